@@ -15,12 +15,14 @@ LIBARCH_SOURCES := \
 	gpgpu.cc \
 	environment_static.cc \
 	cpu_info.cc \
+	perf_counters.cc \
 	vm.cc \
 	info.cc \
 	rtti_utils.cc \
 	rt.cc \
 	abort.cc \
 	spinlock.cc \
+	buffer_pool.cc \
 
 
 LIBARCH_LINK := dl
@@ -0,0 +1,146 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/* buffer_pool.cc
+   Implementation of the process-wide I/O buffer pool.
+*/
+
+#include "buffer_pool.h"
+#include "exception.h"
+#include "arch.h"
+
+#include <mutex>
+#include <vector>
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+
+namespace ML {
+
+namespace {
+
+enum {
+    /// Smallest pooled size class (64kb); classes double from here
+    MIN_CLASS_SHIFT = 16,
+
+    /// Largest pooled size class (256MB); bigger requests aren't pooled
+    MAX_CLASS_SHIFT = 28,
+
+    NUM_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1,
+
+    /// Classes of this size and up are mapped and advised onto huge pages
+    HUGE_PAGE_SHIFT = 21
+};
+
+/// Total bytes allowed to sit in free lists before buffers are really
+/// freed on return; enough that a concurrent import recycles all of its
+/// blocks, small enough not to matter on a server-sized machine
+constexpr size_t MAX_FREE_BYTES = 1ULL << 30;
+
+struct BufferPool {
+
+    std::mutex mutex;
+    std::vector<char *> freeLists[NUM_CLASSES];
+    size_t bytesFree = 0;
+
+    static size_t classSize(int cls)
+    {
+        return 1ULL << (MIN_CLASS_SHIFT + cls);
+    }
+
+    /// Smallest class that fits size, or -1 if none does
+    static int classFor(size_t size)
+    {
+        for (int cls = 0;  cls < NUM_CLASSES;  ++cls)
+            if (size <= classSize(cls))
+                return cls;
+        return -1;
+    }
+
+    static char * allocate(int cls)
+    {
+        size_t size = classSize(cls);
+        void * mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            throw ML::Exception(errno, "buffer pool mmap");
+#ifdef MADV_HUGEPAGE
+        if (size >= (1ULL << HUGE_PAGE_SHIFT)) {
+            // Best effort only; transparent huge pages may be disabled
+            madvise(mem, size, MADV_HUGEPAGE);
+        }
+#endif
+        return (char *)mem;
+    }
+
+    static void deallocate(int cls, char * buffer)
+    {
+        munmap(buffer, classSize(cls));
+    }
+
+    char * get(int cls)
+    {
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            if (!freeLists[cls].empty()) {
+                char * buffer = freeLists[cls].back();
+                freeLists[cls].pop_back();
+                bytesFree -= classSize(cls);
+                return buffer;
+            }
+        }
+        return allocate(cls);
+    }
+
+    void release(int cls, char * buffer)
+    {
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            if (bytesFree + classSize(cls) <= MAX_FREE_BYTES) {
+                freeLists[cls].push_back(buffer);
+                bytesFree += classSize(cls);
+                return;
+            }
+        }
+        deallocate(cls, buffer);
+    }
+};
+
+BufferPool & bufferPool()
+{
+    // Leaked on purpose: buffers may still be in flight on threads that
+    // outlive static destruction
+    static BufferPool * pool = new BufferPool();
+    return *pool;
+}
+
+} // file scope
+
+std::shared_ptr<char>
+get_pooled_buffer(size_t size)
+{
+    int cls = BufferPool::classFor(size);
+
+    if (cls == -1) {
+        // Too big to pool; plain allocation
+        return std::shared_ptr<char>(new char[size],
+                                     [] (char * p) { delete[] p; });
+    }
+
+    BufferPool & pool = bufferPool();
+    return std::shared_ptr<char>(pool.get(cls),
+                                 [&pool, cls] (char * p)
+                                 {
+                                     pool.release(cls, p);
+                                 });
+}
+
+size_t
+pooled_buffer_bytes_free()
+{
+    std::unique_lock<std::mutex> guard(bufferPool().mutex);
+    return bufferPool().bytesFree;
+}
+
+} // namespace ML
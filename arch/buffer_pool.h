@@ -0,0 +1,38 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/* buffer_pool.h                                                   -*- C++ -*-
+   Process-wide pool of large I/O buffers.
+
+   Import, export and compression paths all want multi-megabyte scratch
+   buffers for a short time (a block of lines, an lz4 frame, an S3 part).
+   Allocating and freeing those per block fragments the allocator and
+   makes the kernel fault every page back in each time; this pool keeps
+   freed buffers in per-size-class free lists so that steady-state block
+   I/O recycles already-faulted memory instead.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace ML {
+
+/** Return a buffer of at least size bytes from the process-wide pool.
+    The buffer is returned to the pool when the last reference to it goes
+    away, so it can be handed to worker threads like any other
+    shared_ptr.  The memory is uninitialized (or holds whatever a
+    previous user left in it).
+
+    Sizes are rounded up to a power of two, with a 64kb minimum; classes
+    of 2MB and up are backed by huge pages where the kernel allows it.
+    Requests too big for the largest class fall back to a plain
+    allocation and are not pooled.
+*/
+std::shared_ptr<char> get_pooled_buffer(size_t size);
+
+/** Number of bytes currently sitting in the pool's free lists, for
+    tests and diagnostics. */
+size_t pooled_buffer_bytes_free();
+
+} // namespace ML
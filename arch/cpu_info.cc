@@ -7,9 +7,13 @@
 */
 
 #include "cpu_info.h"
+#include "mldb/arch/exception.h"
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
+
+#include <sched.h>
 
 
 using namespace std;
@@ -46,5 +50,113 @@ void init_num_cpus()
     //cerr << "num_cpus_result = " << num_cpus_result << endl;
 }
 
+namespace {
+
+/* NUMA topology, read once from sysfs.  If anything about the topology
+   can't be parsed we fall back to a single node holding every CPU, which
+   makes all of the queries below degrade to the non-NUMA behaviour. */
+struct NumaInfo {
+    int numNodes;
+    std::vector<int> cpuToNode;           // indexed by cpu number
+    std::vector<std::vector<int> > nodeCpus;  // indexed by node number
+
+    NumaInfo()
+        : numNodes(0)
+    {
+        for (int node = 0;  /* no limit */;  ++node) {
+            ifstream stream("/sys/devices/system/node/node"
+                            + to_string(node) + "/cpulist");
+            if (!stream)
+                break;
+
+            string cpulist;
+            getline(stream, cpulist);
+
+            nodeCpus.emplace_back();
+            if (!parseCpuList(cpulist, node))
+                break;
+            ++numNodes;
+        }
+
+        if (numNodes < 1) {
+            // No topology available; everything on one node
+            numNodes = 1;
+            nodeCpus.assign(1, {});
+            cpuToNode.clear();
+            for (int cpu = 0;  cpu < num_cpus();  ++cpu) {
+                nodeCpus[0].push_back(cpu);
+                cpuToNode.push_back(0);
+            }
+        }
+        nodeCpus.resize(numNodes);
+    }
+
+    /* Parse a sysfs cpulist like "0-23,48-71" for the given node.
+       Returns false if the format isn't understood. */
+    bool parseCpuList(const string & cpulist, int node)
+    {
+        istringstream stream(cpulist);
+        string range;
+        while (getline(stream, range, ',')) {
+            int first, last;
+            char dash;
+            istringstream rangeStream(range);
+            if (!(rangeStream >> first))
+                return false;
+            last = first;
+            if (rangeStream >> dash) {
+                if (dash != '-' || !(rangeStream >> last) || last < first)
+                    return false;
+            }
+            for (int cpu = first;  cpu <= last;  ++cpu) {
+                if (cpu >= cpuToNode.size())
+                    cpuToNode.resize(cpu + 1, 0);
+                cpuToNode[cpu] = node;
+                nodeCpus[node].push_back(cpu);
+            }
+        }
+        return true;
+    }
+};
+
+const NumaInfo & numaInfo()
+{
+    static const NumaInfo info;
+    return info;
+}
+
+} // file scope
+
+int num_numa_nodes_result = 0;
+
+void init_numa_info()
+{
+    num_numa_nodes_result = numaInfo().numNodes;
+}
+
+int numa_node_of_cpu(int cpu)
+{
+    const NumaInfo & info = numaInfo();
+    if (cpu < 0 || cpu >= info.cpuToNode.size())
+        return 0;
+    return info.cpuToNode[cpu];
+}
+
+int current_numa_node()
+{
+    int cpu = sched_getcpu();
+    if (cpu < 0)
+        return 0;
+    return numa_node_of_cpu(cpu);
+}
+
+const std::vector<int> & numa_node_cpus(int node)
+{
+    const NumaInfo & info = numaInfo();
+    if (node < 0 || node >= info.numNodes)
+        throw Exception("numa_node_cpus: node %d out of range", node);
+    return info.nodeCpus[node];
+}
+
 } // namespace ML
 
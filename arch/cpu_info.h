@@ -12,6 +12,8 @@
 
 #include "mldb/compiler/compiler.h"
 
+#include <vector>
+
 namespace ML {
 
 /** Returns the number of CPU cores installed in the system. */
@@ -26,6 +28,31 @@ JML_ALWAYS_INLINE int num_cpus()
     return num_cpus_result;
 }
 
+/** Returns the number of NUMA memory nodes in the system, or 1 if the
+    machine is not NUMA or the topology cannot be determined. */
+
+extern int num_numa_nodes_result;
+
+void init_numa_info();
+
+JML_ALWAYS_INLINE int num_numa_nodes()
+{
+    if (JML_UNLIKELY(!num_numa_nodes_result)) init_numa_info();
+    return num_numa_nodes_result;
+}
+
+/** Returns the NUMA node that the given CPU belongs to, or 0 if the
+    topology cannot be determined. */
+int numa_node_of_cpu(int cpu);
+
+/** Returns the NUMA node that the calling thread is currently running
+    on, or 0 if it cannot be determined. */
+int current_numa_node();
+
+/** Returns the CPUs that belong to the given NUMA node.  Node numbers
+    outside [0, num_numa_nodes()) throw. */
+const std::vector<int> & numa_node_cpus(int node);
+
 } // namespace ML
 
 #endif /* __jml__arch__cpu_info_h__ */
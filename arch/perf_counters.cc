@@ -0,0 +1,138 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/* perf_counters.cc
+   Hardware performance counters, read per thread via perf_event.
+*/
+
+#include "perf_counters.h"
+
+#include <cstring>
+#include <utility>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace ML {
+
+namespace {
+
+/* Availability is probed lazily; the first thread whose group fails to
+   open (EACCES from perf_event_paranoid, ENOSYS in some containers, or
+   a PMU without one of the counters) turns counters off for the whole
+   process so no other thread pays the failed syscalls again. */
+std::atomic<bool> countersDisabled(false);
+
+int openCounter(uint32_t type, uint64_t config, int groupFd)
+{
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(__NR_perf_event_open, &attr,
+                   0 /* this thread */, -1 /* any cpu */,
+                   groupFd, 0 /* flags */);
+}
+
+/** The calling thread's counter group: four counters read together with
+    one read() of the group leader.  Opened enabled and left free
+    running; readers difference totals rather than resetting.
+*/
+struct ThreadCounters {
+    static constexpr int NUM_COUNTERS = 4;
+
+    int fds[NUM_COUNTERS];
+    bool valid;
+
+    ThreadCounters()
+        : valid(false)
+    {
+        for (int & fd: fds)
+            fd = -1;
+
+        if (countersDisabled.load(std::memory_order_relaxed))
+            return;
+
+        static const std::pair<uint32_t, uint64_t> events[NUM_COUNTERS] = {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+        };
+
+        for (int i = 0;  i < NUM_COUNTERS;  ++i) {
+            fds[i] = openCounter(events[i].first, events[i].second,
+                                 i == 0 ? -1 : fds[0]);
+            if (fds[i] == -1) {
+                close();
+                countersDisabled = true;
+                return;
+            }
+        }
+
+        valid = true;
+    }
+
+    ~ThreadCounters()
+    {
+        close();
+    }
+
+    void close()
+    {
+        for (int & fd: fds) {
+            if (fd != -1)
+                ::close(fd);
+            fd = -1;
+        }
+    }
+
+    PerfCounterSample read() const
+    {
+        PerfCounterSample result;
+        if (!valid)
+            return result;
+
+        struct {
+            uint64_t nr;
+            uint64_t values[NUM_COUNTERS];
+        } data;
+
+        ssize_t bytes = ::read(fds[0], &data, sizeof(data));
+        if (bytes != sizeof(data) || data.nr != NUM_COUNTERS)
+            return result;
+
+        result.cycles = data.values[0];
+        result.instructions = data.values[1];
+        result.cacheMisses = data.values[2];
+        result.branchMisses = data.values[3];
+        return result;
+    }
+};
+
+ThreadCounters & threadCounters()
+{
+    static thread_local ThreadCounters counters;
+    return counters;
+}
+
+} // file scope
+
+bool perf_counters_available()
+{
+    return threadCounters().valid;
+}
+
+PerfCounterSample read_thread_perf_counters()
+{
+    return threadCounters().read();
+}
+
+} // namespace ML
@@ -0,0 +1,123 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/* perf_counters.h                                                 -*- C++ -*-
+   Hardware performance counters, read per thread via perf_event.
+
+   tick_counter.h gives cycle counts; this adds the counters needed to
+   see *why* a phase is slow: instructions (for IPC), last level cache
+   misses and branch misses.  Everything degrades to zero readings when
+   the kernel refuses counter access (perf_event_paranoid, containers,
+   missing PMU), so callers never need a fallback path.
+*/
+
+#ifndef __jml__arch__perf_counters_h__
+#define __jml__arch__perf_counters_h__
+
+#include <atomic>
+#include <cstdint>
+
+namespace ML {
+
+/** One reading of a thread's counter group.  Values are running totals
+    since the group was opened; attribute work by differencing two
+    readings.
+*/
+struct PerfCounterSample {
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0;    ///< Last level cache misses
+    uint64_t branchMisses = 0;
+};
+
+/** Are hardware counters available to this process?  Checked by trying
+    to open a counter group; the first failure disables counters for the
+    whole process, so this is cheap to call repeatedly.
+*/
+bool perf_counters_available();
+
+/** Current totals of the calling thread's counter group, opening it on
+    first use.  All zeros when counters are unavailable.
+*/
+PerfCounterSample read_thread_perf_counters();
+
+/** Totals for one phase of work, accumulated from many threads.  Plain
+    relaxed atomic adds; readings from concurrent scopes on different
+    threads sum correctly.
+*/
+struct PerfCounterAccumulator {
+    std::atomic<uint64_t> cycles;
+    std::atomic<uint64_t> instructions;
+    std::atomic<uint64_t> cacheMisses;
+    std::atomic<uint64_t> branchMisses;
+
+    PerfCounterAccumulator()
+        : cycles(0), instructions(0), cacheMisses(0), branchMisses(0)
+    {
+    }
+
+    /// Add the work between two readings of one thread's counters
+    void add(const PerfCounterSample & from, const PerfCounterSample & to)
+    {
+        cycles += to.cycles - from.cycles;
+        instructions += to.instructions - from.instructions;
+        cacheMisses += to.cacheMisses - from.cacheMisses;
+        branchMisses += to.branchMisses - from.branchMisses;
+    }
+
+    /// Nothing was ever attributed here (or counters are unavailable)
+    bool empty() const
+    {
+        return cycles.load(std::memory_order_relaxed) == 0;
+    }
+
+    PerfCounterSample total() const
+    {
+        PerfCounterSample result;
+        result.cycles = cycles.load(std::memory_order_relaxed);
+        result.instructions = instructions.load(std::memory_order_relaxed);
+        result.cacheMisses = cacheMisses.load(std::memory_order_relaxed);
+        result.branchMisses = branchMisses.load(std::memory_order_relaxed);
+        return result;
+    }
+};
+
+/** RAII scope that attributes the calling thread's counter deltas over
+    its lifetime to an accumulator.  A null accumulator makes the scope
+    a no-op, so call sites don't need to be conditional.  The counters
+    free-run (scopes read, they never reset), so scopes nest: an inner
+    scope's work is also counted by the outer one.
+*/
+struct PerfCounterScope {
+    PerfCounterScope(PerfCounterAccumulator * accum)
+        : accum(accum)
+    {
+        if (accum)
+            before = read_thread_perf_counters();
+    }
+
+    ~PerfCounterScope()
+    {
+        stop();
+    }
+
+    /// Attribute the work so far and disarm, for when the phase ends
+    /// before the enclosing C++ scope does
+    void stop()
+    {
+        if (accum) {
+            accum->add(before, read_thread_perf_counters());
+            accum = nullptr;
+        }
+    }
+
+    PerfCounterScope(const PerfCounterScope &) = delete;
+    void operator = (const PerfCounterScope &) = delete;
+
+private:
+    PerfCounterAccumulator * accum;
+    PerfCounterSample before;
+};
+
+} // namespace ML
+
+#endif /* __jml__arch__perf_counters_h__ */
@@ -153,22 +153,36 @@ struct RcuProtected {
 
     JML_IMPLEMENT_OPERATOR_BOOL(val);
 
+    /* Note that for all of the read operations, we enter the critical
+       section *before* we read the pointer.  Reading the pointer first
+       (for example by passing val to the RcuLocked constructor, which
+       evaluates it before lockShared() runs) would leave a window in
+       which a concurrent replace() could defer-delete the object we're
+       about to dereference.
+    */
+
     RcuLocked<T> operator () ()
     {
         //ExcAssert(lock);
-        return RcuLocked<T>(val, lock);
+        RcuLocked<T> result(nullptr, lock);
+        result.ptr = val.load();
+        return result;
     }
 
     RcuLocked<const T> operator () () const
     {
         //ExcAssert(lock);
-        return RcuLocked<const T>(val, lock);
+        RcuLocked<const T> result(nullptr, lock);
+        result.ptr = val.load();
+        return result;
     }
 
     RcuLocked<const T> getImmutable() const
     {
         //ExcAssert(lock);
-        return RcuLocked<const T>(val, lock);
+        RcuLocked<const T> result(nullptr, lock);
+        result.ptr = val.load();
+        return result;
     }
 
     T * unsafePtr() const
@@ -1010,6 +1010,32 @@ double vec_dotprod_dp(const float * x, const float * y, size_t n)
     }
 }
 
+void vec_dotprod_dp_many(const float * x, const float * const * ys,
+                         size_t m, size_t n, double * out)
+{
+    // Interrogate the cpuid flags directly to decide which one to use
+    if (has_avx()) {
+        Avx::vec_dotprod_dp_many(x, ys, m, n, out);
+    }
+    else {
+        for (size_t j = 0;  j < m;  ++j)
+            out[j] = vec_dotprod_dp_sse2(x, ys[j], n);
+    }
+}
+
+void vec_euclid_many(const float * x, const float * const * ys,
+                     size_t m, size_t n, double * out)
+{
+    // Interrogate the cpuid flags directly to decide which one to use
+    if (has_avx()) {
+        Avx::vec_euclid_many(x, ys, m, n, out);
+    }
+    else {
+        for (size_t j = 0;  j < m;  ++j)
+            out[j] = vec_euclid(x, ys[j], n);
+    }
+}
+
 double vec_sum_dp(const float * x, size_t n)
 {
     double res = 0.0;
@@ -1728,6 +1754,152 @@ void vec_min_max_el(const float * x, float * mins, float * maxs, size_t n)
     }
 }
 
+double vec_dotprod_i8_dp(const int8_t * x, const int8_t * y,
+                         const float * scale2, size_t n)
+{
+    double res = 0.0;
+    unsigned i = 0;
+
+    if (true) {
+        v2df rr = vec_splat(0.0);
+        __m128i zero = _mm_setzero_si128();
+
+        for (; i + 16 <= n;  i += 16) {
+            __m128i xb = _mm_loadu_si128((const __m128i *)(x + i));
+            __m128i yb = _mm_loadu_si128((const __m128i *)(y + i));
+
+            // Sign extend the 8 bit values to 16 bits
+            __m128i x16a = _mm_unpacklo_epi8(xb, _mm_cmpgt_epi8(zero, xb));
+            __m128i x16b = _mm_unpackhi_epi8(xb, _mm_cmpgt_epi8(zero, xb));
+            __m128i y16a = _mm_unpacklo_epi8(yb, _mm_cmpgt_epi8(zero, yb));
+            __m128i y16b = _mm_unpackhi_epi8(yb, _mm_cmpgt_epi8(zero, yb));
+
+            // The product of two int8 values fits exactly in an int16
+            __m128i pa = _mm_mullo_epi16(x16a, y16a);
+            __m128i pb = _mm_mullo_epi16(x16b, y16b);
+
+            // Sign extend the products to 32 bits, convert to float and
+            // apply the per-column scale
+            __m128i sa = _mm_cmpgt_epi16(zero, pa);
+            __m128i sb = _mm_cmpgt_epi16(zero, pb);
+
+            v4sf ffff0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(pa, sa));
+            ffff0 *= _mm_loadu_ps(scale2 + i + 0);
+            v4sf ffff1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(pa, sa));
+            ffff1 *= _mm_loadu_ps(scale2 + i + 4);
+            v4sf ffff2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(pb, sb));
+            ffff2 *= _mm_loadu_ps(scale2 + i + 8);
+            v4sf ffff3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(pb, sb));
+            ffff3 *= _mm_loadu_ps(scale2 + i + 12);
+
+            rr += __builtin_ia32_cvtps2pd(ffff0);
+            ffff0 = _mm_shuffle_ps(ffff0, ffff0, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff0);
+
+            rr += __builtin_ia32_cvtps2pd(ffff1);
+            ffff1 = _mm_shuffle_ps(ffff1, ffff1, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff1);
+
+            rr += __builtin_ia32_cvtps2pd(ffff2);
+            ffff2 = _mm_shuffle_ps(ffff2, ffff2, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff2);
+
+            rr += __builtin_ia32_cvtps2pd(ffff3);
+            ffff3 = _mm_shuffle_ps(ffff3, ffff3, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff3);
+        }
+
+        double results[2];
+        *(v2df *)results = rr;
+
+        res = results[0] + results[1];
+    }
+
+    for (; i < n;  ++i)
+        res += double(int(x[i]) * int(y[i])) * scale2[i];
+
+    return res;
+}
+
+double vec_twonorm_sqr_i8_dp(const int8_t * x, const float * scale2,
+                             size_t n)
+{
+    return vec_dotprod_i8_dp(x, x, scale2, n);
+}
+
+double vec_euclid_i8(const int8_t * x, const int8_t * y,
+                     const float * scale2, size_t n)
+{
+    double res = 0.0;
+    unsigned i = 0;
+
+    if (true) {
+        v2df rr = vec_splat(0.0);
+        __m128i zero = _mm_setzero_si128();
+
+        for (; i + 16 <= n;  i += 16) {
+            __m128i xb = _mm_loadu_si128((const __m128i *)(x + i));
+            __m128i yb = _mm_loadu_si128((const __m128i *)(y + i));
+
+            // Sign extend the 8 bit values to 16 bits
+            __m128i x16a = _mm_unpacklo_epi8(xb, _mm_cmpgt_epi8(zero, xb));
+            __m128i x16b = _mm_unpackhi_epi8(xb, _mm_cmpgt_epi8(zero, xb));
+            __m128i y16a = _mm_unpacklo_epi8(yb, _mm_cmpgt_epi8(zero, yb));
+            __m128i y16b = _mm_unpackhi_epi8(yb, _mm_cmpgt_epi8(zero, yb));
+
+            // The difference of two int8 values fits exactly in an int16,
+            // but its square doesn't, so we square in single precision
+            // after converting
+            __m128i da = _mm_sub_epi16(x16a, y16a);
+            __m128i db = _mm_sub_epi16(x16b, y16b);
+
+            __m128i sa = _mm_cmpgt_epi16(zero, da);
+            __m128i sb = _mm_cmpgt_epi16(zero, db);
+
+            v4sf ffff0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(da, sa));
+            ffff0 *= ffff0;
+            ffff0 *= _mm_loadu_ps(scale2 + i + 0);
+            v4sf ffff1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(da, sa));
+            ffff1 *= ffff1;
+            ffff1 *= _mm_loadu_ps(scale2 + i + 4);
+            v4sf ffff2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(db, sb));
+            ffff2 *= ffff2;
+            ffff2 *= _mm_loadu_ps(scale2 + i + 8);
+            v4sf ffff3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(db, sb));
+            ffff3 *= ffff3;
+            ffff3 *= _mm_loadu_ps(scale2 + i + 12);
+
+            rr += __builtin_ia32_cvtps2pd(ffff0);
+            ffff0 = _mm_shuffle_ps(ffff0, ffff0, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff0);
+
+            rr += __builtin_ia32_cvtps2pd(ffff1);
+            ffff1 = _mm_shuffle_ps(ffff1, ffff1, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff1);
+
+            rr += __builtin_ia32_cvtps2pd(ffff2);
+            ffff2 = _mm_shuffle_ps(ffff2, ffff2, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff2);
+
+            rr += __builtin_ia32_cvtps2pd(ffff3);
+            ffff3 = _mm_shuffle_ps(ffff3, ffff3, 14);
+            rr += __builtin_ia32_cvtps2pd(ffff3);
+        }
+
+        double results[2];
+        *(v2df *)results = rr;
+
+        res = results[0] + results[1];
+    }
+
+    for (; i < n;  ++i) {
+        int d = int(x[i]) - int(y[i]);
+        res += double(d * d) * scale2[i];
+    }
+
+    return res;
+}
+
 } // namespace Generic
 } // namespace SIMD
 } // namespace ML
@@ -10,6 +10,7 @@
 
 #include "simd.h"
 #include "mldb/arch/arch.h"
+#include <cstdint>
 
 namespace ML {
 
@@ -171,6 +172,35 @@ void vec_min_max_el(const float * x, float * mins, float * maxs, size_t n);
 // Euclidean distance squared: sum((p - q)^2)
 double vec_euclid(const float * p, const float * q, size_t n);
 
+/* One to many versions, for scanning many candidate vectors against a
+   single query vector: each block of the query is loaded once and
+   reused across several candidates. */
+
+// out[j] = dotprod(x, ys[j]) for j < m, accumulated in double precision
+void vec_dotprod_dp_many(const float * x, const float * const * ys,
+                         size_t m, size_t n, double * out);
+
+// out[j] = sum((x - ys[j])^2) for j < m
+void vec_euclid_many(const float * x, const float * const * ys,
+                     size_t m, size_t n, double * out);
+
+/* Quantized (int8) versions, for values stored as round(value / scale)
+   with a per-column scale.  scale2 holds, per column, the product of the
+   scales of the two vectors (the square of the scale when both vectors
+   are quantized with the same scales). */
+
+// Dot product: sum(x_i y_i scale2_i)
+double vec_dotprod_i8_dp(const int8_t * x, const int8_t * y,
+                         const float * scale2, size_t n);
+
+// Square of the two norm: sum(x_i^2 scale2_i)
+double vec_twonorm_sqr_i8_dp(const int8_t * x, const float * scale2,
+                             size_t n);
+
+// Euclidean distance squared: sum((x_i - y_i)^2 scale2_i)
+double vec_euclid_i8(const int8_t * x, const int8_t * y,
+                     const float * scale2, size_t n);
+
 } // namespace Generic
 
 #if JML_USE_SSE1
@@ -303,6 +303,109 @@ double vec_dotprod_dp(const float * x, const float * y, size_t n)
     return res;
 }
 
+void vec_dotprod_dp_many(const float * x, const float * const * ys,
+                         size_t m, size_t n, double * out)
+{
+    size_t j = 0;
+
+    // Four candidates at a time: each 8 wide block of the query vector
+    // is loaded once and multiplied against all four candidates, so the
+    // query loads are amortized over the scan.
+    for (; j + 4 <= m;  j += 4) {
+        const float * y0 = ys[j + 0];
+        const float * y1 = ys[j + 1];
+        const float * y2 = ys[j + 2];
+        const float * y3 = ys[j + 3];
+
+        v4df rr0 = _mm256_setzero_pd(), rr1 = rr0, rr2 = rr0, rr3 = rr0;
+
+        size_t i = 0;
+        for (; i + 8 <= n;  i += 8) {
+            v8sf xxxx0 = _mm256_loadu_ps(x + i);
+
+            auto accum = [&] (const float * y, v4df & rr)
+                {
+                    v8sf yyyy0 = _mm256_loadu_ps(y + i);
+                    yyyy0 *= xxxx0;
+                    v4df dd0a = _mm256_cvtps_pd(_mm256_extractf128_ps(yyyy0, 0));
+                    v4df dd0b = _mm256_cvtps_pd(_mm256_extractf128_ps(yyyy0, 1));
+                    rr += dd0a + dd0b;
+                };
+
+            accum(y0, rr0);
+            accum(y1, rr1);
+            accum(y2, rr2);
+            accum(y3, rr3);
+        }
+
+        auto finish = [&] (v4df rr, const float * y) -> double
+            {
+                double results[4];
+                *(v4df *)results = rr;
+                double res = results[0] + results[1]
+                           + results[2] + results[3];
+                for (size_t k = i;  k < n;  ++k) res += x[k] * y[k];
+                return res;
+            };
+
+        out[j + 0] = finish(rr0, y0);
+        out[j + 1] = finish(rr1, y1);
+        out[j + 2] = finish(rr2, y2);
+        out[j + 3] = finish(rr3, y3);
+    }
+
+    for (; j < m;  ++j)
+        out[j] = vec_dotprod_dp(x, ys[j], n);
+}
+
+void vec_euclid_many(const float * x, const float * const * ys,
+                     size_t m, size_t n, double * out)
+{
+    size_t j = 0;
+
+    for (; j + 4 <= m;  j += 4) {
+        const float * y0 = ys[j + 0];
+        const float * y1 = ys[j + 1];
+        const float * y2 = ys[j + 2];
+        const float * y3 = ys[j + 3];
+
+        v8sf rr0 = _mm256_setzero_ps(), rr1 = rr0, rr2 = rr0, rr3 = rr0;
+
+        size_t i = 0;
+        for (; i + 8 <= n;  i += 8) {
+            v8sf xxxx0 = _mm256_loadu_ps(x + i);
+
+            auto accum = [&] (const float * y, v8sf & rr)
+                {
+                    v8sf yyyy0 = _mm256_loadu_ps(y + i);
+                    yyyy0 -= xxxx0;
+                    rr += yyyy0 * yyyy0;
+                };
+
+            accum(y0, rr0);
+            accum(y1, rr1);
+            accum(y2, rr2);
+            accum(y3, rr3);
+        }
+
+        auto finish = [&] (v8sf rr, const float * y) -> double
+            {
+                double res = horiz_sum_8_avx(rr, _mm256_setzero_ps());
+                for (size_t k = i;  k < n;  ++k)
+                    res += (x[k] - y[k]) * (x[k] - y[k]);
+                return res;
+            };
+
+        out[j + 0] = finish(rr0, y0);
+        out[j + 1] = finish(rr1, y1);
+        out[j + 2] = finish(rr2, y2);
+        out[j + 3] = finish(rr3, y3);
+    }
+
+    for (; j < m;  ++j)
+        out[j] = vec_euclid(x, ys[j], n);
+}
+
 } // namespace Avx
 } // namespace SIMD
 } // namespace ML
@@ -29,6 +29,16 @@ void vec_minus(const float * x, const float * y, float * r, size_t n);
 /// Single precision vector euclidean distance squared
 double vec_euclid(const float * x, const float * y, size_t n);
 
+/// One to many dot product: out[j] = dotprod(x, ys[j]) for j < m, with
+/// internal summation in dp.  Each block of the query vector x is
+/// loaded once and reused across several candidates.
+void vec_dotprod_dp_many(const float * x, const float * const * ys,
+                         size_t m, size_t n, double * out);
+
+/// One to many euclidean distance squared: out[j] = vec_euclid(x, ys[j])
+void vec_euclid_many(const float * x, const float * const * ys,
+                     size_t m, size_t n, double * out);
+
 } // namespace Avx
 } // namespace SIMD
 } // namespace ML
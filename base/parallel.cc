@@ -14,6 +14,76 @@
 
 namespace Datacratic {
 
+/** Divider for guided self-scheduling: each claim takes at most
+    1/(GUIDED_DIVIDER * numWorkers) of the remaining work, so claims shrink
+    geometrically as the end approaches.  A straggler can therefore be left
+    holding at most that fraction of the tail, no matter how skewed the
+    per-item costs are.
+*/
+static constexpr size_t GUIDED_DIVIDER = 8;
+
+namespace {
+
+/** Process-wide budget of extra worker jobs for parallelMap.  Every call
+    runs its worker loop inline on the calling thread, and may claim up to
+    occupancyLimit - 1 extra shares from this budget to run workers on the
+    thread pool as well.  A nested parallelMap, whose enclosing call
+    typically holds the whole budget, gets no shares and degrades to an
+    inline loop instead of flooding the shared pool with another full set
+    of worker jobs; as the outer call's workers finish and release their
+    shares, inner calls start claiming them again.
+*/
+std::atomic<int> & workerBudget()
+{
+    static std::atomic<int> budget(numCpus() - 1);
+    return budget;
+}
+
+/// Claim up to wanted shares of the worker budget; never blocks, and may
+/// return less than asked for (including zero).
+int claimWorkers(int wanted)
+{
+    if (wanted <= 0)
+        return 0;
+    std::atomic<int> & budget = workerBudget();
+    int available = budget.load(std::memory_order_relaxed);
+    for (;;) {
+        int granted = std::min(wanted, available);
+        if (granted <= 0)
+            return 0;
+        if (budget.compare_exchange_weak(available, available - granted))
+            return granted;
+    }
+}
+
+void releaseWorkers(int numWorkers)
+{
+    if (numWorkers > 0)
+        workerBudget() += numWorkers;
+}
+
+/** Per-thread parallelism limit set by ScopedParallelismLimit; -1 means
+    no limit.  Propagated from the calling thread into the workers of its
+    parallelMap calls so that it covers the whole task tree.
+*/
+thread_local int threadParallelismLimit = -1;
+
+} // file scope
+
+ScopedParallelismLimit::
+ScopedParallelismLimit(int numThreads)
+    : savedLimit(threadParallelismLimit)
+{
+    ExcAssertGreater(numThreads, 0);
+    threadParallelismLimit = numThreads;
+}
+
+ScopedParallelismLimit::
+~ScopedParallelismLimit()
+{
+    threadParallelismLimit = savedLimit;
+}
+
 void parallelMap(size_t first, size_t last,
                  const std::function<void (size_t)> & doWork,
                  int occupancyLimit)
@@ -30,18 +100,41 @@ void parallelMap(size_t first, size_t last,
     ThreadPool tp;
 
     if (occupancyLimit == -1)
-        occupancyLimit = numCpus();
+        occupancyLimit = threadParallelismLimit != -1
+            ? threadParallelismLimit : numCpus();
     if (occupancyLimit > (last - first))
         occupancyLimit = (last - first);
 
-    auto worker = [&] ()
+    // Claim our share of the worker budget.  A nested call will usually
+    // get nothing, and run inline on this thread alone.
+    int extraWorkers = claimWorkers(occupancyLimit - 1);
+
+    size_t numWorkers = extraWorkers + 1;
+
+    int callerLimit = threadParallelismLimit;
+
+    auto workerLoop = [&] ()
         {
             while (!has_exc.load(std::memory_order_relaxed)) {
-                size_t myindex = index.fetch_add(1);
+                // Claim a batch of items when there is lots of work left,
+                // to avoid hammering the shared counter, and single items
+                // once the end is near so that one expensive item can't
+                // hold up the tail while the other threads sit idle.
+                size_t current = index.load(std::memory_order_relaxed);
+                if (current >= last)
+                    return;
+                size_t batch
+                    = std::max<size_t>(1, (last - current)
+                                       / (GUIDED_DIVIDER * numWorkers));
+                size_t myindex = index.fetch_add(batch);
                 if (myindex >= last)
                     return;
+                size_t indexEnd = std::min(last, myindex + batch);
                 try {
-                    doWork(myindex);
+                    for (size_t i = myindex;
+                         i < indexEnd && !has_exc.load(std::memory_order_relaxed);
+                         ++i)
+                        doWork(i);
                 } JML_CATCH_ALL {
                     if (has_exc.fetch_add(1) == 0) {
                         ExcAssert(!exc);
@@ -51,10 +144,22 @@ void parallelMap(size_t first, size_t last,
             }
         };
 
-    // Leave one set of work for this thread to do directly
-    for (int i = 0;  i < occupancyLimit - 1;  ++i)
-        tp.add(worker);
-    
+    auto worker = [&] ()
+        {
+            // Propagate the caller's parallelism limit onto the thread
+            // running this worker, so that nested parallelMap calls made
+            // from doWork respect it too.
+            int savedLimit = threadParallelismLimit;
+            threadParallelismLimit = callerLimit;
+            workerLoop();
+            threadParallelismLimit = savedLimit;
+        };
+
+    // Each pooled worker gives its budget share back as soon as its loop
+    // finishes, so calls still running can pick it up.
+    for (int i = 0;  i < extraWorkers;  ++i)
+        tp.add([&] () { worker(); releaseWorkers(1); });
+
     // Do work until there is nothing left to do
     worker();
 
@@ -81,19 +186,40 @@ void parallelMapChunked(size_t first, size_t last, size_t chunkSize,
 
     // This creates a thread pool that runs jobs on the default thread pool
     ThreadPool tp;
-    
+
     if (occupancyLimit == -1)
-        occupancyLimit = numCpus();
+        occupancyLimit = threadParallelismLimit != -1
+            ? threadParallelismLimit : numCpus();
     if (occupancyLimit > (last - first + chunkSize - 1) / chunkSize)
         occupancyLimit = (last - first + chunkSize - 1) / chunkSize;
 
-    auto worker = [&] ()
+    // Claim our share of the worker budget.  A nested call will usually
+    // get nothing, and run inline on this thread alone.
+    int extraWorkers = claimWorkers(occupancyLimit - 1);
+
+    size_t numWorkers = extraWorkers + 1;
+
+    int callerLimit = threadParallelismLimit;
+
+    auto workerLoop = [&] ()
         {
             while (!has_exc.load(std::memory_order_relaxed)) {
-                size_t myindex = index.fetch_add(chunkSize);
+                // Guided self-scheduling: chunkSize is the upper bound on
+                // the chunk, but as the end approaches we split claims
+                // down as far as a single item, so that a chunk with
+                // skewed per-item costs near the end can't leave the
+                // other threads idle while one finishes it.
+                size_t current = index.load(std::memory_order_relaxed);
+                if (current >= last)
+                    return;
+                size_t mychunk
+                    = std::min(chunkSize,
+                               std::max<size_t>(1, (last - current)
+                                                / (GUIDED_DIVIDER * numWorkers)));
+                size_t myindex = index.fetch_add(mychunk);
                 if (myindex >= last)
                     return;
-                size_t indexEnd = std::min(last, myindex + chunkSize);
+                size_t indexEnd = std::min(last, myindex + mychunk);
                 try {
                     doWork(myindex, indexEnd);
                 } JML_CATCH_ALL {
@@ -105,13 +231,25 @@ void parallelMapChunked(size_t first, size_t last, size_t chunkSize,
             }
         };
 
-    // Leave one set of work for this thread to do directly
-    for (int i = 0;  i < occupancyLimit - 1;  ++i)
-        tp.add(worker);
-    
+    auto worker = [&] ()
+        {
+            // Propagate the caller's parallelism limit onto the thread
+            // running this worker, so that nested parallelMap calls made
+            // from doWork respect it too.
+            int savedLimit = threadParallelismLimit;
+            threadParallelismLimit = callerLimit;
+            workerLoop();
+            threadParallelismLimit = savedLimit;
+        };
+
+    // Each pooled worker gives its budget share back as soon as its loop
+    // finishes, so calls still running can pick it up.
+    for (int i = 0;  i < extraWorkers;  ++i)
+        tp.add([&] () { worker(); releaseWorkers(1); });
+
     // Do work until there is nothing left to do
     worker();
-    
+
     // Wait for the rest of the work to be done
     tp.waitForAll();
 
@@ -40,11 +40,38 @@ void parallelMap(size_t first, size_t last,
                  int occupancyLimit = -1);
 
 /** Same as parallelMap, except that each doWork() call will be passed
-    a chunk of work of chunkSize.  This is useful to reduce the amount
-    of calling overhead on a very fine-grained job.
+    a chunk of work of at most chunkSize.  This is useful to reduce the
+    amount of calling overhead on a very fine-grained job.
+
+    Scheduling is guided: chunks close to chunkSize are handed out while
+    there is plenty of work left, with progressively smaller chunks (down
+    to a single item) towards the end, so that skewed per-item costs
+    don't leave threads idle waiting for the last big chunk.
 */
 void parallelMapChunked(size_t first, size_t last, size_t chunkSize,
                         const std::function<void (size_t, size_t)> & doWork,
                         int occupancyLimit = -1);
 
+/** Scoped limit on the parallelism of parallelMap calls that don't pass
+    an explicit occupancyLimit.  The limit applies to calls made from the
+    current thread and propagates into the workers of those calls, so it
+    caps a whole task tree: a procedure that runs four folds in parallel
+    can give each fold a quarter of the machine, and every parallelMap
+    the fold makes underneath will respect it.
+
+    Limits nest; the innermost one applies.  The destructor restores the
+    previous limit, so the guard must be destroyed on the thread that
+    created it.
+*/
+struct ScopedParallelismLimit {
+    ScopedParallelismLimit(int numThreads);
+    ~ScopedParallelismLimit();
+
+    ScopedParallelismLimit(const ScopedParallelismLimit &) = delete;
+    void operator = (const ScopedParallelismLimit &) = delete;
+
+private:
+    int savedLimit;
+};
+
 } // namespace Datacratic
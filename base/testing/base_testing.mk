@@ -1,3 +1,4 @@
 # This file is part of MLDB. Copyright 2015 Datacratic. All rights reserved.
 
 $(eval $(call test,thread_pool_test,base,boost timed))
+$(eval $(call test,parallel_test,base,boost))
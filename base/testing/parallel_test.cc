@@ -0,0 +1,122 @@
+/** parallel_test.cc
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Test of the parallel map functions, in particular that the guided
+    scheduling covers every index exactly once.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "mldb/base/parallel.h"
+#include "mldb/base/exc_assert.h"
+#include "mldb/arch/exception.h"
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+using namespace Datacratic;
+
+BOOST_AUTO_TEST_CASE (test_parallel_map_covers_all_indexes)
+{
+    for (size_t n: { (size_t)0, (size_t)1, (size_t)3, (size_t)1000,
+                     (size_t)12345 }) {
+        vector<std::atomic<int> > visited(n);
+        for (auto & v: visited)
+            v = 0;
+
+        parallelMap(0, n, [&] (size_t i) { ++visited[i]; });
+
+        for (size_t i = 0;  i < n;  ++i)
+            BOOST_REQUIRE_EQUAL(visited[i], 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (test_parallel_map_chunked_covers_all_indexes)
+{
+    for (size_t n: { (size_t)1, (size_t)3, (size_t)1000, (size_t)12345 }) {
+        for (size_t chunkSize: { (size_t)1, (size_t)7, (size_t)1024 }) {
+            vector<std::atomic<int> > visited(n);
+            for (auto & v: visited)
+                v = 0;
+
+            std::atomic<size_t> maxChunk(0);
+
+            auto onChunk = [&] (size_t first, size_t last)
+                {
+                    BOOST_REQUIRE_LE(last, n);
+                    size_t sz = last - first;
+                    size_t prev = maxChunk.load();
+                    while (sz > prev
+                           && !maxChunk.compare_exchange_weak(prev, sz)) ;
+                    for (size_t i = first;  i < last;  ++i)
+                        ++visited[i];
+                };
+
+            parallelMapChunked(0, n, chunkSize, onChunk);
+
+            BOOST_CHECK_LE(maxChunk, chunkSize);
+
+            for (size_t i = 0;  i < n;  ++i)
+                BOOST_REQUIRE_EQUAL(visited[i], 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (test_nested_parallel_map_covers_all_indexes)
+{
+    constexpr size_t OUTER = 64, INNER = 200;
+
+    vector<std::atomic<int> > visited(OUTER * INNER);
+    for (auto & v: visited)
+        v = 0;
+
+    // The inner calls mostly find the worker budget exhausted and run
+    // inline; either way every (i, j) pair must be seen exactly once.
+    parallelMap(0, OUTER, [&] (size_t i)
+        {
+            parallelMap(0, INNER, [&] (size_t j)
+                {
+                    ++visited[i * INNER + j];
+                });
+        });
+
+    for (size_t i = 0;  i < OUTER * INNER;  ++i)
+        BOOST_REQUIRE_EQUAL(visited[i], 1);
+}
+
+BOOST_AUTO_TEST_CASE (test_scoped_parallelism_limit)
+{
+    std::atomic<int> active(0);
+    std::atomic<int> maxActive(0);
+
+    auto doWork = [&] (size_t i)
+        {
+            int nowActive = ++active;
+            int prev = maxActive.load();
+            while (nowActive > prev
+                   && !maxActive.compare_exchange_weak(prev, nowActive)) ;
+            --active;
+        };
+
+    // A limit of one means no extra workers are claimed at all, so the
+    // whole map runs on the calling thread.
+    ScopedParallelismLimit limit(1);
+    parallelMap(0, 10000, doWork);
+
+    BOOST_CHECK_EQUAL(maxActive, 1);
+}
+
+BOOST_AUTO_TEST_CASE (test_parallel_map_propagates_exception)
+{
+    auto doWork = [&] (size_t i)
+        {
+            if (i == 93)
+                throw ML::Exception("expected failure");
+        };
+
+    BOOST_CHECK_THROW(parallelMap(0, 1000, doWork), std::exception);
+}
@@ -11,6 +11,7 @@
 #include "thread_pool_impl.h"
 #include "mldb/arch/thread_specific.h"
 #include "mldb/arch/demangle.h"
+#include "mldb/arch/cpu_info.h"
 #include "mldb/jml/utils/environment.h"
 #include <atomic>
 #include <condition_variable>
@@ -32,6 +33,24 @@ int numCpus()
     return NUM_CPUS;
 }
 
+static ML::Env_Option<bool>
+BIND_WORKERS_TO_NUMA_NODE("THREADPOOL_BIND_NUMA", true);
+
+/** Bind the calling thread to the CPUs of the given NUMA node.  On a
+    multi-socket machine this keeps each worker resident on one node, so
+    the memory it first touches is allocated there and a scan never drags
+    its working set across the interconnect mid-job.  The thread remains
+    free to move between the CPUs of its node.
+*/
+static void bindThreadToNumaNode(int node)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu: ML::numa_node_cpus(node))
+        CPU_SET(cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
 /*****************************************************************************/
 /* THREAD POOL                                                               */
 /*****************************************************************************/
@@ -475,6 +494,13 @@ struct ThreadPool::Itl: public std::enable_shared_from_this<ThreadPool::Itl> {
     /** Run a worker thread. */
     void runWorker(int workerNum)
     {
+        // Spread the workers round-robin over the NUMA nodes and keep
+        // them there, so that the chunks of memory they allocate and
+        // first touch while working stay local to the node they will
+        // keep running on.  Can be turned off with THREADPOOL_BIND_NUMA=0.
+        if (BIND_WORKERS_TO_NUMA_NODE && ML::num_numa_nodes() > 1)
+            bindThreadToNumaNode(workerNum % ML::num_numa_nodes());
+
         ThreadEntry & entry = getEntry(workerNum);
 
         int itersWithNoWork = 0;
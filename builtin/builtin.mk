@@ -2,11 +2,14 @@
 
 LIBMLDB_BUILTIN_SOURCES:= \
 	merged_dataset.cc \
+	union_dataset.cc \
 	transposed_dataset.cc \
 	joined_dataset.cc \
 	sub_dataset.cc \
 	filtered_dataset.cc \
 	sampled_dataset.cc \
+	histogram_dataset.cc \
+	reservoir_dataset.cc \
 
 LIBMLDB_BUILTIN_LINK:= mldb_core
 
@@ -263,5 +263,12 @@ getColumnIndex() const
     return itl;
 }
 
+std::shared_ptr<RowStream>
+FilteredDataset::
+getRowStream() const
+{
+    return dataset.getRowStream();
+}
+
 } // namespace MLDB
 } // namespace Datacratic
@@ -51,6 +51,13 @@ struct FilteredDataset : public Dataset {
     virtual std::shared_ptr<MatrixView> getMatrixView() const;
     virtual std::shared_ptr<ColumnIndex> getColumnIndex() const;
 
+    /** The filter drops tuples within rows, not rows, so the row set is
+        exactly the underlying dataset's and its stream can be forwarded.
+        Without this, queries with a WHEN clause lost the parallelized
+        executor path and fell back to row-by-row iteration.
+    */
+    virtual std::shared_ptr<RowStream> getRowStream() const;
+
     // TODO: if often used, this could be reasonably overridden here
     //virtual std::pair<Date, Date> getTimestampRange() const;
 
@@ -0,0 +1,245 @@
+/** histogram_dataset.cc                                           -*- C++ -*-
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Implementation of the histogram() table function.  Computes an
+    equi-width or quantile-width histogram of a numeric column in a
+    single parallel pass, with one count array per worker merged at the
+    end, and materializes the buckets as a small sub dataset.
+*/
+
+#include "mldb/sql/sql_expression.h"
+#include "sub_dataset.h"
+#include "mldb/core/dataset.h"
+#include "mldb/server/bucket.h"
+#include "mldb/base/parallel.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/types/structure_description.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/http/http_exception.h"
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* HISTOGRAM CONFIG                                                          */
+/*****************************************************************************/
+
+struct HistogramConfig {
+    HistogramConfig()
+        : numBuckets(20), quantile(false)
+    {
+    }
+
+    Utf8String column;   ///< Column the histogram is computed over
+    int numBuckets;      ///< Number of buckets
+    bool quantile;       ///< Quantile-width buckets instead of equi-width
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(HistogramConfig);
+
+DEFINE_STRUCTURE_DESCRIPTION(HistogramConfig);
+
+HistogramConfigDescription::
+HistogramConfigDescription()
+{
+    addField("column", &HistogramConfig::column,
+             "Column to compute the histogram over");
+    addField("numBuckets", &HistogramConfig::numBuckets,
+             "Number of buckets in the histogram", 20);
+    addField("quantile", &HistogramConfig::quantile,
+             "If true, bucket boundaries follow the value distribution "
+             "(quantile-width buckets) instead of being equally spaced "
+             "over the column's range", false);
+}
+
+
+/*****************************************************************************/
+/* HISTOGRAM DATASET                                                         */
+/*****************************************************************************/
+
+namespace {
+
+/** Count bucket occurrences in parallel, one count array per worker
+    chunk, merged at the end.  getBucket returns the bucket of the
+    value at the given index, or -1 to skip it.
+*/
+template<typename GetBucket>
+std::vector<uint64_t>
+countBuckets(size_t numValues, size_t numBuckets, const GetBucket & getBucket)
+{
+    constexpr size_t valuesPerChunk = 65536;
+    size_t numChunks = (numValues + valuesPerChunk - 1) / valuesPerChunk;
+
+    std::vector<std::vector<uint64_t> > chunkCounts
+        (numChunks, std::vector<uint64_t>(numBuckets));
+
+    auto doChunk = [&] (size_t i)
+        {
+            std::vector<uint64_t> & counts = chunkCounts[i];
+            size_t end = std::min(numValues, (i + 1) * valuesPerChunk);
+            for (size_t j = i * valuesPerChunk;  j < end;  ++j) {
+                int bucket = getBucket(j);
+                if (bucket >= 0)
+                    ++counts[bucket];
+            }
+        };
+
+    parallelMap(0, numChunks, doChunk);
+
+    std::vector<uint64_t> result(numBuckets);
+    for (auto & c: chunkCounts)
+        for (size_t b = 0;  b < numBuckets;  ++b)
+            result[b] += c[b];
+
+    return result;
+}
+
+} // file scope
+
+std::shared_ptr<Dataset>
+createHistogramDataset(MldbServer * server,
+                       std::shared_ptr<Dataset> dataset,
+                       const ExpressionValue & options)
+{
+    HistogramConfig config
+        = jsonDecode<HistogramConfig>(options.extractJson());
+
+    if (config.column.empty())
+        throw HttpReturnException(400, "The 'histogram' function requires "
+                                  "a 'column' parameter naming the column "
+                                  "to compute the histogram over");
+    if (config.numBuckets <= 0)
+        throw HttpReturnException(400, "The 'histogram' function requires "
+                                  "a positive number of buckets",
+                                  "numBuckets", config.numBuckets);
+
+    ColumnName columnName(config.column);
+
+    std::vector<CellValue> lowerBounds, upperBounds;
+    std::vector<uint64_t> counts;
+
+    if (config.quantile) {
+        // Bucket boundaries from the value distribution, as training
+        // does.  The per-row bucket assignment is cached against the
+        // dataset version, so repeated histograms over an unchanged
+        // dataset skip straight to the counting pass.
+        BucketList buckets;
+        BucketDescriptions descriptions;
+        std::tie(buckets, descriptions)
+            = dataset->getColumnBucketsCached(columnName, config.numBuckets);
+
+        const NumericValues & numeric = descriptions.numeric;
+        if (!numeric.active)
+            throw HttpReturnException(400, "The 'histogram' function "
+                                      "requires a numeric column",
+                                      "column", config.column);
+
+        auto allCounts = countBuckets
+            (buckets.numEntries, descriptions.numBuckets(),
+             [&] (size_t i) -> int { return buckets[i]; });
+
+        ColumnSummaryStats stats
+            = dataset->getColumnSummaryStats(columnName);
+
+        // Relative bucket r covers (splits[r-1], splits[r]]; the open
+        // ends take the column's observed min and max
+        for (size_t r = 0;  r < numeric.numBuckets();  ++r) {
+            lowerBounds.push_back(r == 0
+                                  ? stats.minValue
+                                  : CellValue(numeric.splits[r - 1]));
+            upperBounds.push_back(r < numeric.splits.size()
+                                  ? CellValue(numeric.splits[r])
+                                  : stats.maxValue);
+            counts.push_back(allCounts[numeric.offset + r]);
+        }
+    }
+    else {
+        // Equi-width buckets over the column's range.  The range comes
+        // from the summary statistics, which datasets with freeze-time
+        // metadata answer without a range-finding pass.
+        ColumnSummaryStats stats
+            = dataset->getColumnSummaryStats(columnName);
+
+        if (!stats.minValue.isNumber() || !stats.maxValue.isNumber())
+            throw HttpReturnException(400, "The 'histogram' function "
+                                      "requires a numeric column",
+                                      "column", config.column);
+
+        double lo = stats.minValue.toDouble();
+        double hi = stats.maxValue.toDouble();
+        int nb = config.numBuckets;
+        double width = (hi - lo) / nb;
+
+        std::vector<CellValue> vals
+            = dataset->getColumnIndex()->getColumnDense(columnName);
+
+        std::vector<uint64_t> bucketCounts;
+        if (width > 0) {
+            bucketCounts = countBuckets
+                (vals.size(), nb,
+                 [&] (size_t i) -> int
+                 {
+                     const CellValue & v = vals[i];
+                     if (!v.isNumber())
+                         return -1;
+                     int b = (v.toDouble() - lo) / width;
+                     // The maximum value lands in the last bucket
+                     return std::max(0, std::min(nb - 1, b));
+                 });
+        }
+        else {
+            // Degenerate range; everything in the first bucket
+            bucketCounts.resize(nb);
+            for (auto & v: vals)
+                bucketCounts[0] += v.isNumber();
+        }
+
+        for (int b = 0;  b < nb;  ++b) {
+            lowerBounds.push_back(CellValue(lo + b * width));
+            upperBounds.push_back(CellValue(b == nb - 1
+                                            ? hi
+                                            : lo + (b + 1) * width));
+            counts.push_back(bucketCounts[b]);
+        }
+    }
+
+    Date ts = Date::now();
+
+    std::vector<MatrixNamedRow> rows;
+    rows.reserve(counts.size());
+    for (size_t b = 0;  b < counts.size();  ++b) {
+        MatrixNamedRow row;
+        row.rowName = RowName(ML::format("%06zd", b));
+        row.rowHash = row.rowName;
+        row.columns.emplace_back(ColumnName("lowerBound"),
+                                 lowerBounds[b], ts);
+        row.columns.emplace_back(ColumnName("upperBound"),
+                                 upperBounds[b], ts);
+        row.columns.emplace_back(ColumnName("count"),
+                                 (uint64_t)counts[b], ts);
+        rows.emplace_back(std::move(row));
+    }
+
+    return std::make_shared<SubDataset>(server, std::move(rows));
+}
+
+extern std::shared_ptr<Dataset>
+(*createHistogramDatasetFn) (MldbServer *,
+                             std::shared_ptr<Dataset> dataset,
+                             const ExpressionValue & options);
+
+namespace {
+struct AtInit {
+    AtInit()
+    {
+        createHistogramDatasetFn = createHistogramDataset;
+    }
+} atInit;
+}
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -0,0 +1,236 @@
+/** reservoir_dataset.cc                                           -*- C++ -*-
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Implementation of the reservoir() and stratified_sample() table
+    functions.  Draws a bounded-size uniform sample (per stratum for
+    the stratified form) in one parallel pass: every row gets a random
+    key, each worker keeps the rows with the smallest keys in its
+    chunk, and the per-worker reservoirs merge by keeping the overall
+    smallest keys.  Keeping the k smallest of independent uniform keys
+    is a uniform sample without replacement of the whole stream, so
+    the merge loses nothing and memory stays bounded by the sample
+    size per worker, however large the dataset.
+*/
+
+#include "mldb/sql/sql_expression.h"
+#include "sub_dataset.h"
+#include "mldb/core/dataset.h"
+#include "mldb/base/parallel.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/types/structure_description.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/http/http_exception.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* RESERVOIR CONFIG                                                          */
+/*****************************************************************************/
+
+struct ReservoirConfig {
+    ReservoirConfig()
+        : rows(1000)
+    {
+        std::random_device rd;
+        seed = rd();
+    }
+
+    int64_t rows;   ///< Sample size; per stratum for stratified_sample
+    int seed;       ///< Seed for reproducible samples
+    Utf8String by;  ///< Column whose values define the strata
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(ReservoirConfig);
+
+DEFINE_STRUCTURE_DESCRIPTION(ReservoirConfig);
+
+ReservoirConfigDescription::
+ReservoirConfigDescription()
+{
+    addField("rows", &ReservoirConfig::rows,
+             "Number of rows to sample.  For `stratified_sample` this "
+             "many rows are sampled from each stratum.  Strata (or the "
+             "dataset) with fewer rows than this are returned whole.",
+             (int64_t)1000);
+    addField("seed", &ReservoirConfig::seed,
+             "Seed for the random generator, so that a sample can be "
+             "reproduced.  A random seed is used when not provided.");
+    addField("by", &ReservoirConfig::by,
+             "Column whose values define the strata; required for "
+             "`stratified_sample` and not accepted by `reservoir`.");
+}
+
+
+/*****************************************************************************/
+/* RESERVOIR DATASET                                                         */
+/*****************************************************************************/
+
+namespace {
+
+/** Bounded set of the rows with the smallest random keys seen so far,
+    kept as a max-heap on the key so the current worst is evicted in
+    constant space.
+*/
+struct Reservoir {
+    std::vector<std::pair<uint64_t, RowName> > entries;
+
+    static bool keyLess(const std::pair<uint64_t, RowName> & e1,
+                        const std::pair<uint64_t, RowName> & e2)
+    {
+        return e1.first < e2.first;
+    }
+
+    void add(uint64_t key, const RowName & row, size_t capacity)
+    {
+        if (entries.size() < capacity) {
+            entries.emplace_back(key, row);
+            std::push_heap(entries.begin(), entries.end(), keyLess);
+        }
+        else if (key < entries.front().first) {
+            std::pop_heap(entries.begin(), entries.end(), keyLess);
+            entries.back() = std::make_pair(key, row);
+            std::push_heap(entries.begin(), entries.end(), keyLess);
+        }
+    }
+
+    void merge(const Reservoir & other, size_t capacity)
+    {
+        for (auto & e: other.entries)
+            add(e.first, e.second, capacity);
+    }
+};
+
+/// Rows scanned by one worker before its reservoir is merged
+constexpr size_t ROWS_PER_CHUNK = 65536;
+
+/// Decorrelates the per-chunk generators derived from the user's seed
+constexpr uint64_t CHUNK_SEED_MIX = 0x9E3779B97F4A7C15ULL;
+
+} // file scope
+
+std::shared_ptr<Dataset>
+createReservoirDataset(MldbServer * server,
+                       std::shared_ptr<Dataset> dataset,
+                       const ExpressionValue & options,
+                       bool stratified)
+{
+    ReservoirConfig config
+        = jsonDecode<ReservoirConfig>(options.extractJson());
+
+    const char * name = stratified ? "stratified_sample" : "reservoir";
+
+    if (config.rows <= 0)
+        throw HttpReturnException(400, Utf8String("The '") + name
+                                  + "' function requires a positive "
+                                  "number of rows",
+                                  "rows", config.rows);
+    if (stratified && config.by.empty())
+        throw HttpReturnException(400, "The 'stratified_sample' function "
+                                  "requires a 'by' parameter naming the "
+                                  "column whose values define the strata");
+    if (!stratified && !config.by.empty())
+        throw HttpReturnException(400, "The 'reservoir' function doesn't "
+                                  "accept a 'by' parameter; use "
+                                  "'stratified_sample' to sample per "
+                                  "stratum");
+
+    size_t capacity = config.rows;
+    auto matrix = dataset->getMatrixView();
+
+    // One reservoir for the uniform sample; one per stratum value for
+    // the stratified one
+    std::map<CellValue, Reservoir> merged;
+
+    if (stratified) {
+        // The stratum of each row comes from the column itself, so the
+        // scan walks the column's (row, value) entries
+        MatrixColumn column
+            = dataset->getColumnIndex()->getColumn(ColumnName(config.by));
+
+        size_t numEntries = column.rows.size();
+        size_t numChunks = (numEntries + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK;
+
+        std::vector<std::map<CellValue, Reservoir> > chunkReservoirs(numChunks);
+
+        auto doChunk = [&] (size_t i)
+            {
+                std::mt19937_64 rng(config.seed + i * CHUNK_SEED_MIX);
+                auto & reservoirs = chunkReservoirs[i];
+                size_t end = std::min(numEntries, (i + 1) * ROWS_PER_CHUNK);
+                for (size_t j = i * ROWS_PER_CHUNK;  j < end;  ++j) {
+                    auto & entry = column.rows[j];
+                    reservoirs[std::get<1>(entry)]
+                        .add(rng(), std::get<0>(entry), capacity);
+                }
+            };
+
+        parallelMap(0, numChunks, doChunk);
+
+        for (auto & reservoirs: chunkReservoirs)
+            for (auto & r: reservoirs)
+                merged[r.first].merge(r.second, capacity);
+    }
+    else {
+        size_t numRows = matrix->getRowCount();
+        size_t numChunks = (numRows + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK;
+
+        std::vector<Reservoir> chunkReservoirs(numChunks);
+
+        auto doChunk = [&] (size_t i)
+            {
+                std::mt19937_64 rng(config.seed + i * CHUNK_SEED_MIX);
+                Reservoir & reservoir = chunkReservoirs[i];
+                size_t start = i * ROWS_PER_CHUNK;
+                size_t limit = std::min(ROWS_PER_CHUNK, numRows - start);
+                for (auto & rowName: matrix->getRowNames(start, limit))
+                    reservoir.add(rng(), rowName, capacity);
+            };
+
+        parallelMap(0, numChunks, doChunk);
+
+        for (auto & r: chunkReservoirs)
+            merged[CellValue()].merge(r, capacity);
+    }
+
+    // Materialize the sampled rows, in row name order so that the
+    // result is deterministic for a given seed
+    std::vector<RowName> sampled;
+    for (auto & r: merged)
+        for (auto & e: r.second.entries)
+            sampled.emplace_back(std::move(e.second));
+    std::sort(sampled.begin(), sampled.end());
+
+    std::vector<MatrixNamedRow> rows;
+    rows.reserve(sampled.size());
+    for (auto & rowName: sampled)
+        rows.emplace_back(matrix->getRow(rowName));
+
+    return std::make_shared<SubDataset>(server, std::move(rows));
+}
+
+extern std::shared_ptr<Dataset>
+(*createReservoirDatasetFn) (MldbServer *,
+                             std::shared_ptr<Dataset> dataset,
+                             const ExpressionValue & options,
+                             bool stratified);
+
+namespace {
+struct AtInit {
+    AtInit()
+    {
+        createReservoirDatasetFn = createReservoirDataset;
+    }
+} atInit;
+}
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -115,13 +115,12 @@ struct SampledDataset::Itl
           index(dataset->getColumnIndex()),
           columnCount(matrix->getColumnNames().size())
     {
-        // get all existing rows
-        auto rows = matrix->getRowHashes();
+        size_t totalRows = matrix->getRowCount();
 
         unsigned numRows = config.rows != 0 ? config.rows
-                                            : rows.size() * config.fraction;
+                                            : totalRows * config.fraction;
 
-        if(!config.withReplacement && numRows > rows.size()) {
+        if(!config.withReplacement && numRows > totalRows) {
             throw ML::Exception("Requested more rows without replacement than "
                     "available number of rows in original dataset.");
         }
@@ -130,6 +129,53 @@ struct SampledDataset::Itl
 
         // do the sampling
         std::mt19937 gen(config.seed);
+
+        auto stream = totalRows > 0 ? dataset->getRowStream() : nullptr;
+        if (stream) {
+            // Draw the row indexes up front, then fetch the names in a
+            // single strided pass over the row stream, skipping the rows
+            // in between.  This avoids materializing the hash of every
+            // row of the input and the per-sample name lookups of the
+            // fallback below, so sampling stays cheap on large inputs.
+            std::uniform_int_distribution<size_t> dis(0, totalRows - 1);
+
+            std::vector<size_t> sampledIndexes;
+            sampledIndexes.reserve(numRows);
+            if(config.withReplacement) {
+                for(unsigned i = 0; i < numRows; i++)
+                    sampledIndexes.emplace_back(dis(gen));
+            }
+            else {
+                unordered_set<size_t> seenIndexes;
+                while(seenIndexes.size() < numRows)
+                    seenIndexes.insert(dis(gen));
+                sampledIndexes.insert(sampledIndexes.end(),
+                                      seenIndexes.begin(), seenIndexes.end());
+            }
+            std::sort(sampledIndexes.begin(), sampledIndexes.end());
+
+            stream->initAt(0);
+            size_t position = 0;
+            RowName rowName;
+            for(size_t sample_index: sampledIndexes) {
+                if(sampledRows.empty() || sample_index + 1 != position) {
+                    stream->advanceBy(sample_index - position);
+                    rowName = stream->next();
+                    position = sample_index + 1;
+                }
+                // else: repeated draw when sampling with replacement;
+                // reuse the name we just read
+
+                sampledRowsHash.emplace_back(rowName);
+                sampledRows.emplace_back(rowName);
+                sampledRowsIndex.insert(rowName);
+            }
+            return;
+        }
+
+        // get all existing rows
+        auto rows = matrix->getRowHashes();
+
         std::uniform_int_distribution<> dis(0, rows.size() - 1);
 
         unordered_set<unsigned> sampledIndexes;
@@ -153,6 +199,33 @@ struct SampledDataset::Itl
         }
     }
 
+    struct SampledRowStream : public RowStream {
+
+        SampledRowStream(const Itl * source) : source(source)
+        {
+        }
+
+        virtual std::shared_ptr<RowStream> clone() const{
+            auto ptr = std::make_shared<SampledRowStream>(source);
+            return ptr;
+        }
+
+        virtual void initAt(size_t start){
+            iter = source->sampledRows.begin() + start;
+        }
+
+        virtual RowName next() {
+            return *iter++;
+        }
+
+        virtual void advanceBy(size_t n) {
+            iter += n;
+        }
+
+        std::vector<RowName>::const_iterator iter;
+        const Itl * source;
+    };
+
     virtual RowName getRowName(const RowHash & row) const
     {
         auto rowName = matrix->getRowName(row);
@@ -348,6 +421,13 @@ getColumnIndex() const
     return itl;
 }
 
+std::shared_ptr<RowStream>
+SampledDataset::
+getRowStream() const
+{
+    return std::make_shared<Itl::SampledRowStream>(itl.get());
+}
+
 std::string
 SampledDataset::
 getErrorMsg(const std::string msg)
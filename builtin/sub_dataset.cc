@@ -131,6 +131,10 @@ struct SubDataset::Itl
             return (iter++)->rowName;
         }
 
+        virtual void advanceBy(size_t n) {
+            iter += n;
+        }
+
         std::vector<MatrixNamedRow>::const_iterator iter;
         SubDataset::Itl* source;
     };
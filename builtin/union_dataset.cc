@@ -0,0 +1,597 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/** union_dataset.cc                                               -*- C++ -*-
+
+    Implementation of the union dataset, which concatenates the rows of
+    several sub-datasets.  Unlike the merged dataset, no attempt is made
+    to combine rows between sub-datasets: each sub-dataset keeps its rows
+    intact, with the sub-dataset's index prefixed to the row name.  This
+    makes the union ideal for time-sharded data (eg one tabular dataset
+    per month queried as a whole): scans fan out over the sub-datasets in
+    parallel, and predicates are pushed down so that each shard applies
+    its own indexes and zone maps.
+*/
+
+#include "union_dataset.h"
+#include "mldb/sql/sql_expression.h"
+#include "mldb/base/parallel.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/types/structure_description.h"
+#include "mldb/types/vector_description.h"
+#include <unordered_map>
+
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* UNION DATASET CONFIG                                                      */
+/*****************************************************************************/
+
+DEFINE_STRUCTURE_DESCRIPTION(UnionDatasetConfig);
+
+UnionDatasetConfigDescription::
+UnionDatasetConfigDescription()
+{
+    nullAccepted = true;
+
+    addField("datasets", &UnionDatasetConfig::datasets,
+             "Datasets to concatenate together");
+}
+
+
+/*****************************************************************************/
+/* UNION INTERNAL REPRESENTATION                                             */
+/*****************************************************************************/
+
+struct UnionDataset::Itl
+    : public MatrixView, public ColumnIndex {
+
+    /// Datasets that make up the union, in order
+    std::vector<std::shared_ptr<Dataset> > datasets;
+
+    /// Matrix view of each of them.  Length is the same as that of datasets.
+    std::vector<std::shared_ptr<MatrixView> > matrices;
+
+    /// Row count of each sub-dataset, snapshotted at construction
+    std::vector<size_t> counts;
+
+    /// Sum of counts
+    size_t totalRows;
+
+    /// Maps the hash of a (prefixed) row name to the index of the
+    /// sub-dataset that holds it and the hash of the row within it
+    std::unordered_map<uint64_t, std::pair<int, RowHash> > rowIndex;
+
+    /// Maps a column hash to the indexes of the sub-datasets that
+    /// contain the column, in order
+    std::unordered_map<uint64_t, std::vector<int> > columnIndex;
+
+    /// Distinct column names, in order of first appearance
+    std::vector<ColumnName> columnNames;
+
+    /// True iff every sub-dataset provides a row stream
+    bool hasRowStreams;
+
+    Itl(MldbServer * server, std::vector<std::shared_ptr<Dataset> > datasets)
+    {
+        if (datasets.empty())
+            throw ML::Exception("Attempt to unify no datasets together");
+
+        this->datasets = std::move(datasets);
+
+        counts.resize(this->datasets.size());
+        totalRows = 0;
+        hasRowStreams = true;
+
+        for (auto & d: this->datasets) {
+            matrices.emplace_back(d->getMatrixView());
+            if (!d->getRowStream())
+                hasRowStreams = false;
+        }
+
+        // Index the rows of each sub-dataset in parallel; the per-dataset
+        // results are merged serially below so that the index contents
+        // don't depend upon thread timing.
+        std::vector<std::vector<std::pair<uint64_t, RowHash> > >
+            rowEntries(this->datasets.size());
+
+        auto indexDataset = [&] (size_t i)
+            {
+                std::vector<RowName> rows = matrices[i]->getRowNames();
+                counts[i] = rows.size();
+                rowEntries[i].reserve(rows.size());
+                for (auto & r: rows) {
+                    RowHash subHash(r);
+                    RowName prefixed = PathElement(i) + std::move(r);
+                    rowEntries[i].emplace_back(prefixed.hash(), subHash);
+                }
+            };
+
+        parallelMap(0, this->datasets.size(), indexDataset);
+
+        for (size_t i = 0;  i < rowEntries.size();  ++i) {
+            totalRows += counts[i];
+            for (auto & e: rowEntries[i])
+                rowIndex[e.first] = make_pair(i, e.second);
+        }
+
+        for (size_t i = 0;  i < matrices.size();  ++i) {
+            for (auto & c: matrices[i]->getColumnNames()) {
+                auto & entry = columnIndex[c.hash()];
+                if (entry.empty())
+                    columnNames.push_back(c);
+                entry.push_back(i);
+            }
+        }
+    }
+
+    /** Split a union row name into (sub-dataset index, row name within
+        the sub-dataset).  Returns -1 for the index if the name cannot
+        name a row of the union.
+    */
+    std::pair<int, RowName> decomposeName(const RowName & rowName) const
+    {
+        if (rowName.size() < 2)
+            return { -1, RowName() };
+        ssize_t index = rowName[0].toIndex();
+        if (index < 0 || index >= (ssize_t)datasets.size())
+            return { -1, RowName() };
+        return { (int)index, rowName.removePrefix() };
+    }
+
+    struct UnionRowStream : public RowStream {
+
+        UnionRowStream(const UnionDataset::Itl* source)
+            : source(source), dataset(0), rowsLeftInDataset(0)
+        {
+        }
+
+        virtual std::shared_ptr<RowStream> clone() const
+        {
+            return make_shared<UnionRowStream>(source);
+        }
+
+        /* set where the stream should start*/
+        virtual void initAt(size_t start)
+        {
+            dataset = 0;
+            while (dataset < source->counts.size()
+                   && start >= source->counts[dataset]) {
+                start -= source->counts[dataset];
+                ++dataset;
+            }
+            rowsLeftInDataset = 0;
+            if (dataset < source->counts.size()) {
+                subStream = source->datasets[dataset]->getRowStream();
+                subStream->initAt(start);
+                rowsLeftInDataset = source->counts[dataset] - start;
+            }
+        }
+
+        virtual RowName next()
+        {
+            while (rowsLeftInDataset == 0)
+                enterNextDataset();
+
+            --rowsLeftInDataset;
+            return PathElement(dataset) + subStream->next();
+        }
+
+        virtual void advanceBy(size_t n)
+        {
+            while (n > 0) {
+                if (rowsLeftInDataset == 0) {
+                    enterNextDataset();
+                    continue;
+                }
+                size_t toSkip = std::min(n, rowsLeftInDataset);
+                subStream->advanceBy(toSkip);
+                rowsLeftInDataset -= toSkip;
+                n -= toSkip;
+            }
+        }
+
+        void enterNextDataset()
+        {
+            ++dataset;
+            subStream = source->datasets.at(dataset)->getRowStream();
+            subStream->initAt(0);
+            rowsLeftInDataset = source->counts[dataset];
+        }
+
+        const UnionDataset::Itl* source;
+        size_t dataset;
+        std::shared_ptr<RowStream> subStream;
+        size_t rowsLeftInDataset;
+    };
+
+    virtual std::vector<RowName>
+    getRowNames(ssize_t start = 0, ssize_t limit = -1) const
+    {
+        std::vector<RowName> result;
+
+        ssize_t remaining = (limit == -1 ? (ssize_t)totalRows : limit);
+
+        for (size_t i = 0;  i < matrices.size() && remaining > 0;  ++i) {
+            if (start >= (ssize_t)counts[i]) {
+                start -= counts[i];
+                continue;
+            }
+
+            auto sub = matrices[i]->getRowNames(start, remaining);
+            start = 0;
+            remaining -= sub.size();
+
+            for (auto & r: sub)
+                result.emplace_back(PathElement(i) + std::move(r));
+        }
+
+        return result;
+    }
+
+    virtual std::vector<RowHash>
+    getRowHashes(ssize_t start = 0, ssize_t limit = -1) const
+    {
+        std::vector<RowHash> result;
+
+        for (auto & r: getRowNames(start, limit))
+            result.emplace_back(r);
+
+        return result;
+    }
+
+    virtual bool knownRow(const RowName & rowName) const
+    {
+        auto decomposed = decomposeName(rowName);
+        if (decomposed.first == -1)
+            return false;
+        return matrices[decomposed.first]->knownRow(decomposed.second);
+    }
+
+    virtual RowName getRowName(const RowHash & rowHash) const
+    {
+        auto it = rowIndex.find(rowHash.hash());
+        if (it == rowIndex.end())
+            throw ML::Exception("Row not known");
+
+        int index = it->second.first;
+        return PathElement(index)
+            + matrices[index]->getRowName(it->second.second);
+    }
+
+    virtual MatrixNamedRow getRow(const RowName & rowName) const
+    {
+        auto decomposed = decomposeName(rowName);
+        if (decomposed.first == -1)
+            throw ML::Exception("Row not known");
+
+        MatrixNamedRow result
+            = matrices[decomposed.first]->getRow(decomposed.second);
+        result.rowName = rowName;
+        result.rowHash = rowName;
+        return result;
+    }
+
+    virtual bool knownColumn(const ColumnName & column) const
+    {
+        return columnIndex.count(column.hash());
+    }
+
+    virtual ColumnName getColumnName(ColumnHash columnHash) const
+    {
+        auto it = columnIndex.find(columnHash.hash());
+        if (it == columnIndex.end())
+            throw ML::Exception("Column not found in union dataset");
+
+        return matrices[it->second.front()]->getColumnName(columnHash);
+    }
+
+    /** Return a list of all columns. */
+    virtual std::vector<ColumnName> getColumnNames() const
+    {
+        return columnNames;
+    }
+
+    /** Return the value of the column for all rows and timestamps. */
+    virtual MatrixColumn getColumn(const ColumnName & columnName) const
+    {
+        auto it = columnIndex.find(columnName.hash());
+        if (it == columnIndex.end())
+            throw ML::Exception("Column not known");
+
+        MatrixColumn result;
+        result.columnName = columnName;
+        result.columnHash = columnName;
+
+        for (int index: it->second) {
+            auto sub = datasets[index]->getColumnIndex()->getColumn(columnName);
+            for (auto & r: sub.rows) {
+                RowName prefixed
+                    = PathElement(index) + std::move(std::get<0>(r));
+                result.rows.emplace_back(std::move(prefixed),
+                                         std::move(std::get<1>(r)),
+                                         std::get<2>(r));
+            }
+        }
+
+        return result;
+    }
+
+    /** Return the value of the column for all rows, ignoring timestamps. */
+    virtual std::vector<std::tuple<RowName, CellValue> >
+    getColumnValues(const ColumnName & columnName,
+                    const std::function<bool (const CellValue &)> & filter) const
+    {
+        std::vector<std::tuple<RowName, CellValue> > result;
+
+        auto it = columnIndex.find(columnName.hash());
+        if (it == columnIndex.end())
+            return result;
+
+        for (int index: it->second) {
+            auto sub = datasets[index]->getColumnIndex()
+                ->getColumnValues(columnName, filter);
+            for (auto & r: sub) {
+                RowName prefixed
+                    = PathElement(index) + std::move(std::get<0>(r));
+                result.emplace_back(std::move(prefixed),
+                                    std::move(std::get<1>(r)));
+            }
+        }
+
+        return result;
+    }
+
+    virtual size_t getRowCount() const
+    {
+        return totalRows;
+    }
+
+    virtual size_t getColumnCount() const
+    {
+        return columnNames.size();
+    }
+
+    std::pair<Date, Date> getTimestampRange() const
+    {
+        std::pair<Date, Date> result(Date::notADate(), Date::notADate());
+        bool first = true;
+
+        for (auto & d: datasets) {
+            std::pair<Date, Date> dsRange = d->getTimestampRange();
+            if (!dsRange.first.isADate()
+                || !dsRange.second.isADate())
+                continue;
+            if (first) {
+                result = dsRange;
+                first = false;
+            }
+            else {
+                result.first.setMin(dsRange.first);
+                result.second.setMax(dsRange.second);
+            }
+        }
+
+        return result;
+    }
+
+    GenerateRowsWhereFunction
+    generateRowsWhere(const SqlBindingScope & context,
+                      const Utf8String& alias,
+                      const SqlExpression & where,
+                      ssize_t offset,
+                      ssize_t limit) const
+    {
+        // The offset and limit are applied by the caller, so we only
+        // handle the unrestricted case.
+        if (offset != 0 || limit != -1)
+            return GenerateRowsWhereFunction();
+
+        // A constant WHERE is better served by the default
+        // implementation, which exposes a row stream that the executor
+        // can chunk over (and our row stream already fans out over the
+        // sub-datasets).
+        if (where.isConstant())
+            return GenerateRowsWhereFunction();
+
+        // Functions such as rowName() or rowHash() would see the
+        // unprefixed names if evaluated inside the sub-datasets, and a
+        // wildcard needs a row scope; in either case fall back to the
+        // default table scan.
+        UnboundEntities unbound = where.getUnbound();
+        if (!unbound.funcs.empty()
+            || !unbound.tables.empty()
+            || !unbound.wildcards.empty())
+            return GenerateRowsWhereFunction();
+
+        // A column that exists in some sub-datasets but not others would
+        // evaluate to null in those that lack it, which not all
+        // predicates treat as false (eg IS NULL); only push down when
+        // every referenced column is known everywhere.
+        for (auto & v: unbound.vars) {
+            for (auto & m: matrices) {
+                if (!m->knownColumn(v.first))
+                    return GenerateRowsWhereFunction();
+            }
+        }
+
+        // Push the WHERE down to each sub-dataset.  Each one applies its
+        // own pushdown (indexes, zone maps, ...), so shards whose
+        // metadata excludes the predicate return nothing without
+        // scanning.
+        std::vector<GenerateRowsWhereFunction> subGens;
+        subGens.reserve(datasets.size());
+
+        GenerateRowsWhereFunction::Complexity complexity
+            = GenerateRowsWhereFunction::CONSTANT;
+
+        for (auto & d: datasets) {
+            subGens.emplace_back
+                (d->generateRowsWhere(context, alias, where, 0, -1));
+            complexity = std::max(complexity, subGens.back().complexity);
+        }
+
+        auto exec = [=] (ssize_t numToGenerate, Any token,
+                         const BoundParameters & params)
+            -> std::pair<std::vector<RowName>, Any>
+            {
+                std::vector<std::vector<RowName> > parts(subGens.size());
+
+                auto doDataset = [&] (size_t i)
+                    {
+                        auto sub = subGens[i](-1, Any(), params);
+                        parts[i].reserve(sub.first.size());
+                        for (auto & r: sub.first)
+                            parts[i].emplace_back
+                                (PathElement(i) + std::move(r));
+                    };
+
+                parallelMap(0, subGens.size(), doDataset);
+
+                size_t total = 0;
+                for (auto & p: parts)
+                    total += p.size();
+
+                std::vector<RowName> rows;
+                rows.reserve(total);
+                for (auto & p: parts)
+                    rows.insert(rows.end(),
+                                std::make_move_iterator(p.begin()),
+                                std::make_move_iterator(p.end()));
+
+                return { std::move(rows), Any() };
+            };
+
+        return GenerateRowsWhereFunction
+            (exec,
+             "union dataset parallel per-sub-dataset generation",
+             complexity);
+    }
+};
+
+
+/*****************************************************************************/
+/* UNION DATASET                                                             */
+/*****************************************************************************/
+
+UnionDataset::
+UnionDataset(MldbServer * owner,
+             PolyConfig config,
+             const std::function<bool (const Json::Value &)> & onProgress)
+    : Dataset(owner)
+{
+    auto unionConfig = config.params.convert<UnionDatasetConfig>();
+
+    std::vector<std::shared_ptr<Dataset> > datasets;
+
+    for (auto & d: unionConfig.datasets) {
+        datasets.emplace_back(obtainDataset(owner, d, onProgress));
+    }
+
+    itl.reset(new Itl(server, datasets));
+}
+
+UnionDataset::
+UnionDataset(MldbServer * owner,
+             std::vector<std::shared_ptr<Dataset> > datasetsToUnion)
+    : Dataset(owner)
+{
+    itl.reset(new Itl(server, datasetsToUnion));
+}
+
+UnionDataset::
+~UnionDataset()
+{
+}
+
+Any
+UnionDataset::
+getStatus() const
+{
+    std::vector<Any> result;
+    for (auto & d: itl->datasets)
+        result.emplace_back(d->getStatus());
+    return result;
+}
+
+std::pair<Date, Date>
+UnionDataset::
+getTimestampRange() const
+{
+    return itl->getTimestampRange();
+}
+
+std::shared_ptr<MatrixView>
+UnionDataset::
+getMatrixView() const
+{
+    return itl;
+}
+
+std::shared_ptr<ColumnIndex>
+UnionDataset::
+getColumnIndex() const
+{
+    return itl;
+}
+
+std::shared_ptr<RowStream>
+UnionDataset::
+getRowStream() const
+{
+    if (!itl->hasRowStreams)
+        return nullptr;
+    return make_shared<UnionDataset::Itl::UnionRowStream>(itl.get());
+}
+
+uint64_t
+UnionDataset::
+getRowCountEstimate() const
+{
+    return itl->totalRows;
+}
+
+GenerateRowsWhereFunction
+UnionDataset::
+generateRowsWhere(const SqlBindingScope & context,
+                  const Utf8String& alias,
+                  const SqlExpression & where,
+                  ssize_t offset,
+                  ssize_t limit) const
+{
+    GenerateRowsWhereFunction fn
+        = itl->generateRowsWhere(context, alias, where, offset, limit);
+    if (!fn)
+        fn = Dataset::generateRowsWhere(context, alias, where, offset, limit);
+    return fn;
+}
+
+static RegisterDatasetType<UnionDataset, UnionDatasetConfig>
+regUnion(builtinPackage(),
+         "union",
+         "Concatenates the rows of several datasets into one virtual dataset",
+         "datasets/UnionDataset.md.html");
+
+extern std::shared_ptr<Dataset> (*createUnionDatasetFn) (MldbServer *, std::vector<std::shared_ptr<Dataset> > datasets);
+
+std::shared_ptr<Dataset> createUnionDataset(MldbServer * server, std::vector<std::shared_ptr<Dataset> > datasets)
+{
+    return std::make_shared<UnionDataset>(server, datasets);
+}
+
+namespace {
+struct AtInit {
+    AtInit()
+    {
+        createUnionDatasetFn = createUnionDataset;
+    }
+} atInit;
+}
+
+} // namespace MLDB
+} // namespace Datacratic
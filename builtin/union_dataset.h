@@ -0,0 +1,81 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/** union_dataset.h                                                -*- C++ -*-
+
+    Dataset that is the row-wise concatenation of multiple underlying
+    datasets.  Each row of each sub-dataset appears exactly once, with its
+    name prefixed by the index of the sub-dataset, so rows with the same
+    name in two sub-datasets stay distinct (in contrast with the merged
+    dataset, which combines them into a single row).
+*/
+
+#pragma once
+
+#include "mldb/core/dataset.h"
+#include "mldb/types/value_description.h"
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* UNION DATASET CONFIG                                                      */
+/*****************************************************************************/
+
+struct UnionDatasetConfig {
+    std::vector<PolyConfigT<const Dataset> > datasets;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(UnionDatasetConfig);
+
+
+/*****************************************************************************/
+/* UNION DATASET                                                             */
+/*****************************************************************************/
+
+struct UnionDataset: public Dataset {
+
+    UnionDataset(MldbServer * owner,
+                 PolyConfig config,
+                 const std::function<bool (const Json::Value &)> & onProgress);
+
+    /** Constructor used internally when creating a union from a function */
+    UnionDataset(MldbServer * owner,
+                 std::vector<std::shared_ptr<Dataset> > datasetsToUnion);
+
+    virtual ~UnionDataset();
+
+    virtual Any getStatus() const;
+    virtual void recordRowItl(const RowName & rowName,
+          const std::vector<std::tuple<ColumnName, CellValue, Date> > & vals)
+    {
+        throw ML::Exception("Dataset type doesn't allow recording");
+    }
+
+    virtual std::shared_ptr<MatrixView> getMatrixView() const;
+    virtual std::shared_ptr<ColumnIndex> getColumnIndex() const;
+    virtual std::shared_ptr<RowStream> getRowStream() const;
+
+    virtual std::pair<Date, Date> getTimestampRange() const;
+
+    virtual uint64_t getRowCountEstimate() const;
+
+    /** Predicate pushdown: the WHERE clause is pushed down to each
+        sub-dataset, which applies its own indexes and zone maps, and the
+        per-sub-dataset generators are run in parallel.
+    */
+    virtual GenerateRowsWhereFunction
+    generateRowsWhere(const SqlBindingScope & context,
+                      const Utf8String& alias,
+                      const SqlExpression & where,
+                      ssize_t offset,
+                      ssize_t limit) const;
+
+private:
+    UnionDatasetConfig datasetConfig;
+    struct Itl;
+    std::shared_ptr<Itl> itl;
+};
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -12,8 +12,10 @@
 #include "mldb/sql/sql_expression_operations.h"
 #include "mldb/types/tuple_description.h"
 #include "mldb/types/vector_description.h"
+#include "mldb/types/map_description.h"
 #include "mldb/server/analytics.h"
 #include "mldb/sql/sql_expression.h"
+#include "mldb/sql/expression_bytecode.h"
 #include "mldb/sql/sql_utils.h"
 #include "mldb/jml/utils/lightweight_hash.h"
 #include "mldb/jml/utils/profile.h"
@@ -29,6 +31,7 @@
 #include "mldb/rest/rest_request_router.h"
 #include "mldb/types/hash_wrapper_description.h"
 #include <mutex>
+#include <numeric>
 
 
 using namespace std;
@@ -69,11 +72,24 @@ struct SortByRowHash {
 } // file scope
 
 
+/*****************************************************************************/
+/* ROW STREAM                                                                */
+/*****************************************************************************/
+
+void
+RowStream::
+advanceBy(size_t n)
+{
+    while (n--)
+        next();
+}
+
+
 /*****************************************************************************/
 /* DATASET                                                                   */
 /*****************************************************************************/
 
-struct DatasetPolyConfigDescription    
+struct DatasetPolyConfigDescription
     :  public Datacratic::StructureDescription<PolyConfigT<Dataset> > {
     DatasetPolyConfigDescription();
 
@@ -164,6 +180,21 @@ PersistentDatasetConfigDescription()
              "URL of the data file from which to load the dataset.");
 }
 
+DEFINE_STRUCTURE_DESCRIPTION(DatasetMemoryUsage);
+
+DatasetMemoryUsageDescription::
+DatasetMemoryUsageDescription()
+{
+    addField("totalBytes", &DatasetMemoryUsage::totalBytes,
+             "Total number of bytes attributed to the dataset");
+    addField("rowNameBytes", &DatasetMemoryUsage::rowNameBytes,
+             "Bytes held by row names and the row index");
+    addField("indexBytes", &DatasetMemoryUsage::indexBytes,
+             "Bytes held by auxiliary indexes");
+    addField("columnBytes", &DatasetMemoryUsage::columnBytes,
+             "Bytes held per column");
+}
+
 /*****************************************************************************/
 /* MATRIX VIEW                                                               */
 /*****************************************************************************/
@@ -183,6 +214,28 @@ getRowColumnCount(const RowName & row) const
     return cols.size();
 }
 
+MatrixNamedRow
+MatrixView::
+getRowColumns(const RowName & row,
+              const std::vector<ColumnName> & columns) const
+{
+    MatrixNamedRow result = getRow(row);
+
+    std::vector<std::tuple<ColumnName, CellValue, Date> > kept;
+    kept.reserve(columns.size());
+    for (auto & c: result.columns) {
+        for (auto & columnName: columns) {
+            if (std::get<0>(c) == columnName) {
+                kept.emplace_back(std::move(c));
+                break;
+            }
+        }
+    }
+    result.columns = std::move(kept);
+
+    return result;
+}
+
 
 /*****************************************************************************/
 /* COLUMN INDEX                                                              */
@@ -344,10 +397,12 @@ getColumnBuckets(const ColumnName & column,
     // Finally, perform the bucketed lookup
     WritableBucketList buckets(totalRows, descriptions.numBuckets());
 
+    std::vector<uint32_t> assigned;
+    assigned.reserve(vals.size());
     for (auto& v : vals) {
-        uint32_t bucket = values[v];
-        buckets.write(bucket);
+        assigned.push_back(values[v]);
     }
+    buckets.writeBatch(assigned.data(), assigned.size());
 
     return std::make_tuple(std::move(buckets), std::move(descriptions));
 }
@@ -407,9 +462,22 @@ recordRowsExpr(const std::vector<std::pair<RowName, ExpressionValue > > & rows)
 /* DATASET                                                                   */
 /*****************************************************************************/
 
+/** Cache of bucketized columns, so that repeated trainings over an
+    unchanged dataset don't re-run bucketization on the same columns.
+    Entries are keyed on the column and bucket count, and the whole
+    cache is dropped when the dataset version changes (see commit()).
+*/
+struct Dataset::BucketCache {
+    std::mutex lock;
+    uint64_t version = 0;
+    std::map<std::pair<ColumnName, int>,
+             std::shared_ptr<const std::tuple<BucketList,
+                                              BucketDescriptions> > > entries;
+};
+
 Dataset::
 Dataset(MldbServer * server)
-    : server(server)
+    : server(server), version(0), bucketCache(new BucketCache())
 {
 }
 
@@ -609,6 +677,27 @@ recordEmbedding(const std::vector<ColumnName> & columnNames,
     recordRows(rowsOut);
 }
 
+void
+Dataset::
+recordEmbedding(const std::vector<ColumnName> & columnNames,
+                const std::vector<std::pair<RowName, Date> > & rows,
+                const float * coords)
+{
+    size_t numDims = columnNames.size();
+
+    vector<tuple<RowName, vector<float>, Date> > rowsOut;
+    rowsOut.reserve(rows.size());
+
+    for (size_t i = 0;  i < rows.size();  ++i) {
+        rowsOut.emplace_back(rows[i].first,
+                             vector<float>(coords + i * numDims,
+                                           coords + (i + 1) * numDims),
+                             rows[i].second);
+    }
+
+    recordEmbedding(columnNames, rowsOut);
+}
+
 Dataset::MultiChunkRecorder
 Dataset::
 getChunkRecorder()
@@ -645,6 +734,13 @@ getKnownColumnInfos(const std::vector<ColumnName> & columnNames) const
     return result;
 }
 
+bool
+Dataset::
+rowsHaveSingleValuePerColumn() const
+{
+    return false;
+}
+
 std::shared_ptr<RowValueInfo>
 Dataset::
 getRowInfo() const
@@ -667,6 +763,28 @@ getRowExpr(const RowName & row) const
     return std::move(flattened.columns);
 }
 
+std::vector<MatrixNamedRow>
+Dataset::
+getRows(const std::vector<RowName> & rowNames) const
+{
+    auto matrix = getMatrixView();
+
+    std::vector<MatrixNamedRow> result;
+    result.reserve(rowNames.size());
+
+    for (auto & rowName: rowNames) {
+        if (!matrix->knownRow(rowName)) {
+            MatrixNamedRow row;
+            row.rowHash = row.rowName = rowName;
+            result.emplace_back(std::move(row));
+            continue;
+        }
+        result.emplace_back(matrix->getRow(rowName));
+    }
+
+    return result;
+}
+
 std::vector<MatrixNamedRow>
 Dataset::
 queryStructured(const SelectExpression & select,
@@ -1611,6 +1729,10 @@ generateRowsWhere(const SqlBindingScope & scope,
     SqlExpressionDatasetScope dsScope(*this, alias);
     auto whereBound = where.bind(dsScope);
 
+    // Flatten simple scalar predicates into a bytecode program; this is
+    // a no-op for expressions that can't be lowered
+    whereBound = compileExpressionBytecode(whereBound, dsScope);
+
     // Detect if where needs columns or not, by looking at what is unbound
     // in the expression.  For example rowName() or rowHash() don't need
     // the columns at all.
@@ -1644,35 +1766,60 @@ generateRowsWhere(const SqlBindingScope & scope,
 
                 PerThreadAccumulator<std::vector<RowName> > accum;
                 
-                auto onRow = [&] (size_t n)
+                // Filter the rows a chunk at a time through the
+                // selection vector path: the bound where compacts an
+                // index vector over each chunk instead of being called
+                // row by row, and ANDed predicates refine the vector
+                // in turn rather than each seeing every row.
+                constexpr size_t FILTER_CHUNK_ROWS = 1024;
+
+                auto onChunk = [&] (size_t first, size_t last)
                     {
-                        const RowName & r = rows[n];
+                        size_t n = last - first;
+
+                        // Pre-sized so the row scopes' references into
+                        // it stay valid
+                        std::vector<MatrixNamedRow> chunkRows(n);
+                        std::vector<SqlExpressionDatasetScope::RowScope> scopes;
+                        scopes.reserve(n);
+                        std::vector<const SqlRowScope *> scopePtrs(n);
+
+                        for (size_t i = 0;  i < n;  ++i) {
+                            MatrixNamedRow & row = chunkRows[i];
+                            const RowName & r = rows[first + i];
+                            if (needsColumns)
+                                row = std::move(matrix->getRow(r));
+                            else {
+                                row.rowHash = row.rowName = r;
+                            }
 
-                        MatrixNamedRow row;
-                        if (needsColumns)
-                            row = std::move(matrix->getRow(r));
-                        else {
-                            row.rowHash = row.rowName = r;
+                            scopes.emplace_back(dsScope.getRowScope(row, &params));
+                            scopePtrs[i] = &scopes.back();
                         }
 
-                        auto rowScope = dsScope.getRowScope(row, &params);
-                        
-                        bool keep = whereBound(rowScope, GET_LATEST).isTrue();
-                        
-                        if (keep)
-                            accum.get().push_back(r);
+                        std::vector<uint32_t> sel(n);
+                        std::iota(sel.begin(), sel.end(), 0);
+
+                        size_t numKept
+                            = whereBound.filterBatch(scopePtrs.data(),
+                                                     sel.data(), n);
+
+                        auto & kept = accum.get();
+                        for (size_t i = 0;  i < numKept;  ++i)
+                            kept.push_back(rows[first + sel[i]]);
                     };
 
                 bool needSort = false;
                 if (rows.size() >= 1000) {
-                    // Scan the whole lot with the when in parallel
-                    parallelMap(0, rows.size(), onRow);
+                    // Scan the whole lot with the where in parallel
+                    parallelMapChunked(0, rows.size(), FILTER_CHUNK_ROWS,
+                                       onChunk);
                     needSort = true;
                 } else {
                     // Serial, since probably it's not worth the overhead
                     // to run them in parallel.
-                    for (unsigned i = 0;  i < rows.size();  ++i)
-                        onRow(i);
+                    if (!rows.empty())
+                        onChunk(0, rows.size());
                 }
 
                 // Now merge together the results of all the threads
@@ -1994,6 +2141,160 @@ void
 Dataset::
 commit()
 {
+    bumpVersion();
+}
+
+uint64_t
+Dataset::
+getVersion() const
+{
+    return version.load(std::memory_order_acquire);
+}
+
+void
+Dataset::
+bumpVersion()
+{
+    version.fetch_add(1, std::memory_order_acq_rel);
+}
+
+std::tuple<BucketList, BucketDescriptions>
+Dataset::
+getColumnBucketsCached(const ColumnName & column,
+                       int maxNumBuckets) const
+{
+    uint64_t currentVersion = getVersion();
+    std::pair<ColumnName, int> key(column, maxNumBuckets);
+
+    {
+        std::unique_lock<std::mutex> guard(bucketCache->lock);
+        if (bucketCache->version != currentVersion) {
+            // Data has been committed since these entries were made
+            bucketCache->entries.clear();
+            bucketCache->version = currentVersion;
+        }
+        auto it = bucketCache->entries.find(key);
+        if (it != bucketCache->entries.end())
+            return *it->second;
+    }
+
+    auto buckets
+        = std::make_shared<std::tuple<BucketList, BucketDescriptions> >
+        (getColumnIndex()->getColumnBuckets(column, maxNumBuckets));
+
+    {
+        std::unique_lock<std::mutex> guard(bucketCache->lock);
+        // Don't publish buckets that were computed over data which
+        // changed while we were bucketizing it.
+        if (bucketCache->version == currentVersion)
+            bucketCache->entries[key] = buckets;
+    }
+
+    return *buckets;
+}
+
+ColumnSummaryStats
+Dataset::
+getColumnSummaryStats(const ColumnName & column) const
+{
+    ColumnSummaryStats result;
+
+    ML::Lightweight_Hash_Set<uint64_t> distinctValues;
+    ML::Lightweight_Hash_Set<uint64_t> rowsWithValue;
+
+    auto col = getColumnIndex()->getColumn(column);
+
+    for (auto & c: col.rows) {
+        const CellValue & v = std::get<1>(c);
+        if (v.empty())
+            continue;
+        ++result.valueCount;
+        rowsWithValue.insert(RowHash(std::get<0>(c)).hash());
+        distinctValues.insert(v.hash());
+        if (result.minValue.empty() || v < result.minValue)
+            result.minValue = v;
+        if (result.maxValue.empty() || result.maxValue < v)
+            result.maxValue = v;
+    }
+
+    result.nullCount
+        = getMatrixView()->getRowCount() - rowsWithValue.size();
+    result.approxDistinctCount = distinctValues.size();
+
+    return result;
+}
+
+DatasetMemoryUsage
+Dataset::
+getMemoryUsage() const
+{
+    // We don't know anything about how a generic dataset stores its
+    // data, so report nothing rather than a misleading scan-based
+    // estimate.  Dataset types that own their storage override this.
+    return DatasetMemoryUsage();
+}
+
+uint64_t
+Dataset::
+getRowCountEstimate() const
+{
+    return getMatrixView()->getRowCount();
+}
+
+int64_t
+Dataset::
+getColumnCardinalityEstimate(const ColumnName & column) const
+{
+    return -1;  // no estimate without scanning the column
+}
+
+double
+Dataset::
+estimateWhereSelectivity(const SqlExpression & where,
+                         size_t sampleSize) const
+{
+    // Constant clauses don't need a sample
+    if (where.isConstantTrue())
+        return 1.0;
+    if (where.isConstantFalse())
+        return 0.0;
+
+    auto stream = getRowStream();
+    if (!stream)
+        return -1.0;
+
+    auto matrix = getMatrixView();
+    size_t numRows = matrix->getRowCount();
+    if (numRows == 0)
+        return 1.0;
+
+    SqlExpressionDatasetScope scope(*this, "" /* alias */);
+
+    BoundSqlExpression boundWhere;
+    try {
+        boundWhere = where.bind(scope);
+    } JML_CATCH_ALL {
+        // Best effort only: an expression that doesn't bind against
+        // the bare dataset (eg it qualifies columns with a table
+        // alias) simply has no estimate.
+        return -1.0;
+    }
+
+    size_t toSample = std::min(std::max<size_t>(sampleSize, 1), numRows);
+    size_t stride = numRows / toSample;
+
+    size_t numMatched = 0;
+
+    for (size_t i = 0;  i < toSample;  ++i) {
+        stream->initAt(i * stride);
+        RowName rowName = stream->next();
+        auto row = matrix->getRow(rowName);
+        auto rowScope = scope.getRowScope(row);
+        if (boundWhere(rowScope, GET_LATEST).isTrue())
+            ++numMatched;
+    }
+
+    return 1.0 * numMatched / toSample;
 }
 
 BoundFunction
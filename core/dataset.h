@@ -14,6 +14,7 @@
 #include "mldb/sql/cell_value.h"
 #include "mldb/types/url.h"
 #include "mldb/core/recorder.h"
+#include <atomic>
 #include <set>
 
 // NOTE TO MLDB DEVELOPERS: This is an API header file.  No includes
@@ -88,6 +89,18 @@ struct MatrixView {
     
     virtual MatrixNamedRow getRow(const RowName & row) const = 0;
 
+    /** Return only the given columns of a row.  Columns the row doesn't
+        have a value for are simply absent from the result.
+
+        The default materializes the whole row via getRow() and filters
+        it; datasets with columnar storage override it to read just the
+        requested columns, so a point lookup on a row with thousands of
+        columns pays only for the ones the caller touches.
+    */
+    virtual MatrixNamedRow
+    getRowColumns(const RowName & row,
+                  const std::vector<ColumnName> & columns) const;
+
     virtual RowName getRowName(const RowHash & row) const = 0;
 
     //virtual bool knownColumn(ColumnHash column) const = 0;
@@ -145,6 +158,46 @@ struct ColumnStats {
     uint64_t rowCount_;
 };
 
+/** Lightweight per-column summary: enough to render a facet (counts,
+    value range, distinct estimate) without the per-value breakdown of
+    ColumnStats, so that datasets which record statistics at ingestion
+    time can serve it without scanning the column.
+*/
+
+struct ColumnSummaryStats {
+    ColumnSummaryStats()
+        : valueCount(0), nullCount(0), approxDistinctCount(-1)
+    {
+    }
+
+    uint64_t valueCount;          ///< Number of non-null values
+    uint64_t nullCount;           ///< Number of rows without a value
+    CellValue minValue;           ///< Smallest value; null when there are none
+    CellValue maxValue;           ///< Largest value; null when there are none
+    int64_t approxDistinctCount;  ///< Estimated distinct values; -1 when unknown
+};
+
+/** Memory held by a loaded dataset, with a per-column breakdown.
+    Byte counts are approximate: they cover the payload of the stored
+    data, not allocator overhead.  Returned by
+    Dataset::getMemoryUsage() and served on
+    GET /v1/datasets/<id>/memusage.
+*/
+
+struct DatasetMemoryUsage {
+    DatasetMemoryUsage()
+        : totalBytes(0), rowNameBytes(0), indexBytes(0)
+    {
+    }
+
+    uint64_t totalBytes;    ///< Everything attributed to the dataset
+    uint64_t rowNameBytes;  ///< Row names and the row index
+    uint64_t indexBytes;    ///< Auxiliary indexes (trees, inverted index, ...)
+    std::map<ColumnName, uint64_t> columnBytes;  ///< Bytes held per column
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(DatasetMemoryUsage);
+
 /*****************************************************************************/
 /* COLUMN INDEX                                                              */
 /*****************************************************************************/
@@ -242,12 +295,19 @@ struct RowStream {
     /* set where the stream should start*/
     virtual void initAt(size_t start) = 0;
 
-    /* Return the current RowName and move the stream forward 
-       for performance, this method shall NOT do bound checking 
-       so be sure to obtain the maximum number of rows beforehand 
+    /* Return the current RowName and move the stream forward
+       for performance, this method shall NOT do bound checking
+       so be sure to obtain the maximum number of rows beforehand
        using MatrixView::getRowCount for example */
     virtual RowName next() = 0;
 
+    /* Skip over the next n rows without returning their names.  The
+       default implementation calls next() n times and discards the
+       result; streams over random access storage override it to skip
+       in constant time.  Like next(), this does no bound checking.
+       Used for strided and sampled scans. */
+    virtual void advanceBy(size_t n);
+
 };
 
 
@@ -402,6 +462,16 @@ struct Dataset: public MldbEntity {
     virtual std::vector<KnownColumn>
     getKnownColumnInfos(const std::vector<ColumnName> & columnNames) const;
 
+    /** Returns true if each row of the dataset can hold at most one value
+        per column.  Columnar datasets have this property; event style
+        datasets may record several values of the same column at different
+        timestamps within one row.  When it holds, all variable filters
+        (earliest, latest, ...) resolve a column reference to the same
+        value, which lets bound column accessors take a faster path.
+        Default returns false, which is always safe.
+    */
+    virtual bool rowsHaveSingleValuePerColumn() const;
+
     /** Record multiple embedding rows.  This forwards to recordRows in the
         default implementation, but is much more efficient in datasets that
         are designed for embeddings.
@@ -409,6 +479,17 @@ struct Dataset: public MldbEntity {
     virtual void recordEmbedding(const std::vector<ColumnName> & columnNames,
                                  const std::vector<std::tuple<RowName, std::vector<float>, Date> > & rows);
 
+    /** Record multiple embedding rows given as one contiguous row-major
+        float matrix of rows.size() by columnNames.size() coordinates.
+        The default implementation expands into the tuple form above;
+        datasets designed for embeddings append the coordinates directly
+        into their packed storage, so bulk vector loads pay one lock
+        acquisition and no per-row allocation.
+    */
+    virtual void recordEmbedding(const std::vector<ColumnName> & columnNames,
+                                 const std::vector<std::pair<RowName, Date> > & rows,
+                                 const float * coords);
+
     /** Return a RowValueInfo that describes all rows that could be returned
         from the dataset.
 
@@ -422,6 +503,18 @@ struct Dataset: public MldbEntity {
     */
     virtual ExpressionValue getRowExpr(const RowName & row) const;
 
+    /** Fetch many rows by name in one call.  The result is in the same
+        order as the request; rows that don't exist come back with their
+        name set and no columns, so callers can line results up with the
+        request without a second probe.
+
+        The default implementation looks each row up individually
+        through the matrix view; dataset types with a hash row index
+        override it to batch the index probes.
+    */
+    virtual std::vector<MatrixNamedRow>
+    getRows(const std::vector<RowName> & rowNames) const;
+
 
     /** Commit changes to the database.  Default is a no-op.
 
@@ -432,6 +525,78 @@ struct Dataset: public MldbEntity {
     */
     virtual void commit();
 
+    /** Return the version of the dataset's contents.  This is a counter
+        that is bumped each time the queryable contents of the dataset
+        change: on commit, and on record for datasets whose writes are
+        visible before the commit.  It allows cached query plans and
+        results that were bound against the dataset to be checked for
+        staleness.
+
+        Datasets that forward to another dataset should override this to
+        return the underlying dataset's version.
+    */
+    virtual uint64_t getVersion() const;
+
+    /** Note that the content of the dataset has changed, invalidating any
+        cached query plan that was bound against it.  Called by the
+        commit() implementations.
+
+        This function must be thread safe with respect to concurrent calls
+        to all other functions.
+    */
+    void bumpVersion();
+
+    /** Return the same bucketed column as getColumnIndex()->
+        getColumnBuckets(), but cached against the dataset version so
+        that repeated trainings over an unchanged dataset (for example
+        a hyperparameter sweep) skip straight to the bucketed data.
+        The cache is dropped whenever commit() bumps the version.
+    */
+    std::tuple<BucketList, BucketDescriptions>
+    getColumnBucketsCached(const ColumnName & column,
+                           int maxNumBuckets = -1) const;
+
+    /** Return summary statistics for the given column.  The default
+        implementation scans the column; dataset types that record
+        statistics when the data is ingested (eg tabular) override it to
+        answer from metadata.  The distinct count may be an estimate, as
+        indicated in the result.  Throws if the column is unknown.
+    */
+    virtual ColumnSummaryStats
+    getColumnSummaryStats(const ColumnName & column) const;
+
+    /** Return the memory held by the dataset, broken down per column.
+        Used for capacity planning and eviction decisions.  The default
+        implementation returns an empty report; dataset types that own
+        their storage (tabular, sparse, embedding) override it.
+    */
+    virtual DatasetMemoryUsage getMemoryUsage() const;
+
+    /** Cheap estimate of the number of rows, for the query planner to
+        choose execution strategies against.  It may be approximate or
+        slightly stale, but must not scan the data.  Default forwards
+        to the matrix view's getRowCount().
+    */
+    virtual uint64_t getRowCountEstimate() const;
+
+    /** Cheap estimate of the number of distinct values in the given
+        column, or -1 when no estimate is available without scanning.
+        The default returns -1; dataset types that record statistics at
+        ingestion time (eg tabular) answer from metadata.
+    */
+    virtual int64_t
+    getColumnCardinalityEstimate(const ColumnName & column) const;
+
+    /** Estimate the fraction of rows matched by the given WHERE
+        expression by evaluating it over an evenly spaced sample of
+        rows.  Returns a value in [0, 1], or -1 when the dataset has no
+        row stream to sample from.  Cost is proportional to sampleSize,
+        not to the size of the dataset.
+    */
+    virtual double
+    estimateWhereSelectivity(const SqlExpression & where,
+                             size_t sampleSize = 100) const;
+
     /** Select from the database. */
     virtual std::vector<MatrixNamedRow>
     queryStructured(const SelectExpression & select,
@@ -578,6 +743,15 @@ struct Dataset: public MldbEntity {
        This will return the name that the row has in the table with this alias*/
     virtual RowName getOriginalRowName(const Utf8String& tableName,
                                        const RowName & name) const;
+
+private:
+    /// Content version, maintained by bumpVersion() (see getVersion())
+    std::atomic<uint64_t> version;
+
+    /// Cache for getColumnBucketsCached(); opaque so that this API
+    /// header doesn't need any extra includes
+    struct BucketCache;
+    mutable std::unique_ptr<BucketCache> bucketCache;
 };
 
 
@@ -84,6 +84,14 @@ apply(const ExpressionValue & input) const
     return function->apply(*this, input);
 }
 
+std::vector<ExpressionValue>
+FunctionApplier::
+applyBatch(const std::vector<ExpressionValue> & inputs) const
+{
+    ExcAssert(function);
+    return function->applyBatch(*this, inputs);
+}
+
 
 /*****************************************************************************/
 /* FUNCTION                                                                  */
@@ -135,6 +143,32 @@ getFunctionInfo() const
                         + " needs to override getFunctionInfo()");
 }
 
+bool
+Function::
+supportsBatchedCalls() const
+{
+    return false;
+}
+
+bool
+Function::
+isDeterministic() const
+{
+    return false;
+}
+
+std::vector<ExpressionValue>
+Function::
+applyBatch(const FunctionApplier & applier,
+           const std::vector<ExpressionValue> & inputs) const
+{
+    std::vector<ExpressionValue> outputs;
+    outputs.reserve(inputs.size());
+    for (auto & input: inputs)
+        outputs.emplace_back(apply(applier, input));
+    return outputs;
+}
+
 RestRequestMatchResult
 Function::
 handleRequest(RestConnection & connection,
@@ -95,6 +95,14 @@ struct FunctionApplier {
 
     /// Apply the function to the given context
     ExpressionValue apply(const ExpressionValue & input) const;
+
+    /** Apply the function to each of the given inputs in a single call,
+        returning one output per input.  Functions with a high fixed
+        per-call overhead override Function::applyBatch to amortize it
+        over the batch; for everything else this loops over apply().
+    */
+    std::vector<ExpressionValue>
+    applyBatch(const std::vector<ExpressionValue> & inputs) const;
 };
 
 
@@ -167,6 +175,23 @@ struct Function: public MldbEntity {
     */
     ExpressionValue call(const ExpressionValue & input) const;
 
+    /** Is it worth accumulating calls to this function into batches?
+        Functions whose per-call overhead dwarfs the per-row work (eg,
+        those that cross into an interpreter) return true, and the SQL
+        layer will gather concurrent calls and hand them to applyBatch
+        in one go.  Default is false.
+    */
+    virtual bool supportsBatchedCalls() const;
+
+    /** Does the same input always produce the same output?  Functions
+        that return true (eg, pure lookups) may have their results
+        memoized by the SQL layer for the duration of a query, so inputs
+        with heavy value repetition pay for one call per distinct value.
+        Default is false; don't return true from anything that reads
+        mutable state or depends on the clock.
+    */
+    virtual bool isDeterministic() const;
+
     /** Method to overwrite to handle a request.  By default, the function
         will return that it can't handle any requests.  Used to expose
         function-specific functionality.
@@ -185,6 +210,16 @@ protected:
     virtual ExpressionValue apply(const FunctionApplier & applier,
                                   const ExpressionValue & context) const = 0;
 
+    /** Apply the function to a whole batch of inputs in one call,
+        returning one output per input.  The default implementation
+        loops over apply(); functions returning true from
+        supportsBatchedCalls() override it with something that pays
+        its fixed costs once per batch.
+    */
+    virtual std::vector<ExpressionValue>
+    applyBatch(const FunctionApplier & applier,
+               const std::vector<ExpressionValue> & inputs) const;
+
     friend class FunctionApplier;
 };
 
@@ -229,11 +229,24 @@ ValueFunction(MldbServer * server,
       inputDescription(std::move(inputDescription)),
       outputDescription(std::move(outputDescription))
 {
-    std::tie(inputInfo, fromInput, std::ignore)
+    std::tie(inputInfo, fromInput, inputToOutput)
         = toValueInfo(this->inputDescription);
-    std::tie(outputInfo, std::ignore, toOutput)
+    std::tie(outputInfo, outputFromInput, toOutput)
         = toValueInfo(this->outputDescription);
 }
+
+void
+ValueFunction::
+applyTyped(const FunctionApplier & applier,
+           void * input, void * output) const
+{
+    // Generic fallback: round-trip through ExpressionValue.  Correct
+    // for any subclass, but gains nothing; ValueFunctionT overrides it
+    // with a direct typed call.
+    ExpressionValue in = inputToOutput(input);
+    ExpressionValue out = apply(applier, in);
+    outputFromInput(output, out);
+}
     
 Any
 ValueFunction::
@@ -71,7 +71,30 @@ struct ValueFunction: public Function {
     /// Function that does the conversion from binary -> ExpressionValue for
     /// the function's return type.
     ToOutput toOutput;
-    
+
+    /// Converts the binary input back into an ExpressionValue; used by
+    /// the generic applyTyped fallback.
+    ToOutput inputToOutput;
+
+    /// Converts an ExpressionValue into the binary output; used by the
+    /// generic applyTyped fallback.
+    FromInput outputFromInput;
+
+    /** Apply the function on already-converted binary values: input
+        points to an instance of inputDescription's type, and output to
+        a default-constructed instance of outputDescription's type.
+        Used when chained function applications are fused, so the value
+        handed from one function to the next stays in its typed form
+        instead of being materialized as an ExpressionValue in between.
+        May move from the input.
+
+        The generic implementation here round-trips through
+        ExpressionValue; ValueFunctionT overrides it with a direct
+        typed call.
+    */
+    virtual void applyTyped(const FunctionApplier & applier,
+                            void * input, void * output) const;
+
     /// Since we know the input and output types, we can provide a default
     /// implementation of this function.
     virtual FunctionInfo getFunctionInfo() const override;
@@ -190,6 +213,19 @@ private:
         return toOutput(&out);
     }
 
+    virtual void applyTyped(const FunctionApplier & applier,
+                            void * input, void * output) const override
+    {
+        const auto * downcast
+            = dynamic_cast<const FunctionApplierT<Input, Output> *>(&applier);
+        if (!downcast) {
+            throw HttpReturnException(500, "Couldn't downcast applier");
+        }
+
+        *static_cast<Output *>(output)
+            = applyT(*downcast, std::move(*static_cast<Input *>(input)));
+    }
+
     template<typename InputT, typename OutputT>
     friend class FunctionApplierT;
 };
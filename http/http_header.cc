@@ -169,6 +169,23 @@ swap(HttpHeader & other)
     std::swap(version, other.version);
 }
 
+void
+HttpHeader::
+clear()
+{
+    // clear() on the strings and the vector keeps their capacity, so a
+    // reused header stops allocating once it has seen a typical request
+    verb.clear();
+    resource.clear();
+    version.clear();
+    queryParams.clear();
+    contentType.clear();
+    contentLength = -1;
+    isChunked = false;
+    headers.clear();
+    knownData.clear();
+}
+
 namespace {
 
 std::string
@@ -227,7 +244,9 @@ HttpHeader::
 parse(const std::string & headerAndData, bool checkBodyLength)
 {
     try {
-        HttpHeader parsed;
+        // Parse in place, reusing the storage we already hold; a reused
+        // header therefore allocates nothing in steady state
+        clear();
 
         // Parse http
         ML::Parse_Context context("request header",
@@ -235,9 +254,9 @@ parse(const std::string & headerAndData, bool checkBodyLength)
                                   headerAndData.c_str()
                                       + headerAndData.length());
 
-        parsed.verb = context.expect_text(" \n");
+        verb = context.expect_text(" \n");
         context.expect_literal(' ');
-        parsed.resource = context.expect_text(" ?");
+        resource = context.expect_text(" ?");
         if (context.match_literal('?')) {
             do {
                 string key = expectUrlEncodedString(context, "=& ");
@@ -250,7 +269,7 @@ parse(const std::string & headerAndData, bool checkBodyLength)
             } while (context.match_literal('&'));
         }
         context.expect_literal(' ');
-        parsed.version = context.expect_text('\r');
+        version = context.expect_text('\r');
         context.expect_eol();
 
         while (!context.match_literal("\r\n")) {
@@ -261,12 +280,12 @@ parse(const std::string & headerAndData, bool checkBodyLength)
             context.expect_literal(':');
             context.match_whitespace();
             if (name == "content-length") {
-                parsed.contentLength = context.expect_long_long();
-                //cerr << "******* set cntentLength " << parsed.contentLength
+                contentLength = context.expect_long_long();
+                //cerr << "******* set cntentLength " << contentLength
                 //     << endl;
             }
             else if (name == "content-type")
-                parsed.contentType = context.expect_text('\r');
+                contentType = context.expect_text('\r');
             else if (name == "transfer-encoding") {
                 string transferEncoding
                     = context.expect_text('\r');
@@ -275,11 +294,11 @@ parse(const std::string & headerAndData, bool checkBodyLength)
 
                 if (transferEncoding != "chunked")
                     throw ML::Exception("unknown transfer-encoding");
-                parsed.isChunked = true;
+                isChunked = true;
             }
             else {
                 string value = context.expect_text('\r');
-                parsed.headers[name] = value;
+                headers[name] = value;
             }
             context.expect_eol();
         }
@@ -288,25 +307,22 @@ parse(const std::string & headerAndData, bool checkBodyLength)
         const char * content_start
             = headerAndData.c_str() + context.get_offset();
 
-        parsed.knownData
-            = string(content_start,
-                     headerAndData.c_str() + headerAndData.length());
+        knownData.assign(content_start,
+                         headerAndData.c_str() + headerAndData.length());
 
-        if (checkBodyLength && (parsed.contentLength != -1)
-            && ((int)parsed.knownData.length() > (int)parsed.contentLength)) {
-            cerr << "got double packet: got content length " << parsed.knownData.length()
-                 << " wanted " << parsed.contentLength << endl;
-#if 1            
+        if (checkBodyLength && (contentLength != -1)
+            && ((int)knownData.length() > (int)contentLength)) {
+            cerr << "got double packet: got content length " << knownData.length()
+                 << " wanted " << contentLength << endl;
+#if 1
             context.exception(format("too much data for content length: "
                                      "%d > %d for data \"%s\"",
-                                     (int)parsed.knownData.length(),
-                                     (int)parsed.contentLength,
+                                     (int)knownData.length(),
+                                     (int)contentLength,
                                      headerAndData.c_str()));
 #endif
-            parsed.knownData.resize(parsed.contentLength);
+            knownData.resize(contentLength);
         }
-        
-        swap(parsed);
     }
     catch (const std::exception & exc) {
         cerr << "error parsing http header: " << exc.what() << endl;
@@ -86,6 +86,19 @@ struct HttpHeader {
 
     void swap(HttpHeader & other);
 
+    /** Reset to the freshly constructed state, keeping the allocated
+        capacity of the string members and of the query parameter vector.
+        A header object reused across keep-alive requests on a connection
+        therefore stops allocating in steady state (the generic header
+        map still allocates its nodes).
+    */
+    void clear();
+
+    /** Parse the given request or response into this object.  Parses in
+        place, reusing whatever storage the object already holds; on a
+        parse error the object is left in a partially filled state and
+        should be cleared or discarded.
+    */
     void parse(const std::string & headerAndData, bool checkBodyLength = true);
 
     std::string verb;       // GET, PUT, etc
@@ -8,6 +8,10 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 #include <iostream>
 #include "mldb/arch/exception.h"
 #include "mldb/base/parse_context.h"
@@ -312,20 +316,29 @@ handleHeader(const char * data, size_t dataSize)
         skipChar(' ');
     };
 
-    if (matchString("Connection", 10)) {
-        skipToValue();
-        if (matchString("close", 5)) {
-            requireClose_ = true;
+    /* Dispatch on the (lowercased) first character, so that the many
+       headers we don't care about don't each pay a case-insensitive
+       compare against the whole known-header table. */
+    char c0 = dataSize > 0 ? (data[0] | 0x20) : '\0';
+
+    if (c0 == 'c') {
+        if (matchString("Connection", 10)) {
+            skipToValue();
+            if (matchString("close", 5)) {
+                requireClose_ = true;
+            }
+        }
+        else if (matchString("Content-Length", 14)) {
+            skipToValue();
+            remainingBody_ = antoi(data + ptr, data + dataSize - 2);
         }
     }
-    else if (matchString("Content-Length", 14)) {
-        skipToValue();
-        remainingBody_ = antoi(data + ptr, data + dataSize - 2);
-    }
-    else if (matchString("Transfer-Encoding", 15)) {
-        skipToValue();
-        if (matchString("chunked", 7)) {
-            useChunkedEncoding_ = true;
+    else if (c0 == 't') {
+        if (matchString("Transfer-Encoding", 17)) {
+            skipToValue();
+            if (matchString("chunked", 7)) {
+                useChunkedEncoding_ = true;
+            }
         }
     }
 
@@ -434,6 +447,39 @@ HttpParser::BufferState::
 skip_to_char(char c, bool throwOnEol)
 {
     while (!eof()) {
+#if defined(__SSE2__)
+        {
+            /* Skip the uninteresting bytes sixteen at a time, stopping at
+               the target character or, when the end of line matters, at a
+               CR or LF that the scalar code below must look at (a lone CR
+               is not an end of line and scanning must continue past it). */
+            const char * p = get_offset_ptr();
+            size_t avail = readahead_available();
+            __m128i needle = _mm_set1_epi8(c);
+            __m128i cr = _mm_set1_epi8('\r');
+            __m128i lf = _mm_set1_epi8('\n');
+            size_t skipped = 0;
+            while (skipped + 16 <= avail) {
+                __m128i chunk
+                    = _mm_loadu_si128((const __m128i *)(p + skipped));
+                __m128i hits = _mm_cmpeq_epi8(chunk, needle);
+                if (throwOnEol) {
+                    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, cr));
+                    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, lf));
+                }
+                int mask = _mm_movemask_epi8(hits);
+                if (mask != 0) {
+                    skipped += __builtin_ctz(mask);
+                    break;
+                }
+                skipped += 16;
+            }
+            operator += (skipped);
+            if (eof()) {
+                break;
+            }
+        }
+#endif
         if (operator *() == c) {
             return true;
         }
@@ -16,6 +16,7 @@
 #include "mldb/base/exc_assert.h"
 #include "mldb/ext/jsoncpp/json.h"
 
+#include "mldb/types/date.h"
 #include "http_rest_proxy.h"
 #include "http_rest_proxy_impl.h"
 
@@ -179,43 +180,126 @@ struct HttpRestProxy::Itl {
 
     HttpRestProxy * owner;
 
-    /** Lock for connection pool. */
-    mutable std::mutex lock;
+    std::vector<std::string> cookies;
 
-    /** List of inactive handles.  These can be selected from when a new
-        connection needs to be made.
+    /** Process-wide pool of idle curl handles, one sub-pool per
+        scheme://host:port.  Curl keeps the TCP (and TLS) session to a host
+        alive inside the easy handle, so reusing a handle on the same host
+        skips connection establishment entirely.  The pool is shared between
+        all proxy instances because short-lived proxies (for example the one
+        http_streambuf creates per URL downloaded) would otherwise never
+        reuse anything, and it is size-limited with idle reaping so that a
+        burst of traffic doesn't leave file descriptors open forever.
     */
-    mutable std::vector<Connection> inactive;
+    struct SharedPool {
+        /// Maximum number of idle handles kept per host
+        static constexpr size_t MAX_IDLE_PER_HOST = 16;
+
+        /// Idle handles older than this are closed instead of reused
+        static constexpr double MAX_IDLE_SECONDS = 60.0;
+
+        struct IdleHandle {
+            ConnectionHandler * handler;
+            Date returned;
+        };
+
+        std::mutex lock;
+        std::map<std::string, std::vector<IdleHandle> > idleByHost;
+
+        ~SharedPool()
+        {
+            for (auto & host: idleByHost)
+                for (auto & idle: host.second)
+                    delete idle.handler;
+        }
 
-    std::vector<std::string> cookies;
+        /** Close handles that have sat idle for too long.  Must be called
+            with the lock held.
+        */
+        void reapStale(Date now)
+        {
+            for (auto & host: idleByHost) {
+                auto & idle = host.second;
+                for (size_t i = 0;  i < idle.size();  /* no inc */) {
+                    if (now.secondsSince(idle[i].returned) > MAX_IDLE_SECONDS) {
+                        delete idle[i].handler;
+                        idle[i] = idle.back();
+                        idle.pop_back();
+                    }
+                    else ++i;
+                }
+            }
+        }
+    };
 
-    HttpRestProxy::Connection
-    getConnection() const
+    static SharedPool & sharedPool()
     {
-        std::unique_lock<std::mutex> guard(lock);
+        static SharedPool pool;
+        return pool;
+    }
 
-        if (inactive.empty()) {
-            return Connection(new ConnectionHandler, owner);
-        }
-        else {
-            Connection res(std::move(inactive.back()));
-            inactive.pop_back();
+    /** Return the scheme://host:port prefix of the URI, which identifies
+        the hosts a kept-alive handle can be reused on.
+    */
+    static std::string hostKey(const std::string & uri)
+    {
+        auto pos = uri.find("://");
+        if (pos == std::string::npos)
+            return uri;
+        auto end = uri.find('/', pos + 3);
+        if (end == std::string::npos)
+            return uri;
+        return uri.substr(0, end);
+    }
 
-            // Set proxy to this, so when it's destroyed it's put on our list
-            ExcAssert(res.proxy == nullptr);
-            res.proxy = owner;
-            return std::move(res);
+    HttpRestProxy::Connection
+    getConnection(const std::string & uri) const
+    {
+        std::string key = hostKey(uri);
+
+        auto & pool = sharedPool();
+        {
+            std::unique_lock<std::mutex> guard(pool.lock);
+            pool.reapStale(Date::now());
+
+            auto it = pool.idleByHost.find(key);
+            if (it != pool.idleByHost.end() && !it->second.empty()) {
+                // Take the most recently returned handle: it's the one
+                // whose keep-alive connection is least likely to have been
+                // closed by the server.
+                ConnectionHandler * handler = it->second.back().handler;
+                it->second.pop_back();
+                return Connection(handler, owner);
+            }
         }
+
+        auto handler = new ConnectionHandler;
+        handler->poolKey = key;
+        return Connection(handler, owner);
     }
-    
+
     void doneConnection(ConnectionHandler * conn)
     {
-        std::unique_lock<std::mutex> guard(lock);
         conn->reset();
 
-        // Put a Connection with a null handler on the list so it's
-        // destroyed when done
-        inactive.emplace_back(conn, nullptr);
+        // The handle may be picked up by a different proxy talking to the
+        // same host, so don't let session cookies survive the return to
+        // the pool.
+        conn->add_option(CURLOPT_COOKIELIST, "ALL");
+
+        auto & pool = sharedPool();
+        Date now = Date::now();
+
+        std::unique_lock<std::mutex> guard(pool.lock);
+        pool.reapStale(now);
+
+        auto & idle = pool.idleByHost[conn->poolKey];
+        if (idle.size() >= SharedPool::MAX_IDLE_PER_HOST) {
+            guard.unlock();
+            delete conn;
+            return;
+        }
+        idle.push_back({conn, now});
     }
 };
 
@@ -318,11 +402,11 @@ perform(const std::string & verb,
         responseHeaders.clear();
         body.clear();
 
-        Connection connection = getConnection();
+        uri = itl->serviceUri + resource + queryParams.uriEscaped();
 
-        CurlWrapper::Easy & myRequest = *connection;
+        Connection connection = itl->getConnection(uri);
 
-        uri = itl->serviceUri + resource + queryParams.uriEscaped();
+        CurlWrapper::Easy & myRequest = *connection;
 
         myRequest.add_option(CURLOPT_CUSTOMREQUEST, verb);
 
@@ -461,7 +545,7 @@ HttpRestProxy::Connection
 HttpRestProxy::
 getConnection() const
 {
-    return itl->getConnection();
+    return itl->getConnection(itl->serviceUri);
 }
 
 void
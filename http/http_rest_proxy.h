@@ -220,7 +220,11 @@ struct HttpRestProxy {
                      bool followRedirect = false) const;
     
 public:
-    /** Get a connection. */
+    /** Get a connection.  The underlying curl handle comes from a
+        process-wide, size-limited keep-alive pool with one sub-pool per
+        host, so repeated requests to the same host skip connection
+        establishment even when made through different proxy instances.
+    */
     struct Connection;
     Connection getConnection() const;
 
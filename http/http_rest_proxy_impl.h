@@ -16,6 +16,9 @@
 namespace Datacratic {
 
 struct HttpRestProxy::ConnectionHandler: public CurlWrapper::Easy {
+    /// scheme://host:port the handle was created for.  Used to return it
+    /// to the right per-host sub-pool of the shared keep-alive pool.
+    std::string poolKey;
 };
 
 struct HttpRestProxy::Connection {
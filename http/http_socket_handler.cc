@@ -5,17 +5,100 @@
    Copyright (c) 2015 Datacratic.  All rights reserved.
 */
 
+#include <cstdlib>
+#include <strings.h>
+
 #include "boost/system/error_code.hpp"
 #include "boost/asio/error.hpp"
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 #include "http_socket_handler.h"
 #include "tcp_socket.h"
 #include "mldb/arch/exception.h"
+#include "mldb/vfs/zstd_filter.h"
 
 using namespace std;
 using namespace Datacratic;
 
 namespace Datacratic {
 
+std::string
+pickContentEncoding(const std::string & acceptEncoding)
+{
+    bool gzip = false, zstd = false;
+
+    size_t pos = 0;
+    while (pos <= acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == string::npos) end = acceptEncoding.size();
+        string entry = acceptEncoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t semi = entry.find(';');
+        string token
+            = entry.substr(0, semi == string::npos ? entry.size() : semi);
+        size_t b = token.find_first_not_of(" \t");
+        if (b == string::npos) continue;
+        size_t e = token.find_last_not_of(" \t");
+        token = token.substr(b, e - b + 1);
+
+        bool refused = false;
+        if (semi != string::npos) {
+            size_t q = entry.find("q=", semi);
+            if (q != string::npos)
+                refused = (strtod(entry.c_str() + q + 2, nullptr) == 0.0);
+        }
+        if (refused) continue;
+
+        if (token == "zstd") zstd = true;
+        else if (token == "gzip" || token == "x-gzip") gzip = true;
+    }
+
+    if (zstd) return "zstd";
+    if (gzip) return "gzip";
+    return "";
+}
+
+
+/*****************************************************************************/
+/* HTTP CHUNK COMPRESSOR                                                     */
+/*****************************************************************************/
+
+/* Compression state for one response body, whole or streamed.  Each
+   compress() call flushes the filter chain, so what has been returned
+   so far is always a decodable prefix of the stream. */
+
+struct HttpChunkCompressor {
+    HttpChunkCompressor(const std::string & encoding)
+    {
+        if (encoding == "gzip")
+            stream.push(boost::iostreams::gzip_compressor());
+        else if (encoding == "zstd")
+            stream.push(zstd_compressor(-1 /* level */, 0 /* threads */));
+        else throw ML::Exception("unknown content encoding " + encoding);
+        stream.push(boost::iostreams::back_inserter(output));
+    }
+
+    /** Compress a chunk, returning whatever compressed data is ready
+        to go out.  Finishing tears the filter chain down, which
+        writes the stream trailer. */
+    std::string compress(const std::string & chunk, bool finish)
+    {
+        stream.write(chunk.data(), chunk.size());
+        if (finish) stream.reset();
+        else stream.strict_sync();
+
+        std::string result = std::move(output);
+        output.clear();
+        return result;
+    }
+
+private:
+    std::string output;
+    boost::iostreams::filtering_ostream stream;
+};
+
 
 /*****************************************************************************/
 /* HTTP RESPONSE                                                             */
@@ -132,6 +215,11 @@ HttpLegacySocketHandler(TcpSocket && socket)
 {
 }
 
+HttpLegacySocketHandler::
+~HttpLegacySocketHandler()
+{
+}
+
 void
 HttpLegacySocketHandler::
 send(std::string str,
@@ -147,18 +235,67 @@ send(std::string str,
                 requestClose();
             }
         };
-        requestWrite(str, onWritten);
+        requestWrite(std::move(str), onWritten);
     }
 }
 
 void
 HttpLegacySocketHandler::
-putResponseOnWire(const HttpResponse & response,
+send(std::vector<std::string> pieces,
+     NextAction action, OnWriteFinished onWriteFinished)
+{
+    size_t totalSize = 0;
+    for (auto & piece: pieces) {
+        totalSize += piece.size();
+    }
+    if (totalSize > 0) {
+        auto onWritten = [=] (const boost::system::error_code & ec,
+                              size_t) {
+            if (onWriteFinished) {
+                onWriteFinished();
+            }
+            if (action == NEXT_CLOSE || action == NEXT_RECYCLE) {
+                requestClose();
+            }
+        };
+        requestWrite(std::move(pieces), onWritten);
+    }
+}
+
+void
+HttpLegacySocketHandler::
+putResponseOnWire(HttpResponse response,
                   std::function<void ()> onSendFinished,
                   NextAction next)
 {
-    string responseStr;
-    responseStr.reserve(16384 + response.body.length());
+    /* Compress the body if it's worth it and the client asked for it.
+       Responses that already carry a Content-Encoding pass through
+       untouched. */
+    string contentEncoding;
+    if (response.sendBody
+        && response.body.length() >= MIN_COMPRESSED_BODY_SIZE
+        && !acceptedEncoding_.empty()) {
+        bool alreadyEncoded = false;
+        for (auto & h: response.extraHeaders)
+            if (strcasecmp(h.first.c_str(), "content-encoding") == 0)
+                alreadyEncoded = true;
+        if (!alreadyEncoded) {
+            HttpChunkCompressor compressor(acceptedEncoding_);
+            string compressedBody = compressor.compress(response.body,
+                                                        true /* finish */);
+            if (compressedBody.length() < response.body.length()) {
+                response.body = std::move(compressedBody);
+                contentEncoding = acceptedEncoding_;
+            }
+        }
+    }
+
+    /* The header block is assembled in a buffer recycled from an
+       earlier write on this connection; the body goes out as its own
+       iovec of the same gathered write, so it is never copied into a
+       contiguous response buffer. */
+    string responseStr = takeWriteBuffer();
+    responseStr.reserve(1024);
 
     responseStr.append("HTTP/1.1 ");
     responseStr.append(to_string(response.responseCode));
@@ -177,6 +314,11 @@ putResponseOnWire(const HttpResponse & response,
         responseStr.append(to_string(response.body.length()));
         responseStr.append("\r\n");
         responseStr.append("Connection: Keep-Alive\r\n");
+        if (!contentEncoding.empty()) {
+            responseStr.append("Content-Encoding: ");
+            responseStr.append(contentEncoding);
+            responseStr.append("\r\nVary: Accept-Encoding\r\n");
+        }
     }
 
     for (auto & h: response.extraHeaders) {
@@ -187,9 +329,17 @@ putResponseOnWire(const HttpResponse & response,
     }
 
     responseStr.append("\r\n");
-    responseStr.append(response.body);
 
-    send(std::move(responseStr), next, onSendFinished);
+    if (response.sendBody && !response.body.empty()) {
+        std::vector<std::string> pieces;
+        pieces.reserve(2);
+        pieces.emplace_back(std::move(responseStr));
+        pieces.emplace_back(std::move(response.body));
+        send(std::move(pieces), next, onSendFinished);
+    }
+    else {
+        send(std::move(responseStr), next, onSendFinished);
+    }
 }
 
 void
@@ -228,13 +378,44 @@ void
 HttpLegacySocketHandler::
 onDone(bool requireClose)
 {
-    HttpHeader header;
-    header.parse(headerPayload);
-    handleHttpPayload(header, bodyPayload);
+    // The header object and the payload buffers are connection members
+    // whose storage is kept between keep-alive requests, so in steady
+    // state a request parses without allocating
+    header_.parse(headerPayload);
+    acceptedEncoding_
+        = pickContentEncoding(header_.tryGetHeader("accept-encoding"));
+    chunkCompressor_.reset();
+    handleHttpPayload(header_, bodyPayload);
     headerPayload.clear();
     bodyPayload.clear();
     bodyStarted_ = false;
 }
 
+void
+HttpLegacySocketHandler::
+startChunkCompression(const std::string & encoding)
+{
+    chunkCompressor_.reset(new HttpChunkCompressor(encoding));
+}
+
+void
+HttpLegacySocketHandler::
+sendCompressedChunk(std::string chunk,
+                    NextAction action, OnWriteFinished onWriteFinished)
+{
+    if (!chunkCompressor_)
+        throw ML::Exception("sendCompressedChunk without "
+                            "startChunkCompression");
+
+    bool finish = chunk.empty();
+    string compressed = chunkCompressor_->compress(chunk, finish);
+    if (finish)
+        chunkCompressor_.reset();
+
+    if (compressed.empty() && (action == NEXT_CLOSE || action == NEXT_RECYCLE))
+        requestClose();
+    else send(std::move(compressed), action, std::move(onWriteFinished));
+}
+
 } // namespace Datacratic
 
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include "mldb/ext/jsoncpp/value.h"
 #include "mldb/http/http_header.h"
 #include "mldb/http/http_parsers.h"
@@ -15,6 +17,16 @@
 
 namespace Datacratic {
 
+/* Internal; holds the state of a streamed response compression. */
+struct HttpChunkCompressor;
+
+/** Pick the content encoding for a response from the Accept-Encoding
+    header of its request.  Quality values other than q=0 are ignored;
+    zstd wins over gzip because it is cheaper to produce.  Returns the
+    empty string when neither is acceptable. */
+std::string pickContentEncoding(const std::string & acceptEncoding);
+
+
 /****************************************************************************/
 /* HTTP CONNECTION HANDLER                                                  */
 /****************************************************************************/
@@ -110,10 +122,17 @@ struct HttpLegacySocketHandler : public HttpSocketHandler {
 
     HttpLegacySocketHandler(TcpSocket && socket);
 
+    /* Out of line so the compression state can stay an incomplete type
+       for users of this header */
+    virtual ~HttpLegacySocketHandler();
+
     virtual void handleHttpPayload(const HttpHeader & header,
                                    const std::string & payload) = 0;
 
-    void putResponseOnWire(const HttpResponse & response,
+    /** Send a response.  Taken by value so the body can go to the wire
+        as its own iovec, moved rather than copied into a contiguous
+        response buffer. */
+    void putResponseOnWire(HttpResponse response,
                            std::function<void ()> onSendFinished
                            = std::function<void ()>(),
                            NextAction next = NEXT_CONTINUE);
@@ -121,6 +140,47 @@ struct HttpLegacySocketHandler : public HttpSocketHandler {
               NextAction action = NEXT_CONTINUE,
               OnWriteFinished onWriteFinished = nullptr);
 
+    /** Send a payload assembled from several pieces as one gathered
+        write, without coalescing them into a contiguous buffer. */
+    void send(std::vector<std::string> pieces,
+              NextAction action = NEXT_CONTINUE,
+              OnWriteFinished onWriteFinished = nullptr);
+
+    /** Bodies below this size are sent uncompressed; compressing them
+        costs more than the transfer saves. */
+    static constexpr size_t MIN_COMPRESSED_BODY_SIZE = 4096;
+
+    /** Content encoding the current request accepts for its response:
+        "zstd", "gzip" or "" for identity.  Renegotiated from the
+        Accept-Encoding header of each request; zstd wins when the
+        client accepts both.  Responses put on the wire with
+        putResponseOnWire are compressed accordingly; streamed
+        responses opt in with startChunkCompression. */
+    const std::string & negotiatedContentEncoding() const
+    {
+        return acceptedEncoding_;
+    }
+
+    /** Start compressing the body of a streamed response with the
+        given encoding ("gzip" or "zstd").  Must be called before the
+        response header goes on the wire; the caller is responsible
+        for adding the matching Content-Encoding header. */
+    void startChunkCompression(const std::string & encoding);
+
+    /** Is a streamed response currently being compressed? */
+    bool chunkCompressionActive() const
+    {
+        return chunkCompressor_ != nullptr;
+    }
+
+    /** Compress and send a chunk of a streamed response.  The
+        compressor is flushed after each chunk so the data goes out
+        immediately; an empty chunk ends the compression stream and
+        sends its trailer. */
+    void sendCompressedChunk(std::string chunk,
+                             NextAction action = NEXT_CONTINUE,
+                             OnWriteFinished onWriteFinished = nullptr);
+
 private:
     virtual void onRequestStart(const char * methodData, size_t methodSize,
                                 const char * urlData, size_t urlSize,
@@ -132,8 +192,12 @@ private:
 
     std::string headerPayload;
     std::string bodyPayload;
+    HttpHeader header_;   ///< reused between keep-alive requests
     bool bodyStarted_;
 
+    std::string acceptedEncoding_;
+    std::unique_ptr<HttpChunkCompressor> chunkCompressor_;
+
     std::string writeData_;
 };
 
@@ -40,9 +40,10 @@ TcpAcceptor::
 
 void
 TcpAcceptor::
-listen(const PortRange & portRange, const string & hostname, int backlog)
+listen(const PortRange & portRange, const string & hostname, int backlog,
+       bool reusePort)
 {
-    impl_->listen(portRange, hostname, backlog);
+    impl_->listen(portRange, hostname, backlog, reusePort);
 }
 
 int
@@ -42,10 +42,14 @@ struct TcpAcceptor {
     ~TcpAcceptor();
 
     /* Starts listening on either of the given ports (in ascending order) and
-     * interface. Returns the effective port of the listening socket. */
+     * interface. Returns the effective port of the listening socket. When
+     * "reusePort" is set, the listening socket is opened with SO_REUSEPORT
+     * so that several acceptors can share the same port, with the kernel
+     * spreading incoming connections between them. */
     void listen(const PortRange & portRange,
                 const std::string & hostname = "localhost",
-                int backlog = 128);
+                int backlog = 128,
+                bool reusePort = false);
 
     /* Shutdowns the worker threads (except the main listening thread) as well
      * as the listening socket. */
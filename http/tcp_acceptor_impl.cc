@@ -5,6 +5,8 @@
    Copyright (c) 2015 Datacratic.  All rights reserved.
 */
 
+#include <sys/socket.h>
+
 #include <iostream>
 #include <mutex>
 
@@ -53,7 +55,8 @@ TcpAcceptorImpl::
 
 void
 TcpAcceptorImpl::
-listen(const PortRange & portRange, const string & hostname, int backlog)
+listen(const PortRange & portRange, const string & hostname, int backlog,
+       bool reusePort)
 {
     ExcAssert(!hostname.empty());
 
@@ -68,13 +71,13 @@ listen(const PortRange & portRange, const string & hostname, int backlog)
         auto ep = result.endpoint();
         if (ep.protocol() == asio::ip::tcp::v4()) {
             if (!v4Endpoint_.isOpen()) {
-                v4Endpoint_.open(ep, portRange, backlog);
+                v4Endpoint_.open(ep, portRange, backlog, reusePort);
                 accept(v4Endpoint_);
             }
         }
         else if (ep.protocol() == asio::ip::tcp::v6()) {
             if (!v6Endpoint_.isOpen()) {
-                v6Endpoint_.open(ep, portRange, backlog);
+                v6Endpoint_.open(ep, portRange, backlog, reusePort);
                 accept(v6Endpoint_);
             }
         }
@@ -137,7 +140,7 @@ TcpAcceptorImpl::Endpoint::
 void
 TcpAcceptorImpl::Endpoint::
 open(const asio::ip::tcp::endpoint & asioEndpoint,
-     const PortRange & portRange, int backlog)
+     const PortRange & portRange, int backlog, bool reusePort)
 {
     /* Exception safety: we close the socket if we could not bind it
        appropriately */
@@ -152,6 +155,16 @@ open(const asio::ip::tcp::endpoint & asioEndpoint,
             acceptorPtr.reset(new asio::ip::tcp::acceptor(ioService_));
             acceptorPtr->open(bindEndpoint.protocol());
             acceptorPtr->set_option(asio::socket_base::reuse_address(true));
+            if (reusePort) {
+                /* Our version of asio has no portable reuse_port option,
+                   so set it directly on the native descriptor */
+                int one(1);
+                if (::setsockopt(acceptorPtr->native_handle(),
+                                 SOL_SOCKET, SO_REUSEPORT,
+                                 &one, sizeof(one)) == -1) {
+                    throw ML::Exception(errno, "setsockopt(SO_REUSEPORT)");
+                }
+            }
             bindEndpoint.port(i);
             system::error_code ec;
             acceptorPtr->bind(bindEndpoint, ec);
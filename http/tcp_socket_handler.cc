@@ -70,6 +70,20 @@ requestWrite(string data, OnWritten onWritten)
     impl_->requestWrite(std::move(data), std::move(onWritten));
 }
 
+void
+TcpSocketHandler::
+requestWrite(std::vector<std::string> data, OnWritten onWritten)
+{
+    impl_->requestWrite(std::move(data), std::move(onWritten));
+}
+
+std::string
+TcpSocketHandler::
+takeWriteBuffer()
+{
+    return impl_->takeWriteBuffer();
+}
+
 void
 TcpSocketHandler::
 disableNagle()
@@ -9,6 +9,7 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 
 namespace boost
@@ -65,6 +66,17 @@ struct TcpSocketHandler {
     /* Request the sending of a given payload. */
     void requestWrite(std::string data, OnWritten onWritten = nullptr);
 
+    /* Request the sending of a payload assembled from several pieces.
+       The pieces are written in order as one gathered (writev)
+       operation, without being coalesced into a contiguous buffer. */
+    void requestWrite(std::vector<std::string> data,
+                      OnWritten onWritten = nullptr);
+
+    /* A cleared buffer recycled from a completed write on this
+       connection (a fresh empty string when none is spare), so the
+       next payload can be assembled without reallocating. */
+    std::string takeWriteBuffer();
+
     /* Request the reading of any available data from the socket. */
     void requestReceive();
 
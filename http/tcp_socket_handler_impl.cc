@@ -74,10 +74,34 @@ void
 TcpSocketHandlerImpl::
 requestWrite(string data, TcpSocketHandler::OnWritten onWritten)
 {
-    auto dataPtr = std::make_shared<std::string>(std::move(data));
+    std::vector<std::string> parts;
+    parts.emplace_back(std::move(data));
+    requestWrite(std::move(parts), std::move(onWritten));
+}
+
+void
+TcpSocketHandlerImpl::
+requestWrite(std::vector<std::string> data,
+             TcpSocketHandler::OnWritten onWritten)
+{
+    /* The pieces and the buffer sequence pointing into them must both
+       outlive the asynchronous operation. */
+    struct WriteOp {
+        std::vector<std::string> parts;
+        std::vector<asio::const_buffer> buffers;
+        size_t totalSize = 0;
+    };
+    auto op = std::make_shared<WriteOp>();
+    op->parts = std::move(data);
+    op->buffers.reserve(op->parts.size());
+    for (auto & part: op->parts) {
+        op->buffers.emplace_back(part.c_str(), part.size());
+        op->totalSize += part.size();
+    }
+
     auto writeCompleteCond = [=] (const system::error_code & ec,
                                   std::size_t written) {
-        return written == dataPtr->size();
+        return written == op->totalSize;
     };
     auto onWriteComplete = [=] (const system::error_code & ec,
                                 size_t written)
@@ -86,10 +110,41 @@ requestWrite(string data, TcpSocketHandler::OnWritten onWritten)
         if (onWritten) {
             onWritten(ec, written);
         }
-        (void) dataPtr;
+        recycleWriteBuffers(op->parts);
     };
-    asio::const_buffers_1 writeBuffer(dataPtr->c_str(), dataPtr->size());
-    async_write(socket_, writeBuffer, writeCompleteCond, onWriteComplete);
+    async_write(socket_, op->buffers, writeCompleteCond, onWriteComplete);
+}
+
+std::string
+TcpSocketHandlerImpl::
+takeWriteBuffer()
+{
+    std::unique_lock<std::mutex> guard(spareBuffersLock_);
+    if (spareBuffers_.empty()) {
+        return std::string();
+    }
+    std::string result = std::move(spareBuffers_.back());
+    spareBuffers_.pop_back();
+    return result;
+}
+
+void
+TcpSocketHandlerImpl::
+recycleWriteBuffers(std::vector<std::string> & parts)
+{
+    std::unique_lock<std::mutex> guard(spareBuffersLock_);
+    for (auto & part: parts) {
+        if (spareBuffers_.size() >= MAX_SPARE_BUFFERS) {
+            break;
+        }
+        if (part.capacity() == 0
+            || part.capacity() > MAX_SPARE_BUFFER_CAPACITY) {
+            continue;
+        }
+        part.clear();
+        spareBuffers_.emplace_back(std::move(part));
+    }
+    parts.clear();
 }
 
 void
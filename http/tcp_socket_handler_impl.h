@@ -8,7 +8,9 @@
 
 #pragma once
 
+#include <mutex>
 #include <string>
+#include <vector>
 #include <boost/asio/ip/tcp.hpp>
 #include "mldb/http/tcp_socket_handler.h"
 
@@ -46,6 +48,17 @@ struct TcpSocketHandlerImpl {
     void requestWrite(std::string data,
                       TcpSocketHandler::OnWritten onWritten = nullptr);
 
+    /* Request the sending of a payload assembled from several pieces.
+       The pieces go to the kernel as one gathered (writev) operation,
+       in order, without being coalesced into a contiguous buffer. */
+    void requestWrite(std::vector<std::string> data,
+                      TcpSocketHandler::OnWritten onWritten = nullptr);
+
+    /* A cleared buffer recycled from a completed write on this
+       connection (empty capacity-less string when none is spare), so
+       the next payload can be assembled without reallocating. */
+    std::string takeWriteBuffer();
+
     /* Request the reading of any available data from the socket. */
     void requestReceive();
 
@@ -64,6 +77,19 @@ private:
     typedef std::function<void(const boost::system::error_code & ec,
                                size_t bufferSize)> OnReadSome;
     OnReadSome onReadSome_;
+
+    /* Buffers handed back by completed writes, kept for their capacity.
+       Writes are issued from worker threads and complete on the io
+       thread, hence the lock. */
+    static constexpr size_t MAX_SPARE_BUFFERS = 4;
+
+    /* Don't pin the capacity of a huge response body to the connection;
+       buffers above this size are freed rather than recycled. */
+    static constexpr size_t MAX_SPARE_BUFFER_CAPACITY = 1024 * 1024;
+    std::mutex spareBuffersLock_;
+    std::vector<std::string> spareBuffers_;
+
+    void recycleWriteBuffers(std::vector<std::string> & parts);
 };
 
 } // namespace Datacratic
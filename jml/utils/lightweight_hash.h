@@ -518,6 +518,22 @@ struct Lightweight_Hash_Base {
         return bucket != NO_BUCKET;
     }
 
+    /** Prefetch the initial probe bucket for the given key.  Batched
+        lookups can call this a fixed distance ahead of the matching
+        find() so that the cache misses of successive probes overlap
+        instead of being taken one at a time.  Open addressing may step
+        past the first bucket, but the first touch is the miss that
+        matters.
+    */
+    void prefetch(const Key & key) const
+    {
+        ssize_t cap = capacity();
+        if (cap == 0 || Ops::isGuardValue(key))
+            return;
+        ssize_t bucket = Ops::hashKey(key, cap, storage_);
+        __builtin_prefetch(&storage_[bucket], 0 /* read */, 3);
+    }
+
     void destroy()
     {
         ssize_t cp = capacity();
@@ -20,6 +20,7 @@
 #include "mldb/jml/utils/string_functions.h"
 #include "mldb/arch/simd_vector.h"
 #include "mldb/base/parallel.h"
+#include "mldb/base/thread_pool.h"
 
 
 using namespace std;
@@ -723,32 +724,6 @@ lasso_regression(const boost::multi_array<double, 2> & A,
 
 //***********************************************
 
-template<class Float>
-void doWeightedSquareRow(const boost::multi_array<Float, 2> & XT,
-                         const distribution<Float> & d,
-                         boost::multi_array<Float, 2> & result,
-                         int i)
-{
-    int chunk_size = 2048;  // ensure we fit in the cache
-
-    size_t nx = XT.shape()[1];
-    size_t nv = XT.shape()[0];
-
-    int x = 0;
-    while (x < nx) {
-        int nxc = std::min<size_t>(chunk_size, nx - x);
-        distribution<Float> Xid(chunk_size);
-        SIMD::vec_prod(&XT[i][x], &d[x], &Xid[0], nxc);
-            
-        for (unsigned j = 0;  j < nv;  ++j) {
-            result[i][j] += SIMD::vec_dotprod_dp(&XT[j][x], &Xid[0], nxc);
-        }
-
-        x += nxc;
-    }
-
-}
-
 template<class Float>
 boost::multi_array<Float, 2>
 weighted_square_impl(const boost::multi_array<Float, 2> & XT,
@@ -764,32 +739,62 @@ weighted_square_impl(const boost::multi_array<Float, 2> & XT,
 
     boost::multi_array<Float, 2> result(boost::extents[nv][nv]);
 
-    if (false) {
-        int chunk_size = 2048;  // ensure we fit in the cache
-        distribution<Float> Xid(chunk_size);
+    /* Accumulate X^T W X over blocks of examples in parallel.  Splitting
+       over examples rather than variables keeps all cores busy whatever
+       the number of variables, and each block only computes the upper
+       triangle, in double precision.  The per-block partials are summed
+       serially at the end, so the result doesn't depend on the order in
+       which blocks finish. */
+
+    // Cache-sized sub-chunks within each block, as before
+    constexpr size_t chunkSize = 2048;
+
+    // Aim for several blocks per core so uneven blocks don't serialize,
+    // without making the per-block triangles a memory problem
+    size_t blockSize
+        = std::max<size_t>(chunkSize,
+                           (nx / (8 * Datacratic::numCpus()) + chunkSize - 1)
+                           / chunkSize * chunkSize);
+    size_t numBlocks = (nx + blockSize - 1) / blockSize;
+    size_t triangleSize = nv * (nv + 1) / 2;
+
+    std::vector<std::vector<double> > blockAccum
+        (numBlocks, std::vector<double>(triangleSize, 0.0));
+
+    auto doBlock = [&] (size_t blk)
+        {
+            std::vector<double> & accum = blockAccum[blk];
+            distribution<Float> Xid(chunkSize);
 
-        int x = 0;
-        while (x < nx) {
-            int nxc = std::min<size_t>(chunk_size, nx - x);
+            size_t x1 = std::min(nx, (blk + 1) * blockSize);
+            for (size_t x = blk * blockSize;  x < x1;  x += chunkSize) {
+                size_t nxc = std::min(chunkSize, x1 - x);
 
-            for (unsigned i = 0;  i < nv;  ++i) {
-                SIMD::vec_prod(&XT[i][x], &d[x], &Xid[0], nxc);
-            
-                for (unsigned j = 0;  j < nv;  ++j) {
-                    result[i][j] += SIMD::vec_dotprod_dp(&XT[j][x], &Xid[0], nxc);
+                size_t ofs = 0;
+                for (unsigned i = 0;  i < nv;  ++i) {
+                    SIMD::vec_prod(&XT[i][x], &d[x], &Xid[0], nxc);
+
+                    for (unsigned j = 0;  j <= i;  ++j, ++ofs) {
+                        accum[ofs]
+                            += SIMD::vec_dotprod_dp(&XT[j][x], &Xid[0], nxc);
+                    }
                 }
             }
+        };
 
-            x += nxc;
+    Datacratic::parallelMap(0, numBlocks, doBlock);
+
+    // Merge the per-block triangles and mirror into the full matrix
+    size_t ofs = 0;
+    for (unsigned i = 0;  i < nv;  ++i) {
+        for (unsigned j = 0;  j <= i;  ++j, ++ofs) {
+            double total = 0.0;
+            for (auto & accum: blockAccum)
+                total += accum[ofs];
+            result[i][j] = result[j][i] = total;
         }
-    } else {
-        Datacratic::parallelMap(0, nv, std::bind(doWeightedSquareRow<Float>,
-                                                 std::cref(XT),
-                                                 std::cref(d),
-                                                 std::ref(result),
-                                                 std::placeholders::_1));
     }
-    
+
     return result;
 }
 
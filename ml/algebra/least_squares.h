@@ -12,6 +12,7 @@
 #include "mldb/jml/stats/distribution.h"
 #include <boost/multi_array.hpp>
 #include "mldb/arch/exception.h"
+#include "mldb/arch/simd_vector.h"
 #include "mldb/jml/stats/distribution_simd.h"
 #include "mldb/arch/timers.h"
 #include <iostream>
@@ -241,10 +242,14 @@ diag_mult(const boost::multi_array<Float, 2> & X,
         throw Exception("Incompatible matrix sizes");
     size_t nv = X.shape()[0];
 
+    // d * y only depends on the example, so compute it once and reduce
+    // each variable with a SIMD dot product (accumulated in double)
+    distribution<Float> dy(nx);
+    SIMD::vec_prod(&d[0], &y[0], &dy[0], nx);
+
     distribution<Float> result(nv, 0.0);
     for (unsigned v = 0;  v < nv;  ++v)
-        for (unsigned x = 0;  x < nx;  ++x)
-            result[v] += X[v][x] * d[x] * y[x];
+        result[v] = SIMD::vec_dotprod_dp(&X[v][0], &dy[0], nx);
 
     return result;
 }
@@ -0,0 +1,323 @@
+/** hnsw_index.h                                                   -*- C++ -*-
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Hierarchical Navigable Small World graph index for approximate
+    nearest neighbor searches, after Malkov & Yashunin.  Works over any
+    metric exposed as a distance callback, like the vantage point tree,
+    but answers queries approximately: the ef parameter controls the
+    size of the candidate list and hence the recall/latency tradeoff.
+*/
+
+#pragma once
+
+#include "mldb/jml/db/persistent.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace ML {
+
+template<typename Item>
+struct HnswIndexT {
+
+    HnswIndexT(int M = 16, int efConstruction = 200)
+        : M(M), maxM(M), maxM0(2 * M),
+          efConstruction(std::max(efConstruction, M)),
+          levelMult(1.0 / std::log(double(M))),
+          entryPoint(-1), maxLevel(-1),
+          rng(0 /* deterministic builds */)
+    {
+    }
+
+    /** Build an index over the given items.  The distance function must
+        return the distance between any two of the items; it is called
+        from a single thread.
+    */
+    static HnswIndexT *
+    create(const std::vector<Item> & items,
+           const std::function<float (const Item &, const Item &)> & distance,
+           int M = 16, int efConstruction = 200)
+    {
+        std::unique_ptr<HnswIndexT> result(new HnswIndexT(M, efConstruction));
+        result->items.reserve(items.size());
+        result->levels.reserve(items.size());
+        result->links.reserve(items.size());
+
+        for (auto & item: items)
+            result->add(item, distance);
+
+        return result.release();
+    }
+
+    /** Add one item to the index. */
+    void add(const Item & item,
+             const std::function<float (const Item &, const Item &)> & distance)
+    {
+        int node = items.size();
+        items.push_back(item);
+
+        int level = randomLevel();
+        levels.push_back(level);
+        links.emplace_back(level + 1);
+
+        if (entryPoint == -1) {
+            entryPoint = node;
+            maxLevel = level;
+            return;
+        }
+
+        auto dist = [&] (int other) -> float
+            {
+                return distance(items[node], items[other]);
+            };
+
+        // Greedy descent through the levels above the node's own level
+        int curr = entryPoint;
+        float currDist = dist(curr);
+
+        for (int lc = maxLevel;  lc > level;  --lc)
+            greedyClosest(dist, curr, currDist, lc);
+
+        // On each of the node's own levels, search for candidates and
+        // connect both ways
+        for (int lc = std::min(level, maxLevel);  lc >= 0;  --lc) {
+            auto candidates = searchLayer(dist, curr, efConstruction, lc);
+
+            size_t m = lc == 0 ? maxM0 : maxM;
+
+            for (size_t i = 0;  i < candidates.size() && i < m;  ++i) {
+                int neighbor = candidates[i].second;
+                links[node][lc].push_back(neighbor);
+                addLink(neighbor, node, candidates[i].first, lc, distance);
+            }
+
+            curr = candidates.front().second;
+        }
+
+        if (level > maxLevel) {
+            entryPoint = node;
+            maxLevel = level;
+        }
+    }
+
+    /** Return the at most n closest neighbors, which must all have a
+        distance of no more than maximumDist.  The distance function
+        returns the distance from the query to the given item.
+
+        ef is the size of the candidate list kept while walking the
+        bottom layer of the graph; it must be at least n, and raising it
+        increases recall at the cost of latency.
+    */
+    std::vector<std::pair<float, Item> >
+    search(const std::function<float (const Item &)> & distance,
+           int n, float maximumDist, int ef) const
+    {
+        std::vector<std::pair<float, Item> > result;
+
+        if (entryPoint == -1)
+            return result;
+
+        auto dist = [&] (int node) -> float
+            {
+                return distance(items[node]);
+            };
+
+        int curr = entryPoint;
+        float currDist = dist(curr);
+
+        for (int lc = maxLevel;  lc > 0;  --lc)
+            greedyClosest(dist, curr, currDist, lc);
+
+        auto candidates = searchLayer(dist, curr, std::max(ef, n), 0);
+
+        for (size_t i = 0;
+             i < candidates.size() && result.size() < (size_t)n;
+             ++i) {
+            if (candidates[i].first <= maximumDist)
+                result.emplace_back(candidates[i].first,
+                                    items[candidates[i].second]);
+        }
+
+        return result;
+    }
+
+    size_t size() const
+    {
+        return items.size();
+    }
+
+    size_t memusage() const
+    {
+        size_t result = sizeof(*this)
+            + items.capacity() * sizeof(Item)
+            + levels.capacity() * sizeof(int);
+        for (auto & l: links)
+            for (auto & n: l)
+                result += n.capacity() * sizeof(int);
+        return result;
+    }
+
+    void serialize(DB::Store_Writer & store) const
+    {
+        using namespace ML::DB;
+        store << compact_size_t(1)  // version
+              << M << maxM << maxM0 << efConstruction << levelMult
+              << items << levels << links
+              << entryPoint << maxLevel;
+    }
+
+    void reconstitute(DB::Store_Reader & store)
+    {
+        using namespace ML::DB;
+        compact_size_t version(store);
+        if (version != 1)
+            throw ML::Exception("unknown HNSW index version");
+        store >> M >> maxM >> maxM0 >> efConstruction >> levelMult
+              >> items >> levels >> links
+              >> entryPoint >> maxLevel;
+
+        // The generator state isn't persisted; reseeding on the item
+        // count keeps level draws deterministic for a given index size
+        rng.seed(items.size());
+    }
+
+private:
+    int M;                ///< Number of links requested per node
+    int maxM;             ///< Link capacity on the upper levels
+    int maxM0;            ///< Link capacity on the bottom level
+    int efConstruction;   ///< Candidate list size used when building
+    double levelMult;     ///< Multiplier for the level distribution
+
+    std::vector<Item> items;
+    std::vector<int> levels;              ///< Top level of each node
+    std::vector<std::vector<std::vector<int> > > links;  ///< [node][level]
+
+    int entryPoint;
+    int maxLevel;
+
+    std::mt19937 rng;
+
+    int randomLevel()
+    {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        double r = dist(rng);
+        if (r == 0.0)
+            r = std::numeric_limits<double>::min();
+        return (int)(-std::log(r) * levelMult);
+    }
+
+    /** Move curr to the local minimum of the distance function over the
+        links of the given level.
+    */
+    void greedyClosest(const std::function<float (int)> & dist,
+                       int & curr, float & currDist, int level) const
+    {
+        for (bool improved = true;  improved;  ) {
+            improved = false;
+            for (int neighbor: links[curr][level]) {
+                float d = dist(neighbor);
+                if (d < currDist) {
+                    curr = neighbor;
+                    currDist = d;
+                    improved = true;
+                }
+            }
+        }
+    }
+
+    /** Walk the given level of the graph from the entry node, keeping a
+        candidate list of size ef.  Returns the candidates found, closest
+        first.
+    */
+    std::vector<std::pair<float, int> >
+    searchLayer(const std::function<float (int)> & dist,
+                int entry, size_t ef, int level) const
+    {
+        // Min-heap of nodes to expand, max-heap of results kept
+        typedef std::pair<float, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> >
+            candidates;
+        std::priority_queue<Entry> found;
+
+        std::vector<char> visited(items.size(), false);
+
+        float entryDist = dist(entry);
+        candidates.emplace(entryDist, entry);
+        found.emplace(entryDist, entry);
+        visited[entry] = true;
+
+        while (!candidates.empty()) {
+            Entry curr = candidates.top();
+
+            if (curr.first > found.top().first && found.size() >= ef)
+                break;
+
+            candidates.pop();
+
+            for (int neighbor: links[curr.second][level]) {
+                if (visited[neighbor])
+                    continue;
+                visited[neighbor] = true;
+
+                float d = dist(neighbor);
+
+                if (found.size() < ef || d < found.top().first) {
+                    candidates.emplace(d, neighbor);
+                    found.emplace(d, neighbor);
+                    if (found.size() > ef)
+                        found.pop();
+                }
+            }
+        }
+
+        std::vector<Entry> result(found.size());
+        for (int i = found.size() - 1;  !found.empty();  --i) {
+            result[i] = found.top();
+            found.pop();
+        }
+
+        return result;
+    }
+
+    /** Add a link from one node back to a newly inserted one, pruning
+        the neighbor list back to capacity if it overflows.
+    */
+    void addLink(int from, int to, float distFromTo, int level,
+                 const std::function<float (const Item &, const Item &)> & distance)
+    {
+        std::vector<int> & neighbors = links[from][level];
+        size_t m = level == 0 ? maxM0 : maxM;
+
+        if (neighbors.size() < m) {
+            neighbors.push_back(to);
+            return;
+        }
+
+        // Over capacity: keep the m closest of the existing neighbors
+        // plus the new one
+        std::vector<std::pair<float, int> > byDist;
+        byDist.reserve(neighbors.size() + 1);
+        byDist.emplace_back(distFromTo, to);
+        for (int neighbor: neighbors)
+            byDist.emplace_back(distance(items[from], items[neighbor]),
+                                neighbor);
+
+        std::sort(byDist.begin(), byDist.end());
+        byDist.resize(m);
+
+        neighbors.clear();
+        for (auto & entry: byDist)
+            neighbors.push_back(entry.second);
+    }
+};
+
+typedef HnswIndexT<int> HnswIndex;
+
+} // namespace ML
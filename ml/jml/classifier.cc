@@ -543,6 +543,24 @@ predict(int label,
     return optimized_predict_impl(label, fv, info, context);
 }
 
+void
+Classifier_Impl::
+predict_batch(const float * features,
+              size_t num_rows,
+              size_t feature_stride,
+              const Optimization_Info & info,
+              float * outputs,
+              PredictionContext * context) const
+{
+    size_t nl = label_count();
+
+    for (size_t i = 0;  i < num_rows;  ++i) {
+        Label_Dist result
+            = predict(features + i * feature_stride, info, context);
+        std::copy(result.begin(), result.end(), outputs + i * nl);
+    }
+}
+
 bool
 Classifier_Impl::
 optimize_impl(Optimization_Info & info)
@@ -993,8 +1011,34 @@ operator >> (DB::Store_Reader & store, Classifier & classifier)
     return store;
 }
 
+namespace {
+
+/* Plain local model files are opened through a memory mapping, so the
+   flat-format artifacts page in on demand and replicas of the same model
+   share the page cache.  Anything with a scheme or a compression
+   extension still goes through filter_istream. */
+bool can_memory_map(const std::string & filename)
+{
+    if (filename.find("://") != string::npos) return false;
+    for (const char * ext: { ".gz", ".bz2", ".xz", ".lz4", ".zst" }) {
+        size_t len = strlen(ext);
+        if (filename.size() > len
+            && filename.compare(filename.size() - len, len, ext) == 0)
+            return false;
+    }
+    return true;
+}
+
+} // file scope
+
 void Classifier::load(const std::string & filename)
 {
+    if (can_memory_map(filename)) {
+        Store_Reader store((File_Read_Buffer(filename)));
+        reconstitute(store);
+        return;
+    }
+
     Datacratic::filter_istream stream(filename);
     Store_Reader store(stream);
     reconstitute(store);
@@ -1003,8 +1047,14 @@ void Classifier::load(const std::string & filename)
 void Classifier::
 load(const std::string & filename, std::shared_ptr<const Feature_Space> fs)
 {
+    if (can_memory_map(filename)) {
+        Store_Reader store((File_Read_Buffer(filename)));
+        reconstitute(store, fs);
+        return;
+    }
+
     Datacratic::filter_istream stream(filename);
-    Store_Reader store(filename);
+    Store_Reader store(stream);
     reconstitute(store, fs);
 }
 
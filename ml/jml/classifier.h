@@ -365,6 +365,23 @@ public:
                           const Optimization_Info & info,
                           PredictionContext * context = 0) const;
 
+    /** Score a contiguous block of dense feature vectors in one call.
+        The features for row i start at features + i * feature_stride,
+        laid out exactly as for the single row predict above; the label
+        distribution for row i is written to outputs + i * label_count().
+
+        The default implementation calls the single row predict in a
+        loop; classifiers that support the optimized predict override it
+        to amortize the virtual dispatch and per-call setup over the
+        whole block.
+    */
+    virtual void predict_batch(const float * features,
+                               size_t num_rows,
+                               size_t feature_stride,
+                               const Optimization_Info & info,
+                               float * outputs,
+                               PredictionContext * context = 0) const;
+
     //protected:
 
     /** Function to override to perform the optimization.  Default will
@@ -273,6 +273,38 @@ optimized_predict_impl(int label,
     return results;
 }
 
+void
+Decision_Tree::
+predict_batch(const float * features,
+              size_t num_rows,
+              size_t feature_stride,
+              const Optimization_Info & info,
+              float * outputs,
+              PredictionContext * context) const
+{
+    if (!predict_is_optimized() || !info) {
+        Classifier_Impl::predict_batch(features, num_rows, feature_stride,
+                                       info, outputs, context);
+        return;
+    }
+
+    int nl = label_count();
+
+    float fv[info.features_out()];
+    double accum[nl];
+
+    for (size_t i = 0;  i < num_rows;  ++i) {
+        info.apply(features + i * feature_stride, fv);
+
+        OptimizedGetFeatures get_features(fv);
+        DistResults results(accum, nl);
+
+        predict_recursive_impl(get_features, results, tree.root);
+
+        std::copy(accum, accum + nl, outputs + i * nl);
+    }
+}
+
 template<class GetFeatures, class Results>
 void
 Decision_Tree::
@@ -104,6 +104,17 @@ public:
                            const Optimization_Info & info,
                            PredictionContext * context = 0) const;
 
+    /** Batch predict.  Walks the tree for each row of the block within
+        a single call, so that the per-call setup and virtual dispatch
+        are paid once per block instead of once per row.
+    */
+    virtual void predict_batch(const float * features,
+                               size_t num_rows,
+                               size_t feature_stride,
+                               const Optimization_Info & info,
+                               float * outputs,
+                               PredictionContext * context = 0) const;
+
     template<class GetFeatures, class Results>
     void predict_recursive_impl(const GetFeatures & get_features,
                                 Results & results,
@@ -131,6 +131,7 @@ configure(const Configuration & config)
     config.find(max_depth, "max_depth");
     config.find(update_alg, "update_alg");
     config.find(random_feature_propn, "random_feature_propn");
+    config.find(num_buckets, "num_buckets");
 }
 
 void
@@ -142,6 +143,7 @@ defaults()
     max_depth = -1;
     update_alg = Stump::PROB;
     random_feature_propn = 1.0;
+    num_buckets = DEFAULT_NUM_SPLIT_BUCKETS;
 }
 
 Config_Options
@@ -157,7 +159,10 @@ options() const
         .add("update_alg", update_alg,
              "select the type of output that the tree gives")
         .add("random_feature_propn", random_feature_propn, "0.0-1.0",
-             "proportion of the features to enable (for random forests)");
+             "proportion of the features to enable (for random forests)")
+        .add("num_buckets", num_buckets, "0-",
+             "number of buckets for the histogram split search over dense "
+             "real features.  0 means an exact scan over sorted values");
     
     return result;
 }
@@ -762,6 +767,7 @@ struct TreeTrainer {
     Stump::Update update_alg;
     std::shared_ptr<const Feature_Space> feature_space;
     bool validate;
+    int num_buckets;
 
     TreeTrainer(Tree & tree,
                 int max_depth,
@@ -771,13 +777,15 @@ struct TreeTrainer {
                 int trace,
                 Stump::Update update_alg,
                 std::shared_ptr<const Feature_Space> feature_space,
-                bool validate)
+                bool validate,
+                int num_buckets)
         : tree(tree), max_depth(max_depth),
           features(features), advance(advance),
           predicted(predicted), trace(trace),
           update_alg(update_alg),
           feature_space(feature_space),
-          validate(validate)
+          validate(validate),
+          num_buckets(num_buckets)
     {
         nl = feature_space->info(predicted).value_count();
     }
@@ -981,7 +989,8 @@ struct TreeTrainer {
 
         Accum accum(*feature_space, nl, trace);
         SplitTrainer splitTrainer;
-    
+        splitTrainer.num_buckets = num_buckets;
+
         if (binary_weights.empty())
             splitTrainer.test_all
                 (context, default_w, features, data, predicted,
@@ -1145,7 +1154,7 @@ train_recursive(Thread_Context & context,
 
         TreeTrainer<W, Z> trainer(tree, max_depth, features, advance,
                                   predicted, trace, update_alg, feature_space,
-                                  validate);
+                                  validate, num_buckets);
         return trainer.train(context, data, weights, in_class, binary_weights, depth);
     }
     else {
@@ -1154,7 +1163,7 @@ train_recursive(Thread_Context & context,
         typedef Z_normal Z;
         TreeTrainer<W, Z> trainer(tree, max_depth, features, advance,
                                   predicted, trace, update_alg, feature_space,
-                                  validate);
+                                  validate, num_buckets);
         return trainer.train(context, data, weights, in_class, {} /* binary weights */, depth);
     }
 }
@@ -1244,7 +1253,8 @@ train_recursive_regression(Thread_Context & context,
     
     Accum accum(*model.feature_space(), nl, trace);
     Trainer trainer;
-    
+    trainer.num_buckets = num_buckets;
+
     vector<Feature> features = features_;
     
     /* We need it in a fixed array like this. */
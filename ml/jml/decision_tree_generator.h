@@ -71,6 +71,7 @@ public:
     int trace;
     Stump::Update update_alg;
     float random_feature_propn;
+    int num_buckets;
 
     /* Once init has been called, we clone our potential models from this
        one. */
@@ -17,6 +17,7 @@
 
 #include <limits>
 #include "mldb/jml/utils/vector_utils.h"
+#include "mldb/arch/simd_vector.h"
 #include "mldb/compiler/compiler.h"
 #include "mldb/base/exc_assert.h"
 
@@ -236,6 +237,51 @@ optimized_predict_impl(int label,
     return do_predict_impl(label, features_c, &feature_indexes[0]);
 }
 
+void
+GLZ_Classifier::
+predict_batch(const float * features_c,
+              size_t num_rows,
+              size_t feature_stride,
+              const Optimization_Info & info,
+              float * outputs,
+              PredictionContext * context) const
+{
+    if (!predict_is_optimized() || !info) {
+        Classifier_Impl::predict_batch(features_c, num_rows, feature_stride,
+                                       info, outputs, context);
+        return;
+    }
+
+    size_t nf = features.size();
+    size_t nl = label_count();
+    const int * indexes = &feature_indexes[0];
+
+    float fv[info.features_out()];
+
+    // Decoded feature vector for the current row, with the bias term
+    // appended so that each label is one dot product against its whole
+    // weight vector
+    distribution<float> decoded(nf + add_bias);
+    if (add_bias)
+        decoded[nf] = 1.0f;
+
+    for (size_t i = 0;  i < num_rows;  ++i) {
+        info.apply(features_c + i * feature_stride, fv);
+
+        for (unsigned j = 0;  j < nf;  ++j)
+            decoded[j] = decode_value(fv[indexes[j]], features[j]);
+
+        float * out = outputs + i * nl;
+
+        for (unsigned o = 0;  o < nl;  ++o) {
+            double accum = SIMD::vec_dotprod_dp(&decoded[0],
+                                                &weights[o][0],
+                                                nf + add_bias);
+            out[o] = apply_link_inverse(accum, link);
+        }
+    }
+}
+
 float
 GLZ_Classifier::
 decode_value(float feat_val, const Feature_Spec & spec) const
@@ -401,7 +447,7 @@ std::string GLZ_Classifier::summary() const
 namespace {
 
 static const std::string GLZ_CLASSIFIER_MAGIC = "GLZ_CLASSIFIER";
-static const compact_size_t GLZ_CLASSIFIER_VERSION = 4;
+static const compact_size_t GLZ_CLASSIFIER_VERSION = 5;
 
 } // file scope
 
@@ -414,7 +460,20 @@ void GLZ_Classifier::serialize(DB::Store_Writer & store) const
 {
     store << GLZ_CLASSIFIER_MAGIC << GLZ_CLASSIFIER_VERSION;
     feature_space()->serialize(store, predicted_);
-    store << (int)add_bias << weights << link;
+    store << (int)add_bias;
+    /* Version 5: the weight matrix is written as bulk float rows so the
+       whole thing loads with a handful of reads instead of one decode
+       per coefficient. */
+    size_t nw = weights.empty() ? 0 : weights[0].size();
+    for (unsigned i = 0;  i < weights.size();  ++i)
+        if (weights[i].size() != nw)
+            throw Exception("GLZ_Classifier::serialize(): "
+                            "ragged weights matrix");
+    store << compact_size_t(weights.size()) << compact_size_t(nw);
+    for (unsigned i = 0;  i < weights.size();  ++i)
+        if (nw != 0)
+            store.save_binary(&weights[i][0], nw * sizeof(float));
+    store << link;
     store << compact_size_t(features.size());
     for (unsigned i = 0;  i < features.size();  ++i) {
         feature_space_->serialize(store, features[i].feature);
@@ -449,8 +508,18 @@ reconstitute(DB::Store_Reader & store)
         feature_space()->reconstitute(store, predicted_);
     
     int add_bias_;  store >> add_bias_;  add_bias = add_bias_;
-    store >> weights >> link;
-    
+    if (version >= 5) {
+        compact_size_t nl(store), nw(store);
+        weights.resize(nl);
+        for (unsigned i = 0;  i < weights.size();  ++i) {
+            weights[i].resize(nw);
+            if (nw != 0)
+                store.load_binary(&weights[i][0], nw * sizeof(float));
+        }
+        store >> link;
+    }
+    else store >> weights >> link;
+
     compact_size_t nf(store);
     features.resize(nf);
 
@@ -465,7 +534,7 @@ reconstitute(DB::Store_Reader & store)
             features[i].type = Feature_Spec::Type(c);
         }
     }
-    else if (version <= 4) {
+    else if (version <= 5) {
         for (unsigned i = 0;  i < features.size();  ++i) {
             feature_space_->reconstitute(store, features[i].feature);
             char c;  store >> c;
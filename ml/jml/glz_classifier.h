@@ -150,6 +150,16 @@ public:
                            const Optimization_Info & info,
                            PredictionContext * context = 0) const;
 
+    /** Batch predict.  Decodes each row once, then scores every label
+        with a dense dot product against its weight vector.
+    */
+    virtual void predict_batch(const float * features,
+                               size_t num_rows,
+                               size_t feature_stride,
+                               const Optimization_Info & info,
+                               float * outputs,
+                               PredictionContext * context = 0) const;
+
 #ifndef JML_TESTING_GLZ_CLASSIFIER
 protected:
 #endif
@@ -164,6 +164,25 @@ struct Stump_Accum {
     /** Method that gets called when we have found a potential split point. */
     float add(const Feature & feature, const W & w, float arg, float z)
     {
+        /* Reject candidates that can't change the result before touching
+           the lock.  Both z_best and z_needed only ever decrease, so a
+           stale value read without the lock is conservative: we may take
+           the lock for a candidate that has since been beaten, but we
+           never drop one that should have been kept.  (start() already
+           reads z_best unlocked the same way.)  When every feature is
+           being tested on a separate worker, nearly every candidate
+           split point is rejected here, so the workers no longer
+           serialize on the lock.  Fair mode keeps candidates that tie
+           the best, so only strictly worse ones are rejected.  (best
+           only ever grows from empty, so its emptiness check is
+           conservative too.) */
+        if (!tracer) {
+            if (!z_equal(z, z_needed) && z_needed < z) return z;
+            if (num_results == 1 && !best.empty()
+                && !z_equal(z, z_best) && z_best < z)
+                return z;
+        }
+
         Guard JML_UNUSED guard(lock);
 
         if (tracer)
@@ -30,6 +30,10 @@ extern size_t num_bucketed, num_non_bucketed;
 extern size_t num_real_early, num_real_not_early;
 extern size_t num_bucket_early, num_bucket_not_early;
 
+/// Default number of buckets for the histogram-based split search over
+/// dense real-valued features.
+static constexpr int DEFAULT_NUM_SPLIT_BUCKETS = 255;
+
 
 
 /** Compare two Z values, and return true if they are equal within a small
@@ -164,15 +168,25 @@ JML_ALWAYS_INLINE int get_advance(const std::vector<const float *> & weights)
 
 template<class W, class Z, class Tracer=No_Trace>
 struct Stump_Trainer {
-    Stump_Trainer() {}
-    
+    Stump_Trainer()
+        : num_buckets(DEFAULT_NUM_SPLIT_BUCKETS)
+    {
+    }
+
     Stump_Trainer(const Tracer & tracer)
-        : tracer(tracer)
+        : tracer(tracer), num_buckets(DEFAULT_NUM_SPLIT_BUCKETS)
     {
     }
 
     mutable Tracer tracer;  ///< Object to which we trace
 
+    /** Number of buckets used by the histogram-based split search over
+        dense real-valued features.  Fewer buckets mean fewer candidate
+        split points to evaluate, which is faster but coarser.  A value
+        of zero or less disables bucketing and forces the exact scan over
+        sorted feature values. */
+    int num_buckets;
+
     /** This is an object used for example weights which acts as a vector
         of all 1s.  It specifies that each example counts for the same
         amount, without needing to use any memory.
@@ -898,10 +912,9 @@ struct Stump_Trainer {
            slower).
         */
 
-        if (data.index().density(feature) > 0.2)
+        if (num_buckets > 0 && data.index().density(feature) > 0.2)
             return test_buckets(feature, data, predicted, weights, ex_weights,
-                                default_w, results,
-                                255 /* num_buckets; TODO: configurable */,
+                                default_w, results, num_buckets,
                                 false /* categorical */,
                                 advance);
 
@@ -12,6 +12,7 @@
 #include "mldb/jml/db/persistent.h"
 #include "mldb/ml/jml/feature_space.h"
 
+#include <cstring>
 #include <mutex>
 #include <boost/pool/object_pool.hpp>
 
@@ -22,6 +23,78 @@ using namespace ML::DB;
 
 namespace ML {
 
+namespace {
+
+/* On-disk record for the flat tree format (Tree serialization version 2).
+   Nodes and leafs share the one fixed-width layout, laid out in pre-order
+   so that a child always has a higher index than its parent.  The
+   predictions of all records are concatenated into a single float array
+   and referenced by offset, so the whole tree round-trips as two bulk
+   reads instead of one recursive descent with per-field framing. */
+struct Flat_Record {
+    int32_t  feature[3];     ///< Split feature ids; unused for a leaf
+    float    split_val;      ///< Split value; unused for a leaf
+    float    z;              ///< Z score of the split; unused for a leaf
+    float    examples;       ///< Number of examples at this point
+    uint32_t op;             ///< Split::Op, or FLAT_LEAF for a leaf
+    uint32_t pred_offset;    ///< Start of prediction in the float array
+    uint32_t pred_size;      ///< Number of prediction values
+    int32_t  child_true;     ///< Record index of child, or -1 for none
+    int32_t  child_false;
+    int32_t  child_missing;
+};
+
+const uint32_t FLAT_LEAF = (uint32_t)-1;
+
+int32_t
+flatten_recursive(const Tree::Ptr & ptr,
+                  std::vector<Flat_Record> & records,
+                  std::vector<float> & preds)
+{
+    if (!ptr) return -1;
+
+    Flat_Record rec;
+    std::memset(&rec, 0, sizeof(rec));
+
+    rec.pred_offset = preds.size();
+    rec.pred_size = ptr.pred().size();
+    preds.insert(preds.end(), ptr.pred().begin(), ptr.pred().end());
+    rec.examples = ptr.examples();
+    rec.child_true = rec.child_false = rec.child_missing = -1;
+
+    if (const Tree::Node * node = ptr.node()) {
+        const Feature & feature = node->split.feature();
+        rec.feature[0] = feature.type();
+        rec.feature[1] = feature.arg1();
+        rec.feature[2] = feature.arg2();
+        rec.split_val = node->split.split_val();
+        rec.op = node->split.op();
+        rec.z = node->z;
+    }
+    else rec.op = FLAT_LEAF;
+
+    int32_t index = records.size();
+    records.push_back(rec);
+
+    if (const Tree::Node * node = ptr.node()) {
+        /* Fill the children in afterwards via the index; the vector may
+           reallocate while they are being flattened. */
+        int32_t child_true = flatten_recursive(node->child_true,
+                                               records, preds);
+        int32_t child_false = flatten_recursive(node->child_false,
+                                                records, preds);
+        int32_t child_missing = flatten_recursive(node->child_missing,
+                                                  records, preds);
+        records[index].child_true = child_true;
+        records[index].child_false = child_false;
+        records[index].child_missing = child_missing;
+    }
+
+    return index;
+}
+
+} // file scope
+
 
 /*****************************************************************************/
 /* TREE::NODE                                                                */
@@ -270,8 +343,25 @@ Tree::new_leaf()
 void Tree::
 serialize(DB::Store_Writer & store, const Feature_Space & fs) const
 {
-    store << compact_size_t(1);  // version
-    root.serialize(store, fs);
+    /* Version 2 is the flat format: a pre-order array of fixed-width
+       records with index-based child links, plus one float array holding
+       every prediction.  Features are stored as their raw id triplets,
+       which is what Feature_Space::serialize writes anyway.  A 2GB
+       forest reconstitutes with bulk reads instead of millions of
+       per-field decodes. */
+    std::vector<Flat_Record> records;
+    std::vector<float> preds;
+    flatten_recursive(root, records, preds);
+
+    store << compact_size_t(2);  // version
+    store << compact_size_t(records.size())
+          << compact_size_t(preds.size());
+    if (!records.empty())
+        store.save_binary(&records[0],
+                          records.size() * sizeof(Flat_Record));
+    if (!preds.empty())
+        store.save_binary(&preds[0], preds.size() * sizeof(float));
+
     store << compact_size_t(3212345);  // end marker
     store << string("END_TREE");
 }
@@ -285,6 +375,61 @@ reconstitute(DB::Store_Reader & store, const Feature_Space & fs)
         root.reconstitute(store, fs, *this);
         break;
     }
+    case 2: {
+        compact_size_t num_records(store);
+        compact_size_t num_preds(store);
+
+        std::vector<Flat_Record> records(num_records);
+        std::vector<float> preds(num_preds);
+        if (!records.empty())
+            store.load_binary(&records[0],
+                              records.size() * sizeof(Flat_Record));
+        if (!preds.empty())
+            store.load_binary(&preds[0], preds.size() * sizeof(float));
+
+        /* A child always has a higher index than its parent, so building
+           back to front means the children of a record are always
+           finished before the record itself. */
+        std::vector<Ptr> built(records.size());
+
+        auto get_child = [&] (int32_t index, int32_t parent) -> Ptr
+            {
+                if (index == -1) return Ptr();
+                if (index <= parent || index >= (int32_t)records.size())
+                    throw Exception("Tree::reconstitute: "
+                                    "flat record child index out of range");
+                return built[index];
+            };
+
+        for (int32_t i = records.size() - 1;  i >= 0;  --i) {
+            const Flat_Record & rec = records[i];
+            if (rec.pred_offset + (size_t)rec.pred_size > preds.size())
+                throw Exception("Tree::reconstitute: "
+                                "flat record prediction out of range");
+            distribution<float>
+                pred(preds.begin() + rec.pred_offset,
+                     preds.begin() + rec.pred_offset + rec.pred_size);
+
+            if (rec.op == FLAT_LEAF)
+                built[i] = new_leaf(pred, rec.examples);
+            else {
+                Node * node = new_node();
+                node->split = Split(Feature(rec.feature[0], rec.feature[1],
+                                            rec.feature[2]),
+                                    rec.split_val, (Split::Op)rec.op);
+                node->z = rec.z;
+                node->pred = pred;
+                node->examples = rec.examples;
+                node->child_true = get_child(rec.child_true, i);
+                node->child_false = get_child(rec.child_false, i);
+                node->child_missing = get_child(rec.child_missing, i);
+                built[i] = node;
+            }
+        }
+
+        if (!built.empty()) root = built[0];
+        break;
+    }
     default:
         throw Exception("Decision tree: Attempt to reconstitute tree of "
                         "unknown version " + ostream_format(version.size_));
@@ -10,6 +10,7 @@
 #include "kmeans.h"
 
 #include <boost/random/mersenne_twister.hpp>
+#include "mldb/arch/simd_vector.h"
 #include "mldb/jml/utils/smart_ptr_utils.h"
 #include <boost/random/uniform_int.hpp>
 
@@ -21,7 +22,8 @@ train(const std::vector<distribution<float>> & points,
       std::vector<int> & in_cluster,
       int nbClusters,
       int maxIterations,
-      int randomSeed
+      int randomSeed,
+      int minibatchSize
       )
 {
     using namespace std;
@@ -80,6 +82,86 @@ train(const std::vector<distribution<float>> & points,
         // cerr << "norm of best init centroid " << clusters[i].centroid.two_norm() << endl;
     }
 
+    size_t dim = points[0].size();
+
+    // For the Euclidean metric, the closest centroid to x is
+    // argmin ||c||^2 - 2 x.c since the ||x||^2 term is the same for every
+    // centroid.  That turns assignment into dot products over the centroid
+    // matrix, which the SIMD kernels do much faster than the generic
+    // per-point distance loop.
+    bool euclidean
+        = dynamic_cast<const KMeansEuclideanMetric *>(metric.get()) != nullptr;
+
+    distribution<float> centroidNormSq(nbClusters);
+
+    auto updateCentroidNorms = [&] ()
+        {
+            if (!euclidean)
+                return;
+            for (int k = 0;  k < nbClusters;  ++k)
+                centroidNormSq[k]
+                    = SIMD::vec_dotprod(&clusters[k].centroid[0],
+                                        &clusters[k].centroid[0], dim);
+        };
+
+    auto bestCluster = [&] (const distribution<float> & point) -> int
+        {
+            if (!euclidean)
+                return this->assign(point);
+
+            float distMin = INFINITY;
+            int best_cluster = -1;
+            for (int k = 0;  k < nbClusters;  ++k) {
+                float dist = centroidNormSq[k]
+                    - 2.0f * SIMD::vec_dotprod(&point[0],
+                                               &clusters[k].centroid[0], dim);
+                if (dist < distMin) {
+                    distMin = dist;
+                    best_cluster = k;
+                }
+            }
+            // Points with nan distances go in cluster 0, like assign()
+            if (best_cluster == -1)
+                best_cluster = 0;
+            return best_cluster;
+        };
+
+    if (minibatchSize > 0 && minibatchSize < npoints) {
+        // Mini-batch k-means: each iteration pulls the centroids towards a
+        // random sample of the points, with a per-centroid learning rate
+        // that decays with the number of updates the centroid has received.
+        std::vector<int> batch(minibatchSize);
+        std::vector<int> batchCluster(minibatchSize);
+        std::vector<size_t> updateCount(nbClusters, 0);
+
+        for (int iter = 0;  iter < maxIterations;  ++iter) {
+            updateCentroidNorms();
+
+            for (auto & b: batch)
+                b = rng() % npoints;
+
+            auto assignBlock = [&] (size_t first, size_t last)
+                {
+                    for (size_t i = first;  i < last;  ++i)
+                        batchCluster[i] = bestCluster(points[batch[i]]);
+                };
+
+            Datacratic::parallelMapChunked(0, minibatchSize, 1024,
+                                           assignBlock);
+
+            for (int i = 0;  i < minibatchSize;  ++i) {
+                int cluster = batchCluster[i];
+                double eta = 1.0 / ++updateCount[cluster];
+                clusters[cluster].centroid *= (1.0 - eta);
+                metric->contributeToAverage(clusters[cluster].centroid,
+                                            points[batch[i]], eta);
+            }
+        }
+
+        // The full pass below assigns every point to its final cluster and
+        // replaces the centroids with exact means.
+        maxIterations = 1;
+    }
 
     for (int iter = 0;  iter < maxIterations;  ++iter) {
 
@@ -104,9 +186,11 @@ train(const std::vector<distribution<float>> & points,
 
         std::vector<AI> clusterNumMembers(nbClusters);
 
-        auto findNewCluster = [&] (int i) {
+        updateCentroidNorms();
+
+        auto findNewCluster = [&] (size_t i) {
 
-            int best_cluster = this->assign(points[i]);
+            int best_cluster = bestCluster(points[i]);
 
             if (best_cluster != in_cluster[i]) {
                 ++changes;
@@ -116,7 +200,14 @@ train(const std::vector<distribution<float>> & points,
             ++clusterNumMembers[best_cluster];
         };
 
-        Datacratic::parallelMap(0, points.size(), findNewCluster);
+        auto findNewClusterBlock = [&] (size_t first, size_t last)
+            {
+                for (size_t i = first;  i < last;  ++i)
+                    findNewCluster(i);
+            };
+
+        Datacratic::parallelMapChunked(0, points.size(), 1024,
+                                       findNewClusterBlock);
 
         for (unsigned i = 0;  i < nbClusters;  ++i)
             clusters[i].nbMembers = clusterNumMembers[i];
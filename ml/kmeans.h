@@ -145,11 +145,18 @@ struct KMeans {
     std::vector<Cluster> clusters;
     std::shared_ptr<KMeansMetric> metric;
     
+    /** Train the clustering.  If minibatchSize is non-zero, each iteration
+        refines the centroids from a random sample of that many points
+        instead of a full pass (mini-batch k-means), which converges much
+        faster on very large datasets; a final full pass assigns every
+        point to its cluster.
+    */
     void train(const std::vector<distribution<float> > & points,
                std::vector<int> & in_cluster,
                int nclusters=100,
                int maxIterations = 100,
-               int randomSeed = 1);
+               int randomSeed = 1,
+               int minibatchSize = 0);
 
     distribution<float> centroidDistances(const distribution<float> & point) const;
 
@@ -91,12 +91,12 @@ struct PartitionData {
                     return;
 
                 size_t n = 0;
+                BucketListCursor buckets(features[f].buckets);
                 for (size_t i = 0;  i < rows.size();  ++i) {
                     if (weights[i] == 0)
                         continue;
 
-                    uint32_t bucket = features[f].buckets[rows[i].exampleNum];
-                    featureBuckets[f].write(bucket);
+                    featureBuckets[f].write(buckets(rows[i].exampleNum));
                     ++n;
                 }
 
@@ -226,9 +226,20 @@ struct PartitionData {
 
         double useRatio = 1.0 * rows.size() / rows.back().exampleNum;
 
-        //todo: Re-index when usable data fits inside cache
-        bool reIndex = useRatio < 0.1;
-        //reIndex = false;
+        // Re-index (rewrite the bucket lists so this node's rows are
+        // contiguous) when the subset is sparse within the storage, or
+        // when the re-indexed feature data would fit in cache, where
+        // contiguous per-node storage pays for the copy almost
+        // immediately as the tree deepens.
+        size_t activeBits = 0;
+        for (auto & f: features)
+            if (f.active)
+                activeBits += f.buckets.entryBits;
+        size_t reindexedBytes = rows.size() * activeBits / 8;
+        static constexpr size_t REINDEX_CACHE_BYTES = 4 * 1024 * 1024;
+
+        bool reIndex = useRatio < 0.1
+            || (useRatio < 0.75 && reindexedBytes <= REINDEX_CACHE_BYTES);
         //cerr << "useRatio = " << useRatio << endl;
 
         if (!reIndex) {
@@ -236,14 +247,10 @@ struct PartitionData {
             sides[0].rows.reserve(rows.size());
             sides[1].rows.reserve(rows.size());
 
-            //this is for debug only
-            //int maxBucket = 0;
-            //int minBucket = INFINITY;
+            BucketListCursor buckets(features[featureToSplitOn].buckets);
 
             for (size_t i = 0;  i < rows.size();  ++i) {
-                int bucket = features[featureToSplitOn].buckets[rows[i].exampleNum];
-                //maxBucket = std::max(maxBucket, bucket);
-                //minBucket = std::min(minBucket, bucket);
+                int bucket = buckets(rows[i].exampleNum);
                 int side = ordinal ? bucket > splitValue : bucket != splitValue;
                 sides[side].addRow(rows[i]);
             }
@@ -280,8 +287,10 @@ struct PartitionData {
             sides[0].rows.reserve(rows.size());
             sides[1].rows.reserve(rows.size());
 
+            BucketListCursor splitBuckets(features[featureToSplitOn].buckets);
+
             for (size_t i = 0;  i < rows.size();  ++i) {
-                int bucket = features[featureToSplitOn].buckets[rows[i].exampleNum];
+                int bucket = splitBuckets(rows[i].exampleNum);
                 int side = ordinal ? bucket > splitValue : bucket != splitValue;
                 lr[i] = side;
                 sides[side].addRow(rows[i].label, rows[i].weight, numOnSide[side]++);
@@ -296,9 +305,11 @@ struct PartitionData {
                 newFeatures[1].init(numOnSide[1], features[i].info->distinctValues);
                 size_t index[2] = { 0, 0 };
 
+                BucketListCursor buckets(features[i].buckets);
+
                 for (size_t j = 0;  j < rows.size();  ++j) {
                     int side = lr[j];
-                    newFeatures[side].write(features[i].buckets[rows[j].exampleNum]);
+                    newFeatures[side].write(buckets(rows[j].exampleNum));
                     ++index[side];
                 }
 
@@ -372,9 +383,11 @@ struct PartitionData {
                 bool twoBuckets = false;
                 int lastBucket = -1;
 
+                BucketListCursor buckets(features[i].buckets);
+
                 for (size_t j = 0;  j < rows.size();  ++j) {
                     auto & r = rows[j];
-                    int bucket = features[i].buckets[r.exampleNum];
+                    int bucket = buckets(r.exampleNum);
 
                     twoBuckets = twoBuckets
                         || (lastBucket != -1 && bucket != lastBucket);
@@ -1504,6 +1504,68 @@ operator () (int x1, int x2) const
     return sqrtf(dist);
 }
 
+/* Accumulate the attractive force on a 2D point from its sparse
+   neighbours.  Two neighbours are processed per iteration, with the
+   (p - q) factors and coordinate differences computed four lanes at a
+   time; accumulation is in double precision via vec_f2d, as in
+   calc_D_row above. */
+inline void
+calc_attr_2d(const float * y,
+             const TsneSparseProbs & neighbours,
+             const boost::multi_array<float, 2> & Y,
+             float pFactor,
+             double * Fattr)
+{
+    using namespace SIMD;
+
+    int nn = neighbours.indexes.size();
+
+    v4sf yyyy = { y[0], y[1], y[0], y[1] };
+    v4sf pfpf = vec_splat(pFactor);
+    v4sf one  = vec_splat(1.0f);
+    v2df rr   = vec_splat(0.0);
+
+    unsigned q = 0;
+    for (;  q + 2 <= nn;  q += 2) {
+        int j0 = neighbours.indexes[q];
+        int j1 = neighbours.indexes[q + 1];
+
+        v4sf yjyj = { Y[j0][0], Y[j0][1], Y[j1][0], Y[j1][1] };
+        v4sf dddd = yyyy - yjyj;
+        v4sf ssss = dddd * dddd;
+
+        // Horizontal add within each pair: D0 D0 D1 D1
+        v4sf DDDD = ssss + _mm_shuffle_ps(ssss, ssss, 0xb1);
+
+        v4sf ffff = { neighbours.probs[q],     neighbours.probs[q],
+                      neighbours.probs[q + 1], neighbours.probs[q + 1] };
+        ffff = ffff * pfpf / (one + DDDD);
+
+        v4sf xxxx = dddd * ffff;
+
+        // Both halves hold an (x, y) contribution
+        v2df xx0, xx1;
+        vec_f2d(xxxx, xx0, xx1);
+        rr = rr + xx0;
+        rr = rr + xx1;
+    }
+
+    double results[2];
+    *(v2df *)results = rr;
+    Fattr[0] += results[0];
+    Fattr[1] += results[1];
+
+    for (;  q < nn;  ++q) {
+        int j = neighbours.indexes[q];
+        float d0 = y[0] - Y[j][0];
+        float d1 = y[1] - Y[j][1];
+        double D = d0 * d0 + d1 * d1;
+        double factorAttr = pFactor * neighbours.probs[q] / (1.0 + D);
+        Fattr[0] += d0 * factorAttr;
+        Fattr[1] += d1 * factorAttr;
+    }
+}
+
 // Object we keep around to calculate the repulsive force, by iterating over the
 // quadtree.  We primarily use a separate object to avoid the overhead in passing
 // all of these parameters around.
@@ -1846,13 +1908,13 @@ tsneApproxFromSparse(const std::vector<TsneSparseProbs> & exampleNeighbours,
         bool calcC = iter < 10 || (iter + 1) % 100 == 0 || iter == params.max_iter - 1;
         //calcC = true;
 
-        // Approximation for Z, accumulated here
+        // Approximation for Z, accumulated here (one entry per chunk)
         ML::Spinlock Zmutex;
         std::vector<double> ZApproxValues;
-        ZApproxValues.reserve(nx);
+        ZApproxValues.reserve((nx + 255) / 256);
 
 
-        auto calcExample = [&] (int x)
+        auto calcExample = [&] (int x) -> double
             {
                 // Clear the updates
                 for (unsigned i = 0;  i < nd;  ++i) {
@@ -1870,40 +1932,28 @@ tsneApproxFromSparse(const std::vector<TsneSparseProbs> & exampleNeighbours,
 
                 // For each neighbour, calculate the attractive force.  The
                 // others are defined as zero.
-                for (unsigned q = 0;  q < neighbours.indexes.size();  ++q) {
-                    
-                    unsigned j = neighbours.indexes[q];
-                    ExcAssertNotEqual(j, x);
-
-                    double D = 0.0;
-                    if (nd == 2) {
-                        float d0 = y[0] - Y[j][0];
-                        float d1 = y[1] - Y[j][1];
-                        D = d0 * d0 + d1 * d1;
-                    } else {
+                //
+                // Note that 1/(1 + D[j]) == Q[j] * Z
+                // See van der Marten, 2013 http://arxiv.org/pdf/1301.3342.pdf
+                // Barnes-Hut-SNE
+                if (nd == 2) {
+                    calc_attr_2d(&y[0], neighbours, Y, pFactor,
+                                 &FattrApprox[x][0]);
+                }
+                else {
+                    for (unsigned q = 0;  q < neighbours.indexes.size();  ++q) {
+
+                        unsigned j = neighbours.indexes[q];
+                        ExcAssertNotEqual(j, x);
+
+                        double D = 0.0;
                         for (unsigned i = 0;  i < nd;  ++i) {
                             D += (y[i] - Y[j][i]) * (y[i] - Y[j][i]);
                         }
-                    }
-
-                    //if (x == 0 && j == 1) {
-                    //    cerr << "D[0][1] approx = " << D << " prob "
-                    //         << neighbours.probs[q] << endl;
-                    //}
-
-                    // Note that 1/(1 + D[j]) == Q[j] * Z
-                    // See van der Marten, 2013 http://arxiv.org/pdf/1301.3342.pdf
-                    // Barnes-Hut-SNE
 
-                    double factorAttr = pFactor * neighbours.probs[q] / (1.0 + D);
+                        double factorAttr
+                            = pFactor * neighbours.probs[q] / (1.0 + D);
 
-                    if (nd == 2) {
-                        float dYj0 = y[0] - Y[j][0];
-                        float dYj1 = y[1] - Y[j][1];
-                        FattrApprox[x][0] += dYj0 * factorAttr;
-                        FattrApprox[x][1] += dYj1 * factorAttr;
-                    }
-                    else {
                         for (unsigned i = 0;  i < nd;  ++i) {
                             double dYji = y[i] - Y[j][i];
                             FattrApprox[x][i] += dYji * factorAttr;
@@ -1986,43 +2036,28 @@ tsneApproxFromSparse(const std::vector<TsneSparseProbs> & exampleNeighbours,
                             nullptr, {}, nullptr, params.min_distance_ratio);
                 }
 
-                {
-                    std::unique_lock<ML::Spinlock> guard(Zmutex);
-                    ZApproxValues.push_back(exampleZ);
-                }
-
                 //if (x == 1026)
                 //    cerr << "touched " << nodesTouched << " of " << numNodes << " nodes"
                 //         << endl;
-            };
 
-#if 1
-        int totalThreads = std::max(1, std::min(16, Datacratic::numCpus() / 2));
+                return exampleZ;
+            };
 
-        auto doThread = [&] (int n)
+        // Spread the tree traversals over all cores in small chunks, so
+        // that expensive points don't serialize on a fixed partitioning.
+        // Each chunk accumulates its Z contribution locally and touches
+        // the shared accumulator once.
+        auto doChunk = [&] (size_t x0, size_t x1)
             {
-                int perThread = nx / totalThreads;
-                int start = n * perThread;
-                int end = start + perThread;
-                if (n == totalThreads)
-                    end = nx;
-
-                for (unsigned x = start;  x < end;  ++x)
-                    calcExample(x);
+                double chunkZ = 0.0;
+                for (size_t x = x0;  x < x1;  ++x)
+                    chunkZ += calcExample(x);
 
-                //for (unsigned x = n;  x < nx;  x += totalThreads) {
-                //    calcExample(x);
-                //}
+                std::unique_lock<ML::Spinlock> guard(Zmutex);
+                ZApproxValues.push_back(chunkZ);
             };
 
-        Datacratic::parallelMap(0, totalThreads, doThread);
-        //parallelMap(0, nx, calcExample);
-#else
-        // Each example proceeds more or less independently
-        for (unsigned x = 0;  x < nx;  ++x) {
-            calcExample(x);
-        }
-#endif
+        Datacratic::parallelMapChunked(0, nx, 256, doChunk);
 
         // Sort from smallest to largest to accumulate.  This minimises
         // rounding errors and makes the result independent of the order
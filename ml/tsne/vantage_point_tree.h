@@ -469,6 +469,61 @@ struct VantagePointTreeT {
         return result;
     }
 
+    /** Insert a single item into an already-built tree.  The item
+        descends to the subtree its pivot distances put it in, so the
+        stored radii stay valid and searches remain exact; the tree is
+        not rebalanced, so this is meant for topping up a large tree
+        with a small number of new items, not for building one.
+
+        The distance function returns the distance from the new item to
+        the given item, like the one passed to search().
+    */
+    void insert(Item item, const std::function<float (Item)> & distance)
+    {
+        if (items.empty()) {
+            // Empty tree; the item becomes a leaf
+            items.push_back(item);
+            radius = std::numeric_limits<float>::quiet_NaN();
+            return;
+        }
+
+        float pivotDistance = distance(items.at(0));
+
+        if (pivotDistance == 0.0f) {
+            items.push_back(item);
+            return;
+        }
+
+        if (!clump.empty()) {
+            // Clump nodes have no children and are scanned exhaustively
+            // by search(), so the item simply joins the clump
+            clump.push_back(item);
+            std::sort(clump.begin(), clump.end());
+            return;
+        }
+
+        if (!inside && !outside) {
+            // Leaf node; the pivot distance becomes the radius and the
+            // item starts the inside subtree
+            radius = pivotDistance;
+            inside.reset(new VantagePointTreeT(item));
+            return;
+        }
+
+        if (pivotDistance <= radius) {
+            if (inside)
+                inside->insert(item, distance);
+            else
+                inside.reset(new VantagePointTreeT(item));
+        }
+        else {
+            if (outside)
+                outside->insert(item, distance);
+            else
+                outside.reset(new VantagePointTreeT(item));
+        }
+    }
+
     /** Create a deep copy of the given node.  This also works for
         null pointers.
     */
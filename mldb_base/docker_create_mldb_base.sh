@@ -79,6 +79,7 @@ apt-get install -y \
     libboost-filesystem1.54.0 \
     libgoogle-perftools4 \
     liblzma5 \
+    libzstd1 \
     libbz2-1.0 \
     libcrypto++9 \
     libv8-3.14.5 \
@@ -85,6 +85,21 @@ AccuracyConfigDescription()
               "test set is very large and aggregate statistics for each unique score is "
               "sufficient, for instance to generate a ROC curve. This has no effect "
               "for other values of `mode`.", false);
+    addField("streamingBins", &AccuracyConfig::streamingBins,
+             "If non-zero and `mode` is `boolean`, the evaluation runs as a "
+             "single parallel pass that bins scores into this many histogram "
+             "buckets instead of collecting and sorting every example.  "
+             "Memory use is constant in the number of examples and the ROC "
+             "curve, AUC and best points are computed per bin boundary, so "
+             "thresholds are quantized to the bin width.  10000 bins is "
+             "plenty for most uses.  Has no effect for other values of "
+             "`mode`.", 0);
+    addField("streamingScoreMin", &AccuracyConfig::streamingScoreMin,
+             "Lower end of the score range covered by `streamingBins`; "
+             "scores below it land in the first bin.", 0.0);
+    addField("streamingScoreMax", &AccuracyConfig::streamingScoreMax,
+             "Upper end of the score range covered by `streamingBins`; "
+             "scores above it land in the last bin.", 1.0);
     addParent<ProcedureConfig>();
 
     onPostValidate = validateQuery(&AccuracyConfig::testingData,
@@ -119,11 +134,194 @@ getStatus() const
     return Any();
 }
 
+/** Streaming boolean evaluation: one parallel pass accumulating
+    per-thread score histograms, merged and walked from the highest bin
+    down to produce the same ROC/AUC outputs as the exact path, with
+    thresholds quantized to the bin width.  Memory is constant in the
+    number of examples.
+*/
+RunOutput
+runBooleanStreaming(AccuracyConfig & runAccuracyConf,
+                    BoundSelectQuery & selectQuery,
+                    std::shared_ptr<Dataset> output)
+{
+    int numBins = runAccuracyConf.streamingBins;
+    double scoreMin = runAccuracyConf.streamingScoreMin;
+    double scoreMax = runAccuracyConf.streamingScoreMax;
+
+    if (scoreMax <= scoreMin)
+        throw HttpReturnException(400, "streamingScoreMax must be greater "
+                                  "than streamingScoreMin");
+
+    struct Histogram {
+        std::vector<double> pos, neg;        ///< weighted counts per bin
+        std::vector<uint64_t> posN, negN;    ///< example counts per bin
+    };
+
+    PerThreadAccumulator<Histogram> accum;
+
+    double binWidth = (scoreMax - scoreMin) / numBins;
+
+    auto binOf = [=] (double score) -> int
+        {
+            int b = (int)((score - scoreMin) / binWidth);
+            return std::max(0, std::min(numBins - 1, b));
+        };
+
+    auto processor = [&] (NamedRowValue & row,
+                          const std::vector<ExpressionValue> & scoreLabelWeight)
+        {
+            double score = scoreLabelWeight[0].toDouble();
+            bool label = scoreLabelWeight[1].asBool();
+            double weight = scoreLabelWeight[2].toDouble();
+
+            Histogram & h = accum.get();
+            if (h.pos.empty()) {
+                h.pos.resize(numBins);
+                h.neg.resize(numBins);
+                h.posN.resize(numBins);
+                h.negN.resize(numBins);
+            }
+
+            int b = binOf(score);
+            if (label) {
+                h.pos[b] += weight;
+                h.posN[b] += 1;
+            }
+            else {
+                h.neg[b] += weight;
+                h.negN[b] += 1;
+            }
+
+            return true;
+        };
+
+    selectQuery.execute({processor, true /*processInParallel*/},
+                        runAccuracyConf.testingData.stm->offset,
+                        runAccuracyConf.testingData.stm->limit,
+                        nullptr /* progress */);
+
+    Histogram total;
+    total.pos.resize(numBins);
+    total.neg.resize(numBins);
+    total.posN.resize(numBins);
+    total.negN.resize(numBins);
+    bool gotStuff = false;
+
+    accum.forEach([&] (Histogram * h)
+                  {
+                      if (h->pos.empty())
+                          return;
+                      gotStuff = true;
+                      for (int b = 0;  b < numBins;  ++b) {
+                          total.pos[b] += h->pos[b];
+                          total.neg[b] += h->neg[b];
+                          total.posN[b] += h->posN[b];
+                          total.negN[b] += h->negN[b];
+                      }
+                  });
+
+    if (!gotStuff) {
+        throw ML::Exception(NO_DATA_ERR_MSG);
+    }
+
+    // Walk the bins from the highest score down, mirroring what
+    // ScoredStats::calculate does over sorted entries: each non-empty
+    // bin moves its examples from excluded to included and yields one
+    // ROC point at the bin's lower edge.
+    ScoredStats stats;
+
+    BinaryStats current;
+    for (int b = 0;  b < numBins;  ++b) {
+        current.counts[true][false] += total.pos[b];
+        current.counts[false][false] += total.neg[b];
+        current.unweighted_counts[true][false] += total.posN[b];
+        current.unweighted_counts[false][false] += total.negN[b];
+    }
+
+    stats.bestF = current;
+    stats.bestMcc = current;
+
+    double totalAuc = 0.0;
+
+    stats.stats.clear();
+    stats.stats.push_back(BinaryStats(current, INFINITY));
+
+    for (int b = numBins - 1;  b >= 0;  --b) {
+        if (total.posN[b] == 0 && total.negN[b] == 0)
+            continue;
+
+        current.counts[true][false] -= total.pos[b];
+        current.counts[true][true] += total.pos[b];
+        current.counts[false][false] -= total.neg[b];
+        current.counts[false][true] += total.neg[b];
+        current.unweighted_counts[true][false] -= total.posN[b];
+        current.unweighted_counts[true][true] += total.posN[b];
+        current.unweighted_counts[false][false] -= total.negN[b];
+        current.unweighted_counts[false][true] += total.negN[b];
+
+        totalAuc += current.rocAreaSince(stats.stats.back());
+        stats.stats.push_back(BinaryStats(current, scoreMin + b * binWidth));
+
+        if (current.f() > stats.bestF.f())
+            stats.bestF = stats.stats.back();
+        if (current.mcc() > stats.bestMcc.mcc())
+            stats.bestMcc = stats.stats.back();
+        if (current.specificity() > stats.bestSpecificity.specificity())
+            stats.bestSpecificity = stats.stats.back();
+    }
+
+    stats.auc = totalAuc;
+    stats.isSorted = true;
+
+    if (output) {
+        const Date recordDate = Date::now();
+
+        std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > rows;
+
+        // One row per ROC point; there are no per-example rows in
+        // streaming mode
+        for (unsigned i = 1;  i < stats.stats.size();  ++i) {
+            const BinaryStats & bstats = stats.stats[i];
+
+            std::vector<std::tuple<RowName, CellValue, Date> > row;
+            row.emplace_back(ColumnName("index"), i, recordDate);
+            row.emplace_back(ColumnName("score"), bstats.threshold, recordDate);
+            row.emplace_back(ColumnName("truePositives"), bstats.truePositives(), recordDate);
+            row.emplace_back(ColumnName("falsePositives"), bstats.falsePositives(), recordDate);
+            row.emplace_back(ColumnName("trueNegatives"), bstats.trueNegatives(), recordDate);
+            row.emplace_back(ColumnName("falseNegatives"), bstats.falseNegatives(), recordDate);
+            row.emplace_back(ColumnName("precision"), bstats.precision(), recordDate);
+            row.emplace_back(ColumnName("recall"), bstats.recall(), recordDate);
+            row.emplace_back(ColumnName("truePositiveRate"), bstats.truePositiveRate(), recordDate);
+            row.emplace_back(ColumnName("falsePositiveRate"), bstats.falsePositiveRate(), recordDate);
+
+            rows.emplace_back(RowName(ML::format("%06d", i)), std::move(row));
+            if (rows.size() > 10000) {
+                output->recordRows(rows);
+                rows.clear();
+            }
+        }
+
+        output->recordRows(rows);
+
+        output->commit();
+    }
+
+    cerr << "stats are " << endl;
+
+    cerr << stats.toJson();
+
+    return Any(stats.toJson());
+}
+
 RunOutput
 runBoolean(AccuracyConfig & runAccuracyConf,
            BoundSelectQuery & selectQuery,
            std::shared_ptr<Dataset> output)
 {
+    if (runAccuracyConf.streamingBins > 0)
+        return runBooleanStreaming(runAccuracyConf, selectQuery, output);
 
     PerThreadAccumulator<ScoredStats> accum;
 
@@ -28,7 +28,8 @@ struct AccuracyConfig : public ProcedureConfig {
     static constexpr const char * name = "classifier.test";
 
     AccuracyConfig()
-          : mode(CM_BOOLEAN), uniqueScoresOnly(false)
+          : mode(CM_BOOLEAN), uniqueScoresOnly(false),
+            streamingBins(0), streamingScoreMin(0.0), streamingScoreMax(1.0)
     {
     }
 
@@ -40,6 +41,14 @@ struct AccuracyConfig : public ProcedureConfig {
 
     bool uniqueScoresOnly;
 
+    /// Number of score histogram bins for streaming boolean evaluation;
+    /// 0 keeps the exact per-example computation
+    int streamingBins;
+
+    /// Score range covered by the streaming bins
+    double streamingScoreMin;
+    double streamingScoreMax;
+
     /// Dataset we output to
     Optional<PolyConfigT<Dataset> > outputDataset;
     static constexpr char const * defaultOutputDatasetType = "tabular";
@@ -35,6 +35,7 @@
 #include "mldb/jml/utils/map_reduce.h"
 #include "mldb/jml/utils/string_functions.h"
 #include "mldb/server/analytics.h"
+#include "mldb/server/column_scope.h"
 #include "mldb/server/per_thread_accumulator.h"
 #include "mldb/server/parallel_merge_sort.h"
 #include "mldb/ml/jml/feature_info.h"
@@ -43,6 +44,11 @@
 #include "mldb/rest/in_process_rest_connection.h"
 #include "mldb/server/static_content_macro.h"
 
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
 
 using namespace std;
 using namespace ML;
@@ -424,79 +430,201 @@ run(const ProcedureRunConfig & run,
     if (runProcConf.trainingData.stm->limit == -1 && runProcConf.trainingData.stm->offset == 0)
         runProcConf.trainingData.stm->orderBy.clauses.clear();
 
+    // The select was validated to contain only plain columns, so once no
+    // clauses are left that filter or reorder rows the training data can
+    // be pulled straight out of the dataset's column index, one column at
+    // a time, instead of being flattened, sorted and merged row by row
+    // through the SQL execution path.
+    bool canExtractByColumn
+        = runProcConf.trainingData.stm->where->isConstantTrue()
+        && (!runProcConf.trainingData.stm->when.when
+            || runProcConf.trainingData.stm->when.when->isConstantTrue())
+        && runProcConf.trainingData.stm->orderBy.clauses.empty()
+        && runProcConf.trainingData.stm->limit == -1
+        && runProcConf.trainingData.stm->offset == 0;
+
     timer.restart();
 
-    BoundSelectQuery(select, *boundDataset.dataset,
-                     boundDataset.asName, runProcConf.trainingData.stm->when,
-                     *runProcConf.trainingData.stm->where,
-                     runProcConf.trainingData.stm->orderBy, extra)
-        .execute({processor,true/*processInParallel*/},
-                 runProcConf.trainingData.stm->offset,
-                 runProcConf.trainingData.stm->limit,
-                 nullptr /* progress */);
+    std::vector<Fv> fvs;
 
-    INFO_MSG(logger) << "extracted feature vectors in " << timer.elapsed();
+    if (canExtractByColumn) {
+        // Label and weight are evaluated over whole columns, as the
+        // random forest procedure does
+        ColumnScope colScope(server, boundDataset.dataset);
+        auto boundLabel = label->bind(colScope);
+        auto boundWeight = weight->bind(colScope);
+
+        std::vector<std::vector<CellValue> > labelsAndWeights
+            = colScope.run({boundLabel, boundWeight});
+
+        const std::vector<CellValue> & labels = labelsAndWeights[0];
+        const std::vector<CellValue> & weights = labelsAndWeights[1];
+
+        // Rows with a null label are not examples
+        std::vector<size_t> exampleRows;
+        exampleRows.reserve(labels.size());
+        for (size_t i = 0;  i < labels.size();  ++i) {
+            if (!labels[i].empty())
+                exampleRows.push_back(i);
+        }
 
-    // If we're categorical, we need to sort out the labels over all
-    // of the threads.
+        size_t numExamples = exampleRows.size();
 
-    std::map<std::string, int> labelMapping;
+        // Each example starts with its label and weight.  Labels are
+        // encoded sequentially in row order, so that categorical label
+        // codes come out deterministically.
+        std::vector<ML::Mutable_Feature_Set::features_type>
+            rowFeatures(numExamples);
 
-    if (runProcConf.mode == CM_CATEGORICAL) {
+        for (size_t x = 0;  x < numExamples;  ++x) {
+            const CellValue & lbl = labels[exampleRows[x]];
 
-        std::set<std::string> allLabels;
+            float encodedLabel;
+            switch (runProcConf.mode) {
+            case CM_REGRESSION:
+                encodedLabel = lbl.toDouble();
+                break;
+            case CM_BOOLEAN:
+                encodedLabel = lbl.isTrue();
+                break;
+            case CM_CATEGORICAL:
+                encodedLabel = categorical->parse_or_add(jsonEncodeStr(lbl));
+                break;
+            default:
+                throw HttpReturnException(400, "Unknown classifier mode");
+            }
 
-        auto onThread = [&] (ThreadAccum * acc)
-            {
-                allLabels.insert(acc->categoricalLabelList.begin(),
-                                 acc->categoricalLabelList.end());
-            };
+            rowFeatures[x].reserve(2 + knownInputColumns.size());
+            rowFeatures[x].emplace_back(labelFeature, encodedLabel);
+            rowFeatures[x].emplace_back(weightFeature,
+                                        weights[exampleRows[x]].toDouble());
+        }
+
+        // Fill in the features one column at a time.  Each column's info
+        // is resolved once per column here, rather than once per cell as
+        // in the row-by-row path below.
+        auto columnIndex = boundDataset.dataset->getColumnIndex();
+
+        for (const auto & columnName: knownInputColumns) {
+            ColumnHash ch = columnName;
+            const auto & info = featureSpace->columnInfo.at(ch);
+            ML::Feature feature = DatasetFeatureSpace::getFeature(ch);
 
-        accum.forEach(onThread);
+            std::vector<CellValue> vals
+                = columnIndex->getColumnDense(columnName);
 
-        // Now, initialize a mapping for each thread
-        for (auto & labelStr: allLabels) {
-            int encodedLabel = categorical->parse_or_add(labelStr);
-            labelMapping[labelStr] = encodedLabel;
+            if (vals.size() < labels.size()) {
+                throw HttpReturnException
+                    (500, "Column '" + columnName.toUtf8String()
+                     + "' too short for columnwise extraction");
+            }
+
+            auto onChunk = [&] (size_t first, size_t last)
+                {
+                    for (size_t x = first;  x < last;  ++x) {
+                        const CellValue & v = vals[exampleRows[x]];
+                        if (v.empty())
+                            continue;
+                        rowFeatures[x].emplace_back
+                            (feature,
+                             featureSpace->encodeValue(v, columnName,
+                                                       info));
+                    }
+                };
+
+            parallelMapChunked(0, numExamples, 65536 /* rows at once */,
+                               onChunk);
         }
 
-        auto onThread2 = [&] (ThreadAccum * acc)
+        fvs.resize(numExamples);
+        numRows = numExamples;
+
+        // Building the feature sets sorts each one's features
+        auto buildFeatureSets = [&] (size_t first, size_t last)
             {
-                for (auto & labelStr: acc->categoricalLabelList) {
-                    acc->labelMapping[acc->categoricalLabels[labelStr] ]
-                        = labelMapping[labelStr];
+                for (size_t x = first;  x < last;  ++x) {
+                    fvs[x].featureSet
+                        = ML::Mutable_Feature_Set(std::move(rowFeatures[x]));
                 }
             };
 
-        accum.forEach(onThread2);
+        parallelMapChunked(0, numExamples, 4096 /* rows at once */,
+                           buildFeatureSets);
+
+        INFO_MSG(logger) << "extracted feature vectors columnwise in "
+                         << timer.elapsed();
     }
+    else {
+        BoundSelectQuery(select, *boundDataset.dataset,
+                         boundDataset.asName, runProcConf.trainingData.stm->when,
+                         *runProcConf.trainingData.stm->where,
+                         runProcConf.trainingData.stm->orderBy, extra)
+            .execute({processor,true/*processInParallel*/},
+                     runProcConf.trainingData.stm->offset,
+                     runProcConf.trainingData.stm->limit,
+                     nullptr /* progress */);
 
-    // Now merge them together in parallel
+        INFO_MSG(logger) << "extracted feature vectors in " << timer.elapsed();
 
-    std::vector<Fv> fvs;
+        // If we're categorical, we need to sort out the labels over all
+        // of the threads.
 
-    timer.restart();
+        std::map<std::string, int> labelMapping;
+
+        if (runProcConf.mode == CM_CATEGORICAL) {
+
+            std::set<std::string> allLabels;
+
+            auto onThread = [&] (ThreadAccum * acc)
+                {
+                    allLabels.insert(acc->categoricalLabelList.begin(),
+                                     acc->categoricalLabelList.end());
+                };
+
+            accum.forEach(onThread);
+
+            // Now, initialize a mapping for each thread
+            for (auto & labelStr: allLabels) {
+                int encodedLabel = categorical->parse_or_add(labelStr);
+                labelMapping[labelStr] = encodedLabel;
+            }
 
-    parallelMergeSortRecursive(accum.threads, 0, accum.threads.size(),
-                               [] (const std::shared_ptr<ThreadAccum> & t)
-                               {
-                                   t->sort();
-                               },
-                               [] (const std::shared_ptr<ThreadAccum> & t1,
-                                   const std::shared_ptr<ThreadAccum> & t2)
-                               {
-                                   ThreadAccum::merge(*t1, *t2);
-                               },
-                               [] (const std::shared_ptr<ThreadAccum> & t)
-                               {
-                                   return t->fvs.size();
-                               },
-                               10000 /* thread threshold */);
-
-    INFO_MSG(logger) << "merged feature vectors in " << timer.elapsed();
-
-    if (!accum.threads.empty()) {
-        fvs = std::move(accum.threads[0]->fvs);
+            auto onThread2 = [&] (ThreadAccum * acc)
+                {
+                    for (auto & labelStr: acc->categoricalLabelList) {
+                        acc->labelMapping[acc->categoricalLabels[labelStr] ]
+                            = labelMapping[labelStr];
+                    }
+                };
+
+            accum.forEach(onThread2);
+        }
+
+        // Now merge them together in parallel
+
+        timer.restart();
+
+        parallelMergeSortRecursive(accum.threads, 0, accum.threads.size(),
+                                   [] (const std::shared_ptr<ThreadAccum> & t)
+                                   {
+                                       t->sort();
+                                   },
+                                   [] (const std::shared_ptr<ThreadAccum> & t1,
+                                       const std::shared_ptr<ThreadAccum> & t2)
+                                   {
+                                       ThreadAccum::merge(*t1, *t2);
+                                   },
+                                   [] (const std::shared_ptr<ThreadAccum> & t)
+                                   {
+                                       return t->fvs.size();
+                                   },
+                                   10000 /* thread threshold */);
+
+        INFO_MSG(logger) << "merged feature vectors in " << timer.elapsed();
+
+        if (!accum.threads.empty()) {
+            fvs = std::move(accum.threads[0]->fvs);
+        }
     }
 
     ExcAssertEqual(fvs.size(), numRows);
@@ -695,13 +823,96 @@ ClassifyFunctionConfigDescription()
     addField("modelFileUrl", &ClassifyFunctionConfig::modelFileUrl,
              "URL of the model file (with extension '.cls') to load. "
              "This file is created by the ![](%%doclink classifier.train procedure).");
+    addField("scoringCacheSize", &ClassifyFunctionConfig::scoringCacheSize,
+             "Maximum number of scores kept in a per-function LRU cache, "
+             "keyed on a hash of the encoded feature vector.  When scoring "
+             "traffic repeats the same features, a cached score costs a "
+             "hash probe instead of a full model evaluation.  Zero (the "
+             "default) disables the cache.  Hit statistics are reported "
+             "in the function status.", 0);
 }
 
+namespace {
+
+/// 64 bit FNV-1a over raw bytes; fast enough to disappear next to a
+/// model evaluation
+uint64_t hashBytes(const void * data, size_t len, uint64_t h)
+{
+    const unsigned char * p = (const unsigned char *)data;
+    for (size_t i = 0;  i < len;  ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+/** LRU cache of classifier scores, keyed on a hash of the encoded
+    feature vector.  Scores depend only on the features, so timestamps
+    are left out of the cache and re-applied per request.
+*/
+struct ScoringCache {
+    size_t maxEntries = 0;
+
+    typedef std::pair<uint64_t, std::vector<float> > Entry;
+
+    mutable std::mutex mutex;
+    mutable std::list<Entry> lru;  ///< Front is the most recently used
+    mutable std::unordered_map<uint64_t, std::list<Entry>::iterator> entries;
+    mutable std::atomic<uint64_t> hits { 0 };
+    mutable std::atomic<uint64_t> misses { 0 };
+
+    bool enabled() const
+    {
+        return maxEntries > 0;
+    }
+
+    bool lookup(uint64_t key, std::vector<float> & scores) const
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            ++misses;
+            return false;
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        scores = it->second->second;
+        ++hits;
+        return true;
+    }
+
+    void insert(uint64_t key, const std::vector<float> & scores) const
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return;
+        }
+        lru.emplace_front(key, scores);
+        entries[key] = lru.begin();
+        if (entries.size() > maxEntries) {
+            entries.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return entries.size();
+    }
+};
+
+} // file scope
+
 struct ClassifyFunction::Itl {
     ML::Classifier classifier;
     std::shared_ptr<const DatasetFeatureSpace> featureSpace;
     ML::Feature_Info labelInfo;
     ClassifierMode mode;
+    ScoringCache cache;
 };
 
 ClassifyFunction::
@@ -723,6 +934,8 @@ ClassifyFunction(MldbServer * owner,
     itl->labelInfo = labelInfo;
 
     isRegression = itl->classifier.label_count() == 1;
+
+    itl->cache.maxEntries = std::max(0, functionConfig.scoringCacheSize);
 }
 
 ClassifyFunction::
@@ -756,6 +969,18 @@ getStatus() const
     Json::Value result;
     result["summary"] = itl->classifier.impl->summary();
     result["mode"] = jsonEncode(itl->mode);
+    if (itl->cache.enabled()) {
+        uint64_t hits = itl->cache.hits;
+        uint64_t misses = itl->cache.misses;
+        Json::Value cache;
+        cache["entries"] = (Json::UInt)itl->cache.size();
+        cache["maxEntries"] = (Json::UInt)itl->cache.maxEntries;
+        cache["hits"] = (Json::UInt)hits;
+        cache["misses"] = (Json::UInt)misses;
+        if (hits + misses > 0)
+            cache["hitRate"] = (double)hits / (hits + misses);
+        result["scoringCache"] = cache;
+    }
     return result;
 }
 
@@ -888,62 +1113,90 @@ apply(const FunctionApplier & applier_,
 
     std::tie(dense, fset, ts) = getFeatureSet(context, true /* try to optimize */);
 
-    StructValue result;
-    result.reserve(1);
+    if (dense.empty() && !fset) {
+        throw ML::Exception("Feature_Set is null! Are you giving "
+                            "only null features to the classifier function?");
+    }
 
     auto cat = itl->labelInfo.categorical();
-    if (!dense.empty()) {
-        if (cat) {
-            auto scores = itl->classifier.impl->predict(dense, applier.optInfo);
-            ExcAssertEqual(scores.size(), labelCount);
-
-            vector<tuple<PathElement, ExpressionValue> > row;
-            for (unsigned i = 0;  i < labelCount;  ++i) {
-                row.emplace_back(PathElement(cat->print(i)),
-                                 ExpressionValue(scores[i], ts));
+
+    auto computeScores = [&] () -> std::vector<float>
+        {
+            if (!dense.empty()) {
+                if (cat)
+                    return itl->classifier.impl->predict(dense, applier.optInfo);
+                else if (itl->labelInfo.type() == ML::REAL) {
+                    ExcAssertEqual(labelCount, 1);
+                    return { itl->classifier.impl
+                                ->predict(0, dense, applier.optInfo) };
+                }
+                else {
+                    ExcAssertEqual(labelCount, 2);
+                    return { itl->classifier.impl
+                                ->predict(1, dense, applier.optInfo) };
+                }
             }
+            else {
+                if (cat)
+                    return itl->classifier.predict(*fset);
+                else if (itl->labelInfo.type() == ML::REAL) {
+                    ExcAssertEqual(labelCount, 1);
+                    return { itl->classifier.predict(0, *fset) };
+                }
+                else {
+                    ExcAssertEqual(labelCount, 2);
+                    return { itl->classifier.predict(1, *fset) };
+                }
+            }
+        };
 
-            result.emplace_back("scores", std::move(row));
-        }
-        else if (itl->labelInfo.type() == ML::REAL) {
-            ExcAssertEqual(labelCount, 1);
-            float score = itl->classifier.impl->predict(0, dense, applier.optInfo);
-            result.emplace_back("score", ExpressionValue(score, ts));
+    std::vector<float> scores;
+
+    if (itl->cache.enabled()) {
+        // Scores depend only on the encoded features, so the cache key
+        // is a hash over them; the timestamp is applied per request below.
+        uint64_t key;
+        if (!dense.empty()) {
+            key = hashBytes(dense.data(), dense.size() * sizeof(float),
+                            FNV_OFFSET_BASIS);
         }
         else {
-            ExcAssertEqual(labelCount, 2);
-            float score = itl->classifier.impl->predict(1, dense, applier.optInfo);
-            result.emplace_back("score", ExpressionValue(score, ts));
+            // Different seed so a sparse set can't collide with a dense
+            // vector that happens to encode the same bytes
+            key = FNV_OFFSET_BASIS ^ 1;
+            for (auto & f: fset->features) {
+                uint64_t featureHash = f.first.hash();
+                key = hashBytes(&featureHash, sizeof(featureHash), key);
+                key = hashBytes(&f.second, sizeof(float), key);
+            }
+        }
+
+        if (!itl->cache.lookup(key, scores)) {
+            scores = computeScores();
+            itl->cache.insert(key, scores);
         }
     }
     else {
-        if(!fset) {
-            throw ML::Exception("Feature_Set is null! Are you giving "
-                                "only null features to the classifier function?");
-        }
-        
-        if (cat) {
-            auto scores = itl->classifier.predict(*fset);
-            ExcAssertEqual(scores.size(), labelCount);
+        scores = computeScores();
+    }
 
-            vector<tuple<PathElement, ExpressionValue> > row;
+    StructValue result;
+    result.reserve(1);
 
-            for (unsigned i = 0;  i < labelCount;  ++i) {
-                row.emplace_back(PathElement(cat->print(i)),
-                                 ExpressionValue(scores[i], ts));
-            }
-            result.emplace_back("scores", std::move(row));
-        }
-        else if (itl->labelInfo.type() == ML::REAL) {
-            ExcAssertEqual(labelCount, 1);
-            float score = itl->classifier.predict(0, *fset);
-            result.emplace_back("score", ExpressionValue(score, ts));
-        }
-        else {
-            ExcAssertEqual(labelCount, 2);
-            float score = itl->classifier.predict(1, *fset);
-            result.emplace_back("score", ExpressionValue(score, ts));
+    if (cat) {
+        ExcAssertEqual(scores.size(), labelCount);
+
+        vector<tuple<PathElement, ExpressionValue> > row;
+        for (unsigned i = 0;  i < labelCount;  ++i) {
+            row.emplace_back(PathElement(cat->print(i)),
+                             ExpressionValue(scores[i], ts));
         }
+
+        result.emplace_back("scores", std::move(row));
+    }
+    else {
+        ExcAssertEqual(scores.size(), 1);
+        result.emplace_back("score", ExpressionValue(scores[0], ts));
     }
 
     return std::move(result);
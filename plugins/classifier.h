@@ -100,11 +100,15 @@ struct ClassifierProcedure: public Procedure {
 
 struct ClassifyFunctionConfig {
     ClassifyFunctionConfig(const Url & modelFileUrl = Url())
-        : modelFileUrl(modelFileUrl)
+        : modelFileUrl(modelFileUrl),
+          scoringCacheSize(0)
     {
     }
 
     Url modelFileUrl;
+
+    /// Maximum number of entries in the LRU score cache; 0 disables it
+    int scoringCacheSize;
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(ClassifyFunctionConfig);
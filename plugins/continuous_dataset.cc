@@ -12,6 +12,8 @@
 #include "mldb/rest/rest_request_binding.h"
 #include "mldb/arch/simd_vector.h"
 #include "mldb/base/parallel.h"
+#include "mldb/base/thread_pool.h"
+#include "mldb/base/scope.h"
 #include "mldb/sql/sql_expression.h"
 #include "mldb/sql/sql_expression_operations.h"
 #include "mldb/jml/utils/lightweight_hash.h"
@@ -21,6 +23,8 @@
 #include "mldb/watch/watch_impl.h"
 #include "mldb/server/mldb_server.h"
 #include "mldb/builtin/merged_dataset.h"
+#include "mldb/builtin/sub_dataset.h"
+#include "partial_aggregation.h"
 
 
 using namespace std;
@@ -34,6 +38,12 @@ namespace MLDB {
 /* CONTINUOUS DATASET CONFIG                                                 */
 /*****************************************************************************/
 
+ContinuousDatasetConfig::
+ContinuousDatasetConfig()
+    : compactionThreshold(8)
+{
+}
+
 DEFINE_STRUCTURE_DESCRIPTION(ContinuousDatasetConfig);
 
 ContinuousDatasetConfigDescription::
@@ -47,6 +57,41 @@ ContinuousDatasetConfigDescription()
              "Procedure that will save a storage dataset returning metadata");
     addField("commitInterval", &ContinuousDatasetConfig::commitInterval,
              "Interval between auto-commit operations");
+    addField("compactionThreshold", &ContinuousDatasetConfig::compactionThreshold,
+             "Number of adjacent committed datasets in the same size tier "
+             "before they are merged into one in the background.  Values "
+             "less than two disable compaction.", 8);
+}
+
+
+/*****************************************************************************/
+/* METADATA ROWS                                                             */
+/*****************************************************************************/
+
+/** Given a row from a metadata dataset query, return a configuration
+    object for the dataset.
+*/
+static PolyConfigT<const Dataset>
+reconstituteConfig(const MatrixNamedRow & row)
+{
+    Json::Value current;
+
+    for (auto & col: row.columns) {
+        Json::Value * p = &current;
+        vector<string> parts = ML::split(std::get<0>(col).toUtf8String().rawString(), '.');
+        if (parts[0] != "config")
+            continue;
+        for (unsigned i = 1;  i < parts.size();  ++i) {
+            Json::Value & v2 = (*p)[parts[i]];
+            p = &v2;
+        }
+
+        *p = jsonEncode(std::get<1>(col));
+    }
+
+    current["id"] = jsonEncode(row.rowName);
+
+    return jsonDecode<PolyConfigT<const Dataset> >(current);
 }
 
 
@@ -54,11 +99,14 @@ ContinuousDatasetConfigDescription()
 /* CONTINUOUS INTERNAL REPRESENTATION                                        */
 /*****************************************************************************/
 
-struct ContinuousDataset::Itl {
+struct ContinuousDataset::Itl
+    : public std::enable_shared_from_this<ContinuousDataset::Itl> {
     Itl(MldbServer * server, const ContinuousDatasetConfig & config)
         : server(server),
           current(gcLock),
-          lastCommit(Date::now().secondsSinceEpoch())
+          lastCommit(Date::now().secondsSinceEpoch()),
+          compactionThreshold(config.compactionThreshold),
+          compactionsActive(0)
     {
         initRoutes();
 
@@ -177,9 +225,47 @@ struct ContinuousDataset::Itl {
     /// rotated.
     WatchesT<std::shared_ptr<Dataset> > datasetWatches;
 
+    /// Callbacks to report saved datasets to (eg aggregation views).
+    /// A plain registry rather than a watch because the payload has no
+    /// value description.
+    std::mutex savedCallbacksMutex;
+    std::map<size_t, ContinuousDataset::OnDatasetSaved> savedCallbacks;
+    size_t nextSavedCallbackHandle = 0;
+
+    /** Report a saved dataset to the registered callbacks.  Callbacks
+        are copied out first, so one may still be invoked right after
+        its removal; subscribers deal with that by holding their state
+        through a weak pointer.
+    */
+    void notifyDatasetSaved(const std::shared_ptr<Dataset> & savedDataset)
+    {
+        std::vector<ContinuousDataset::OnDatasetSaved> callbacks;
+        {
+            std::unique_lock<std::mutex> guard(savedCallbacksMutex);
+            callbacks.reserve(savedCallbacks.size());
+            for (auto & c: savedCallbacks)
+                callbacks.emplace_back(c.second);
+        }
+
+        for (auto & fn: callbacks) {
+            try {
+                fn(savedDataset);
+            } JML_CATCH_ALL {
+                cerr << "error notifying saved continuous dataset: "
+                     << ML::getExceptionString() << endl;
+            }
+        }
+    }
+
     /// Date of the last commit
     std::atomic<double> lastCommit;
-    
+
+    /// Number of adjacent same-tier datasets before they're merged
+    int compactionThreshold;
+
+    /// Number of background compactions running or queued (0 or 1)
+    std::atomic<size_t> compactionsActive;
+
     static std::vector<std::tuple<ColumnName, CellValue, Date> >
     extractMetadata(const Json::Value & val, ColumnName prefix = ColumnName())
     {
@@ -286,15 +372,35 @@ struct ContinuousDataset::Itl {
 
         auto saveOutput
             = saveStorageDataset->run(saveRunConfig, nullptr /* progress */);
-        
+
+        cerr << "metadata is " << jsonEncode(saveOutput) << endl;
+
         // Take the metadata and put it in the metadata database
-        
+        recordSavedDataset(savedDataset, saveOutput);
+
+        datasetWatches.trigger(savedDataset);
+
+        notifyDatasetSaved(savedDataset);
+
+        // We now know that everything is committed up to lastCommit.
+        lastCommit = commitStarted.secondsSinceEpoch();
+
+        // Merge small committed datasets together in the background so
+        // that queries don't fan out over an ever growing number of them
+        startCompaction();
+    }
+
+    /** Record the metadata returned from saving a dataset into the
+        metadata dataset, so that window queries over the right time
+        range can find it.
+    */
+    void recordSavedDataset(const std::shared_ptr<Dataset> & savedDataset,
+                            const RunOutput & saveOutput)
+    {
         Json::Value resultsJson = jsonEncode(saveOutput.results);
         const Json::Value & metadataJson = resultsJson["metadata"];
         const Json::Value & configJson = resultsJson["config"];
 
-        cerr << "metadata is " << jsonEncode(saveOutput) << endl;
-
         RowName rowName(savedDataset->config_->id);
 
         std::vector<std::tuple<ColumnName, CellValue, Date> > metadata
@@ -314,13 +420,191 @@ struct ContinuousDataset::Itl {
         // TODO: the procedure should return this...
         metadata.emplace_back(ColumnName("earliest"), earliest, Date::now());
         metadata.emplace_back(ColumnName("latest"), latest, Date::now());
-        
+        metadata.emplace_back(ColumnName("rowCount"),
+                              (int64_t)savedDataset->getMatrixView()
+                                  ->getRowCount(),
+                              Date::now());
+
         metadataDataset->recordRow(rowName, metadata);
+    }
 
-        datasetWatches.trigger(savedDataset);
+    /** Kick off a background compaction pass if one isn't already
+        running.  Runs on the thread pool so that neither the recording
+        path nor the committer ever waits for a merge.
+    */
+    void startCompaction()
+    {
+        if (compactionThreshold < 2)
+            return;
 
-        // We now know that everything is committed up to lastCommit.
-        lastCommit = commitStarted.secondsSinceEpoch();
+        // One compaction at a time is enough; the next rotation will
+        // start another if small datasets have accumulated again
+        if (compactionsActive.fetch_add(1) != 0) {
+            --compactionsActive;
+            return;
+        }
+
+        auto self = shared_from_this();
+        auto job = [self] ()
+            {
+                Scope_Exit(--self->compactionsActive);
+                try {
+                    self->compact();
+                } JML_CATCH_ALL {
+                    cerr << "error compacting continuous dataset: "
+                         << ML::getExceptionString() << endl;
+                }
+            };
+
+        try {
+            ThreadPool::instance().add(std::move(job));
+        } catch (...) {
+            --compactionsActive;
+            throw;
+        }
+    }
+
+    /** Merge adjacent small committed datasets into one larger one, so
+        that the number of datasets a window query fans out over stays
+        bounded.
+
+        Datasets are tiered by row count (power-of-four bands); when
+        compactionThreshold adjacent datasets fall in the same tier,
+        they're merged into a new storage dataset, which is saved and
+        recorded like any rotated dataset, and the originals are marked
+        with the `compactedInto` column so window queries skip them.
+        One run is merged per pass; repeated rotations walk the merges
+        up the tiers, so total compaction work is amortized constant
+        per row saved.
+    */
+    void compact()
+    {
+        // Take the save mutex so that we never run concurrently with
+        // the save phase of a rotation
+        std::unique_lock<std::mutex> saveGuard(saveMutex);
+
+        // Get the committed datasets that haven't been compacted yet,
+        // oldest first.  Datasets saved before row counts were recorded
+        // have no rowCount column and are left alone.
+        auto datasets
+            = metadataDataset
+            ->queryStructured(SelectExpression::STAR,
+                              WhenExpression::TRUE /* when */,
+                              *SqlExpression::parse
+                                  ("compactedInto IS NULL "
+                                   "AND rowCount IS NOT NULL") /* where */,
+                              OrderByExpression::parse("earliest ASC"),
+                              TupleExpression(),
+                              *SqlExpression::TRUE /* having */,
+                              *SqlExpression::parse("rowPath()") /* rowName */,
+                              0 /* offset */,
+                              -1 /* limit */,
+                              "" /* alias */);
+
+        // Tier of a dataset: datasets in the same power-of-four row
+        // count band merge together
+        auto tierOf = [] (int64_t rowCount)
+            {
+                int tier = 0;
+                while (rowCount >= 64) {
+                    rowCount /= 4;
+                    ++tier;
+                }
+                return tier;
+            };
+
+        auto rowCountOf = [] (const MatrixNamedRow & row) -> int64_t
+            {
+                for (auto & col: row.columns) {
+                    if (std::get<0>(col) == ColumnName("rowCount"))
+                        return std::get<1>(col).toInt();
+                }
+                return -1;
+            };
+
+        // Find the first run of compactionThreshold adjacent datasets
+        // in the same tier
+        size_t runStart = 0;
+        size_t runEnd = 0;
+        for (size_t i = 0;  i < datasets.size();  ++i) {
+            if (i == runStart
+                || tierOf(rowCountOf(datasets[i]))
+                   != tierOf(rowCountOf(datasets[runStart])))
+                runStart = i;
+            if (i - runStart + 1 == (size_t)compactionThreshold) {
+                runEnd = i + 1;
+                break;
+            }
+        }
+
+        if (runEnd == 0)
+            return;  // nothing to compact
+
+        // Load the run as one merged dataset
+        MergedDatasetConfig mergedParams;
+        for (size_t i = runStart;  i < runEnd;  ++i)
+            mergedParams.datasets.emplace_back(reconstituteConfig(datasets[i]));
+
+        PolyConfigT<const Dataset> mergedConfig;
+        mergedConfig.type = "merged";
+        mergedConfig.params = mergedParams;
+
+        std::shared_ptr<Dataset> source
+            = obtainDataset(server, mergedConfig, nullptr);
+
+        // Create a new storage dataset and copy the rows over
+        ProcedureRunConfig runConfig;
+        auto storageOutput
+            = createStorageDataset->run(runConfig, nullptr /* progress */);
+
+        std::shared_ptr<Dataset> compacted
+            = obtainDataset(server,
+                            storageOutput.results.getField("config")
+                            .convert<PolyConfig>(), nullptr);
+
+        auto matrix = source->getMatrixView();
+
+        std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > batch;
+        batch.reserve(1024);
+
+        for (auto & rowName: matrix->getRowNames()) {
+            MatrixNamedRow row = matrix->getRow(rowName);
+            batch.emplace_back(std::move(row.rowName),
+                               std::move(row.columns));
+            if (batch.size() == 1024) {
+                compacted->recordRows(batch);
+                batch.clear();
+            }
+        }
+        if (!batch.empty())
+            compacted->recordRows(batch);
+
+        compacted->commit();
+
+        // Save it and record its metadata, exactly as for a rotated
+        // dataset
+        ProcedureRunConfig saveRunConfig;
+        Json::Value saveParams;
+        saveParams["args"]["datasetId"] = compacted->config_->id;
+        saveRunConfig.params = saveParams;
+
+        auto saveOutput
+            = saveStorageDataset->run(saveRunConfig, nullptr /* progress */);
+
+        recordSavedDataset(compacted, saveOutput);
+
+        // Finally, mark the originals so that window queries skip them.
+        // Readers that already loaded them keep working; they just see
+        // the same rows through the old datasets.
+        for (size_t i = runStart;  i < runEnd;  ++i) {
+            metadataDataset
+                ->recordRow(datasets[i].rowName,
+                            { { ColumnName("compactedInto"),
+                                CellValue(compacted->config_->id),
+                                Date::now() } });
+        }
+
+        metadataDataset->commit();
     }
 
     virtual void commit()
@@ -422,7 +706,8 @@ void
 ContinuousDataset::
 commit()
 {
-    return itl->commit();
+    itl->commit();
+    bumpVersion();
 }
     
 std::pair<Date, Date>
@@ -469,6 +754,57 @@ handleRequest(RestConnection & connection,
     return itl->handleRequest(connection, request, context);
 }
 
+std::shared_ptr<Dataset>
+ContinuousDataset::
+getCurrentStore() const
+{
+    auto myCurrent = itl->current();
+    return myCurrent->dataset;
+}
+
+size_t
+ContinuousDataset::
+addOnDatasetSaved(OnDatasetSaved fn)
+{
+    std::unique_lock<std::mutex> guard(itl->savedCallbacksMutex);
+    size_t handle = itl->nextSavedCallbackHandle++;
+    itl->savedCallbacks.emplace(handle, std::move(fn));
+    return handle;
+}
+
+void
+ContinuousDataset::
+removeOnDatasetSaved(size_t handle)
+{
+    std::unique_lock<std::mutex> guard(itl->savedCallbacksMutex);
+    itl->savedCallbacks.erase(handle);
+}
+
+std::vector<std::shared_ptr<Dataset> >
+ContinuousDataset::
+getCommittedDatasets() const
+{
+    auto rows = itl->metadataDataset
+        ->queryStructured(SelectExpression::STAR,
+                          WhenExpression::TRUE /* when */,
+                          *SqlExpression::parse
+                              ("compactedInto IS NULL") /* where */,
+                          OrderByExpression::parse("rowPath() ASC"),
+                          TupleExpression(),
+                          *SqlExpression::TRUE /* having */,
+                          *SqlExpression::parse("rowPath()") /* rowName */,
+                          0 /* offset */,
+                          -1 /* limit */,
+                          "" /* alias */);
+
+    std::vector<std::shared_ptr<Dataset> > result;
+    result.reserve(rows.size());
+    for (auto & r: rows)
+        result.emplace_back(obtainDataset(server, reconstituteConfig(r),
+                                          nullptr));
+    return result;
+}
+
 static RegisterDatasetType<ContinuousDataset, ContinuousDatasetConfig>
 regContinuous(builtinPackage(),
               "continuous",
@@ -510,32 +846,6 @@ ContinuousWindowDatasetConfigDescription()
 /* CONTINUOUS WINDOW DATASET                                                 */
 /*****************************************************************************/
 
-/** Given a row from a metadata dataset query, return a configuration
-    object for the dataset.
-*/
-static PolyConfigT<const Dataset>
-reconstituteConfig(const MatrixNamedRow & row)
-{
-    Json::Value current;
-
-    for (auto & col: row.columns) {
-        Json::Value * p = &current;
-        vector<string> parts = ML::split(std::get<0>(col).toUtf8String().rawString(), '.');
-        if (parts[0] != "config")
-            continue;
-        for (unsigned i = 1;  i < parts.size();  ++i) {
-            Json::Value & v2 = (*p)[parts[i]];
-            p = &v2;
-        }
-
-        *p = jsonEncode(std::get<1>(col));
-    }
-
-    current["id"] = jsonEncode(row.rowName);
-
-    return jsonDecode<PolyConfigT<const Dataset> >(current);
-}
-
 PolyConfigT<const Dataset>
 ContinuousWindowDataset::
 getDatasetConfig(std::shared_ptr<SqlExpression> datasetsWhere,
@@ -546,6 +856,7 @@ getDatasetConfig(std::shared_ptr<SqlExpression> datasetsWhere,
     // This is earliest <= to and latest >= from
 
     Utf8String where = "(" + datasetsWhere->surface + ") "
+        + "AND compactedInto IS NULL "
         + "AND earliest <= CAST ('" + CellValue(to).toString() + "' AS TIMESTAMP) "
         + "AND latest >= CAST ('" + CellValue(from).toString() + "' AS TIMESTAMP)";
     
@@ -633,5 +944,295 @@ regContinuousWindow(builtinPackage(),
                     nullptr,
                     {MldbEntity::INTERNAL_ENTITY});
 
+
+/*****************************************************************************/
+/* CONTINUOUS AGGREGATION DATASET CONFIG                                     */
+/*****************************************************************************/
+
+ContinuousAggregationDatasetConfig::
+ContinuousAggregationDatasetConfig()
+    : where("true")
+{
+}
+
+DEFINE_STRUCTURE_DESCRIPTION(ContinuousAggregationDatasetConfig);
+
+ContinuousAggregationDatasetConfigDescription::
+ContinuousAggregationDatasetConfigDescription()
+{
+    addField("dataset", &ContinuousAggregationDatasetConfig::dataset,
+             "Continuous dataset whose rows are aggregated");
+    addField("select", &ContinuousAggregationDatasetConfig::select,
+             "Aggregate clauses to maintain, each with an alias, eg "
+             "`count(*) AS n, avg(latency) AS latency`.  Only aggregates "
+             "with an algebraic decomposition (count, sum, min, max, avg) "
+             "can be maintained incrementally.");
+    addField("groupBy", &ContinuousAggregationDatasetConfig::groupBy,
+             "Group keys; leave empty to maintain a single row");
+    addField("where", &ContinuousAggregationDatasetConfig::where,
+             "Filter on the input rows", Utf8String("true"));
+    addField("rowName", &ContinuousAggregationDatasetConfig::rowName,
+             "Expression naming the group rows; defaults to the same "
+             "naming a plain GROUP BY query would use");
+}
+
+
+/*****************************************************************************/
+/* CONTINUOUS AGGREGATION DATASET                                            */
+/*****************************************************************************/
+
+struct ContinuousAggregationDataset::Itl {
+    Itl(MldbServer * server,
+        const ContinuousAggregationDatasetConfig & config)
+        : server(server), config(config), version(0)
+    {
+        if (config.select.empty())
+            throw HttpReturnException(400, "Continuous aggregation view "
+                                      "needs a select");
+
+        grouped = !config.groupBy.empty();
+        plan = PartialAggregationPlan::decompose
+            (SelectExpression::parse(config.select), grouped);
+        partialSelect = SelectExpression::parse(plan.partialSelect);
+        groupBy = TupleExpression::parse(config.groupBy);
+        where = SqlExpression::parse
+            (config.where.empty() ? Utf8String("true") : config.where);
+        rowName = SqlExpression::parse
+            (config.rowName.empty() ? Utf8String("rowPath()")
+                                    : config.rowName);
+
+        std::shared_ptr<Dataset> underlying;
+        try {
+            underlying = obtainDataset(server, config.dataset);
+        } JML_CATCH_ALL {
+            rethrowHttpException(-1, "Error initializing continuous "
+                                 "aggregation view in dataset "
+                                 "initialization: "
+                                 + ML::getExceptionString(),
+                                 "continuousAggregationConfig", config);
+        }
+
+        source = std::dynamic_pointer_cast<ContinuousDataset>(underlying);
+        if (!source)
+            throw HttpReturnException(400, "Continuous aggregation views "
+                                      "can only be put over a continuous "
+                                      "dataset",
+                                      "continuousAggregationConfig", config);
+    }
+
+    ~Itl()
+    {
+        if (savedCallbackHandle != (size_t)-1)
+            source->removeOnDatasetSaved(savedCallbackHandle);
+    }
+
+    /** Subscribe to saved datasets and backfill the committed history.
+        Subscription comes first, so that a rotation landing in between
+        is never missed; a dataset seen through both paths is
+        deduplicated by its id.  The callback holds a weak pointer, so
+        one that is still in flight when the view is destroyed fizzles
+        instead of touching freed state.
+    */
+    void init(std::weak_ptr<Itl> self)
+    {
+        savedCallbackHandle = source->addOnDatasetSaved
+            ([self] (std::shared_ptr<Dataset> dataset)
+             {
+                 auto strong = self.lock();
+                 if (strong)
+                     strong->foldDataset(dataset);
+             });
+
+        for (auto & dataset: source->getCommittedDatasets())
+            foldDataset(dataset);
+    }
+
+    MldbServer * server;
+    ContinuousAggregationDatasetConfig config;
+
+    std::shared_ptr<ContinuousDataset> source;
+
+    bool grouped;
+    PartialAggregationPlan plan;
+    SelectExpression partialSelect;
+    TupleExpression groupBy;
+    std::shared_ptr<SqlExpression> where;
+    std::shared_ptr<SqlExpression> rowName;
+
+    /// Protects the folded groups and the materialization cache
+    mutable std::mutex mutex;
+
+    /// Folded partials of all committed datasets, keyed by group row
+    /// name, with the synthetic partial columns still in place (avg
+    /// can't be folded once finished)
+    std::map<RowName, MatrixNamedRow> folded;
+
+    /// Ids of the datasets already folded, so the initial backfill and
+    /// the watch can't count one twice
+    std::set<Utf8String> foldedIds;
+
+    /// Bumped on every fold; invalidates the materialization cache
+    uint64_t version;
+
+    mutable std::shared_ptr<SubDataset> cached;
+    mutable uint64_t cachedVersion = 0;
+    mutable const Dataset * cachedStore = nullptr;
+    mutable uint64_t cachedStoreRows = 0;
+
+    /// Handle from addOnDatasetSaved, or -1 before init()
+    size_t savedCallbackHandle = (size_t)-1;
+
+    /** Partial aggregate of one dataset's rows. */
+    std::vector<MatrixNamedRow>
+    runPartial(const Dataset & dataset) const
+    {
+        return dataset.queryStructured(partialSelect,
+                                       WhenExpression::TRUE,
+                                       *where,
+                                       OrderByExpression::parse("true"),
+                                       groupBy,
+                                       *SqlExpression::TRUE /* having */,
+                                       *rowName,
+                                       0 /* offset */,
+                                       -1 /* limit */,
+                                       "" /* alias */);
+    }
+
+    /** Fold one committed dataset into the live result.  Cost is
+        proportional to that dataset's rows, never to the history.
+    */
+    void foldDataset(const std::shared_ptr<Dataset> & dataset)
+    {
+        try {
+            auto partial = runPartial(*dataset);
+
+            Utf8String id = dataset->config_ ? Utf8String(dataset->config_->id)
+                                             : Utf8String();
+
+            std::unique_lock<std::mutex> guard(mutex);
+            if (!id.empty() && !foldedIds.insert(id).second)
+                return;  // backfill raced with a rotation; already in
+            plan.mergeRows(folded, std::move(partial));
+            ++version;
+        } JML_CATCH_ALL {
+            cerr << "error folding dataset into continuous aggregation "
+                 << "view: " << ML::getExceptionString() << endl;
+        }
+    }
+
+    /** Snapshot the view as a queryable dataset: the folded groups plus
+        a partial over the rows still in the mutable store.  Rebuilt
+        only when a fold happened or the store grew, so repeated
+        accesses between events share one materialization.
+    */
+    std::shared_ptr<SubDataset>
+    materialize() const
+    {
+        auto store = source->getCurrentStore();
+        uint64_t storeRows = store ? store->getRowCountEstimate() : 0;
+
+        std::unique_lock<std::mutex> guard(mutex);
+        if (cached
+            && cachedVersion == version
+            && cachedStore == store.get()
+            && cachedStoreRows == storeRows)
+            return cached;
+
+        uint64_t foldedVersion = version;
+        auto groups = folded;
+        guard.unlock();
+
+        if (store)
+            plan.mergeRows(groups, runPartial(*store));
+
+        std::vector<MatrixNamedRow> rows;
+        rows.reserve(groups.size());
+        for (auto & g: groups) {
+            plan.finishRow(g.second);
+            rows.emplace_back(std::move(g.second));
+        }
+
+        auto result = std::make_shared<SubDataset>(server, std::move(rows));
+
+        guard.lock();
+        cached = result;
+        cachedVersion = foldedVersion;
+        cachedStore = store.get();
+        cachedStoreRows = storeRows;
+        return result;
+    }
+
+    Any getStatus() const
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        Json::Value status;
+        status["groupCount"] = (Json::UInt)folded.size();
+        status["foldedDatasets"] = (Json::UInt)foldedIds.size();
+        return status;
+    }
+};
+
+ContinuousAggregationDataset::
+ContinuousAggregationDataset(MldbServer * owner,
+                             PolyConfig config,
+                             const std::function<bool (const Json::Value &)> & onProgress)
+    : Dataset(owner)
+{
+    auto datasetConfig
+        = config.params.convert<ContinuousAggregationDatasetConfig>();
+    itl.reset(new Itl(owner, datasetConfig));
+    itl->init(itl);
+}
+
+ContinuousAggregationDataset::
+~ContinuousAggregationDataset()
+{
+}
+
+Any
+ContinuousAggregationDataset::
+getStatus() const
+{
+    return itl->getStatus();
+}
+
+std::shared_ptr<MatrixView>
+ContinuousAggregationDataset::
+getMatrixView() const
+{
+    return itl->materialize()->getMatrixView();
+}
+
+std::shared_ptr<ColumnIndex>
+ContinuousAggregationDataset::
+getColumnIndex() const
+{
+    return itl->materialize()->getColumnIndex();
+}
+
+std::shared_ptr<RowStream>
+ContinuousAggregationDataset::
+getRowStream() const
+{
+    return itl->materialize()->getRowStream();
+}
+
+std::pair<Date, Date>
+ContinuousAggregationDataset::
+getTimestampRange() const
+{
+    return itl->materialize()->getTimestampRange();
+}
+
+static RegisterDatasetType<ContinuousAggregationDataset,
+                           ContinuousAggregationDatasetConfig>
+regContinuousAggregation(builtinPackage(),
+                         "continuous.aggregation",
+                         "Materialized incremental aggregation view over "
+                         "a continuous dataset",
+                         "datasets/ContinuousDataset.md.html",
+                         nullptr,
+                         {MldbEntity::INTERNAL_ENTITY});
+
 } // namespace MLDB
 } // namespace Datacratic
@@ -26,10 +26,13 @@ namespace MLDB {
 /*****************************************************************************/
 
 struct ContinuousDatasetConfig {
+    ContinuousDatasetConfig();
+
     PolyConfigT<Dataset> metadataDataset;          ///< Dataset for metadata storage
     PolyConfigT<Procedure> createStorageDataset;   ///< Create a storage dataset
     PolyConfigT<Procedure> saveStorageDataset;     ///< Save a storage dataset
     TimePeriod commitInterval;                     ///< Frequency for auto-commit
+    int compactionThreshold;                       ///< Adjacent same-size datasets before merge
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(ContinuousDatasetConfig);
@@ -73,6 +76,29 @@ struct ContinuousDataset: public Dataset {
                   const RestRequest & request,
                   RestRequestParsingContext & context) const;
 
+    /** The mutable storage dataset that new rows are currently being
+        recorded to.  Aggregation views query it so that rows that
+        haven't been committed yet still show up in their output.
+    */
+    std::shared_ptr<Dataset> getCurrentStore() const;
+
+    typedef std::function<void (std::shared_ptr<Dataset>)> OnDatasetSaved;
+
+    /** Register a callback for storage datasets as they are saved at
+        each rotation.  Each saved dataset is reported exactly once,
+        after its metadata has been recorded.  Returns a handle for
+        removeOnDatasetSaved.
+    */
+    size_t addOnDatasetSaved(OnDatasetSaved fn);
+
+    /** Remove a callback registered with addOnDatasetSaved. */
+    void removeOnDatasetSaved(size_t handle);
+
+    /** The committed storage datasets, skipping ones that have been
+        folded into a compacted dataset, oldest first.
+    */
+    std::vector<std::shared_ptr<Dataset> > getCommittedDatasets() const;
+
 private:
     ContinuousDatasetConfig datasetConfig;
     struct Itl;
@@ -118,6 +144,61 @@ struct ContinuousWindowDataset: public ForwardedDataset {
 };
 
 
+/*****************************************************************************/
+/* CONTINUOUS AGGREGATION DATASET CONFIG                                     */
+/*****************************************************************************/
+
+struct ContinuousAggregationDatasetConfig {
+    ContinuousAggregationDatasetConfig();
+
+    PolyConfigT<Dataset> dataset;   ///< Continuous dataset to aggregate
+
+    Utf8String select;              ///< Aggregate clauses, each with an alias
+    Utf8String groupBy;             ///< Group keys; empty for a single row
+    Utf8String where;               ///< Filter on the input rows
+    Utf8String rowName;             ///< Expression naming the group rows
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(ContinuousAggregationDatasetConfig);
+
+
+/*****************************************************************************/
+/* CONTINUOUS AGGREGATION DATASET                                            */
+/*****************************************************************************/
+
+/** Materialized incremental aggregation view over a continuous dataset.
+
+    The registered GROUP BY query is decomposed into partial aggregates;
+    each storage dataset is aggregated once, as it is committed, and
+    folded into a live result, so maintenance cost is proportional to
+    the new data rather than the whole history.  Queries see the folded
+    groups plus a partial over the rows still in the mutable store, so
+    freshness is bounded by the cost of aggregating the uncommitted
+    tail, not by the commit interval.
+*/
+
+struct ContinuousAggregationDataset: public Dataset {
+
+    ContinuousAggregationDataset(MldbServer * owner,
+                                 PolyConfig config,
+                                 const std::function<bool (const Json::Value &)> & onProgress);
+
+    virtual ~ContinuousAggregationDataset();
+
+    virtual Any getStatus() const;
+
+    virtual std::shared_ptr<MatrixView> getMatrixView() const;
+    virtual std::shared_ptr<ColumnIndex> getColumnIndex() const;
+    virtual std::shared_ptr<RowStream> getRowStream() const;
+
+    virtual std::pair<Date, Date> getTimestampRange() const;
+
+private:
+    struct Itl;
+    std::shared_ptr<Itl> itl;
+};
+
+
 } // namespace MLDB
 } // namespace Datacratic
 
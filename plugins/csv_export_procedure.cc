@@ -24,6 +24,8 @@
 #include "mldb/vfs/filter_streams.h"
 #include "mldb/soa/utils/csv_writer.h"
 #include "mldb/plugins/sql_config_validator.h"
+#include "mldb/base/thread_pool.h"
+#include "mldb/jml/utils/lightweight_hash.h"
 #include <memory>
 
 using namespace std;
@@ -71,6 +73,147 @@ CsvExportProcedureConfigDescription()
     };
 }
 
+namespace {
+
+/** Fast path for "SELECT *"-shaped exports.
+
+    When the statement selects every column of a plain dataset with no
+    filtering, ordering or windowing, there is no need to round-trip
+    every cell through the query engine and ExpressionValue; we can walk
+    the dataset storage directly, stringify the cells ourselves (the
+    CellValue printers already use the fast dtoa/itoa) and serialize
+    chunks of rows on all cores, concatenating them in row order.
+
+    Returns false if the statement does not have the required shape, in
+    which case the caller falls back to the general query path.
+*/
+bool tryDirectExport(const CsvExportProcedureConfig & config,
+                     const BoundTableExpression & boundDataset,
+                     filter_ostream & out)
+{
+    const SelectStatement & stm = *config.exportData.stm;
+
+    if (!boundDataset.dataset)
+        return false;
+    if ((stm.where && !stm.where->isConstantTrue())
+        || (stm.when.when && !stm.when.when->isConstantTrue())
+        || !stm.orderBy.clauses.empty()
+        || !stm.groupBy.clauses.empty()
+        || stm.offset != 0
+        || stm.limit != -1)
+        return false;
+
+    SqlExpressionDatasetScope dscope(*boundDataset.dataset,
+                                     boundDataset.asName);
+    if (!stm.select.isIdentitySelect(dscope))
+        return false;
+
+    const Dataset & dataset = *boundDataset.dataset;
+    auto matrix = dataset.getMatrixView();
+    auto stream = dataset.getRowStream();
+    if (!matrix || !stream)
+        return false;
+
+    const char delimiter = config.delimiter.at(0);
+    const char quote = config.quoteChar.at(0);
+
+    // Same quoting rules as CsvWriter, but appending to an in-memory
+    // buffer and without a temporary copy when nothing needs escaping
+    auto appendField = [&] (std::string & output, const std::string & val)
+    {
+        if (val.find(quote) == string::npos
+            && val.find(delimiter) == string::npos) {
+            output += val;
+            return;
+        }
+        output += quote;
+        for (char c: val) {
+            if (c == quote)
+                output += quote;
+            output += c;
+        }
+        output += quote;
+    };
+
+    const vector<ColumnName> columnNames = dataset.getColumnNames();
+    ML::Lightweight_Hash<ColumnHash, int> columnIndex;
+    for (unsigned i = 0;  i < columnNames.size();  ++i)
+        columnIndex[columnNames[i]] = i;
+
+    if (config.headers) {
+        std::string headerLine;
+        for (unsigned i = 0;  i < columnNames.size();  ++i) {
+            if (i != 0)
+                headerLine += delimiter;
+            appendField(headerLine, columnNames[i].toUtf8String().rawString());
+        }
+        headerLine += '\n';
+        out << headerLine;
+    }
+
+    const size_t numRows = matrix->getRowCount();
+    constexpr size_t ROWS_PER_CHUNK = 16384;
+    const size_t numChunks = (numRows + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK;
+
+    vector<std::string> chunkOutput(numChunks);
+
+    auto doChunk = [&] (size_t chunkNum)
+    {
+        const size_t firstRow = chunkNum * ROWS_PER_CHUNK;
+        const size_t lastRow = std::min(numRows, firstRow + ROWS_PER_CHUNK);
+
+        auto myStream = stream->clone();
+        myStream->initAt(firstRow);
+
+        std::string & output = chunkOutput[chunkNum];
+        vector<CellValue> cells(columnNames.size());
+
+        for (size_t r = firstRow;  r < lastRow;  ++r) {
+            RowName rowName = myStream->next();
+            MatrixNamedRow row = matrix->getRow(rowName);
+
+            for (auto & c: row.columns) {
+                auto it = columnIndex.find(std::get<0>(c));
+                if (it == columnIndex.end())
+                    throw ML::Exception("CSV export found a column that is "
+                                        "not in the dataset column index");
+                CellValue & cell = cells[it->second];
+                if (!cell.empty())
+                    throw ML::Exception("CSV export does not work over "
+                                        "cells having multiple values");
+                cell = std::move(std::get<1>(c));
+            }
+
+            for (unsigned i = 0;  i < cells.size();  ++i) {
+                if (i != 0)
+                    output += delimiter;
+                if (!cells[i].empty()) {
+                    appendField(output, cells[i].toString());
+                    cells[i] = CellValue();
+                }
+            }
+            output += '\n';
+        }
+    };
+
+    // Bound the memory taken by in-flight chunks while still keeping
+    // every core busy; each batch is written out in row order before
+    // the next one is serialized
+    const size_t chunksInFlight = std::max(numCpus() * 4, 1);
+    for (size_t chunk0 = 0;  chunk0 < numChunks;  chunk0 += chunksInFlight) {
+        size_t chunk1 = std::min(numChunks, chunk0 + chunksInFlight);
+        parallelMap(chunk0, chunk1, doChunk);
+        for (size_t i = chunk0;  i < chunk1;  ++i) {
+            out << chunkOutput[i];
+            std::string().swap(chunkOutput[i]);
+        }
+    }
+
+    return true;
+}
+
+} // file scope
+
 CsvExportProcedure::
 CsvExportProcedure(MldbServer * owner,
                  PolyConfig config,
@@ -88,11 +231,19 @@ run(const ProcedureRunConfig & run,
     auto runProcConf = applyRunConfOverProcConf(procedureConfig, run);
     SqlExpressionMldbScope context(server);
     filter_ostream out(runProcConf.dataFileUrl.toString());
-    CsvWriter csv(out, runProcConf.delimiter.at(0),
-                  runProcConf.quoteChar.at(0));
 
     auto boundDataset = runProcConf.exportData.stm->from->bind(context);
 
+    // "SELECT *" over a plain dataset can be written straight from
+    // storage without going through the query engine
+    if (tryDirectExport(runProcConf, boundDataset, out)) {
+        RunOutput output;
+        return output;
+    }
+
+    CsvWriter csv(out, runProcConf.delimiter.at(0),
+                  runProcConf.quoteChar.at(0));
+
     vector<shared_ptr<SqlExpression> > calc;
     BoundSelectQuery bsq(runProcConf.exportData.stm->select,
                          *boundDataset.dataset,
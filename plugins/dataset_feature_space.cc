@@ -107,11 +107,21 @@ getColumnInfo(std::shared_ptr<Dataset> dataset,
             //cerr << "feature " << columnName << " has types " << jsonEncodeStr(types)
             //     << endl;
 
-            if (types.count(CellValue::ASCII_STRING) || 
+            if (types.count(CellValue::ASCII_STRING) ||
                 types.count(CellValue::UTF8_STRING)) {
                 // Has string values; make it categorical
                 auto categorical = std::make_shared<ML::Fixed_Categorical_Info>(allValues);
                 result.info = ML::Feature_Info(categorical);
+
+                // Pre-resolve every training value to its code, so the
+                // per-cell encoding paths below don't have to print the
+                // value and look the string up
+                result.categoricalLookup.reserve(allValues.size());
+                size_t i = 0;
+                for (auto & v: stats.values) {
+                    result.categoricalLookup[v.first.hash()]
+                        = categorical->lookup(allValues[i++]);
+                }
             }
             else {
                 result.info = ML::REAL;
@@ -120,8 +130,8 @@ getColumnInfo(std::shared_ptr<Dataset> dataset,
     }
     else {
         auto bucketsAndDescriptions
-            = dataset->getColumnIndex()
-            ->getColumnBuckets(columnName, 255 /* num buckets */);
+            = dataset->getColumnBucketsCached(columnName,
+                                              255 /* num buckets */);
 
         BucketList & buckets = std::get<0>(bucketsAndDescriptions);
         BucketDescriptions & descriptions = std::get<1>(bucketsAndDescriptions);
@@ -146,7 +156,7 @@ encodeFeatureValue(ColumnHash column, const CellValue & value) const
         throw ML::Exception("Encoding unknown column");
     }
 
-    return encodeValue(value, it->second.columnName, it->second.info);
+    return encodeValue(value, it->second.columnName, it->second);
 }
 
 void
@@ -164,7 +174,7 @@ encodeFeature(ColumnHash column, const CellValue & value,
 
     fset.emplace_back(getFeature(column),
                       encodeValue(value, it->second.columnName,
-                                  it->second.info));
+                                  it->second));
 }
 
 std::pair<int, int>
@@ -181,10 +191,14 @@ getFeatureBucket(ColumnHash column, const CellValue & value) const
 
     if (it->second.info.type() == ML::CATEGORICAL
         || it->second.info.type() == ML::STRING) {
+        auto fit = it->second.categoricalLookup.find(value.hash());
+        if (fit != it->second.categoricalLookup.end())
+            return { it->second.index, fit->second };
+
         std::string key;
         if (value.isUtf8String())
             key = value.toUtf8String().rawString();
-        else 
+        else
             key  = value.toString();
 
         int val = it->second.info.categorical()->lookup(key);
@@ -210,6 +224,24 @@ encodeLabel(const CellValue & value, bool isRegression) const
     }
 }
 
+float
+DatasetFeatureSpace::
+encodeValue(const CellValue & value,
+            const ColumnName & columnName,
+            const ColumnInfo & columnInfo) const
+{
+    // Values seen in training resolve straight to their code from the
+    // value's hash; anything else (including numerics) goes through
+    // the generic path below
+    if (!value.empty() && !columnInfo.categoricalLookup.empty()) {
+        auto it = columnInfo.categoricalLookup.find(value.hash());
+        if (it != columnInfo.categoricalLookup.end())
+            return it->second;
+    }
+
+    return encodeValue(value, columnName, columnInfo.info);
+}
+
 float
 DatasetFeatureSpace::
 encodeValue(const CellValue & value,
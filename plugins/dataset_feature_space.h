@@ -60,6 +60,11 @@ struct DatasetFeatureSpace: public ML::Feature_Space {
         BucketList buckets;
         BucketDescriptions bucketDescriptions;
 
+        /// For categorical columns, the code of each value seen in
+        /// training keyed by the value's hash, so that encoding a cell
+        /// is a hash lookup rather than a string round trip
+        std::unordered_map<CellValueHash, int> categoricalLookup;
+
         Utf8String print() const {
             return "[Column '"+columnName.toUtf8String()
                 +"'; Info: "+info.print()+
@@ -99,9 +104,9 @@ struct DatasetFeatureSpace: public ML::Feature_Space {
                       const ColumnName & columnName,
                       const ML::Feature_Info & info) const;
 
-/*    float encodeValue(const CellValue & value,
+    float encodeValue(const CellValue & value,
                       const ColumnName & columnName,
-                      const ColumnInfo & columnInfo) const;*/
+                      const ColumnInfo & columnInfo) const;
 
     virtual ML::Feature_Info info(const ML::Feature & feature) const;
 
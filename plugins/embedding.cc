@@ -9,6 +9,7 @@
 
 #include "embedding.h"
 #include "mldb/ml/tsne/vantage_point_tree.h"
+#include "mldb/ml/hnsw_index.h"
 #include "mldb/arch/rcu_protected.h"
 #include "mldb/rest/rest_request_binding.h"
 #include "mldb/arch/simd_vector.h"
@@ -23,6 +24,7 @@
 #include "mldb/types/jml_serialization.h"
 #include "mldb/types/hash_wrapper_description.h"
 #include "mldb/vfs/filter_streams.h"
+#include "mldb/vfs/fs_utils.h"
 #include "mldb/arch/timers.h"
 
 using namespace std;
@@ -34,33 +36,31 @@ namespace MLDB {
 inline ML::DB::Store_Writer &
 operator << (ML::DB::Store_Writer & store, const PathElement & coord)
 {
-    // Currently not used, since we haven't exposed serialization
-    // of embedding datasets.
-    throw ML::Exception("PathElement serialization");
+    return store << coord.toUtf8String();
 }
 
 inline ML::DB::Store_Reader &
 operator >> (ML::DB::Store_Reader & store, PathElement & coord)
 {
-    // Currently not used, since we haven't exposed serialization
-    // of embedding datasets.
-    throw ML::Exception("PathElement deserialization");
+    Utf8String str;
+    store >> str;
+    coord = PathElement::parse(str);
+    return store;
 }
 
 inline ML::DB::Store_Writer &
 operator << (ML::DB::Store_Writer & store, const Path & coords)
 {
-    // Currently not used, since we haven't exposed serialization
-    // of embedding datasets.
-    throw ML::Exception("Path serialization");
+    return store << coords.toUtf8String();
 }
 
 inline ML::DB::Store_Reader &
 operator >> (ML::DB::Store_Reader & store, Path & coords)
 {
-    // Currently not used, since we haven't exposed serialization
-    // of embedding datasets.
-    throw ML::Exception("Path deserialization");
+    Utf8String str;
+    store >> str;
+    coords = Path::parse(str);
+    return store;
 }
 
 
@@ -68,6 +68,22 @@ operator >> (ML::DB::Store_Reader & store, Path & coords)
 /* EMBEDDING DATASET CONFIG                                                  */
 /*****************************************************************************/
 
+DEFINE_ENUM_DESCRIPTION(EmbeddingIndexType);
+
+EmbeddingIndexTypeDescription::
+EmbeddingIndexTypeDescription()
+{
+    addValue("vantagepoint", INDEX_VANTAGE_POINT,
+             "Index with a vantage point tree.  Nearest neighbors searches "
+             "are exact, but their cost grows quickly with the "
+             "dimensionality of the embedding.");
+    addValue("hnsw", INDEX_HNSW,
+             "Index with a Hierarchical Navigable Small World graph.  "
+             "Nearest neighbors searches are approximate but typically "
+             "much faster on large, high-dimensional embeddings; the ef "
+             "parameter of the search trades accuracy for speed.");
+}
+
 DEFINE_STRUCTURE_DESCRIPTION(EmbeddingDatasetConfig);
 
 EmbeddingDatasetConfigDescription::
@@ -81,6 +97,32 @@ EmbeddingDatasetConfigDescription()
              "good for normalized embeddings like the SVD) and 'euclidean' "
              "(which is good for geometric embeddings like the t-SNE "
              "algorithm).", METRIC_EUCLIDEAN);
+    addField("indexType", &EmbeddingDatasetConfig::indexType,
+             "Index built over the embedding when the dataset is "
+             "committed, and used to answer nearest neighbors queries.",
+             INDEX_VANTAGE_POINT);
+    addField("hnswM", &EmbeddingDatasetConfig::hnswM,
+             "Number of graph links per row for the 'hnsw' index type.  "
+             "Higher values give better recall at the cost of memory and "
+             "indexing time.  Ignored for other index types.",
+             unsigned(16));
+    addField("hnswEfConstruction", &EmbeddingDatasetConfig::hnswEfConstruction,
+             "Size of the candidate list used when building the 'hnsw' "
+             "index.  Higher values give a better quality graph at the "
+             "cost of indexing time.  Ignored for other index types.",
+             unsigned(200));
+    addField("quantize", &EmbeddingDatasetConfig::quantize,
+             "If true, the coordinates are stored as int8 values with a "
+             "per-column scale once the dataset is committed, cutting "
+             "memory usage 4x and speeding up distance scans at a small "
+             "cost in the accuracy of distances and of the values read "
+             "back from the dataset.", false);
+    addField("dataFileUrl", &EmbeddingDatasetConfig::dataFileUrl,
+             "Optional file that the committed dataset, including its "
+             "built nearest neighbors index, is persisted to.  If the "
+             "file already exists when the dataset is created, the "
+             "dataset is reloaded from it instead of being re-recorded "
+             "and re-indexed.");
 }
 
 
@@ -112,7 +154,15 @@ struct EmbeddingDatasetRepr {
           columnIndex(other.columnIndex),
           rows(other.rows),
           rowIndex(other.rowIndex),
-          vpTree(ML::VantagePointTreeT<int>::deepCopy(other.vpTree.get()))
+          numIndexed(other.numIndexed),
+          coordStore(other.coordStore),
+          quantizedCoords(other.quantizedCoords),
+          quantizationScale(other.quantizationScale),
+          quantizationScaleSqr(other.quantizationScaleSqr),
+          vpTree(ML::VantagePointTreeT<int>::deepCopy(other.vpTree.get())),
+          hnswIndex(other.hnswIndex
+                    ? new ML::HnswIndex(*other.hnswIndex)
+                    : nullptr)
     {
     }
 
@@ -145,6 +195,10 @@ struct EmbeddingDatasetRepr {
     }
 
     struct Row {
+        Row()
+        {
+        }
+
         Row(RowName rowName, ML::distribution<float> coords, Date timestamp)
             : rowName(std::move(rowName)), coords(std::move(coords))
         {
@@ -158,6 +212,13 @@ struct EmbeddingDatasetRepr {
         {
             store << rowName.toUtf8String() << coords << timestamp;
         }
+
+        void reconstitute(ML::DB::Store_Reader & store)
+        {
+            Utf8String name;
+            store >> name >> coords >> timestamp;
+            rowName = RowName::parse(name);
+        }
     };
 
     float dist(unsigned row1, unsigned row2) const
@@ -167,11 +228,30 @@ struct EmbeddingDatasetRepr {
 
         if (row1 == row2)
             return 0.0f;
-        
+
+        if (quantized()) {
+            float result = distance->distQuantized(row1, row2,
+                                                   quantizedRow(row1),
+                                                   quantizedRow(row2),
+                                                   &quantizationScaleSqr[0],
+                                                   columnNames.size());
+            ExcAssert(isfinite(result));
+            return result;
+        }
+
+        if (packed()) {
+            float result = distance->distFlat(row1, row2,
+                                              packedRow(row1),
+                                              packedRow(row2),
+                                              columnNames.size());
+            ExcAssert(isfinite(result));
+            return result;
+        }
+
         float result = distance->dist(row1, row2,
                                       rows[row1].coords,
                                       rows[row2].coords);
-        
+
         ExcAssert(isfinite(result));
         return result;
     }
@@ -180,14 +260,196 @@ struct EmbeddingDatasetRepr {
     {
         ExcAssertLess(row1, rows.size());
         ExcAssertEqual(row2.size(), columns.size());
-        
+
+        if (quantized()) {
+            std::vector<int8_t> quantizedQuery = quantizeCoords(row2);
+            return distQuantizedQuery(row1, quantizedQuery.data());
+        }
+
+        if (packed()) {
+            float result = distance->distFlat(row1, -1,
+                                              packedRow(row1),
+                                              row2.data(),
+                                              columnNames.size());
+            ExcAssert(isfinite(result));
+            return result;
+        }
+
         float result = distance->dist(row1, -1,
                                       rows[row1].coords,
                                       row2);
         ExcAssert(isfinite(result));
         return result;
     }
-    
+
+    float distQuantizedQuery(unsigned row1, const int8_t * query) const
+    {
+        ExcAssertLess(row1, rows.size());
+        ExcAssert(quantized());
+
+        float result = distance->distQuantized(row1, -1,
+                                               quantizedRow(row1),
+                                               query,
+                                               &quantizationScaleSqr[0],
+                                               columnNames.size());
+        ExcAssert(isfinite(result));
+        return result;
+    }
+
+    bool quantized() const
+    {
+        return !quantizedCoords.empty();
+    }
+
+    const int8_t * quantizedRow(unsigned row) const
+    {
+        return &quantizedCoords[(size_t)row * columnNames.size()];
+    }
+
+    bool packed() const
+    {
+        return !coordStore.empty();
+    }
+
+    const float * packedRow(unsigned row) const
+    {
+        return &coordStore[(size_t)row * columnNames.size()];
+    }
+
+    /** Return the given coordinate of the given row, from the packed
+        or quantized storage once it has been built. */
+    float coord(unsigned row, unsigned col) const
+    {
+        if (quantized())
+            return quantizedRow(row)[col] * quantizationScale[col];
+        if (packed())
+            return packedRow(row)[col];
+        return rows[row].coords[col];
+    }
+
+    /** Quantize a query point with the dataset's per-column scales. */
+    std::vector<int8_t> quantizeCoords(const ML::distribution<float> & coords) const
+    {
+        std::vector<int8_t> result(coords.size());
+        for (unsigned j = 0;  j < coords.size();  ++j) {
+            float scaled = coords[j] / quantizationScale[j];
+            result[j] = (int8_t)std::max(-127.0f, std::min(127.0f, roundf(scaled)));
+        }
+        return result;
+    }
+
+    /** Decode a full column from the quantized storage. */
+    std::vector<float> decodeColumn(unsigned col) const
+    {
+        std::vector<float> result(rows.size());
+        for (size_t i = 0;  i < rows.size();  ++i)
+            result[i] = quantizedRow(i)[col] * quantizationScale[col];
+        return result;
+    }
+
+    /** Full float coordinates of the given row, decoded from whichever
+        storage is authoritative. */
+    ML::distribution<float> rowCoords(unsigned row) const
+    {
+        size_t numDims = columnNames.size();
+        if (quantized()) {
+            ML::distribution<float> result(numDims);
+            const int8_t * q = quantizedRow(row);
+            for (unsigned j = 0;  j < numDims;  ++j)
+                result[j] = q[j] * quantizationScale[j];
+            return result;
+        }
+        if (packed()) {
+            const float * p = packedRow(row);
+            return ML::distribution<float>(p, p + numDims);
+        }
+        return rows[row].coords;
+    }
+
+    /** Quantize the coordinates to int8 with a per-column scale, and
+        release the float storage: the quantized copy becomes
+        authoritative and serves all reads and distance calculations.
+        Called at commit time when the dataset is configured with
+        quantize=true, after the float column index has been built.
+    */
+    void quantizeAll()
+    {
+        size_t numDims = columnNames.size();
+
+        // Rows quantized by a previous commit keep their bytes; their
+        // float coordinates are gone, and re-scaling would invalidate
+        // them anyway
+        size_t numQuantized = quantizedCoords.size() / numDims;
+
+        if (quantizationScale.empty()) {
+            quantizationScale.resize(numDims);
+            quantizationScaleSqr.resize(numDims);
+
+            for (unsigned j = 0;  j < numDims;  ++j) {
+                float maxAbs = 0.0f;
+                for (float v: columns[j])
+                    maxAbs = std::max(maxAbs, fabsf(v));
+                quantizationScale[j] = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+                quantizationScaleSqr[j]
+                    = quantizationScale[j] * quantizationScale[j];
+            }
+        }
+        // else keep the scales from the first commit; values in newly
+        // added rows that fall outside the original range clamp to ±127
+
+        quantizedCoords.resize(numDims * rows.size());
+
+        auto quantizeRow = [&] (size_t i)
+            {
+                int8_t * q = &quantizedCoords[i * numDims];
+                for (unsigned j = 0;  j < numDims;  ++j) {
+                    // Clamp to guard against rounding past the scale
+                    long v = lrintf(rows[i].coords[j]
+                                    / quantizationScale[j]);
+                    q[j] = (int8_t)std::max(-127l, std::min(127l, v));
+                }
+
+                // Release the float coordinates
+                ML::distribution<float>().swap(rows[i].coords);
+            };
+
+        parallelMap(numQuantized, rows.size(), quantizeRow);
+
+        for (auto & c: columns)
+            std::vector<float>().swap(c);
+    }
+
+    /** Pack the coordinates into a single contiguous row-major
+        allocation and release the per-row distributions: rows are then
+        read at row * numDims in the packed store.  One distribution
+        per row scatters the vectors across the heap, so distance scans
+        chase a pointer per row and the hardware prefetcher can't keep
+        up; packed, consecutive rows are consecutive cache lines.
+        Called at commit time for datasets that aren't quantized (the
+        quantized storage is already contiguous).
+    */
+    void packAll()
+    {
+        size_t numDims = columnNames.size();
+
+        // Rows packed by a previous commit keep their place; their
+        // per-row coordinates are already released
+        size_t numPacked = coordStore.size() / numDims;
+
+        coordStore.resize(numDims * rows.size());
+
+        auto packRow = [&] (size_t i)
+            {
+                float * p = &coordStore[i * numDims];
+                std::copy(rows[i].coords.begin(), rows[i].coords.end(), p);
+
+                // Release the per-row float coordinates
+                ML::distribution<float>().swap(rows[i].coords);
+            };
+
+        parallelMap(numPacked, rows.size(), packRow);
+    }
+
     std::pair<Date, Date> getTimestampRange() const
     {
         // TODO: this could be made more efficiently by caching and updating
@@ -215,21 +477,50 @@ struct EmbeddingDatasetRepr {
 
     std::vector<Row> rows;
     ML::Lightweight_Hash<uint64_t, int> rowIndex;
-    
+
+    /// Number of leading rows that the last commit column-indexed and
+    /// inserted into the distance index.  Rows past it are pending;
+    /// they may still sit in the packed store if they were bulk
+    /// recorded, so this can't be inferred from the store sizes.
+    size_t numIndexed = 0;
+
+    /// Packed (float) coordinate storage, row major and contiguous,
+    /// built at commit time (or extended directly by bulk recording).
+    /// When present, it replaces the per-row distributions in rows.
+    std::vector<float> coordStore;
+
+    /// Quantized (int8) storage, row major, built at commit time when
+    /// the dataset is configured with quantize=true.  When present, it
+    /// replaces the float coordinates.
+    std::vector<int8_t> quantizedCoords;
+    ML::distribution<float> quantizationScale;     ///< Per-column scale
+    ML::distribution<float> quantizationScaleSqr;  ///< Per-column scale^2
+
     std::unique_ptr<ML::VantagePointTreeT<int> > vpTree;
+    std::unique_ptr<ML::HnswIndex> hnswIndex;
     std::unique_ptr<DistanceMetric> distance;
 
     void save(const std::string & filename)
     {
         filter_ostream stream(filename);
         ML::DB::Store_Writer store(stream);
-        
+
         serialize(store);
 
         // Make sure that we saved properly
         stream.close();
     }
+
+    void load(const std::string & filename)
+    {
+        filter_istream stream(filename);
+        ML::DB::Store_Reader store(stream);
+
+        reconstitute(store);
+    }
+
     void serialize(ML::DB::Store_Writer & store) const;
+    void reconstitute(ML::DB::Store_Reader & store);
 };
 
 const RowHash EmbeddingDatasetRepr::nullHashIn(RowName("null"));
@@ -241,27 +532,90 @@ operator << (ML::DB::Store_Writer & store, const EmbeddingDatasetRepr::Row & row
     return store;
 }
 
+ML::DB::Store_Reader &
+operator >> (ML::DB::Store_Reader & store, EmbeddingDatasetRepr::Row & row)
+{
+    row.reconstitute(store);
+    return store;
+}
+
 void
 EmbeddingDatasetRepr::
 serialize(ML::DB::Store_Writer & store) const
 {
     store << string("EMBEDDING_DATASET")
-          << ML::DB::compact_size_t(1);  // version
+          << ML::DB::compact_size_t(2);  // version
     store << columnNames << columns << rows;
+    store << coordStore << quantizedCoords << quantizationScale;
     vpTree->serialize(store);
+    store << ML::DB::compact_size_t(hnswIndex ? 1 : 0);
+    if (hnswIndex)
+        hnswIndex->serialize(store);
+}
+
+void
+EmbeddingDatasetRepr::
+reconstitute(ML::DB::Store_Reader & store)
+{
+    string magic;
+    store >> magic;
+    if (magic != "EMBEDDING_DATASET")
+        throw HttpReturnException(400, "File is not an embedding dataset");
+    ML::DB::compact_size_t version(store);
+    if (version != 2)
+        throw HttpReturnException(400, "Unknown embedding dataset version",
+                                  "version", (int)version);
+
+    store >> columnNames >> columns >> rows;
+    store >> coordStore >> quantizedCoords >> quantizationScale;
+
+    vpTree.reset(new ML::VantagePointTreeT<int>());
+    vpTree->reconstitute(store);
+
+    ML::DB::compact_size_t hasHnsw(store);
+    if (hasHnsw) {
+        hnswIndex.reset(new ML::HnswIndex());
+        hnswIndex->reconstitute(store);
+    }
+
+    // Rebuild the derived state that isn't persisted
+    quantizationScaleSqr = quantizationScale * quantizationScale;
+
+    columnIndex.clear();
+    for (unsigned i = 0;  i < columnNames.size();  ++i)
+        columnIndex[columnNames[i]] = i;
+
+    rowIndex.clear();
+    for (unsigned i = 0;  i < rows.size();  ++i)
+        rowIndex[getRowHashForIndex(rows[i].rowName)] = i;
+
+    // A persisted repr is fully indexed
+    numIndexed = rows.size();
+
+    for (unsigned i = 0;  i < rows.size();  ++i)
+        distance->addRow(i, rowCoords(i));
 }
 
 struct EmbeddingDataset::Itl
     : public MatrixView, public ColumnIndex {
-    Itl(MetricSpace metric)
-        : metric(metric), committed(lock, metric), uncommitted(nullptr)
+    Itl(const EmbeddingDatasetConfig & config)
+        : metric(config.metric), indexConfig(config),
+          committed(lock, config.metric), uncommitted(nullptr)
     {
     }
 
-    // TODO: make it loadable...
-    Itl(const std::string & address, MetricSpace metric)
-        : metric(metric), committed(lock, metric), uncommitted(nullptr), address(address)
+    Itl(const std::string & address, const EmbeddingDatasetConfig & config)
+        : metric(config.metric), indexConfig(config),
+          committed(lock, config.metric), uncommitted(nullptr), address(address)
     {
+        // If the file already exists, reload the committed dataset and
+        // its index from it rather than waiting to be re-recorded
+        if (tryGetUriObjectInfo(address)) {
+            std::unique_ptr<EmbeddingDatasetRepr> repr
+                (new EmbeddingDatasetRepr(config.metric));
+            repr->load(address);
+            committed.replace(repr.release());
+        }
     }
 
     ~Itl()
@@ -270,6 +624,7 @@ struct EmbeddingDataset::Itl
     }
 
     MetricSpace metric;
+    EmbeddingDatasetConfig indexConfig;
 
     GcLock lock;
     RcuProtected<EmbeddingDatasetRepr> committed;
@@ -318,10 +673,14 @@ struct EmbeddingDataset::Itl
         }
 
         virtual RowName next() {
-            auto repr = source->committed();     
+            auto repr = source->committed();
             return repr->rows[index++].rowName;
         }
 
+        virtual void advanceBy(size_t n) {
+            index += n;
+        }
+
         size_t index;
         const EmbeddingDataset::Itl* source;
     };
@@ -386,10 +745,11 @@ struct EmbeddingDataset::Itl
 
         MatrixNamedRow result;
         result.rowHash = result.rowName = rowName;
-        result.columns.reserve(row.coords.size());
+        result.columns.reserve(repr->columnNames.size());
 
-        for (unsigned i = 0;  i < row.coords.size();  ++i) {
-            result.columns.emplace_back(repr->columnNames[i], row.coords[i],
+        for (unsigned i = 0;  i < repr->columnNames.size();  ++i) {
+            result.columns.emplace_back(repr->columnNames[i],
+                                        repr->coord(it->second, i),
                                         row.timestamp);
         }
         return result;
@@ -410,10 +770,11 @@ struct EmbeddingDataset::Itl
         MatrixRow result;
         result.rowHash = rowHash;
         result.rowName = row.rowName;
-        result.columns.reserve(row.coords.size());
+        result.columns.reserve(repr->columnNames.size());
 
-        for (unsigned i = 0;  i < row.coords.size();  ++i) {
-            result.columns.emplace_back(repr->columnNames[i], row.coords[i],
+        for (unsigned i = 0;  i < repr->columnNames.size();  ++i) {
+            result.columns.emplace_back(repr->columnNames[i],
+                                        repr->coord(it->second, i),
                                         row.timestamp);
         }
         return result;
@@ -514,7 +875,11 @@ struct EmbeddingDataset::Itl
         if (it == repr->columnIndex.end())
             throw HttpReturnException(400, "Can't get name of unknown column");
 
-        const vector<float> & columnVals = repr->columns.at(it->second);
+        vector<float> decoded;
+        if (repr->quantized())
+            decoded = repr->decodeColumn(it->second);
+        const vector<float> & columnVals
+            = repr->quantized() ? decoded : repr->columns.at(it->second);
 
         toStoreResult.isNumeric_ = true;
         toStoreResult.atMostOne_ = true;
@@ -539,7 +904,11 @@ struct EmbeddingDataset::Itl
         if (it == repr->columnIndex.end())
             throw HttpReturnException(400, "Can't get name of unknown column");
 
-        const vector<float> & columnVals = repr->columns.at(it->second);
+        vector<float> decoded;
+        if (repr->quantized())
+            decoded = repr->decodeColumn(it->second);
+        const vector<float> & columnVals
+            = repr->quantized() ? decoded : repr->columns.at(it->second);
 
         MatrixColumn result;
 
@@ -697,7 +1066,114 @@ struct EmbeddingDataset::Itl
                 if ((*uncommitted).rows.size() > numRowsBefore)
                     (*uncommitted).rows.pop_back();
                 throw;
-            }        
+            }
+        }
+    }
+
+    virtual void
+    recordEmbedding(const std::vector<ColumnName> & columnNames,
+                    const std::vector<std::pair<RowName, Date> > & rows,
+                    const float * coords)
+    {
+        auto repr = committed();
+        std::unique_lock<Mutex> guard(mutex);
+
+        // If this is the first commit, then create a new structure with the
+        // column names now that we know them
+        if (!uncommitted) {
+            if (!repr->initialized()) {
+                // First commit; we just learnt the column names
+                uncommitted = new EmbeddingDatasetRepr(columnNames, metric);
+            }
+            else {
+                uncommitted = new EmbeddingDatasetRepr(*repr);
+            }
+        }
+        else {
+            if (columnNames.size() != uncommitted.load()->columnNames.size())
+                throw HttpReturnException(400, "Attempt to change number of columns in embedding dataset");
+            if (columnNames != uncommitted.load()->columnNames)
+                throw HttpReturnException(400, "Attempt to change column names in embedding dataset");
+        }
+
+        size_t numDims = columnNames.size();
+
+        // The batch extends the packed (SoA) store directly when every
+        // row so far is packed, which is always the case when loading
+        // exclusively through this interface.  Rows recorded through the
+        // row-by-row interfaces before a commit have per-row coordinates
+        // instead; then the batch takes the same form, and the commit
+        // packs everything.  Quantized datasets never use the float
+        // store, so they always take the per-row form.
+        bool packDirectly = !indexConfig.quantize
+            && (*uncommitted).coordStore.size()
+               == (*uncommitted).rows.size() * numDims;
+
+        (*uncommitted).rows.reserve((*uncommitted).rows.size() + rows.size());
+        if (packDirectly)
+            (*uncommitted).coordStore.reserve
+                (((*uncommitted).rows.size() + rows.size()) * numDims);
+
+        // One scratch embedding reused across the batch; the distance
+        // metric only reads it
+        ML::distribution<float> embedding(numDims);
+
+        for (size_t i = 0;  i < rows.size();  ++i) {
+            const RowName & rowName = rows[i].first;
+            const float * rowCoords = coords + i * numDims;
+
+            uint64_t rowHash = EmbeddingDatasetRepr::getRowHashForIndex(rowName);
+            int index = (*uncommitted).rows.size();
+
+            if (!(*uncommitted).rowIndex.insert({ rowHash, index }).second) {
+                if ((*uncommitted).rowIndex[rowHash] == -1)
+                    (*uncommitted).rowIndex[rowHash] = index;
+                else {
+                    // Check if it's a double record or a hash collision
+                    RowName oldName
+                        = (*uncommitted).rows.at((*uncommitted).rowIndex[rowHash])
+                        .rowName;
+                    if (oldName == rowName)
+                        throw HttpReturnException
+                            (400, "Row '" + rowName.toUtf8String()
+                             + "' has already been recorded into embedding dataset.  "
+                             + "Are you re-using an output dataset (3)?");
+                    else {
+                        throw HttpReturnException
+                            (400, "Row '" + rowName.toUtf8String() + "' and '"
+                             + oldName.toUtf8String() + "' both hash to '"
+                             + RowHash(rowName).toString() + "' (hash collision). "
+                             + "You may be able to modify your names to avoid the collision.");
+                    }
+                }
+            }
+
+            std::copy(rowCoords, rowCoords + numDims, embedding.begin());
+
+            size_t numRowsBefore = (*uncommitted).rows.size();
+
+            try {
+                if (packDirectly) {
+                    (*uncommitted).coordStore.insert
+                        ((*uncommitted).coordStore.end(),
+                         rowCoords, rowCoords + numDims);
+                    (*uncommitted).rows.emplace_back
+                        (rowName, ML::distribution<float>(), rows[i].second);
+                }
+                else {
+                    (*uncommitted).rows.emplace_back(rowName, embedding,
+                                                     rows[i].second);
+                }
+                (*uncommitted).distance->addRow(numRowsBefore, embedding);
+            } catch (const std::exception & exc) {
+                // If there is an exception, keep the data structure consistent
+                (*uncommitted).rowIndex[rowHash] = -1;
+                if ((*uncommitted).rows.size() > numRowsBefore)
+                    (*uncommitted).rows.pop_back();
+                if (packDirectly)
+                    (*uncommitted).coordStore.resize(numRowsBefore * numDims);
+                throw;
+            }
         }
     }
 
@@ -825,27 +1301,104 @@ struct EmbeddingDataset::Itl
         if (!uncommitted)
             return;
 
+        size_t numRows = (*uncommitted).rows.size();
+        size_t numDims = (*uncommitted).columnNames.size();
+
+        // Rows that a previous commit already indexed; the steps below
+        // only touch the rows recorded since.  Bulk recorded rows may
+        // already sit in the packed store, so the store sizes can't
+        // tell us.
+        size_t numIndexed = (*uncommitted).numIndexed;
+
         for (unsigned j = 0;  j < (*uncommitted).columns.size();  ++j)
-            (*uncommitted).columns[j].resize((*uncommitted).rows.size());
+            (*uncommitted).columns[j].resize(numRows);
 
-        // Create the column index; this is a standard matrix inversion
+        // Create the column index; this is a standard matrix inversion.
+        // Bulk recorded rows have their coordinates in the packed store
+        // rather than per row.
         auto indexRow = [&] (size_t i)
             {
+                const auto & coords = (*uncommitted).rows[i].coords;
+                const float * src = coords.empty()
+                    ? (*uncommitted).packedRow(i)
+                    : coords.data();
                 for (unsigned j = 0;  j < (*uncommitted).columns.size();  ++j)
-                    (*uncommitted).columns[j][i] = (*uncommitted).rows[i].coords[j];
+                    (*uncommitted).columns[j][i] = src[j];
             };
 
-        parallelMap(0, (*uncommitted).rows.size(), indexRow);
+        parallelMap(numIndexed, numRows, indexRow);
+
+        if (indexConfig.quantize) {
+            cerr << "quantizing embedding to int8" << endl;
+            (*uncommitted).quantizeAll();
+        }
+        else {
+            // Pack the coordinates so the index build and searches
+            // stream over contiguous storage
+            (*uncommitted).packAll();
+        }
+
+        if (indexConfig.indexType == INDEX_HNSW) {
+            // Create or extend the HNSW graph for approximate indexed
+            // lookups on distance; the graph is built by insertion, so
+            // rows added since the last commit just join it
+            cerr << "indexing " << (numRows - numIndexed)
+                 << " rows in HNSW index" << endl;
+            ML::Timer timer;
+
+            auto dist = [&] (const int & item1, const int & item2) -> float
+                {
+                    return (*uncommitted).dist(item1, item2);
+                };
+
+            if (!(*uncommitted).hnswIndex) {
+                (*uncommitted).hnswIndex
+                    .reset(new ML::HnswIndex(indexConfig.hnswM,
+                                             indexConfig.hnswEfConstruction));
+            }
+
+            for (size_t i = (*uncommitted).hnswIndex->size();
+                 i < numRows;  ++i)
+                (*uncommitted).hnswIndex->add(i, dist);
+
+            cerr << "HNSW index done in " << timer.elapsed() << endl;
+
+            commitIndexed();
+            return;
+        }
+
+        size_t numNew = numRows - numIndexed;
+        if (numIndexed > 0 && numNew * 100 <= numIndexed) {
+            // Small top-up of a large committed tree: insert the new
+            // rows rather than rebuilding, so the commit is bounded by
+            // the additions rather than the dataset
+            cerr << "inserting " << numNew
+                 << " rows into vantage point tree" << endl;
+            ML::Timer timer;
+
+            for (size_t i = numIndexed;  i < numRows;  ++i) {
+                auto dist = [&] (int item) -> float
+                    {
+                        return (*uncommitted).dist(item, i);
+                    };
+                (*uncommitted).vpTree->insert(i, dist);
+            }
+
+            cerr << "VP tree insert done in " << timer.elapsed() << endl;
+
+            commitIndexed();
+            return;
+        }
 
-        // Create the vantage point tree
-        cerr << "creating vantage point tree" << endl;
-        ML::Timer timer;
-        
         std::vector<int> items;
-        for (unsigned i = 0;  i < (*uncommitted).rows.size();  ++i) {
+        for (unsigned i = 0;  i < numRows;  ++i) {
             items.push_back(i);
         }
 
+        // Create the vantage point tree
+        cerr << "creating vantage point tree" << endl;
+        ML::Timer timer;
+
         // Function used to build the VP tree, that scans all of the items in
         // parallel.
         auto dist = [&] (int item, const std::vector<int> & items, int depth)
@@ -884,7 +1437,14 @@ struct EmbeddingDataset::Itl
         (*uncommitted).vpTree.reset(ML::VantagePointTreeT<int>::createParallel(items, dist));
 
         cerr << "VP tree done in " << timer.elapsed() << endl;
-        
+
+        commitIndexed();
+    }
+
+    /** Publish the uncommitted representation once its index is built. */
+    void commitIndexed()
+    {
+        (*uncommitted).numIndexed = (*uncommitted).rows.size();
         committed.replace(uncommitted);
         uncommitted = nullptr;
 
@@ -894,30 +1454,50 @@ struct EmbeddingDataset::Itl
         }
     }
 
+    /** Default size of the HNSW candidate list when the query doesn't
+        give one: large enough that small searches keep a high recall.
+    */
+    static int defaultEf(int numNeighbors)
+    {
+        return std::max(64, 2 * numNeighbors);
+    }
+
     vector<tuple<RowName, RowHash, float> >
     getNeighbors(const ML::distribution<float> & coord,
                  int numNeighbors,
-                 double maxDistance)
+                 double maxDistance,
+                 int ef)
     {
         auto repr = committed();
         if (!repr->initialized())
             return {};
 
+        // Quantize the query point once, rather than once per distance
+        // calculation
+        std::vector<int8_t> quantizedQuery;
+        if (repr->quantized())
+            quantizedQuery = repr->quantizeCoords(coord);
+
         auto dist = [&] (int item) -> float
         {
-            float result = repr->dist(item, coord);
+            float result = repr->quantized()
+                ? repr->distQuantizedQuery(item, quantizedQuery.data())
+                : repr->dist(item, coord);
             ExcAssert(isfinite(result));
             return result;
         };
 
         //ML::Timer timer;
 
-        auto neighbors = repr->vpTree->search(dist, numNeighbors, maxDistance);
+        auto neighbors = repr->hnswIndex
+            ? repr->hnswIndex->search(dist, numNeighbors, maxDistance,
+                                      ef > 0 ? ef : defaultEf(numNeighbors))
+            : repr->vpTree->search(dist, numNeighbors, maxDistance);
 
         //cerr << "neighbors took " << timer.elapsed() << endl;
 
         //cerr << "neighbors = " << jsonEncode(neighbors) << endl;
-        
+
         vector<tuple<RowName, RowHash, float> > result;
         for (auto & n: neighbors) {
             result.emplace_back(repr->rows[n.second].rowName,
@@ -929,7 +1509,8 @@ struct EmbeddingDataset::Itl
     }
 
     vector<tuple<RowName, RowHash, float> >
-    getRowNeighbors(const RowName & row, int numNeighbors, double maxDistance)
+    getRowNeighbors(const RowName & row, int numNeighbors, double maxDistance,
+                    int ef)
     {
         auto repr = committed();
         if (!repr->initialized())
@@ -952,7 +1533,10 @@ struct EmbeddingDataset::Itl
                 return result;
             };
 
-        auto neighbors = repr->vpTree->search(dist, numNeighbors, maxDistance);
+        auto neighbors = repr->hnswIndex
+            ? repr->hnswIndex->search(dist, numNeighbors, maxDistance,
+                                      ef > 0 ? ef : defaultEf(numNeighbors))
+            : repr->vpTree->search(dist, numNeighbors, maxDistance);
 
         vector<tuple<RowName, RowHash, float> > result;
         for (auto & n: neighbors) {
@@ -972,6 +1556,64 @@ struct EmbeddingDataset::Itl
 
         return repr->getTimestampRange();
     }
+
+    static uint64_t vpTreeBytes(const ML::VantagePointTreeT<int> * node)
+    {
+        if (!node)
+            return 0;
+        uint64_t result = sizeof(*node);
+        // compact_vector inlines a single element
+        if (node->items.size() > 1)
+            result += node->items.size() * sizeof(int);
+        if (node->clump.size() > 1)
+            result += node->clump.size() * sizeof(int);
+        return result
+            + vpTreeBytes(node->inside.get())
+            + vpTreeBytes(node->outside.get());
+    }
+
+    /** Approximate memory held by the committed representation:
+        coordinates (float or quantized), row names and the nearest
+        neighbour indexes.  Rows recorded since the last commit are
+        not counted.
+    */
+    DatasetMemoryUsage getMemoryUsage() const
+    {
+        DatasetMemoryUsage result;
+
+        auto repr = committed();
+        if (!repr->initialized())
+            return result;
+
+        // Coordinates are dense, so each column holds one value per
+        // row; the per-column float index counts with its column when
+        // it has been built
+        uint64_t coordBytes
+            = repr->rows.size()
+              * (repr->quantized() ? sizeof(int8_t) : sizeof(float));
+
+        for (unsigned i = 0;  i < repr->columnNames.size();  ++i) {
+            uint64_t bytes
+                = coordBytes + repr->columns[i].capacity() * sizeof(float);
+            result.columnBytes[repr->columnNames[i]] = bytes;
+            result.totalBytes += bytes;
+        }
+
+        // Row names and the row index
+        for (auto & r: repr->rows)
+            result.rowNameBytes += sizeof(r) + r.rowName.memusage();
+        result.rowNameBytes
+            += repr->rowIndex.capacity() * (sizeof(uint64_t) + sizeof(int));
+        result.totalBytes += result.rowNameBytes;
+
+        // Nearest neighbour indexes
+        result.indexBytes = vpTreeBytes(repr->vpTree.get());
+        if (repr->hnswIndex)
+            result.indexBytes += repr->hnswIndex->memusage();
+        result.totalBytes += result.indexBytes;
+
+        return result;
+    }
 };
 
 
@@ -986,17 +1628,13 @@ EmbeddingDataset(MldbServer * owner,
     : Dataset(owner)
 {
     this->datasetConfig = config.params.convert<EmbeddingDatasetConfig>();
-#if 1
-    itl.reset(new Itl(datasetConfig.metric));
-#else // once persistence is done
-
-    if (!config.address.empty()) {
-        itl.reset(new Itl(config.address));
+    if (!datasetConfig.dataFileUrl.empty()) {
+        itl.reset(new Itl(datasetConfig.dataFileUrl.toString(),
+                          datasetConfig));
     }
     else {
-        itl.reset(new Itl());
+        itl.reset(new Itl(datasetConfig));
     }
-#endif
 }
     
 EmbeddingDataset::
@@ -1027,11 +1665,21 @@ recordEmbedding(const std::vector<ColumnName> & columnNames,
     itl->recordEmbedding(columnNames, rows);
 }
 
+void
+EmbeddingDataset::
+recordEmbedding(const std::vector<ColumnName> & columnNames,
+                const std::vector<std::pair<RowName, Date> > & rows,
+                const float * coords)
+{
+    itl->recordEmbedding(columnNames, rows, coords);
+}
+
 void
 EmbeddingDataset::
 commit()
 {
-    return itl->commit();
+    itl->commit();
+    bumpVersion();
 }
     
 std::pair<Date, Date>
@@ -1041,6 +1689,13 @@ getTimestampRange() const
     return itl->getTimestampRange();
 }
 
+DatasetMemoryUsage
+EmbeddingDataset::
+getMemoryUsage() const
+{
+    return itl->getMemoryUsage();
+}
+
 Date
 EmbeddingDataset::
 quantizeTimestamp(Date timestamp) const
@@ -1080,16 +1735,18 @@ overrideFunction(const Utf8String & tableName,
 
 vector<tuple<RowName, RowHash, float> >
 EmbeddingDataset::
-getNeighbors(const ML::distribution<float> & coord, int numNeighbors, double maxDistance) const
+getNeighbors(const ML::distribution<float> & coord, int numNeighbors,
+             double maxDistance, int ef) const
 {
-    return itl->getNeighbors(coord, numNeighbors, maxDistance);
+    return itl->getNeighbors(coord, numNeighbors, maxDistance, ef);
 }
-    
+
 vector<tuple<RowName, RowHash, float> >
 EmbeddingDataset::
-getRowNeighbors(const RowName & row, int numNeighbors, double maxDistance) const
+getRowNeighbors(const RowName & row, int numNeighbors, double maxDistance,
+                int ef) const
 {
-    return itl->getRowNeighbors(row, numNeighbors, maxDistance);
+    return itl->getRowNeighbors(row, numNeighbors, maxDistance, ef);
 }
 
 KnownColumn
@@ -1164,6 +1821,12 @@ NearestNeighborsInputDescription()
     addField("maxDistance", &NearestNeighborsInput::maxDistance,
              "Maximum distance to accept.  Passing null will use the "
              "value in the config", CellValue());
+    addField("ef", &NearestNeighborsInput::ef,
+             "Size of the candidate list used for the search when the "
+             "underlying dataset has an 'hnsw' index.  Higher values give "
+             "better recall at the cost of latency.  Passing null will "
+             "use a default based on `numNeighbors`; it is ignored for "
+             "an exact index", CellValue());
     addField("coords", &NearestNeighborsInput::coords,
              "Coordinates of the value whose neighbors are being sought, "
              "or alternatively the `rowName` of the value in the underlying "
@@ -1221,24 +1884,29 @@ applyT(const ApplierT & applier_, NearestNeighborsInput input) const
 
     unsigned numNeighbors = functionConfig.defaultNumNeighbors;
     double maxDistance = functionConfig.defaultMaxDistance;
+    int ef = -1;
 
     if(!input.numNeighbors.empty())
         numNeighbors = input.numNeighbors.toInt();
 
     if(!input.maxDistance.empty())
         maxDistance = input.maxDistance.toDouble();
-    
+
+    if(!input.ef.empty())
+        ef = input.ef.toInt();
+
     Date ts;
     vector<tuple<RowName, RowHash, float> > neighbors;
     if (inputRow.isAtom()) {
         neighbors = applier.embeddingDataset
             ->getRowNeighbors(RowName(inputRow.toUtf8String()),
-                               numNeighbors, maxDistance);
+                               numNeighbors, maxDistance, ef);
     }
     else if(inputRow.isEmbedding() || inputRow.isRow()) {
         auto embedding = applier.getEmbeddingFromExpr(inputRow);
         neighbors = applier.embeddingDataset
-            ->getNeighbors(embedding.cast<float>(), numNeighbors, maxDistance);
+            ->getNeighbors(embedding.cast<float>(), numNeighbors, maxDistance,
+                           ef);
     }
     else {
         throw ML::Exception("Input row must be either a row name or an embedding");
@@ -22,13 +22,34 @@ namespace MLDB {
 /* EMBEDDING DATASET CONFIG                                                  */
 /*****************************************************************************/
 
+enum EmbeddingIndexType {
+    INDEX_VANTAGE_POINT,  ///< Exact search over a vantage point tree
+    INDEX_HNSW            ///< Approximate search over an HNSW graph
+};
+
+DECLARE_ENUM_DESCRIPTION(EmbeddingIndexType);
+
 struct EmbeddingDatasetConfig {
     EmbeddingDatasetConfig()
-        : metric(METRIC_EUCLIDEAN)
+        : metric(METRIC_EUCLIDEAN),
+          indexType(INDEX_VANTAGE_POINT),
+          hnswM(16),
+          hnswEfConstruction(200),
+          quantize(false)
     {
     }
 
     MetricSpace metric;
+    EmbeddingIndexType indexType;
+    unsigned hnswM;
+    unsigned hnswEfConstruction;
+    bool quantize;
+
+    /// Optional file that the committed dataset, including its built
+    /// nearest neighbors index, is persisted to.  If the file already
+    /// exists when the dataset is created, the dataset is reloaded
+    /// from it instead of being re-recorded and re-indexed.
+    Url dataFileUrl;
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(EmbeddingDatasetConfig);
@@ -55,6 +76,11 @@ struct EmbeddingDataset: public Dataset {
     recordEmbedding(const std::vector<ColumnName> & columnNames,
                     const std::vector<std::tuple<RowName, std::vector<float>, Date> > & rows);
 
+    virtual void
+    recordEmbedding(const std::vector<ColumnName> & columnNames,
+                    const std::vector<std::pair<RowName, Date> > & rows,
+                    const float * coords);
+
     virtual void commit();
 
     virtual std::shared_ptr<MatrixView> getMatrixView() const;
@@ -73,14 +99,24 @@ struct EmbeddingDataset: public Dataset {
 
     virtual std::vector<KnownColumn>
     getKnownColumnInfos(const std::vector<ColumnName> & columnNames) const;
-    
+
+    /** Memory held by the committed representation, per column.  Rows
+        recorded since the last commit are not counted.
+    */
+    virtual DatasetMemoryUsage getMemoryUsage() const;
+
+    /** Find the closest rows to the given coordinates.  For an
+        HNSW-indexed dataset, ef gives the size of the candidate list
+        used in the search (higher is more accurate but slower), with
+        -1 choosing a default; it is ignored for an exact index.
+    */
     std::vector<std::tuple<RowName, RowHash, float> >
     getNeighbors(const ML::distribution<float> & coord, int numNeighbors,
-                 double maxDistance) const;
-    
+                 double maxDistance, int ef = -1) const;
+
     std::vector<std::tuple<RowName, RowHash, float> >
     getRowNeighbors(const RowName & row, int numNeighbors,
-                    double maxDistance) const;
+                    double maxDistance, int ef = -1) const;
 
 private:
     EmbeddingDatasetConfig datasetConfig;
@@ -114,6 +150,7 @@ struct NearestNeighborsInput {
     ExpressionValue coords;
     CellValue numNeighbors; // positive integer or null
     CellValue maxDistance;  // double or null
+    CellValue ef;           // positive integer or null
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(NearestNeighborsInput);
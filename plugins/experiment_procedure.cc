@@ -21,6 +21,9 @@
 #include "mldb/plugins/sql_config_validator.h"
 #include "mldb/plugins/sql_expression_extractors.h"
 #include "mldb/plugins/sparse_matrix_dataset.h"
+#include "mldb/base/parallel.h"
+
+#include <mutex>
 
 using namespace std;
 
@@ -179,6 +182,13 @@ ExperimentProcedureConfigDescription()
               "test set is very large and aggregate statistics for each unique score is "
               "sufficient, for instance to generate a ROC curve. This has no effect "
               "for other values of `mode`.", false);
+    addField("parallelism", &ExperimentProcedureConfig::parallelism,
+             "Number of dataset folds to run concurrently. The default of 1 "
+             "runs the folds one after the other. Each fold still parallelizes "
+             "its own training and testing internally over the same thread "
+             "pool, so this mainly helps when the individual trainings leave "
+             "cores idle during their single-threaded phases; a value of 2 or "
+             "3 is usually enough to keep the machine busy.", 1);
     addParent<ProcedureConfig>();
 
     onPostValidate = chain(validateQuery(&ExperimentProcedureConfig::inputData,
@@ -296,15 +306,20 @@ run(const ProcedureRunConfig & run,
 
     auto runProcConf = applyRunConfOverProcConf(procConfig, run);
 
-    std::atomic<int> progress(0);
-
+    // Guards the stats generators, the resource list and the onProgress
+    // callback, all of which are shared between concurrently running folds
+    std::mutex resultsLock;
 
-    auto onProgress2 = [&] (const Json::Value & details)
+    auto makeOnProgress = [&] (size_t foldNumber)
         {
-            Json::Value value;
-            value["foldNumber"] = (int)progress;
-            value["details"] = details;
-            return onProgress(value);
+            return [&, foldNumber] (const Json::Value & details)
+                {
+                    Json::Value value;
+                    value["foldNumber"] = (int)foldNumber;
+                    value["details"] = details;
+                    std::unique_lock<std::mutex> guard(resultsLock);
+                    return onProgress(value);
+                };
         };
 
     vector<string> resourcesToDelete;
@@ -312,9 +327,6 @@ run(const ProcedureRunConfig & run,
     std::shared_ptr<Procedure> clsProcedure;
     std::shared_ptr<Procedure> accuracyProc;
 
-
-    Json::Value test_eval_results(Json::ValueType::arrayValue);
-
     if(!runProcConf.inputData.stm) {
         throw ML::Exception("Training data must be specified.");
     }
@@ -327,6 +339,9 @@ run(const ProcedureRunConfig & run,
     else if(runProcConf.kfold == 1) {
         throw ML::Exception("When using the kfold parameter, it must be >= 2.");
     }
+    else if(runProcConf.parallelism < 1) {
+        throw ML::Exception("The parallelism parameter must be >= 1.");
+    }
 
     // default behaviour if nothing is defined
     if(runProcConf.datasetFolds.size() == 0 && runProcConf.kfold == 0) {
@@ -363,51 +378,142 @@ run(const ProcedureRunConfig & run,
 
     ExcAssertGreater(runProcConf.datasetFolds.size(), 0);
 
-    for(auto & datasetFold : runProcConf.datasetFolds) {
+    size_t numFolds = runProcConf.datasetFolds.size();
+
+    // Per-fold results, in fold order
+    vector<Json::Value> foldResults(numFolds);
+
+    auto makeClassifierConfig = [&] (size_t foldNumber)
+        {
+            auto & datasetFold = runProcConf.datasetFolds[foldNumber];
+
+            ClassifierConfig clsProcConf;
+            clsProcConf.trainingData = runProcConf.inputData;
+            clsProcConf.trainingData.stm->where = datasetFold.trainingWhere;
+            clsProcConf.trainingData.stm->limit = datasetFold.trainingLimit;
+            clsProcConf.trainingData.stm->offset = datasetFold.trainingOffset;
+            clsProcConf.trainingData.stm->orderBy = datasetFold.trainingOrderBy;
+
+            string baseUrl = runProcConf.modelFileUrlPattern.toString();
+            ML::replace_all(baseUrl, "$runid",
+                            ML::format("%s-%d", runProcConf.experimentName,
+                                       (int)foldNumber));
+            clsProcConf.modelFileUrl = Url(baseUrl);
+            clsProcConf.configuration = runProcConf.configuration;
+            clsProcConf.configurationFile = runProcConf.configurationFile;
+            clsProcConf.algorithm = runProcConf.algorithm;
+            clsProcConf.equalizationFactor = runProcConf.equalizationFactor;
+            clsProcConf.mode = runProcConf.mode;
+
+            clsProcConf.functionName = ML::format("%s_scorer_%d",
+                                                  runProcConf.experimentName,
+                                                  (int)foldNumber);
+
+            return clsProcConf;
+        };
+
+    auto makeAccuracyConfig = [&] (size_t foldNumber, bool onTestSet,
+                                   bool prepareOutputDataset)
+        {
+            auto & datasetFold = runProcConf.datasetFolds[foldNumber];
+
+            // create config for the accuracy procedure
+            AccuracyConfig accuracyConfig;
+            accuracyConfig.mode = runProcConf.mode;
+            accuracyConfig.uniqueScoresOnly = runProcConf.uniqueScoresOnly;
+
+            if(runProcConf.outputAccuracyDataset && onTestSet) {
+                PolyConfigT<Dataset> outputPC;
+                outputPC.id = ML::format("%s_results_%d", runProcConf.experimentName,
+                                                          (int)foldNumber);
+                outputPC.type = "tabular";
+
+                if(prepareOutputDataset) {
+                    InProcessRestConnection connection;
+                    RestRequest request("DELETE", "/v1/datasets/"+outputPC.id.utf8String(),
+                                        RestParams(), "{}");
+                    server->handleRequest(connection, request);
+
+                    if(connection.responseCode != 204) {
+                        throw ML::Exception("HTTP error "+std::to_string(connection.responseCode)+
+                            " when trying to DELETE dataset '"+outputPC.id.utf8String()+"'");
+                    }
+                }
+                accuracyConfig.outputDataset.emplace(outputPC);
+            }
+
+            if(onTestSet) {
+                accuracyConfig.testingData =
+                    runProcConf.testingDataOverride ? *runProcConf.testingDataOverride
+                                                    : runProcConf.inputData;
+                accuracyConfig.testingData.stm->where = datasetFold.testingWhere;
+                accuracyConfig.testingData.stm->limit = datasetFold.testingLimit;
+                accuracyConfig.testingData.stm->offset = datasetFold.testingOffset;
+                accuracyConfig.testingData.stm->orderBy = datasetFold.testingOrderBy;
+            }
+            else {
+                accuracyConfig.testingData = runProcConf.inputData;
+                accuracyConfig.testingData.stm->where = datasetFold.trainingWhere;
+                accuracyConfig.testingData.stm->limit = datasetFold.trainingLimit;
+                accuracyConfig.testingData.stm->offset = datasetFold.trainingOffset;
+                accuracyConfig.testingData.stm->orderBy = datasetFold.trainingOrderBy;
+            }
+
+            return accuracyConfig;
+        };
+
+    // The training and testing procedures are created once and shared by
+    // all folds; each fold passes its own configuration when running them.
+    {
+        PolyConfig clsProcPC;
+        clsProcPC.id = runProcConf.experimentName + "_trainer";
+        clsProcPC.type = "classifier.train";
+        clsProcPC.params = jsonEncode(makeClassifierConfig(0));
+
+        cerr << " >>>>> Creating training procedure" << endl;
+        clsProcedure = createProcedure(server, clsProcPC, makeOnProgress(0), true);
+        resourcesToDelete.push_back("/v1/procedures/"+clsProcPC.id.utf8String());
+
+        PolyConfig accuracyProcPC;
+        accuracyProcPC.id = runProcConf.experimentName + "_scorer";
+        accuracyProcPC.type = "classifier.test";
+        accuracyProcPC.params = makeAccuracyConfig(0, true, false /* prepareOutputDataset */);
+
+        cerr << " >>>>> Creating testing procedure" << endl;
+        accuracyProc = createProcedure(server, accuracyProcPC, makeOnProgress(0), true);
+        resourcesToDelete.push_back("/v1/procedures/"+accuracyProcPC.id.utf8String());
+    }
+
+    if(!clsProcedure) {
+        throw ML::Exception("Was unable to create classifier.train procedure");
+    }
+    if(!accuracyProc) {
+        throw ML::Exception("Was unable to create accuracy procedure");
+    }
+
+    // setup score expression
+    string scoreExpr;
+    if     (runProcConf.mode == CM_BOOLEAN ||
+            runProcConf.mode == CM_REGRESSION)  scoreExpr = "\"%s\"({%s})[score] as score";
+    else if(runProcConf.mode == CM_CATEGORICAL) scoreExpr = "\"%s\"({%s})[scores] as score";
+    else throw ML::Exception("Classifier mode %d not implemented", runProcConf.mode);
+
+    auto runFold = [&] (size_t foldNumber)
+        {
+        auto & datasetFold = runProcConf.datasetFolds[foldNumber];
+        auto onProgressFold = makeOnProgress(foldNumber);
+
         /***
          * TRAIN
          * **/
-        ClassifierConfig clsProcConf;
-        clsProcConf.trainingData = runProcConf.inputData;
-        clsProcConf.trainingData.stm->where = datasetFold.trainingWhere;
-        clsProcConf.trainingData.stm->limit = datasetFold.trainingLimit;
-        clsProcConf.trainingData.stm->offset = datasetFold.trainingOffset;
-        clsProcConf.trainingData.stm->orderBy = datasetFold.trainingOrderBy;
-
-        string baseUrl = runProcConf.modelFileUrlPattern.toString();
-        ML::replace_all(baseUrl, "$runid",
-                        ML::format("%s-%d", runProcConf.experimentName, (int)progress));
-        clsProcConf.modelFileUrl = Url(baseUrl);
-        clsProcConf.configuration = runProcConf.configuration;
-        clsProcConf.configurationFile = runProcConf.configurationFile;
-        clsProcConf.algorithm = runProcConf.algorithm;
-        clsProcConf.equalizationFactor = runProcConf.equalizationFactor;
-        clsProcConf.mode = runProcConf.mode;
-
-
-        clsProcConf.functionName = ML::format("%s_scorer_%d", runProcConf.experimentName, (int)progress);
-
-        if(progress == 0) {
-            PolyConfig clsProcPC;
-            clsProcPC.id = runProcConf.experimentName + "_trainer";
-            clsProcPC.type = "classifier.train";
-            clsProcPC.params = jsonEncode(clsProcConf);
-
-            cerr << " >>>>> Creating training procedure" << endl;
-            clsProcedure = createProcedure(server, clsProcPC, onProgress2, true);
-            resourcesToDelete.push_back("/v1/procedures/"+clsProcPC.id.utf8String());
-        }
-
-        if(!clsProcedure) {
-            throw ML::Exception("Was unable to create classifier.train procedure");
-        }
+        auto clsProcConf = makeClassifierConfig(foldNumber);
 
         // create run configuration
         ProcedureRunConfig clsProcRunConf;
-        clsProcRunConf.id = "run_"+to_string(progress);
+        clsProcRunConf.id = "run_"+to_string(foldNumber);
         clsProcRunConf.params = jsonEncode(clsProcConf);
         Date trainStart = Date::now();
-        RunOutput output = clsProcedure->run(clsProcRunConf, onProgress2);
+        RunOutput output = clsProcedure->run(clsProcRunConf, onProgressFold);
         Date trainFinish = Date::now();
 
 
@@ -415,33 +521,14 @@ run(const ProcedureRunConfig & run,
          * scoring function
          * created during the training so only add it to the cleanup list
          * **/
-
-        resourcesToDelete.push_back("/v1/functions/" + clsProcConf.functionName.utf8String());
+        {
+            std::unique_lock<std::mutex> guard(resultsLock);
+            resourcesToDelete.push_back("/v1/functions/" + clsProcConf.functionName.utf8String());
+        }
 
         /***
          * accuracy
          * **/
-        auto createAccuracyProcedure = [&] (AccuracyConfig & accuracyConf)
-        {
-            PolyConfig accuracyProcPC;
-            accuracyProcPC.id = runProcConf.experimentName + "_scorer";
-            accuracyProcPC.type = "classifier.test";
-            accuracyProcPC.params = accuracyConf;
-
-            cerr << " >>>>> Creating testing procedure" << endl;
-            accuracyProc = createProcedure(server, accuracyProcPC, onProgress2, true);
-
-            resourcesToDelete.push_back("/v1/procedures/"+accuracyProcPC.id.utf8String());
-        };
-
-
-        // setup score expression
-        string scoreExpr;
-        if     (runProcConf.mode == CM_BOOLEAN ||
-                runProcConf.mode == CM_REGRESSION)  scoreExpr = "\"%s\"({%s})[score] as score";
-        else if(runProcConf.mode == CM_CATEGORICAL) scoreExpr = "\"%s\"({%s})[scores] as score";
-        else throw ML::Exception("Classifier mode %d not implemented", runProcConf.mode);
-
 
         // this lambda actually runs the accuracy procedure for the given config
         auto runAccuracyFor = [&] (AccuracyConfig & accuracyConf)
@@ -460,14 +547,11 @@ run(const ProcedureRunConfig & run,
 
             ML::Timer timer;
 
-            if(!accuracyProc)
-                throw ML::Exception("Was unable to create accuracy procedure");
-
             ProcedureRunConfig accuracyProcRunConf;
-            accuracyProcRunConf.id = "run_"+to_string(progress);
+            accuracyProcRunConf.id = "run_"+to_string(foldNumber);
             accuracyProcRunConf.params = jsonEncode(accuracyConf);
             Date testStart = Date::now();
-            RunOutput accuracyOutput = accuracyProc->run(accuracyProcRunConf, onProgress2);
+            RunOutput accuracyOutput = accuracyProc->run(accuracyProcRunConf, onProgressFold);
             Date testFinish = Date::now();
 
             cerr << "accuracy took " << timer.elapsed() << endl;
@@ -476,59 +560,7 @@ run(const ProcedureRunConfig & run,
                               testFinish.secondsSinceEpoch() - testStart.secondsSinceEpoch());
         };
 
-
-        auto getAccuracyConfig = [&] (bool onTestSet)
-            {
-                // create config for the accuracy procedure
-                AccuracyConfig accuracyConfig;
-                accuracyConfig.mode = runProcConf.mode;
-                accuracyConfig.uniqueScoresOnly = runProcConf.uniqueScoresOnly;
-
-                if(runProcConf.outputAccuracyDataset && onTestSet) {
-                    PolyConfigT<Dataset> outputPC;
-                    outputPC.id = ML::format("%s_results_%d", runProcConf.experimentName, 
-                                                              (int)progress);
-                    outputPC.type = "tabular";
-
-                    {
-                        InProcessRestConnection connection;
-                        RestRequest request("DELETE", "/v1/datasets/"+outputPC.id.utf8String(),
-                                            RestParams(), "{}");
-                        server->handleRequest(connection, request);
-
-                        if(connection.responseCode != 204) {
-                            throw ML::Exception("HTTP error "+std::to_string(connection.responseCode)+
-                                " when trying to DELETE dataset '"+outputPC.id.utf8String()+"'");
-                        }
-                    }
-                    accuracyConfig.outputDataset.emplace(outputPC);
-                }
-
-                if(onTestSet) {
-                    accuracyConfig.testingData =
-                        runProcConf.testingDataOverride ? *runProcConf.testingDataOverride
-                                                        : runProcConf.inputData;
-                    accuracyConfig.testingData.stm->where = datasetFold.testingWhere;
-                    accuracyConfig.testingData.stm->limit = datasetFold.testingLimit;
-                    accuracyConfig.testingData.stm->offset = datasetFold.testingOffset;
-                    accuracyConfig.testingData.stm->orderBy = datasetFold.testingOrderBy;
-                }
-                else {
-                    accuracyConfig.testingData = runProcConf.inputData;
-                    accuracyConfig.testingData.stm->where = datasetFold.trainingWhere;
-                    accuracyConfig.testingData.stm->limit = datasetFold.trainingLimit;
-                    accuracyConfig.testingData.stm->offset = datasetFold.trainingOffset;
-                    accuracyConfig.testingData.stm->orderBy = datasetFold.trainingOrderBy;
-                }
-
-                return accuracyConfig;
-            };
-
-        auto accuracyConfig = getAccuracyConfig(true);
-
-        // create empty testing procedure
-        if(progress == 0)
-            createAccuracyProcedure(accuracyConfig);
+        auto accuracyConfig = makeAccuracyConfig(foldNumber, true, true);
 
         // run evaluation on testing
         auto accuracyOutput = runAccuracyFor(accuracyConfig);
@@ -536,8 +568,7 @@ run(const ProcedureRunConfig & run,
         // run evaluation on training
         std::tuple<RunOutput, double> accuracyOutputTrain;
         if(runProcConf.evalTrain) {
-            auto accuracyTrainingConf = getAccuracyConfig(false);
-            createAccuracyProcedure(accuracyTrainingConf);
+            auto accuracyTrainingConf = makeAccuracyConfig(foldNumber, false, false);
             accuracyOutputTrain = runAccuracyFor(accuracyTrainingConf);
         }
 
@@ -545,7 +576,6 @@ run(const ProcedureRunConfig & run,
         duration["train"] = trainFinish.secondsSinceEpoch() - trainStart.secondsSinceEpoch();
         duration["test"] = get<1>(accuracyOutput) + (runProcConf.evalTrain ? get<1>(accuracyOutputTrain)
                                                                            : 0);
-        durationStatsGen.accumStats(duration, "");
 
         // Add results
         Json::Value foldRez;
@@ -557,18 +587,38 @@ run(const ProcedureRunConfig & run,
 
         foldRez["resultsTest"] = jsonEncode(get<0>(accuracyOutput).results);
         foldRez["durationSecs"] = duration;
-        statsGen.accumStats(foldRez["resultsTest"], "");
 
         if(runProcConf.evalTrain) {
             foldRez["resultsTrain"] = jsonEncode(get<0>(accuracyOutputTrain).results);
-            statsGenTrain.accumStats(foldRez["resultsTrain"], "");
         }
 
-        test_eval_results.append(foldRez);
+        // Aggregate the fold's results as soon as they are available,
+        // rather than holding on to all the raw outputs until the end
+        {
+            std::unique_lock<std::mutex> guard(resultsLock);
+            durationStatsGen.accumStats(duration, "");
+            statsGen.accumStats(foldRez["resultsTest"], "");
+            if(runProcConf.evalTrain)
+                statsGenTrain.accumStats(foldRez["resultsTrain"], "");
+            foldResults[foldNumber] = std::move(foldRez);
+        }
+        };
 
-        progress ++;
+    if(runProcConf.parallelism == 1 || numFolds == 1) {
+        for(size_t i = 0;  i < numFolds;  i++)
+            runFold(i);
+    }
+    else {
+        // Folds also parallelize their own training and testing over the
+        // same thread pool; only the number of folds executing at once
+        // is capped here
+        parallelMap(0, numFolds, runFold, runProcConf.parallelism);
     }
 
+    Json::Value test_eval_results(Json::ValueType::arrayValue);
+    for(auto & foldRez : foldResults)
+        test_eval_results.append(foldRez);
+
     /***
      * cleanups
      * **/
@@ -72,7 +72,8 @@ struct ExperimentProcedureConfig : public ProcedureConfig {
           mode(CM_BOOLEAN),
           outputAccuracyDataset(true),
           uniqueScoresOnly(false),
-          evalTrain(false)
+          evalTrain(false),
+          parallelism(1)
     {
     }
 
@@ -111,6 +112,9 @@ struct ExperimentProcedureConfig : public ProcedureConfig {
     bool outputAccuracyDataset;
     bool uniqueScoresOnly;
     bool evalTrain;
+
+    /// How many folds to run concurrently
+    int parallelism;
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(ExperimentProcedureConfig);
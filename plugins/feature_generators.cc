@@ -66,11 +66,15 @@ HashedColumnFeatureGenerator(MldbServer * owner,
 {
     functionConfig = config.params.convert<HashedColumnFeatureGeneratorConfig>();
 
+    auto names = std::make_shared<std::vector<ColumnName> >();
+    names->reserve(numBuckets());
     for(int i=0; i<numBuckets(); i++) {
         outputColumns.emplace_back(ColumnName(ML::format("hashColumn%d", i)),
                                    std::make_shared<Float32ValueInfo>(),
                                    COLUMN_IS_DENSE);
+        names->emplace_back(outputColumns.back().columnName);
     }
+    bucketNames = std::move(names);
 }
 
 HashedColumnFeatureGenerator::
@@ -82,47 +86,48 @@ FeatureGeneratorOutput
 HashedColumnFeatureGenerator::
 call(FeatureGeneratorInput input) const
 {
-    ML::distribution<float> result(numBuckets());
-
-    ML::Lightweight_Hash_Set<uint64_t> doneHashes;
+    // Reused across calls so that scoring a stream of rows doesn't
+    // allocate per row.  The name hashes themselves are cached per
+    // thread inside PathElement::hash().
+    static thread_local std::vector<uint64_t> hashes;
+    static thread_local ML::Lightweight_Hash_Set<uint64_t> doneHashes;
+    hashes.clear();
+    doneHashes.clear();
 
     Date ts = Date::negativeInfinity();
-    // copied from the LAL repo
 
+    // First pass: gather the deduplicated name hashes, so that the
+    // bucket accumulation below runs over a flat array instead of
+    // being interleaved with walking the row.
     auto onColumn = [&] (const PathElement & columnName,
                          const ExpressionValue & val)
     {
         ts.setMax(val.getEffectiveTimestamp());
-        
-        uint64_t hash = columnName.hash();
-        if (!doneHashes.insert(hash).second)
-            return true;
-
-        // cerr << "got " << hash << endl;
 
-        int bit = 0;
-        for (int i = 0;  bit <= 63;  ++i, bit += functionConfig.numBits) {
-            int bucket = (hash >> bit) & ((1ULL << functionConfig.numBits) - 1);
-            ExcAssert(bucket >= 0 && bucket <= numBuckets());
-            int val = (i % 2 ? -1 : 1);
-            // cerr << "bit = " << bit << " bucket = " << bucket
-            //     << " val = " << val << endl;
-            result[bucket] += val;
-        }
+        uint64_t hash = columnName.hash();
+        if (doneHashes.insert(hash).second)
+            hashes.push_back(hash);
 
         return true;
     };
 
     input.columns.forEachColumn(onColumn);
 
-    ExpressionValue foResult;
-    RowValue rowVal;
-    for(int i=0; i<result.size(); i++) {
-        rowVal.push_back(make_tuple(ColumnName(ML::format("hashColumn%d", i)),
-                                    CellValue(result[i]), ts));
+    std::vector<double> result(numBuckets());
+
+    const int numBits = functionConfig.numBits;
+    const uint64_t mask = (1ULL << numBits) - 1;
+
+    for (uint64_t hash: hashes) {
+        int bit = 0;
+        for (int i = 0;  bit <= 63;  ++i, bit += numBits) {
+            result[(hash >> bit) & mask] += (i % 2 ? -1 : 1);
+        }
     }
-    
-    return {ExpressionValue(rowVal)};
+
+    // Dense output sharing the precomputed bucket names; only the
+    // values are copied.
+    return {ExpressionValue(result, bucketNames, ts)};
 }
 
 namespace {
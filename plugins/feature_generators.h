@@ -57,6 +57,10 @@ struct HashedColumnFeatureGenerator: public ValueFunctionT<FeatureGeneratorInput
 
     std::vector<KnownColumn> outputColumns;
 
+    /// Bucket column names, precomputed once and shared with every
+    /// output row rather than re-formatted per call
+    std::shared_ptr<const std::vector<ColumnName> > bucketNames;
+
     HashedColumnFeatureGeneratorConfig functionConfig;
 
     int numBuckets() const
@@ -6,6 +6,7 @@
 
 */
 
+#include <algorithm>
 #include <atomic>
 #include <exception>
 #include <mutex>
@@ -14,8 +15,10 @@
 #include <chrono>
 #include <thread>
 #include <cstring>
+#include "mldb/arch/buffer_pool.h"
 #include "mldb/jml/utils/ring_buffer.h"
 #include "mldb/vfs/filter_streams.h"
+#include "mldb/vfs/zstd_blocked.h"
 #include "mldb/base/thread_pool.h"
 #include "mldb/base/exc_assert.h"
 #include "mldb/types/date.h"
@@ -239,6 +242,50 @@ forEachLineStr(const std::string & filename,
 /* FOR EACH LINE BLOCK                                                       */
 /*****************************************************************************/
 
+namespace {
+
+/** Tracks whether a scan position is inside a quoted CSV value, with
+    the same rules as parseFixedWidthCsvRow: a quote only opens a value
+    at the start of a field, a doubled quote inside a quoted value is a
+    literal quote, and a quote in the middle of an unquoted field is an
+    ordinary character.  A plain parity count gets the last case wrong:
+    one stray quote in an unquoted field would flip it for the rest of
+    the block and every following newline would look quoted.
+
+    Scan ranges must end just before a newline (or at the end of the
+    input), so that a quote as the last character of a range can only
+    be a closing quote, never half of a doubled one.
+*/
+struct CsvQuoteState {
+    bool inQuoted = false;       ///< inside a quoted value
+    bool atFieldStart = true;    ///< next character begins a field
+
+    void scan(const char * p, const char * end,
+              char quote, char separator)
+    {
+        for (; p != end;  ++p) {
+            const char c = *p;
+            if (inQuoted) {
+                if (c != quote)
+                    continue;    // includes embedded newlines
+                if (p + 1 != end && p[1] == quote)
+                    ++p;         // doubled quote: literal
+                else
+                    inQuoted = false;
+            }
+            else if (c == separator || c == '\n')
+                atFieldStart = true;
+            else {
+                if (c == quote && atFieldStart)
+                    inQuoted = true;
+                atFieldStart = false;
+            }
+        }
+    }
+};
+
+} // file scope
+
 void forEachLineBlock(std::istream & stream,
                       std::function<bool (const char * line,
                                           size_t lineLength,
@@ -247,7 +294,9 @@ void forEachLineBlock(std::istream & stream,
                       int64_t maxLines,
                       int maxParallelism,
                       std::function<bool (int64_t blockNumber, int64_t lineNumber)> startBlock,
-                      std::function<bool (int64_t blockNumber, int64_t lineNumber)> endBlock)
+                      std::function<bool (int64_t blockNumber, int64_t lineNumber)> endBlock,
+                      char blockQuoteChar,
+                      char blockSeparatorChar)
 {
     //static constexpr int64_t BLOCK_SIZE = 100000000;  // 100MB blocks
     static constexpr int64_t BLOCK_SIZE = 20000000;  // 20MB blocks
@@ -289,41 +338,99 @@ void forEachLineBlock(std::istream & stream,
             size_t myChunkNumber = 0;
             
             try {
-                //MLDB-1426
-                if (mapped && false) {
-                    const char * start = mapped + stream.tellg();
+                // Only use the mapping when the stream can tell us where
+                // we are within it (MLDB-1426: a stream that can't seek
+                // used to send us scanning from mapped - 1).
+                std::streamoff mappedOffset
+                    = mapped ? (std::streamoff)stream.tellg() : -1;
+
+                if (mapped && mappedOffset >= 0) {
+                    // Zero-copy path: scan the memory mapping in place and
+                    // hand the callbacks pointers into it, instead of
+                    // copying each block through a read buffer.  The
+                    // mapping outlives the stream, so the lines stay valid
+                    // until the block completes.
+                    const char * start = mapped + mappedOffset;
                     const char * current = start;
                     const char * end = mapped + mappedSize;
 
+                    // Quote state since the start of the block, when
+                    // splitting is quote-aware: a newline seen inside
+                    // a quoted value is part of the line rather than
+                    // the end of it
+                    CsvQuoteState quoteState;
+                    const char * counted = start;
+
+                    auto atLineBoundary = [&] (const char * nl)
+                        {
+                            if (!blockQuoteChar)
+                                return true;
+                            quoteState.scan(counted, nl, blockQuoteChar,
+                                            blockSeparatorChar);
+                            counted = nl;
+                            return !quoteState.inQuoted;
+                        };
+
                     while (current && current < end && (current - start) < BLOCK_SIZE
                            && (maxLines == -1 || doneLines < maxLines)) { //stop processing new line when we have enough)
                         current = (const char *)memchr(current, '\n', end - current);
                         if (current && current < end) {
                             ExcAssertEqual(*current, '\n');
-                            lineOffsets.push_back(current - start);
-                            ++doneLines;
+                            if (atLineBoundary(current)
+                                && lineOffsets.back() != current - start) {
+                                lineOffsets.push_back(current - start);
+                                ++doneLines;
+                            }
                             ++current;
                         }
                     }
-                
-                    if (current)
+
+                    // Never end the block in the middle of a quoted
+                    // value: if the size limit tripped inside one,
+                    // keep consuming until the line ends
+                    if (blockQuoteChar && current && current < end
+                        && quoteState.inQuoted) {
+                        while (current < end) {
+                            const char * next = (const char *)
+                                memchr(current, '\n', end - current);
+                            if (!next) {
+                                current = nullptr;
+                                break;
+                            }
+                            bool boundary = atLineBoundary(next);
+                            current = next + 1;
+                            if (boundary) {
+                                if (lineOffsets.back() != next - start) {
+                                    lineOffsets.push_back(next - start);
+                                    ++doneLines;
+                                }
+                                break;
+                            }
+                        }
+                    }
+
+                    if (current) {
                         stream.seekg(current - start, ios::cur);
+                        if (current == end)
+                            lastBlock = true;
+                    }
                     else {
-                        // Last line has no newline
+                        // Last line has no newline; consume up to the end
+                        // of the mapping so no other block is started
+                        stream.seekg(end - start, ios::cur);
                         lineOffsets.push_back(end - start);
                         ++doneLines;
+                        lastBlock = true;
                     }
-                    
+
                     myChunkNumber = chunkNumber++;
 
-                    if (current && current < end &&
+                    if (!lastBlock &&
                         (maxLines == -1 || doneLines < maxLines)) // don't schedule a new block if we have enough lines
                         {
                             // Ready for another chunk
                             tp.add(doBlock);
-                        } else if (current == end) {
-                        lastBlock = true;
-                    }
+                        }
 
                     blockOut = std::shared_ptr<const char>(start,
                                                            [] (const char *) {});
@@ -335,12 +442,23 @@ void forEachLineBlock(std::istream & stream,
                     // How much extra space to allocate for the last line?
                     static constexpr size_t EXTRA_SIZE = 10000;
 
-                    std::shared_ptr<char> block(new char[BLOCK_SIZE + EXTRA_SIZE],
-                                                [] (char * c) { delete[] c; });
+                    size_t blockCapacity = BLOCK_SIZE + EXTRA_SIZE;
+                    std::shared_ptr<char> block
+                        = get_pooled_buffer(blockCapacity);
                     blockOut = block;
 
                     // First line starts at offset 0
 
+                    // Quote state since the start of the block, when
+                    // splitting is quote-aware (see the mapped path)
+                    CsvQuoteState quoteState;
+                    size_t countedOffset = 0;
+
+                    // Where the newline scan resumes: just past the
+                    // last newline examined, so a newline skipped at
+                    // odd parity isn't counted twice
+                    size_t scanStart = 0;
+
                     while (stream && !stream.eof()
                            && (maxLines == -1 || doneLines < maxLines)  //stop processing new line when we have enough
                            && (byteOffset - startOffset < BLOCK_SIZE)) {
@@ -354,19 +472,31 @@ void forEachLineBlock(std::istream & stream,
                         offset += bytesRead;
 
                         // Scan for end of line characters
-                        const char * current = block.get() + lineOffsets.back();
+                        const char * current = block.get() + scanStart;
                         const char * end = block.get() + offset;
 
                         while (current && current < end) {
                             current = (const char *)memchr(current, '\n', end - current);
                             if (current && current < end) {
                                 ExcAssertEqual(*current, '\n');
-                                if (lineOffsets.back() != current - block.get()) {
+                                bool boundary = true;
+                                if (blockQuoteChar) {
+                                    quoteState.scan
+                                        ((const char *)block.get()
+                                             + countedOffset,
+                                         current, blockQuoteChar,
+                                         blockSeparatorChar);
+                                    countedOffset = current - block.get();
+                                    boundary = !quoteState.inQuoted;
+                                }
+                                if (boundary
+                                    && lineOffsets.back() != current - block.get()) {
                                     lineOffsets.push_back(current - block.get());
                                     //cerr << "got line at offset " << lineOffsets.back() << endl;
                                     ++doneLines;
                                 }
                                 ++current;
+                                scanStart = current - block.get();
                             }
                         }
 
@@ -386,18 +516,28 @@ void forEachLineBlock(std::istream & stream,
                     else {
                         // If we are not at the end of the stream
                         // get the last line, as we probably got just a partial
-                        // line in the last one
-                        std::string lastLine;
-                        getline(stream, lastLine);
-                
-                        size_t cnt = stream.gcount();
+                        // line in the last one.  With quote-aware
+                        // splitting this repeats until the quotes
+                        // balance, so the block never ends inside a
+                        // quoted value; the embedded newlines stay in
+                        // the buffer as part of the line.
+                        for (;;) {
+                            std::string lastLine;
+                            getline(stream, lastLine);
+
+                            size_t cnt = stream.gcount();
+
+                            if (cnt == 0)
+                                break;
 
-                        if (cnt != 0) {
                             // Check for overflow on the buffer size
-                            if (offset + lastLine.size() + 1 > BLOCK_SIZE + EXTRA_SIZE) {
+                            if (offset + lastLine.size() + 1 > blockCapacity) {
                                 // reallocate and copy
-                                std::shared_ptr<char> newBlock(new char[offset + lastLine.size() + 1],
-                                                               [] (char * c) { delete[] c; });
+                                blockCapacity
+                                    = std::max(blockCapacity * 2,
+                                               offset + lastLine.size() + 1);
+                                std::shared_ptr<char> newBlock
+                                    = get_pooled_buffer(blockCapacity);
                                 std::copy(block.get(), block.get() + offset,
                                           newBlock.get());
                                 block = newBlock;
@@ -406,11 +546,40 @@ void forEachLineBlock(std::istream & stream,
 
                             std::copy(lastLine.data(), lastLine.data() + lastLine.length(),
                                       block.get() + offset);
-                    
-                            lineOffsets.emplace_back(offset + lastLine.length());
-                            ++doneLines;
+
+                            bool boundary = true;
+                            if (blockQuoteChar) {
+                                // Materialize the newline so the bytes
+                                // between lines are well defined
+                                if (cnt == lastLine.size() + 1)
+                                    block.get()[offset + lastLine.size()]
+                                        = '\n';
+                                quoteState.scan
+                                    (block.get() + countedOffset,
+                                     block.get() + offset + lastLine.size(),
+                                     blockQuoteChar, blockSeparatorChar);
+                                countedOffset = offset + lastLine.size();
+                                boundary = !quoteState.inQuoted;
+                            }
+
+                            if (boundary) {
+                                lineOffsets.emplace_back(offset + lastLine.length());
+                                ++doneLines;
+                            }
                             offset += cnt;
-                        }                
+
+                            if (boundary)
+                                break;
+
+                            if (!stream || stream.eof()) {
+                                // Unclosed quote at the end of the
+                                // stream: hand the remainder to the
+                                // parser as one line so it can report it
+                                lineOffsets.emplace_back(offset);
+                                ++doneLines;
+                                break;
+                            }
+                        }
                     }
 
                     myChunkNumber = chunkNumber++;
@@ -476,4 +645,302 @@ void forEachLineBlock(std::istream & stream,
     }
 }
 
+
+/*****************************************************************************/
+/* FOR EACH LINE BLOCK (BLOCK-INDEXED COMPRESSED FILES)                      */
+/*****************************************************************************/
+
+namespace {
+
+/** State handed from each block's worker to the next one: the global
+    line count so far, how many already-consumed lines are still to be
+    skipped, and the partial line cut at the block boundary.
+
+    If the next block was decompressed before its predecessor finished,
+    its worker leaves its remaining work in continuation rather than
+    blocking a thread pool thread (which could deadlock the pool), and
+    whoever publishes the handoff schedules it.
+*/
+struct BlockHandoff {
+    std::mutex mutex;
+    bool ready = false;
+    int64_t lineNumber = 0;
+    int64_t toSkip = 0;
+    std::string leftover;
+    std::function<void ()> continuation;
+};
+
+}
+
+static void
+forEachLineBlockIndexed(const std::string & uri,
+                        int64_t skipLines,
+                        std::function<bool (const char * line,
+                                            size_t lineLength,
+                                            int64_t blockNumber,
+                                            int64_t lineNumber)> onLine,
+                        int64_t maxLines,
+                        int maxParallelism,
+                        std::function<bool (int64_t blockNumber, int64_t lineNumber)> startBlock,
+                        std::function<bool (int64_t blockNumber, int64_t lineNumber)> endBlock)
+{
+    // Room kept ahead of the decompressed data so that the partial line
+    // handed over from the previous block can normally be prepended
+    // without copying the whole block
+    static constexpr size_t LEFTOVER_RESERVE = 65536;
+
+    // Re-open the file at the compressed level
+    filter_istream raw(uri, { { "compression", "none" } });
+    ZstdBlockedSource source(raw);
+
+    ThreadPool tp(maxParallelism);
+
+    std::atomic<int> hasExc(false);
+    std::exception_ptr exc;
+    std::atomic<bool> stop(false);       // a callback asked us to stop
+    std::atomic<bool> gotMaxLines(false);   // no point reading any further
+    std::atomic<int> outstanding(0);
+
+    auto prev = std::make_shared<BlockHandoff>();
+    prev->ready = true;
+    prev->toSkip = skipLines;
+
+    for (int64_t blockNumber = 0;
+         !stop && !gotMaxLines && !hasExc.load(std::memory_order_relaxed);
+         ++blockNumber) {
+
+        auto compressed = std::make_shared<std::vector<char> >();
+        uint32_t uncompressedSize;
+        if (!source.nextBlock(*compressed, uncompressedSize))
+            break;
+        bool lastBlock = source.eof();
+
+        // Bound the number of blocks held in memory at once
+        while (outstanding >= maxParallelism + 2
+               && !stop && !hasExc.load(std::memory_order_relaxed))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++outstanding;
+
+        auto next = std::make_shared<BlockHandoff>();
+        auto myPrev = prev;
+        prev = next;
+
+        std::function<void ()> doBlock
+            = [&tp, &hasExc, &exc, &stop, &gotMaxLines, &outstanding,
+               onLine, startBlock, endBlock, maxLines,
+               compressed, uncompressedSize, lastBlock, blockNumber,
+               myPrev, next] ()
+            {
+                std::shared_ptr<char> block;
+
+                try {
+                    // Decompress in parallel with the other workers; the
+                    // handoff below only covers the (cheap) line scan
+                    block = get_pooled_buffer(LEFTOVER_RESERVE
+                                              + uncompressedSize);
+                    ZstdBlockedSource::decompressBlock
+                        (compressed->data(), compressed->size(),
+                         block.get() + LEFTOVER_RESERVE, uncompressedSize);
+                } JML_CATCH_ALL {
+                    if (hasExc.fetch_add(1) == 0)
+                        exc = std::current_exception();
+                }
+
+                auto processRest = [&tp, &hasExc, &exc, &stop, &gotMaxLines,
+                                    &outstanding,
+                                    onLine, startBlock, endBlock, maxLines,
+                                    uncompressedSize, lastBlock, blockNumber,
+                                    block, next]
+                    (int64_t firstLine, int64_t toSkip, std::string leftover)
+                    {
+                        bool published = false;
+                        auto publish = [&] (int64_t lineNumber, int64_t toSkip,
+                                            std::string leftover)
+                            {
+                                std::function<void ()> continuation;
+                                {
+                                    std::unique_lock<std::mutex> guard(next->mutex);
+                                    next->lineNumber = lineNumber;
+                                    next->toSkip = toSkip;
+                                    next->leftover = std::move(leftover);
+                                    next->ready = true;
+                                    continuation = std::move(next->continuation);
+                                }
+                                published = true;
+                                if (continuation)
+                                    tp.add(std::move(continuation));
+                            };
+
+                        try {
+                            if (stop || hasExc.load(std::memory_order_relaxed)) {
+                                publish(firstLine, toSkip, std::move(leftover));
+                                --outstanding;
+                                return;
+                            }
+
+                            const char * dataStart;
+                            size_t dataSize = leftover.size() + uncompressedSize;
+                            std::shared_ptr<char> data = block;
+
+                            if (leftover.empty())
+                                dataStart = data.get() + LEFTOVER_RESERVE;
+                            else if (leftover.size() <= LEFTOVER_RESERVE) {
+                                char * start = data.get() + LEFTOVER_RESERVE
+                                    - leftover.size();
+                                std::memcpy(start, leftover.data(),
+                                            leftover.size());
+                                dataStart = start;
+                            }
+                            else {
+                                // Very long line spanning several blocks;
+                                // reallocate and copy
+                                data = get_pooled_buffer(dataSize);
+                                std::memcpy(data.get(), leftover.data(),
+                                            leftover.size());
+                                std::memcpy(data.get() + leftover.size(),
+                                            block.get() + LEFTOVER_RESERVE,
+                                            uncompressedSize);
+                                dataStart = data.get();
+                            }
+
+                            // Scan for end of line characters
+                            vector<size_t> lineEnds;
+                            const char * current = dataStart;
+                            const char * end = dataStart + dataSize;
+                            while (current && current < end) {
+                                current = (const char *)
+                                    memchr(current, '\n', end - current);
+                                if (current) {
+                                    lineEnds.push_back(current - dataStart);
+                                    ++current;
+                                }
+                            }
+
+                            size_t tailStart
+                                = lineEnds.empty() ? 0 : lineEnds.back() + 1;
+                            std::string myLeftover(dataStart + tailStart, end);
+                            if (lastBlock && !myLeftover.empty()) {
+                                // Last line of the file has no newline
+                                lineEnds.push_back(dataSize);
+                                myLeftover.clear();
+                            }
+
+                            int64_t numLines = lineEnds.size();
+                            int64_t skippedHere
+                                = std::min<int64_t>(toSkip, numLines);
+                            int64_t emitHere = numLines - skippedHere;
+                            if (maxLines != -1)
+                                emitHere = std::max<int64_t>
+                                    (0, std::min<int64_t>(emitHere,
+                                                          maxLines - firstLine));
+
+                            publish(firstLine + numLines - skippedHere,
+                                    toSkip - skippedHere,
+                                    std::move(myLeftover));
+
+                            if (maxLines != -1
+                                && firstLine + numLines - skippedHere >= maxLines)
+                                gotMaxLines = true;  // don't read further blocks
+
+                            if (emitHere > 0) {
+                                int64_t lineNumber = firstLine;
+
+                                if (startBlock
+                                    && !startBlock(blockNumber, lineNumber))
+                                    stop = true;
+
+                                for (int64_t i = skippedHere;
+                                     !stop && i < skippedHere + emitHere;  ++i) {
+                                    if (hasExc.load(std::memory_order_relaxed))
+                                        break;
+                                    size_t start
+                                        = i == 0 ? 0 : lineEnds[i - 1] + 1;
+                                    size_t len = lineEnds[i] - start;
+                                    const char * line = dataStart + start;
+
+                                    // Skip \r for DOS line endings
+                                    if (len > 0 && line[len - 1] == '\r')
+                                        --len;
+
+                                    if (!onLine(line, len, blockNumber,
+                                                lineNumber++))
+                                        stop = true;
+                                }
+
+                                if (!stop && endBlock
+                                    && !endBlock(blockNumber, lineNumber))
+                                    stop = true;
+                            }
+                        } JML_CATCH_ALL {
+                            if (hasExc.fetch_add(1) == 0)
+                                exc = std::current_exception();
+                        }
+
+                        // Unblock any successor, whatever happened above
+                        if (!published)
+                            publish(firstLine, toSkip, std::string());
+
+                        --outstanding;
+                    };
+
+                // Hook into the predecessor: run straight away if its
+                // handoff arrived already, otherwise leave the rest of
+                // the work for whoever publishes it
+                bool runNow = false;
+                {
+                    std::unique_lock<std::mutex> guard(myPrev->mutex);
+                    if (myPrev->ready)
+                        runNow = true;
+                    else myPrev->continuation = [myPrev, processRest] ()
+                        {
+                            processRest(myPrev->lineNumber, myPrev->toSkip,
+                                        std::move(myPrev->leftover));
+                        };
+                }
+
+                if (runNow)
+                    processRest(myPrev->lineNumber, myPrev->toSkip,
+                                std::move(myPrev->leftover));
+            };
+
+        tp.add(std::move(doBlock));
+    }
+
+    tp.waitForAll();
+
+    // If there was an exception, rethrow it rather than returning
+    // cleanly
+    if (hasExc) {
+        std::rethrow_exception(exc);
+    }
+}
+
+void forEachLineBlock(std::istream & stream,
+                      const std::string & uri,
+                      int64_t skipLines,
+                      std::function<bool (const char * line,
+                                          size_t lineLength,
+                                          int64_t blockNumber,
+                                          int64_t lineNumber)> onLine,
+                      int64_t maxLines,
+                      int maxParallelism,
+                      std::function<bool (int64_t blockNumber, int64_t lineNumber)> startBlock,
+                      std::function<bool (int64_t blockNumber, int64_t lineNumber)> endBlock,
+                      char blockQuoteChar,
+                      char blockSeparatorChar)
+{
+    // Quote-aware splitting can't be guaranteed across pre-compressed
+    // block boundaries, so it always takes the stream path
+    if (isZstdBlocked(uri) && blockQuoteChar == 0) {
+        forEachLineBlockIndexed(uri, skipLines, std::move(onLine),
+                                maxLines, maxParallelism,
+                                std::move(startBlock), std::move(endBlock));
+        return;
+    }
+
+    forEachLineBlock(stream, std::move(onLine), maxLines, maxParallelism,
+                     std::move(startBlock), std::move(endBlock),
+                     blockQuoteChar, blockSeparatorChar);
+}
+
 } // namespace Datacratic
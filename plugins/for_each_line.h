@@ -101,6 +101,17 @@ forEachLineStr(const std::string & filename,
     the processing thread, at the beginning and end of the block
     respectively.
 
+    When blockQuoteChar is non-zero, lines only end at newlines that
+    fall outside a quoted CSV value: such newlines are treated as part
+    of the line, which is then delivered whole with the newline
+    embedded, and blocks never split inside a quoted value.  Quotes are
+    tracked with the CSV parser's own rules (a quote only opens a value
+    at the start of a field, doubled quotes are literals, a quote in
+    the middle of an unquoted field is an ordinary character), using
+    blockSeparatorChar to find field starts.  Tracking the quotes costs
+    one extra scan per block on the splitting thread; parsing stays
+    parallel.
+
     This is the fastest way to parse a text file.
 */
 
@@ -114,7 +125,40 @@ void forEachLineBlock(std::istream & stream,
                       std::function<bool (int64_t blockNumber, int64_t lineNumber)> startBlock
                           = nullptr,
                       std::function<bool (int64_t blockNumber, int64_t lineNumber)> endBlock
-                          = nullptr);
+                          = nullptr,
+                      char blockQuoteChar = 0,
+                      char blockSeparatorChar = ',');
+
+
+/** Same, but with knowledge of the uri the stream was opened from.
+
+    When the uri names a block-indexed compressed file (see
+    mldb/vfs/zstd_blocked.h), the file is re-read at the compressed level
+    and each compressed block is decompressed and parsed on a separate
+    worker thread, instead of the single-threaded decompression the
+    stream version is limited to.  Any other uri is processed exactly as
+    by the stream version above.
+
+    skipLines gives the number of lines already consumed from the stream
+    (for example a header line); the parallel path re-reads the file from
+    the start and needs to skip them again.
+*/
+
+void forEachLineBlock(std::istream & stream,
+                      const std::string & uri,
+                      int64_t skipLines,
+                      std::function<bool (const char * line,
+                                          size_t lineLength,
+                                          int64_t blockNumber,
+                                          int64_t lineNumber)> onLine,
+                      int64_t maxLines = -1,
+                      int maxParallelism = 8,
+                      std::function<bool (int64_t blockNumber, int64_t lineNumber)> startBlock
+                          = nullptr,
+                      std::function<bool (int64_t blockNumber, int64_t lineNumber)> endBlock
+                          = nullptr,
+                      char blockQuoteChar = 0,
+                      char blockSeparatorChar = ',');
+
 
-    
 } // namespace Datacratic
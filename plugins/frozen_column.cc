@@ -7,17 +7,389 @@
 
 #include "frozen_column.h"
 #include "tabular_dataset_column.h"
+#include "tabular_persistence.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/types/value_description.h"
 #include "mldb/arch/bitops.h"
+#include "mldb/base/exc_assert.h"
 #include "mldb/arch/bit_range_ops.h"
 #include "mldb/jml/utils/compact_vector.h"
 #include "mldb/jml/utils/lightweight_hash.h"
 #include "mldb/http/http_exception.h"
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
 using namespace std;
 
 namespace Datacratic {
 namespace MLDB {
 
+
+/*****************************************************************************/
+/* FROZEN COLUMN                                                             */
+/*****************************************************************************/
+
+bool
+FrozenColumn::
+scanEquals(const CellValue & value,
+           const std::function<bool (uint32_t rowIndex)> & fn) const
+{
+    size_t sz = this->size();
+    for (size_t i = 0;  i < sz;  ++i) {
+        if (this->get(i) == value) {
+            if (!fn(i))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool
+FrozenColumn::
+scanIn(const std::vector<CellValue> & values,
+       const std::function<bool (uint32_t rowIndex)> & fn) const
+{
+    size_t sz = this->size();
+    for (size_t i = 0;  i < sz;  ++i) {
+        CellValue v = this->get(i);
+        for (auto & tst: values) {
+            if (v == tst) {
+                if (!fn(i))
+                    return false;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool
+FrozenColumn::
+scanSelected(const uint32_t * selected, size_t numSelected,
+             const std::function<bool (uint32_t rowIndex,
+                                       const CellValue & value)> & fn) const
+{
+    for (size_t i = 0;  i < numSelected;  ++i) {
+        if (!fn(selected[i], this->get(selected[i])))
+            return false;
+    }
+    return true;
+}
+
+/*****************************************************************************/
+/* COLUMN DISTINCT SKETCH                                                    */
+/*****************************************************************************/
+
+void
+ColumnDistinctSketch::
+addHash(uint64_t hash)
+{
+    if (registers.empty())
+        registers.resize(NUM_REGISTERS);
+
+    // Top ten bits choose the register; the rank is the position of the
+    // highest set bit among the remaining ones.
+    size_t bucket = hash >> 54;
+    uint64_t rest = hash << 10;
+    uint8_t rank = rest == 0 ? 55 : __builtin_clzll(rest) + 1;
+    registers[bucket] = std::max(registers[bucket], rank);
+}
+
+void
+ColumnDistinctSketch::
+merge(const ColumnDistinctSketch & other)
+{
+    if (other.registers.empty())
+        return;
+    if (registers.empty()) {
+        registers = other.registers;
+        return;
+    }
+    for (size_t i = 0;  i < NUM_REGISTERS;  ++i)
+        registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+uint64_t
+ColumnDistinctSketch::
+estimate() const
+{
+    if (registers.empty())
+        return 0;
+
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t r: registers) {
+        sum += std::ldexp(1.0, -r);
+        zeros += (r == 0);
+    }
+
+    constexpr double m = NUM_REGISTERS;
+    constexpr double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double e = alpha * m * m / sum;
+
+    // Small cardinalities: linear counting over the empty registers is
+    // more accurate than the raw harmonic mean estimate.
+    if (e <= 2.5 * m && zeros > 0)
+        e = m * std::log(m / zeros);
+
+    return (uint64_t)(e + 0.5);
+}
+
+
+/*****************************************************************************/
+/* COLUMN BLOOM FILTER                                                       */
+/*****************************************************************************/
+
+constexpr size_t ColumnBloomFilter::NUM_HASHES;
+constexpr size_t ColumnBloomFilter::BITS_PER_VALUE;
+
+void
+ColumnBloomFilter::
+init(size_t numDistinct)
+{
+    size_t numBits = std::max<size_t>(64, numDistinct * BITS_PER_VALUE);
+
+    // Round up to a power of two so probes can mask instead of dividing
+    size_t numWords = 1;
+    while (numWords * 64 < numBits)
+        numWords *= 2;
+
+    bits.assign(numWords, 0);
+}
+
+void
+ColumnBloomFilter::
+addHash(uint64_t hash)
+{
+    ExcAssert(!bits.empty());
+
+    // Double hashing: the two halves of the 64 bit hash generate the
+    // NUM_HASHES probe positions.
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    uint64_t mask = bits.size() * 64 - 1;
+    for (size_t i = 0;  i < NUM_HASHES;  ++i) {
+        uint64_t pos = (h1 + i * h2) & mask;
+        bits[pos >> 6] |= 1ULL << (pos & 63);
+    }
+}
+
+bool
+ColumnBloomFilter::
+couldContain(uint64_t hash) const
+{
+    if (bits.empty())
+        return true;
+
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    uint64_t mask = bits.size() * 64 - 1;
+    for (size_t i = 0;  i < NUM_HASHES;  ++i) {
+        uint64_t pos = (h1 + i * h2) & mask;
+        if (!(bits[pos >> 6] & (1ULL << (pos & 63))))
+            return false;
+    }
+    return true;
+}
+
+
+namespace {
+
+// Type tags for the on-disk format; see tabular_persistence.h
+static constexpr uint32_t FC_TABLE = 1;
+static constexpr uint32_t FC_SPARSE_TABLE = 2;
+static constexpr uint32_t FC_DICTIONARY_U8 = 3;
+static constexpr uint32_t FC_DICTIONARY_U16 = 4;
+static constexpr uint32_t FC_RUN_LENGTH = 5;
+
+void serializeColumnTypes(TabularFileWriter & writer,
+                          const ColumnTypes & types)
+{
+    writer.writeU64(types.numNulls);
+    writer.writeU64(types.numIntegers);
+    writer.writeU64((uint64_t)types.minNegativeInteger);
+    writer.writeU64(types.maxPositiveInteger);
+    writer.writeU64(types.numReals);
+    writer.writeU64(types.numStrings);
+    writer.writeU64(types.numBlobs);
+    writer.writeU64(types.numOther);
+}
+
+void serializeZoneMap(TabularFileWriter & writer,
+                      const ColumnZoneMap & zoneMap)
+{
+    writer.writeString(jsonEncodeStr(zoneMap.minValue));
+    writer.writeString(jsonEncodeStr(zoneMap.maxValue));
+    writer.writeU64(zoneMap.nullCount);
+    writer.writeU64(zoneMap.valueCount);
+    writer.writeString(std::string(zoneMap.distinctSketch.registers.begin(),
+                                   zoneMap.distinctSketch.registers.end()));
+    writer.writeString(std::string((const char *)zoneMap.bloomFilter.bits.data(),
+                                   zoneMap.bloomFilter.bits.size()
+                                       * sizeof(uint64_t)));
+}
+
+ColumnZoneMap reconstituteZoneMap(TabularFileReader & reader)
+{
+    ColumnZoneMap zoneMap;
+    zoneMap.minValue = jsonDecodeStr<CellValue>(reader.readString());
+    zoneMap.maxValue = jsonDecodeStr<CellValue>(reader.readString());
+    zoneMap.nullCount = reader.readU64();
+    zoneMap.valueCount = reader.readU64();
+    std::string registers = reader.readString();
+    zoneMap.distinctSketch.registers.assign(registers.begin(),
+                                            registers.end());
+    std::string filterBits = reader.readString();
+    if (filterBits.size() % sizeof(uint64_t) != 0)
+        throw HttpReturnException(400, "Corrupt bloom filter in zone map",
+                                  "numBytes", filterBits.size());
+    zoneMap.bloomFilter.bits.resize(filterBits.size() / sizeof(uint64_t));
+    std::memcpy(zoneMap.bloomFilter.bits.data(), filterBits.data(),
+                filterBits.size());
+    return zoneMap;
+}
+
+/// Columns with at least this many distinct values in the chunk get a
+/// bloom filter in their zone map.  Below it the value range already
+/// prunes well and a scan of the value table is cheap anyway; above it
+/// is where point lookups on identifier-like columns currently scan
+/// every chunk whose [min, max] happens to cover the probe value.
+static constexpr size_t BLOOM_MIN_DISTINCT = 256;
+
+/// Zone map of a column about to be frozen, from its distinct value
+/// table and row counts.
+ColumnZoneMap zoneMapOf(const TabularDatasetColumn & column)
+{
+    ColumnZoneMap zoneMap;
+    size_t numEntries = column.maxRowNumber - column.minRowNumber + 1;
+    zoneMap.nullCount = numEntries - column.sparseIndexes.size();
+    zoneMap.valueCount = column.sparseIndexes.size();
+    if (column.indexedVals.size() >= BLOOM_MIN_DISTINCT)
+        zoneMap.bloomFilter.init(column.indexedVals.size());
+    for (auto & v: column.indexedVals) {
+        if (v.empty())
+            continue;
+        if (zoneMap.minValue.empty() || v < zoneMap.minValue)
+            zoneMap.minValue = v;
+        if (zoneMap.maxValue.empty() || zoneMap.maxValue < v)
+            zoneMap.maxValue = v;
+        uint64_t hash = v.hash();
+        zoneMap.distinctSketch.addHash(hash);
+        if (!zoneMap.bloomFilter.empty())
+            zoneMap.bloomFilter.addHash(hash);
+    }
+    return zoneMap;
+}
+
+ColumnTypes reconstituteColumnTypes(TabularFileReader & reader)
+{
+    ColumnTypes types;
+    types.numNulls = reader.readU64();
+    types.numIntegers = reader.readU64();
+    types.minNegativeInteger = (int64_t)reader.readU64();
+    types.maxPositiveInteger = reader.readU64();
+    types.numReals = reader.readU64();
+    types.numStrings = reader.readU64();
+    types.numBlobs = reader.readU64();
+    types.numOther = reader.readU64();
+    return types;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* FROZEN VALUE TABLE                                                        */
+/*****************************************************************************/
+
+/** Immutable, shared table of a frozen column's distinct values.
+
+    Tables are interned in a process-wide registry keyed by their
+    contents: chunks, columns and whole dataset generations that index
+    the same distinct values (nightly re-imports of the same URLs or
+    campaign names, both sides of a switchover) all end up referencing
+    one copy of the dictionary instead of each holding their own, and
+    since codes are positions in the table, an identical re-import gets
+    identical codes.  Entries are held weakly, so a dictionary
+    disappears with its last column.
+*/
+struct FrozenValueTable {
+    FrozenValueTable() = default;
+
+    // Intern the given values, sharing any existing identical table
+    FrozenValueTable(std::vector<CellValue> newVals)
+        : vals(intern(std::move(newVals)))
+    {
+    }
+
+    const CellValue & operator [] (size_t i) const
+    {
+        return (*vals)[i];
+    }
+
+    size_t size() const
+    {
+        return vals ? vals->size() : 0;
+    }
+
+    std::vector<CellValue>::const_iterator begin() const
+    {
+        return vals->begin();
+    }
+
+    std::vector<CellValue>::const_iterator end() const
+    {
+        return vals->end();
+    }
+
+    const std::vector<CellValue> & values() const
+    {
+        return *vals;
+    }
+
+private:
+    static std::shared_ptr<const std::vector<CellValue> >
+    intern(std::vector<CellValue> newVals)
+    {
+        static std::mutex lock;
+        static std::unordered_multimap
+            <uint64_t, std::weak_ptr<const std::vector<CellValue> > > tables;
+
+        uint64_t h = 1;
+        for (auto & v: newVals)
+            h = h * 1000000007ULL + v.hash();
+
+        std::unique_lock<std::mutex> guard(lock);
+
+        auto range = tables.equal_range(h);
+        for (auto it = range.first;  it != range.second;  /* inc below */) {
+            auto existing = it->second.lock();
+            if (!existing) {
+                it = tables.erase(it);
+                continue;
+            }
+            if (*existing == newVals)
+                return existing;
+            ++it;
+        }
+
+        auto result = std::make_shared<const std::vector<CellValue> >
+            (std::move(newVals));
+        tables.emplace(h, result);
+        return result;
+    }
+
+    std::shared_ptr<const std::vector<CellValue> > vals;
+};
+
+
 /// Frozen column that finds each value in a lookup table
 struct TableFrozenColumn: public FrozenColumn {
     TableFrozenColumn(TabularDatasetColumn & column)
@@ -51,6 +423,34 @@ struct TableFrozenColumn: public FrozenColumn {
         }
     }
 
+    TableFrozenColumn(TabularFileReader & reader)
+    {
+        firstEntry = reader.readU64();
+        numEntries = reader.readU32();
+        indexBits = reader.readU32();
+        hasNulls = reader.readU32();
+        columnTypes = reconstituteColumnTypes(reader);
+        zoneMap = reconstituteZoneMap(reader);
+        table = jsonDecodeStr<std::vector<CellValue> >(reader.readString());
+        size_t numWords = (indexBits * (size_t)numEntries + 31) / 32;
+        storage = std::static_pointer_cast<const uint32_t>
+            (reader.mapAlignedBytes(numWords * sizeof(uint32_t)));
+    }
+
+    virtual void serialize(TabularFileWriter & writer) const
+    {
+        writer.writeU32(FC_TABLE);
+        writer.writeU64(firstEntry);
+        writer.writeU32(numEntries);
+        writer.writeU32(indexBits);
+        writer.writeU32(hasNulls);
+        serializeColumnTypes(writer, columnTypes);
+        serializeZoneMap(writer, zoneMap);
+        writer.writeString(jsonEncodeStr(table.values()));
+        size_t numWords = (indexBits * (size_t)numEntries + 31) / 32;
+        writer.writeAlignedBytes(storage.get(), numWords * sizeof(uint32_t));
+    }
+
     virtual CellValue get(uint32_t rowIndex) const
     {
         CellValue result;
@@ -109,9 +509,9 @@ struct TableFrozenColumn: public FrozenColumn {
     uint32_t indexBits;
     uint32_t numEntries;
     uint64_t firstEntry;
-    
+
     bool hasNulls;
-    std::vector<CellValue> table;
+    FrozenValueTable table;
     ColumnTypes columnTypes;
 
     virtual ColumnTypes getColumnTypes() const
@@ -138,12 +538,9 @@ struct TableFrozenColumn: public FrozenColumn {
 /// Sparse frozen column that finds each value in a lookup table
 struct SparseTableFrozenColumn: public FrozenColumn {
     SparseTableFrozenColumn(TabularDatasetColumn & column)
-        : table(column.indexedVals.size()), columnTypes(column.columnTypes)
+        : table(std::move(column.indexedVals)), columnTypes(column.columnTypes)
     {
         firstEntry = column.minRowNumber;
-        std::move(std::make_move_iterator(column.indexedVals.begin()),
-                  std::make_move_iterator(column.indexedVals.end()),
-                  table.begin());
         indexBits = ML::highest_bit(table.size()) + 1;
         rowNumBits = ML::highest_bit(column.maxRowNumber - column.minRowNumber) + 1;
         numEntries = column.sparseIndexes.size();
@@ -175,6 +572,64 @@ struct SparseTableFrozenColumn: public FrozenColumn {
 #endif
     }
 
+    SparseTableFrozenColumn(TabularFileReader & reader)
+    {
+        firstEntry = reader.readU64();
+        numEntries = reader.readU32();
+        indexBits = reader.readU32();
+        rowNumBits = reader.readU32();
+        columnTypes = reconstituteColumnTypes(reader);
+        zoneMap = reconstituteZoneMap(reader);
+        table = jsonDecodeStr<std::vector<CellValue> >(reader.readString());
+        size_t numWords
+            = ((indexBits + rowNumBits) * (size_t)numEntries + 31) / 32;
+        storage = std::static_pointer_cast<const uint32_t>
+            (reader.mapAlignedBytes(numWords * sizeof(uint32_t)));
+    }
+
+    virtual void serialize(TabularFileWriter & writer) const
+    {
+        writer.writeU32(FC_SPARSE_TABLE);
+        writer.writeU64(firstEntry);
+        writer.writeU32(numEntries);
+        writer.writeU32(indexBits);
+        writer.writeU32(rowNumBits);
+        serializeColumnTypes(writer, columnTypes);
+        serializeZoneMap(writer, zoneMap);
+        writer.writeString(jsonEncodeStr(table.values()));
+        size_t numWords
+            = ((indexBits + rowNumBits) * (size_t)numEntries + 31) / 32;
+        writer.writeAlignedBytes(storage.get(), numWords * sizeof(uint32_t));
+    }
+
+    /// Decode the packed (row number, value index) pair at entry n
+    std::pair<uint32_t, uint32_t> entryAt(uint32_t n) const
+    {
+        ML::Bit_Extractor<uint32_t> bits(storage.get());
+        bits.advance(n * (indexBits + rowNumBits));
+        uint32_t rowNum = bits.extract<uint32_t>(rowNumBits);
+        uint32_t index = bits.extract<uint32_t>(indexBits);
+        return std::make_pair(rowNum, index);
+    }
+
+    /** Walk the packed (row number, value index) entries linearly, in
+        row number order, decoding each exactly once.  Row numbers are
+        relative to firstEntry.  Stops (and returns false) if fn returns
+        false.
+    */
+    template<typename Fn>
+    bool forEachEntry(Fn && fn) const
+    {
+        ML::Bit_Extractor<uint32_t> bits(storage.get());
+        for (uint32_t i = 0;  i < numEntries;  ++i) {
+            uint32_t rowNum = bits.extract<uint32_t>(rowNumBits);
+            uint32_t index = bits.extract<uint32_t>(indexBits);
+            if (!fn(rowNum, index))
+                return false;
+        }
+        return true;
+    }
+
     virtual CellValue get(uint32_t rowIndex) const
     {
         CellValue result;
@@ -182,22 +637,13 @@ struct SparseTableFrozenColumn: public FrozenColumn {
             return result;
         rowIndex -= firstEntry;
 
-        auto getAtIndex = [&] (uint32_t n)
-            {
-                ML::Bit_Extractor<uint32_t> bits(storage.get());
-                bits.advance(n * (indexBits + rowNumBits));
-                uint32_t rowNum = bits.extract<uint32_t>(rowNumBits);
-                uint32_t index = bits.extract<uint32_t>(indexBits);
-                return std::make_pair(rowNum, index);
-            };
-
         uint32_t first = 0;
         uint32_t last  = numEntries;
 
         while (first != last) {
             uint32_t middle = (first + last) / 2;
             uint32_t rowNum, index;
-            std::tie(rowNum, index) = getAtIndex(middle);
+            std::tie(rowNum, index) = entryAt(middle);
 
             //cerr << "first = " << first << " middle = " << middle
             //     << " last = " << last << " rowNum = " << rowNum
@@ -250,7 +696,177 @@ struct SparseTableFrozenColumn: public FrozenColumn {
             if (!fn(v))
                 return false;
         }
-        
+
+        return true;
+    }
+
+    virtual bool
+    forEach(const std::function<bool (size_t rowIndex, CellValue val)> & fn)
+        const
+    {
+        // One linear decode per non-null entry, instead of one binary
+        // search per row.  Null rows (the gaps) are not visited.
+        return forEachEntry([&] (uint32_t rowNum, uint32_t index)
+            {
+                return fn(rowNum + firstEntry, table[index]);
+            });
+    }
+
+    virtual bool
+    scanEquals(const CellValue & value,
+               const std::function<bool (uint32_t rowIndex)> & fn) const
+    {
+        if (value.empty())
+            return FrozenColumn::scanEquals(value, fn);
+
+        // Find which table slot (if any) holds the value, then walk the
+        // packed entries linearly comparing slot numbers: the scan costs
+        // one decode per non-null entry rather than one binary search
+        // per row.
+        int tst = -1;
+        for (size_t i = 0;  i < table.size();  ++i) {
+            if (table[i] == value) {
+                tst = i;
+                break;
+            }
+        }
+        if (tst == -1)
+            return true;  // value doesn't occur; nothing to scan
+
+        return forEachEntry([&] (uint32_t rowNum, uint32_t index)
+            {
+                if (index != (uint32_t)tst)
+                    return true;
+                return fn(rowNum + firstEntry);
+            });
+    }
+
+    virtual bool
+    scanIn(const std::vector<CellValue> & values,
+           const std::function<bool (uint32_t rowIndex)> & fn) const
+    {
+        for (auto & v: values) {
+            if (v.empty())
+                return FrozenColumn::scanIn(values, fn);
+        }
+
+        // Membership bitmap over table slots, then one linear pass over
+        // the packed entries
+        std::vector<bool> member(table.size(), false);
+        size_t numFound = 0;
+        for (auto & v: values) {
+            for (size_t i = 0;  i < table.size();  ++i) {
+                if (table[i] == v && !member[i]) {
+                    member[i] = true;
+                    ++numFound;
+                }
+            }
+        }
+
+        if (numFound == 0)
+            return true;
+
+        return forEachEntry([&] (uint32_t rowNum, uint32_t index)
+            {
+                if (!member[index])
+                    return true;
+                return fn(rowNum + firstEntry);
+            });
+    }
+
+    virtual bool
+    scanSelected(const uint32_t * selected, size_t numSelected,
+                 const std::function<bool (uint32_t rowIndex,
+                                           const CellValue & value)> & fn)
+        const
+    {
+        // Galloping intersection of the selection against the packed
+        // entries.  Both sides are sorted by row number; entries are
+        // decoded a block at a time and each selected row is compared
+        // against a whole block at once, galloping (probes at doubling
+        // distances) over the entry array when the selection jumps far
+        // ahead, so the cost is proportional to the entries actually
+        // crossed rather than one binary search per selected row.
+        static constexpr uint32_t BLOCK = 16;
+        uint32_t blockRows[BLOCK];
+        uint32_t blockIndexes[BLOCK];
+        uint32_t blockStart = 0, blockSize = 0;
+
+        auto decodeBlock = [&] (uint32_t start)
+            {
+                blockStart = start;
+                blockSize = std::min<uint32_t>(BLOCK, numEntries - start);
+                ML::Bit_Extractor<uint32_t> bits(storage.get());
+                bits.advance(start * (indexBits + rowNumBits));
+                for (uint32_t i = 0;  i < blockSize;  ++i) {
+                    blockRows[i] = bits.extract<uint32_t>(rowNumBits);
+                    blockIndexes[i] = bits.extract<uint32_t>(indexBits);
+                }
+            };
+
+        if (numEntries > 0)
+            decodeBlock(0);
+
+        const CellValue nullValue;
+
+        for (size_t i = 0;  i < numSelected;  ++i) {
+            uint32_t row = selected[i];
+            if (row < firstEntry) {
+                if (!fn(row, nullValue))
+                    return false;
+                continue;
+            }
+            uint32_t rowNum = row - firstEntry;
+
+            // Gallop forward while the whole current block is behind the
+            // selection
+            while (blockSize > 0 && blockRows[blockSize - 1] < rowNum
+                   && blockStart + blockSize < numEntries) {
+                uint32_t next = blockStart + blockSize;
+                uint32_t step = BLOCK;
+                while (next + step < numEntries
+                       && entryAt(next + step).first < rowNum) {
+                    next += step;
+                    step *= 2;
+                }
+                decodeBlock(next);
+            }
+
+            if (blockSize == 0 || blockRows[blockSize - 1] < rowNum) {
+                // Selection is past the last entry
+                if (!fn(row, nullValue))
+                    return false;
+                continue;
+            }
+
+            // Look for the row number within the block
+            int found = -1;
+            uint32_t j = 0;
+#if defined(__SSE2__)
+            __m128i tst4 = _mm_set1_epi32(rowNum);
+            for (; j + 4 <= blockSize;  j += 4) {
+                __m128i block
+                    = _mm_loadu_si128((const __m128i *)(blockRows + j));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(block, tst4));
+                if (mask) {
+                    found = j + __builtin_ctz(mask) / 4;
+                    break;
+                }
+            }
+#endif // __SSE2__
+            if (found == -1) {
+                for (; j < blockSize;  ++j) {
+                    if (blockRows[j] == rowNum) {
+                        found = j;
+                        break;
+                    }
+                }
+            }
+
+            if (!fn(row, found == -1 ? nullValue : table[blockIndexes[found]]))
+                return false;
+        }
+
         return true;
     }
 
@@ -276,7 +892,7 @@ struct SparseTableFrozenColumn: public FrozenColumn {
     }
 
     std::shared_ptr<const uint32_t> storage;
-    ML::compact_vector<CellValue, 0> table;
+    FrozenValueTable table;
     uint8_t rowNumBits;
     uint8_t indexBits;
     uint32_t numEntries;
@@ -284,16 +900,677 @@ struct SparseTableFrozenColumn: public FrozenColumn {
     ColumnTypes columnTypes;
 };
 
+/// Dictionary coded frozen column for low cardinality string columns.
+/// Unlike TableFrozenColumn, which bit-packs its indexes, this one stores
+/// one fixed width (8 or 16 bit) code per row so that equality and IN
+/// predicates can be evaluated as straight compares over the code array,
+/// without materializing a CellValue per row.  Code 0 is reserved for
+/// null when the column has nulls.
+template<typename Code>
+struct DictionaryCodedFrozenColumn: public FrozenColumn {
+    DictionaryCodedFrozenColumn(TabularDatasetColumn & column)
+        : table(std::move(column.indexedVals)),
+          columnTypes(column.columnTypes)
+    {
+        firstEntry = column.minRowNumber;
+        numEntries = column.maxRowNumber - column.minRowNumber + 1;
+        hasNulls = column.sparseIndexes.size() < numEntries;
+
+        Code * data = new Code[numEntries];
+        storage = std::shared_ptr<Code>(data, [] (Code * p) { delete[] p; });
+
+        if (!hasNulls) {
+            for (size_t i = 0;  i < column.sparseIndexes.size();  ++i) {
+                ExcAssertEqual(column.sparseIndexes[i].first, i);
+                data[i] = column.sparseIndexes[i].second;
+            }
+        }
+        else {
+            std::fill(data, data + numEntries, 0);
+            for (auto & r_i: column.sparseIndexes)
+                data[r_i.first] = r_i.second + 1;
+        }
+    }
+
+    DictionaryCodedFrozenColumn(TabularFileReader & reader)
+    {
+        firstEntry = reader.readU64();
+        numEntries = reader.readU32();
+        hasNulls = reader.readU32();
+        columnTypes = reconstituteColumnTypes(reader);
+        zoneMap = reconstituteZoneMap(reader);
+        table = jsonDecodeStr<std::vector<CellValue> >(reader.readString());
+        storage = std::static_pointer_cast<const Code>
+            (reader.mapAlignedBytes(numEntries * sizeof(Code)));
+    }
+
+    virtual void serialize(TabularFileWriter & writer) const
+    {
+        writer.writeU32(sizeof(Code) == 1 ? FC_DICTIONARY_U8 : FC_DICTIONARY_U16);
+        writer.writeU64(firstEntry);
+        writer.writeU32(numEntries);
+        writer.writeU32(hasNulls);
+        serializeColumnTypes(writer, columnTypes);
+        serializeZoneMap(writer, zoneMap);
+        writer.writeString(jsonEncodeStr(table.values()));
+        writer.writeAlignedBytes(storage.get(), numEntries * sizeof(Code));
+    }
+
+    /// Code for the given value, or -1 if the value doesn't occur in the
+    /// column (including a null lookup on a column without nulls).
+    int codeForValue(const CellValue & value) const
+    {
+        if (value.empty())
+            return hasNulls ? 0 : -1;
+        for (size_t i = 0;  i < table.size();  ++i) {
+            if (table[i] == value)
+                return i + hasNulls;
+        }
+        return -1;
+    }
+
+    virtual CellValue get(uint32_t rowIndex) const
+    {
+        CellValue result;
+        if (rowIndex < firstEntry)
+            return result;
+        rowIndex -= firstEntry;
+        if (rowIndex >= numEntries)
+            return result;
+        Code code = storage.get()[rowIndex];
+        if (hasNulls) {
+            if (code == 0)
+                return result;
+            return result = table[code - 1];
+        }
+        return result = table[code];
+    }
+
+    virtual size_t size() const
+    {
+        return numEntries;
+    }
+
+    virtual size_t memusage() const
+    {
+        size_t result
+            = sizeof(*this)
+            + sizeof(Code) * numEntries;
+
+        for (auto & v: table)
+            result += v.memusage();
+
+        return result;
+    }
+
+    virtual bool
+    forEachDistinctValue(std::function<bool (const CellValue &)> fn) const
+    {
+        if (hasNulls) {
+            if (!fn(CellValue()))
+                return false;
+        }
+        for (auto & v: table) {
+            if (!fn(v))
+                return false;
+        }
+
+        return true;
+    }
+
+    /// Scan the code array for codes equal to tst, calling fn with the row
+    /// index of each match.  The inner loop is a compare over fixed width
+    /// integers, which the compiler vectorizes; on SSE2 we compare 16 bytes
+    /// at a time explicitly so that non-matching blocks cost one branch.
+    template<typename Fn>
+    bool scanForCode(Code tst, Fn && fn) const
+    {
+        const Code * codes = storage.get();
+        size_t i = 0;
+
+#if defined(__SSE2__)
+        if (sizeof(Code) == 1) {
+            __m128i tst16 = _mm_set1_epi8(tst);
+            for (; i + 16 <= numEntries;  i += 16) {
+                __m128i block
+                    = _mm_loadu_si128((const __m128i *)(codes + i));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, tst16));
+                while (mask) {
+                    int bit = __builtin_ctz(mask);
+                    if (!fn(i + bit))
+                        return false;
+                    mask &= mask - 1;
+                }
+            }
+        }
+        else if (sizeof(Code) == 2) {
+            __m128i tst8 = _mm_set1_epi16(tst);
+            for (; i + 8 <= numEntries;  i += 8) {
+                __m128i block
+                    = _mm_loadu_si128((const __m128i *)(codes + i));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(block, tst8));
+                while (mask) {
+                    int bit = __builtin_ctz(mask) / 2;
+                    if (!fn(i + bit))
+                        return false;
+                    mask &= ~(3 << (bit * 2));
+                }
+            }
+        }
+#endif // __SSE2__
+
+        for (; i < numEntries;  ++i) {
+            if (codes[i] == tst) {
+                if (!fn(i))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    virtual bool
+    scanEquals(const CellValue & value,
+               const std::function<bool (uint32_t rowIndex)> & fn) const
+    {
+        int code = codeForValue(value);
+        if (code == -1)
+            return true;  // value doesn't occur; nothing to scan
+        return scanForCode(code,
+                           [&] (size_t i) { return fn(i + firstEntry); });
+    }
+
+    virtual bool
+    scanIn(const std::vector<CellValue> & values,
+           const std::function<bool (uint32_t rowIndex)> & fn) const
+    {
+        // Translate the values into a membership bitmap over codes, then
+        // make a single pass over the code array testing the bitmap.
+        std::vector<bool> member(table.size() + hasNulls, false);
+        size_t numFound = 0;
+        for (auto & v: values) {
+            int code = codeForValue(v);
+            if (code != -1 && !member[code]) {
+                member[code] = true;
+                ++numFound;
+            }
+        }
+
+        if (numFound == 0)
+            return true;
+        if (numFound == 1) {
+            for (size_t code = 0;  code < member.size();  ++code) {
+                if (member[code])
+                    return scanForCode(code,
+                                       [&] (size_t i)
+                                       { return fn(i + firstEntry); });
+            }
+        }
+
+        const Code * codes = storage.get();
+        for (size_t i = 0;  i < numEntries;  ++i) {
+            if (member[codes[i]]) {
+                if (!fn(i + firstEntry))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    virtual ColumnTypes getColumnTypes() const
+    {
+        return columnTypes;
+    }
+
+    static size_t bytesRequired(const TabularDatasetColumn & column)
+    {
+        size_t numEntries = column.maxRowNumber - column.minRowNumber + 1;
+        size_t result
+            = sizeof(DictionaryCodedFrozenColumn)
+            + sizeof(Code) * numEntries;
+
+        for (auto & v: column.indexedVals)
+            result += v.memusage();
+
+        return result;
+    }
+
+    std::shared_ptr<const Code> storage;
+    uint32_t numEntries;
+    uint64_t firstEntry;
+
+    bool hasNulls;
+    FrozenValueTable table;
+    ColumnTypes columnTypes;
+};
+
+/// Run length encoded frozen column.  Columns ingested in sorted order
+/// (dates, campaign ids, ...) hold long runs of identical values; rather
+/// than one entry per row, this stores one (start row, value index) pair
+/// per run, bit-packed like SparseTableFrozenColumn's entries.  Random
+/// access is a binary search over run starts; iteration and scans walk
+/// the runs directly, decoding each run's value once.  Value indexes use
+/// the same scheme as TableFrozenColumn: when the column has nulls,
+/// index 0 means null and the table is offset by one.
+struct RunLengthFrozenColumn: public FrozenColumn {
+
+    /// Call onRun(startRow, index) for each run of identical values in
+    /// the column, in row order, including runs of nulls.
+    template<typename Fn>
+    static void forEachRun(const TabularDatasetColumn & column,
+                           bool hasNulls,
+                           Fn && onRun)
+    {
+        size_t numEntries = column.maxRowNumber - column.minRowNumber + 1;
+
+        int64_t curIndex = -1;
+        size_t runStart = 0;
+        size_t nextRow = 0;
+
+        auto addRows = [&] (size_t startRow, uint32_t index)
+            {
+                if ((int64_t)index != curIndex) {
+                    if (curIndex != -1)
+                        onRun(runStart, (uint32_t)curIndex);
+                    curIndex = index;
+                    runStart = startRow;
+                }
+            };
+
+        for (auto & r_i: column.sparseIndexes) {
+            if (r_i.first > nextRow)
+                addRows(nextRow, 0 /* null */);
+            addRows(r_i.first, r_i.second + hasNulls);
+            nextRow = r_i.first + 1;
+        }
+        if (nextRow < numEntries)
+            addRows(nextRow, 0 /* null */);
+        if (curIndex != -1)
+            onRun(runStart, (uint32_t)curIndex);
+    }
+
+    RunLengthFrozenColumn(TabularDatasetColumn & column)
+        : table(std::move(column.indexedVals)),
+          columnTypes(column.columnTypes)
+    {
+        firstEntry = column.minRowNumber;
+        numEntries = column.maxRowNumber - column.minRowNumber + 1;
+        hasNulls = column.sparseIndexes.size() < numEntries;
+        indexBits = ML::highest_bit(table.size() + hasNulls) + 1;
+        rowNumBits = ML::highest_bit(numEntries - 1) + 1;
+
+        size_t runs = 0;
+        forEachRun(column, hasNulls,
+                   [&] (size_t, uint32_t) { ++runs; });
+        numRuns = runs;
+
+        size_t numWords = ((rowNumBits + indexBits) * (size_t)numRuns + 31) / 32;
+        uint32_t * data = new uint32_t[numWords];
+        storage = std::shared_ptr<uint32_t>(data, [] (uint32_t * p) { delete[] p; });
+
+        ML::Bit_Writer<uint32_t> writer(data);
+        forEachRun(column, hasNulls,
+                   [&] (size_t startRow, uint32_t index)
+                   {
+                       writer.write(startRow, rowNumBits);
+                       writer.write(index, indexBits);
+                   });
+    }
+
+    RunLengthFrozenColumn(TabularFileReader & reader)
+    {
+        firstEntry = reader.readU64();
+        numEntries = reader.readU32();
+        numRuns = reader.readU32();
+        indexBits = reader.readU32();
+        rowNumBits = reader.readU32();
+        hasNulls = reader.readU32();
+        columnTypes = reconstituteColumnTypes(reader);
+        zoneMap = reconstituteZoneMap(reader);
+        table = jsonDecodeStr<std::vector<CellValue> >(reader.readString());
+        size_t numWords = ((rowNumBits + indexBits) * (size_t)numRuns + 31) / 32;
+        storage = std::static_pointer_cast<const uint32_t>
+            (reader.mapAlignedBytes(numWords * sizeof(uint32_t)));
+    }
+
+    virtual void serialize(TabularFileWriter & writer) const
+    {
+        writer.writeU32(FC_RUN_LENGTH);
+        writer.writeU64(firstEntry);
+        writer.writeU32(numEntries);
+        writer.writeU32(numRuns);
+        writer.writeU32(indexBits);
+        writer.writeU32(rowNumBits);
+        writer.writeU32(hasNulls);
+        serializeColumnTypes(writer, columnTypes);
+        serializeZoneMap(writer, zoneMap);
+        writer.writeString(jsonEncodeStr(table.values()));
+        size_t numWords = ((rowNumBits + indexBits) * (size_t)numRuns + 31) / 32;
+        writer.writeAlignedBytes(storage.get(), numWords * sizeof(uint32_t));
+    }
+
+    std::pair<uint32_t, uint32_t> runAtIndex(uint32_t n) const
+    {
+        ML::Bit_Extractor<uint32_t> bits(storage.get());
+        bits.advance(n * (rowNumBits + indexBits));
+        uint32_t startRow = bits.extract<uint32_t>(rowNumBits);
+        uint32_t index = bits.extract<uint32_t>(indexBits);
+        return std::make_pair(startRow, index);
+    }
+
+    CellValue valueForIndex(uint32_t index) const
+    {
+        CellValue result;
+        if (hasNulls) {
+            if (index == 0)
+                return result;
+            return result = table[index - 1];
+        }
+        return result = table[index];
+    }
+
+    virtual CellValue get(uint32_t rowIndex) const
+    {
+        CellValue result;
+        if (rowIndex < firstEntry)
+            return result;
+        rowIndex -= firstEntry;
+        if (rowIndex >= numEntries)
+            return result;
+
+        // Binary search for the last run starting at or before rowIndex.
+        // Run 0 always starts at row 0, so the search can't fail.
+        uint32_t first = 0;
+        uint32_t last = numRuns;
+        while (last - first > 1) {
+            uint32_t middle = (first + last) / 2;
+            if (runAtIndex(middle).first <= rowIndex)
+                first = middle;
+            else last = middle;
+        }
+
+        return valueForIndex(runAtIndex(first).second);
+    }
+
+    virtual size_t size() const
+    {
+        return numEntries;
+    }
+
+    virtual size_t memusage() const
+    {
+        size_t result
+            = sizeof(*this)
+            + ((rowNumBits + indexBits) * (size_t)numRuns + 31) / 8;
+
+        for (auto & v: table)
+            result += v.memusage();
+
+        return result;
+    }
+
+    virtual bool
+    forEachDistinctValue(std::function<bool (const CellValue &)> fn) const
+    {
+        if (hasNulls) {
+            if (!fn(CellValue()))
+                return false;
+        }
+        for (auto & v: table) {
+            if (!fn(v))
+                return false;
+        }
+
+        return true;
+    }
+
+    /** Walk the runs in row order, calling onRun(startRow, endRow, index)
+        for each, with endRow one past the run's last row.  Stops (and
+        returns false) if onRun returns false.
+    */
+    template<typename Fn>
+    bool scanRuns(Fn && onRun) const
+    {
+        ML::Bit_Extractor<uint32_t> bits(storage.get());
+
+        uint32_t prevStart = 0;
+        uint32_t prevIndex = 0;
+        bool havePrev = false;
+
+        for (uint32_t run = 0;  run < numRuns;  ++run) {
+            uint32_t startRow = bits.extract<uint32_t>(rowNumBits);
+            uint32_t index = bits.extract<uint32_t>(indexBits);
+            if (havePrev && !onRun(prevStart, startRow, prevIndex))
+                return false;
+            prevStart = startRow;
+            prevIndex = index;
+            havePrev = true;
+        }
+
+        if (havePrev && !onRun(prevStart, numEntries, prevIndex))
+            return false;
+
+        return true;
+    }
+
+    virtual bool
+    forEach(const std::function<bool (size_t rowIndex, CellValue val)> & fn)
+        const
+    {
+        // Match the base implementation: one call per index in
+        // [0, size()), with the value get() would return there
+        for (size_t i = 0;  i < firstEntry && i < numEntries;  ++i) {
+            if (!fn(i, CellValue()))
+                return false;
+        }
+
+        return scanRuns([&] (uint32_t startRow, uint32_t endRow,
+                             uint32_t index)
+            {
+                // Decode the run's value once, not once per row
+                CellValue val = valueForIndex(index);
+                for (size_t i = startRow;  i < endRow;  ++i) {
+                    size_t rowIndex = i + firstEntry;
+                    if (rowIndex >= numEntries)
+                        break;
+                    if (!fn(rowIndex, CellValue(val)))
+                        return false;
+                }
+                return true;
+            });
+    }
+
+    /// Index for the given value, or -1 if the value doesn't occur in
+    /// the column (including a null lookup on a column without nulls).
+    int indexForValue(const CellValue & value) const
+    {
+        if (value.empty())
+            return hasNulls ? 0 : -1;
+        for (size_t i = 0;  i < table.size();  ++i) {
+            if (table[i] == value)
+                return i + hasNulls;
+        }
+        return -1;
+    }
+
+    virtual bool
+    scanEquals(const CellValue & value,
+               const std::function<bool (uint32_t rowIndex)> & fn) const
+    {
+        int index = indexForValue(value);
+        if (index == -1)
+            return true;  // value doesn't occur; nothing to scan
+
+        // Runs of other values are skipped with one compare each
+        return scanRuns([&] (uint32_t startRow, uint32_t endRow,
+                             uint32_t runIndex)
+            {
+                if (runIndex != (uint32_t)index)
+                    return true;
+                for (uint32_t i = startRow;  i < endRow;  ++i) {
+                    if (!fn(i + firstEntry))
+                        return false;
+                }
+                return true;
+            });
+    }
+
+    virtual bool
+    scanIn(const std::vector<CellValue> & values,
+           const std::function<bool (uint32_t rowIndex)> & fn) const
+    {
+        std::vector<bool> member(table.size() + hasNulls, false);
+        size_t numFound = 0;
+        for (auto & v: values) {
+            int index = indexForValue(v);
+            if (index != -1 && !member[index]) {
+                member[index] = true;
+                ++numFound;
+            }
+        }
+
+        if (numFound == 0)
+            return true;
+
+        return scanRuns([&] (uint32_t startRow, uint32_t endRow,
+                             uint32_t runIndex)
+            {
+                if (!member[runIndex])
+                    return true;
+                for (uint32_t i = startRow;  i < endRow;  ++i) {
+                    if (!fn(i + firstEntry))
+                        return false;
+                }
+                return true;
+            });
+    }
+
+    virtual ColumnTypes getColumnTypes() const
+    {
+        return columnTypes;
+    }
+
+    static size_t bytesRequired(const TabularDatasetColumn & column)
+    {
+        size_t numEntries = column.maxRowNumber - column.minRowNumber + 1;
+        bool hasNulls = column.sparseIndexes.size() < numEntries;
+        int indexBits = ML::highest_bit(column.indexedVals.size() + hasNulls) + 1;
+        int rowNumBits = ML::highest_bit(numEntries - 1) + 1;
+
+        size_t numRuns = 0;
+        forEachRun(column, hasNulls,
+                   [&] (size_t, uint32_t) { ++numRuns; });
+
+        size_t result
+            = sizeof(RunLengthFrozenColumn)
+            + ((rowNumBits + indexBits) * numRuns + 31) / 8;
+
+        for (auto & v: column.indexedVals)
+            result += v.memusage();
+
+        return result;
+    }
+
+    std::shared_ptr<const uint32_t> storage;
+    uint8_t rowNumBits;
+    uint8_t indexBits;
+    uint32_t numRuns;
+    uint32_t numEntries;
+    uint64_t firstEntry;
+
+    bool hasNulls;
+    FrozenValueTable table;
+    ColumnTypes columnTypes;
+};
+
 std::shared_ptr<FrozenColumn>
 FrozenColumn::
 freeze(TabularDatasetColumn & column)
 {
+    // Record the zone map before the value table is moved out of the
+    // column by the representation's constructor.
+    ColumnZoneMap zoneMap = zoneMapOf(column);
+
+    auto finish = [&] (std::shared_ptr<FrozenColumn> result)
+        {
+            result->zoneMap = std::move(zoneMap);
+            return result;
+        };
+
     size_t required1 = TableFrozenColumn::bytesRequired(column);
     size_t required2 = SparseTableFrozenColumn::bytesRequired(column);
 
+    // Columns ingested in sorted order (dates, categories, ...) hold
+    // long runs of identical values and compress far better run length
+    // encoded.  Random access becomes a binary search over runs, so we
+    // only choose this representation when it wins by at least a factor
+    // of two, which implies the average run is long enough for run-aware
+    // scans to more than make up the difference.
+    size_t requiredRle = RunLengthFrozenColumn::bytesRequired(column);
+    if (requiredRle * 2 <= std::min(required1, required2))
+        return finish(std::make_shared<RunLengthFrozenColumn>(column));
+
+    // String-only columns with a low cardinality go to the dictionary
+    // coded representation so that equality and IN predicates scan over
+    // fixed width codes instead of materializing CellValues.  The fixed
+    // width codes cost a little more memory than the bit-packed table,
+    // so we only use them when they're within a factor of two.
+    const ColumnTypes & types = column.columnTypes;
+    bool stringOnly
+        = types.numStrings > 0
+        && types.numIntegers == 0
+        && types.numReals == 0
+        && types.numBlobs == 0
+        && types.numOther == 0;
+
+    if (stringOnly) {
+        size_t numEntries = column.maxRowNumber - column.minRowNumber + 1;
+        bool hasNulls = column.sparseIndexes.size() < numEntries;
+        size_t numCodes = column.indexedVals.size() + hasNulls;
+
+        if (numCodes <= 256) {
+            size_t required
+                = DictionaryCodedFrozenColumn<uint8_t>::bytesRequired(column);
+            if (required <= 2 * std::min(required1, required2))
+                return finish(std::make_shared
+                              <DictionaryCodedFrozenColumn<uint8_t> >(column));
+        }
+        else if (numCodes <= 65536) {
+            size_t required
+                = DictionaryCodedFrozenColumn<uint16_t>::bytesRequired(column);
+            if (required <= 2 * std::min(required1, required2))
+                return finish(std::make_shared
+                              <DictionaryCodedFrozenColumn<uint16_t> >(column));
+        }
+    }
+
     if (required1 <= required2)
-        return std::make_shared<TableFrozenColumn>(column);
-    else return std::make_shared<SparseTableFrozenColumn>(column);
+        return finish(std::make_shared<TableFrozenColumn>(column));
+    else return finish(std::make_shared<SparseTableFrozenColumn>(column));
+}
+
+std::shared_ptr<FrozenColumn>
+FrozenColumn::
+reconstitute(TabularFileReader & reader)
+{
+    uint32_t tag = reader.readU32();
+
+    switch (tag) {
+    case FC_TABLE:
+        return std::make_shared<TableFrozenColumn>(reader);
+    case FC_SPARSE_TABLE:
+        return std::make_shared<SparseTableFrozenColumn>(reader);
+    case FC_DICTIONARY_U8:
+        return std::make_shared<DictionaryCodedFrozenColumn<uint8_t> >(reader);
+    case FC_DICTIONARY_U16:
+        return std::make_shared<DictionaryCodedFrozenColumn<uint16_t> >(reader);
+    case FC_RUN_LENGTH:
+        return std::make_shared<RunLengthFrozenColumn>(reader);
+    default:
+        throw HttpReturnException(400, "Unknown frozen column type tag in "
+                                  "tabular dataset file",
+                                  "tag", tag);
+    }
 }
 
 } // namespace MLDB
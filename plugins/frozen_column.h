@@ -10,11 +10,145 @@
 
 #include "column_types.h"
 #include "mldb/sql/cell_value.h"
+#include <functional>
+#include <vector>
 
 namespace Datacratic {
 namespace MLDB {
 
 struct TabularDatasetColumn;
+struct TabularFileWriter;
+struct TabularFileReader;
+
+/*****************************************************************************/
+/* COLUMN DISTINCT SKETCH                                                    */
+/*****************************************************************************/
+
+/** HyperLogLog sketch of the set of distinct values in a column, recorded
+    at freeze time so that distinct count probes don't need to re-scan the
+    column.  Sketches from different chunks merge losslessly, so the
+    dataset-wide estimate is the merge of the per-chunk sketches.
+*/
+
+struct ColumnDistinctSketch {
+    /// 2^10 registers: one kilobyte per chunk column, standard error of
+    /// about 3.3% on the estimate
+    static constexpr size_t NUM_REGISTERS = 1024;
+
+    /// One register per bucket; empty until the first value is added
+    std::vector<uint8_t> registers;
+
+    bool empty() const
+    {
+        return registers.empty();
+    }
+
+    /// Add a value, identified by its 64 bit hash
+    void addHash(uint64_t hash);
+
+    /// Merge in the values added to another sketch
+    void merge(const ColumnDistinctSketch & other);
+
+    /// Estimate the number of distinct values added
+    uint64_t estimate() const;
+};
+
+
+/*****************************************************************************/
+/* COLUMN BLOOM FILTER                                                       */
+/*****************************************************************************/
+
+/** Bloom filter over the distinct values of a chunk column, recorded at
+    freeze time for high cardinality columns.  Point predicates probe it
+    to eliminate chunks whose value range spans the probe value but which
+    don't actually contain it, which is the common case for identifier
+    columns where every chunk's [min, max] covers nearly the whole key
+    space.
+*/
+
+struct ColumnBloomFilter {
+    /// Number of bit probes per value; with BITS_PER_VALUE bits per
+    /// distinct value this gives a false positive rate of about 1%
+    static constexpr size_t NUM_HASHES = 6;
+
+    /// Target bits per distinct value, before rounding the filter up to
+    /// a power of two words
+    static constexpr size_t BITS_PER_VALUE = 10;
+
+    /// Filter bits; empty if no filter was built for the column
+    std::vector<uint64_t> bits;
+
+    bool empty() const
+    {
+        return bits.empty();
+    }
+
+    /// Size the (empty) filter to hold the given number of distinct values
+    void init(size_t numDistinct);
+
+    /// Add a value, identified by its 64 bit hash
+    void addHash(uint64_t hash);
+
+    /** Could a value with the given hash have been added?  Always true
+        when no filter was built, so callers don't need to distinguish.
+    */
+    bool couldContain(uint64_t hash) const;
+};
+
+
+/*****************************************************************************/
+/* COLUMN ZONE MAP                                                           */
+/*****************************************************************************/
+
+/** Per-chunk statistics about a column, recorded at freeze time.  The
+    value range allows range predicates to eliminate a whole chunk without
+    touching its rows; the counts and the distinct sketch serve summary
+    statistics probes as pure metadata reads.
+*/
+
+struct ColumnZoneMap {
+    ColumnZoneMap()
+        : nullCount(0), valueCount(0)
+    {
+    }
+
+    CellValue minValue;   ///< Smallest non-null value; empty if all null
+    CellValue maxValue;   ///< Largest non-null value; empty if all null
+    uint64_t nullCount;   ///< Number of null (missing) values in the chunk
+    uint64_t valueCount;  ///< Number of rows with a non-null value
+
+    /// Sketch of the distinct non-null values in the chunk
+    ColumnDistinctSketch distinctSketch;
+
+    /// Bloom filter over the distinct non-null values; only built for
+    /// high cardinality columns (see zoneMapOf in frozen_column.cc)
+    ColumnBloomFilter bloomFilter;
+
+    /** Could any row in the chunk have a value within [lo, hi]?  An empty
+        lo or hi means unbounded on that side.  Returns false only when
+        the chunk provably contains no matching row.
+    */
+    bool couldContainRange(const CellValue & lo, const CellValue & hi) const
+    {
+        if (minValue.empty())
+            return false;  // column is entirely null in this chunk
+        if (!hi.empty() && hi < minValue)
+            return false;
+        if (!lo.empty() && maxValue < lo)
+            return false;
+        return true;
+    }
+
+    bool couldContainValue(const CellValue & val) const
+    {
+        if (!couldContainRange(val, val))
+            return false;
+        if (!val.empty() && !bloomFilter.couldContain(val.hash()))
+            return false;
+        return true;
+    }
+};
+
 
 /*****************************************************************************/
 /* FROZEN COLUMN                                                             */
@@ -32,6 +166,11 @@ struct FrozenColumn {
 
     virtual size_t memusage() const = 0;
 
+    /** Call fn once per value in the column's value table.  Values are
+        distinct except for columns that switched to direct storage
+        while being built (see TabularDatasetColumn), where a value may
+        rarely repeat; callers must tolerate a repeat.
+    */
     virtual bool
     forEachDistinctValue(std::function<bool (const CellValue &)> fn)
         const = 0;
@@ -41,22 +180,79 @@ struct FrozenColumn {
         return this->get(index);
     }
 
-    template<typename Fn>
-    bool forEach(Fn && fn) const
+    /** Call fn with (rowIndex, value) for each row in turn.  Stops (and
+        returns false) if fn returns false.  Representations that can
+        iterate faster than one get() per row (eg, run length encoded
+        columns, which decode each run's value once) override this.
+    */
+    virtual bool
+    forEach(const std::function<bool (size_t rowIndex, CellValue val)> & fn)
+        const
     {
         // TODO: sparse columns have nulls...
         size_t sz = this->size();
         for (size_t i = 0;  i < sz;  ++i) {
             if (!fn(i, std::move(this->get(i))))
                 return false;
-        } 
+        }
         return true;
     }
 
     virtual ColumnTypes getColumnTypes() const = 0;
 
+    /** Call fn with the index of each row whose value is exactly equal to
+        the given value, in ascending row order.  Stops (and returns false)
+        if fn returns false.
+
+        The default implementation materializes each cell via get() and
+        compares; representations that can compare without materializing
+        (eg, dictionary coded columns) override it with something much
+        faster.
+    */
+    virtual bool
+    scanEquals(const CellValue & value,
+               const std::function<bool (uint32_t rowIndex)> & fn) const;
+
+    /** Like scanEquals, but matches rows whose value is equal to any of
+        the given values (an IN predicate).
+    */
+    virtual bool
+    scanIn(const std::vector<CellValue> & values,
+           const std::function<bool (uint32_t rowIndex)> & fn) const;
+
+    /** Call fn with (rowIndex, value) for each row in the given selection,
+        in selection order.  The selection must be sorted ascending; the
+        value passed for a selected row with no value is null.  Stops (and
+        returns false) if fn returns false.
+
+        The default implementation materializes each selected cell via
+        get(); sparse columns override it with a galloping intersection of
+        the selection against their non-null entries, so a narrow
+        selection doesn't pay one binary search per row.
+    */
+    virtual bool
+    scanSelected(const uint32_t * selected, size_t numSelected,
+                 const std::function<bool (uint32_t rowIndex,
+                                           const CellValue & value)> & fn)
+        const;
+
     static std::shared_ptr<FrozenColumn>
     freeze(TabularDatasetColumn & column);
+
+    /** Serialize the column (metadata plus raw storage) to the given
+        writer, for the memory-mappable on-disk tabular format (see
+        tabular_persistence.h).
+    */
+    virtual void serialize(TabularFileWriter & writer) const = 0;
+
+    /** Reconstitute a column serialized with serialize(), pointing its
+        storage directly into the reader's file mapping.
+    */
+    static std::shared_ptr<FrozenColumn>
+    reconstitute(TabularFileReader & reader);
+
+    /// Zone map statistics, filled in by freeze() and reconstitute()
+    ColumnZoneMap zoneMap;
 };
 
 
@@ -10,17 +10,26 @@
 #include "mldb/jml/utils/csv.h"
 #include "mldb/jml/utils/lightweight_hash.h"
 #include "mldb/base/parallel.h"
+#include "mldb/base/fast_int_parsing.h"
+#include "mldb/base/fast_float_parsing.h"
 #include "mldb/plugins/for_each_line.h"
 #include "mldb/server/mldb_server.h"
 #include "mldb/server/per_thread_accumulator.h"
 #include "mldb/sql/sql_expression.h"
 #include "mldb/types/basic_value_descriptions.h"
+#include "mldb/types/map_description.h"
 #include "mldb/types/any_impl.h"
 #include "mldb/server/dataset_context.h"
 #include "mldb/vfs/filter_streams.h"
 #include "mldb/vfs/fs_utils.h"
 #include "mldb/plugins/progress.h"
 
+#include <cstring>
+#include <mutex>
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 
 using namespace std;
 
@@ -33,6 +42,15 @@ ImportTextConfigDescription::ImportTextConfigDescription()
 {
     addField("dataFileUrl", &ImportTextConfig::dataFileUrl,
              "URL of the text data to import");
+    addField("dataFileUrls", &ImportTextConfig::dataFileUrls,
+             "Further URLs of text data to import into the same dataset.  "
+             "An entry ending in `*` is expanded to every object whose URL "
+             "starts with the given prefix.  All files must have the same "
+             "column structure; they are downloaded and parsed "
+             "concurrently.  The `offset` and `limit` parameters apply to "
+             "each file individually.  When more than one file is imported "
+             "and `named` is left at its default, rows are named "
+             "`<dataFileUrl>:<lineNumber>` so that names stay unique.");
     addField("outputDataset", &ImportTextConfig::outputDataset,
              "Dataset to record the data into.",
              PolyConfigT<Dataset>().withType("tabular"));
@@ -80,6 +98,18 @@ ImportTextConfigDescription::ImportTextConfigDescription()
     addField("timestamp", &ImportTextConfig::timestamp,
              "Expression for row timestamp.",
              SqlExpression::parse("fileTimestamp()"));
+    addField("columnTypes", &ImportTextConfig::columnTypes,
+             "Object mapping column names to their declared type: `integer`, "
+             "`number` or `string`.  Values in a declared column are handed "
+             "straight to the corresponding parser instead of having their "
+             "type inferred, which speeds up the import and guarantees the "
+             "column is uniformly typed (in particular, a `string` column "
+             "will never have a value like `00123` read back as a number).  "
+             "A value that doesn't parse as the declared type is an error "
+             "for its line, subject to `ignoreBadLines`; empty cells stay "
+             "null as usual.  Columns not mentioned are inferred cell by "
+             "cell as if this parameter weren't set.",
+             std::map<Utf8String, std::string>());
     addField("allowMultiLines", &ImportTextConfig::allowMultiLines,
              "Allows columns with multi-line quoted strings. "
              "This option disables many optimizations and makes the procedure "
@@ -323,6 +353,29 @@ Encoding parseEncoding(const std::string & encodingStr)
     return encoding;
 }
 
+/// Declared type of an input column, from the columnTypes parameter
+enum ColumnTypeHint {
+    CT_AUTO,    ///< No declaration; infer the type cell by cell
+    CT_INT,     ///< Declared integer
+    CT_FLOAT,   ///< Declared floating point number
+    CT_STRING   ///< Declared string; never interpreted as a number
+};
+
+ColumnTypeHint parseColumnTypeHint(const Utf8String & columnName,
+                                   const std::string & typeStr)
+{
+    if (typeStr == "integer")
+        return CT_INT;
+    else if (typeStr == "number")
+        return CT_FLOAT;
+    else if (typeStr == "string")
+        return CT_STRING;
+    else throw HttpReturnException(400, "Unknown column type for import.text; "
+                                   "expected 'integer', 'number' or 'string'",
+                                   "columnName", columnName,
+                                   "columnType", typeStr);
+}
+
 const char * findInvalidAscii(const char * start, size_t length, char*buf, char replaceInvalidCharactersWith) {
 
     memcpy(buf, start, length);
@@ -343,6 +396,54 @@ const char * findInvalidAscii(const char * start, size_t length, char*buf, char
 namespace {
     const string unclosedQuoteError = "Unclosed quoted CSV value";
     const string notEnoughColsError = "not enough columns in row";
+    const string badIntError = "value in column declared 'integer' is not an integer";
+    const string badFloatError = "value in column declared 'number' is not a number";
+}
+
+/** Scan forward to the first occurrence of either of two special
+    characters, recording on the way whether any non-ASCII byte was seen
+    strictly before the returned position.  Returns end if neither
+    character occurs.
+
+    This is the inner loop of CSV field splitting; on SSE2 machines it
+    sweeps 16 bytes at a time with byte compares, with the scalar loop
+    kept as the tail and fallback.
+*/
+static const char *
+scanFieldForSpecialChar(const char * p, const char * end,
+                        char c1, char c2, bool & eightBit)
+{
+#if defined(__SSE2__)
+    __m128i special1 = _mm_set1_epi8(c1);
+    __m128i special2 = _mm_set1_epi8(c2);
+
+    while (end - p >= 16) {
+        __m128i block
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int special
+            = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, special1),
+                                             _mm_cmpeq_epi8(block, special2)));
+        int highBits = _mm_movemask_epi8(block);
+
+        if (special) {
+            int offset = __builtin_ctz(special);
+            eightBit = eightBit || (highBits & ((1 << offset) - 1));
+            return p + offset;
+        }
+
+        eightBit = eightBit || highBits;
+        p += 16;
+    }
+#endif // __SSE2__
+
+    for (; p < end;  ++p) {
+        if (*p == c1 || *p == c2)
+            return p;
+        if (!isascii(*p))
+            eightBit = true;
+    }
+
+    return end;
 }
 
 /** Parse a single row of CSV into an array of CellValues.
@@ -370,6 +471,10 @@ namespace {
     Otherwise, it's the ASCII code point to put in place of them.
     - isTextLine: optimization to ignore separator and quote chars and get a single column per line
     - hasQuoteChar: should we use the quote char
+    - columnTypes: if non-null, an array of numColumns declared column
+    types.  Fields in a declared column go straight to the matching
+    parser instead of through type inference; a field that doesn't parse
+    as its declared type is an error for the row.
 */
 
 const char *
@@ -382,7 +487,8 @@ parseFixedWidthCsvRow(const char * & line,
                       Encoding encoding,
                       int replaceInvalidCharactersWith,
                       bool isTextLine,
-                      bool hasQuoteChar)
+                      bool hasQuoteChar,
+                      const ColumnTypeHint * columnTypes)
 {
     ExcAssert(!(hasQuoteChar && isTextLine));
 
@@ -444,6 +550,47 @@ parseFixedWidthCsvRow(const char * & line,
             }
         };
 
+    // Finish a field of a column with a declared type.  Numeric columns
+    // parse directly with the fast parsers; string columns skip the
+    // numeric sniffing in CellValue::parse entirely.
+    auto finishTyped = [&] (const char * start, size_t len, bool eightBit,
+                            ColumnTypeHint hint) -> CellValue
+        {
+            switch (hint) {
+            case CT_INT: {
+                ML::Parse_Context pcontext("", start, start + len);
+                long long val;
+                if (ML::match_long_long(val, pcontext) && pcontext.eof())
+                    return CellValue((int64_t)val);
+                errorMsg = badIntError.c_str();
+                return CellValue();
+            }
+            case CT_FLOAT: {
+                ML::Parse_Context pcontext("", start, start + len);
+                double val;
+                if (ML::match_float(val, pcontext) && pcontext.eof())
+                    return CellValue(val);
+                errorMsg = badFloatError.c_str();
+                return CellValue();
+            }
+            case CT_STRING:
+                if (!eightBit) {
+                    char buf[len];
+                    if (replaceInvalidCharactersWith >= 0) {
+                        ExcAssert(replaceInvalidCharactersWith < 256);
+                        start = findInvalidAscii(start, len, buf,
+                                                 (char)replaceInvalidCharactersWith);
+                    }
+                    return CellValue(start, len, STRING_IS_VALID_ASCII);
+                }
+                // The eight bit case never infers a type anyway
+                return finishString(start, len, eightBit);
+            case CT_AUTO:
+            default:
+                return finishString(start, len, eightBit);
+            }
+        };
+
     while (colNum < numColumns) {
 
         ExcAssert(line <= lineEnd);
@@ -459,6 +606,9 @@ parseFixedWidthCsvRow(const char * & line,
 
         const char * start = line;
 
+        const ColumnTypeHint hint
+            = columnTypes ? columnTypes[colNum] : CT_AUTO;
+
         char c = *line++;
 
         if (c == separator && !isTextLine) {
@@ -494,32 +644,51 @@ parseFixedWidthCsvRow(const char * & line,
                     s[len++] = c;
                 };
 
-            for (; line < lineEnd;  ++line) {
-                c = *line;
-                //cerr << "c = " << c << endl;
-                if (c == quote) {
-                    ++line;
-                    if (line >= lineEnd) {
-                        ok = true;
-                        break;
-                    }
-                    else if (*line == separator) {
-                        ok = true;
-                        ++line;
-                        break;
-                    }
-                    else if (*line == quote) {
-                        // doubled quote; take a literal value
-                        pushChar(quote);
-                    }
-                    else {
-                        // Error
-                        errorMsg = "Garbage after closing quote";
-                        break;
+            auto pushRange = [&] (const char * p, size_t n)
+                {
+                    while (len + n > buflen) {
+                        std::unique_ptr<char[]> newBuf(new char[buflen * 2]);
+                        std::copy(s, s + len, newBuf.get());
+                        sdynamic.swap(newBuf);
+                        s = sdynamic.get();
+                        buflen *= 2;
                     }
+
+                    std::memcpy(s + len, p, n);
+                    len += n;
+                };
+
+            while (line < lineEnd) {
+                // Skip over the run of literal characters up to the next
+                // quote in one sweep, and copy it in as a block
+                const char * quotePos
+                    = scanFieldForSpecialChar(line, lineEnd, quote, quote,
+                                              eightBit);
+                if (quotePos > line)
+                    pushRange(line, quotePos - line);
+                line = quotePos;
+                if (line == lineEnd)
+                    break;  // unclosed quote
+
+                ++line;
+                if (line >= lineEnd) {
+                    ok = true;
+                    break;
+                }
+                else if (*line == separator) {
+                    ok = true;
+                    ++line;
+                    break;
+                }
+                else if (*line == quote) {
+                    // doubled quote; take a literal value
+                    pushChar(quote);
+                    ++line;
                 }
                 else {
-                    pushChar(c);
+                    // Error
+                    errorMsg = "Garbage after closing quote";
+                    break;
                 }
             }
 
@@ -531,11 +700,13 @@ parseFixedWidthCsvRow(const char * & line,
 
             //cerr << "eightBit = " << eightBit << endl;
             //cerr << "parsing " << string(s, len) << endl;
-            values[colNum++] = finishString(s, len, eightBit);
+            values[colNum++] = finishTyped(s, len, eightBit, hint);
+            if (errorMsg)
+                break;
 
             //cerr << "after quoted, *line = " << *line << endl;
         }
-        else if ((isdigit(c) || c == '-') && !isTextLine) {
+        else if ((isdigit(c) || c == '-') && !isTextLine && hint == CT_AUTO) {
             // Special case for something that looks like a number, in order to
             // save on parsing it.  We short circuit out when we get to a length
             // where we could start to lose digits, and fall back on parsing the
@@ -582,17 +753,28 @@ parseFixedWidthCsvRow(const char * & line,
             bool eightBit = !isascii(c);
             size_t len = 1;
 
-            for (; line < lineEnd;  ++line, ++len) {
-                c = *line;
-                if (c == separator && !isTextLine) {
-                    ++line;
-                    break;
+            if (!isTextLine) {
+                const char * fieldEnd
+                    = scanFieldForSpecialChar(line, lineEnd,
+                                              separator, separator,
+                                              eightBit);
+                len += fieldEnd - line;
+                line = fieldEnd;
+                if (line < lineEnd)
+                    ++line;  // skip the separator
+            }
+            else {
+                // The whole line is the field; we only need to know
+                // whether it's pure ASCII
+                for (; line < lineEnd;  ++line, ++len) {
+                    if (!isascii(*line))
+                        eightBit = true;
                 }
-                if (!isascii(c))
-                    eightBit = true;
             }
 
-            values[colNum++] = finishString(start, len, eightBit);
+            values[colNum++] = finishTyped(start, len, eightBit, hint);
+            if (errorMsg)
+                break;
         }
 
         //cerr << "added col " << (colNum - 1) << " val " << values[colNum - 1] << endl;
@@ -639,6 +821,8 @@ struct ImportTextProcedureWorkInstance
     // output column names that will be created once parsing has
     // happened.
     vector<ColumnName> inputColumnNames;
+    // Declared type per input column; empty when nothing is declared
+    vector<ColumnTypeHint> columnTypeHints;
     bool isTextLine;
     std::atomic<int> areOutputColumnNamesKnown;
     char separator;
@@ -659,12 +843,12 @@ struct ImportTextProcedureWorkInstance
 
     /*    Load a text file and filter according to the configuration  */
     void loadText(const ImportTextConfig& config,
+                  const std::string & filename,
                   std::shared_ptr<Dataset> dataset,
                   MldbServer * server,
-                  const std::function<bool (const Json::Value &)> & onProgress)
+                  const std::function<bool (const Json::Value &)> & onProgress,
+                  Dataset::MultiChunkRecorder & recorder)
     {
-        string filename = config.dataFileUrl.toString();
-
         // Ask for a memory mappable stream if possible
         Datacratic::filter_istream stream(filename, { { "mapped", "true" } });
 
@@ -795,10 +979,29 @@ struct ImportTextProcedureWorkInstance
                                           "columnName", c);
         }
 
+        // Resolve the declared column types against the input columns
+        if (!config.columnTypes.empty()) {
+            columnTypeHints.resize(inputColumnNames.size(), CT_AUTO);
+            for (auto & t: config.columnTypes) {
+                ColumnName col = config.structuredColumnNames
+                    ? ColumnName::parse(t.first)
+                    : ColumnName(t.first);
+                auto it = inputColumnIndex.find(ColumnHash(col));
+                if (it == inputColumnIndex.end())
+                    throw HttpReturnException
+                        (400, "Column in columnTypes is not a column "
+                         "of the CSV file",
+                         "columnName", col,
+                         "knownColumns", inputColumnNames);
+                columnTypeHints[it->second]
+                    = parseColumnTypeHint(t.first, t.second);
+            }
+        }
+
         // Now we know the columns, we can bind our SQL expressions for the
         // select, where, named and timestamp parts of the expression.
         SqlCsvScope scope(server, inputColumnNames, ts,
-                          Utf8String(config.dataFileUrl.toString()));
+                          Utf8String(filename));
 
         selectBound = config.select.bind(scope);
         whereBound = config.where->bind(scope);
@@ -853,16 +1056,19 @@ struct ImportTextProcedureWorkInstance
             getline(stream, line);
         }
 
-        loadTextData(dataset, stream, config, scope, onProgress);
+        loadTextData(dataset, stream, filename, config, scope, onProgress,
+                     recorder);
     }
 
     /*    Load, filter and format all lines and process them  */
     void
     loadTextData(std::shared_ptr<Dataset> dataset,
                  std::istream& stream,
+                 const std::string & filename,
                  const ImportTextConfig& config,
                  SqlCsvScope& scope,
-                 const std::function<bool (const Json::Value &)> & onProgress)
+                 const std::function<bool (const Json::Value &)> & onProgress,
+                 Dataset::MultiChunkRecorder & recorder)
     {
         Progress progress;
         std::shared_ptr<Step> iterationStep = progress.steps({
@@ -894,9 +1100,6 @@ struct ImportTextProcedureWorkInstance
                                       "line", line);
         };
 
-        Dataset::MultiChunkRecorder recorder
-            = dataset->getChunkRecorder();
-
         struct ThreadAccum {
             /// Recorder object for this thread that the dataset gives us
             /// to record into the dataset.
@@ -982,18 +1185,12 @@ struct ImportTextProcedureWorkInstance
                                             separator, quote, encoding,
                                             replaceInvalidCharactersWith,
                                             isTextLine,
-                                            hasQuoteChar);
+                                            hasQuoteChar,
+                                            columnTypeHints.empty()
+                                                ? nullptr
+                                                : columnTypeHints.data());
 
                 if (errorMsg) {
-                    if(config.allowMultiLines) {
-                        // check if we hit an error meaning we probably
-                        // have a multiline error
-                        if(errorMsg == unclosedQuoteError ||
-                           errorMsg == notEnoughColsError) {
-                            return false;
-                        }
-                    }
-
                     return handleError(errorMsg, actualLineNum,
                                            line - lineStart + 1,
                                            string(line, length));
@@ -1057,50 +1254,43 @@ struct ImportTextProcedureWorkInstance
         };
 
 
-        if(!config.allowMultiLines) {
-            forEachLineBlock(stream, onLine, config.limit,
-                             32 /* parallelism */,
-                             startChunk, doneChunk);
-        }
-        else {
-            // very simplistic and not efficient way of doing multi-line. we send
-            // lines one by one to the 'onLine' function, and if
-            // we get an error that probably is caused by a multi-
-            // line string, we concat the current line with the next
-            // one and try again. 
-            startChunk(0, 0);
-
-            string line;
-            string t_line;
-            string prevLine;
-            int64_t lineNum = 0;
-            while(getline(stream, line)) {
-                // prepend previous line if we're tagging it along
-                if(!prevLine.empty()) {
-                    t_line.assign(std::move(line));
-                    line.assign(std::move(prevLine));
-                    line += ' ' + t_line;
-                }
+        // When multi-line quoted values are allowed, the blocks are
+        // split at newlines outside quoted values, so every delivered
+        // line is a whole row with its embedded newlines; those become
+        // spaces, which is what the old sequential path produced by
+        // joining the pieces.  Most such files have no embedded
+        // newlines at all, and they now parse with full parallelism.
+        char blockQuoteChar
+            = (config.allowMultiLines && hasQuoteChar) ? quote : 0;
 
-                if(!onLine(line.c_str(), line.size(),
-                           0 /* chunkNum */, lineNum)) {
-                    prevLine.assign(std::move(line));
-                } else {
-                    prevLine.erase();
-                    lineNum++;
+        auto onLineMulti = [&] (const char * line, size_t length,
+                                int64_t chunkNum, int64_t lineNum) -> bool
+            {
+                if (JML_UNLIKELY(memchr(line, '\n', length) != nullptr)) {
+                    std::string joined(line, length);
+                    std::replace(joined.begin(), joined.end(), '\n', ' ');
+                    return onLine(joined.c_str(), joined.size(),
+                                  chunkNum, lineNum);
                 }
+                return onLine(line, length, chunkNum, lineNum);
+            };
 
-                if(config.limit > 0 && lineNum >= config.limit)
-                    break;
-            }
+        std::function<bool (const char *, size_t, int64_t, int64_t)>
+            lineFn = onLine;
+        if (blockQuoteChar)
+            lineFn = onLineMulti;
 
-            doneChunk(0, lineNum);
-        }
+        // When the file is block-indexed compressed, this
+        // decompresses and parses the blocks in parallel
+        forEachLineBlock(stream, filename,
+                         lineOffset - 1 /* lines already consumed */,
+                         std::move(lineFn), config.limit,
+                         32 /* parallelism */,
+                         startChunk, doneChunk,
+                         blockQuoteChar, separator);
 
         //cerr << "processed " << totalLinesProcessed << " lines" << endl;
 
-        recorder.commit();
-
         numLineErrors = numSkipped;
     }
 };
@@ -1134,16 +1324,100 @@ run(const ProcedureRunConfig & run,
 {
     auto runProcConf = applyRunConfOverProcConf(config, run);
 
+    // Expand the list of files to import
+    vector<string> filenames;
+
+    if (!runProcConf.dataFileUrl.empty())
+        filenames.push_back(runProcConf.dataFileUrl.toString());
+
+    for (const Url & url: runProcConf.dataFileUrls) {
+        string filename = url.toString();
+        if (!filename.empty() && filename[filename.size() - 1] == '*') {
+            // Wildcard: import every object with the given prefix
+            auto onObject = [&] (const std::string & uri,
+                                 const FsObjectInfo & info,
+                                 const OpenUriObject & open,
+                                 int depth)
+                {
+                    filenames.push_back(uri);
+                    return true;
+                };
+
+            forEachUriObject(string(filename, 0, filename.size() - 1),
+                             onObject);
+        }
+        else filenames.push_back(filename);
+    }
+
+    if (filenames.empty())
+        throw HttpReturnException
+            (400, "import.text procedure needs at least one file in "
+             "dataFileUrl or dataFileUrls");
+
     std::shared_ptr<Dataset> dataset
         = createDataset(server, runProcConf.outputDataset, onProgress,
                         true /*overwrite*/);
 
-    ImportTextProcedureWorkInstance instance;
+    // All files record their chunks through the same recorder, so they
+    // interleave into the one dataset and are committed together
+    Dataset::MultiChunkRecorder recorder
+        = dataset->getChunkRecorder();
+
+    // When several files are imported with the default row names, line
+    // numbers repeat across files; qualify them with the file they came
+    // from so that the names stay unique.
+    ImportTextConfig fileConf = runProcConf;
+    if (filenames.size() > 1
+        && fileConf.named->surface == "lineNumber()") {
+        fileConf.named = SqlExpression::parse
+            ("concat({f: dataFileUrl(), l: lineNumber()}, {separator: ':'})");
+    }
+
+    // One work instance per file, so that each file gets its own header,
+    // bound expressions and file timestamp
+    std::vector<ImportTextProcedureWorkInstance> instances(filenames.size());
+
+    // Progress callbacks can come from any file's worker threads
+    std::mutex progressMutex;
+    auto serializedProgress = [&] (const Json::Value & progress)
+        {
+            std::unique_lock<std::mutex> guard(progressMutex);
+            return onProgress(progress);
+        };
+
+    auto importFile = [&] (size_t fileNum)
+        {
+            instances[fileNum].loadText(fileConf, filenames[fileNum],
+                                        dataset, server, serializedProgress,
+                                        recorder);
+        };
+
+    if (filenames.size() == 1)
+        importFile(0);
+    else {
+        // Each file is a ThreadPool job; within a file, the line blocks
+        // are themselves parsed in parallel
+        parallelMap(0, filenames.size(), importFile);
+
+        // All of the files must agree on the column structure
+        for (size_t i = 1;  i < instances.size();  ++i) {
+            if (instances[i].inputColumnNames
+                != instances[0].inputColumnNames)
+                throw HttpReturnException
+                    (400, "All files of a multi-file import.text "
+                     "must have the same columns",
+                     "firstFile", filenames[0],
+                     "mismatchedFile", filenames[i]);
+        }
+    }
 
-    instance.loadText(config, dataset, server, onProgress);
+    recorder.commit();
 
     Json::Value status;
-    status["numLineErrors"] = instance.numLineErrors;
+    uint64_t numLineErrors = 0;
+    for (auto & instance: instances)
+        numLineErrors += instance.numLineErrors;
+    status["numLineErrors"] = numLineErrors;
 
     dataset->commit();
 
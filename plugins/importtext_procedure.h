@@ -42,6 +42,7 @@ struct ImportTextConfig : public ProcedureConfig  {
     }
 
     Url dataFileUrl;
+    std::vector<Url> dataFileUrls;  ///< Further files, imported concurrently
     PolyConfigT<Dataset> outputDataset;
     std::vector<Utf8String> headers;
     std::string delimiter;
@@ -54,6 +55,10 @@ struct ImportTextConfig : public ProcedureConfig  {
     bool structuredColumnNames;
     bool allowMultiLines;
 
+    /// Declared type ("integer", "number" or "string") per input column;
+    /// columns left out are inferred cell by cell as usual.
+    std::map<Utf8String, std::string> columnTypes;
+
     SelectExpression select;               ///< What to select from the CSV
     std::shared_ptr<SqlExpression> where;  ///< Filter for the CSV
     std::shared_ptr<SqlExpression> named;  ///< Row name to output
@@ -0,0 +1,280 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/**
+ * json_export_procedure.cc
+ * This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+ *
+ * Exports a dataset as JSON Lines: one JSON object per row, with one
+ * member per column.  The output of a plain "SELECT *" export can be
+ * read back with import.json.
+ **/
+
+#include "json_export_procedure.h"
+#include "mldb/server/mldb_server.h"
+#include "mldb/sql/sql_expression.h"
+#include "mldb/server/dataset_context.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/base/parallel.h"
+#include "mldb/server/bound_queries.h"
+#include "mldb/sql/table_expression_operations.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/types/json_printing.h"
+#include "mldb/vfs/filter_streams.h"
+#include "mldb/plugins/sql_config_validator.h"
+#include "mldb/base/thread_pool.h"
+#include <memory>
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+JsonExportProcedureConfig::
+JsonExportProcedureConfig()
+    : numPartitions(0)
+{
+}
+
+DEFINE_STRUCTURE_DESCRIPTION(JsonExportProcedureConfig);
+
+JsonExportProcedureConfigDescription::
+JsonExportProcedureConfigDescription()
+{
+    addField("exportData", &JsonExportProcedureConfig::exportData,
+             "An SQL query to select the data to be exported.  This could "
+             "be any query on an existing dataset.");
+    addField("dataFileUrl", &JsonExportProcedureConfig::dataFileUrl,
+             "URL where the JSON Lines output should be written to.  The "
+             "compression is taken from the extension (for example .gz or "
+             ".lz4).  If a file already exists, it will be overwritten.");
+    addField("numPartitions", &JsonExportProcedureConfig::numPartitions,
+             "Number of part files to write in parallel, each named by "
+             "inserting '-part-NNNNNN' before the extension of "
+             "`dataFileUrl`.  Only plain \"SELECT *\" exports can be "
+             "partitioned; the default of 0 writes one part per CPU core "
+             "for those, and a value of 1 forces a single file.  Queries "
+             "that go through the query engine always write a single "
+             "file.", 0);
+    addParent<ProcedureConfig>();
+
+    onPostValidate = [&] (JsonExportProcedureConfig * cfg,
+                          JsonParsingContext & context)
+    {
+        if (cfg->numPartitions < 0) {
+            throw ML::Exception("numPartitions must not be negative.");
+        }
+        MustContainFrom()(cfg->exportData, JsonExportProcedureConfig::name);
+    };
+}
+
+namespace {
+
+/// Flush the serialization buffer through the stream once it grows to
+/// this size, so that its capacity settles and rows serialize without
+/// further allocation
+constexpr size_t FLUSH_BUFFER_SIZE = 1024 * 1024;
+
+/// Name of the given part file: dataFileUrl with "-part-NNNNNN" inserted
+/// before the first extension, so "out.jsonl.gz" becomes
+/// "out-part-000003.jsonl.gz" and the compression is kept
+std::string partFileName(const Url & url, int part, int numParts)
+{
+    string result = url.toString();
+    if (numParts == 1)
+        return result;
+    string suffix = ML::format("-part-%06d", part);
+    size_t lastSlash = result.rfind('/');
+    size_t firstDot = result.find('.', lastSlash == string::npos
+                                   ? 0 : lastSlash);
+    if (firstDot == string::npos)
+        return result + suffix;
+    return result.substr(0, firstDot) + suffix + result.substr(firstDot);
+}
+
+/// Serialize one row as a JSON object with one member per column,
+/// followed by a newline.  The context must be printing into output.
+void printRowObject(StringJsonPrintingContext & context,
+                    std::string & output,
+                    const std::vector<std::tuple<ColumnName, CellValue,
+                                                 Date> > & columns)
+{
+    context.startObject();
+    for (auto & c: columns) {
+        context.startMember(std::get<0>(c).toUtf8String());
+        std::get<1>(c).extractStructuredJson(context);
+    }
+    context.endObject();
+    output += '\n';
+}
+
+/** Fast path for "SELECT *"-shaped exports.
+
+    When the statement selects every column of a plain dataset with no
+    filtering, ordering or windowing, the rows are independent and can be
+    partitioned by row range: each partition walks its range of the
+    dataset storage, serializes rows straight into a reused buffer and
+    writes through its own compressed stream to a numbered part file, so
+    the export runs as wide as the import did.
+
+    Returns false if the statement does not have the required shape, in
+    which case the caller falls back to the general query path.
+*/
+bool tryDirectExport(const JsonExportProcedureConfig & config,
+                     const BoundTableExpression & boundDataset)
+{
+    const SelectStatement & stm = *config.exportData.stm;
+
+    if (!boundDataset.dataset)
+        return false;
+    if ((stm.where && !stm.where->isConstantTrue())
+        || (stm.when.when && !stm.when.when->isConstantTrue())
+        || !stm.orderBy.clauses.empty()
+        || !stm.groupBy.clauses.empty()
+        || stm.offset != 0
+        || stm.limit != -1)
+        return false;
+
+    SqlExpressionDatasetScope dscope(*boundDataset.dataset,
+                                     boundDataset.asName);
+    if (!stm.select.isIdentitySelect(dscope))
+        return false;
+
+    const Dataset & dataset = *boundDataset.dataset;
+    auto matrix = dataset.getMatrixView();
+    auto stream = dataset.getRowStream();
+    if (!matrix || !stream)
+        return false;
+
+    const size_t numRows = matrix->getRowCount();
+
+    // One partition per core by default, but never so many that a
+    // partition is too small to be worth a file of its own
+    constexpr size_t MIN_ROWS_PER_PARTITION = 16384;
+    size_t numPartitions
+        = config.numPartitions > 0 ? config.numPartitions : numCpus();
+    numPartitions
+        = std::max<size_t>(1, std::min<size_t>(numPartitions,
+                                               numRows
+                                               / MIN_ROWS_PER_PARTITION));
+
+    auto doPartition = [&] (size_t partition)
+    {
+        const size_t firstRow = numRows * partition / numPartitions;
+        const size_t lastRow = numRows * (partition + 1) / numPartitions;
+
+        filter_ostream out(partFileName(config.dataFileUrl,
+                                        partition, numPartitions));
+
+        auto myStream = stream->clone();
+        myStream->initAt(firstRow);
+
+        std::string output;
+        output.reserve(2 * FLUSH_BUFFER_SIZE);
+        StringJsonPrintingContext context(output);
+        context.writeUtf8 = true;
+
+        for (size_t r = firstRow;  r < lastRow;  ++r) {
+            RowName rowName = myStream->next();
+            MatrixNamedRow row = matrix->getRow(rowName);
+            printRowObject(context, output, row.columns);
+
+            if (output.size() >= FLUSH_BUFFER_SIZE) {
+                out << output;
+                output.clear();
+            }
+        }
+
+        out << output;
+    };
+
+    parallelMap(0, numPartitions, doPartition);
+
+    return true;
+}
+
+} // file scope
+
+JsonExportProcedure::
+JsonExportProcedure(MldbServer * owner,
+                    PolyConfig config,
+                    const std::function<bool (const Json::Value &)> & onProgress)
+    : Procedure(owner)
+{
+    procedureConfig = config.params.convert<JsonExportProcedureConfig>();
+}
+
+RunOutput
+JsonExportProcedure::
+run(const ProcedureRunConfig & run,
+    const std::function<bool (const Json::Value &)> & onProgress) const
+{
+    auto runProcConf = applyRunConfOverProcConf(procedureConfig, run);
+    SqlExpressionMldbScope context(server);
+
+    auto boundDataset = runProcConf.exportData.stm->from->bind(context);
+
+    // "SELECT *" over a plain dataset can be written straight from
+    // storage, partitioned over all cores
+    if (tryDirectExport(runProcConf, boundDataset)) {
+        RunOutput output;
+        return output;
+    }
+
+    // General path: run the query and serialize its rows in order into
+    // a single file
+    filter_ostream out(runProcConf.dataFileUrl.toString());
+
+    vector<shared_ptr<SqlExpression> > calc;
+    BoundSelectQuery bsq(runProcConf.exportData.stm->select,
+                         *boundDataset.dataset,
+                         boundDataset.asName,
+                         runProcConf.exportData.stm->when,
+                         *runProcConf.exportData.stm->where,
+                         runProcConf.exportData.stm->orderBy,
+                         calc);
+
+    std::string output;
+    output.reserve(2 * FLUSH_BUFFER_SIZE);
+    StringJsonPrintingContext printContext(output);
+    printContext.writeUtf8 = true;
+
+    auto outputJsonLine = [&] (NamedRowValue & row_,
+                               const vector<ExpressionValue> & calc)
+    {
+        MatrixNamedRow row = row_.flattenDestructive();
+        printRowObject(printContext, output, row.columns);
+
+        if (output.size() >= FLUSH_BUFFER_SIZE) {
+            out << output;
+            output.clear();
+        }
+        return true;
+    };
+
+    bsq.execute({outputJsonLine, false/*processInParallel*/},
+                runProcConf.exportData.stm->offset,
+                runProcConf.exportData.stm->limit,
+                onProgress);
+
+    out << output;
+
+    RunOutput output_;
+    return output_;
+}
+
+Any
+JsonExportProcedure::
+getStatus() const
+{
+    return Any();
+}
+
+static RegisterProcedureType<JsonExportProcedure, JsonExportProcedureConfig>
+regJsonExportProcedure(
+    builtinPackage(),
+    "Exports a dataset to a target location as JSON Lines",
+    "procedures/JsonExportProcedure.md.html");
+
+} // namespace MLDB
+} // namespace Datacratic
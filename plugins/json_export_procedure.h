@@ -0,0 +1,47 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/**
+ * json_export_procedure.h
+ * This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+ *
+ * Exports a dataset as JSON Lines, optionally as parallel part files.
+ **/
+
+#pragma once
+#include "mldb/core/procedure.h"
+#include "mldb/core/function.h"
+#include "mldb/core/dataset.h"
+#include "mldb/sql/sql_expression.h"
+
+namespace Datacratic {
+namespace MLDB {
+
+struct JsonExportProcedureConfig : ProcedureConfig {
+    static constexpr const char * name = "export.jsonl";
+
+    JsonExportProcedureConfig();
+    InputQuery exportData;
+    Url dataFileUrl;
+    int numPartitions;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(JsonExportProcedureConfig);
+
+struct JsonExportProcedure: public Procedure {
+
+    JsonExportProcedure(
+        MldbServer * owner,
+        PolyConfig config,
+        const std::function<bool (const Json::Value &)> & onProgress);
+
+    virtual RunOutput run(
+        const ProcedureRunConfig & run,
+        const std::function<bool (const Json::Value &)> & onProgress) const;
+
+    virtual Any getStatus() const;
+
+    JsonExportProcedureConfig procedureConfig;
+};
+
+} // namespace MLDB
+} // namespace Datacratic
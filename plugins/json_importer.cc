@@ -21,6 +21,7 @@
 #include "mldb/base/parallel.h"
 #include "mldb/arch/timers.h"
 #include "mldb/base/parse_context.h"
+#include "mldb/types/simd_json_parsing.h"
 
 using namespace std;
 
@@ -112,7 +113,9 @@ struct JSONImporter: public Procedure {
         std::string line;
         std::string filename = runProcConf.dataFileUrl.toString();
 
-        filter_istream stream(filename);
+        // Map the file when possible, so that forEachLineBlock can parse
+        // straight out of the mapping instead of copying it block by block
+        filter_istream stream(filename, { { "mapped", "true" } });
 
         Date timestamp = stream.info().lastModified;
 
@@ -178,6 +181,31 @@ struct JSONImporter: public Procedure {
             if(lineLength == 0)
                 return handleError("empty line", actualLineNum, "");
 
+            // TODO: in the configuration
+            JsonArrayHandling arrays = ENCODE_ARRAYS;
+
+            // Fast path: tokenize the whole line with the vectorized
+            // parser.  If it can't handle the line, or anything goes
+            // wrong converting it, re-parse with the streaming parser
+            // below, which has identical semantics and produces the
+            // error messages.
+            static thread_local SimdJsonParsingContext simdParser;
+
+            if (simdParser.init(filename, line, lineLength, actualLineNum)) {
+                try {
+                    ExpressionValue expr
+                        = ExpressionValue::parseJson(simdParser, timestamp,
+                                                     arrays);
+                    recordedLines++;
+                    threadAccum.threadRecorder
+                        ->recordRowExprDestructive(RowName(actualLineNum),
+                                                   std::move(expr));
+                    return true;
+                } catch (const std::exception & exc) {
+                    // fall through to the streaming parser
+                }
+            }
+
             StreamingJsonParsingContext parser(filename, line, lineLength,
                                                actualLineNum);
 
@@ -186,9 +214,6 @@ struct JSONImporter: public Procedure {
                 return handleError("empty line", actualLineNum, "");
             }
 
-            // TODO: in the configuration
-            JsonArrayHandling arrays = ENCODE_ARRAYS;
-
             ExpressionValue expr;
             try {
                 expr = ExpressionValue::parseJson(parser, timestamp, arrays);
@@ -209,7 +234,9 @@ struct JSONImporter: public Procedure {
             return true;
         };
 
-        forEachLineBlock(stream, onLine, runProcConf.limit, 32,
+        forEachLineBlock(stream, filename,
+                         lineOffset - 1 /* lines already consumed */,
+                         onLine, runProcConf.limit, 32,
                          startChunk, doneChunk);
 
         cerr << timer.elapsed() << endl;
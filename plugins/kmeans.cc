@@ -75,6 +75,12 @@ KmeansConfigDescription()
              "Maximum number of iterations to perform.  If no convergeance is "
              "reached within this number of iterations, the current clustering "
              "will be returned.", 100);
+    addField("minibatchSize", &KmeansConfig::minibatchSize,
+             "If non-zero, each iteration refines the centroids from a "
+             "random sample of this many rows instead of a full pass over "
+             "the data (mini-batch k-means).  This is much faster on large "
+             "datasets, at the cost of slightly less accurate centroids.  "
+             "0 means classical full-batch k-means.", 0);
     addField("metric", &KmeansConfig::metric,
              "Metric space in which the k-means distances will be calculated. "
              "Normally this will be Cosine for an orthonormal basis, and "
@@ -198,7 +204,8 @@ run(const ProcedureRunConfig & run,
     int numClusters = runProcConf.numClusters;
     int numIterations = runProcConf.maxIterations;
 
-    kmeans.train(vecs, inCluster, numClusters, numIterations);
+    kmeans.train(vecs, inCluster, numClusters, numIterations,
+                 1 /* randomSeed */, runProcConf.minibatchSize);
 
     bool saved = false;
     if (!runProcConf.modelFileUrl.empty()) {
@@ -33,6 +33,7 @@ struct KmeansConfig : public ProcedureConfig {
         : numInputDimensions(-1),
           numClusters(10),
           maxIterations(100),
+          minibatchSize(0),
           metric(METRIC_COSINE)
     {
     }
@@ -46,6 +47,7 @@ struct KmeansConfig : public ProcedureConfig {
     int numInputDimensions;
     int numClusters;
     int maxIterations;
+    int minibatchSize;
     MetricSpace metric;
 
     Utf8String functionName;
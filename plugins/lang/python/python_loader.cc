@@ -291,9 +291,10 @@ handleRequest(RestConnection & connection,
     if (res != RestRequestRouter::MR_NO)
         return res;
 
-    // check if 
+    // check if
     bool isChild = request.header.headers.find("__mldb_child_call") != request.header.headers.end();
-    PythonSubinterpreter pyControl(isChild);
+    PooledPythonSubinterpreter pyControlHandle(isChild);
+    PythonSubinterpreter & pyControl = pyControlHandle.interpreter();
     addPluginPathToEnv(pyControl);
 
     // Second, check for a generic request handler
@@ -373,7 +374,11 @@ handleTypeRoute(RestDirectory * server,
         }
 
         bool isChild = request.header.headers.find("__mldb_child_call") != request.header.headers.end();
-        PythonSubinterpreter pyControl(isChild);
+
+        // Scripts run in a warm interpreter from the pool; the boot
+        // cost is paid on the first run only
+        PooledPythonSubinterpreter pyControlHandle(isChild);
+        PythonSubinterpreter & pyControl = pyControlHandle.interpreter();
         auto result = runPythonScript(titl, PackageElement::MAIN, pyControl);
         conn.sendResponse(result.exception ? 400 : 200,
                           jsonEncodeStr(result), "application/json");
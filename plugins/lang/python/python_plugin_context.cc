@@ -49,10 +49,13 @@ PythonSubinterpreter(bool isChild) : isChild(isChild)
     // change current thread state
     savedThreadState = PyThreadState_Swap(threadState);
 
-    main_module = boost::python::import("__main__"); 
+    main_module = boost::python::import("__main__");
     main_namespace = main_module.attr("__dict__");
 
     injectOutputLoggingCode();
+
+    initialSysPath = boost::python::list(boost::python::import("sys")
+                                         .attr("path"));
 }
 
 PythonSubinterpreter::
@@ -102,6 +105,80 @@ releaseGil()
     hasGil = false;
 }
 
+void PythonSubinterpreter::
+reset()
+{
+    acquireGil();
+
+    // Drop everything the last run left in __main__; the modules it
+    // imported stay loaded in the interpreter
+    boost::python::exec(
+        "for _k in list(globals().keys()):\n"
+        "    if _k not in ('__builtins__', '__name__', '__doc__', "
+        "'__package__'):\n"
+        "        del globals()[_k]\n",
+        main_namespace);
+
+    // Undo any additions to sys.path (eg the plugin dir a route
+    // handler run inserts)
+    boost::python::import("sys").attr("path")
+        = boost::python::list(initialSysPath);
+
+    injectOutputLoggingCode();
+}
+
+
+/****************************************************************************/
+/* PooledPythonSubinterpreter                                               */
+/****************************************************************************/
+
+std::mutex PooledPythonSubinterpreter::poolMutex;
+std::vector<std::shared_ptr<PythonSubinterpreter> >
+    PooledPythonSubinterpreter::pool;
+constexpr size_t PooledPythonSubinterpreter::MAX_IDLE;
+
+PooledPythonSubinterpreter::
+PooledPythonSubinterpreter(bool isChild)
+{
+    if(!isChild) {
+        lock = std::unique_ptr<std::lock_guard<std::mutex>>(
+                new std::lock_guard<std::mutex>(PythonSubinterpreter::youShallNotPassMutex));
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(poolMutex);
+        if (!pool.empty()) {
+            interp = std::move(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    if (interp) {
+        interp->acquireGil();
+    }
+    else {
+        // The serialization lock (when one is needed) is already held
+        // above, so the interpreter itself is constructed as a child
+        interp = std::make_shared<PythonSubinterpreter>(true /* isChild */);
+    }
+}
+
+PooledPythonSubinterpreter::
+~PooledPythonSubinterpreter()
+{
+    try {
+        interp->reset();
+        interp->releaseGil();
+
+        std::unique_lock<std::mutex> guard(poolMutex);
+        if (pool.size() < MAX_IDLE)
+            pool.emplace_back(std::move(interp));
+    } catch (...) {
+        // An interpreter whose namespace can't be reset isn't safe to
+        // hand to the next run; let it be destroyed instead
+    }
+}
+
 ScriptException
 convertException(PythonSubinterpreter & pyControl,
         const boost::python::error_already_set & exc2,
@@ -46,15 +46,27 @@ struct PythonSubinterpreter {
 
     void acquireGil();
     void releaseGil();
-    
+
+    /** Put the interpreter back in the state a fresh one starts in:
+        everything the last run left in __main__ is dropped, sys.path
+        is restored and the output logging code is re-injected.  The
+        modules the run imported stay loaded, which is what makes a
+        reset interpreter cheap to reuse.  Must only be called between
+        runs; leaves the GIL held.
+    */
+    void reset();
+
     PyThreadState* savedThreadState;
-    
+
     PyThreadState* interpState;
     PyThreadState* threadState;
-    
+
     boost::python::object main_module;
     boost::python::object main_namespace;
 
+    /// Copy of sys.path at creation, restored by reset()
+    boost::python::object initialSysPath;
+
     bool hasGil;
     bool isChild;
 
@@ -62,6 +74,41 @@ struct PythonSubinterpreter {
     std::unique_ptr<std::lock_guard<std::mutex>> lock;
 };
 
+
+/****************************************************************************/
+/* PooledPythonSubinterpreter                                               */
+/****************************************************************************/
+
+/** Checks a warm subinterpreter out of a process-wide pool for the
+    duration of a run, instead of paying interpreter creation and module
+    initialization on every script.  On destruction the interpreter is
+    reset (see PythonSubinterpreter::reset()) and returned to the pool,
+    so repeated small scripts keep their imported modules loaded across
+    runs.  The caveat is the same as any warm pool: module-level state a
+    script leaves behind survives into the next run.
+
+    Non-child runs are serialized by the same mutex that direct
+    construction of a PythonSubinterpreter takes.
+*/
+struct PooledPythonSubinterpreter {
+    PooledPythonSubinterpreter(bool isChild = false);
+    ~PooledPythonSubinterpreter();
+
+    PythonSubinterpreter & interpreter() { return *interp; }
+
+    /// Maximum idle interpreters kept warm
+    static constexpr size_t MAX_IDLE = 4;
+
+private:
+    // Declared before the interpreter so the serialization lock is
+    // released only once the interpreter is reset and back in the pool
+    std::unique_ptr<std::lock_guard<std::mutex>> lock;
+    std::shared_ptr<PythonSubinterpreter> interp;
+
+    static std::mutex poolMutex;
+    static std::vector<std::shared_ptr<PythonSubinterpreter> > pool;
+};
+
 ScriptException
 convertException(PythonSubinterpreter & pyControl,
         const boost::python::error_already_set & exc2,
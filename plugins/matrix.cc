@@ -302,22 +302,47 @@ invertFeatures(const ClassifiedColumns & columns,
     // Index of examples for each discrete behaviour
     std::mutex discreteValuesLock;
 
+    // Tile sizes for the blocked transpose of the continuous values.
+    // A column block's worth of destination cache lines stays hot while
+    // a row block streams through it, instead of every row striding
+    // across every column's array.
+    constexpr size_t TRANSPOSE_ROW_BLOCK = 256;
+    constexpr size_t TRANSPOSE_COL_BLOCK = 64;
+
     auto doBucket = [&] (int n)
         {
+            const FeatureBucket & bucket = featureBuckets[n];
+            size_t numBucketRows = bucket.size();
+
+            // Blocked transpose of the continuous (dense) part
+            for (size_t r0 = 0;  r0 < numBucketRows;
+                 r0 += TRANSPOSE_ROW_BLOCK) {
+                size_t r1 = std::min(numBucketRows, r0 + TRANSPOSE_ROW_BLOCK);
+                for (size_t c0 = 0;  c0 < (size_t)numContinuousColumns;
+                     c0 += TRANSPOSE_COL_BLOCK) {
+                    size_t c1 = std::min<size_t>(numContinuousColumns,
+                                                 c0 + TRANSPOSE_COL_BLOCK);
+                    for (size_t r = r0;  r < r1;  ++r) {
+                        const ExtractedRow & entry = bucket[r];
+                        size_t index = bucket.startIndex + r;
+                        size_t cEnd = std::min<size_t>(c1, entry.continuous.size());
+                        for (size_t c = c0;  c < cEnd;  ++c)
+                            result[c].continuousValues[index] = entry.continuous[c];
+                    }
+                }
+            }
+
             // For each discrete column, a list of the indexes of this bucket
             // that contain the feature.
             std::vector<std::vector<int> > bucketDiscreteIndexes(numSparseColumns);
             std::vector<std::vector<std::pair<int, float> > > bucketSparseIndexes(numSparseColumns);
-            
+
             int index = featureBuckets[n].startIndex;
 
             for (const ExtractedRow & entry: featureBuckets[n]) {
                 //cerr << "continuous " << entry.continuous.size() << " sparse "
                 //     << entry.sparse.size() << endl;
 
-                for (unsigned i = 0;  i < entry.continuous.size();  ++i) {
-                    result[i].continuousValues[index] = entry.continuous[i];
-                }
                 for (auto col_val: entry.sparse) {
 
                     int sparseColumnNum;
@@ -20,6 +20,8 @@
 #include "mldb/plugins/sql_expression_extractors.h"
 #include "mldb/plugins/sparse_matrix_dataset.h"
 #include "mldb/server/bound_queries.h"
+#include "mldb/server/per_thread_accumulator.h"
+#include <atomic>
 
 using namespace std;
 
@@ -137,7 +139,50 @@ run(const ProcedureRunConfig & run,
     ColumnName keyColumnName(runProcConf.keyColumnName);
     ColumnName valueColumnName(runProcConf.valueColumnName);
 
-    std::mutex recordMutex;
+    // Melted rows stream from the executor's threads straight into the
+    // output dataset's chunk recorder: each thread fills its own chunk,
+    // so there is no global lock on the record path and no intermediate
+    // materialization of the output rows.
+    constexpr size_t ROWS_PER_CHUNK = 65536;
+    constexpr size_t FLUSH_ROWS = 1024;
+
+    Dataset::MultiChunkRecorder recorder = outputDataset->getChunkRecorder();
+
+    struct ThreadAccum {
+        /// Recorder for the chunk this thread is currently filling
+        std::unique_ptr<Recorder> threadRecorder;
+        /// Rows already recorded into the current chunk
+        size_t rowsInChunk = 0;
+        /// Small buffer so rows are handed over in batches
+        std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > rows;
+    };
+
+    PerThreadAccumulator<ThreadAccum> accum;
+    std::atomic<size_t> chunkNumber(0);
+
+    auto flush = [&recorder, &chunkNumber] (ThreadAccum & threadAccum,
+                                            bool finish)
+        {
+            if (!threadAccum.rows.empty()) {
+                if (!threadAccum.threadRecorder)
+                    threadAccum.threadRecorder
+                        = recorder.newChunk(chunkNumber.fetch_add(1));
+                threadAccum.rowsInChunk += threadAccum.rows.size();
+                threadAccum.threadRecorder
+                    ->recordRowsDestructive(std::move(threadAccum.rows));
+                threadAccum.rows.clear();
+            }
+
+            // Cut the chunk once it's full so that it can be frozen
+            // and its mutable representation released
+            if (threadAccum.threadRecorder
+                && (finish || threadAccum.rowsInChunk >= ROWS_PER_CHUNK)) {
+                threadAccum.threadRecorder->finishedChunk();
+                threadAccum.threadRecorder.reset();
+                threadAccum.rowsInChunk = 0;
+            }
+        };
+
     auto processor = [&] (NamedRowValue & row_,
                            const std::vector<ExpressionValue> & extraVals)
         {
@@ -165,18 +210,29 @@ run(const ProcedureRunConfig & run,
                 expr.forEachAtom(onAtom, ColumnName());
             }
 
+            auto & threadAccum = accum.get();
+            threadAccum.rows.reserve(FLUSH_ROWS);
+
             // Melted
             for(auto & col : row.columns) {
-                // TODO. should I call recordRow twice instead of doing a vector copy here?
-                RowValue currOutputRow(fixedOutputRows);
+                RowValue currOutputRow;
+                currOutputRow.reserve(fixedOutputRows.size() + 2);
+                currOutputRow.assign(fixedOutputRows.begin(),
+                                     fixedOutputRows.end());
 
                 currOutputRow.emplace_back(keyColumnName, get<0>(col).toUtf8String(), rowTs);
-                currOutputRow.emplace_back(valueColumnName, get<1>(col), rowTs);
 
                 RowName rowName = row.rowName + std::get<0>(col);
 
-                std::unique_lock<std::mutex> guard(recordMutex);
-                outputDataset->recordRow(rowName, currOutputRow);
+                // The melted column is visited exactly once, so its value
+                // can be moved into the output row
+                currOutputRow.emplace_back(valueColumnName, std::move(get<1>(col)), rowTs);
+
+                threadAccum.rows.emplace_back(std::move(rowName),
+                                              std::move(currOutputRow));
+
+                if (threadAccum.rows.size() >= FLUSH_ROWS)
+                    flush(threadAccum, false /* finish */);
             }
             return true;
         };
@@ -193,6 +249,12 @@ run(const ProcedureRunConfig & run,
                  runProcConf.inputData.stm->limit,
                  nullptr /* progress */);
 
+    // Finish off the partial chunk of each thread
+    accum.forEach([&] (ThreadAccum * threadAccum)
+                  {
+                      flush(*threadAccum, true /* finish */);
+                  });
+
     outputDataset->commit();
 
     return RunOutput();
@@ -131,6 +131,92 @@ dist(int rowNum1, int rowNum2,
     return sqrtf(distSquared);
 }
 
+float
+EuclideanDistanceMetric::
+distQuantized(int rowNum1, int rowNum2,
+              const int8_t * coords1,
+              const int8_t * coords2,
+              const float * scale2,
+              size_t numDims) const
+{
+    // Make sure dist(x,x) == 0 irrespective of rounding
+    if (rowNum1 == rowNum2 && rowNum1 != -1)
+        return 0.0;
+
+    // The kernel is symmetric by construction, so unlike dist() no
+    // argument reordering is needed to get dist(x,y) == dist(y,x)
+    double distSquared
+        = ML::SIMD::vec_euclid_i8(coords1, coords2, scale2, numDims);
+    ExcAssert(isfinite(distSquared));
+
+    // Deal with rounding errors
+    if (distSquared < 0.0)
+        distSquared = 0.0;
+
+    return sqrtf(distSquared);
+}
+
+float
+EuclideanDistanceMetric::
+distFlat(int rowNum1, int rowNum2,
+         const float * coords1,
+         const float * coords2,
+         size_t numDims) const
+{
+    if (rowNum1 == -1 || rowNum2 == -1) {
+        double distSquared = ML::SIMD::vec_euclid(coords1, coords2, numDims);
+        ExcAssert(isfinite(distSquared));
+        return sqrt(std::max(distSquared, 0.0));
+    }
+
+    // Make sure dist(x,y) == dist(y,x) irrespective of rounding
+    if (rowNum2 < rowNum1)
+        return distFlat(rowNum2, rowNum1, coords2, coords1, numDims);
+
+    // Make sure dist(x,x) == 0 irrespective of rounding
+    if (rowNum1 == rowNum2)
+        return 0.0;
+
+    // Same cached norm calculation as dist(); see there for the
+    // derivation
+    float dpResult = -2.0 * ML::SIMD::vec_dotprod_dp(coords1, coords2,
+                                                     numDims);
+    ExcAssert(isfinite(dpResult));
+
+    float distSquared = dpResult + sum_dist.at(rowNum1) + sum_dist.at(rowNum2);
+    ExcAssert(isfinite(distSquared));
+
+    // Deal with rounding errors
+    if (distSquared < 0.0)
+        distSquared = 0.0;
+
+    return sqrtf(distSquared);
+}
+
+void
+EuclideanDistanceMetric::
+distMany(const ML::distribution<float> & coords,
+         const int * rowNums,
+         const float * const * rowCoords,
+         size_t numRows,
+         float * out) const
+{
+    // Same calculation as calc(): a direct sum of squared differences,
+    // so the results agree with dist() against a query point.  The
+    // cached row norms don't help here; the one to many kernel already
+    // amortizes the query vector loads.
+    std::vector<double> distSquared(numRows);
+    ML::SIMD::vec_euclid_many(coords.data(), rowCoords, numRows,
+                              coords.size(), distSquared.data());
+
+    for (size_t i = 0;  i < numRows;  ++i) {
+        ExcAssert(isfinite(distSquared[i]));
+
+        // Deal with rounding errors
+        out[i] = sqrt(std::max(distSquared[i], 0.0));
+    }
+}
+
 
 /*****************************************************************************/
 /* COSINE DISTANCE METRIC                                                    */
@@ -246,6 +332,128 @@ dist(int rowNum1, int rowNum2,
     return result;
 }
 
+float
+CosineDistanceMetric::
+distQuantized(int rowNum1, int rowNum2,
+              const int8_t * coords1,
+              const int8_t * coords2,
+              const float * scale2,
+              size_t numDims) const
+{
+    // Make sure dist(x,x) == 0 irrespective of rounding
+    if (rowNum1 == rowNum2 && rowNum1 != -1)
+        return 0.0;
+
+    // Use the cached norm reciprocal for known rows; for a query point
+    // we calculate it from the quantized coordinates.  Zero magnitude
+    // vectors get a non-finite reciprocal, matching addRow().
+    double recip1 = rowNum1 != -1
+        ? two_norm_recip.at(rowNum1)
+        : 1.0 / sqrt(ML::SIMD::vec_twonorm_sqr_i8_dp(coords1, scale2,
+                                                     numDims));
+    double recip2 = rowNum2 != -1
+        ? two_norm_recip.at(rowNum2)
+        : 1.0 / sqrt(ML::SIMD::vec_twonorm_sqr_i8_dp(coords2, scale2,
+                                                     numDims));
+
+    if (!isfinite(recip1) && !isfinite(recip2))
+        return 0.0;
+    if (!isfinite(recip1) || !isfinite(recip2))
+        return 1.0;
+
+    double dotprod
+        = ML::SIMD::vec_dotprod_i8_dp(coords1, coords2, scale2, numDims);
+
+    float result = 1.0 - dotprod * recip1 * recip2;
+    if (result < 0.0)
+        result = 0.0;
+
+    ExcAssert(isfinite(result));
+    ExcAssertGreaterEqual(result, 0.0);
+
+    return result;
+}
+
+float
+CosineDistanceMetric::
+distFlat(int rowNum1, int rowNum2,
+         const float * coords1,
+         const float * coords2,
+         size_t numDims) const
+{
+    // Make sure dist(x,x) == 0 irrespective of rounding
+    if (rowNum1 == rowNum2 && rowNum1 != -1)
+        return 0.0;
+
+    // Make sure dist(x,y) == dist(y,x) irrespective of rounding
+    if (rowNum1 != -1 && rowNum2 != -1 && rowNum2 < rowNum1)
+        return distFlat(rowNum2, rowNum1, coords2, coords1, numDims);
+
+    // Use the cached norm reciprocal for known rows; for a query point
+    // we calculate it from the coordinates.  Zero magnitude vectors
+    // get a non-finite reciprocal, matching addRow().
+    double recip1 = rowNum1 != -1
+        ? two_norm_recip.at(rowNum1)
+        : 1.0 / sqrt(ML::SIMD::vec_dotprod_dp(coords1, coords1, numDims));
+    double recip2 = rowNum2 != -1
+        ? two_norm_recip.at(rowNum2)
+        : 1.0 / sqrt(ML::SIMD::vec_dotprod_dp(coords2, coords2, numDims));
+
+    if (!isfinite(recip1) && !isfinite(recip2))
+        return 0.0;
+    if (!isfinite(recip1) || !isfinite(recip2))
+        return 1.0;
+
+    double dotprod = ML::SIMD::vec_dotprod_dp(coords1, coords2, numDims);
+
+    float result = 1.0 - dotprod * recip1 * recip2;
+    if (result < 0.0)
+        result = 0.0;
+
+    ExcAssert(isfinite(result));
+    ExcAssertGreaterEqual(result, 0.0);
+
+    return result;
+}
+
+void
+CosineDistanceMetric::
+distMany(const ML::distribution<float> & coords,
+         const int * rowNums,
+         const float * const * rowCoords,
+         size_t numRows,
+         float * out) const
+{
+    // A non-finite reciprocal marks a zero magnitude query, matching
+    // the convention of addRow()
+    double queryRecip = 1.0 / coords.two_norm();
+
+    std::vector<double> dotprods(numRows);
+    ML::SIMD::vec_dotprod_dp_many(coords.data(), rowCoords, numRows,
+                                  coords.size(), dotprods.data());
+
+    for (size_t i = 0;  i < numRows;  ++i) {
+        double rowRecip = two_norm_recip.at(rowNums[i]);
+
+        // Zero magnitude handling matches dist()
+        if (!isfinite(queryRecip) && !isfinite(rowRecip)) {
+            out[i] = 0.0;
+            continue;
+        }
+        if (!isfinite(queryRecip) || !isfinite(rowRecip)) {
+            out[i] = 1.0;
+            continue;
+        }
+
+        float result = 1.0 - dotprods[i] * queryRecip * rowRecip;
+        if (result < 0.0)
+            result = 0.0;
+
+        ExcAssert(isfinite(result));
+        out[i] = result;
+    }
+}
+
 
 } // namespace Datacratic
 } // namespace MLDB
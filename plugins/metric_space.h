@@ -11,6 +11,7 @@
 
 #include "mldb/types/value_description_fwd.h"
 #include "mldb/jml/stats/distribution.h"
+#include <cstdint>
 
 namespace Datacratic {
 namespace MLDB {
@@ -44,6 +45,44 @@ struct DistanceMetric {
                        const ML::distribution<float> & coords1,
                        const ML::distribution<float> & coords2) const = 0;
 
+    /** Calculate the distance between two quantized (int8) rows.  The
+        coordinates are stored as round(value / scale) with a per-column
+        scale; scale2 gives the per-column square of that scale.  As for
+        dist(), rowNum will be -1 for a coordinate vector that doesn't
+        come from the dataset (eg, a query point), in which case no
+        cached per-row information may be used for it.
+    */
+    virtual float distQuantized(int rowNum1, int rowNum2,
+                                const int8_t * coords1,
+                                const int8_t * coords2,
+                                const float * scale2,
+                                size_t numDims) const = 0;
+
+    /** Calculate the distance between two rows stored as flat float
+        arrays, for coordinates packed into contiguous storage rather
+        than held in per-row distributions.  As for dist(), rowNum will
+        be -1 for a coordinate vector that doesn't come from the
+        dataset (eg, a query point), in which case no cached per-row
+        information may be used for it.
+    */
+    virtual float distFlat(int rowNum1, int rowNum2,
+                           const float * coords1,
+                           const float * coords2,
+                           size_t numDims) const = 0;
+
+    /** Calculate the distance from a single query vector to many rows
+        at once, writing numRows results to out.  The row numbers give
+        access to the cached per-row information, as for dist(); the
+        query point has none.  This amortizes the query vector loads
+        over the whole scan, so nearest neighbour and clustering scans
+        should prefer it to calling dist() once per pair.
+    */
+    virtual void distMany(const ML::distribution<float> & coords,
+                          const int * rowNums,
+                          const float * const * rowCoords,
+                          size_t numRows,
+                          float * out) const = 0;
+
     /** Factor for distance metric objects. */
     static DistanceMetric * create(MetricSpace space);
 };
@@ -61,6 +100,23 @@ struct EuclideanDistanceMetric: public DistanceMetric {
                const ML::distribution<float> & coords1,
                const ML::distribution<float> & coords2) const;
 
+    float distQuantized(int rowNum1, int rowNum2,
+                        const int8_t * coords1,
+                        const int8_t * coords2,
+                        const float * scale2,
+                        size_t numDims) const;
+
+    float distFlat(int rowNum1, int rowNum2,
+                   const float * coords1,
+                   const float * coords2,
+                   size_t numDims) const;
+
+    void distMany(const ML::distribution<float> & coords,
+                  const int * rowNums,
+                  const float * const * rowCoords,
+                  size_t numRows,
+                  float * out) const;
+
     /// Pre cached ||vec||^2 for each row, to allow optimization of the
     /// calculation.
     std::vector<double> sum_dist;
@@ -83,6 +139,23 @@ struct CosineDistanceMetric: public DistanceMetric {
                const ML::distribution<float> & coords1,
                const ML::distribution<float> & coords2) const;
 
+    float distQuantized(int rowNum1, int rowNum2,
+                        const int8_t * coords1,
+                        const int8_t * coords2,
+                        const float * scale2,
+                        size_t numDims) const;
+
+    float distFlat(int rowNum1, int rowNum2,
+                   const float * coords1,
+                   const float * coords2,
+                   size_t numDims) const;
+
+    void distMany(const ML::distribution<float> & coords,
+                  const int * rowNums,
+                  const float * const * rowCoords,
+                  size_t numRows,
+                  float * out) const;
+
     /// Pre-cached reciprocal of the two norm of each vector, to allow
     /// optimization of the calculation.
     std::vector<double> two_norm_recip;
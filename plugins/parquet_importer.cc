@@ -0,0 +1,287 @@
+/** parquet_importer.cc
+    Jeremy Barnes, 29 August 2016
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Importer for Apache Parquet columnar files.  Row groups are decoded
+    in parallel, each one recording into its own chunk of the output
+    dataset so that no row level parsing or synchronization is needed.
+*/
+
+#include "parquet_reader.h"
+#include "mldb/core/procedure.h"
+#include "mldb/core/dataset.h"
+#include "mldb/types/value_description.h"
+#include "mldb/types/structure_description.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/types/url.h"
+#include "mldb/vfs/filter_streams.h"
+#include "mldb/vfs/fs_utils.h"
+#include "mldb/http/http_exception.h"
+#include "mldb/base/parallel.h"
+
+#include <cstring>
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* PARQUET IMPORTER                                                          */
+/*****************************************************************************/
+
+struct ParquetImporterConfig : ProcedureConfig {
+
+    static constexpr const char * name = "experimental.import.parquet";
+
+    Url dataFileUrl;
+    PolyConfigT<Dataset> outputDataset;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(ParquetImporterConfig);
+
+DEFINE_STRUCTURE_DESCRIPTION(ParquetImporterConfig);
+
+ParquetImporterConfigDescription::
+ParquetImporterConfigDescription()
+{
+    addField("dataFileUrl", &ParquetImporterConfig::dataFileUrl,
+             "URL of the Parquet file to load");
+    addField("outputDataset", &ParquetImporterConfig::outputDataset,
+             "Configuration for output dataset",
+             PolyConfigT<Dataset>().withType("tabular"));
+
+    addParent<ProcedureConfig>();
+}
+
+namespace {
+
+/** Convert one decoded Parquet value into a CellValue, applying the
+    logical (converted) type annotation of its column.
+*/
+CellValue cellFromParquet(const Parquet::ColumnChunkValues & values,
+                          size_t valueIndex,
+                          int convertedType)
+{
+    switch (values.type) {
+    case Parquet::PT_BOOLEAN:
+        return CellValue((int64_t)values.i32.at(valueIndex));
+    case Parquet::PT_INT32: {
+        int32_t v = values.i32.at(valueIndex);
+        if (convertedType == Parquet::CT_DATE)
+            return CellValue(Date::fromSecondsSinceEpoch(v * 86400.0));
+        return CellValue((int64_t)v);
+    }
+    case Parquet::PT_INT64: {
+        int64_t v = values.i64.at(valueIndex);
+        if (convertedType == Parquet::CT_TIMESTAMP_MILLIS)
+            return CellValue(Date::fromSecondsSinceEpoch(v / 1000.0));
+        if (convertedType == Parquet::CT_TIMESTAMP_MICROS)
+            return CellValue(Date::fromSecondsSinceEpoch(v / 1000000.0));
+        if (convertedType == Parquet::CT_UINT_64)
+            return CellValue((uint64_t)v);
+        return CellValue(v);
+    }
+    case Parquet::PT_FLOAT:
+        return CellValue(values.f32.at(valueIndex));
+    case Parquet::PT_DOUBLE:
+        return CellValue(values.f64.at(valueIndex));
+    case Parquet::PT_INT96: {
+        // Legacy Impala timestamps: nanoseconds within the day followed
+        // by a Julian day number, both little-endian
+        const std::string & v = values.bytes.at(valueIndex);
+        int64_t nanos;
+        int32_t julianDay;
+        std::memcpy(&nanos, v.data(), 8);
+        std::memcpy(&julianDay, v.data() + 8, 4);
+        int64_t unixDays = (int64_t)julianDay - 2440588;
+        return CellValue(Date::fromSecondsSinceEpoch
+                         (unixDays * 86400.0 + nanos / 1e9));
+    }
+    case Parquet::PT_BYTE_ARRAY: {
+        const std::string & v = values.bytes.at(valueIndex);
+        if (convertedType == Parquet::CT_UTF8
+            || convertedType == Parquet::CT_JSON
+            || convertedType == Parquet::CT_ENUM)
+            return CellValue(v.data(), v.length());
+        return CellValue::blob(v.data(), v.length());
+    }
+    case Parquet::PT_FIXED_LEN_BYTE_ARRAY: {
+        const std::string & v = values.bytes.at(valueIndex);
+        return CellValue::blob(v.data(), v.length());
+    }
+    default:
+        throw HttpReturnException
+            (400, "Parquet file corrupted: unknown physical type "
+             + std::to_string(values.type));
+    }
+}
+
+} // file scope
+
+struct ParquetImporter: public Procedure {
+
+    ParquetImporter(MldbServer * owner,
+                    PolyConfig config_,
+                    const std::function<bool (const Json::Value &)> & onProgress)
+        : Procedure(owner)
+    {
+        config = config_.params.convert<ParquetImporterConfig>();
+    }
+
+    ParquetImporterConfig config;
+
+    virtual RunOutput run(const ProcedureRunConfig & run,
+                          const std::function<bool (const Json::Value &)> & onProgress) const
+    {
+        auto runProcConf = applyRunConfOverProcConf(config, run);
+
+        std::string filename = runProcConf.dataFileUrl.toString();
+
+        // Parquet needs random access (the metadata is a footer), so we
+        // map or slurp the whole file rather than streaming it
+        filter_istream stream(filename, { { "mapped", "true" } });
+
+        Date timestamp = stream.info().lastModified;
+
+        const char * data;
+        size_t dataLength;
+        std::string contents;
+        std::tie(data, dataLength) = stream.mapped();
+        if (!data) {
+            contents = stream.readAll();
+            data = contents.data();
+            dataLength = contents.size();
+        }
+
+        auto meta = Parquet::parseParquetFileMetadata(data, dataLength);
+
+        // Check that the schema is flat: a root whose children are all
+        // primitive columns
+        if (meta.schema.empty())
+            throw HttpReturnException(400, "Parquet file has no schema",
+                                      "dataFileUrl", runProcConf.dataFileUrl);
+        if (meta.schema.size() != (size_t)meta.schema[0].numChildren + 1)
+            throw HttpReturnException
+                (400, "Parquet import doesn't support nested schemas",
+                 "dataFileUrl", runProcConf.dataFileUrl);
+
+        std::vector<ColumnName> columnNames;
+        for (size_t i = 1;  i < meta.schema.size();  ++i) {
+            const auto & element = meta.schema[i];
+            if (element.numChildren != 0 || element.type < 0
+                || element.repetitionType == Parquet::FRT_REPEATED)
+                throw HttpReturnException
+                    (400, "Parquet import doesn't support nested or "
+                     "repeated columns",
+                     "column", element.name,
+                     "dataFileUrl", runProcConf.dataFileUrl);
+            columnNames.emplace_back(Utf8String(element.name));
+        }
+
+        // Create the output dataset
+        std::shared_ptr<Dataset> outputDataset;
+
+        if (!runProcConf.outputDataset.type.empty()
+            || !runProcConf.outputDataset.id.empty()) {
+            outputDataset
+                = createDataset(server, runProcConf.outputDataset,
+                                nullptr, true);
+        }
+
+        if (!outputDataset) {
+            throw ML::Exception("Unable to obtain output dataset");
+        }
+
+        // First row number of each row group, so that row names don't
+        // depend on the order the groups are decoded in
+        std::vector<int64_t> rowGroupStart;
+        rowGroupStart.reserve(meta.rowGroups.size());
+        int64_t totalRows = 0;
+        for (const auto & group: meta.rowGroups) {
+            rowGroupStart.push_back(totalRows);
+            totalRows += group.numRows;
+        }
+
+        Dataset::MultiChunkRecorder recorder
+            = outputDataset->getChunkRecorder();
+
+        auto doRowGroup = [&] (size_t groupIndex)
+            {
+                const auto & group = meta.rowGroups[groupIndex];
+
+                if (group.columns.size() != columnNames.size())
+                    throw HttpReturnException
+                        (400, "Parquet file corrupted: row group doesn't "
+                         "have one chunk per column",
+                         "dataFileUrl", runProcConf.dataFileUrl);
+
+                // Decode the whole row group column by column
+                std::vector<Parquet::ColumnChunkValues> columns;
+                columns.reserve(columnNames.size());
+                for (size_t i = 0;  i < group.columns.size();  ++i) {
+                    columns.emplace_back
+                        (Parquet::decodeColumnChunk(data, dataLength,
+                                                    group.columns[i],
+                                                    meta.schema[i + 1]));
+                    if ((int64_t)columns.back().numRows() != group.numRows)
+                        throw HttpReturnException
+                            (400, "Parquet file corrupted: column chunk row "
+                             "count doesn't match its row group",
+                             "column", columnNames[i],
+                             "dataFileUrl", runProcConf.dataFileUrl);
+                }
+
+                // ... then turn it back into rows, recording them into
+                // this row group's own chunk of the dataset
+                auto chunkRecorder = recorder.newChunk(groupIndex);
+                auto specializedRecorder
+                    = chunkRecorder->specializeRecordTabular(columnNames);
+
+                std::vector<size_t> valueIndexes(columnNames.size(), 0);
+                std::vector<CellValue> values(columnNames.size());
+
+                for (int64_t row = 0;  row < group.numRows;  ++row) {
+                    for (size_t i = 0;  i < columns.size();  ++i) {
+                        if (columns[i].notNull[row])
+                            values[i] = cellFromParquet
+                                (columns[i], valueIndexes[i]++,
+                                 meta.schema[i + 1].convertedType);
+                        else values[i] = CellValue();
+                    }
+                    specializedRecorder
+                        (RowName(rowGroupStart[groupIndex] + row + 1),
+                         timestamp, values.data(), values.size(), {});
+                }
+
+                chunkRecorder->finishedChunk();
+            };
+
+        parallelMap(0, meta.rowGroups.size(), doRowGroup);
+
+        recorder.commit();
+
+        Json::Value result;
+        result["rowCount"] = totalRows;
+        result["numRowGroups"] = (int64_t)meta.rowGroups.size();
+        return RunOutput(result);
+    }
+
+    virtual Any getStatus() const
+    {
+        return Any();
+    }
+};
+
+static RegisterProcedureType<ParquetImporter, ParquetImporterConfig>
+regParquet(builtinPackage(),
+           "Import an Apache Parquet file into MLDB",
+           "procedures/ParquetImporter.md.html",
+           nullptr /* static route */,
+           { MldbEntity::INTERNAL_ENTITY });
+
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -0,0 +1,928 @@
+/** parquet_reader.cc
+    Jeremy Barnes, 29 August 2016
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Minimal reader for the Apache Parquet columnar file format.
+*/
+
+#include "parquet_reader.h"
+#include "mldb/http/http_exception.h"
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/array.hpp>
+
+#include <zstd.h>
+
+#include <cstring>
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+namespace Parquet {
+
+namespace {
+
+/*****************************************************************************/
+/* BYTE READER                                                               */
+/*****************************************************************************/
+
+/** Bounds checked cursor over a memory range.  All decoding goes through
+    this so that a truncated or corrupted file gives an error instead of
+    reading off the end of the buffer.
+*/
+struct ByteReader {
+    ByteReader(const char * data, size_t length)
+        : data(data), length(length), pos(0)
+    {
+    }
+
+    const char * data;
+    size_t length;
+    size_t pos;
+
+    size_t remaining() const { return length - pos; }
+
+    const char * require(size_t numBytes)
+    {
+        if (numBytes > length - pos)
+            throw HttpReturnException
+                (400, "Parquet file corrupted: read past the end of a buffer");
+        const char * result = data + pos;
+        pos += numBytes;
+        return result;
+    }
+
+    uint8_t readByte()
+    {
+        return *(const uint8_t *)require(1);
+    }
+
+    uint32_t readU32()
+    {
+        uint32_t result;
+        std::memcpy(&result, require(4), 4);
+        return result;  // Parquet is little-endian, as are we
+    }
+
+    /** Unsigned LEB128 varint, as used by both Thrift compact and the
+        Parquet page encodings. */
+    uint64_t readVarint()
+    {
+        uint64_t result = 0;
+        for (int shift = 0;  shift < 64;  shift += 7) {
+            uint8_t b = readByte();
+            result |= uint64_t(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return result;
+        }
+        throw HttpReturnException
+            (400, "Parquet file corrupted: varint too long");
+    }
+};
+
+
+/*****************************************************************************/
+/* THRIFT COMPACT PROTOCOL                                                   */
+/*****************************************************************************/
+
+/* The Parquet footer and page headers are Thrift structures serialized
+   with the compact protocol.  We only ever read them, and only the
+   handful of structures Parquet uses, so a small hand rolled reader is
+   much simpler than depending on a Thrift runtime. */
+
+enum ThriftCompactType {
+    TCT_STOP = 0,
+    TCT_BOOL_TRUE = 1,
+    TCT_BOOL_FALSE = 2,
+    TCT_BYTE = 3,
+    TCT_I16 = 4,
+    TCT_I32 = 5,
+    TCT_I64 = 6,
+    TCT_DOUBLE = 7,
+    TCT_BINARY = 8,
+    TCT_LIST = 9,
+    TCT_SET = 10,
+    TCT_MAP = 11,
+    TCT_STRUCT = 12
+};
+
+struct ThriftReader {
+    ThriftReader(ByteReader & in)
+        : in(in)
+    {
+    }
+
+    ByteReader & in;
+
+    int64_t readZigzag()
+    {
+        uint64_t v = in.readVarint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+
+    std::string readBinary()
+    {
+        uint64_t len = in.readVarint();
+        const char * p = in.require(len);
+        return std::string(p, p + len);
+    }
+
+    /** Read the next field header of a struct.  Returns false at the
+        STOP field.  lastFieldId carries the state for the short form
+        delta encoding of field ids. */
+    bool readFieldHeader(int & fieldId, int & type, int & lastFieldId)
+    {
+        uint8_t b = in.readByte();
+        if (b == TCT_STOP)
+            return false;
+        type = b & 0x0f;
+        int delta = b >> 4;
+        if (delta == 0)
+            fieldId = readZigzag();
+        else fieldId = lastFieldId + delta;
+        lastFieldId = fieldId;
+        return true;
+    }
+
+    void readListHeader(int & elemType, uint64_t & size)
+    {
+        uint8_t b = in.readByte();
+        elemType = b & 0x0f;
+        size = b >> 4;
+        if (size == 15)
+            size = in.readVarint();
+    }
+
+    /** Skip over a value of the given compact type, recursively for
+        containers.  Used for the many fields (statistics, key/value
+        metadata, ...) that we don't need. */
+    void skip(int type)
+    {
+        switch (type) {
+        case TCT_BOOL_TRUE:
+        case TCT_BOOL_FALSE:
+            return;
+        case TCT_BYTE:
+            in.readByte();
+            return;
+        case TCT_I16:
+        case TCT_I32:
+        case TCT_I64:
+            in.readVarint();
+            return;
+        case TCT_DOUBLE:
+            in.require(8);
+            return;
+        case TCT_BINARY:
+            in.require(in.readVarint());
+            return;
+        case TCT_LIST:
+        case TCT_SET: {
+            int elemType;
+            uint64_t size;
+            readListHeader(elemType, size);
+            for (uint64_t i = 0;  i < size;  ++i)
+                skip(elemType);
+            return;
+        }
+        case TCT_MAP: {
+            uint64_t size = in.readVarint();
+            if (size > 0) {
+                uint8_t kv = in.readByte();
+                for (uint64_t i = 0;  i < size;  ++i) {
+                    skip(kv >> 4);
+                    skip(kv & 0x0f);
+                }
+            }
+            return;
+        }
+        case TCT_STRUCT: {
+            int fieldId, fieldType, lastFieldId = 0;
+            while (readFieldHeader(fieldId, fieldType, lastFieldId))
+                skip(fieldType);
+            return;
+        }
+        default:
+            throw HttpReturnException
+                (400, "Parquet file corrupted: unknown Thrift compact type "
+                 + std::to_string(type));
+        }
+    }
+};
+
+
+/*****************************************************************************/
+/* METADATA STRUCTURES                                                       */
+/*****************************************************************************/
+
+SchemaElement parseSchemaElement(ThriftReader & tr)
+{
+    SchemaElement result;
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:  result.type = tr.readZigzag();  break;
+        case 2:  result.typeLength = tr.readZigzag();  break;
+        case 3:  result.repetitionType = tr.readZigzag();  break;
+        case 4:  result.name = tr.readBinary();  break;
+        case 5:  result.numChildren = tr.readZigzag();  break;
+        case 6:  result.convertedType = tr.readZigzag();  break;
+        default: tr.skip(type);
+        }
+    }
+    return result;
+}
+
+ColumnChunkMeta parseColumnMetaData(ThriftReader & tr)
+{
+    ColumnChunkMeta result;
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:  result.type = tr.readZigzag();  break;
+        case 2: {
+            int elemType;
+            uint64_t size;
+            tr.readListHeader(elemType, size);
+            for (uint64_t i = 0;  i < size;  ++i)
+                result.encodings.push_back(tr.readZigzag());
+            break;
+        }
+        case 3: {
+            int elemType;
+            uint64_t size;
+            tr.readListHeader(elemType, size);
+            for (uint64_t i = 0;  i < size;  ++i)
+                result.pathInSchema.push_back(tr.readBinary());
+            break;
+        }
+        case 4:  result.codec = tr.readZigzag();  break;
+        case 5:  result.numValues = tr.readZigzag();  break;
+        case 6:  result.totalUncompressedSize = tr.readZigzag();  break;
+        case 7:  result.totalCompressedSize = tr.readZigzag();  break;
+        case 9:  result.dataPageOffset = tr.readZigzag();  break;
+        case 11: result.dictionaryPageOffset = tr.readZigzag();  break;
+        default: tr.skip(type);
+        }
+    }
+    return result;
+}
+
+ColumnChunkMeta parseColumnChunk(ThriftReader & tr)
+{
+    ColumnChunkMeta result;
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:
+            if (!tr.readBinary().empty())
+                throw HttpReturnException
+                    (400, "Parquet import doesn't support column chunks "
+                     "stored in external files");
+            break;
+        case 3:  result = parseColumnMetaData(tr);  break;
+        default: tr.skip(type);
+        }
+    }
+    return result;
+}
+
+RowGroupMeta parseRowGroup(ThriftReader & tr)
+{
+    RowGroupMeta result;
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1: {
+            int elemType;
+            uint64_t size;
+            tr.readListHeader(elemType, size);
+            for (uint64_t i = 0;  i < size;  ++i)
+                result.columns.push_back(parseColumnChunk(tr));
+            break;
+        }
+        case 2:  result.totalByteSize = tr.readZigzag();  break;
+        case 3:  result.numRows = tr.readZigzag();  break;
+        default: tr.skip(type);
+        }
+    }
+    return result;
+}
+
+FileMeta parseFileMeta(ThriftReader & tr)
+{
+    FileMeta result;
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:  result.version = tr.readZigzag();  break;
+        case 2: {
+            int elemType;
+            uint64_t size;
+            tr.readListHeader(elemType, size);
+            for (uint64_t i = 0;  i < size;  ++i)
+                result.schema.push_back(parseSchemaElement(tr));
+            break;
+        }
+        case 3:  result.numRows = tr.readZigzag();  break;
+        case 4: {
+            int elemType;
+            uint64_t size;
+            tr.readListHeader(elemType, size);
+            for (uint64_t i = 0;  i < size;  ++i)
+                result.rowGroups.push_back(parseRowGroup(tr));
+            break;
+        }
+        default: tr.skip(type);
+        }
+    }
+    return result;
+}
+
+
+/*****************************************************************************/
+/* PAGE HEADERS                                                              */
+/*****************************************************************************/
+
+enum PageType {
+    PAGE_DATA = 0,
+    PAGE_INDEX = 1,
+    PAGE_DICTIONARY = 2,
+    PAGE_DATA_V2 = 3
+};
+
+struct PageHeader {
+    int type = -1;
+    int32_t uncompressedPageSize = 0;
+    int32_t compressedPageSize = 0;
+
+    // data page v1
+    int32_t numValues = 0;
+    int encoding = ENC_PLAIN;
+    int definitionLevelEncoding = ENC_RLE;
+
+    // data page v2 only
+    int32_t numNulls = 0;
+    int32_t definitionLevelsByteLength = 0;
+    int32_t repetitionLevelsByteLength = 0;
+    bool isCompressed = true;
+};
+
+void parseDataPageHeader(ThriftReader & tr, PageHeader & header)
+{
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:  header.numValues = tr.readZigzag();  break;
+        case 2:  header.encoding = tr.readZigzag();  break;
+        case 3:  header.definitionLevelEncoding = tr.readZigzag();  break;
+        default: tr.skip(type);
+        }
+    }
+}
+
+void parseDictionaryPageHeader(ThriftReader & tr, PageHeader & header)
+{
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:  header.numValues = tr.readZigzag();  break;
+        case 2:  header.encoding = tr.readZigzag();  break;
+        default: tr.skip(type);
+        }
+    }
+}
+
+void parseDataPageHeaderV2(ThriftReader & tr, PageHeader & header)
+{
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:  header.numValues = tr.readZigzag();  break;
+        case 2:  header.numNulls = tr.readZigzag();  break;
+        case 4:  header.encoding = tr.readZigzag();  break;
+        case 5:  header.definitionLevelsByteLength = tr.readZigzag();  break;
+        case 6:  header.repetitionLevelsByteLength = tr.readZigzag();  break;
+        case 7:  header.isCompressed = (type == TCT_BOOL_TRUE);  break;
+        default: tr.skip(type);
+        }
+    }
+}
+
+PageHeader parsePageHeader(ThriftReader & tr)
+{
+    PageHeader result;
+    int fieldId, type, lastFieldId = 0;
+    while (tr.readFieldHeader(fieldId, type, lastFieldId)) {
+        switch (fieldId) {
+        case 1:  result.type = tr.readZigzag();  break;
+        case 2:  result.uncompressedPageSize = tr.readZigzag();  break;
+        case 3:  result.compressedPageSize = tr.readZigzag();  break;
+        case 5:  parseDataPageHeader(tr, result);  break;
+        case 7:  parseDictionaryPageHeader(tr, result);  break;
+        case 8:  parseDataPageHeaderV2(tr, result);  break;
+        default: tr.skip(type);
+        }
+    }
+    return result;
+}
+
+
+/*****************************************************************************/
+/* DECOMPRESSION                                                             */
+/*****************************************************************************/
+
+/** Decompress a raw Snappy block (the framing-free format Parquet uses).
+    Small enough that it's not worth vendoring the library for. */
+void snappyDecompress(const char * src, size_t srcLength,
+                      char * dst, size_t dstLength)
+{
+    ByteReader in(src, srcLength);
+    if (in.readVarint() != dstLength)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: Snappy page has the wrong "
+             "uncompressed length");
+    size_t outPos = 0;
+    while (in.remaining() > 0) {
+        uint8_t tag = in.readByte();
+        size_t len;
+        size_t offset = 0;
+        switch (tag & 3) {
+        case 0:  // literal
+            len = (tag >> 2) + 1;
+            if (len > 60) {
+                size_t numLenBytes = len - 60;
+                len = 0;
+                for (size_t i = 0;  i < numLenBytes;  ++i)
+                    len |= size_t(in.readByte()) << (8 * i);
+                len += 1;
+            }
+            if (len > dstLength - outPos)
+                throw HttpReturnException
+                    (400, "Parquet file corrupted: Snappy literal overruns "
+                     "the output");
+            std::memcpy(dst + outPos, in.require(len), len);
+            outPos += len;
+            continue;
+        case 1:  // copy with a 1 byte offset
+            len = ((tag >> 2) & 7) + 4;
+            offset = (size_t(tag >> 5) << 8) | in.readByte();
+            break;
+        case 2:  // copy with a 2 byte offset
+            len = (tag >> 2) + 1;
+            offset = in.readByte();
+            offset |= size_t(in.readByte()) << 8;
+            break;
+        case 3:  // copy with a 4 byte offset
+            len = (tag >> 2) + 1;
+            offset = in.readU32();
+            break;
+        }
+        if (offset == 0 || offset > outPos || len > dstLength - outPos)
+            throw HttpReturnException
+                (400, "Parquet file corrupted: invalid Snappy copy");
+        // Copies may overlap themselves (offset < len), so byte by byte
+        for (size_t i = 0;  i < len;  ++i, ++outPos)
+            dst[outPos] = dst[outPos - offset];
+    }
+    if (outPos != dstLength)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: Snappy page decompressed short");
+}
+
+void gzipDecompress(const char * src, size_t srcLength,
+                    char * dst, size_t dstLength)
+{
+    boost::iostreams::filtering_istream in;
+    in.push(boost::iostreams::gzip_decompressor());
+    in.push(boost::iostreams::array_source(src, srcLength));
+    in.read(dst, dstLength);
+    if (in.gcount() != (std::streamsize)dstLength)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: gzip page decompressed short");
+}
+
+void zstdDecompress(const char * src, size_t srcLength,
+                    char * dst, size_t dstLength)
+{
+    size_t res = ZSTD_decompress(dst, dstLength, src, srcLength);
+    if (ZSTD_isError(res))
+        throw HttpReturnException
+            (400, string("Parquet file corrupted: zstd page: ")
+             + ZSTD_getErrorName(res));
+    if (res != dstLength)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: zstd page decompressed short");
+}
+
+/** Decompress a page into newly allocated storage, or return the input
+    range directly when the codec is UNCOMPRESSED (storage stays empty).
+*/
+std::pair<const char *, size_t>
+decompressPage(int codec, const char * src, size_t srcLength,
+               size_t uncompressedLength, std::vector<char> & storage)
+{
+    if (codec == CODEC_UNCOMPRESSED) {
+        if (srcLength != uncompressedLength)
+            throw HttpReturnException
+                (400, "Parquet file corrupted: inconsistent uncompressed "
+                 "page sizes");
+        return { src, srcLength };
+    }
+    storage.resize(uncompressedLength);
+    switch (codec) {
+    case CODEC_SNAPPY:
+        snappyDecompress(src, srcLength, storage.data(), uncompressedLength);
+        break;
+    case CODEC_GZIP:
+        gzipDecompress(src, srcLength, storage.data(), uncompressedLength);
+        break;
+    case CODEC_ZSTD:
+        zstdDecompress(src, srcLength, storage.data(), uncompressedLength);
+        break;
+    default:
+        throw HttpReturnException
+            (400, "Parquet import doesn't support compression codec "
+             + std::to_string(codec)
+             + "; supported codecs are uncompressed, snappy, gzip and zstd");
+    }
+    return { storage.data(), uncompressedLength };
+}
+
+
+/*****************************************************************************/
+/* VALUE DECODING                                                            */
+/*****************************************************************************/
+
+/** Decode the RLE / bit-packed hybrid encoding used for definition
+    levels and dictionary indices.  Values are appended to out until
+    numValues have been produced or the input is exhausted.
+*/
+void decodeRleBitPacked(ByteReader & in, int bitWidth, size_t numValues,
+                        std::vector<uint32_t> & out)
+{
+    out.reserve(out.size() + numValues);
+    if (bitWidth == 0) {
+        out.resize(out.size() + numValues, 0);
+        return;
+    }
+    size_t byteWidth = (bitWidth + 7) / 8;
+    while (out.size() < numValues && in.remaining() > 0) {
+        uint64_t header = in.readVarint();
+        if ((header & 1) == 0) {
+            // RLE run: a repeated value
+            uint64_t runLength = header >> 1;
+            uint32_t value = 0;
+            const char * p = in.require(byteWidth);
+            std::memcpy(&value, p, byteWidth);
+            if (runLength > numValues - out.size())
+                runLength = numValues - out.size();
+            out.resize(out.size() + runLength, value);
+        }
+        else {
+            // Bit-packed run: groups of 8 values, LSB first
+            uint64_t numGroups = header >> 1;
+            const uint8_t * p
+                = (const uint8_t *)in.require(numGroups * bitWidth);
+            size_t bitPos = 0;
+            for (uint64_t i = 0;
+                 i < numGroups * 8 && out.size() < numValues;
+                 ++i, bitPos += bitWidth) {
+                uint64_t word = 0;
+                std::memcpy(&word, p + bitPos / 8,
+                            std::min<size_t>(8, numGroups * bitWidth
+                                             - bitPos / 8));
+                out.push_back((word >> (bitPos % 8))
+                              & ((1ULL << bitWidth) - 1));
+            }
+        }
+    }
+    if (out.size() < numValues)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: RLE run ended early");
+}
+
+/** Decode numValues PLAIN encoded values of the given physical type,
+    appending them to the arrays of out. */
+void decodePlain(ByteReader & in, int type, int typeLength,
+                 size_t numValues, ColumnChunkValues & out)
+{
+    switch (type) {
+    case PT_BOOLEAN: {
+        // Bit packed, LSB first
+        const uint8_t * p = (const uint8_t *)in.require((numValues + 7) / 8);
+        for (size_t i = 0;  i < numValues;  ++i)
+            out.i32.push_back((p[i / 8] >> (i % 8)) & 1);
+        break;
+    }
+    case PT_INT32: {
+        const char * p = in.require(numValues * 4);
+        size_t pos = out.i32.size();
+        out.i32.resize(pos + numValues);
+        std::memcpy(out.i32.data() + pos, p, numValues * 4);
+        break;
+    }
+    case PT_INT64: {
+        const char * p = in.require(numValues * 8);
+        size_t pos = out.i64.size();
+        out.i64.resize(pos + numValues);
+        std::memcpy(out.i64.data() + pos, p, numValues * 8);
+        break;
+    }
+    case PT_FLOAT: {
+        const char * p = in.require(numValues * 4);
+        size_t pos = out.f32.size();
+        out.f32.resize(pos + numValues);
+        std::memcpy(out.f32.data() + pos, p, numValues * 4);
+        break;
+    }
+    case PT_DOUBLE: {
+        const char * p = in.require(numValues * 8);
+        size_t pos = out.f64.size();
+        out.f64.resize(pos + numValues);
+        std::memcpy(out.f64.data() + pos, p, numValues * 8);
+        break;
+    }
+    case PT_BYTE_ARRAY: {
+        for (size_t i = 0;  i < numValues;  ++i) {
+            uint32_t len = in.readU32();
+            const char * p = in.require(len);
+            out.bytes.emplace_back(p, p + len);
+        }
+        break;
+    }
+    case PT_INT96: {
+        for (size_t i = 0;  i < numValues;  ++i) {
+            const char * p = in.require(12);
+            out.bytes.emplace_back(p, p + 12);
+        }
+        break;
+    }
+    case PT_FIXED_LEN_BYTE_ARRAY: {
+        if (typeLength <= 0)
+            throw HttpReturnException
+                (400, "Parquet file corrupted: fixed length byte array "
+                 "with no length");
+        for (size_t i = 0;  i < numValues;  ++i) {
+            const char * p = in.require(typeLength);
+            out.bytes.emplace_back(p, p + typeLength);
+        }
+        break;
+    }
+    default:
+        throw HttpReturnException
+            (400, "Parquet file corrupted: unknown physical type "
+             + std::to_string(type));
+    }
+}
+
+/** Append dictionary entries selected by indices to the arrays of out. */
+void appendFromDictionary(const ColumnChunkValues & dictionary,
+                          const std::vector<uint32_t> & indices,
+                          int type, ColumnChunkValues & out)
+{
+    auto checkIndex = [&] (uint32_t index, size_t dictSize) {
+        if (index >= dictSize)
+            throw HttpReturnException
+                (400, "Parquet file corrupted: dictionary index out of "
+                 "range");
+    };
+    switch (type) {
+    case PT_BOOLEAN:
+    case PT_INT32:
+        for (auto index: indices) {
+            checkIndex(index, dictionary.i32.size());
+            out.i32.push_back(dictionary.i32[index]);
+        }
+        break;
+    case PT_INT64:
+        for (auto index: indices) {
+            checkIndex(index, dictionary.i64.size());
+            out.i64.push_back(dictionary.i64[index]);
+        }
+        break;
+    case PT_FLOAT:
+        for (auto index: indices) {
+            checkIndex(index, dictionary.f32.size());
+            out.f32.push_back(dictionary.f32[index]);
+        }
+        break;
+    case PT_DOUBLE:
+        for (auto index: indices) {
+            checkIndex(index, dictionary.f64.size());
+            out.f64.push_back(dictionary.f64[index]);
+        }
+        break;
+    default:
+        for (auto index: indices) {
+            checkIndex(index, dictionary.bytes.size());
+            out.bytes.push_back(dictionary.bytes[index]);
+        }
+    }
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* PUBLIC INTERFACE                                                          */
+/*****************************************************************************/
+
+FileMeta parseParquetFileMetadata(const char * data, size_t length)
+{
+    static constexpr const char * MAGIC = "PAR1";
+
+    if (length < 12
+        || std::memcmp(data, MAGIC, 4) != 0
+        || std::memcmp(data + length - 4, MAGIC, 4) != 0)
+        throw HttpReturnException
+            (400, "File is not a Parquet file (magic number not found)");
+
+    uint32_t metadataLength;
+    std::memcpy(&metadataLength, data + length - 8, 4);
+    if (metadataLength > length - 12)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: footer metadata overruns the "
+             "file");
+
+    ByteReader in(data + length - 8 - metadataLength, metadataLength);
+    ThriftReader tr(in);
+    return parseFileMeta(tr);
+}
+
+ColumnChunkValues
+decodeColumnChunk(const char * fileData, size_t fileLength,
+                  const ColumnChunkMeta & chunk,
+                  const SchemaElement & element)
+{
+    if (element.repetitionType == FRT_REPEATED)
+        throw HttpReturnException
+            (400, "Parquet import doesn't support nested (repeated) "
+             "columns (column " + element.name + ")");
+
+    int maxDefinitionLevel
+        = element.repetitionType == FRT_OPTIONAL ? 1 : 0;
+
+    ColumnChunkValues result;
+    result.type = chunk.type;
+    result.notNull.reserve(chunk.numValues);
+
+    ColumnChunkValues dictionary;
+    dictionary.type = chunk.type;
+    bool hasDictionary = false;
+
+    // The dictionary page, when present, precedes the first data page
+    int64_t startOffset = chunk.dataPageOffset;
+    if (chunk.dictionaryPageOffset > 0
+        && chunk.dictionaryPageOffset < startOffset)
+        startOffset = chunk.dictionaryPageOffset;
+
+    if (startOffset < 0 || (uint64_t)startOffset > fileLength)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: column chunk outside the file");
+
+    ByteReader pages(fileData + startOffset, fileLength - startOffset);
+
+    while ((int64_t)result.notNull.size() < chunk.numValues) {
+        ThriftReader tr(pages);
+        PageHeader header = parsePageHeader(tr);
+        const char * pageData = pages.require(header.compressedPageSize);
+
+        if (header.type == PAGE_INDEX)
+            continue;
+
+        if (header.type == PAGE_DICTIONARY) {
+            if (header.encoding != ENC_PLAIN
+                && header.encoding != ENC_PLAIN_DICTIONARY)
+                throw HttpReturnException
+                    (400, "Parquet import doesn't support dictionary pages "
+                     "with encoding " + std::to_string(header.encoding)
+                     + " (column " + element.name + ")");
+            std::vector<char> storage;
+            auto page = decompressPage(chunk.codec, pageData,
+                                       header.compressedPageSize,
+                                       header.uncompressedPageSize, storage);
+            ByteReader values(page.first, page.second);
+            decodePlain(values, chunk.type, element.typeLength,
+                        header.numValues, dictionary);
+            hasDictionary = true;
+            continue;
+        }
+
+        if (header.type != PAGE_DATA && header.type != PAGE_DATA_V2)
+            throw HttpReturnException
+                (400, "Parquet file corrupted: unknown page type "
+                 + std::to_string(header.type));
+
+        // Definition levels tell us which of the page's values are null.
+        // With a flat schema the maximum definition level is at most 1,
+        // so they double as the per row notNull flags.
+        std::vector<uint32_t> definitionLevels;
+        const char * valueData;
+        size_t valueLength;
+        std::vector<char> storage;
+
+        if (header.type == PAGE_DATA) {
+            auto page = decompressPage(chunk.codec, pageData,
+                                       header.compressedPageSize,
+                                       header.uncompressedPageSize, storage);
+            ByteReader in(page.first, page.second);
+            if (maxDefinitionLevel > 0) {
+                if (header.definitionLevelEncoding != ENC_RLE)
+                    throw HttpReturnException
+                        (400, "Parquet import doesn't support definition "
+                         "level encoding "
+                         + std::to_string(header.definitionLevelEncoding)
+                         + " (column " + element.name + ")");
+                uint32_t levelsLength = in.readU32();
+                ByteReader levels(in.require(levelsLength), levelsLength);
+                decodeRleBitPacked(levels, 1 /* bit width for max level 1 */,
+                                   header.numValues, definitionLevels);
+            }
+            valueData = in.data + in.pos;
+            valueLength = in.remaining();
+        }
+        else {  // PAGE_DATA_V2: levels are outside of the compressed region
+            if (header.repetitionLevelsByteLength != 0)
+                throw HttpReturnException
+                    (400, "Parquet import doesn't support nested (repeated) "
+                     "columns (column " + element.name + ")");
+            ByteReader in(pageData, header.compressedPageSize);
+            ByteReader levels(in.require(header.definitionLevelsByteLength),
+                              header.definitionLevelsByteLength);
+            if (maxDefinitionLevel > 0)
+                decodeRleBitPacked(levels, 1, header.numValues,
+                                   definitionLevels);
+            size_t valuesCompressed
+                = header.compressedPageSize
+                - header.definitionLevelsByteLength;
+            size_t valuesUncompressed
+                = header.uncompressedPageSize
+                - header.definitionLevelsByteLength;
+            auto page = decompressPage(header.isCompressed
+                                           ? chunk.codec : CODEC_UNCOMPRESSED,
+                                       in.data + in.pos, valuesCompressed,
+                                       valuesUncompressed, storage);
+            valueData = page.first;
+            valueLength = page.second;
+        }
+
+        size_t numNotNull = header.numValues;
+        if (maxDefinitionLevel > 0) {
+            numNotNull = 0;
+            for (auto level: definitionLevels) {
+                result.notNull.push_back(level == 1);
+                numNotNull += (level == 1);
+            }
+        }
+        else result.notNull.resize(result.notNull.size() + header.numValues,
+                                   1);
+
+        ByteReader values(valueData, valueLength);
+
+        switch (header.encoding) {
+        case ENC_PLAIN:
+            decodePlain(values, chunk.type, element.typeLength,
+                        numNotNull, result);
+            break;
+        case ENC_PLAIN_DICTIONARY:
+        case ENC_RLE_DICTIONARY: {
+            if (!hasDictionary)
+                throw HttpReturnException
+                    (400, "Parquet file corrupted: dictionary encoded page "
+                     "with no dictionary page (column " + element.name
+                     + ")");
+            int bitWidth = values.readByte();
+            if (bitWidth > 32)
+                throw HttpReturnException
+                    (400, "Parquet file corrupted: dictionary index bit "
+                     "width too large");
+            std::vector<uint32_t> indices;
+            decodeRleBitPacked(values, bitWidth, numNotNull, indices);
+            appendFromDictionary(dictionary, indices, chunk.type, result);
+            break;
+        }
+        default:
+            throw HttpReturnException
+                (400, "Parquet import doesn't support data page encoding "
+                 + std::to_string(header.encoding)
+                 + "; supported encodings are plain and dictionary (column "
+                 + element.name + ")");
+        }
+    }
+
+    if ((int64_t)result.notNull.size() != chunk.numValues)
+        throw HttpReturnException
+            (400, "Parquet file corrupted: column chunk value count "
+             "doesn't match its metadata (column " + element.name + ")");
+
+    return result;
+}
+
+
+} // namespace Parquet
+} // namespace MLDB
+} // namespace Datacratic
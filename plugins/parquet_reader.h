@@ -0,0 +1,185 @@
+/** parquet_reader.h                                               -*- C++ -*-
+    Jeremy Barnes, 29 August 2016
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Minimal reader for the Apache Parquet columnar file format, sufficient
+    for the import.parquet procedure.  It reads the Thrift compact protocol
+    footer and decodes flat (non-nested) column chunks.
+
+    Supported subset:
+    - flat schemas (every column a required or optional primitive);
+    - PLAIN, PLAIN_DICTIONARY and RLE_DICTIONARY encodings, with RLE or
+      bit-packed definition levels (data pages v1 and v2);
+    - UNCOMPRESSED, SNAPPY, GZIP and ZSTD compression codecs.
+
+    Files outside of this subset (nested schemas, delta encodings, other
+    codecs) are rejected with a clear error rather than misread.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace Datacratic {
+namespace MLDB {
+namespace Parquet {
+
+
+/*****************************************************************************/
+/* FORMAT CONSTANTS                                                          */
+/*****************************************************************************/
+
+/** Physical storage types of Parquet columns. */
+enum PhysicalType {
+    PT_BOOLEAN = 0,
+    PT_INT32 = 1,
+    PT_INT64 = 2,
+    PT_INT96 = 3,           ///< legacy 12 byte timestamps
+    PT_FLOAT = 4,
+    PT_DOUBLE = 5,
+    PT_BYTE_ARRAY = 6,
+    PT_FIXED_LEN_BYTE_ARRAY = 7
+};
+
+/** Logical (converted) types, annotating the physical type. */
+enum ConvertedType {
+    CT_NONE = -1,           ///< no annotation; use the physical type
+    CT_UTF8 = 0,
+    CT_MAP = 1,
+    CT_MAP_KEY_VALUE = 2,
+    CT_LIST = 3,
+    CT_ENUM = 4,
+    CT_DECIMAL = 5,
+    CT_DATE = 6,            ///< days since the epoch, in an INT32
+    CT_TIME_MILLIS = 7,
+    CT_TIME_MICROS = 8,
+    CT_TIMESTAMP_MILLIS = 9,
+    CT_TIMESTAMP_MICROS = 10,
+    CT_UINT_8 = 11,
+    CT_UINT_16 = 12,
+    CT_UINT_32 = 13,
+    CT_UINT_64 = 14,
+    CT_INT_8 = 15,
+    CT_INT_16 = 16,
+    CT_INT_32 = 17,
+    CT_INT_64 = 18,
+    CT_JSON = 19,
+    CT_BSON = 20,
+    CT_INTERVAL = 21
+};
+
+enum FieldRepetitionType {
+    FRT_REQUIRED = 0,
+    FRT_OPTIONAL = 1,
+    FRT_REPEATED = 2
+};
+
+enum Encoding {
+    ENC_PLAIN = 0,
+    ENC_PLAIN_DICTIONARY = 2,
+    ENC_RLE = 3,
+    ENC_BIT_PACKED = 4,
+    ENC_DELTA_BINARY_PACKED = 5,
+    ENC_DELTA_LENGTH_BYTE_ARRAY = 6,
+    ENC_DELTA_BYTE_ARRAY = 7,
+    ENC_RLE_DICTIONARY = 8
+};
+
+enum CompressionCodec {
+    CODEC_UNCOMPRESSED = 0,
+    CODEC_SNAPPY = 1,
+    CODEC_GZIP = 2,
+    CODEC_LZO = 3,
+    CODEC_BROTLI = 4,
+    CODEC_LZ4 = 5,
+    CODEC_ZSTD = 6
+};
+
+
+/*****************************************************************************/
+/* FILE METADATA                                                             */
+/*****************************************************************************/
+
+/** One element of the (flattened) file schema.  The first element is the
+    root; for the flat schemas we support, every other element is a child
+    of the root describing one column.
+*/
+struct SchemaElement {
+    int type = -1;                   ///< PhysicalType; -1 for the root
+    int typeLength = 0;              ///< for FIXED_LEN_BYTE_ARRAY
+    int repetitionType = FRT_REQUIRED;
+    std::string name;
+    int numChildren = 0;
+    int convertedType = CT_NONE;
+};
+
+/** Metadata of one column chunk (one column within one row group). */
+struct ColumnChunkMeta {
+    int type = -1;                   ///< PhysicalType
+    std::vector<int> encodings;
+    std::vector<std::string> pathInSchema;
+    int codec = CODEC_UNCOMPRESSED;
+    int64_t numValues = 0;           ///< including nulls
+    int64_t totalUncompressedSize = 0;
+    int64_t totalCompressedSize = 0;
+    int64_t dataPageOffset = 0;
+    int64_t dictionaryPageOffset = -1;  ///< -1 when there is no dictionary
+};
+
+struct RowGroupMeta {
+    std::vector<ColumnChunkMeta> columns;
+    int64_t totalByteSize = 0;
+    int64_t numRows = 0;
+};
+
+struct FileMeta {
+    int version = 0;
+    std::vector<SchemaElement> schema;
+    int64_t numRows = 0;
+    std::vector<RowGroupMeta> rowGroups;
+};
+
+/** Parse the footer metadata of a Parquet file held in memory.  Throws
+    an exception if the file is truncated, is not a Parquet file, or has
+    a malformed footer.
+*/
+FileMeta parseParquetFileMetadata(const char * data, size_t length);
+
+
+/*****************************************************************************/
+/* COLUMN CHUNK DECODING                                                     */
+/*****************************************************************************/
+
+/** Decoded contents of one column chunk.  Nullness is per row; values
+    of the non-null rows are stored in row order in the array matching
+    the physical type (BOOLEAN as 0/1 in i32; INT96 and fixed length
+    byte arrays as raw bytes in bytes).
+*/
+struct ColumnChunkValues {
+    int type = -1;                   ///< PhysicalType
+    std::vector<uint8_t> notNull;    ///< one entry per row
+    std::vector<int32_t> i32;
+    std::vector<int64_t> i64;
+    std::vector<float> f32;
+    std::vector<double> f64;
+    std::vector<std::string> bytes;
+
+    size_t numRows() const { return notNull.size(); }
+};
+
+/** Decode one column chunk from a Parquet file held in memory.  Thread
+    safe; each row group and column can be decoded independently.  Throws
+    on malformed data or on features outside of the supported subset.
+*/
+ColumnChunkValues
+decodeColumnChunk(const char * fileData, size_t fileLength,
+                  const ColumnChunkMeta & chunk,
+                  const SchemaElement & element);
+
+
+} // namespace Parquet
+} // namespace MLDB
+} // namespace Datacratic
@@ -0,0 +1,223 @@
+/** partial_aggregation.cc                                         -*- C++ -*-
+    Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Algebraic decomposition of aggregate selects into per-partition
+    partials.
+*/
+
+#include "partial_aggregation.h"
+#include "mldb/sql/sql_expression_operations.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/http/http_exception.h"
+
+using namespace std;
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* PARTIAL AGGREGATION PLAN                                                  */
+/*****************************************************************************/
+
+PartialAggregationPlan
+PartialAggregationPlan::
+decompose(const SelectExpression & select, bool grouped)
+{
+    PartialAggregationPlan plan;
+
+    std::vector<Utf8String> pushed;
+    int numAggs = 0;
+
+    for (auto & clause: select.clauses) {
+        auto named
+            = dynamic_cast<const NamedColumnExpression *>(clause.get());
+        const FunctionCallExpression * call = nullptr;
+        if (named)
+            call = dynamic_cast<const FunctionCallExpression *>
+                (named->expression.get());
+
+        if (!call || !call->isAggregator()) {
+            // Group key or plain expression: evaluated identically on
+            // every partition of a group, so push it through and keep
+            // the first value seen
+            if (!clause->findAggregators(grouped).empty())
+                throw HttpReturnException
+                    (400, "Can't decompose aggregate expression into "
+                     "partial aggregates; select the aggregates "
+                     "separately and combine them in an outer query",
+                     "clause", clause->surface);
+            pushed.emplace_back(clause->surface);
+            continue;
+        }
+
+        if (named->alias.empty())
+            throw HttpReturnException
+                (400, "Aggregates in a partially aggregated query need "
+                 "an explicit alias", "clause", clause->surface);
+
+        Utf8String fn = call->functionName.toLower();
+        Utf8String args;
+        for (auto & a: call->args) {
+            if (!args.empty())
+                args += ", ";
+            args += a->surface;
+        }
+
+        auto pushedName = [&] (const char * suffix)
+            {
+                return ColumnName("__partial" + to_string(numAggs)
+                                  + suffix);
+            };
+
+        if (fn == "count" || fn == "sum" || fn == "min" || fn == "max") {
+            ColumnName name = pushedName("");
+            pushed.emplace_back(fn + "(" + args + ") AS \""
+                                + name.toUtf8String() + "\"");
+            plan.mergeOps[name] = fn == "min" ? MERGE_MIN
+                                : fn == "max" ? MERGE_MAX
+                                : MERGE_SUM;
+            plan.renames[name] = named->alias;
+        }
+        else if (fn == "avg") {
+            AvgSpec spec{pushedName("_sum"), pushedName("_count"),
+                         named->alias};
+            pushed.emplace_back(Utf8String("sum(") + args + ") AS \""
+                                + spec.sumName.toUtf8String() + "\"");
+            pushed.emplace_back(Utf8String("count(") + args + ") AS \""
+                                + spec.countName.toUtf8String() + "\"");
+            plan.mergeOps[spec.sumName] = MERGE_SUM;
+            plan.mergeOps[spec.countName] = MERGE_SUM;
+            plan.avgSums[spec.sumName] = plan.avgs.size();
+            plan.avgCounts[spec.countName] = plan.avgs.size();
+            plan.avgs.emplace_back(std::move(spec));
+        }
+        else {
+            throw HttpReturnException
+                (400, "Aggregate '" + call->functionName + "' has no "
+                 "partial aggregate decomposition; supported are count, "
+                 "sum, min, max and avg", "clause", clause->surface);
+        }
+
+        ++numAggs;
+    }
+
+    for (auto & p: pushed) {
+        if (!plan.partialSelect.empty())
+            plan.partialSelect += ", ";
+        plan.partialSelect += p;
+    }
+
+    return plan;
+}
+
+CellValue
+PartialAggregationPlan::
+combine(MergeOp op, const CellValue & a, const CellValue & b)
+{
+    if (a.empty())
+        return b;
+    if (b.empty())
+        return a;
+
+    switch (op) {
+    case MERGE_SUM:
+        if (a.isInteger() && b.isInteger())
+            return CellValue(a.toInt() + b.toInt());
+        return CellValue(a.toDouble() + b.toDouble());
+    case MERGE_MIN:
+        return b < a ? b : a;
+    case MERGE_MAX:
+        return a < b ? b : a;
+    }
+
+    throw HttpReturnException(500, "Unknown partial aggregate merge "
+                              "operation");
+}
+
+void
+PartialAggregationPlan::
+mergeRow(MatrixNamedRow & merged, const MatrixNamedRow & partial) const
+{
+    for (auto & c: partial.columns) {
+        auto op = mergeOps.find(std::get<0>(c));
+        if (op == mergeOps.end())
+            continue;  // group key; first value kept
+
+        bool found = false;
+        for (auto & m: merged.columns) {
+            if (std::get<0>(m) != std::get<0>(c))
+                continue;
+            std::get<1>(m) = combine(op->second,
+                                     std::get<1>(m), std::get<1>(c));
+            std::get<2>(m) = std::max(std::get<2>(m), std::get<2>(c));
+            found = true;
+            break;
+        }
+        if (!found)
+            merged.columns.emplace_back(c);
+    }
+}
+
+void
+PartialAggregationPlan::
+mergeRows(std::map<RowName, MatrixNamedRow> & merged,
+          std::vector<MatrixNamedRow> rows) const
+{
+    for (auto & row: rows) {
+        auto it = merged.find(row.rowName);
+        if (it == merged.end())
+            merged.emplace(row.rowName, std::move(row));
+        else
+            mergeRow(it->second, row);
+    }
+}
+
+void
+PartialAggregationPlan::
+finishRow(MatrixNamedRow & row) const
+{
+    std::vector<std::tuple<ColumnName, CellValue, Date> > columns;
+    columns.reserve(row.columns.size());
+
+    auto findCell = [&] (const ColumnName & name) -> CellValue
+        {
+            for (auto & c: row.columns) {
+                if (std::get<0>(c) == name)
+                    return std::get<1>(c);
+            }
+            return CellValue();
+        };
+
+    for (auto & c: row.columns) {
+        const ColumnName & name = std::get<0>(c);
+
+        auto sumIt = avgSums.find(name);
+        if (sumIt != avgSums.end()) {
+            const AvgSpec & spec = avgs[sumIt->second];
+            CellValue count = findCell(spec.countName);
+            CellValue result;
+            if (!count.empty() && count.toInt() > 0
+                && !std::get<1>(c).empty())
+                result = CellValue(std::get<1>(c).toDouble()
+                                   / count.toDouble());
+            columns.emplace_back(spec.outputName, result, std::get<2>(c));
+            continue;
+        }
+        if (avgCounts.count(name))
+            continue;  // folded into the average above
+
+        auto rn = renames.find(name);
+        columns.emplace_back(rn == renames.end() ? name : rn->second,
+                             std::get<1>(c), std::get<2>(c));
+    }
+
+    row.columns = std::move(columns);
+    row.rowHash = row.rowName;
+}
+
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -0,0 +1,102 @@
+/** partial_aggregation.h                                          -*- C++ -*-
+    Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Algebraic decomposition of aggregate selects into per-partition
+    partials that can be folded together, used by the sharded dataset
+    (partials per peer) and incremental aggregation views (partials per
+    committed chunk).
+*/
+
+#pragma once
+
+#include "mldb/sql/sql_expression.h"
+#include "mldb/sql/dataset_types.h"
+#include <map>
+
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* PARTIAL AGGREGATION PLAN                                                  */
+/*****************************************************************************/
+
+/** Rewrite of an aggregate SELECT as a select to run over each
+    partition of the rows plus a rule for folding the partial results
+    back together: count and sum partials are summed, min and max are
+    compared, and avg becomes a sum and count pair that finish()
+    completes.  Group keys and other non-aggregate clauses pass through
+    unchanged and keep the first value seen, since every partition of a
+    group computes the same one.
+
+    The bound aggregators themselves merge through typed void pointers,
+    which only works when all the partials live in one process; this
+    textual form is what lets partials cross peers or be folded long
+    after the rows that produced them are gone.
+*/
+struct PartialAggregationPlan {
+
+    /// How partial values of one pushed column fold together
+    enum MergeOp {
+        MERGE_SUM,
+        MERGE_MIN,
+        MERGE_MAX
+    };
+
+    /// An avg clause, pushed as a sum and a count partial
+    struct AvgSpec {
+        ColumnName sumName;    ///< pushed partial sum column
+        ColumnName countName;  ///< pushed partial count column
+        ColumnName outputName; ///< alias in the original select
+    };
+
+    /// Select to run over each partition, with synthetic aliases for
+    /// the aggregate partials
+    Utf8String partialSelect;
+
+    std::map<ColumnName, MergeOp> mergeOps;
+    std::map<ColumnName, ColumnName> renames;  ///< partial -> output name
+    std::vector<AvgSpec> avgs;
+    std::map<ColumnName, size_t> avgSums;      ///< partial sum -> avgs index
+    std::map<ColumnName, size_t> avgCounts;    ///< partial count -> avgs index
+
+    /** Decompose the select.  Throws for aggregates with no algebraic
+        decomposition (anything but count, sum, min, max, avg), for
+        aggregates buried inside larger expressions, and for aggregates
+        without an explicit alias.
+    */
+    static PartialAggregationPlan
+    decompose(const SelectExpression & select, bool grouped);
+
+    /** Fold two partial values of one pushed column together. */
+    static CellValue
+    combine(MergeOp op, const CellValue & a, const CellValue & b);
+
+    /** Fold one partition's row into the merged row of its group.
+        Columns without a merge op are group keys and keep the value
+        already in place.
+    */
+    void mergeRow(MatrixNamedRow & merged,
+                  const MatrixNamedRow & partial) const;
+
+    /** Fold a whole partition into rows merged by row name (the row
+        name carries the group keys, so rows with the same name in two
+        partitions are partials of the same group).
+    */
+    void mergeRows(std::map<RowName, MatrixNamedRow> & merged,
+                   std::vector<MatrixNamedRow> rows) const;
+
+    /** Complete a merged row: averages are computed from their sum and
+        count partials and the synthetic aliases are renamed back to the
+        ones in the original select.  Column order follows the partial
+        select, so it matches the original clause order.
+    */
+    void finishRow(MatrixNamedRow & row) const;
+};
+
+
+} // namespace MLDB
+} // namespace Datacratic
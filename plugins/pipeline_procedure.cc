@@ -0,0 +1,288 @@
+/** pipeline_procedure.cc
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Procedure that runs a DAG of child procedures, overlapping steps
+    that don't depend on each other on separate threads.
+*/
+
+#include "pipeline_procedure.h"
+#include "mldb/server/mldb_server.h"
+#include "mldb/rest/in_process_rest_connection.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/types/optional_description.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/http/http_exception.h"
+#include "mldb/types/date.h"
+#include "jml/utils/string_functions.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* PIPELINE PROCEDURE CONFIG                                                 */
+/*****************************************************************************/
+
+DEFINE_STRUCTURE_DESCRIPTION(PipelineStepConfig);
+
+PipelineStepConfigDescription::
+PipelineStepConfigDescription()
+{
+    addField("name", &PipelineStepConfig::name,
+             "Name of the step, used in progress reports, in the run output "
+             "and as the target of dependsOn.  Defaults to step<N> where N "
+             "is the position of the step in the list.");
+    addField("procedure", &PipelineStepConfig::procedure,
+             "Configuration of the procedure that this step runs, with the "
+             "same type and params as when creating it directly.");
+    addField("dependsOn", &PipelineStepConfig::dependsOn,
+             "Names of the steps that must have finished before this one "
+             "starts.  They must appear earlier in the steps list.  If not "
+             "set, the step depends on the step immediately before it, so a "
+             "pipeline without any dependsOn runs its steps one after the "
+             "other; set it (possibly to the empty list) to let the step "
+             "overlap with others.");
+}
+
+DEFINE_STRUCTURE_DESCRIPTION(PipelineProcedureConfig);
+
+PipelineProcedureConfigDescription::
+PipelineProcedureConfigDescription()
+{
+    addField("steps", &PipelineProcedureConfig::steps,
+             "The steps of the pipeline, in order.");
+    addField("maxParallelism", &PipelineProcedureConfig::maxParallelism,
+             "Maximum number of steps run at the same time.  The default of "
+             "0 means one per CPU core.", 0);
+    addField("intermediates", &PipelineProcedureConfig::intermediates,
+             "Ids of datasets that only exist to pass data between steps.  "
+             "They are deleted once the whole pipeline has finished "
+             "successfully.");
+    addParent<ProcedureConfig>();
+}
+
+
+/*****************************************************************************/
+/* PIPELINE PROCEDURE                                                        */
+/*****************************************************************************/
+
+PipelineProcedure::
+PipelineProcedure(MldbServer * owner,
+                  PolyConfig config,
+                  const std::function<bool (const Json::Value &)> & onProgress)
+    : Procedure(owner)
+{
+    this->procConfig = config.params.convert<PipelineProcedureConfig>();
+}
+
+Any
+PipelineProcedure::
+getStatus() const
+{
+    return Any();
+}
+
+RunOutput
+PipelineProcedure::
+run(const ProcedureRunConfig & run,
+    const std::function<bool (const Json::Value &)> & onProgress) const
+{
+    auto runProcConf = applyRunConfOverProcConf(procConfig, run);
+
+    size_t numSteps = runProcConf.steps.size();
+    if (numSteps == 0)
+        throw HttpReturnException(400, "Pipeline has no steps");
+
+    // Resolve step names and dependencies into a DAG.  Dependencies may
+    // only point at earlier steps, which also guarantees there are no
+    // cycles.
+    vector<Utf8String> stepNames(numSteps);
+    std::unordered_map<Utf8String, size_t> stepNumbers;
+    vector<vector<size_t> > dependents(numSteps);
+    vector<size_t> numPending(numSteps, 0);
+
+    for (size_t i = 0;  i < numSteps;  ++i) {
+        const PipelineStepConfig & step = runProcConf.steps[i];
+        stepNames[i] = step.name.empty()
+            ? Utf8String("step" + to_string(i))
+            : step.name;
+        if (!stepNumbers.insert({ stepNames[i], i }).second)
+            throw HttpReturnException(400, "Pipeline step names must be "
+                                      "unique",
+                                      "name", stepNames[i]);
+        if (step.dependsOn) {
+            for (const Utf8String & dep: *step.dependsOn) {
+                auto it = stepNumbers.find(dep);
+                if (it == stepNumbers.end() || it->second == i)
+                    throw HttpReturnException(400, "Pipeline step depends on "
+                                              "a step that doesn't come "
+                                              "before it",
+                                              "step", stepNames[i],
+                                              "dependsOn", dep);
+                dependents[it->second].push_back(i);
+                numPending[i] += 1;
+            }
+        }
+        else if (i > 0) {
+            dependents[i - 1].push_back(i);
+            numPending[i] = 1;
+        }
+    }
+
+    // Guards the scheduling state, the results, the resource list and
+    // the onProgress callback, all shared between the worker threads
+    std::mutex lock;
+    std::condition_variable wake;
+    vector<size_t> ready;
+    size_t numFinished = 0;
+    std::exception_ptr failure;
+    vector<Json::Value> stepResults(numSteps);
+    vector<string> resourcesToDelete;
+
+    for (size_t i = 0;  i < numSteps;  ++i)
+        if (numPending[i] == 0)
+            ready.push_back(i);
+
+    auto runStep = [&] (size_t stepNumber)
+        {
+            const PipelineStepConfig & step = runProcConf.steps[stepNumber];
+            const Utf8String & stepName = stepNames[stepNumber];
+
+            auto onStepProgress = [&, stepName] (const Json::Value & details)
+                {
+                    Json::Value value;
+                    value["step"] = stepName.rawString();
+                    value["details"] = details;
+                    std::unique_lock<std::mutex> guard(lock);
+                    return onProgress(value);
+                };
+
+            PolyConfig stepPC = step.procedure;
+            if (stepPC.id.empty())
+                stepPC.id = stepName;
+
+            auto procedure
+                = createProcedure(server, stepPC, onStepProgress, true);
+            if (!procedure)
+                throw HttpReturnException(400, "Unable to create procedure "
+                                          "for pipeline step",
+                                          "step", stepName);
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                resourcesToDelete
+                    .push_back("/v1/procedures/" + stepPC.id.utf8String());
+            }
+
+            ProcedureRunConfig stepRunConf;
+            stepRunConf.id = "run";
+
+            Date stepStart = Date::now();
+            RunOutput output = procedure->run(stepRunConf, onStepProgress);
+            Date stepFinish = Date::now();
+
+            Json::Value result;
+            result["name"] = stepName.rawString();
+            result["duration"] = stepFinish.secondsSinceEpoch()
+                - stepStart.secondsSinceEpoch();
+            result["results"] = jsonEncode(output.results);
+
+            std::unique_lock<std::mutex> guard(lock);
+            stepResults[stepNumber] = std::move(result);
+        };
+
+    auto worker = [&] ()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            for (;;) {
+                while (ready.empty() && numFinished < numSteps && !failure)
+                    wake.wait(guard);
+                if (ready.empty() || failure)
+                    return;
+
+                size_t stepNumber = ready.back();
+                ready.pop_back();
+
+                guard.unlock();
+                std::exception_ptr stepFailure;
+                try {
+                    runStep(stepNumber);
+                } catch (...) {
+                    stepFailure = std::current_exception();
+                }
+                guard.lock();
+
+                if (stepFailure) {
+                    // First failure wins; the other workers drain out
+                    // without starting any further steps
+                    if (!failure)
+                        failure = stepFailure;
+                    wake.notify_all();
+                    return;
+                }
+
+                numFinished += 1;
+                for (size_t dep: dependents[stepNumber]) {
+                    if (--numPending[dep] == 0)
+                        ready.push_back(dep);
+                }
+                wake.notify_all();
+            }
+        };
+
+    size_t numWorkers = runProcConf.maxParallelism > 0
+        ? runProcConf.maxParallelism
+        : std::thread::hardware_concurrency();
+    numWorkers = std::min(numWorkers, numSteps);
+
+    vector<std::thread> workers;
+    for (size_t i = 0;  i < numWorkers;  ++i)
+        workers.emplace_back(worker);
+    for (auto & w: workers)
+        w.join();
+
+    // On failure the step procedures and intermediate datasets are left
+    // in place so that the failed step can be inspected and the pipeline
+    // re-run
+    if (failure)
+        std::rethrow_exception(failure);
+
+    for (const Utf8String & dataset: runProcConf.intermediates)
+        resourcesToDelete.push_back("/v1/datasets/" + dataset.utf8String());
+
+    InProcessRestConnection connection;
+    for (const string & resource: resourcesToDelete) {
+        RestRequest request("DELETE", resource, RestParams(), "{}");
+        server->handleRequest(connection, request);
+        if (connection.responseCode != 204) {
+            throw ML::Exception(ML::format("Unable to delete resource '%s'. "
+                        "Response code %d", resource, connection.responseCode));
+        }
+    }
+
+    Json::Value output;
+    for (auto & result: stepResults)
+        output["steps"].append(result);
+
+    return RunOutput(output);
+}
+
+
+namespace {
+
+RegisterProcedureType<PipelineProcedure, PipelineProcedureConfig>
+regPipelineProc(builtinPackage(),
+                "Run a DAG of procedures, overlapping independent steps",
+                "procedures/PipelineProcedure.md.html");
+
+} // file scope
+
+} // namespace MLDB
+} // namespace Datacratic
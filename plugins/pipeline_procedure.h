@@ -0,0 +1,88 @@
+/** pipeline_procedure.h                                           -*- C++ -*-
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Procedure that runs a DAG of child procedures, overlapping steps
+    that don't depend on each other on separate threads.
+*/
+
+#pragma once
+
+#include "types/value_description.h"
+#include "server/mldb_server.h"
+#include "mldb/core/procedure.h"
+#include "mldb/rest/poly_entity.h"
+#include "types/optional.h"
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* PIPELINE PROCEDURE CONFIG                                                 */
+/*****************************************************************************/
+
+struct PipelineStepConfig {
+    PipelineStepConfig()
+    {
+    }
+
+    /// Name of the step, used in progress reports, in the run output and
+    /// as the target of dependsOn.  Defaults to "step<N>".
+    Utf8String name;
+
+    /// Configuration of the procedure that this step runs
+    PolyConfig procedure;
+
+    /// Names of the steps that must have finished before this one starts.
+    /// They must appear earlier in the steps list.  If unset, the step
+    /// depends on the step immediately before it, which preserves the
+    /// semantics of running the procedures one after the other; set it
+    /// (possibly to the empty list) to let the step overlap with others.
+    Optional<std::vector<Utf8String> > dependsOn;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(PipelineStepConfig);
+
+
+struct PipelineProcedureConfig : public ProcedureConfig {
+    static constexpr const char * name = "pipeline.run";
+
+    PipelineProcedureConfig()
+        : maxParallelism(0)
+    {
+    }
+
+    /// The steps of the pipeline, in order
+    std::vector<PipelineStepConfig> steps;
+
+    /// Maximum number of steps run at once; 0 means one per CPU core
+    int maxParallelism;
+
+    /// Ids of datasets that only exist to pass data between steps; they
+    /// are deleted once the whole pipeline has finished successfully
+    std::vector<Utf8String> intermediates;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(PipelineProcedureConfig);
+
+
+/*****************************************************************************/
+/* PIPELINE PROCEDURE                                                        */
+/*****************************************************************************/
+
+struct PipelineProcedure: public Procedure {
+
+    PipelineProcedure(MldbServer * owner,
+                      PolyConfig config,
+                      const std::function<bool (const Json::Value &)> & onProgress);
+
+    virtual RunOutput run(const ProcedureRunConfig & run,
+                          const std::function<bool (const Json::Value &)> & onProgress) const;
+
+    virtual Any getStatus() const;
+
+    PipelineProcedureConfig procConfig;
+};
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -11,6 +11,7 @@ LIBMLDB_BUILTIN_PLUGIN_SOURCES:= \
 	sparse_matrix_dataset.cc \
 	script_procedure.cc \
 	permuter_procedure.cc \
+	pipeline_procedure.cc \
 	external_python_procedure.cc \
 	experiment_procedure.cc \
 	docker_plugin.cc \
@@ -19,15 +20,22 @@ LIBMLDB_BUILTIN_PLUGIN_SOURCES:= \
 	nlp.cc \
 	sentiwordnet.cc \
 	bucketize_procedure.cc \
+	window_procedure.cc \
 	git.cc \
 	csv_export_procedure.cc \
+	json_export_procedure.cc \
 	xlsx_importer.cc \
 	json_importer.cc \
+	parquet_reader.cc \
+	parquet_importer.cc \
 	melt_procedure.cc \
 	ranking_procedure.cc \
 	fetcher.cc \
 	importtext_procedure.cc \
 	tabular_dataset.cc \
+	partial_aggregation.cc \
+	sharded_dataset.cc \
+	tabular_persistence.cc \
 	frozen_column.cc \
 	column_types.cc \
 	tabular_dataset_column.cc \
@@ -53,7 +61,7 @@ LIBMLDB_BUILTIN_PLUGIN_SOURCES:= \
 # Needed so that Python plugin can find its header
 $(eval $(call set_compile_option,python_plugin_loader.cc,-I$(PYTHON_INCLUDE_PATH)))
 
-$(eval $(call library,mldb_builtin_plugins,$(LIBMLDB_BUILTIN_PLUGIN_SOURCES),datacratic_sqlite ml mldb_lang_plugins mldb_algo_plugins mldb_misc_plugins mldb_ui_plugins tsne svm libstemmer edlib algebra svdlibc csv_writer))
+$(eval $(call library,mldb_builtin_plugins,$(LIBMLDB_BUILTIN_PLUGIN_SOURCES),datacratic_sqlite ml mldb_lang_plugins mldb_algo_plugins mldb_misc_plugins mldb_ui_plugins tsne svm libstemmer edlib algebra svdlibc csv_writer zstd boost_iostreams))
 $(eval $(call library_forward_dependency,mldb_builtin_plugins,mldb_lang_plugins mldb_algo_plugins mldb_misc_plugins mldb_ui_plugins))
 
 $(eval $(call include_sub_make,lang))
@@ -138,6 +138,13 @@ run(const ProcedureRunConfig & run,
 
     checkWritability(runProcConf.modelFileUrl.toString(), "modelFileUrl");
 
+    if (runProcConf.featureVectorSamplingProp <= 0.0f
+        || runProcConf.featureVectorSamplingProp > 1.0f) {
+        throw HttpReturnException
+            (400, "featureVectorSamplingProp must be between 0 and 1",
+             "featureVectorSamplingProp", runProcConf.featureVectorSamplingProp);
+    }
+
     // 1.  Get the input dataset
     SqlExpressionMldbScope context(server);
 
@@ -228,7 +235,13 @@ run(const ProcedureRunConfig & run,
         allData.addRow(labels[i].isTrue(), 1.0 /* weight */, i);
     }
 
-    const float trainprop = 1.0f;
+    // The labels are folded into allData now; don't keep a second copy
+    // around for the whole training run.
+    labels = std::vector<CellValue>();
+
+    // Each bag only materializes its sampled rows when it compacts, so
+    // this directly controls the peak memory per concurrent bag.
+    const float trainprop = runProcConf.featureVectorSamplingProp;
     RandomForestRNG myrng;
     int totalResultCount = runProcConf.featureVectorSamplings*runProcConf.featureSamplings;
     vector<shared_ptr<Decision_Tree>> results(totalResultCount);
@@ -32,8 +32,15 @@ ScriptFunctionConfigDescription()
 {
     addField("language", &ScriptFunctionConfig::language, 
             "Script language (python or javascript)");
-    addField("scriptConfig", &ScriptFunctionConfig::scriptConfig, 
+    addField("scriptConfig", &ScriptFunctionConfig::scriptConfig,
             "Script resource configuration");
+    addField("batched", &ScriptFunctionConfig::batched,
+            "If true, calls to the function are accumulated and the script "
+            "is invoked once per batch: its args parameter is a list with "
+            "each call's args, and it must return a list with one result "
+            "per entry, in order.  This amortizes the interpreter startup "
+            "and argument conversion over the batch, which matters when "
+            "the function is applied to every row of a query.", false);
 }
 
 
@@ -72,29 +79,24 @@ getStatus() const
     return Any();
 }
 
-ExpressionValue
+Json::Value
 ScriptFunction::
-apply(const FunctionApplier & applier,
-      const ExpressionValue & context) const
+runScript(const Json::Value & args) const
 {
     string resource = "/v1/types/plugins/" + runner + "/routes/run";
 
     // make it so that if the params parameter contains an args key, we move
     // its contents to the args parameter of the script
     ScriptResource copiedSR(cachedResource);
-
-    ExpressionValue args = context.getColumn(PathElement("args"));
-    //Json::Value val = { args.extractJson(), jsonEncode(args.getEffectiveTimestamp()) };
-    Json::Value val = jsonEncode(args);
-    copiedSR.args = val;
+    copiedSR.args = args;
 
     //cerr << "script args = " << jsonEncode(copiedSR.args) << endl;
 
     RestRequest request("POST", resource, RestParams(),
-                        
+
                         jsonEncode(copiedSR).toString());
     InProcessRestConnection connection;
-    
+
     // TODO. this should not always be true. need to get this from the context
     // somehow
     request.header.headers.insert(make_pair("__mldb_child_call", "true"));
@@ -107,8 +109,14 @@ apply(const FunctionApplier & applier,
                                   Json::parse(connection.response));
     }
 
-    Json::Value result = Json::parse(connection.response)["result"];
-    
+    return Json::parse(connection.response)["result"];
+}
+
+/// Turn one call's result (an array of [name, value, timestamp]
+/// triplets) into the function's output row
+static ExpressionValue
+decodeScriptResult(const Json::Value & result)
+{
     vector<tuple<PathElement, ExpressionValue>> vals;
     if(!result.isArray()) {
         throw ML::Exception("Function should return array of arrays.");
@@ -129,6 +137,52 @@ apply(const FunctionApplier & applier,
     return std::move(sresult);
 }
 
+ExpressionValue
+ScriptFunction::
+apply(const FunctionApplier & applier,
+      const ExpressionValue & context) const
+{
+    ExpressionValue args = context.getColumn(PathElement("args"));
+    //Json::Value val = { args.extractJson(), jsonEncode(args.getEffectiveTimestamp()) };
+
+    return decodeScriptResult(runScript(jsonEncode(args)));
+}
+
+bool
+ScriptFunction::
+supportsBatchedCalls() const
+{
+    return functionConfig.batched;
+}
+
+std::vector<ExpressionValue>
+ScriptFunction::
+applyBatch(const FunctionApplier & applier,
+           const std::vector<ExpressionValue> & inputs) const
+{
+    // One script run for the whole batch: the args parameter holds each
+    // call's args in order, so the interpreter entry, script compilation
+    // and argument conversion are paid once rather than once per row
+    Json::Value args(Json::arrayValue);
+    for (auto & input: inputs)
+        args.append(jsonEncode(input.getColumn(PathElement("args"))));
+
+    Json::Value results = runScript(args);
+
+    if (!results.isArray() || results.size() != inputs.size()) {
+        throw HttpReturnException
+            (400, "Batched script function must return one result list "
+             "per entry of its args list",
+             "numInputs", inputs.size());
+    }
+
+    std::vector<ExpressionValue> outputs;
+    outputs.reserve(inputs.size());
+    for (const Json::Value & result: results)
+        outputs.emplace_back(decodeScriptResult(result));
+    return outputs;
+}
+
 FunctionInfo
 ScriptFunction::
 getFunctionInfo() const
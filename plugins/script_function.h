@@ -21,8 +21,14 @@ namespace MLDB {
 /*****************************************************************************/
 
 struct ScriptFunctionConfig {
+    ScriptFunctionConfig()
+        : batched(false)
+    {
+    }
+
     std::string language;
     ScriptResource scriptConfig;
+    bool batched;   ///< Script expects a list of each call's args
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(ScriptFunctionConfig);
@@ -43,8 +49,19 @@ struct ScriptFunction: public Function {
     virtual ExpressionValue apply(const FunctionApplier & applier,
                               const ExpressionValue & context) const;
 
+    virtual bool supportsBatchedCalls() const;
+
+    virtual std::vector<ExpressionValue>
+    applyBatch(const FunctionApplier & applier,
+               const std::vector<ExpressionValue> & inputs) const;
+
     virtual FunctionInfo getFunctionInfo() const;
 
+    /** Run the script once with the given args and return the raw
+        result array.  Shared between the single-call and batched paths.
+    */
+    Json::Value runScript(const Json::Value & args) const;
+
     ScriptFunctionConfig functionConfig;
 
     std::string runner;
@@ -0,0 +1,602 @@
+/** sharded_dataset.cc                                             -*- C++ -*-
+    Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Dataset that scatters queries over shards held by remote peers and
+    merges the results on the coordinator.
+*/
+
+#include "sharded_dataset.h"
+#include "partial_aggregation.h"
+#include "mldb/server/mldb_server.h"
+#include "mldb/server/dataset_collection.h"
+#include "mldb/sql/sql_expression.h"
+#include "mldb/sql/sql_expression_operations.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/types/structure_description.h"
+#include "mldb/types/vector_description.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/http/http_exception.h"
+#include <algorithm>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+using namespace std;
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* SHARDED DATASET CONFIG                                                    */
+/*****************************************************************************/
+
+ShardedDatasetConfig::
+ShardedDatasetConfig()
+    : queryTimeout(30.0)
+{
+}
+
+DEFINE_STRUCTURE_DESCRIPTION(ShardedDatasetShard);
+
+ShardedDatasetShardDescription::
+ShardedDatasetShardDescription()
+{
+    addField("peer", &ShardedDatasetShard::peer,
+             "Name of the peer holding the shard.  Leave empty for a "
+             "shard hosted by this instance.");
+    addField("dataset", &ShardedDatasetShard::dataset,
+             "Id of the dataset on that peer");
+}
+
+DEFINE_STRUCTURE_DESCRIPTION(ShardedDatasetConfig);
+
+ShardedDatasetConfigDescription::
+ShardedDatasetConfigDescription()
+{
+    addField("shards", &ShardedDatasetConfig::shards,
+             "The shards making up the dataset, eg one per month.  Every "
+             "row must live in exactly one shard; the coordinator "
+             "concatenates without deduplicating.");
+    addField("queryTimeout", &ShardedDatasetConfig::queryTimeout,
+             "How long (in seconds) to wait for a shard to answer before "
+             "the whole query fails", 30.0);
+}
+
+
+namespace {
+
+/** Textual query pushed to one shard.  Shards parse exactly what a
+    client would have sent to their /query route, so a clause means the
+    same thing distributed as it does run against each shard by hand.
+*/
+struct ShardQuery {
+    Utf8String select = "*";
+    Utf8String when = "true";
+    Utf8String where = "true";
+    Utf8String groupBy;
+    Utf8String rowName;       ///< empty = shard default (rowPath())
+    ssize_t offset = 0;
+    ssize_t limit = -1;
+};
+
+/** Pushed query parsed once on the coordinator.  The shards of one
+    logical table share a schema, so the expressions mean the same thing
+    on each; one parsed set serves every local shard of a scatter
+    instead of each shard re-parsing the same five strings.
+*/
+struct ParsedShardQuery {
+    ParsedShardQuery(const ShardQuery & q)
+        : select(SelectExpression::parse(q.select)),
+          when(WhenExpression::parse(q.when)),
+          where(SqlExpression::parse(q.where)),
+          orderBy(OrderByExpression::parse("true")),
+          groupBy(TupleExpression::parse(q.groupBy)),
+          rowName(SqlExpression::parse
+                  (q.rowName.empty() ? Utf8String("rowPath()") : q.rowName))
+    {
+    }
+
+    SelectExpression select;
+    WhenExpression when;
+    std::shared_ptr<SqlExpression> where;
+    OrderByExpression orderBy;
+    TupleExpression groupBy;
+    std::shared_ptr<SqlExpression> rowName;
+};
+
+/** Key identifying a pushed query in the parsed-query cache. */
+std::string parsedQueryKey(const ShardQuery & q)
+{
+    return q.select.rawString() + "\n" + q.when.rawString() + "\n"
+        + q.where.rawString() + "\n" + q.groupBy.rawString() + "\n"
+        + q.rowName.rawString();
+}
+
+void applyOffsetLimit(ssize_t offset, ssize_t limit,
+                      std::vector<MatrixNamedRow> & rows)
+{
+    if (offset > 0)
+        rows.erase(rows.begin(),
+                   rows.begin() + std::min<ssize_t>(offset, rows.size()));
+    if (limit != -1 && (ssize_t)rows.size() > limit)
+        rows.resize(limit);
+}
+
+Utf8String surfaceOrClauses(const Utf8String & surface,
+                            const std::vector<std::shared_ptr<SqlExpression> > & clauses)
+{
+    if (!surface.empty())
+        return surface;
+    Utf8String result;
+    for (auto & c: clauses) {
+        if (!result.empty())
+            result += ", ";
+        result += c->surface;
+    }
+    return result;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* SHARDED DATASET INTERNAL                                                  */
+/*****************************************************************************/
+
+struct ShardedDataset::Itl {
+    Itl(MldbServer * server, ShardedDatasetConfig config)
+        : server(server), config(std::move(config))
+    {
+        if (this->config.shards.empty())
+            throw HttpReturnException(400, "Sharded dataset needs at least "
+                                      "one shard");
+        for (auto & s: this->config.shards) {
+            if (s.dataset.empty())
+                throw HttpReturnException(400, "Sharded dataset shard needs "
+                                          "a dataset id");
+        }
+    }
+
+    MldbServer * server;
+    ShardedDatasetConfig config;
+
+    /// Parsed pushed queries, keyed on the exact query text.  Shared
+    /// across the local shards of each scatter and across repeated
+    /// queries; entries never go stale since what is cached is the
+    /// parse, not a binding against any shard.
+    mutable std::mutex parsedQueriesLock;
+    mutable std::map<std::string, std::shared_ptr<const ParsedShardQuery> >
+        parsedQueries;
+
+    /// Schema fingerprint of a local shard, cached against the shard
+    /// dataset's content version so an unchanged shard is never
+    /// re-enumerated.
+    struct ShardSchema {
+        uint64_t version;
+        uint64_t fingerprint;
+    };
+    mutable std::mutex schemasLock;
+    mutable std::map<std::string, ShardSchema> shardSchemas;
+
+    bool isLocal(const ShardedDatasetShard & shard) const
+    {
+        return shard.peer.empty()
+            || shard.peer == server->getLocalPeerName();
+    }
+
+    /** The REST parameters a client would pass to the shard's /query
+        route for the given pushed query.
+    */
+    RestParams paramsFor(const ShardQuery & q) const
+    {
+        RestParams params
+            = { { "format", "full" },
+                { "select", q.select },
+                { "when", q.when },
+                { "where", q.where },
+                { "offset", to_string(q.offset) },
+                { "limit", to_string(q.limit) } };
+        if (!q.groupBy.empty())
+            params.emplace_back("groupBy", q.groupBy);
+        if (!q.rowName.empty())
+            params.emplace_back("rowName", q.rowName);
+        return params;
+    }
+
+    /** Return the parsed form of the pushed query, reusing a previous
+        parse of the same text when there is one.  The strings are
+        exactly what a remote shard would receive, so local and remote
+        shards still can't drift apart in semantics.
+    */
+    std::shared_ptr<const ParsedShardQuery>
+    parsedFor(const ShardQuery & q) const
+    {
+        std::string key = parsedQueryKey(q);
+
+        std::unique_lock<std::mutex> guard(parsedQueriesLock);
+        auto it = parsedQueries.find(key);
+        if (it != parsedQueries.end())
+            return it->second;
+
+        // Queries with generated text (eg an IN list per request) would
+        // otherwise grow the cache without bound
+        if (parsedQueries.size() >= 256)
+            parsedQueries.clear();
+
+        auto parsed = std::make_shared<const ParsedShardQuery>(q);
+        parsedQueries.emplace(std::move(key), parsed);
+        return parsed;
+    }
+
+    /** Fingerprint of a shard's schema: a hash of its column names in
+        order, cached against the shard dataset's content version.
+    */
+    uint64_t
+    schemaFingerprintFor(const ShardedDatasetShard & shard,
+                         const Dataset & dataset) const
+    {
+        uint64_t version = dataset.getVersion();
+
+        {
+            std::unique_lock<std::mutex> guard(schemasLock);
+            auto it = shardSchemas.find(shard.dataset);
+            if (it != shardSchemas.end() && it->second.version == version)
+                return it->second.fingerprint;
+        }
+
+        uint64_t fingerprint = 1;
+        for (auto & c: dataset.getColumnNames())
+            fingerprint = fingerprint * 1000000007ULL + c.hash();
+
+        std::unique_lock<std::mutex> guard(schemasLock);
+        shardSchemas[shard.dataset] = { version, fingerprint };
+        return fingerprint;
+    }
+
+    /** Run the pushed query against a shard hosted by this instance. */
+    std::vector<MatrixNamedRow>
+    queryLocalShard(const Dataset & dataset,
+                    const ShardQuery & q,
+                    const ParsedShardQuery & parsed) const
+    {
+        return dataset.queryStructured(parsed.select, parsed.when,
+                                       *parsed.where,
+                                       parsed.orderBy,
+                                       parsed.groupBy,
+                                       *SqlExpression::TRUE /* having */,
+                                       *parsed.rowName,
+                                       q.offset, q.limit);
+    }
+
+    /** Decode the 4-element REST response payload from a remote shard. */
+    std::vector<MatrixNamedRow>
+    decodeShardResponse(const ShardedDatasetShard & shard,
+                        std::vector<std::string> && payload) const
+    {
+        if (payload.size() != 4)
+            throw HttpReturnException(500, "Malformed query response from "
+                                      "shard peer",
+                                      "peer", shard.peer,
+                                      "dataset", shard.dataset);
+
+        int code = std::stoi(payload[0]);
+        if (code != 200)
+            throw HttpReturnException(code, "Query on shard failed",
+                                      "peer", shard.peer,
+                                      "dataset", shard.dataset,
+                                      "response", payload[3]);
+
+        return jsonDecodeStr<std::vector<MatrixNamedRow> >(payload[3]);
+    }
+
+    /** Push the query to every shard and return the partial results, in
+        shard configuration order.  Remote shards answer in parallel;
+        local shards run inline while the remote answers are in flight.
+    */
+    std::vector<std::vector<MatrixNamedRow> >
+    scatter(const ShardQuery & q) const
+    {
+        Date deadline = Date::now().plusSeconds(config.queryTimeout);
+        RestParams params = paramsFor(q);
+
+        std::vector<std::shared_ptr<std::promise<std::vector<std::string> > > >
+            pending(config.shards.size());
+
+        for (size_t i = 0;  i < config.shards.size();  ++i) {
+            const ShardedDatasetShard & shard = config.shards[i];
+            if (isLocal(shard))
+                continue;
+
+            auto promise
+                = std::make_shared<std::promise<std::vector<std::string> > >();
+            pending[i] = promise;
+
+            std::vector<std::string> message
+                = { "GET",
+                    "/v1/datasets/" + shard.dataset + "/query",
+                    jsonEncodeStr(params),
+                    "" };
+
+            auto onResponse = [promise] (PeerMessage && msg,
+                                         std::vector<std::string> && payload)
+                {
+                    promise->set_value(std::move(payload));
+                };
+
+            auto onError = [promise, shard] (PeerMessage && msg)
+                {
+                    promise->set_exception
+                        (std::make_exception_ptr
+                         (HttpReturnException
+                          (503, "Query to shard peer failed",
+                           "peer", shard.peer,
+                           "dataset", shard.dataset,
+                           "error", msg.error.empty()
+                               ? "request timed out or peer unreachable"
+                               : msg.error)));
+                };
+
+            server->sendPeerMessage(shard.peer,
+                                    PRI_NORMAL,
+                                    deadline,
+                                    2 /* layer */,
+                                    MldbServer::PEER_REST_REQUEST,
+                                    std::move(message),
+                                    std::move(onResponse),
+                                    std::move(onError));
+        }
+
+        std::vector<std::vector<MatrixNamedRow> > partials(config.shards.size());
+
+        // One parse of the pushed query serves every local shard
+        std::shared_ptr<const ParsedShardQuery> parsed;
+        uint64_t commonFingerprint = 0;
+
+        for (size_t i = 0;  i < config.shards.size();  ++i) {
+            if (pending[i])
+                continue;
+            const ShardedDatasetShard & shard = config.shards[i];
+
+            auto dataset = server->datasets->obtainDataset(shard.dataset);
+            if (!dataset)
+                throw HttpReturnException(400, "Unknown local dataset in "
+                                          "sharded dataset",
+                                          "dataset", shard.dataset);
+
+            // The shards of one logical table are expected to share a
+            // schema; each shard interprets the pushed query text on
+            // its own, so a drift silently changes what a clause means
+            // there.  Flag it rather than fail: every per-shard result
+            // is still self-consistent.
+            uint64_t fingerprint = schemaFingerprintFor(shard, *dataset);
+            if (commonFingerprint == 0)
+                commonFingerprint = fingerprint;
+            else if (fingerprint != commonFingerprint)
+                cerr << "warning: shard " << shard.dataset
+                     << " of sharded dataset has a different schema from "
+                     << "its sibling shards" << endl;
+
+            if (!parsed)
+                parsed = parsedFor(q);
+
+            partials[i] = queryLocalShard(*dataset, q, *parsed);
+        }
+
+        for (size_t i = 0;  i < config.shards.size();  ++i) {
+            if (pending[i])
+                partials[i] = decodeShardResponse
+                    (config.shards[i], pending[i]->get_future().get());
+        }
+
+        return partials;
+    }
+
+    std::vector<MatrixNamedRow>
+    queryStructured(const SelectExpression & select,
+                    const WhenExpression & when,
+                    const SqlExpression & where,
+                    const OrderByExpression & orderBy,
+                    const TupleExpression & groupBy,
+                    const SqlExpression & having,
+                    const SqlExpression & rowName,
+                    ssize_t offset,
+                    ssize_t limit) const
+    {
+        if (!orderBy.clauses.empty())
+            throw HttpReturnException
+                (400, "ORDER BY can't be pushed to the shards of a sharded "
+                 "dataset; sort the merged result in an outer query or in "
+                 "the application");
+
+        bool grouped = !groupBy.clauses.empty();
+
+        ShardQuery q;
+        q.select = select.surface;
+        if (q.select.empty()) {
+            for (auto & c: select.clauses) {
+                if (!q.select.empty())
+                    q.select += ", ";
+                q.select += c->surface;
+            }
+        }
+        q.when = when.surface.empty() ? Utf8String("true") : when.surface;
+        q.where = where.surface.empty() ? Utf8String("true") : where.surface;
+        q.rowName = rowName.surface;
+
+        // Plain scan: push the select through verbatim and concatenate.
+        // Each shard only ever needs to produce the first offset + limit
+        // rows; offset itself can't be pushed, since we don't know how
+        // the skipped rows distribute over the shards.
+        if (!grouped && select.findAggregators(false).empty()) {
+            if (!having.isConstantTrue())
+                throw HttpReturnException(400, "HAVING expression requires "
+                                          "a GROUP BY expression");
+
+            q.limit = limit == -1 ? -1 : offset + limit;
+
+            auto partials = scatter(q);
+
+            std::vector<MatrixNamedRow> output;
+            for (auto & partial: partials) {
+                if (output.empty())
+                    output = std::move(partial);
+                else
+                    output.insert(output.end(),
+                                  std::make_move_iterator(partial.begin()),
+                                  std::make_move_iterator(partial.end()));
+            }
+
+            applyOffsetLimit(offset, limit, output);
+            return output;
+        }
+
+        // Aggregate query.  The aggregator states merge through typed
+        // void pointers in-process, so they can't be shipped between
+        // peers; instead the select is decomposed algebraically into
+        // per-shard partials with synthetic aliases, which are combined
+        // here per group.
+        if (!having.isConstantTrue())
+            throw HttpReturnException
+                (400, "HAVING can't be evaluated per shard of a sharded "
+                 "dataset; filter the merged groups in an outer query");
+
+        PartialAggregationPlan plan
+            = PartialAggregationPlan::decompose(select, grouped);
+
+        q.select = plan.partialSelect;
+        q.groupBy = grouped
+            ? surfaceOrClauses(groupBy.surface, groupBy.clauses)
+            : Utf8String();
+
+        // Every shard has to hand back all of its groups for the merge
+        // to be correct; offset and limit apply to the merged groups
+        q.offset = 0;
+        q.limit = -1;
+
+        auto partials = scatter(q);
+
+        // Merge the partial rows by row name.  The row name carries the
+        // group keys (or names the single aggregate row), so rows with
+        // the same name on two shards are partials of the same output
+        // row.  The merge map keeps the groups ordered by row name, so
+        // the result is deterministic regardless of shard order.
+        std::map<RowName, MatrixNamedRow> merged;
+        for (auto & partial: partials)
+            plan.mergeRows(merged, std::move(partial));
+
+        std::vector<MatrixNamedRow> output;
+        output.reserve(merged.size());
+        for (auto & m: merged) {
+            plan.finishRow(m.second);
+            output.emplace_back(std::move(m.second));
+        }
+
+        applyOffsetLimit(offset, limit, output);
+        return output;
+    }
+};
+
+
+/*****************************************************************************/
+/* SHARDED DATASET                                                           */
+/*****************************************************************************/
+
+ShardedDataset::
+ShardedDataset(MldbServer * owner,
+               PolyConfig config,
+               const std::function<bool (const Json::Value &)> & onProgress)
+    : Dataset(owner)
+{
+    auto datasetConfig = config.params.convert<ShardedDatasetConfig>();
+    itl.reset(new Itl(owner, std::move(datasetConfig)));
+}
+
+ShardedDataset::
+~ShardedDataset()
+{
+}
+
+Any
+ShardedDataset::
+getStatus() const
+{
+    Json::Value status;
+    status["shardCount"] = (Json::UInt)itl->config.shards.size();
+    return status;
+}
+
+std::shared_ptr<MatrixView>
+ShardedDataset::
+getMatrixView() const
+{
+    throw HttpReturnException(400, "Sharded datasets can't be accessed as "
+                              "a matrix; the shards stay on their peers, "
+                              "so the operation has to be expressed as a "
+                              "query that can be scattered to them");
+}
+
+std::shared_ptr<ColumnIndex>
+ShardedDataset::
+getColumnIndex() const
+{
+    throw HttpReturnException(400, "Sharded datasets can't be accessed as "
+                              "a column index; the shards stay on their "
+                              "peers, so the operation has to be expressed "
+                              "as a query that can be scattered to them");
+}
+
+uint64_t
+ShardedDataset::
+getVersion() const
+{
+    // The coordinator holds no rows of its own, so its version is
+    // derived from the shards': a plan bound against the sharded view
+    // (see SqlQueryFunction's plan cache) then goes stale when a local
+    // shard commits.  Remote shards can't be polled cheaply here, but a
+    // cached plan only keeps the scatter, which re-queries the remote
+    // shards every run; only coordinator-side binding metadata could be
+    // stale for them.
+    uint64_t version = Dataset::getVersion();
+    for (auto & shard: itl->config.shards) {
+        if (!itl->isLocal(shard))
+            continue;
+        auto dataset = itl->server->datasets->obtainDataset(shard.dataset);
+        if (dataset)
+            version += dataset->getVersion();
+    }
+    return version;
+}
+
+std::vector<MatrixNamedRow>
+ShardedDataset::
+queryStructured(const SelectExpression & select,
+                const WhenExpression & when,
+                const SqlExpression & where,
+                const OrderByExpression & orderBy,
+                const TupleExpression & groupBy,
+                const SqlExpression & having,
+                const SqlExpression & rowName,
+                ssize_t offset,
+                ssize_t limit,
+                Utf8String alias) const
+{
+    return itl->queryStructured(select, when, where, orderBy, groupBy,
+                                having, rowName, offset, limit);
+}
+
+namespace {
+
+RegisterDatasetType<ShardedDataset, ShardedDatasetConfig>
+regSharded(builtinPackage(),
+           "sharded",
+           "Coordinator view over datasets sharded across peers",
+           "datasets/ShardedDataset.md.html");
+
+} // file scope
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -0,0 +1,99 @@
+/** sharded_dataset.h                                              -*- C++ -*-
+    Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Dataset that scatters queries over shards held by remote peers and
+    merges the results on the coordinator.
+*/
+
+#pragma once
+
+#include "mldb/core/dataset.h"
+#include "mldb/types/value_description.h"
+
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* SHARDED DATASET CONFIG                                                    */
+/*****************************************************************************/
+
+struct ShardedDatasetShard {
+    /// Name of the peer holding the shard.  Empty means this instance.
+    std::string peer;
+
+    /// Id of the dataset on that peer
+    std::string dataset;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(ShardedDatasetShard);
+
+struct ShardedDatasetConfig {
+    ShardedDatasetConfig();
+
+    /// The shards making up the dataset, eg one per month.  Every row
+    /// lives in exactly one shard; the coordinator never dedups.
+    std::vector<ShardedDatasetShard> shards;
+
+    /// How long (in seconds) to wait for a shard to answer before the
+    /// whole query fails
+    double queryTimeout;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(ShardedDatasetConfig);
+
+
+/*****************************************************************************/
+/* SHARDED DATASET                                                           */
+/*****************************************************************************/
+
+/** Read-only view over datasets sharded across MLDB instances.  A
+    select is decomposed into per-shard queries pushed over the peer
+    channel (or run directly for local shards) and the partial results
+    are merged here: plain scans are concatenated, and the decomposable
+    aggregates (count, sum, min, max, avg) are combined algebraically,
+    per group when there is a GROUP BY.
+
+    The shards are never materialized on the coordinator, so the dataset
+    can't be accessed as a matrix; everything has to go through a query.
+*/
+
+struct ShardedDataset: public Dataset {
+
+    ShardedDataset(MldbServer * owner,
+                   PolyConfig config,
+                   const std::function<bool (const Json::Value &)> & onProgress);
+
+    virtual ~ShardedDataset();
+
+    virtual Any getStatus() const;
+
+    virtual std::shared_ptr<MatrixView> getMatrixView() const;
+
+    virtual std::shared_ptr<ColumnIndex> getColumnIndex() const;
+
+    virtual uint64_t getVersion() const;
+
+    virtual std::vector<MatrixNamedRow>
+    queryStructured(const SelectExpression & select,
+                    const WhenExpression & when,
+                    const SqlExpression & where,
+                    const OrderByExpression & orderBy,
+                    const TupleExpression & groupBy,
+                    const SqlExpression & having,
+                    const SqlExpression & rowName,
+                    ssize_t offset,
+                    ssize_t limit,
+                    Utf8String alias = "") const;
+
+private:
+    struct Itl;
+    std::shared_ptr<Itl> itl;
+};
+
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -72,13 +72,21 @@ struct MatrixWriteTransaction;
 
 struct MatrixReadTransaction {
 
-      struct Stream {       
+      struct Stream {
 
         virtual std::shared_ptr<MatrixReadTransaction::Stream> clone() const = 0;
 
         virtual void initAt(size_t start) = 0;
 
         virtual uint64_t next() = 0;
+
+        /* Skip over the next n row numbers.  The default simply calls
+           next() n times; implementations can skip more cheaply. */
+        virtual void advanceBy(size_t n)
+        {
+            while (n--)
+                next();
+        }
     };
 
     virtual ~MatrixReadTransaction()
@@ -18,6 +18,7 @@
 #include "mldb/arch/timers.h"
 #include "mldb/base/parallel.h"
 #include "mldb/base/thread_pool.h"
+#include "mldb/base/scope.h"
 #include "mldb/utils/atomic_shared_ptr.h"
 #include "mldb/server/parallel_merge_sort.h"
 #include <mutex>
@@ -154,6 +155,11 @@ struct SparseMatrixDataset::Itl
             return source->getRowNameTrans(RowHash(i), *trans);
         }
 
+        virtual void advanceBy(size_t n) {
+            // skips the row number to name resolution entirely
+            internalStream->advanceBy(n);
+        }
+
         std::shared_ptr<MatrixReadTransaction::Stream> internalStream;
         std::shared_ptr<ReadTransaction> trans;
         SparseMatrixDataset::Itl* source;
@@ -667,6 +673,68 @@ struct SparseMatrixDataset::Itl
         return { columnName, std::make_shared<AnyValueInfo>(), COLUMN_IS_SPARSE };
     }
 
+    /** Approximate memory held by the matrix.  The per-column
+        breakdown comes from the inverse (column-major) side; the
+        row-major side holds every cell a second time and counts
+        towards the total, as do the row and column name tables.
+    */
+    DatasetMemoryUsage getMemoryUsage() const
+    {
+        DatasetMemoryUsage result;
+
+        auto trans = getReadTransaction();
+
+        auto entryBytes = [] (const BaseEntry & entry) -> uint64_t
+            {
+                uint64_t bytes = sizeof(BaseEntry);
+                for (auto & m: entry.metadata)
+                    bytes += m.size();
+                return bytes;
+            };
+
+        trans->inverse->iterateRows([&] (uint64_t col)
+            {
+                uint64_t bytes = 0;
+                trans->inverse->iterateRow
+                    (col, [&] (const BaseEntry & entry)
+                     {
+                         bytes += entryBytes(entry);
+                         return true;
+                     });
+                result.columnBytes[getColumnNameTrans(ColumnHash(col),
+                                                      *trans)]
+                    = bytes;
+                result.totalBytes += bytes;
+                return true;
+            });
+
+        trans->matrix->iterateRows([&] (uint64_t row)
+            {
+                trans->matrix->iterateRow
+                    (row, [&] (const BaseEntry & entry)
+                     {
+                         result.totalBytes += entryBytes(entry);
+                         return true;
+                     });
+                return true;
+            });
+
+        // Row and column names both live in the values matrix
+        trans->values->iterateRows([&] (uint64_t row)
+            {
+                trans->values->iterateRow
+                    (row, [&] (const BaseEntry & entry)
+                     {
+                         result.rowNameBytes += entryBytes(entry);
+                         return true;
+                     });
+                return true;
+            });
+        result.totalBytes += result.rowNameBytes;
+
+        return result;
+    }
+
     /** Return the value of the column for all rows and timestamps. */
     virtual MatrixColumn getColumnTrans(const ColumnName & column,
                                         ReadTransaction & trans) const
@@ -815,13 +883,25 @@ getStatus() const
     return itl->getStatus();
 }
 
+DatasetMemoryUsage
+SparseMatrixDataset::
+getMemoryUsage() const
+{
+    return itl->getMemoryUsage();
+}
+
 void
 SparseMatrixDataset::
 recordRowItl(const RowName & rowName,
              const std::vector<std::tuple<ColumnName, CellValue, Date> > & vals)
 {
     validateNames(rowName, vals);
-    return itl->recordRow(rowName, vals);
+    itl->recordRow(rowName, vals);
+
+    // Recorded rows are visible to queries right away (there is no
+    // commit barrier), so the version has to move right away too or
+    // cached results would be served stale until the next commit
+    bumpVersion();
 }
 
 void
@@ -829,7 +909,8 @@ SparseMatrixDataset::
 recordRows(const std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > & rows)
 {
     validateNames(rows);
-    return itl->recordRows(rows);
+    itl->recordRows(rows);
+    bumpVersion();
 }
 
 KnownColumn
@@ -846,7 +927,8 @@ commit()
     // We call commit() when we're done with writing data.  We take advantage
     // of it to optimize the storage of the data that's been recorded to
     // date.
-    return itl->optimize();
+    itl->optimize();
+    bumpVersion();
 }
     
 Date
@@ -897,10 +979,12 @@ enum CommitMode {
 /* MUTABLE BASE MATRIX                                                       */
 /*****************************************************************************/
 
-struct MutableBaseData {
+struct MutableBaseData
+    : public std::enable_shared_from_this<MutableBaseData> {
 
     MutableBaseData(CommitMode commitMode)
-        : repr(std::make_shared<Repr>()), commitMode(commitMode)
+        : repr(std::make_shared<Repr>()), commitMode(commitMode),
+          backgroundMergesActive(0)
     {
     }
 
@@ -968,6 +1052,10 @@ struct MutableBaseData {
         bool iterateRows(const std::function<bool (uint64_t row)> & onRow) const
         {
             std::vector<uint64_t> allRows;
+            size_t totalRows = 0;
+            for (auto & e: entries)
+                totalRows += e->size();
+            allRows.reserve(totalRows);
 
             for (auto & e: entries) {
                 for (auto & r: *e) {
@@ -1015,6 +1103,10 @@ struct MutableBaseData {
             // TODO: this is slow, but at least correct
             std::unique_lock<std::mutex> guard(rowCountMutex);
             std::vector<uint64_t> allRows;
+            size_t totalRows = 0;
+            for (auto & e: entries)
+                totalRows += e->size();
+            allRows.reserve(totalRows);
 
             for (auto & e: entries) {
                 for (auto & r: *e) {
@@ -1037,42 +1129,7 @@ struct MutableBaseData {
             return rowCount;
         }
 
-        Rows optimize(std::vector<std::shared_ptr<RowsEntry> > & nonReadableWrites) const
-        {
-            Rows result;
-
-            RowsEntry newEntries;
-
-            if (!entries.empty()) {
-                newEntries = *entries.front();
-
-                for (unsigned i = 1;  i < entries.size();  ++i) {
-                    auto & e = entries[i];
-                    for (auto & v: *e) {
-                        auto & vec = newEntries[v.first];
-                        vec.insert(vec.end(), v.second.begin(), v.second.end());
-                    }
-                }
-            }
-
-            for (auto & w: nonReadableWrites) {
-
-                auto & e = *w;
-                for (auto & v: e) {
-                    auto & vec = newEntries[v.first];
-                    vec.insert(vec.end(),
-                               std::make_move_iterator(v.second.begin()),
-                               std::make_move_iterator(v.second.end()));
-                }
-            }
-
-            nonReadableWrites.clear();
-
-            result.entries.emplace_back(new RowsEntry(std::move(newEntries)));
-            return result;
-        }
-
-        struct Stream {       
+        struct Stream {
 
             Stream(const MutableBaseData::Rows* source) : source(source)
             {
@@ -1113,6 +1170,24 @@ struct MutableBaseData {
                 return value;
             }
 
+            void advanceBy(size_t n)
+            {
+                while (n > 0) {
+                    // skip whole entries without walking their elements
+                    if (subIter == (*entriesIter)->begin()
+                        && n >= (*entriesIter)->size()) {
+                        n -= (*entriesIter)->size();
+                        ++entriesIter;
+                        if (entriesIter == source->entries.end())
+                            return;
+                        subIter = (*entriesIter)->begin();
+                        continue;
+                    }
+                    --n;
+                    next();
+                }
+            }
+
             std::vector<std::shared_ptr<const RowsEntry> >::const_iterator entriesIter;
             RowsEntry::const_iterator subIter;
             const MutableBaseData::Rows* source;
@@ -1148,13 +1223,145 @@ struct MutableBaseData {
     CommitMode commitMode;
     std::vector<std::shared_ptr<RowsEntry> > nonReadableWrites;
 
-    /** Commit and optimize everything that's been written up to here. */
+    /// Number of background generation merges running or queued
+    std::atomic<size_t> backgroundMergesActive;
+
+    /** Commit everything that's been written up to here, in time
+        proportional to the newly written data.  The non readable writes
+        are sealed into a single new generation that becomes readable
+        immediately; generations are then merged back together in the
+        background (see mergeGenerations()), so the pause seen by the
+        committer doesn't grow with the total dataset size.
+    */
     void optimize()
     {
-        std::unique_lock<std::mutex> guard(mutex);
-        auto newRows = repr.load()->rows.optimize(nonReadableWrites);
-        auto newRepr = std::make_shared<Repr>(std::move(newRows));
-        repr.store(std::move(newRepr));
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+
+            std::shared_ptr<RowsEntry> sealed;
+            if (!nonReadableWrites.empty()) {
+                sealed = std::move(nonReadableWrites.front());
+
+                // Size the hash table for the whole generation up front,
+                // so sealing doesn't rehash once per doubling
+                size_t totalRows = sealed->size();
+                for (unsigned i = 1;  i < nonReadableWrites.size();  ++i)
+                    totalRows += nonReadableWrites[i]->size();
+                sealed->reserve(totalRows);
+
+                for (unsigned i = 1;  i < nonReadableWrites.size();  ++i) {
+                    for (auto & v: *nonReadableWrites[i]) {
+                        auto & vec = (*sealed)[v.first];
+                        vec.insert(vec.end(),
+                                   std::make_move_iterator(v.second.begin()),
+                                   std::make_move_iterator(v.second.end()));
+                    }
+                }
+                nonReadableWrites.clear();
+            }
+
+            if (sealed && !sealed->empty()) {
+                auto r = repr.load();
+                auto newEntries = r->rows.entries;
+                newEntries.emplace_back(std::move(sealed));
+                repr.store(std::make_shared<Repr>(std::move(newEntries),
+                                                  -1 /* row count unknown */));
+            }
+        }
+
+        // One merge at a time is enough; if generations accumulate again
+        // the next commit will start another
+        if (backgroundMergesActive.fetch_add(1) != 0) {
+            --backgroundMergesActive;
+            return;
+        }
+
+        auto self = shared_from_this();
+        auto job = [self] ()
+            {
+                Scope_Exit(--self->backgroundMergesActive);
+                self->mergeGenerations();
+            };
+
+        try {
+            ThreadPool::instance().add(std::move(job));
+        } catch (...) {
+            --backgroundMergesActive;
+            throw;
+        }
+    }
+
+    /** Merge committed generations back towards a single entry.  Each
+        pass merges the deepest pair of generations violating the size
+        tiered invariant of insertBalanced() (each generation at most
+        half the size of the one before it), so the total merge work is
+        amortized constant per row.  The mutex is only held to swap the
+        entry lists, never while merging, so recording and reading
+        continue unimpeded.
+    */
+    void mergeGenerations()
+    {
+        for (;;) {
+            std::shared_ptr<const RowsEntry> e1, e2;
+
+            {
+                std::unique_lock<std::mutex> guard(mutex);
+                auto entries = repr.load()->rows.entries;
+                if (entries.size() < 2)
+                    return;
+
+                std::sort(entries.begin(), entries.end(),
+                          [] (const std::shared_ptr<const RowsEntry> & l,
+                              const std::shared_ptr<const RowsEntry> & r)
+                          {
+                              return l->size() > r->size();
+                          });
+
+                for (int i = entries.size() - 2;  i >= 0;  --i) {
+                    if (entries[i + 1]->size() * 2 > entries[i]->size()) {
+                        e1 = entries[i];
+                        e2 = entries[i + 1];
+                        break;
+                    }
+                }
+
+                if (!e1)
+                    return;  // invariant holds; nothing left to merge
+            }
+
+            auto merged = std::make_shared<RowsEntry>(*e1);
+            merged->reserve(e1->size() + e2->size());
+            for (auto & v: *e2) {
+                auto & vec = (*merged)[v.first];
+                vec.insert(vec.end(), v.second.begin(), v.second.end());
+            }
+
+            {
+                std::unique_lock<std::mutex> guard(mutex);
+                auto r = repr.load();
+
+                std::vector<std::shared_ptr<const RowsEntry> > newEntries;
+                bool found1 = false, found2 = false;
+                for (auto & e: r->rows.entries) {
+                    if (e == e1) { found1 = true; continue; }
+                    if (e == e2) { found2 = true; continue; }
+                    newEntries.push_back(e);
+                }
+
+                if (!found1 || !found2) {
+                    // A balanced insert rebuilt the entry list under us;
+                    // drop this merge and let the next commit retry
+                    return;
+                }
+
+                newEntries.emplace_back(std::move(merged));
+
+                // Merging doesn't change the set of rows
+                repr.store(std::make_shared<Repr>
+                           (std::move(newEntries),
+                            r->rows.cachedRowCount.load()));
+            }
+        }
     }
 
     /** Insert the given set of rows very quickly, but in a way that they
@@ -1238,6 +1445,7 @@ struct MutableBaseData {
 
             // Otherwise, merge the two together
             auto merged = std::make_shared<RowsEntry>(*rows);
+            merged->reserve(rows->size() + current->size());
 
             for (auto & rowIn: *current) {
                 auto & rowOut = (*merged)[rowIn.first];
@@ -1415,6 +1623,11 @@ struct MutableReadTransaction: public MatrixReadTransaction {
             return innerStream.next();
         }
 
+        virtual void advanceBy(size_t n)
+        {
+            innerStream.advanceBy(n);
+        }
+
         MutableBaseData::Rows::Stream innerStream;
         const MutableReadTransaction* source;
     };
@@ -40,6 +40,12 @@ struct SparseMatrixDataset: public Dataset {
     */
     virtual KnownColumn getKnownColumnInfo(const ColumnName & columnName) const;
 
+    /** Approximate memory held by the matrix, its inverse and the
+        name tables, with the per-column breakdown taken from the
+        inverse matrix.
+    */
+    virtual DatasetMemoryUsage getMemoryUsage() const;
+
     /** Commit changes to the database.  Default is a no-op. */
     virtual void commit();
 
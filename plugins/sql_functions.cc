@@ -20,6 +20,7 @@
 #include "mldb/types/any_impl.h"
 #include "mldb/server/per_thread_accumulator.h"
 #include "mldb/rest/in_process_rest_connection.h"
+#include "mldb/server/dataset_collection.h"
 #include "mldb/plugins/sql_config_validator.h"
 #include "mldb/server/analytics.h"
 #include <memory>
@@ -125,7 +126,9 @@ struct SqlQueryFunctionApplier: public FunctionApplier {
                 return std::make_shared<AnyValueInfo>();
             };
 
-        pipeline = getMldbRoot(function->server)->statement(*config.query.stm, getParamInfo);
+        auto scope = std::make_shared<SqlExpressionMldbScope>(function->server);
+
+        pipeline = PipelineElement::root(scope)->statement(*config.query.stm, getParamInfo);
 
         std::vector<KnownColumn> inputColumns;
         inputColumns.reserve(inputParams.size());
@@ -140,6 +143,10 @@ struct SqlQueryFunctionApplier: public FunctionApplier {
         // Bind the pipeline
         boundPipeline = pipeline->bind();
 
+        // Remember which datasets the plan was bound against, so that we
+        // know when it becomes stale
+        resolvedDatasets = std::move(scope->resolvedDatasets);
+
         switch (function->functionConfig.output) {
         case FIRST_ROW:
             // What type does the pipeline return?
@@ -276,15 +283,52 @@ struct SqlQueryFunctionApplier: public FunctionApplier {
     std::shared_ptr<Dataset> from;
     std::shared_ptr<PipelineElement> pipeline;
     std::shared_ptr<BoundPipelineElement> boundPipeline;
+
+    /// Datasets the plan was bound against, with their version then
+    std::vector<SqlExpressionMldbScope::ResolvedDataset> resolvedDatasets;
 };
 
+std::shared_ptr<const SqlQueryFunctionApplier>
+SqlQueryFunction::
+getApplier() const
+{
+    std::unique_lock<std::mutex> guard(applierLock);
+
+    if (cachedApplier) {
+        bool stale = false;
+        for (auto & d: cachedApplier->resolvedDatasets) {
+            if (d.dataset->getVersion() != d.version) {
+                stale = true;
+                break;
+            }
+            // A dataset deleted and recreated under the same name is a
+            // different object, with its own versions
+            if (!d.name.empty()
+                && server->datasets->tryGetExistingEntity(d.name.rawString())
+                   != d.dataset) {
+                stale = true;
+                break;
+            }
+        }
+        if (!stale)
+            return cachedApplier;
+    }
+
+    cachedApplier
+        = std::make_shared<SqlQueryFunctionApplier>(this, functionConfig);
+
+    return cachedApplier;
+}
+
 std::unique_ptr<FunctionApplier>
 SqlQueryFunction::
 bind(SqlBindingScope & outerContext,
      const std::shared_ptr<RowValueInfo> & input) const
 {
+    // Each caller gets its own applier object, but they share the bound
+    // pipeline, which is where the binding work is
     std::unique_ptr<SqlQueryFunctionApplier> result
-        (new SqlQueryFunctionApplier(this, functionConfig));
+        (new SqlQueryFunctionApplier(*getApplier()));
 
     result->info.checkInputCompatibility(*input);
 
@@ -304,8 +348,7 @@ FunctionInfo
 SqlQueryFunction::
 getFunctionInfo() const
 {
-    SqlQueryFunctionApplier applier(this, functionConfig);
-    return applier.info;
+    return getApplier()->info;
 }
 
 static RegisterFunctionType<SqlQueryFunction, SqlQueryFunctionConfig>
@@ -576,9 +619,50 @@ run(const ProcedureRunConfig & run,
     auto boundDataset = runProcConf.inputData.stm->from->bind(context);
     if (runProcConf.inputData.stm->groupBy.clauses.empty() && aggregators.empty()) {
 
-        // We accumulate multiple rows per thread and insert with recordRows
-        // to be more efficient.
-        PerThreadAccumulator<std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > > accum;
+        // Rows flow straight from the query executor into the output
+        // dataset's chunk recorder, so the transform never holds more
+        // than one partial chunk per thread.  Recording happens on the
+        // executor's threads, so a slow output naturally throttles the
+        // query instead of letting rows pile up in between.
+        constexpr size_t ROWS_PER_CHUNK = 65536;
+        constexpr size_t FLUSH_ROWS = 1024;
+
+        Dataset::MultiChunkRecorder recorder = output->getChunkRecorder();
+
+        struct ThreadAccum {
+            /// Recorder for the chunk this thread is currently filling
+            std::unique_ptr<Recorder> threadRecorder;
+            /// Rows already recorded into the current chunk
+            size_t rowsInChunk = 0;
+            /// Small buffer so rows are handed over in batches
+            std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > rows;
+        };
+
+        PerThreadAccumulator<ThreadAccum> accum;
+        std::atomic<size_t> chunkNumber(0);
+
+        auto flush = [&recorder, &chunkNumber] (ThreadAccum & threadAccum,
+                                                bool finish)
+            {
+                if (!threadAccum.rows.empty()) {
+                    if (!threadAccum.threadRecorder)
+                        threadAccum.threadRecorder
+                            = recorder.newChunk(chunkNumber.fetch_add(1));
+                    threadAccum.rowsInChunk += threadAccum.rows.size();
+                    threadAccum.threadRecorder
+                        ->recordRowsDestructive(std::move(threadAccum.rows));
+                    threadAccum.rows.clear();
+                }
+
+                // Cut the chunk once it's full so that it can be frozen
+                // and its mutable representation released
+                if (threadAccum.threadRecorder
+                    && (finish || threadAccum.rowsInChunk >= ROWS_PER_CHUNK)) {
+                    threadAccum.threadRecorder->finishedChunk();
+                    threadAccum.threadRecorder.reset();
+                    threadAccum.rowsInChunk = 0;
+                }
+            };
 
         auto recordRowInOutputDataset
             = [&] (NamedRowValue & row_,
@@ -589,23 +673,25 @@ run(const ProcedureRunConfig & run,
                 std::vector<std::tuple<ColumnName, CellValue, Date> > cols
                     = filterEmptyColumns(row);
 
-                if (!skipEmptyRows || cols.size() > 0) {
-                    auto & rows = accum.get();
-                    rows.reserve(10000);
-                    try {
-                        rows.emplace_back(calc.at(0).coerceToPath(),
-                                          std::move(cols));
-                    } catch (...) {
-                        cerr << "parsing " << calc.at(0).toUtf8String() << endl;
-                        throw;
-                    }
-
-                    if (rows.size() >= 10000) {
-                        output->recordRows(rows);
-                        rows.clear();
-                    }
+                if (skipEmptyRows && cols.empty())
+                    return true;
+
+                RowName rowName;
+                try {
+                    rowName = calc.at(0).coerceToPath();
+                } catch (...) {
+                    cerr << "parsing " << calc.at(0).toUtf8String() << endl;
+                    throw;
                 }
 
+                auto & threadAccum = accum.get();
+                threadAccum.rows.reserve(FLUSH_ROWS);
+                threadAccum.rows.emplace_back(std::move(rowName),
+                                              std::move(cols));
+
+                if (threadAccum.rows.size() >= FLUSH_ROWS)
+                    flush(threadAccum, false /* finish */);
+
                 return true;
             };
 
@@ -622,10 +708,10 @@ run(const ProcedureRunConfig & run,
                      runProcConf.inputData.stm->limit,
                      onProgress);
 
-        // Finish off the last bits of each thread
-        accum.forEach([&] (std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > * rows)
+        // Finish off the partial chunk of each thread
+        accum.forEach([&] (ThreadAccum * threadAccum)
                       {
-                          output->recordRows(*rows);
+                          flush(*threadAccum, true /* finish */);
                       });
     }
     else {
@@ -14,12 +14,15 @@
 #include "mldb/core/dataset.h"
 #include "mldb/sql/sql_expression.h"
 
+#include <mutex>
+
 namespace Datacratic {
 namespace MLDB {
 
 struct SqlExpression;
 struct SqlExpressionMldbScope;
 struct SqlExpressionExtractScope;
+struct SqlQueryFunctionApplier;
 
 
 /*****************************************************************************/
@@ -68,6 +71,17 @@ struct SqlQueryFunction: public Function {
     virtual FunctionInfo getFunctionInfo() const;
 
     SqlQueryFunctionConfig functionConfig;
+
+private:
+    /** Return the bound plan for the function's query, rebinding it if a
+        dataset it was bound against has changed since (see
+        Dataset::getVersion()).  Binding is expensive compared to running
+        a small query, so the plan is reused across applications.
+    */
+    std::shared_ptr<const SqlQueryFunctionApplier> getApplier() const;
+
+    mutable std::mutex applierLock;
+    mutable std::shared_ptr<const SqlQueryFunctionApplier> cachedApplier;
 };
 
 
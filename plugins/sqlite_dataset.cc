@@ -105,6 +105,21 @@ SqliteSparseDatasetConfigDescription()
 {
     addField("dataFileUrl", &SqliteSparseDatasetConfig::dataFileUrl,
              "URI (must be file://) under which the database data lives");
+    addField("pageCacheSizeKb", &SqliteSparseDatasetConfig::pageCacheSizeKb,
+             "Size in kilobytes of the SQLite page cache for each "
+             "connection.  Zero (the default) keeps SQLite's built-in "
+             "default.  Metadata-heavy workloads benefit from a cache "
+             "large enough to hold the hot interior index pages.",
+             (int64_t)0);
+    addField("journalMode", &SqliteSparseDatasetConfig::journalMode,
+             "SQLite journal_mode pragma: one of 'delete', 'truncate', "
+             "'persist', 'memory', 'wal' or 'off'.",
+             std::string("wal"));
+    addField("synchronous", &SqliteSparseDatasetConfig::synchronous,
+             "SQLite synchronous pragma: one of 'off', 'normal', 'full' "
+             "or 'extra'.  Lower settings trade durability on power "
+             "loss for write throughput.",
+             std::string("normal"));
 }
 
 
@@ -120,6 +135,47 @@ struct SqliteSparseDataset::Itl
             : sqlite3pp::database(filename.empty() ? ("file::" + id + "?mode=memory&cache=shared").rawData() : filename.c_str())
         {
         }
+
+        /** Prepared statements reused across operations on this
+            connection, keyed on the SQL text.  The point operations all
+            use the same handful of literal statements, so in steady
+            state no SQL is re-parsed.  Bounded because the scan queries
+            splice OFFSET and LIMIT values into their text; when full,
+            the cache is simply cleared (the statements are cheap to
+            re-prepare once).
+        */
+        std::map<std::string, std::unique_ptr<sqlite3pp::query> > queryCache;
+        std::map<std::string, std::unique_ptr<sqlite3pp::command> > commandCache;
+
+        static constexpr size_t MAX_CACHED_STATEMENTS = 64;
+
+        sqlite3pp::query & getQuery(const std::string & sql)
+        {
+            auto it = queryCache.find(sql);
+            if (it == queryCache.end()) {
+                if (queryCache.size() >= MAX_CACHED_STATEMENTS)
+                    queryCache.clear();
+                it = queryCache.emplace
+                    (sql, std::unique_ptr<sqlite3pp::query>
+                          (new sqlite3pp::query(*this, sql.c_str()))).first;
+            }
+            else it->second->reset();
+            return *it->second;
+        }
+
+        sqlite3pp::command & getCommand(const std::string & sql)
+        {
+            auto it = commandCache.find(sql);
+            if (it == commandCache.end()) {
+                if (commandCache.size() >= MAX_CACHED_STATEMENTS)
+                    commandCache.clear();
+                it = commandCache.emplace
+                    (sql, std::unique_ptr<sqlite3pp::command>
+                          (new sqlite3pp::command(*this, sql.c_str()))).first;
+            }
+            else it->second->reset();
+            return *it->second;
+        }
     };
 
     struct Connection: public std::unique_ptr<Database> {
@@ -139,10 +195,12 @@ struct SqliteSparseDataset::Itl
 
     };
 
-    Itl(const Url & url, const Utf8String & id)
+    Itl(const SqliteSparseDatasetConfig & config, const Utf8String & id)
+        : config(config)
     {
         initRoutes();
 
+        const Url & url = config.dataFileUrl;
         if (url.scheme() != "file" && !url.empty())
             throw HttpReturnException(400, "SQLite database requires file:// "
                                       "URI, passed '" + url.toUtf8String() + "'");
@@ -157,6 +215,7 @@ struct SqliteSparseDataset::Itl
     {
     }
 
+    SqliteSparseDatasetConfig config;
     std::string filename;
     Utf8String id;
 
@@ -285,7 +344,7 @@ struct SqliteSparseDataset::Itl
             cerr << explainQuery << endl << explanation;
         }
 
-        sqlite3pp::query query(*db, queryStr.c_str());
+        sqlite3pp::query & query = db->getQuery(queryStr);
 
         bindArgs(query, 1, std::forward<Args>(args)...);
 
@@ -440,13 +499,14 @@ struct SqliteSparseDataset::Itl
         return result;
     }
 
-    virtual int getRowNum(sqlite3pp::database & db, const RowName & rowName)
+    virtual int getRowNum(Database & db, const RowName & rowName)
     {
         RowHash rowHash(rowName);
         std::string rowNameStr = rowName.toUtf8String().rawString();
 
         {
-            sqlite3pp::command command(db,"INSERT OR IGNORE INTO rows VALUES (NULL, ?, ?)");
+            sqlite3pp::command & command
+                = db.getCommand("INSERT OR IGNORE INTO rows VALUES (NULL, ?, ?)");
             bindArg(command, 1, rowHash);
             bindArg(command, 2, rowNameStr.c_str());
             command.execute();
@@ -478,7 +538,8 @@ struct SqliteSparseDataset::Itl
 
 
 
-        sqlite3pp::query query(db, "SELECT rowNum FROM rows WHERE rowHash = ? LIMIT 1");
+        sqlite3pp::query & query
+            = db.getQuery("SELECT rowNum FROM rows WHERE rowHash = ? LIMIT 1");
         bindArg(query, 1, rowHash);
         for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
             return (*i).get<int>(0);
@@ -487,7 +548,7 @@ struct SqliteSparseDataset::Itl
         throw HttpReturnException(400, "Couldn't get a row number");
     }
 
-    virtual int getColNum(sqlite3pp::database & db, const ColumnName & colName)
+    virtual int getColNum(Database & db, const ColumnName & colName)
     {
         ColumnHash colHash(colName);
         auto it = colNumCache.find(colHash);
@@ -495,9 +556,10 @@ struct SqliteSparseDataset::Itl
             return it->second;
 
         std::string colNameStr = colName.toUtf8String().rawString();
-        
+
         {
-            sqlite3pp::command command(db,"INSERT OR IGNORE INTO cols VALUES (NULL, ?, ?)");
+            sqlite3pp::command & command
+                = db.getCommand("INSERT OR IGNORE INTO cols VALUES (NULL, ?, ?)");
             bindArg(command, 1, colHash);
             bindArg(command, 2, colNameStr.c_str());
             command.execute();
@@ -505,7 +567,8 @@ struct SqliteSparseDataset::Itl
 
         //dumpQuery(db, "SELECT * FROM cols");
 
-        sqlite3pp::query query(db, "SELECT colNum FROM cols WHERE colHash = ? AND colName = ? LIMIT 1");
+        sqlite3pp::query & query
+            = db.getQuery("SELECT colNum FROM cols WHERE colHash = ? AND colName = ? LIMIT 1");
         bindArgs(query, 1, colHash, colNameStr.c_str());
         for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
             int result = (*i).get<int>(0);
@@ -531,7 +594,8 @@ struct SqliteSparseDataset::Itl
 
         sqlite3pp::transaction trans(*db);
 
-        sqlite3pp::command command(*db, "INSERT OR IGNORE INTO vals VALUES (?, ?, ?, ?)");
+        sqlite3pp::command & command
+            = db->getCommand("INSERT OR IGNORE INTO vals VALUES (?, ?, ?, ?)");
 
         for (auto & r: rows) {
 
@@ -674,11 +738,38 @@ struct SqliteSparseDataset::Itl
             };
 
         doCommand("PRAGMA busy_timeout=10000");
-        doCommand("PRAGMA journal_mode=WAL");
-        doCommand("PRAGMA synchronous=NORMAL");
+        doCommand("PRAGMA journal_mode="
+                  + validatePragma("journalMode", config.journalMode,
+                                   { "delete", "truncate", "persist",
+                                     "memory", "wal", "off" }));
+        doCommand("PRAGMA synchronous="
+                  + validatePragma("synchronous", config.synchronous,
+                                   { "off", "normal", "full", "extra" }));
         doCommand("PRAGMA locking_mode=NORMAL");
         doCommand("PRAGMA foreign_keys=ON");
         doCommand("PRAGMA mmap_size=10000000000");
+
+        // Negative cache_size means size in KiB rather than pages
+        if (config.pageCacheSizeKb > 0)
+            doCommand("PRAGMA cache_size=-"
+                      + to_string(config.pageCacheSizeKb));
+    }
+
+    /** Check a pragma value from the dataset config against its allowed
+        values; pragmas can't be bound as statement parameters, so only
+        whitelisted values may be spliced into the command.
+    */
+    static std::string validatePragma(const std::string & field,
+                                      std::string value,
+                                      const std::set<std::string> & allowed)
+    {
+        for (auto & c: value)
+            c = tolower(c);
+        if (!allowed.count(value))
+            throw HttpReturnException(400, "Invalid value '" + value
+                                      + "' for sqliteSparse dataset config "
+                                      "field '" + field + "'");
+        return value;
     }
 
     Connection getConnection() const
@@ -710,7 +801,7 @@ SqliteSparseDataset(MldbServer * owner,
 {
     if (!config.params.empty())
         datasetConfig = config.params.convert<SqliteSparseDatasetConfig>();
-    itl.reset(new Itl(datasetConfig.dataFileUrl, config.id));
+    itl.reset(new Itl(datasetConfig, config.id));
 }
     
 SqliteSparseDataset::
@@ -744,7 +835,8 @@ void
 SqliteSparseDataset::
 commit()
 {
-    return itl->commit();
+    itl->commit();
+    bumpVersion();
 }
     
 std::pair<Date, Date>
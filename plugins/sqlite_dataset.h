@@ -23,10 +23,16 @@ namespace MLDB {
 
 struct SqliteSparseDatasetConfig {
     SqliteSparseDatasetConfig()
+        : pageCacheSizeKb(0),
+          journalMode("wal"),
+          synchronous("normal")
     {
     }
 
     Url dataFileUrl;  /// must be file://
+    int64_t pageCacheSizeKb;   ///< Page cache per connection; 0 = default
+    std::string journalMode;   ///< SQLite journal_mode pragma
+    std::string synchronous;   ///< SQLite synchronous pragma
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(SqliteSparseDatasetConfig);
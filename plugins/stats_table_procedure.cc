@@ -27,8 +27,11 @@
 #include "mldb/vfs/filter_streams.h"
 #include "mldb/plugins/sql_config_validator.h"
 #include "mldb/base/parallel.h"
+#include "mldb/server/per_thread_accumulator.h"
 #include "mldb/types/optional_description.h"
 
+#include <atomic>
+
 
 using namespace std;
 
@@ -98,6 +101,23 @@ increment(const CellValue & val, const vector<uint> & outcomes) {
     return it->second;
 }
 
+void
+StatsTable::
+add(const StatsTable & other)
+{
+    ExcAssertEqual(other.outcome_names.size(), outcome_names.size());
+
+    for(auto & it : other.counts) {
+        auto res = counts.emplace(it.first, it.second);
+        if(!res.second) {
+            BucketCounts & ours = res.first->second;
+            ours.first += it.second.first;
+            for(int i=0; i<ours.second.size(); i++)
+                ours.second[i] += it.second.second[i];
+        }
+    }
+}
+
 const StatsTable::BucketCounts &
 StatsTable::
 getCounts(const CellValue & val) const
@@ -681,16 +701,24 @@ run(const ProcedureRunConfig & run,
             return onProgress(value);
         };
 
-    int num_req = 0;
+    std::atomic<uint64_t> num_req(0);
     Date start = Date::now();
 
+    // Each worker thread accumulates into its own table, so the hot
+    // increment path touches no shared state and needs no locking;
+    // the tables are merged once the scan is done
+    PerThreadAccumulator<StatsTable> accum(
+        [&] () { return new StatsTable(ColumnName("words"), outcome_names); });
+
     auto processor = [&] (NamedRowValue & row_,
                            const std::vector<ExpressionValue> & extraVals)
         {
             MatrixNamedRow row = row_.flattenDestructive();
-            if(num_req++ % 10000 == 0) {
+            uint64_t req = num_req.fetch_add(1);
+            if(req % 10000 == 0) {
                 double secs = Date::now().secondsSinceEpoch() - start.secondsSinceEpoch();
-                string progress = ML::format("done %d. %0.4f/sec", num_req, num_req / secs);
+                string progress = ML::format("done %lld. %0.4f/sec",
+                                             (long long)req, req / secs);
                 onProgress2(progress);
                 cerr << progress << endl;
             }
@@ -701,8 +729,9 @@ run(const ProcedureRunConfig & run,
                 encodedLabels.push_back( !outcome.empty() && outcome.isTrue() );
             }
 
+            StatsTable & shard = accum.get();
             for(const std::tuple<ColumnName, CellValue, Date> & col : row.columns) {
-                statsTable.increment(CellValue(get<0>(col).toUtf8String()), encodedLabels);
+                shard.increment(CellValue(get<0>(col).toUtf8String()), encodedLabels);
             }
 
             return true;
@@ -719,11 +748,29 @@ run(const ProcedureRunConfig & run,
                    runProcConf.trainingData.stm->when,
                    *runProcConf.trainingData.stm->where,
                    extra,
-                   {processor,false/*processInParallel*/},
+                   {processor,true/*processInParallel*/},
                    runProcConf.trainingData.stm->orderBy,
                    runProcConf.trainingData.stm->offset,
                    runProcConf.trainingData.stm->limit);
 
+    // Merge the per-thread tables pairwise, in parallel, until one is
+    // left
+    std::vector<StatsTable *> shards;
+    accum.forEach([&] (StatsTable * t) { shards.push_back(t); });
+
+    while (shards.size() > 1) {
+        size_t keep = (shards.size() + 1) / 2;
+        auto mergePair = [&] (size_t i)
+            {
+                shards[i]->add(*shards[keep + i]);
+            };
+        parallelMap(0, shards.size() - keep, mergePair);
+        shards.resize(keep);
+    }
+
+    if (!shards.empty())
+        statsTable = std::move(*shards[0]);
+
     // Optionally save counts to a dataset
     if (runProcConf.outputDataset) {
         Date date0;
@@ -46,6 +46,11 @@ struct StatsTable {
                                    const std::vector<uint> & outcomes);
     const BucketCounts & getCounts(const CellValue & val) const;
 
+    /** Merge the counts of another table over the same outcomes into
+        this one.  Used to combine the per-thread tables of a parallel
+        accumulation. */
+    void add(const StatsTable & other);
+
     void save(const std::string & filename) const;
     void serialize(ML::DB::Store_Writer & store) const;
     void reconstitute(ML::DB::Store_Reader & store);
@@ -141,6 +146,9 @@ struct StatsTableFunction: public Function {
     /** Describe what the input and output is for this function. */
     virtual FunctionInfo getFunctionInfo() const;
 
+    /// Pure lookup into the loaded tables, so results can be memoized
+    virtual bool isDeterministic() const { return true; }
+
     StatsTableFunctionConfig functionConfig;
 
     StatsTablesMap statsTables;
@@ -269,6 +277,9 @@ struct StatsTablePosNegFunction: public Function {
     /** Describe what the input and output is for this function. */
     virtual FunctionInfo getFunctionInfo() const;
 
+    /// Pure lookup into the loaded tables, so results can be memoized
+    virtual bool isDeterministic() const { return true; }
+
     StatsTablePosNegFunctionConfig functionConfig;
 
 
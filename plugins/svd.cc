@@ -21,6 +21,8 @@
 #include "mldb/ml/svd_utils.h"
 #include "mldb/jml/utils/vector_utils.h"
 #include "mldb/ext/svdlibc/svdlib.h"
+#include "mldb/ml/algebra/lapack.h"
+#include <random>
 #include "mldb/types/basic_value_descriptions.h"
 #include "mldb/types/distribution_description.h"
 #include "mldb/types/optional_description.h"
@@ -91,6 +93,24 @@ SvdConfigDescription()
              "The runtime goes up with the square of this parameter, "
              "in other words 10 times as many is 100 times as long to run.",
              2000);
+    addField("engine", &SvdConfig::engine,
+             "Solver used to compute the decomposition.  `lanczos` uses the "
+             "svdlibc LAS2 iterative solver.  `randomized` uses a randomized "
+             "projection onto the leading subspace followed by a small dense "
+             "SVD; it is multithreaded and much faster when "
+             "`numDenseBasisVectors` is large, at the cost of slightly less "
+             "accurate small singular values.", std::string("lanczos"));
+    addField("mode", &SvdConfig::mode,
+             "Training mode.  `full` recomputes the decomposition from "
+             "scratch.  `incremental` loads the model previously written to "
+             "`modelFileUrl` and folds the current columns into that basis, "
+             "keeping its singular values and basis vectors; this is much "
+             "faster when only a small fraction of the data changed between "
+             "runs.  Columns that appeared since the previous run are "
+             "projected onto the existing basis.  The approximation degrades "
+             "as the data drifts away from the basis, so schedule a periodic "
+             "`full` run to refresh it.  If no previous model can be loaded, "
+             "a full recompute is performed.", std::string("full"));
     addField("outputColumn", &SvdConfig::outputColumn,
              "Base name of the column that will be written by the SVD.  "
              "It will be an embedding with numSingularValues elements.",
@@ -402,9 +422,17 @@ struct SvdTrainer {
     static SvdBasis calcSvdBasis(const ColumnCorrelations & correlations,
                                  int numSingularValues);
 
+    static SvdBasis calcRandomizedSvdBasis(const ColumnCorrelations & correlations,
+                                           int numSingularValues);
+
     static SvdBasis calcRightSingular(const ClassifiedColumns & columns,
                                       const ColumnIndexEntries & columnIndex,
                                       const SvdBasis & svd);
+
+    static SvdBasis foldInBasis(const ClassifiedColumns & columns,
+                                const ColumnIndexEntries & columnIndex,
+                                const SvdBasis & previous,
+                                int numDenseBasisVectors);
 };
 
 SvdBasis
@@ -552,6 +580,162 @@ calcSvdBasis(const ColumnCorrelations & correlations,
     return result;
 }
 
+SvdBasis
+SvdTrainer::
+calcRandomizedSvdBasis(const ColumnCorrelations & correlations,
+                       int numSingularValues)
+{
+    int ndims = correlations.columnCount();
+
+    ML::Timer timer;
+
+    if (numSingularValues > ndims)
+        numSingularValues = ndims;
+
+    // Oversampling gives the range finder headroom to capture the leading
+    // subspace accurately; the extra dimensions are dropped at the end.
+    int rank = std::min(ndims, numSingularValues + 10);
+
+    // y = Bx over a block of vectors, one thread per vector.  This is the
+    // same product as the Lanczos opb function, but over the whole block
+    // at once instead of one vector per iteration.
+    auto multiply = [&] (const std::vector<ML::distribution<double> > & x,
+                         std::vector<ML::distribution<double> > & y)
+        {
+            auto doVector = [&] (size_t i)
+                {
+                    for (unsigned r = 0;  r < ndims;  ++r)
+                        y[i][r] = ML::SIMD::vec_dotprod_dp
+                            (&correlations.correlations[r][0], &x[i][0],
+                             ndims);
+                };
+
+            Datacratic::parallelMap(0, x.size(), doVector);
+        };
+
+    // Modified Gram-Schmidt over the block
+    auto orthonormalize = [&] (std::vector<ML::distribution<double> > & vecs)
+        {
+            for (unsigned i = 0;  i < vecs.size();  ++i) {
+                for (unsigned j = 0;  j < i;  ++j) {
+                    double d = ML::SIMD::vec_dotprod(&vecs[j][0], &vecs[i][0],
+                                                     ndims);
+                    ML::SIMD::vec_add(&vecs[i][0], -d, &vecs[j][0],
+                                      &vecs[i][0], ndims);
+                }
+                double norm = std::sqrt(ML::SIMD::vec_dotprod
+                                        (&vecs[i][0], &vecs[i][0], ndims));
+                if (norm > 0.0)
+                    vecs[i] /= norm;
+            }
+        };
+
+    std::vector<ML::distribution<double> >
+        q(rank, ML::distribution<double>(ndims)),
+        bq(rank, ML::distribution<double>(ndims));
+
+    std::mt19937 rng(12345);
+    std::normal_distribution<double> gaussian;
+    for (auto & v: q)
+        for (auto & e: v)
+            e = gaussian(rng);
+
+    // Range finder with power iterations: every multiplication by the
+    // (symmetric, positive semi-definite) correlation matrix aligns the
+    // block further with the leading eigenspace; re-orthonormalizing
+    // between products keeps it from collapsing onto the top eigenvector.
+    int numIterations = 3;
+    for (int iter = 0;  iter < numIterations;  ++iter) {
+        orthonormalize(q);
+        multiply(q, bq);
+        std::swap(q, bq);
+    }
+    orthonormalize(q);
+    multiply(q, bq);
+
+    // Project into the subspace: t = q'Bq, a small dense symmetric matrix
+    boost::multi_array<double, 2> t(boost::extents[rank][rank]);
+    for (unsigned i = 0;  i < rank;  ++i)
+        for (unsigned j = 0;  j < rank;  ++j)
+            t[i][j] = ML::SIMD::vec_dotprod(&q[i][0], &bq[j][0], ndims);
+
+    // The SVD of t is its eigendecomposition since t is symmetric PSD.
+    // The eigenvalues of B = A'A are the squared singular values of the
+    // implicit matrix A, matching what LAS2 reports.
+    ML::distribution<double> eigenvalues(rank);
+    boost::multi_array<double, 2> ut(boost::extents[rank][rank]);
+    boost::multi_array<double, 2> vt(boost::extents[rank][rank]);
+
+    int res = ML::LAPack::gesdd("S", rank, rank,
+                                t.data(), rank,
+                                &eigenvalues[0],
+                                &ut[0][0], rank,
+                                &vt[0][0], rank);
+    if (res != 0)
+        throw ML::Exception("gesdd returned non-zero");
+
+    cerr << "done randomized SVD " << timer.elapsed() << endl;
+
+    // Only keep the usable values, like the Lanczos path does.  The 1e-18
+    // ratio corresponds to its 1e-9 cutoff on unsquared singular values.
+    unsigned realD = 0;
+    while (realD < numSingularValues
+           && isfinite(eigenvalues[realD])
+           && eigenvalues[realD] > 0.0
+           && eigenvalues[realD] / eigenvalues[0] > 1e-18)
+        ++realD;
+
+    cerr << "skipped " << numSingularValues - realD
+         << " bad singular values" << endl;
+
+    numSingularValues = realD;
+
+    SvdBasis result;
+    result.modelTs = correlations.modelTs;
+    result.singularValues.resize(numSingularValues);
+    for (unsigned i = 0;  i < numSingularValues;  ++i)
+        result.singularValues[i] = std::sqrt(eigenvalues[i]);
+
+    cerr << "svalues = " << result.singularValues << endl;
+
+    result.columns.resize(ndims);
+    std::copy(correlations.columns.begin(), correlations.columns.end(),
+              result.columns.begin());
+
+    // Rotate the subspace eigenvectors back into the full space:
+    // v_j = sum_c ut[j][c] q[c].  gesdd fills U in column-major order, so
+    // row j of ut holds the vector for the j-th eigenvalue.
+    std::vector<ML::distribution<double> >
+        v(numSingularValues, ML::distribution<double>(ndims));
+
+    auto doRotate = [&] (size_t j)
+        {
+            for (unsigned c = 0;  c < rank;  ++c)
+                ML::SIMD::vec_add(&v[j][0], ut[j][c], &q[c][0], &v[j][0],
+                                  ndims);
+        };
+
+    Datacratic::parallelMap(0, numSingularValues, doRotate);
+
+    for (unsigned i = 0;  i < ndims;  ++i) {
+        ML::distribution<float> & d = result.columns[i].singularVector;
+        d.resize(numSingularValues);
+        for (unsigned j = 0;  j < numSingularValues;  ++j)
+            d[j] = v[j][i];
+
+        ColumnName columnName = result.columns[i].columnName;
+        CellValue cellValue = result.columns[i].cellValue;
+
+        result.columnIndex[columnName].values[cellValue] = i;
+        result.columnIndex[columnName].columnName = columnName;
+    }
+
+    for (auto & i: result.columnIndex)
+        ExcAssertNotEqual(i.second.columnName, ColumnName());
+
+    return result;
+}
+
 SvdBasis
 SvdTrainer::
 calcRightSingular(const ClassifiedColumns & columns,
@@ -652,6 +836,99 @@ calcRightSingular(const ClassifiedColumns & columns,
     return result;
 }
 
+SvdBasis
+SvdTrainer::
+foldInBasis(const ClassifiedColumns & columns,
+            const ColumnIndexEntries & columnIndex,
+            const SvdBasis & previous,
+            int numDenseBasisVectors)
+{
+    ML::Timer timer;
+
+    size_t totalColumns = columns.continuousColumns.size()
+        + columns.sparseColumns.size();
+    size_t numSingularValues = previous.numSingularValues();
+
+    // Match the previous run's basis up with the entries of the current
+    // data.  Columns that appeared since the last full recompute aren't
+    // in the previous model so can't contribute to the basis; they still
+    // get a singular vector as fold-in targets below.
+    std::vector<std::pair<const ColumnIndexEntry *,
+                          const ML::distribution<float> *> > basis;
+    basis.reserve(std::min<size_t>(numDenseBasisVectors, totalColumns));
+
+    for (size_t i = 0;
+         i < totalColumns && basis.size() < (size_t)numDenseBasisVectors;
+         ++i) {
+        auto it = previous.columnIndex.find(columnIndex[i].columnName);
+        if (it == previous.columnIndex.end())
+            continue;
+        auto jt = it->second.values.find(columnIndex[i].cellValue);
+        if (jt == it->second.values.end())
+            continue;
+        const auto & vec = previous.columns.at(jt->second).singularVector;
+        if (vec.size() != numSingularValues)
+            continue;
+        basis.emplace_back(&columnIndex[i], &vec);
+    }
+
+    if (basis.empty())
+        throw HttpReturnException
+            (400, "SVD incremental update found no columns in common with "
+             "the previous model; run a full recompute instead");
+
+    cerr << "folding " << totalColumns << " columns into a basis of "
+         << basis.size() << " columns" << endl;
+
+    SvdBasis result;
+    result.modelTs = columnIndex.modelTs;
+    result.singularValues = previous.singularValues;
+    result.columns.resize(totalColumns);
+
+    ML::distribution<float> sv2
+        = previous.singularValues * previous.singularValues;
+
+    auto doColumn = [&] (size_t i)
+        {
+            // Same projection as rightSingularVector(), but against the
+            // previous run's basis with overlaps measured on today's data
+            ML::distribution<float> vec(numSingularValues);
+            for (auto & b: basis) {
+                double overlap = columnIndex[i].correlation(*b.first);
+                if (overlap == 0.0)
+                    continue;
+                vec += overlap * *b.second;
+            }
+            vec /= sv2;
+
+            SvdColumnEntry column;
+            column = columnIndex[i];
+            column.singularVector = std::move(vec);
+
+            result.columns[i] = std::move(column);
+        };
+
+    parallelMap(0, totalColumns, doColumn);
+
+    cerr << "done incremental SVD fold-in in " << timer.elapsed() << endl;
+
+    for (unsigned i = 0;  i < totalColumns;  ++i) {
+        ColumnName columnName = result.columns[i].columnName;
+        CellValue cellValue = result.columns[i].cellValue;
+        if (result.columns[i].op == COL_VALUE)
+            ExcAssertEqual(cellValue, CellValue());
+
+        result.columnIndex[columnName].values[cellValue] = i;
+        result.columnIndex[columnName].columnName = columnName;
+    }
+
+    for (auto & c: result.columns) {
+        ExcAssertNotEqual(c.columnName, ColumnName());
+    }
+
+    return result;
+}
+
 
 /*****************************************************************************/
 /* SVD PROCEDURE                                                              */
@@ -729,18 +1006,70 @@ run(const ProcedureRunConfig & run,
                                                                runProcConf.trainingData.stm->limit,
                                                                columns);
     ColumnIndexEntries columnIndex = invertFeatures(columns, extractedFeatures);
-    ColumnCorrelations correlations = calculateCorrelations(columnIndex, numBasisVectors);
-    SvdBasis svd = SvdTrainer::calcSvdBasis(correlations,
-                                            runProcConf.numSingularValues);
 
-#if 0
-    cerr << "----------- SVD columns" << endl;
-    for (auto & c: svd.columns) {
-        cerr << "name " << c.columnName << " val " << c.cellValue << " op " << c.op << endl;
+    SvdBasis previousBasis;
+    bool incremental = false;
+
+    if (runProcConf.mode == "incremental") {
+        if (runProcConf.modelFileUrl.empty())
+            throw HttpReturnException
+                (400, "SVD incremental mode requires modelFileUrl to point "
+                 "to the model written by a previous run");
+        try {
+            previousBasis = jsonDecodeFile<SvdBasis>
+                (runProcConf.modelFileUrl.toString());
+
+            // Deal with the older version of the file
+            std::map<ColumnHash, SvdColumnIndexEntry> columnIndex2;
+            for (auto & c: previousBasis.columnIndex) {
+                columnIndex2[c.second.columnName] = std::move(c.second);
+            }
+            previousBasis.columnIndex = std::move(columnIndex2);
+
+            incremental = previousBasis.numSingularValues() > 0;
+        } catch (const std::exception & exc) {
+            // No usable previous model; this run becomes the periodic
+            // full recompute
+            cerr << "SVD incremental mode: could not load previous model "
+                 << "from " << runProcConf.modelFileUrl.toString()
+                 << ": " << exc.what() << "; doing a full recompute" << endl;
+        }
     }
+    else if (runProcConf.mode != "full") {
+        throw HttpReturnException(400, "unknown SVD mode '"
+                                  + runProcConf.mode
+                                  + "': expected 'full' or 'incremental'",
+                                  "mode", runProcConf.mode);
+    }
+
+    SvdBasis allSvd;
+    if (incremental) {
+        allSvd = SvdTrainer::foldInBasis(columns, columnIndex, previousBasis,
+                                         numBasisVectors);
+    }
+    else {
+        ColumnCorrelations correlations = calculateCorrelations(columnIndex, numBasisVectors);
+        SvdBasis svd;
+        if (runProcConf.engine == "lanczos")
+            svd = SvdTrainer::calcSvdBasis(correlations,
+                                           runProcConf.numSingularValues);
+        else if (runProcConf.engine == "randomized")
+            svd = SvdTrainer::calcRandomizedSvdBasis(correlations,
+                                                     runProcConf.numSingularValues);
+        else throw HttpReturnException(400, "unknown SVD engine '"
+                                       + runProcConf.engine
+                                       + "': expected 'lanczos' or 'randomized'",
+                                       "engine", runProcConf.engine);
+
+#if 0
+        cerr << "----------- SVD columns" << endl;
+        for (auto & c: svd.columns) {
+            cerr << "name " << c.columnName << " val " << c.cellValue << " op " << c.op << endl;
+        }
 #endif
 
-    SvdBasis allSvd = SvdTrainer::calcRightSingular(columns, columnIndex, svd);
+        allSvd = SvdTrainer::calcRightSingular(columns, columnIndex, svd);
+    }
 
 #if 0
     cerr << "----------- ALL SVD columns" << endl;
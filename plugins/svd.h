@@ -29,7 +29,9 @@ struct SvdConfig : ProcedureConfig {
     SvdConfig()
         : outputColumn("embedding"),
           numSingularValues(100),
-          numDenseBasisVectors(1000)
+          numDenseBasisVectors(1000),
+          engine("lanczos"),
+          mode("full")
     {
     }
 
@@ -42,6 +44,8 @@ struct SvdConfig : ProcedureConfig {
     PathElement outputColumn;
     int numSingularValues;
     int numDenseBasisVectors;
+    std::string engine;        ///< Solver: "lanczos" or "randomized"
+    std::string mode;          ///< "full" recompute or "incremental" fold-in
     Utf8String functionName;
 };
 
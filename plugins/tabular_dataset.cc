@@ -10,7 +10,11 @@
 #include "frozen_column.h"
 #include "tabular_dataset_column.h"
 #include "tabular_dataset_chunk.h"
+#include "tabular_persistence.h"
+#include "mldb/jml/utils/file_functions.h"
+#include "mldb/sql/sql_expression_operations.h"
 #include "mldb/arch/timers.h"
+#include "mldb/arch/bitops.h"
 #include "mldb/types/basic_value_descriptions.h"
 #include "mldb/ml/jml/training_index_entry.h"
 #include "mldb/jml/utils/smart_ptr_utils.h"
@@ -18,11 +22,24 @@
 #include "mldb/base/thread_pool.h"
 #include "mldb/base/scope.h"
 #include "mldb/server/bucket.h"
+#include "mldb/server/bound_queries.h"
+#include "mldb/server/engine_stats.h"
+#include "mldb/server/mldb_server.h"
 #include "mldb/types/any_impl.h"
 #include "mldb/types/hash_wrapper_description.h"
 #include "mldb/http/http_exception.h"
+#include "mldb/rest/rest_request_binding.h"
 #include "mldb/utils/atomic_shared_ptr.h"
+#include "mldb/arch/gc_lock.h"
+#include "mldb/jml/utils/ring_buffer.h"
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
 #include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -33,6 +50,229 @@ static constexpr size_t TABULAR_DATASET_DEFAULT_ROWS_PER_CHUNK=65536;
 static constexpr size_t NUM_PARALLEL_CHUNKS=16;
 
 
+/*****************************************************************************/
+/* TABULAR WAL                                                               */
+/*****************************************************************************/
+
+/** Write-ahead log for a tabular dataset.  Rows are appended as compact
+    length-prefixed binary records before being recorded in memory, with
+    group commit: concurrent appenders share a single fdatasync.  On
+    startup any complete records are replayed; a torn record at the tail
+    (from a crash mid-write) stops the replay cleanly.  The log is
+    truncated once the dataset has been checkpointed to its persisted
+    file at commit time, so recovery replays the uncheckpointed window
+    instead of the whole import.
+*/
+
+struct TabularWal {
+    TabularWal(const std::string & filename)
+        : filename(filename), fd(-1),
+          appendGen(0), syncedGen(0), flushing(false)
+    {
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd == -1)
+            throw ML::Exception(errno, "opening tabular WAL " + filename);
+    }
+
+    ~TabularWal()
+    {
+        if (fd != -1)
+            ::close(fd);
+    }
+
+    /// Append one row; returns once the record is on disk.  Appenders
+    /// that arrive while a flush is in flight are all covered by the
+    /// single following fdatasync.
+    void append(const RowName & rowName,
+                const std::vector<std::tuple<ColumnName, CellValue, Date> > & vals)
+    {
+        std::string payload;
+        appendString(payload, rowName.toUtf8String().rawString());
+        appendU32(payload, vals.size());
+        for (auto & v: vals) {
+            appendString(payload, std::get<0>(v).toUtf8String().rawString());
+            appendString(payload, jsonEncodeStr(std::get<1>(v)));
+            double ts = std::get<2>(v).secondsSinceEpoch();
+            payload.append((const char *)&ts, sizeof(ts));
+        }
+
+        std::string record;
+        record.reserve(payload.size() + 8);
+        appendU32(record, payload.size());
+        appendU32(record, checksum(payload.data(), payload.size()));
+        record += payload;
+
+        std::unique_lock<std::mutex> guard(mutex);
+        pending += record;
+        uint64_t myGen = ++appendGen;
+
+        for (;;) {
+            if (syncedGen >= myGen)
+                return;   // someone else's flush covered us
+            if (!flushing)
+                break;    // our turn to flush
+            cond.wait(guard);
+        }
+
+        flushing = true;
+        std::string toWrite = std::move(pending);
+        pending.clear();
+        uint64_t flushedGen = appendGen;
+        guard.unlock();
+
+        writeAll(toWrite);
+        ::fdatasync(fd);
+
+        guard.lock();
+        syncedGen = flushedGen;
+        flushing = false;
+        cond.notify_all();
+    }
+
+    /// Truncate the log once its contents are durable elsewhere
+    void checkpoint()
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        while (flushing)
+            cond.wait(guard);
+        if (::ftruncate(fd, 0) == -1)
+            throw ML::Exception(errno, "truncating tabular WAL " + filename);
+    }
+
+    /** Replay complete records from the log, calling onRow for each.
+        Returns the number of rows replayed.  If validEndOut is given it
+        receives the file offset just past the last valid record, so the
+        caller can truncate a torn tail away before appending again.
+    */
+    static size_t
+    replay(const std::string & filename,
+           const std::function<void (RowName,
+                                     std::vector<std::tuple<ColumnName, CellValue, Date> >)> & onRow,
+           size_t * validEndOut = nullptr)
+    {
+        std::ifstream stream(filename, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(stream)),
+                             std::istreambuf_iterator<char>());
+
+        size_t numReplayed = 0;
+        size_t pos = 0;
+
+        auto readU32 = [&] (size_t & at) -> uint32_t
+            {
+                uint32_t result;
+                std::memcpy(&result, contents.data() + at, sizeof(result));
+                at += sizeof(result);
+                return result;
+            };
+
+        while (contents.size() - pos >= 8) {
+            size_t at = pos;
+            uint32_t payloadLength = readU32(at);
+            uint32_t expectedChecksum = readU32(at);
+
+            if (contents.size() - at < payloadLength)
+                break;  // torn record at the tail
+            if (checksum(contents.data() + at, payloadLength)
+                != expectedChecksum)
+                break;  // partial write of the record body
+
+            size_t payloadEnd = at + payloadLength;
+
+            auto readString = [&] () -> std::string
+                {
+                    uint32_t length = readU32(at);
+                    std::string result(contents, at, length);
+                    at += length;
+                    return result;
+                };
+
+            std::string rowNameStr = readString();
+            RowName rowName = RowName::parse(rowNameStr.data(),
+                                             rowNameStr.size());
+            uint32_t numVals = readU32(at);
+
+            std::vector<std::tuple<ColumnName, CellValue, Date> > vals;
+            vals.reserve(numVals);
+            for (uint32_t i = 0;  i < numVals;  ++i) {
+                std::string columnNameStr = readString();
+                ColumnName columnName
+                    = ColumnName::parse(columnNameStr.data(),
+                                        columnNameStr.size());
+                CellValue value = jsonDecodeStr<CellValue>(readString());
+                double ts;
+                std::memcpy(&ts, contents.data() + at, sizeof(ts));
+                at += sizeof(ts);
+                vals.emplace_back(std::move(columnName), std::move(value),
+                                  Date::fromSecondsSinceEpoch(ts));
+            }
+
+            ExcAssertEqual(at, payloadEnd);
+
+            onRow(std::move(rowName), std::move(vals));
+            ++numReplayed;
+            pos = payloadEnd;
+        }
+
+        if (pos != contents.size())
+            cerr << "tabular WAL " << filename << " has a torn record at "
+                 << "offset " << pos << "; replay stops there" << endl;
+
+        if (validEndOut)
+            *validEndOut = pos;
+
+        return numReplayed;
+    }
+
+private:
+    static uint32_t checksum(const char * p, size_t len)
+    {
+        uint32_t h = 2166136261U;  // FNV-1a
+        for (size_t i = 0;  i < len;  ++i) {
+            h ^= (uint8_t)p[i];
+            h *= 16777619U;
+        }
+        return h;
+    }
+
+    static void appendU32(std::string & s, uint32_t v)
+    {
+        s.append((const char *)&v, sizeof(v));
+    }
+
+    static void appendString(std::string & s, const std::string & str)
+    {
+        appendU32(s, str.size());
+        s.append(str);
+    }
+
+    void writeAll(const std::string & data)
+    {
+        const char * p = data.data();
+        size_t left = data.size();
+        while (left > 0) {
+            ssize_t written = ::write(fd, p, left);
+            if (written == -1) {
+                if (errno == EINTR)
+                    continue;
+                throw ML::Exception(errno, "writing tabular WAL " + filename);
+            }
+            p += written;
+            left -= written;
+        }
+    }
+
+    std::string filename;
+    int fd;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::string pending;      ///< Records waiting for the next flush
+    uint64_t appendGen;       ///< Generation of the latest append
+    uint64_t syncedGen;       ///< Generation covered by the last sync
+    bool flushing;            ///< A flush is currently in flight
+};
+
+
 /*****************************************************************************/
 /* TABULAR DATA STORE                                                        */
 /*****************************************************************************/
@@ -44,9 +284,32 @@ static constexpr size_t NUM_PARALLEL_CHUNKS=16;
 struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
 
     TabularDataStore(TabularDatasetConfig config)
-        : rowCount(0), config(std::move(config)),
-          backgroundJobsActive(0)
+        : rowCount(0), frozenChunks(nullptr), config(std::move(config)),
+          replicationServer(nullptr), replicationPolling(false),
+          backgroundJobsActive(0),
+          writeBehindStopping(false), writeBehindFailed(false)
     {
+        lastCommitTime = primaryCommitTime = lastSyncTime = Date::notADate();
+
+        if (this->config.writeBehind) {
+            writeBehindQueue.reset
+                (new ML::RingBufferSRMW<PendingRow>(WRITE_BEHIND_QUEUE_SIZE));
+            writeBehindThread
+                = std::thread([this] () { this->runWriteBehind(); });
+        }
+
+        initRoutes();
+    }
+
+    ~TabularDataStore()
+    {
+        // Stop the replication poll before anything it touches goes away
+        replicationTimer = WatchT<Date>();
+
+        stopWriteBehind(false /* rethrow */);
+
+        // Free any chunks that were handed off but never committed
+        popFrozenChunks();
     }
 
     /** A stream of row names used to incrementally query available rows
@@ -94,6 +357,21 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
             return row;
         }
 
+        virtual void advanceBy(size_t n)
+        {
+            while (chunkiter != store->chunks.end()) {
+                size_t leftInChunk = chunkiter->rowNames.end() - rowiter;
+                if (n < leftInChunk) {
+                    rowiter += n;
+                    return;
+                }
+                n -= leftInChunk;
+                ++chunkiter;
+                if (chunkiter != store->chunks.end())
+                    rowiter = chunkiter->rowNames.begin();
+            }
+        }
+
         TabularDataStore* store;
         std::vector<TabularDatasetChunk>::const_iterator chunkiter;
         std::vector<RowName>::const_iterator rowiter;
@@ -136,6 +414,18 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
     /// List of all chunks in the dataset
     std::vector<TabularDatasetChunk> chunks;
 
+    /// Index of the declared event-time column among the fixed columns,
+    /// or -1 when no timeColumn is configured or it isn't a fixed column
+    int timeColumnIndex = -1;
+
+    /** Sorted sparse index on the declared event-time column: for each
+        chunk, the row offsets ordered by that column's value (nulls left
+        out, since they never match a range).  The per-chunk zone maps
+        provide the block-level fences; this provides the within-chunk
+        ordering.  Parallel to chunks; rebuilt at each commit.
+    */
+    std::vector<std::vector<uint32_t> > timeIndexSortedRows;
+
     /** This structure handles a list of chunks that allows for them to be
         recorded in parallel.  It's used for the old recordRow interface.
         Most datasets should instead use the chunk oriented interface, and
@@ -147,13 +437,17 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
     struct ChunkList {
         ChunkList(size_t n)
             : chunks(new atomic_shared_ptr<MutableTabularDatasetChunk>[n]),
+              raw(new std::atomic<MutableTabularDatasetChunk *>[n]),
               n(n)
         {
+            for (size_t i = 0;  i < n;  ++i)
+                raw[i] = nullptr;
         }
 
         ~ChunkList()
         {
             delete[] chunks;
+            delete[] raw;
         }
 
         size_t size() const
@@ -168,6 +462,44 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
             return chunks[i].load();
         }
 
+        /** Raw pointer to the chunk in slot i, for callers inside a
+            critical section of the chunk GC lock.  The chunk it points
+            to stays alive until the section is exited, so no reference
+            counting is needed on the read path.
+        */
+        MutableTabularDatasetChunk * rawGet(size_t i) const
+        {
+            ExcAssertLess(i, n);
+            return raw[i].load(std::memory_order_acquire);
+        }
+
+        /// Publish a chunk in slot i, keeping the raw mirror in sync
+        void store(size_t i,
+                   std::shared_ptr<MutableTabularDatasetChunk> chunk)
+        {
+            ExcAssertLess(i, n);
+            MutableTabularDatasetChunk * p = chunk.get();
+            chunks[i].store(std::move(chunk));
+            raw[i].store(p, std::memory_order_release);
+        }
+
+        /** Rotate slot i from expected to newChunk.  Returns true if we
+            won the race; readers that load the raw mirror before it is
+            updated simply retry against the full chunk.
+        */
+        bool replace(size_t i,
+                     std::shared_ptr<MutableTabularDatasetChunk> & expected,
+                     std::shared_ptr<MutableTabularDatasetChunk> newChunk)
+        {
+            ExcAssertLess(i, n);
+            MutableTabularDatasetChunk * p = newChunk.get();
+            if (!chunks[i].compare_exchange_strong(expected,
+                                                   std::move(newChunk)))
+                return false;
+            raw[i].store(p, std::memory_order_release);
+            return true;
+        }
+
         const atomic_shared_ptr<MutableTabularDatasetChunk> * begin() const
         {
             return chunks;
@@ -189,6 +521,8 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         }
         
         atomic_shared_ptr<MutableTabularDatasetChunk> * chunks;
+        /// Mirror of chunks as plain pointers, for epoch-based readers
+        std::atomic<MutableTabularDatasetChunk *> * raw;
         size_t n;
     };
 
@@ -196,11 +530,77 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
     // Writing is protected by the dataset mutex
     atomic_shared_ptr<ChunkList> mutableChunks;
 
+    /** Raw mirror of mutableChunks, read by recorders inside a critical
+        section of mutableChunksGc.  Set (before mutableChunks) under
+        the dataset mutex; cleared (after mutableChunks) by commit().
+    */
+    std::atomic<ChunkList *> mutableChunksRaw = { nullptr };
+
+    /** Epoch lock protecting raw access to the mutable chunks.  The row
+        record path enters a shared critical section and works on plain
+        pointers for the duration of the row, so the hot path does no
+        reference counting at all; rotation and commit defer the release
+        of replaced chunks until all such readers have moved on.
+    */
+    GcLock mutableChunksGc;
+
+    /*  Finished chunks are handed off from the freeze jobs (multiple
+        producers) to commit() (the single consumer) through a lock
+        free push list, so that with many parse threads feeding the
+        freeze stage the hand off never contends on the dataset mutex.
+    */
+    struct FrozenChunkNode {
+        TabularDatasetChunk chunk;
+        FrozenChunkNode * next;
+    };
+
+    std::atomic<FrozenChunkNode *> frozenChunks;
+
     // Everything below here is protected by the dataset lock
-    std::vector<TabularDatasetChunk> frozenChunks;
 
-    /// Index from rowHash to (chunk, indexInChunk) when line number not used for rowName
-    ML::Lightweight_Hash<RowHash, std::pair<int, int> > rowIndex;
+    /** Index from rowHash to (chunk, indexInChunk) when line number not
+        used for rowName.  Sharded on the top bits of the hash so that
+        construction at commit time can fill one shard per thread;
+        lookups hash once and probe only their shard.  Not built at all
+        when the rowNameIndex config parameter is false.
+    */
+    struct RowIndex {
+        static constexpr size_t NUM_SHARDS = 32;
+
+        ML::Lightweight_Hash<RowHash, std::pair<int, int> >
+            shards[NUM_SHARDS];
+
+        /** The shard a hash belongs to.  Lightweight_Hash buckets on
+            the low bits, so the shard comes from the top bits. */
+        static size_t shardOf(RowHash h)
+        {
+            return h.hash() >> 59;
+        }
+
+        const std::pair<int, int> * find(RowHash h) const
+        {
+            const auto & shard = shards[shardOf(h)];
+            auto it = shard.find(h);
+            if (it == shard.end())
+                return nullptr;
+            return &it->second;
+        }
+
+        bool insert(RowHash h, std::pair<int, int> entry)
+        {
+            return shards[shardOf(h)].insert({ h, entry }).second;
+        }
+
+        size_t capacity() const
+        {
+            size_t result = 0;
+            for (auto & shard: shards)
+                result += shard.capacity();
+            return result;
+        }
+    };
+
+    RowIndex rowIndex;
     std::string filename;
     Date earliestTs, latestTs;
 
@@ -208,6 +608,26 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
 
     TabularDatasetConfig config;
 
+    /// When the committed chunks last changed; served to replicas so
+    /// they can report how far behind the primary they are
+    Date lastCommitTime;
+
+    /// Server used to reach the primary; null unless this is a replica
+    MldbServer * replicationServer;
+
+    /// Periodic poll of the primary for newly committed chunks
+    WatchT<Date> replicationTimer;
+
+    /// True while a poll is in flight, so that ticks never overlap
+    std::atomic<bool> replicationPolling;
+
+    /// Protects the replication statistics below (they are written by
+    /// the poll callbacks and read by getStatus())
+    mutable std::mutex replicationMutex;
+    Date primaryCommitTime;       ///< Commit time reported by the primary
+    Date lastSyncTime;            ///< When we last caught up to the primary
+    std::string replicationError; ///< Last poll error, empty when healthy
+
     // Return the value of the column for all rows
     virtual MatrixColumn getColumn(const ColumnName & column) const override
     {
@@ -244,6 +664,9 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         std::vector<CellValue> result;
         result.reserve(entry.rowCount);
 
+        ML::PerfCounterScope perfScope
+            (QueryPerfCounters::columnScanAccumulator());
+
         // Go through each chunk with a non-null value
         for (auto & c: entry.chunks) {
             auto onValue = [&] (size_t n, CellValue val)
@@ -290,22 +713,76 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         descriptions.initialize(valueList, maxNumBuckets);
 
         for (auto & v: values) {
-            v.second = descriptions.getBucket(v.first);            
+            v.second = descriptions.getBucket(v.first);
         }
-        
-        // Finally, perform the bucketed lookup
+
+        // Finally, perform the bucketed lookup.  Buckets are assigned
+        // chunk by chunk in parallel into per-chunk buffers; purely
+        // numeric columns go through the vectorized numeric kernel
+        // instead of the per-value hash lookup.
+        bool numericFastPath
+            = descriptions.isOnlyNumeric() && descriptions.numeric.active;
+
+        std::vector<std::vector<uint32_t> > chunkBuckets(chunks.size());
+
+        QueryPerfCounters * perf = QueryPerfCounters::current();
+
+        auto doChunk = [&] (size_t i)
+            {
+                QueryPerfCounters::Guard perfGuard(perf);
+                ML::PerfCounterScope perfScope
+                    (perf ? &perf->columnScan : nullptr);
+
+                std::vector<uint32_t> & out = chunkBuckets[i];
+                out.reserve(chunks[i].rowCount());
+
+                if (numericFastPath) {
+                    // Gather the values to assign; nulls go straight to
+                    // bucket zero and leave a hole to fill in afterwards
+                    std::vector<double> doubles;
+                    doubles.reserve(chunks[i].rowCount());
+
+                    auto onValue = [&] (size_t, const CellValue & val)
+                        {
+                            if (val.empty())
+                                out.push_back(0);
+                            else {
+                                out.push_back(-1);
+                                doubles.push_back(val.toDouble());
+                            }
+                            return true;
+                        };
+
+                    chunks[i].columns[it->second]->forEach(onValue);
+
+                    std::vector<uint32_t> assigned(doubles.size());
+                    descriptions.numeric.getBuckets(doubles.data(),
+                                                    doubles.size(),
+                                                    assigned.data());
+
+                    size_t j = 0;
+                    for (auto & b: out) {
+                        if (b == (uint32_t)-1)
+                            b = assigned[j++];
+                    }
+                }
+                else {
+                    auto onValue = [&] (size_t, const CellValue & val)
+                        {
+                            out.push_back(values.at(val));
+                            return true;
+                        };
+
+                    chunks[i].columns[it->second]->forEach(onValue);
+                }
+            };
+
+        parallelMap(0, chunks.size(), doChunk);
+
         WritableBucketList buckets(totalRows, descriptions.numBuckets());
 
-        for (unsigned i = 0;  i < chunks.size();  ++i) {
-            auto onValue = [&] (size_t, const CellValue & val)
-                {
-                    uint32_t bucket = values[val];
-                    buckets.write(bucket);
-                    return true;
-                };
-            
-            chunks[i].columns[it->second]->forEach(onValue);
-        }
+        for (auto & cb: chunkBuckets)
+            buckets.writeBatch(cb.data(), cb.size());
 
         return std::make_tuple(std::move(buckets), std::move(descriptions));
     }
@@ -389,23 +866,51 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         std::vector<RowHash> result;
 
         size_t n = 0;
-        for (auto & i: rowIndex) {
-            if (n++ < start)
-                continue;
-            if (limit != -1 && n > start + limit)
-                break;
-            result.emplace_back(i.first);
+        if (!config.rowNameIndex) {
+            // No index; enumeration is a scan of the chunk row names
+            for (auto & c: chunks) {
+                for (auto & name: c.rowNames) {
+                    if (n++ < start)
+                        continue;
+                    if (limit != -1 && n > start + limit)
+                        return result;
+                    result.emplace_back(name);
+                }
+            }
+            return result;
+        }
+
+        for (auto & shard: rowIndex.shards) {
+            for (auto & i: shard) {
+                if (n++ < start)
+                    continue;
+                if (limit != -1 && n > start + limit)
+                    return result;
+                result.emplace_back(i.first);
+            }
         }
 
         return result;
     }
 
+    /** Throw for a point lookup on a dataset created with
+        rowNameIndex=false. */
+    void checkRowIndexEnabled() const
+    {
+        if (!config.rowNameIndex)
+            throw HttpReturnException
+                (400, "Tabular dataset was configured with "
+                 "rowNameIndex=false, so rows cannot be addressed "
+                 "by name");
+    }
+
     std::pair<int, int> tryLookupRow(const RowName & rowName) const
     {
-        auto it = rowIndex.find(rowName);
-        if (it == rowIndex.end())
+        checkRowIndexEnabled();
+        auto entry = rowIndex.find(rowName);
+        if (!entry)
             return { -1, -1 };
-        return it->second;
+        return *entry;
     }
     
     std::pair<int, int> lookupRow(const RowName & rowName) const
@@ -434,8 +939,9 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         result.rowHash = rowName;
         result.rowName = rowName;
 
-        auto it = rowIndex.find(rowName);
-        if (it == rowIndex.end()) {
+        checkRowIndexEnabled();
+        auto entry = rowIndex.find(rowName);
+        if (!entry) {
             throw HttpReturnException
                 (400, "Row not found in tabular dataset: "
                  + rowName.toUtf8String(),
@@ -443,19 +949,114 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         }
 
         result.columns
-            = chunks.at(it->second.first)
-            .getRow(it->second.second, fixedColumns);
+            = chunks.at(entry->first)
+            .getRow(entry->second, fixedColumns);
+        return result;
+    }
+
+    /** Point lookup of a subset of a row's columns.  Reads only the
+        frozen columns that are asked for, so a three column probe of a
+        five thousand column row decodes three cells, not thousands.
+    */
+    virtual MatrixNamedRow
+    getRowColumns(const RowName & rowName,
+                  const std::vector<ColumnName> & columns) const override
+    {
+        MatrixNamedRow result;
+        result.rowHash = rowName;
+        result.rowName = rowName;
+
+        checkRowIndexEnabled();
+        auto entry = rowIndex.find(rowName);
+        if (!entry) {
+            throw HttpReturnException
+                (400, "Row not found in tabular dataset: "
+                 + rowName.toUtf8String(),
+                 "rowName", rowName);
+        }
+
+        const TabularDatasetChunk & chunk = chunks.at(entry->first);
+        size_t indexInChunk = entry->second;
+        Date ts = chunk.timestamps->get(indexInChunk).toTimestamp();
+
+        result.columns.reserve(columns.size());
+        for (auto & columnName: columns) {
+            const FrozenColumn * col = nullptr;
+            auto fit = fixedColumnIndex.find(columnName.newHash());
+            if (fit != fixedColumnIndex.end())
+                col = chunk.columns.at(fit->second).get();
+            else {
+                auto sit = chunk.sparseColumns.find(columnName);
+                if (sit != chunk.sparseColumns.end())
+                    col = sit->second.get();
+            }
+            if (!col)
+                continue;
+            CellValue val = col->get(indexInChunk);
+            if (val.empty())
+                continue;
+            result.columns.emplace_back(columnName, std::move(val), ts);
+        }
+
         return result;
     }
 
     virtual RowName getRowName(const RowHash & rowHash) const override
     {
-        auto it = rowIndex.find(rowHash);
-        if (it == rowIndex.end()) {
+        checkRowIndexEnabled();
+        auto entry = rowIndex.find(rowHash);
+        if (!entry) {
             throw HttpReturnException(400, "Row not found in tabular dataset");
         }
 
-        return chunks.at(it->second.first).rowNames[it->second.second];
+        return chunks.at(entry->first).rowNames[entry->second];
+    }
+
+    /** Batched point lookups.  The probes are ordered by hash, which
+        groups them per index shard, and the initial bucket of each
+        probe is prefetched a fixed distance ahead, so the cache misses
+        of a large batch overlap instead of being taken one at a time.
+        Unknown rows come back with their name set and no columns, per
+        the Dataset::getRows() contract.
+    */
+    std::vector<MatrixNamedRow>
+    getRowBatch(const std::vector<RowName> & rowNames) const
+    {
+        checkRowIndexEnabled();
+
+        size_t numRows = rowNames.size();
+
+        // (hash, position in the request); the top bits of the hash
+        // are the shard, so sorting walks one shard at a time
+        std::vector<std::pair<uint64_t, uint32_t> > order;
+        order.reserve(numRows);
+        for (unsigned i = 0;  i < numRows;  ++i)
+            order.emplace_back(RowHash(rowNames[i]).hash(), i);
+        std::sort(order.begin(), order.end());
+
+        static constexpr size_t PREFETCH_AHEAD = 8;
+
+        std::vector<MatrixNamedRow> result(numRows);
+
+        for (size_t i = 0;  i < numRows;  ++i) {
+            if (i + PREFETCH_AHEAD < numRows) {
+                RowHash ahead(order[i + PREFETCH_AHEAD].first);
+                rowIndex.shards[RowIndex::shardOf(ahead)].prefetch(ahead);
+            }
+
+            RowHash hash(order[i].first);
+            MatrixNamedRow & row = result[order[i].second];
+            row.rowHash = hash;
+            row.rowName = rowNames[order[i].second];
+
+            auto entry = rowIndex.find(hash);
+            if (!entry)
+                continue;
+            row.columns = chunks.at(entry->first)
+                .getRow(entry->second, fixedColumns);
+        }
+
+        return result;
     }
 
     virtual ColumnName getColumnName(ColumnHash column) const override
@@ -482,84 +1083,1144 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
                                       "knownColumns", getColumnNames());
         }
 
-        stats = ColumnStats();
+        stats = ColumnStats();
+
+        bool isNumeric = true;
+
+        for (auto & c: columns.at(it->second).chunks) {
+
+            auto onValue = [&] (const CellValue & value)
+                {
+                    if (!value.isNumber())
+                        isNumeric = false;
+                    stats.values[value].rowCount_ += 1;
+                    return true;
+                };
+                                
+            c.second->forEachDistinctValue(onValue);
+        }
+
+        stats.isNumeric_ = isNumeric && !chunks.empty();
+        stats.rowCount_ = rowCount;
+        return stats;
+    }
+
+    /** Summary statistics from the zone maps recorded when the chunks
+        were frozen: a read over the per-chunk metadata, not over the
+        rows.
+    */
+    ColumnSummaryStats
+    getColumnSummaryStats(const ColumnName & column) const
+    {
+        auto it = columnIndex.find(column.newHash());
+        if (it == columnIndex.end()) {
+            throw HttpReturnException(400, "Tabular dataset contains no column with given hash",
+                                      "columnHash", column,
+                                      "knownColumns", getColumnNames());
+        }
+
+        ColumnSummaryStats result;
+        ColumnDistinctSketch sketch;
+
+        for (auto & c: columns.at(it->second).chunks) {
+            const ColumnZoneMap & zoneMap = c.second->zoneMap;
+            result.valueCount += zoneMap.valueCount;
+            if (!zoneMap.minValue.empty()
+                && (result.minValue.empty()
+                    || zoneMap.minValue < result.minValue))
+                result.minValue = zoneMap.minValue;
+            if (!zoneMap.maxValue.empty()
+                && (result.maxValue.empty()
+                    || result.maxValue < zoneMap.maxValue))
+                result.maxValue = zoneMap.maxValue;
+            sketch.merge(zoneMap.distinctSketch);
+        }
+
+        // Columns hold at most one value per row, so the rows without a
+        // value are the rows the value count doesn't reach.
+        result.nullCount = rowCount - result.valueCount;
+        result.approxDistinctCount = sketch.estimate();
+
+        return result;
+    }
+
+    /** Memory held by the frozen chunks, broken down per column.  Only
+        committed data is counted; rows still in the mutable chunks are
+        not.
+    */
+    DatasetMemoryUsage getMemoryUsage() const
+    {
+        DatasetMemoryUsage result;
+
+        // Whole chunks, including row names, timestamps and per-chunk
+        // overhead
+        for (auto & chunk: chunks) {
+            result.totalBytes += chunk.memusage();
+            for (auto & r: chunk.rowNames)
+                result.rowNameBytes += r.memusage();
+        }
+
+        // Per-column payload, across chunks
+        for (auto & c: columns) {
+            uint64_t bytes = 0;
+            for (auto & ch: c.chunks)
+                bytes += ch.second->memusage();
+            result.columnBytes[c.columnName] = bytes;
+        }
+
+        // The row index counts with the row names; the column indexes
+        // count as auxiliary indexes
+        uint64_t rowIndexBytes
+            = rowIndex.capacity()
+              * (sizeof(RowHash) + sizeof(std::pair<int, int>));
+        result.rowNameBytes += rowIndexBytes;
+
+        result.indexBytes
+            = columnIndex.capacity() * (sizeof(uint64_t) + sizeof(int))
+            + columnHashIndex.capacity() * (sizeof(ColumnHash) + sizeof(int))
+            + fixedColumnIndex.capacity() * (sizeof(uint64_t) + sizeof(int));
+
+        result.totalBytes += rowIndexBytes + result.indexBytes;
+
+        return result;
+    }
+
+    /// Type-specific routes, reached under /routes on the dataset
+    RestRequestRouter router;
+
+    void initRoutes()
+    {
+        addRouteSyncJsonReturn(router, "/publish", { "POST" },
+                               "Publish the committed dataset as a shared "
+                               "memory segment that a co-located instance "
+                               "can attach to",
+                               "Attach configuration for the published "
+                               "segment",
+                               &TabularDataStore::publish,
+                               this,
+                               RestParam<std::string>("name",
+                                                      "Name of the shared "
+                                                      "memory segment"));
+
+        // Binary route used by replicas to pull committed chunks; the
+        // response is the encodeTabularChunks blob, so it can't go
+        // through the JSON helpers.
+        auto replicateRoute
+            = [this] (RestConnection & connection,
+                      const RestRequest & request,
+                      RestRequestParsingContext & context)
+            -> RestRequestMatchResult
+            {
+                size_t skipChunks = 0;
+                if (request.params.hasValue("skipChunks"))
+                    skipChunks = std::stoull
+                        (request.params.getValue("skipChunks").rawString());
+
+                std::unique_lock<std::mutex> guard(datasetMutex);
+
+                if (skipChunks > chunks.size())
+                    skipChunks = chunks.size();
+
+                RestParams headers
+                    = { { "X-Mldb-Num-Chunks",
+                          std::to_string(chunks.size()) },
+                        { "X-Mldb-Commit-Time",
+                          std::to_string(lastCommitTime
+                                         .secondsSinceEpoch()) } };
+
+                connection.sendHttpResponse
+                    (200,
+                     encodeTabularChunks(fixedColumns, chunks, skipChunks),
+                     "application/octet-stream",
+                     std::move(headers));
+
+                return RestRequestRouter::MR_YES;
+            };
+
+        Json::Value replicateHelp;
+        replicateHelp["result"]
+            = "Compressed frozen chunks, in the persisted file format";
+
+        router.addRoute("/replicate", { "GET" },
+                        "Return the committed chunks past the first "
+                        "skipChunks ones, compressed, for replication",
+                        replicateRoute,
+                        replicateHelp);
+    }
+
+    /** Publish the committed dataset as a read-only shared memory
+        segment: the persisted file format, written to a file under
+        /dev/shm so that it lives in shared pages rather than on disk.
+        A co-located instance attaches by creating a tabular dataset
+        whose dataFileUrl points at the segment; loading memory maps
+        the column storage straight out of the shared pages, so the
+        attach cost is bounded by the metadata, not the data.
+
+        Returns the segment path along with a ready-made attach
+        configuration.
+    */
+    Json::Value publish(const std::string & segmentName)
+    {
+        if (segmentName.empty())
+            throw HttpReturnException(400, "A segment name is required "
+                                      "to publish a tabular dataset");
+        if (segmentName.find('/') != std::string::npos)
+            throw HttpReturnException(400, "Shared memory segment names "
+                                      "may not contain '/'",
+                                      "name", segmentName);
+
+        std::string path = "/dev/shm/" + segmentName;
+
+        // Hold the dataset lock for a consistent snapshot, as a commit
+        // that persists does.  The write is a sequential copy of the
+        // frozen column storage into tmpfs.
+        std::unique_lock<std::mutex> guard(datasetMutex);
+
+        ML::Timer timer;
+        saveTabularFile(path, fixedColumns, chunks);
+        cerr << "published tabular dataset to " << path
+             << " in " << timer.elapsed() << endl;
+
+        Json::Value result;
+        result["segmentPath"] = path;
+        result["attachConfig"]["type"] = "tabular";
+        result["attachConfig"]["params"]["dataFileUrl"]
+            = "file://" + path;
+        return result;
+    }
+
+    /** Distinct count estimate from the freeze-time sketches alone:
+        like getColumnSummaryStats but without the min/max fold, and
+        with -1 for an unknown column instead of an exception (the
+        planner asks about columns speculatively).
+    */
+    int64_t
+    getColumnCardinalityEstimate(const ColumnName & column) const
+    {
+        auto it = columnIndex.find(column.newHash());
+        if (it == columnIndex.end())
+            return -1;
+
+        ColumnDistinctSketch sketch;
+        for (auto & c: columns.at(it->second).chunks)
+            sketch.merge(c.second->zoneMap.distinctSketch);
+
+        return sketch.estimate();
+    }
+
+    virtual size_t getRowCount() const override
+    {
+        return rowCount;
+    }
+
+    virtual size_t getColumnCount() const override
+    {
+        return columns.size();
+    }
+
+    virtual std::pair<Date, Date> getTimestampRange() const
+    {
+        return { earliestTs, latestTs };
+    }
+
+    /** Recognize a WHERE tree made of column = constant predicates over
+        fixed columns, combined with AND and OR.  Returns a function that
+        evaluates the tree into a per-chunk bitmap of matching rows, or a
+        null function if the tree contains anything else.
+
+        The function must be called with an all-zero bitmap covering the
+        chunk's rows, and leaves its result there.  Each leaf fills its
+        bitmap via scanEquals, which on dictionary coded columns compares
+        codes without materializing any cell, and AND/OR nodes combine
+        the child bitmaps word by word, so the whole selection runs
+        before any SQL expression is evaluated.
+
+        The restriction argument, when non-null, is a sorted list of the
+        only rows that could still match (the survivors of the left side
+        of an AND); a leaf with a narrow restriction probes just those
+        rows via scanSelected instead of scanning its whole column.  The
+        top-level call passes null.
+    */
+    std::function<void (const TabularDatasetChunk & chunk,
+                        const std::vector<uint32_t> * restriction,
+                        std::vector<uint64_t> & bits)>
+    compileBitmapWhere(const SqlExpression & where) const
+    {
+        typedef std::function<void (const TabularDatasetChunk &,
+                                    const std::vector<uint32_t> *,
+                                    std::vector<uint64_t> &)> ChunkBitmapFn;
+
+        auto boolean = dynamic_cast<const BooleanOperatorExpression *>(&where);
+        if (boolean && (boolean->op == "AND" || boolean->op == "OR")) {
+            ChunkBitmapFn lhs = compileBitmapWhere(*boolean->lhs);
+            if (!lhs)
+                return nullptr;
+            ChunkBitmapFn rhs = compileBitmapWhere(*boolean->rhs);
+            if (!rhs)
+                return nullptr;
+            bool isAnd = (boolean->op == "AND");
+
+            return [=] (const TabularDatasetChunk & chunk,
+                        const std::vector<uint32_t> * restriction,
+                        std::vector<uint64_t> & bits)
+                {
+                    lhs(chunk, restriction, bits);
+
+                    if (isAnd) {
+                        // Rows matching the left side become the
+                        // restriction for the right side, so a selective
+                        // left predicate turns the right side's scan
+                        // into a probe of the survivors (and an empty
+                        // left side skips it entirely)
+                        std::vector<uint32_t> survivors;
+                        for (size_t w = 0;  w < bits.size();  ++w) {
+                            uint64_t word = bits[w];
+                            while (word) {
+                                int bit = ML::lowest_bit(word);
+                                survivors.push_back(w * 64 + bit);
+                                word &= word - 1;
+                            }
+                        }
+                        if (survivors.empty())
+                            return;
+
+                        std::vector<uint64_t> rhsBits(bits.size(), 0);
+                        rhs(chunk, &survivors, rhsBits);
+                        for (size_t i = 0;  i < bits.size();  ++i)
+                            bits[i] &= rhsBits[i];
+                    }
+                    else {
+                        std::vector<uint64_t> rhsBits(bits.size(), 0);
+                        rhs(chunk, restriction, rhsBits);
+                        for (size_t i = 0;  i < bits.size();  ++i)
+                            bits[i] |= rhsBits[i];
+                    }
+                };
+        }
+
+        auto comparison = dynamic_cast<const ComparisonExpression *>(&where);
+        if (!comparison
+            || (comparison->op != "=" && comparison->op != "=="))
+            return nullptr;
+
+        auto clhs = dynamic_cast<const ConstantExpression *>
+            (comparison->lhs.get());
+        auto crhs = dynamic_cast<const ConstantExpression *>
+            (comparison->rhs.get());
+        auto vlhs = dynamic_cast<const ReadColumnExpression *>
+            (comparison->lhs.get());
+        auto vrhs = dynamic_cast<const ReadColumnExpression *>
+            (comparison->rhs.get());
+
+        const ReadColumnExpression * variable
+            = vlhs ? vlhs : vrhs;
+        const ConstantExpression * constant
+            = crhs ? crhs : clhs;
+
+        if (!variable || !constant)
+            return nullptr;
+
+        // Only fixed (dense) columns are present in every chunk
+        auto it = fixedColumnIndex.find(variable->columnName.newHash());
+        if (it == fixedColumnIndex.end())
+            return nullptr;
+        int columnIndex = it->second;
+
+        CellValue val = constant->constant.getAtom();
+        if (val.empty())
+            return nullptr;
+
+        return [=] (const TabularDatasetChunk & chunk,
+                    const std::vector<uint32_t> * restriction,
+                    std::vector<uint64_t> & bits)
+            {
+                const FrozenColumn & col = *chunk.columns.at(columnIndex);
+
+                // Whole-chunk elimination from the zone map; the bitmap
+                // stays empty
+                if (!col.zoneMap.couldContainValue(val)) {
+                    engineStatsAdd(engineStats().chunksSkipped);
+                    return;
+                }
+
+                engineStatsAdd(engineStats().chunksScanned);
+
+                // A narrow restriction makes probing just the selected
+                // rows cheaper than scanning the whole column; a wide
+                // one is better served by the full scan, whose result
+                // the AND combiner masks anyway
+                if (restriction
+                    && restriction->size() < chunk.rowNames.size() / 16) {
+                    auto onValue = [&] (uint32_t rowIndex,
+                                        const CellValue & v)
+                        {
+                            if (v == val)
+                                bits[rowIndex >> 6]
+                                    |= uint64_t(1) << (rowIndex & 63);
+                            return true;
+                        };
+                    col.scanSelected(restriction->data(),
+                                     restriction->size(), onValue);
+                    return;
+                }
+
+                auto onRow = [&] (uint32_t rowIndex)
+                    {
+                        bits[rowIndex >> 6]
+                            |= uint64_t(1) << (rowIndex & 63);
+                        return true;
+                    };
+                col.scanEquals(val, onRow);
+            };
+    }
+
+    /** Generate the rows whose declared event-time column falls between
+        lo and hi (an empty bound is unbounded on that side), using the
+        zone map fences to skip whole chunks and the sorted per-chunk
+        offsets to binary search within the survivors.  The cost is
+        proportional to the rows in the window plus a logarithmic number
+        of probes per surviving chunk, independent of how much history
+        the dataset retains.
+    */
+    GenerateRowsWhereFunction
+    generateTimeRangeRows(const CellValue & lo, bool loInclusive,
+                          const CellValue & hi, bool hiInclusive) const
+    {
+        int columnIndex = timeColumnIndex;
+        ExcAssert(columnIndex != -1);
+
+        auto exec = [=] (ssize_t numToGenerate, Any token,
+                         const BoundParameters & params)
+            -> std::pair<std::vector<RowName>, Any>
+            {
+                std::vector<RowName> rows;
+
+                ML::PerfCounterScope perfScope
+                    (QueryPerfCounters::columnScanAccumulator());
+
+                for (size_t i = 0;  i < chunks.size();  ++i) {
+                    const TabularDatasetChunk & chunk = chunks[i];
+                    const FrozenColumn & col
+                        = *chunk.columns.at(columnIndex);
+
+                    // Whole-chunk elimination from the fences
+                    if (!col.zoneMap.couldContainRange(lo, hi)) {
+                        engineStatsAdd(engineStats().chunksSkipped);
+                        continue;
+                    }
+
+                    engineStatsAdd(engineStats().chunksScanned);
+
+                    const std::vector<uint32_t> & sorted
+                        = timeIndexSortedRows.at(i);
+
+                    // First entry inside the window
+                    size_t first = 0;
+                    if (!lo.empty()) {
+                        size_t l = 0, r = sorted.size();
+                        while (l < r) {
+                            size_t m = (l + r) / 2;
+                            CellValue v = col.get(sorted[m]);
+                            if (loInclusive ? v < lo : v <= lo)
+                                l = m + 1;
+                            else r = m;
+                        }
+                        first = l;
+                    }
+
+                    // First entry past the window
+                    size_t end = sorted.size();
+                    if (!hi.empty()) {
+                        size_t l = first, r = sorted.size();
+                        while (l < r) {
+                            size_t m = (l + r) / 2;
+                            CellValue v = col.get(sorted[m]);
+                            if (hiInclusive ? v <= hi : v < hi)
+                                l = m + 1;
+                            else r = m;
+                        }
+                        end = l;
+                    }
+
+                    for (size_t p = first;  p < end;  ++p)
+                        rows.emplace_back(chunk.rowNames[sorted[p]]);
+                }
+
+                return { std::move(rows), Any() };
+            };
+
+        return GenerateRowsWhereFunction
+            (exec,
+             "tabular dataset time index range scan",
+             GenerateRowsWhereFunction::BETTER_THAN_TABLESCAN);
+    }
+
+    GenerateRowsWhereFunction
+    generateRowsWhere(const SqlBindingScope & context,
+                      const SqlExpression & where,
+                      ssize_t offset,
+                      ssize_t limit) const
+    {
+        // We can use the zone maps to skip chunks for WHERE clauses of
+        // the form column OP constant with a comparison operator.  The
+        // offset and limit are applied by the caller, so we only handle
+        // the unrestricted case.
+        if (offset != 0 || limit != -1)
+            return GenerateRowsWhereFunction();
+
+        // Conjunctions and disjunctions of equality predicates
+        // (campaign='X' AND country='CA') resolve via per-predicate
+        // bitmaps combined word by word
+        if (dynamic_cast<const BooleanOperatorExpression *>(&where)) {
+            auto bitmapFn = compileBitmapWhere(where);
+            if (bitmapFn) {
+                auto exec = [=] (ssize_t numToGenerate, Any token,
+                                 const BoundParameters & params)
+                    -> std::pair<std::vector<RowName>, Any>
+                    {
+                        std::vector<RowName> rows;
+
+                        for (auto & chunk: chunks) {
+                            size_t numRows = chunk.rowNames.size();
+                            std::vector<uint64_t>
+                                bits((numRows + 63) / 64, 0);
+                            bitmapFn(chunk, nullptr, bits);
+
+                            for (size_t w = 0;  w < bits.size();  ++w) {
+                                uint64_t word = bits[w];
+                                while (word) {
+                                    int bit = ML::lowest_bit(word);
+                                    rows.emplace_back
+                                        (chunk.rowNames[w * 64 + bit]);
+                                    word &= word - 1;
+                                }
+                            }
+                        }
+
+                        return { std::move(rows), Any() };
+                    };
+
+                return GenerateRowsWhereFunction
+                    (exec,
+                     "tabular dataset bitmap predicate scan",
+                     GenerateRowsWhereFunction::BETTER_THAN_TABLESCAN);
+            }
+        }
+
+        // BETWEEN on the declared event-time column is the canonical
+        // time-window predicate; answer it from the time index
+        auto between = dynamic_cast<const BetweenExpression *>(&where);
+        if (between && !between->notBetween && timeColumnIndex != -1) {
+            auto var = dynamic_cast<const ReadColumnExpression *>
+                (between->expr.get());
+            auto clower = dynamic_cast<const ConstantExpression *>
+                (between->lower.get());
+            auto cupper = dynamic_cast<const ConstantExpression *>
+                (between->upper.get());
+
+            if (var && clower && cupper) {
+                auto it = fixedColumnIndex.find
+                    (var->columnName.newHash());
+                if (it != fixedColumnIndex.end()
+                    && it->second == timeColumnIndex) {
+                    CellValue lo = clower->constant.getAtom();
+                    CellValue hi = cupper->constant.getAtom();
+                    if (!lo.empty() && !hi.empty())
+                        return generateTimeRangeRows(lo, true /* incl */,
+                                                     hi, true /* incl */);
+                }
+            }
+        }
+
+        auto comparison = dynamic_cast<const ComparisonExpression *>(&where);
+        if (!comparison)
+            return GenerateRowsWhereFunction();
+
+        auto clhs = dynamic_cast<const ConstantExpression *>
+            (comparison->lhs.get());
+        auto crhs = dynamic_cast<const ConstantExpression *>
+            (comparison->rhs.get());
+        auto vlhs = dynamic_cast<const ReadColumnExpression *>
+            (comparison->lhs.get());
+        auto vrhs = dynamic_cast<const ReadColumnExpression *>
+            (comparison->rhs.get());
+
+        const ReadColumnExpression * variable = nullptr;
+        const ConstantExpression * constant = nullptr;
+        std::string op = comparison->op;
+
+        if (vlhs && crhs) {
+            variable = vlhs;
+            constant = crhs;
+        }
+        else if (clhs && vrhs) {
+            // Normalize so that the column is always on the left
+            variable = vrhs;
+            constant = clhs;
+            if (op == "<") op = ">";
+            else if (op == ">") op = "<";
+            else if (op == "<=") op = ">=";
+            else if (op == ">=") op = "<=";
+        }
+
+        if (!variable || !constant)
+            return GenerateRowsWhereFunction();
+
+        // Only fixed (dense) columns are present in every chunk
+        auto it = fixedColumnIndex.find(variable->columnName.newHash());
+        if (it == fixedColumnIndex.end())
+            return GenerateRowsWhereFunction();
+        int columnIndex = it->second;
+
+        CellValue cmp = constant->constant.getAtom();
+        if (cmp.empty())
+            return GenerateRowsWhereFunction();
+
+        // Bounds of values that could match, for the zone map check
+        CellValue lo, hi;
+        if (op == "=" || op == "==")
+            lo = hi = cmp;
+        else if (op == "<" || op == "<=")
+            hi = cmp;
+        else if (op == ">" || op == ">=")
+            lo = cmp;
+        else return GenerateRowsWhereFunction();  // != can't skip chunks
+
+        // Range comparisons on the declared event-time column binary
+        // search the time index instead of scanning surviving chunks
+        if (columnIndex == timeColumnIndex
+            && (op == "<" || op == "<=" || op == ">" || op == ">="))
+            return generateTimeRangeRows(lo, op != ">", hi, op != "<");
+
+        auto exec = [=] (ssize_t numToGenerate, Any token,
+                         const BoundParameters & params)
+            -> std::pair<std::vector<RowName>, Any>
+            {
+                std::vector<RowName> rows;
+
+                ML::PerfCounterScope perfScope
+                    (QueryPerfCounters::columnScanAccumulator());
+
+                for (auto & chunk: chunks) {
+                    const FrozenColumn & col
+                        = *chunk.columns.at(columnIndex);
+
+                    // Whole-chunk elimination from the zone map
+                    if (!col.zoneMap.couldContainRange(lo, hi)) {
+                        engineStatsAdd(engineStats().chunksSkipped);
+                        continue;
+                    }
+
+                    engineStatsAdd(engineStats().chunksScanned);
+
+                    if (op == "=" || op == "==") {
+                        auto onRow = [&] (uint32_t rowIndex)
+                            {
+                                rows.emplace_back(chunk.rowNames[rowIndex]);
+                                return true;
+                            };
+                        col.scanEquals(cmp, onRow);
+                        continue;
+                    }
+
+                    auto onValue = [&] (size_t rowIndex, CellValue val)
+                        {
+                            if (val.empty())
+                                return true;
+                            bool matches;
+                            if (op == "<")
+                                matches = val < cmp;
+                            else if (op == "<=")
+                                matches = val <= cmp;
+                            else if (op == ">")
+                                matches = val > cmp;
+                            else matches = val >= cmp;
+                            if (matches)
+                                rows.emplace_back(chunk.rowNames[rowIndex]);
+                            return true;
+                        };
+                    col.forEach(onValue);
+                }
+
+                return { std::move(rows), Any() };
+            };
+
+        GenerateRowsWhereFunction result
+            (exec,
+             "tabular dataset zone map chunk-skipping scan",
+             GenerateRowsWhereFunction::BETTER_THAN_TABLESCAN);
+        return result;
+    }
+
+    void finalize(std::vector<TabularDatasetChunk> & inputChunks,
+                  uint64_t totalRows)
+    {
+        // NOTE: must be called with the lock held
+
+        // Retention: drop whole chunks whose newest row timestamp has
+        // passed the horizon.  Chunks are dropped, never trimmed, so a
+        // row leaves the dataset once the entire chunk it sits in has
+        // expired; the cost is per chunk, not per row.
+        if (config.retentionPeriod > 0.0) {
+            Date cutoff = Date::now().plusSeconds(-config.retentionPeriod);
+            auto expired = [&] (const TabularDatasetChunk & c)
+                {
+                    return c.maxTimestamp() < cutoff;
+                };
+            auto firstDropped
+                = std::remove_if(inputChunks.begin(), inputChunks.end(),
+                                 expired);
+            if (firstDropped != inputChunks.end()) {
+                size_t numDropped
+                    = std::distance(firstDropped, inputChunks.end());
+                inputChunks.erase(firstDropped, inputChunks.end());
+                totalRows = 0;
+                for (auto & c: inputChunks)
+                    totalRows += c.rowCount();
+                cerr << "retention dropped " << numDropped
+                     << " expired chunks; " << totalRows
+                     << " rows retained" << endl;
+            }
+        }
+
+        rowCount = totalRows;
+
+        chunks.reserve(inputChunks.size());
+
+        for (auto & c: inputChunks) {
+            chunks.emplace_back(std::move(c));
+        }
+
+        columns.reserve(fixedColumns.size());
+        for (size_t i = 0;  i < fixedColumns.size();  ++i) {
+            const ColumnName & c = fixedColumns[i];
+            ColumnEntry entry;
+            entry.columnName = c;
+            columns.emplace_back(entry);
+            columnIndex[c.newHash()] = i;
+            columnHashIndex[c] = i;
+        }
+
+        // Create the column index.  This should be rapid, as there shouldn't
+        // be too many columns.
+        for (size_t i = 0;  i < chunks.size();  ++i) {
+            const TabularDatasetChunk & chunk = chunks[i];
+            ExcAssertEqual(fixedColumns.size(), chunk.columns.size());
+            for (size_t j = 0;  j < chunk.columns.size();  ++j) {
+                columns[j].chunks.emplace_back(i, chunk.columns[j]);
+            }
+            for (auto & c: chunk.sparseColumns) {
+                auto it = columnIndex.insert(make_pair(c.first.newHash(),
+                                                       columns.size()))
+                    .first;
+                if (it->second == columns.size()) {
+                    ColumnEntry entry;
+                    entry.columnName = c.first;
+                    columns.emplace_back(entry);
+                    columnHashIndex[c.first] = it->second;
+                }
+                columns[it->second].chunks.emplace_back(i, c.second);
+            }
+        }
+
+        ExcAssertEqual(columns.size(), columnIndex.size());
+        ExcAssertEqual(columns.size(), columnHashIndex.size());
+
+        // Sort each chunk's row offsets by the declared event-time
+        // column, so that time-range queries can binary search to their
+        // first matching row.  The fences (zone map min/max) already
+        // exist; only the within-chunk ordering is built here.
+        timeColumnIndex = -1;
+        timeIndexSortedRows.clear();
+        if (!config.timeColumn.empty()) {
+            auto it = fixedColumnIndex.find
+                (ColumnName(config.timeColumn).newHash());
+            if (it == fixedColumnIndex.end()) {
+                if (!chunks.empty())
+                    cerr << "time column '" << config.timeColumn
+                         << "' is not a fixed column of the dataset; "
+                         << "no time index built" << endl;
+            }
+            else {
+                ML::Timer timeIndexTimer;
+                timeColumnIndex = it->second;
+                timeIndexSortedRows.resize(chunks.size());
+
+                auto sortChunk = [&] (size_t i)
+                    {
+                        const FrozenColumn & col
+                            = *chunks[i].columns.at(timeColumnIndex);
+                        std::vector<std::pair<CellValue, uint32_t> > vals;
+                        vals.reserve(col.size());
+                        auto onValue = [&] (size_t rowIndex, CellValue val)
+                            {
+                                if (!val.empty())
+                                    vals.emplace_back(std::move(val),
+                                                      rowIndex);
+                                return true;
+                            };
+                        col.forEach(onValue);
+                        std::sort(vals.begin(), vals.end());
+
+                        auto & sorted = timeIndexSortedRows[i];
+                        sorted.reserve(vals.size());
+                        for (auto & v: vals)
+                            sorted.push_back(v.second);
+                    };
+
+                parallelMap(0, chunks.size(), sortChunk);
+
+                cerr << "time index took " << timeIndexTimer.elapsed()
+                     << endl;
+            }
+        }
+
+        // Datasets addressed only by scan can skip the index entirely
+        if (!config.rowNameIndex)
+            return;
+
+        ML::Timer rowIndexTimer;
+        //cerr << "creating row index" << endl;
+
+        // Phase 1: hash the row names one chunk per job, bucketing each
+        // (hash, row) pair by its destination shard so that phase 2
+        // doesn't re-scan every chunk per shard.
+        std::vector<std::array<std::vector<std::pair<RowHash, uint32_t> >,
+                               RowIndex::NUM_SHARDS> >
+            sharded(chunks.size());
+
+        auto hashChunk = [&] (size_t i)
+            {
+                size_t numRows = chunks[i].rowNames.size();
+                for (auto & b: sharded[i])
+                    b.reserve(numRows / RowIndex::NUM_SHARDS + 16);
+                for (uint32_t j = 0;  j < numRows;  ++j) {
+                    RowHash h(chunks[i].rowNames[j]);
+                    sharded[i][RowIndex::shardOf(h)].emplace_back(h, j);
+                }
+            };
+
+        parallelMap(0, chunks.size(), hashChunk);
+
+        // Phase 2: one job per shard inserts its buckets from every
+        // chunk; shards are disjoint so no locking is needed.
+        auto doShard = [&] (size_t shard)
+            {
+                auto & hash = rowIndex.shards[shard];
+
+                size_t numEntries = 0;
+                for (auto & c: sharded)
+                    numEntries += c[shard].size();
+                hash.reserve(4 * numEntries / 3);
+
+                for (size_t i = 0;  i < sharded.size();  ++i) {
+                    for (auto & e: sharded[i][shard]) {
+                        if (!hash.insert({ e.first,
+                                           { (int)i, (int)e.second } }).second)
+                            throw HttpReturnException
+                                (400, "Duplicate row name in tabular dataset",
+                                 "rowName", chunks[i].rowNames[e.second]);
+                    }
+                }
+            };
+
+        parallelMap(0, RowIndex::NUM_SHARDS, doShard);
+
+        //cerr << "done creating row index" << endl;
+        cerr << "row index took " << rowIndexTimer.elapsed() << endl;
+
+    }
+
+    /** Local path of the persisted file, or empty if persistence isn't
+        configured.  Only file:// URLs can be memory mapped.
+    */
+    std::string persistedPath() const
+    {
+        if (config.dataFileUrl.empty())
+            return "";
+        if (config.dataFileUrl.scheme() != "file")
+            throw HttpReturnException(400, "Tabular dataset persistence "
+                                      "requires a file:// dataFileUrl, "
+                                      "passed '"
+                                      + config.dataFileUrl.toUtf8String()
+                                      + "'");
+        return config.dataFileUrl.path();
+    }
+
+    /** Local path of the write-ahead log, or empty if durability isn't
+        configured.
+    */
+    std::string walPath() const
+    {
+        if (config.walFileUrl.empty())
+            return "";
+        if (config.walFileUrl.scheme() != "file")
+            throw HttpReturnException(400, "Tabular dataset write-ahead "
+                                      "log requires a file:// walFileUrl, "
+                                      "passed '"
+                                      + config.walFileUrl.toUtf8String()
+                                      + "'");
+        return config.walFileUrl.path();
+    }
+
+    /// Write-ahead log, or null when walFileUrl isn't configured
+    std::shared_ptr<TabularWal> wal;
+
+    /** Replay any rows left in the write-ahead log by a crash, then
+        open it for appending.  Called once at creation, after any
+        persisted file has been loaded (a commit that persists the
+        dataset truncates the log, so whatever is left postdates the
+        last checkpoint).
+    */
+    void initializeWal()
+    {
+        std::string path = walPath();
+        if (path.empty())
+            return;
+
+        if (ML::fileExists(path)) {
+            ML::Timer timer;
+            size_t validEnd = 0;
+            size_t numReplayed = TabularWal::replay
+                (path,
+                 [&] (RowName rowName,
+                      std::vector<std::tuple<ColumnName, CellValue, Date> > vals)
+                 {
+                     recordRowSync(std::move(rowName), std::move(vals));
+                 },
+                 &validEnd);
+            if (numReplayed)
+                cerr << "replayed " << numReplayed << " rows from WAL "
+                     << path << " in " << timer.elapsed() << endl;
+
+            // Cut any torn tail off before reopening for append: rows
+            // appended after the garbage would be stranded behind it
+            // and silently dropped by the next replay
+            if (::truncate(path.c_str(), validEnd) == -1)
+                throw ML::Exception(errno, "truncating torn tail of "
+                                    "tabular WAL " + path);
+        }
+
+        wal = std::make_shared<TabularWal>(path);
+    }
+
+    /** If a persisted file exists, reload the dataset from it (with the
+        column storage memory mapped) and return true.  Otherwise return
+        false and leave the dataset empty, ready to be recorded to.
+    */
+    bool loadFromPersistedFile()
+    {
+        std::string path = persistedPath();
+        if (path.empty() || !ML::fileExists(path))
+            return false;
+
+        ML::Timer timer;
+
+        std::vector<ColumnName> columnNames;
+        std::vector<TabularDatasetChunk> loadedChunks;
+        std::tie(columnNames, loadedChunks) = loadTabularFile(path);
+
+        std::unique_lock<std::mutex> guard(datasetMutex);
+
+        initialize(std::move(columnNames));
+
+        uint64_t totalRows = 0;
+        for (auto & c: loadedChunks)
+            totalRows += c.rowCount();
 
-        bool isNumeric = true;
+        finalize(loadedChunks, totalRows);
 
-        for (auto & c: columns.at(it->second).chunks) {
+        lastCommitTime = Date::now();
 
-            auto onValue = [&] (const CellValue & value)
-                {
-                    if (!value.isNumber())
-                        isNumeric = false;
-                    stats.values[value].rowCount_ += 1;
-                    return true;
-                };
-                                
-            c.second->forEachDistinctValue(onValue);
-        }
+        cerr << "reloaded tabular dataset from " << path
+             << " with " << totalRows << " rows in "
+             << timer.elapsed() << endl;
 
-        stats.isNumeric_ = isNumeric && !chunks.empty();
-        stats.rowCount_ = rowCount;
-        return stats;
+        return true;
     }
 
-    virtual size_t getRowCount() const override
+    void initialize(vector<ColumnName> columnNames)
     {
-        return rowCount;
-    }
+        ExcAssert(this->fixedColumns.empty());
+        this->fixedColumns = std::move(columnNames);
 
-    virtual size_t getColumnCount() const override
-    {
-        return columns.size();
+        for (size_t i = 0;  i < fixedColumns.size();  ++i) {
+            if (!fixedColumnIndex.insert(make_pair(fixedColumns[i].newHash(), i))
+                .second)
+                throw HttpReturnException(500,
+                                          "Duplicate column name in tabular dataset",
+                                          "columnName", fixedColumns[i]);
+        }
     }
 
-    virtual std::pair<Date, Date> getTimestampRange() const
+    /** Start pulling committed chunks from the primary.  Called once at
+        creation when replicateFromPeer is configured.
+    */
+    void startReplication(MldbServer * server)
     {
-        return { earliestTs, latestTs };
+        if (config.replicateFromPeer.empty())
+            return;
+        if (config.replicateFromDataset.empty())
+            throw HttpReturnException(400, "replicateFromDataset is required "
+                                      "when replicateFromPeer is set");
+        if (config.replicationPeriod <= 0)
+            throw HttpReturnException(400, "replicationPeriod must be "
+                                      "positive",
+                                      "replicationPeriod",
+                                      config.replicationPeriod);
+
+        replicationServer = server;
+        replicationTimer = server->getTimer
+            (Date::now().plusSeconds(config.replicationPeriod),
+             config.replicationPeriod,
+             [this] (Date) { this->pollReplication(); });
     }
 
-    GenerateRowsWhereFunction
-    generateRowsWhere(const SqlBindingScope & context,
-                      const SqlExpression & where,
-                      ssize_t offset,
-                      ssize_t limit) const
+    /** Ask the primary for any chunks past the ones we already have.
+        Polls never overlap: if the previous one is still in flight (eg
+        a large backlog being decoded), this tick is skipped.
+    */
+    void pollReplication()
     {
-        GenerateRowsWhereFunction result;
-        return result;
+        bool expected = false;
+        if (!replicationPolling.compare_exchange_strong(expected, true))
+            return;
+
+        size_t have;
+        {
+            std::unique_lock<std::mutex> guard(datasetMutex);
+            have = chunks.size();
+        }
+
+        std::vector<std::string> message
+            = { "GET",
+                "/v1/datasets/" + config.replicateFromDataset
+                    + "/routes/replicate",
+                jsonEncodeStr(RestParams{ { "skipChunks",
+                                            std::to_string(have) } }),
+                "" };
+
+        auto onResponse = [this] (PeerMessage && msg,
+                                  std::vector<std::string> && payload)
+            {
+                try {
+                    applyReplicationResponse(std::move(payload));
+                } catch (const std::exception & exc) {
+                    std::unique_lock<std::mutex> guard(replicationMutex);
+                    replicationError = exc.what();
+                }
+                replicationPolling = false;
+            };
+
+        auto onError = [this] (PeerMessage && msg)
+            {
+                {
+                    std::unique_lock<std::mutex> guard(replicationMutex);
+                    replicationError = msg.error.empty()
+                        ? "replication request failed" : msg.error;
+                }
+                replicationPolling = false;
+            };
+
+        try {
+            replicationServer->sendPeerMessage
+                (config.replicateFromPeer,
+                 PRI_NORMAL,
+                 Date::now().plusSeconds(10 * config.replicationPeriod),
+                 2 /* layer */,
+                 MldbServer::PEER_REST_REQUEST,
+                 std::move(message),
+                 std::move(onResponse),
+                 std::move(onError));
+        } catch (const std::exception & exc) {
+            {
+                std::unique_lock<std::mutex> guard(replicationMutex);
+                replicationError = exc.what();
+            }
+            replicationPolling = false;
+        }
     }
 
-    void finalize(std::vector<TabularDatasetChunk> & inputChunks,
-                  uint64_t totalRows)
+    /** Apply the response to a replication poll: decode the chunk blob,
+        append any new chunks, and update the lag statistics.
+    */
+    void applyReplicationResponse(std::vector<std::string> && payload)
     {
-        // NOTE: must be called with the lock held
+        if (payload.size() != 4)
+            throw HttpReturnException(500, "Malformed replication response "
+                                      "from primary");
 
-        rowCount = totalRows;
-        
-        chunks.reserve(inputChunks.size());
+        int code = std::stoi(payload[0]);
+        if (code != 200)
+            throw HttpReturnException(code, "Replication request to primary "
+                                      "failed",
+                                      "response", payload[3]);
 
-        for (auto & c: inputChunks) {
-            chunks.emplace_back(std::move(c));
+        Date primaryCommit = Date::notADate();
+        for (auto & h: jsonDecodeStr<RestParams>(payload[2])) {
+            if (h.first == "X-Mldb-Commit-Time")
+                primaryCommit = Date::fromSecondsSinceEpoch
+                    (std::stod(h.second.rawString()));
         }
 
-        columns.reserve(fixedColumns.size());
-        for (size_t i = 0;  i < fixedColumns.size();  ++i) {
-            const ColumnName & c = fixedColumns[i];
-            ColumnEntry entry;
-            entry.columnName = c;
-            columns.emplace_back(entry);
-            columnIndex[c.newHash()] = i;
-            columnHashIndex[c] = i;
+        std::vector<ColumnName> columnNames;
+        std::vector<TabularDatasetChunk> newChunks;
+        std::tie(columnNames, newChunks) = decodeTabularChunks(payload[3]);
+
+        appendReplicatedChunks(std::move(columnNames), std::move(newChunks));
+
+        std::unique_lock<std::mutex> guard(replicationMutex);
+        primaryCommitTime = primaryCommit;
+        lastSyncTime = Date::now();
+        replicationError.clear();
+    }
+
+    /** Apply chunks pulled from the primary.  Unlike finalize(), which
+        indexes the whole dataset once at commit time, this appends and
+        indexes only the new chunks, so it can run on every poll.
+    */
+    void appendReplicatedChunks(std::vector<ColumnName> columnNames,
+                                std::vector<TabularDatasetChunk> newChunks)
+    {
+        std::unique_lock<std::mutex> guard(datasetMutex);
+
+        if (mutableChunks.load())
+            throw HttpReturnException(400, "Tabular dataset replicas can't "
+                                      "also be recorded to");
+
+        if (fixedColumns.empty() && columns.empty()) {
+            if (!columnNames.empty())
+                initialize(std::move(columnNames));
+        }
+        else if (columnNames != fixedColumns)
+            throw HttpReturnException(400, "Replicated chunks have a "
+                                      "different fixed column set than the "
+                                      "replica",
+                                      "primaryColumns", columnNames,
+                                      "replicaColumns", fixedColumns);
+
+        if (columns.empty() && !fixedColumns.empty()) {
+            columns.reserve(fixedColumns.size());
+            for (size_t i = 0;  i < fixedColumns.size();  ++i) {
+                const ColumnName & c = fixedColumns[i];
+                ColumnEntry entry;
+                entry.columnName = c;
+                columns.emplace_back(entry);
+                columnIndex[c.newHash()] = i;
+                columnHashIndex[c] = i;
+            }
         }
 
-        // Create the column index.  This should be rapid, as there shouldn't
-        // be too many columns.
-        for (size_t i = 0;  i < chunks.size();  ++i) {
+        size_t firstNew = chunks.size();
+        chunks.reserve(chunks.size() + newChunks.size());
+        for (auto & c: newChunks)
+            chunks.emplace_back(std::move(c));
+
+        for (size_t i = firstNew;  i < chunks.size();  ++i) {
             const TabularDatasetChunk & chunk = chunks[i];
             ExcAssertEqual(fixedColumns.size(), chunk.columns.size());
-            for (size_t j = 0;  j < chunk.columns.size();  ++j) {
+            for (size_t j = 0;  j < chunk.columns.size();  ++j)
                 columns[j].chunks.emplace_back(i, chunk.columns[j]);
-            }
             for (auto & c: chunk.sparseColumns) {
                 auto it = columnIndex.insert(make_pair(c.first.newHash(),
                                                        columns.size()))
@@ -572,39 +2233,41 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
                 }
                 columns[it->second].chunks.emplace_back(i, c.second);
             }
-        }
-
-        ExcAssertEqual(columns.size(), columnIndex.size());
-        ExcAssertEqual(columns.size(), columnHashIndex.size());
 
-        ML::Timer rowIndexTimer;
-        //cerr << "creating row index" << endl;
-        rowIndex.reserve(4 * totalRows / 3);
-        //cerr << "rowIndex capacity is " << rowIndex.capacity() << endl;
-        for (unsigned i = 0;  i < chunks.size();  ++i) {
-            for (unsigned j = 0;  j < chunks[i].rowNames.size();  ++j) {
-                if (!rowIndex.insert({ chunks[i].rowNames[j], { i, j } }).second)
-                    throw HttpReturnException(400, "Duplicate row name in tabular dataset",
-                                              "rowName", chunks[i].rowNames[j]);
+            if (config.rowNameIndex) {
+                for (unsigned j = 0;  j < chunk.rowNames.size();  ++j) {
+                    if (!rowIndex.insert(chunk.rowNames[j],
+                                         { (int)i, (int)j }))
+                        throw HttpReturnException(400, "Duplicate row name in "
+                                                  "replicated chunks",
+                                                  "rowName", chunk.rowNames[j]);
+                }
             }
-        }
-        //cerr << "done creating row index" << endl;
-        cerr << "row index took " << rowIndexTimer.elapsed() << endl;
 
+            rowCount += chunk.rowCount();
+        }
     }
 
-    void initialize(vector<ColumnName> columnNames)
+    /** Replication status for getStatus(): where we replicate from, how
+        far behind the primary we are, and the last error if the link is
+        unhealthy.
+    */
+    Json::Value replicationStatus() const
     {
-        ExcAssert(this->fixedColumns.empty());
-        this->fixedColumns = std::move(columnNames);
-
-        for (size_t i = 0;  i < fixedColumns.size();  ++i) {
-            if (!fixedColumnIndex.insert(make_pair(fixedColumns[i].newHash(), i))
-                .second)
-                throw HttpReturnException(500,
-                                          "Duplicate column name in tabular dataset",
-                                          "columnName", fixedColumns[i]);
-        }
+        Json::Value result;
+        result["peer"] = config.replicateFromPeer;
+        result["dataset"] = config.replicateFromDataset;
+
+        std::unique_lock<std::mutex> guard(replicationMutex);
+        if (lastSyncTime.isADate()) {
+            result["lastSyncTime"] = lastSyncTime.printIso8601();
+            result["lagSeconds"] = Date::now().secondsSince(lastSyncTime);
+        }
+        if (primaryCommitTime.isADate())
+            result["primaryCommitTime"] = primaryCommitTime.printIso8601();
+        if (!replicationError.empty())
+            result["error"] = replicationError;
+        return result;
     }
 
     /** This is a recorder that allows parallel records from multiple
@@ -808,8 +2471,9 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         {
             if (!chunk || chunk->rowCount() == 0)
                 return;
-            auto frozen = chunk->freeze();
-            store->addFrozenChunk(std::move(frozen));
+            // Freeze on the thread pool rather than on the recording
+            // thread; commit() waits for the background jobs to finish.
+            store->freezeChunkInBackground(std::move(chunk));
         }
 
         virtual
@@ -866,18 +2530,24 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
 
     void commit()
     {
+        // Make sure all queued rows have been recorded before we freeze
+        stopWriteBehind(true /* rethrow */);
+
         // No mutable chunks anymore.  Atomically swap out the old pointer.
         auto oldMutableChunks = mutableChunks.exchange(nullptr);
 
         if (!oldMutableChunks)
             return;  // a parallel commit beat us to it
 
+        mutableChunksRaw.store(nullptr);
+
+        // Wait for every recorder that entered its epoch before the swap
+        // to leave it; after this nobody holds a raw pointer into the
+        // old chunk list or its chunks, so we can freeze them.
+        mutableChunksGc.visibleBarrier();
+
         for (auto & c: *oldMutableChunks) {
-            // Wait for us to have the only reference to the chunk
             auto p = c.load();
-            // We have one reference here
-            // There is one reference inside oldMutableChunks
-            while (p.use_count() != 2) ;
 
             if (p->rowCount() != 0)
                 freezeChunkInBackground(p);
@@ -900,13 +2570,20 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
         // apart from this thread.  So we can perform operations unlocked
         // on it without any problem.
 
+        // Claim the frozen chunk hand off list.  The freeze jobs have
+        // all finished, so nothing can push concurrently any more; we
+        // still take it atomically in case a parallel commit races us.
+        std::vector<TabularDatasetChunk> claimedChunks = popFrozenChunks();
+
         // Freeze all of the uncommitted chunks
         std::atomic<size_t> totalRows(0);
 
-        for (auto & c: frozenChunks)
+        for (auto & c: claimedChunks)
             totalRows += c.rowCount();
 
-        finalize(frozenChunks, totalRows);
+        finalize(claimedChunks, totalRows);
+
+        lastCommitTime = Date::now();
 
         size_t mem = 0;
         for (auto & c: chunks) {
@@ -930,6 +2607,156 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
              << 1.0 * mem / rowCount << " bytes/row" << endl;
         cerr << "column memory is " << columnMem << endl;
 
+        std::string path = persistedPath();
+        if (!path.empty()) {
+            ML::Timer persistTimer;
+            saveTabularFile(path, fixedColumns, chunks);
+            cerr << "persisted tabular dataset to " << path
+                 << " in " << persistTimer.elapsed() << endl;
+
+            // The persisted file now covers everything in the log
+            if (wal)
+                wal->checkpoint();
+        }
+    }
+
+    /// True while a background storage re-optimization pass is running
+    std::atomic<bool> optimizePassActive = { false };
+
+    /** Background re-optimization of committed column storage.
+
+        A chunk column can sit in a representation far bigger than what
+        freeze() would choose today: chunks reloaded from a persisted
+        file keep whatever representation they were written with, which
+        predates newer representations like run length or dictionary
+        coding.  This pass rebuilds each committed chunk column in
+        recordable form, re-freezes it through the current heuristics,
+        and swaps the result in when it is at least 25% smaller.
+        Readers are unaffected: they work through shared pointers, and
+        the swap happens under the dataset mutex like any commit.
+    */
+    void optimizeStorage()
+    {
+        struct Item {
+            uint32_t chunkIndex;
+            size_t columnEntry;
+            size_t numRows;
+            std::shared_ptr<const FrozenColumn> column;
+        };
+
+        std::vector<Item> items;
+
+        {
+            std::unique_lock<std::mutex> guard(datasetMutex);
+            for (size_t j = 0;  j < columns.size();  ++j) {
+                for (auto & ch: columns[j].chunks) {
+                    items.emplace_back
+                        (Item{ch.first, j,
+                              chunks.at(ch.first).rowCount(), ch.second});
+                }
+            }
+        }
+
+        size_t numRefrozen = 0;
+        int64_t bytesReclaimed = 0;
+
+        for (auto & item: items) {
+            const FrozenColumn & old = *item.column;
+
+            // Rebuild the recordable form from the frozen data
+            TabularDatasetColumn rebuilt;
+            bool started = false;
+            for (size_t r = 0;  r < item.numRows;  ++r) {
+                CellValue v = old.get(r);
+                if (v.empty() && !started)
+                    continue;  // leading nulls stay implicit
+                started = true;
+                rebuilt.add(r, std::move(v));
+            }
+
+            if (!started)
+                continue;  // entirely null in this chunk
+
+            auto candidate = rebuilt.freeze();
+
+            // Only swap for a clear win; equal-size churn would just
+            // dirty memory
+            size_t oldMem = old.memusage();
+            size_t newMem = candidate->memusage();
+            if (newMem * 4 > oldMem * 3)
+                continue;
+
+            std::unique_lock<std::mutex> guard(datasetMutex);
+
+            // A parallel commit may have replaced the column (or
+            // retention dropped its chunk) while we worked; only swap
+            // if it's still the one we rebuilt.
+            if (item.columnEntry >= columns.size())
+                continue;
+            ColumnEntry & entry = columns[item.columnEntry];
+
+            bool swapped = false;
+            for (auto & ch: entry.chunks) {
+                if (ch.first == item.chunkIndex && ch.second == item.column) {
+                    ch.second = candidate;
+                    swapped = true;
+                }
+            }
+            if (!swapped)
+                continue;
+
+            TabularDatasetChunk & chunk = chunks.at(item.chunkIndex);
+            auto fit = fixedColumnIndex.find(entry.columnName.newHash());
+            if (fit != fixedColumnIndex.end()) {
+                if (chunk.columns.at(fit->second) == item.column)
+                    chunk.columns.at(fit->second) = candidate;
+            }
+            else {
+                auto sit = chunk.sparseColumns.find(entry.columnName);
+                if (sit != chunk.sparseColumns.end()
+                    && sit->second == item.column)
+                    sit->second = candidate;
+            }
+
+            ++numRefrozen;
+            bytesReclaimed += (int64_t)oldMem - (int64_t)newMem;
+        }
+
+        if (numRefrozen > 0)
+            cerr << "storage optimization re-froze " << numRefrozen
+                 << " chunk columns, reclaiming " << bytesReclaimed
+                 << " bytes" << endl;
+    }
+
+    /** Kick off optimizeStorage() on the thread pool, unless a pass is
+        already running.  The job holds the shared pointer so the store
+        outlives it if the dataset is deleted mid-pass.
+    */
+    static void
+    scheduleOptimizeStorage(std::shared_ptr<TabularDataStore> self)
+    {
+        bool expected = false;
+        if (!self->optimizePassActive.compare_exchange_strong(expected, true))
+            return;
+
+        auto job = [self] ()
+            {
+                Scope_Exit(self->optimizePassActive = false);
+                try {
+                    self->optimizeStorage();
+                }
+                catch (const std::exception & exc) {
+                    cerr << "tabular storage optimization failed: "
+                         << exc.what() << endl;
+                }
+            };
+
+        try {
+            ThreadPool::instance().add(std::move(job));
+        } catch (...) {
+            self->optimizePassActive = false;
+            throw;
+        }
     }
 
     /// The number of background jobs that we're currently waiting for
@@ -962,8 +2789,34 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
     void addFrozenChunk(TabularDatasetChunk frozen)
     {
         ExcAssertNotEqual(frozen.rowCount(), 0);
-        std::unique_lock<std::mutex> guard(datasetMutex);
-        frozenChunks.emplace_back(std::move(frozen));
+
+        // Lock free multi producer push; commit() is the single
+        // consumer and claims the whole list at once.
+        auto node = new FrozenChunkNode{std::move(frozen), nullptr};
+        node->next = frozenChunks.load(std::memory_order_relaxed);
+        while (!frozenChunks.compare_exchange_weak
+               (node->next, node,
+                std::memory_order_release, std::memory_order_relaxed)) ;
+    }
+
+    /** Atomically take the whole frozen chunk hand off list, restoring
+        push order.
+    */
+    std::vector<TabularDatasetChunk> popFrozenChunks()
+    {
+        FrozenChunkNode * node
+            = frozenChunks.exchange(nullptr, std::memory_order_acquire);
+
+        std::vector<TabularDatasetChunk> result;
+        while (node) {
+            result.emplace_back(std::move(node->chunk));
+            FrozenChunkNode * next = node->next;
+            delete node;
+            node = next;
+        }
+
+        std::reverse(result.begin(), result.end());
+        return result;
     }
 
     std::shared_ptr<MutableTabularDatasetChunk>
@@ -1000,14 +2853,17 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
             initialize(std::move(columnNames));
 
             auto newChunks = std::make_shared<ChunkList>(NUM_PARALLEL_CHUNKS);
-            
-            for (auto & c: *newChunks) {
+
+            for (size_t i = 0;  i < newChunks->size();  ++i) {
                 auto newChunk = std::make_shared<MutableTabularDatasetChunk>
                     (fixedColumns.size(),
                      TABULAR_DATASET_DEFAULT_ROWS_PER_CHUNK);
-                c.store(std::move(newChunk));
+                newChunks->store(i, std::move(newChunk));
             }
-            
+
+            // The raw mirror is published first so that no epoch-based
+            // reader can ever see the list without it
+            mutableChunksRaw.store(newChunks.get());
             auto old = mutableChunks.exchange(std::move(newChunks));
             ExcAssert(!old);
         }
@@ -1063,16 +2919,38 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
     template<typename Vals>
     void recordRow(RowName rowName,
                    Vals&& vals)
+    {
+        // Write ahead: the row must be on disk before we acknowledge it
+        if (wal)
+            wal->append(rowName, vals);
+
+        if (config.writeBehind) {
+            recordRowWriteBehind(std::move(rowName), std::forward<Vals>(vals));
+            return;
+        }
+
+        recordRowSync(std::move(rowName), std::forward<Vals>(vals));
+    }
+
+    template<typename Vals>
+    void recordRowSync(RowName rowName,
+                       Vals&& vals)
     {
         if (rowCount > 0)
             HttpReturnException(400, "Tabular dataset has already been committed, cannot add more rows");
 
-        auto mc = mutableChunks.load();
+        // Enter an epoch instead of taking shared_ptr copies: the chunk
+        // list and the chunk itself are used through raw pointers for
+        // the duration of the row, so recording doesn't ping-pong any
+        // reference counts on hot chunks.
+        GcLockBase::SharedGuard gcGuard(mutableChunksGc);
+
+        ChunkList * mc = mutableChunksRaw.load(std::memory_order_acquire);
 
         if (!mc) {
             std::unique_lock<std::mutex> guard(datasetMutex);
             createFirstChunks(vals);
-            mc = mutableChunks.load();
+            mc = mutableChunksRaw.load(std::memory_order_acquire);
         }
 
         ExcAssert(mc);
@@ -1089,7 +2967,7 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
 
         for (int written = MutableTabularDatasetChunk::ADD_PERFORM_ROTATION;
              written != MutableTabularDatasetChunk::ADD_SUCCEEDED;) {
-            auto chunkPtr = mc->chunks[chunkNum].load();
+            MutableTabularDatasetChunk * chunkPtr = mc->rawGet(chunkNum);
             ExcAssert(chunkPtr);
             written = chunkPtr->add(rowName, ts,
                                     orderedVals.data(),
@@ -1099,20 +2977,101 @@ struct TabularDataset::TabularDataStore: public ColumnIndex, public MatrixView {
                 continue;  // busy wait until the rotation is done by another thread
             else if (written
                      == MutableTabularDatasetChunk::ADD_PERFORM_ROTATION) {
-                // We need a rotation, and we've been selected to do it
+                // We need a rotation, and we've been selected to do it.
+                // This is the cold path, so we take shared ownership of
+                // the outgoing chunk here.
                 auto newChunk = std::make_shared<MutableTabularDatasetChunk>
                     (fixedColumns.size(), TABULAR_DATASET_DEFAULT_ROWS_PER_CHUNK);
-                if (mc->chunks[chunkNum]
-                    .compare_exchange_strong(chunkPtr, newChunk)) {
-                    // Successful rotation.  First we background freeze
-                    // the chunk.  Then the old one goes in the list of
-                    // uncommitted chunks.
+                auto expected = mc->chunks[chunkNum].load();
+                if (expected.get() == chunkPtr
+                    && mc->replace(chunkNum, expected, newChunk)) {
+                    // Successful rotation.  Other recorders still inside
+                    // their epoch may hold a raw pointer to the old
+                    // chunk, so pin it until they have all left.  Then
+                    // we background freeze the chunk, and the old one
+                    // goes in the list of uncommitted chunks.
+                    mutableChunksGc.defer([expected] () {});
+
+                    freezeChunkInBackground(std::move(expected));
+                }
+            }
+        }
+    }
 
-                    freezeChunkInBackground(std::move(chunkPtr));
+    /* WRITE BEHIND
+
+       When the writeBehind config option is set, recorded rows are pushed
+       onto a bounded ring buffer and drained by a single maintenance
+       thread.  The recording threads never pay for chunk rotation or
+       freezing; they only ever wait when they produce rows faster than
+       the maintenance thread can apply them.
+    */
+
+    /// Row waiting on the write-behind queue
+    struct PendingRow {
+        RowName rowName;
+        std::vector<std::tuple<ColumnName, CellValue, Date> > vals;
+    };
+
+    /// Entries in the write-behind ring buffer.  Bounds the memory that
+    /// queued rows can take and provides backpressure to the producers.
+    static constexpr size_t WRITE_BEHIND_QUEUE_SIZE = 4096;
+
+    std::unique_ptr<ML::RingBufferSRMW<PendingRow> > writeBehindQueue;
+    std::thread writeBehindThread;
+    std::atomic<bool> writeBehindStopping;
+    std::atomic<bool> writeBehindFailed;
+    std::exception_ptr writeBehindError;
+
+    void recordRowWriteBehind(RowName rowName,
+                              std::vector<std::tuple<ColumnName, CellValue, Date> > vals)
+    {
+        if (writeBehindFailed)
+            std::rethrow_exception(writeBehindError);
+
+        PendingRow row{std::move(rowName), std::move(vals)};
+        while (!writeBehindQueue->tryPush(std::move(row))) {
+            // Queue full: wait for the maintenance thread to catch up.
+            // This is where the bounded queue applies backpressure.
+            std::this_thread::yield();
+        }
+    }
+
+    void runWriteBehind()
+    {
+        PendingRow row;
+        for (;;) {
+            if (writeBehindQueue->tryPop(row, 0.1 /* seconds */)) {
+                try {
+                    recordRowSync(std::move(row.rowName),
+                                  std::move(row.vals));
+                } catch (...) {
+                    // Surface the error on a later recordRow or at commit
+                    // time, and keep draining so that producers don't
+                    // block forever on a full queue.
+                    if (!writeBehindFailed) {
+                        writeBehindError = std::current_exception();
+                        writeBehindFailed = true;
+                    }
                 }
             }
+            else if (writeBehindStopping)
+                return;
         }
     }
+
+    /// Drain and join the write-behind thread.  Called at commit time
+    /// (which rethrows any deferred error) and on destruction (which
+    /// can't).
+    void stopWriteBehind(bool rethrow)
+    {
+        if (!writeBehindThread.joinable())
+            return;
+        writeBehindStopping = true;
+        writeBehindThread.join();
+        if (rethrow && writeBehindFailed)
+            std::rethrow_exception(writeBehindError);
+    }
 };
 
 TabularDataset::
@@ -1122,6 +3081,13 @@ TabularDataset(MldbServer * owner,
     : Dataset(owner)
 {
     itl = make_shared<TabularDataStore>(config.params.convert<TabularDatasetConfig>());
+    if (itl->loadFromPersistedFile()) {
+        // Files written before newer column representations existed may
+        // reload into representations freeze() wouldn't choose today
+        TabularDataStore::scheduleOptimizeStorage(itl);
+    }
+    itl->initializeWal();
+    itl->startReplication(owner);
 }
 
 TabularDataset::
@@ -1136,6 +3102,8 @@ getStatus() const
     Json::Value status;
     status["rowCount"] = itl->rowCount;
     status["columnCount"] = itl->columns.size();
+    if (itl->replicationServer)
+        status["replication"] = itl->replicationStatus();
     return status;
 }
 
@@ -1190,11 +3158,64 @@ getKnownColumnInfo(const ColumnName & columnName) const
     return itl->getKnownColumnInfo(columnName);
 }
 
+bool
+TabularDataset::
+rowsHaveSingleValuePerColumn() const
+{
+    return true;
+}
+
+ColumnSummaryStats
+TabularDataset::
+getColumnSummaryStats(const ColumnName & columnName) const
+{
+    return itl->getColumnSummaryStats(columnName);
+}
+
+DatasetMemoryUsage
+TabularDataset::
+getMemoryUsage() const
+{
+    return itl->getMemoryUsage();
+}
+
+RestRequestMatchResult
+TabularDataset::
+handleRequest(RestConnection & connection,
+              const RestRequest & request,
+              RestRequestParsingContext & context) const
+{
+    return itl->router.processRequest(connection, request, context);
+}
+
+uint64_t
+TabularDataset::
+getRowCountEstimate() const
+{
+    return itl->getRowCount();
+}
+
+std::vector<MatrixNamedRow>
+TabularDataset::
+getRows(const std::vector<RowName> & rowNames) const
+{
+    return itl->getRowBatch(rowNames);
+}
+
+int64_t
+TabularDataset::
+getColumnCardinalityEstimate(const ColumnName & columnName) const
+{
+    return itl->getColumnCardinalityEstimate(columnName);
+}
+
 void
 TabularDataset::
 commit()
 {
-    return itl->commit();
+    itl->commit();
+    TabularDataStore::scheduleOptimizeStorage(itl);
+    bumpVersion();
 }
 
 Dataset::MultiChunkRecorder
@@ -1237,6 +3258,10 @@ TabularDatasetConfig::
 TabularDatasetConfig()
 {
     unknownColumns = UC_ERROR;
+    writeBehind = false;
+    replicationPeriod = 1.0;
+    retentionPeriod = 0.0;
+    rowNameIndex = true;
 }
 
 DEFINE_ENUM_DESCRIPTION(UnknownColumnAction);
@@ -1261,6 +3286,61 @@ TabularDatasetConfigDescription()
              "'error' (default), or 'add' which will allow an unlimited "
              "number of sparse columns to be added.",
              UC_ERROR);
+    addField("dataFileUrl", &TabularDatasetConfig::dataFileUrl,
+             "Optional file:// URL that the committed dataset is persisted "
+             "to.  If the file already exists when the dataset is created, "
+             "the dataset is reloaded from it (memory-mapped) instead of "
+             "having to be re-recorded.");
+    addField("writeBehind", &TabularDatasetConfig::writeBehind,
+             "If true, recorded rows are pushed onto a bounded queue and "
+             "applied by a background maintenance thread, keeping recording "
+             "latency flat while full chunks are rotated and compressed.  "
+             "Errors are reported on a later record or at commit time.",
+             false);
+    addField("walFileUrl", &TabularDatasetConfig::walFileUrl,
+             "Optional file:// URL of a write-ahead log.  Recorded rows "
+             "are appended to it (with group commit) before being "
+             "acknowledged, and replayed from it when the dataset is "
+             "recreated after a crash.  The log is truncated when a "
+             "commit persists the dataset to dataFileUrl.");
+    addField("replicateFromPeer", &TabularDatasetConfig::replicateFromPeer,
+             "Name of the peer to replicate from.  When set, this dataset "
+             "is a read-only replica: committed chunks are pulled from the "
+             "primary over the peer channel (compressed) and applied as "
+             "they appear.");
+    addField("replicateFromDataset",
+             &TabularDatasetConfig::replicateFromDataset,
+             "Id of the dataset on the primary peer to replicate from.  "
+             "Required when replicateFromPeer is set.");
+    addField("replicationPeriod", &TabularDatasetConfig::replicationPeriod,
+             "How often (in seconds) a replica polls the primary for newly "
+             "committed chunks.  The replication lag is bounded by this "
+             "plus the transfer time.",
+             1.0);
+    addField("retentionPeriod", &TabularDatasetConfig::retentionPeriod,
+             "How long (in seconds) rows are retained, or 0 (the default) "
+             "to keep them forever.  Rows expire a whole chunk at a time: "
+             "at each commit, and when the dataset is reloaded from "
+             "dataFileUrl, chunks whose newest row timestamp has passed "
+             "the retention horizon are dropped in their entirety, so "
+             "retention is a metadata operation rather than a re-import.",
+             0.0);
+    addField("rowNameIndex", &TabularDatasetConfig::rowNameIndex,
+             "If false, no row name index is built when the dataset is "
+             "committed, saving the memory and commit time it would take.  "
+             "Only for datasets that are addressed exclusively by scanning "
+             "(queries over all rows): any point lookup of a row by name "
+             "or row hash is an error on such a dataset.",
+             true);
+    addField("timeColumn", &TabularDatasetConfig::timeColumn,
+             "Name of the event-time column, or empty (the default) for "
+             "none.  When set, the commit builds a sorted sparse index on "
+             "that column (block-level fences plus per-chunk sorted "
+             "offsets), and WHERE clauses that bound it (BETWEEN or "
+             "comparisons against constants) binary search to the "
+             "matching rows instead of scanning, so time-window queries "
+             "cost in proportion to the window rather than to the "
+             "history retained.");
 }
 
 namespace {
@@ -33,6 +33,50 @@ struct TabularDatasetConfig {
     TabularDatasetConfig();
 
     UnknownColumnAction unknownColumns;
+
+    /// Optional file that the committed dataset is persisted to.  If the
+    /// file already exists when the dataset is created, the dataset is
+    /// reloaded from it (memory-mapped) instead of being re-recorded.
+    Url dataFileUrl;
+
+    /// If true, recorded rows are queued and applied by a background
+    /// maintenance thread, so that recording never waits on chunk
+    /// rotation or freezing.
+    bool writeBehind;
+
+    /// Optional file that recorded rows are appended to (with group
+    /// commit) before being acknowledged.  After a crash, rows since
+    /// the last persisted commit are replayed from it on creation.
+    Url walFileUrl;
+
+    /// Name of the peer to replicate from.  When set, this dataset is a
+    /// read-only replica: committed chunks are pulled from the primary
+    /// over the peer channel and applied as they appear.
+    std::string replicateFromPeer;
+
+    /// Id of the dataset on the primary peer to replicate from
+    std::string replicateFromDataset;
+
+    /// How often (in seconds) a replica polls the primary for newly
+    /// committed chunks
+    double replicationPeriod;
+
+    /// How long (in seconds) rows are retained, or 0 to keep them
+    /// forever.  Rows expire a whole chunk at a time: at each commit
+    /// (and on reload from dataFileUrl), chunks whose newest row
+    /// timestamp has passed the horizon are dropped.
+    double retentionPeriod;
+
+    /// If false, no row name index is built at commit time.  For
+    /// datasets addressed only by scan; point lookups by row name
+    /// become errors.
+    bool rowNameIndex;
+
+    /// Name of the event-time column, or empty for none.  When set, a
+    /// sorted sparse index (per-chunk row offsets ordered by that
+    /// column) is built at commit time and time-range predicates binary
+    /// search instead of scanning.
+    Utf8String timeColumn;
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(TabularDatasetConfig);
@@ -64,6 +108,47 @@ struct TabularDataset : public Dataset {
 
     virtual KnownColumn getKnownColumnInfo(const ColumnName & columnName) const;
 
+    /** Columnar storage holds one cell per (row, column), so this always
+        returns true; bound column references use it to skip the per-row
+        search through the materialized row.
+    */
+    virtual bool rowsHaveSingleValuePerColumn() const;
+
+    /** Served from the per-chunk statistics recorded at freeze time, so
+        this is a metadata read, not a column scan.
+    */
+    virtual ColumnSummaryStats
+    getColumnSummaryStats(const ColumnName & columnName) const;
+
+    /** Memory held by the frozen chunks, per column.  Committed data
+        only; rows still in the mutable chunks are not counted.
+    */
+    virtual DatasetMemoryUsage getMemoryUsage() const;
+
+    /** Type-specific routes.  POST /routes/publish writes the committed
+        dataset as a shared memory segment that a co-located instance
+        can attach to through its dataFileUrl.
+    */
+    virtual RestRequestMatchResult
+    handleRequest(RestConnection & connection,
+                  const RestRequest & request,
+                  RestRequestParsingContext & context) const;
+
+    /** O(1): the row count is maintained as rows are recorded. */
+    virtual uint64_t getRowCountEstimate() const;
+
+    /** Batched point lookups that probe the row index in one pass,
+        with the hash bucket loads prefetched ahead of the probes.
+    */
+    virtual std::vector<MatrixNamedRow>
+    getRows(const std::vector<RowName> & rowNames) const;
+
+    /** Served from the distinct value sketches recorded at freeze
+        time; returns -1 for unknown columns rather than throwing.
+    */
+    virtual int64_t
+    getColumnCardinalityEstimate(const ColumnName & columnName) const;
+
     /** Commit changes to the database. */
     virtual void commit();
 
@@ -8,7 +8,10 @@
 #pragma once
 
 #include <unordered_map>
+#include <atomic>
 #include "frozen_column.h"
+#include "mldb/base/thread_pool.h"
+#include "mldb/base/scope.h"
 #include <mutex>
 
 namespace Datacratic {
@@ -88,6 +91,22 @@ struct TabularDatasetChunk {
         return result;
     }
 
+    /** Time range covered by the chunk's row timestamps, from the zone
+        map of the frozen timestamp column.  Used to drop whole expired
+        chunks when a retention period is configured.
+    */
+    Date minTimestamp() const
+    {
+        const CellValue & v = timestamps->zoneMap.minValue;
+        return v.empty() ? Date::negativeInfinity() : v.toTimestamp();
+    }
+
+    Date maxTimestamp() const
+    {
+        const CellValue & v = timestamps->zoneMap.maxValue;
+        return v.empty() ? Date::positiveInfinity() : v.toTimestamp();
+    }
+
     const FrozenColumn *
     maybeGetColumn(size_t columnIndex, const PathElement & columnName) const
     {
@@ -192,13 +211,56 @@ struct MutableTabularDatasetChunk {
         result.columns.resize(columns.size());
         result.sparseColumns.reserve(sparseColumns.size());
 
-        for (unsigned i = 0;  i < columns.size();  ++i)
-            result.columns[i] = columns[i].freeze();
+        // Each column freezes independently of the others, so spread
+        // them over the thread pool rather than grinding through them
+        // on one core.  Sparse columns get a stable slot to freeze into
+        // before any job runs, and are moved into the map afterwards.
+        std::vector<std::pair<const ColumnName *, std::shared_ptr<FrozenColumn> > >
+            frozenSparse;
+        frozenSparse.reserve(sparseColumns.size());
         for (auto & c: sparseColumns)
-            result.sparseColumns.emplace(c.first, c.second.freeze());
+            frozenSparse.emplace_back(&c.first, nullptr);
+
+        std::atomic<size_t> jobsActive(0);
+
+        auto freezeInBackground = [&] (std::function<void ()> freezeColumn)
+            {
+                auto job = [&jobsActive, freezeColumn] ()
+                    {
+                        Scope_Exit(--jobsActive);
+                        freezeColumn();
+                    };
+
+                ++jobsActive;
+                try {
+                    ThreadPool::instance().add(std::move(job));
+                } catch (...) {
+                    --jobsActive;
+                    throw;
+                }
+            };
+
+        for (unsigned i = 0;  i < columns.size();  ++i)
+            freezeInBackground([&,i] ()
+                               { result.columns[i] = columns[i].freeze(); });
+        for (unsigned i = 0;  i < frozenSparse.size();  ++i)
+            freezeInBackground([&,i] ()
+                               { frozenSparse[i].second
+                                     = sparseColumns[*frozenSparse[i].first]
+                                         .freeze(); });
 
-        result.timestamps = timestamps.freeze();
         result.rowNames = std::move(rowNames);
+        result.timestamps = timestamps.freeze();
+
+        // Busy wait while working in between, so that freezing from
+        // within a pool thread (as the background freeze on chunk
+        // rotation does) can't deadlock when no other threads are
+        // available.
+        while (jobsActive)
+            ThreadPool::instance().work();
+
+        for (auto & c: frozenSparse)
+            result.sparseColumns.emplace(*c.first, std::move(c.second));
 
         isFrozen = true;
 
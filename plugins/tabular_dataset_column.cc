@@ -18,7 +18,8 @@ namespace MLDB {
 
 TabularDatasetColumn::
 TabularDatasetColumn()
-    : minRowNumber(-1), maxRowNumber(-1), isFrozen(false)
+    : minRowNumber(-1), maxRowNumber(-1), isFrozen(false),
+      directStorage(false), numValues(0)
 {
 }
 
@@ -56,12 +57,25 @@ TabularDatasetColumn::
 getIndex(CellValue & val)
 {
     ExcAssert(!isFrozen);
+    ++numValues;
+
     // Optimization: if we're recording the same value as
     // the last column, then we don't need to do anything
     if (!sparseIndexes.empty() && val == lastValue) {
         return sparseIndexes.back().second;
     }
 
+    // High cardinality columns get no benefit from the dictionary, so
+    // once the ratio check has tripped we just append: no hash probe,
+    // no probe table growth
+    if (directStorage) {
+        columnTypes.update(val);
+        int index = indexedVals.size();
+        indexedVals.emplace_back(val);
+        lastValue = std::move(val);
+        return index;
+    }
+
     // Optimization: if there are only a few values, do a
     // linear search and don't bother with the hashing
 
@@ -90,6 +104,16 @@ getIndex(CellValue & val)
         index = it->second;
     }
 
+    // Evaluate the distinct ratio once, after a sample's worth of
+    // values.  Mostly-distinct means the dictionary is all cost: switch
+    // to direct storage and drop the probe table.  Columns that stay in
+    // dictionary mode never pay more than this one comparison per cell.
+    if (JML_UNLIKELY(numValues == CARDINALITY_SAMPLE_VALUES)
+        && indexedVals.size() * 2 >= numValues) {
+        directStorage = true;
+        valueIndex = ML::Lightweight_Hash<uint64_t, int>();
+    }
+
     return index;
 }
 
@@ -21,9 +21,20 @@ namespace MLDB {
 
 /** Represents a column of a tabular dataset that's currently being
     constructed as the inversion of a row by row insert.
+
+    Values are dictionary coded as they arrive: each distinct value is
+    stored once in indexedVals and rows store its index.  That pays one
+    hash probe per cell, which is pure overhead for identifier-like
+    columns where nearly every value is new.  Once the distinct ratio
+    over the first values shows the dictionary isn't earning its keep,
+    the column switches to direct storage: new values are appended
+    without a probe, and the probe table is dropped.
 */
 
 struct TabularDatasetColumn {
+    /// Number of values after which the distinct ratio is evaluated
+    static constexpr size_t CARDINALITY_SAMPLE_VALUES = 10000;
+
     TabularDatasetColumn();
 
     /** Add a value for the given row number (which must be greater than
@@ -48,6 +59,12 @@ struct TabularDatasetColumn {
     */
     void reserve(size_t sz);
 
+    /** Value table indexed by sparseIndexes.  Distinct while the
+        dictionary is active; once a column has switched to direct
+        storage a value that re-occurs non-adjacently is stored again,
+        so consumers of the frozen table (eg forEachDistinctValue
+        callers) must tolerate the occasional repeat.
+    */
     std::vector<CellValue> indexedVals;
     ML::Lightweight_Hash<uint64_t, int> valueIndex;
     CellValue lastValue;
@@ -56,6 +73,8 @@ struct TabularDatasetColumn {
     int64_t maxRowNumber;  ///< Including null values not in sparseIndexes
     ColumnTypes columnTypes;
     bool isFrozen;
+    bool directStorage;    ///< Dictionary abandoned; values appended as-is
+    size_t numValues;      ///< Non-null values seen, for the ratio check
 
 
     std::shared_ptr<FrozenColumn> freeze();
@@ -0,0 +1,313 @@
+/** tabular_persistence.cc                                         -*- C++ -*-
+    Jeremy Barnes, 29 August 2016
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Implementation of the memory-mappable on-disk format for tabular
+    datasets.
+*/
+
+#include "tabular_persistence.h"
+#include "frozen_column.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/types/value_description.h"
+#include "mldb/http/http_exception.h"
+#include "mldb/vfs/fs_utils.h"
+#include <boost/iostreams/operations.hpp>
+#include "mldb/vfs/lz4_filter.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/device/array.hpp>
+
+using namespace std;
+
+namespace Datacratic {
+namespace MLDB {
+
+namespace {
+
+static constexpr uint64_t TABULAR_FILE_MAGIC = 0x314c425454424c4dULL; // "MLDBTTBL1"
+static constexpr uint32_t TABULAR_FILE_VERSION = 3;  // v3: bloom filters in the zone maps
+
+} // file scope
+
+
+/*****************************************************************************/
+/* TABULAR FILE WRITER                                                       */
+/*****************************************************************************/
+
+void
+TabularFileWriter::
+writeU32(uint32_t val)
+{
+    stream.write((const char *)&val, sizeof(val));
+    offset += sizeof(val);
+}
+
+void
+TabularFileWriter::
+writeU64(uint64_t val)
+{
+    stream.write((const char *)&val, sizeof(val));
+    offset += sizeof(val);
+}
+
+void
+TabularFileWriter::
+writeString(const std::string & str)
+{
+    writeU32(str.size());
+    stream.write(str.data(), str.size());
+    offset += str.size();
+}
+
+void
+TabularFileWriter::
+writeAlignedBytes(const void * data, size_t numBytes)
+{
+    static const char padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    size_t pad = (8 - offset % 8) % 8;
+    stream.write(padding, pad);
+    stream.write((const char *)data, numBytes);
+    offset += pad + numBytes;
+}
+
+
+/*****************************************************************************/
+/* TABULAR FILE READER                                                       */
+/*****************************************************************************/
+
+TabularFileReader::
+TabularFileReader(const std::string & filename)
+    : buffer(filename), offset(0)
+{
+}
+
+TabularFileReader::
+TabularFileReader(ML::File_Read_Buffer buffer)
+    : buffer(std::move(buffer)), offset(0)
+{
+}
+
+uint32_t
+TabularFileReader::
+readU32()
+{
+    if (offset + sizeof(uint32_t) > buffer.size())
+        throw HttpReturnException(400, "Truncated tabular dataset file",
+                                  "filename", buffer.filename());
+    uint32_t result;
+    std::memcpy(&result, buffer.start() + offset, sizeof(result));
+    offset += sizeof(result);
+    return result;
+}
+
+uint64_t
+TabularFileReader::
+readU64()
+{
+    if (offset + sizeof(uint64_t) > buffer.size())
+        throw HttpReturnException(400, "Truncated tabular dataset file",
+                                  "filename", buffer.filename());
+    uint64_t result;
+    std::memcpy(&result, buffer.start() + offset, sizeof(result));
+    offset += sizeof(result);
+    return result;
+}
+
+std::string
+TabularFileReader::
+readString()
+{
+    uint32_t len = readU32();
+    if (offset + len > buffer.size())
+        throw HttpReturnException(400, "Truncated tabular dataset file",
+                                  "filename", buffer.filename());
+    std::string result(buffer.start() + offset, buffer.start() + offset + len);
+    offset += len;
+    return result;
+}
+
+std::shared_ptr<const void>
+TabularFileReader::
+mapAlignedBytes(size_t numBytes)
+{
+    offset += (8 - offset % 8) % 8;
+    if (offset + numBytes > buffer.size())
+        throw HttpReturnException(400, "Truncated tabular dataset file",
+                                  "filename", buffer.filename());
+    const char * data = buffer.start() + offset;
+    offset += numBytes;
+
+    // Alias the mapped region so that the mapping stays alive as long as
+    // any column points into it.
+    auto region = buffer.region;
+    return std::shared_ptr<const void>(region, data);
+}
+
+
+/*****************************************************************************/
+/* FILE LEVEL OPERATIONS                                                     */
+/*****************************************************************************/
+
+static void
+writeTabularStream(std::ostream & stream,
+                   const std::vector<ColumnName> & fixedColumns,
+                   const std::vector<TabularDatasetChunk> & chunks,
+                   size_t firstChunk = 0)
+{
+    TabularFileWriter writer(stream);
+
+    writer.writeU64(TABULAR_FILE_MAGIC);
+    writer.writeU32(TABULAR_FILE_VERSION);
+    writer.writeU32(fixedColumns.size());
+    writer.writeU32(chunks.size() - firstChunk);
+
+    writer.writeString(jsonEncodeStr(fixedColumns));
+
+    for (size_t i = firstChunk;  i < chunks.size();  ++i) {
+        const TabularDatasetChunk & chunk = chunks[i];
+
+        writer.writeString(jsonEncodeStr(chunk.rowNames));
+
+        writer.writeU32(chunk.columns.size());
+        for (auto & c: chunk.columns)
+            c->serialize(writer);
+
+        writer.writeU32(chunk.sparseColumns.size());
+        for (auto & c: chunk.sparseColumns) {
+            writer.writeString(jsonEncodeStr(c.first));
+            c.second->serialize(writer);
+        }
+
+        chunk.timestamps->serialize(writer);
+    }
+}
+
+void
+saveTabularFile(const std::string & filename,
+                const std::vector<ColumnName> & fixedColumns,
+                const std::vector<TabularDatasetChunk> & chunks)
+{
+    makeUriDirectory(filename);
+
+    std::ofstream stream(filename, std::ios::binary);
+    if (!stream)
+        throw HttpReturnException(400, "Couldn't open tabular dataset file "
+                                  "for writing",
+                                  "filename", filename);
+
+    writeTabularStream(stream, fixedColumns, chunks);
+
+    stream.flush();
+    if (!stream)
+        throw HttpReturnException(400, "Error writing tabular dataset file",
+                                  "filename", filename);
+}
+
+static std::pair<std::vector<ColumnName>,
+                 std::vector<TabularDatasetChunk> >
+readTabularStream(TabularFileReader & reader, const std::string & filename)
+{
+    if (reader.readU64() != TABULAR_FILE_MAGIC)
+        throw HttpReturnException(400, "File is not a tabular dataset file",
+                                  "filename", filename);
+    uint32_t version = reader.readU32();
+    if (version != TABULAR_FILE_VERSION)
+        throw HttpReturnException(400, "Unknown tabular dataset file version",
+                                  "filename", filename,
+                                  "version", version);
+
+    uint32_t numFixedColumns = reader.readU32();
+    uint32_t numChunks = reader.readU32();
+
+    auto fixedColumns
+        = jsonDecodeStr<std::vector<ColumnName> >(reader.readString());
+    if (fixedColumns.size() != numFixedColumns)
+        throw HttpReturnException(400, "Corrupt tabular dataset file",
+                                  "filename", filename);
+
+    std::vector<TabularDatasetChunk> chunks;
+    chunks.reserve(numChunks);
+
+    for (size_t i = 0;  i < numChunks;  ++i) {
+        TabularDatasetChunk chunk;
+        chunk.rowNames
+            = jsonDecodeStr<std::vector<RowName> >(reader.readString());
+
+        uint32_t numColumns = reader.readU32();
+        chunk.columns.reserve(numColumns);
+        for (size_t j = 0;  j < numColumns;  ++j)
+            chunk.columns.emplace_back(FrozenColumn::reconstitute(reader));
+
+        uint32_t numSparseColumns = reader.readU32();
+        chunk.sparseColumns.reserve(numSparseColumns);
+        for (size_t j = 0;  j < numSparseColumns;  ++j) {
+            auto name = jsonDecodeStr<ColumnName>(reader.readString());
+            chunk.sparseColumns.emplace(std::move(name),
+                                        FrozenColumn::reconstitute(reader));
+        }
+
+        chunk.timestamps = FrozenColumn::reconstitute(reader);
+
+        chunks.emplace_back(std::move(chunk));
+    }
+
+    return { std::move(fixedColumns), std::move(chunks) };
+}
+
+std::pair<std::vector<ColumnName>,
+          std::vector<TabularDatasetChunk> >
+loadTabularFile(const std::string & filename)
+{
+    TabularFileReader reader(filename);
+    return readTabularStream(reader, filename);
+}
+
+std::string
+encodeTabularChunks(const std::vector<ColumnName> & fixedColumns,
+                    const std::vector<TabularDatasetChunk> & chunks,
+                    size_t firstChunk)
+{
+    std::string result;
+
+    boost::iostreams::filtering_ostream stream;
+    stream.push(lz4_compressor());
+    stream.push(boost::iostreams::back_inserter(result));
+
+    writeTabularStream(stream, fixedColumns, chunks, firstChunk);
+
+    stream.reset();  // flush the compressor
+
+    return result;
+}
+
+std::pair<std::vector<ColumnName>,
+          std::vector<TabularDatasetChunk> >
+decodeTabularChunks(const std::string & blob)
+{
+    // Decompress to an anonymous buffer; the columns point into it and
+    // keep it alive through the File_Read_Buffer's region.
+    auto decompressed = std::make_shared<std::string>();
+
+    {
+        boost::iostreams::filtering_istream stream;
+        stream.push(lz4_decompressor());
+        stream.push(boost::iostreams::array_source(blob.data(), blob.size()));
+
+        char buf[65536];
+        while (stream) {
+            stream.read(buf, sizeof(buf));
+            decompressed->append(buf, stream.gcount());
+        }
+    }
+
+    ML::File_Read_Buffer buffer(decompressed->data(), decompressed->size(),
+                                "replicated tabular chunks",
+                                [decompressed] () {});
+
+    TabularFileReader reader(std::move(buffer));
+    return readTabularStream(reader, "replicated tabular chunks");
+}
+
+} // namespace MLDB
+} // namespace Datacratic
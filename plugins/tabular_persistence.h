@@ -0,0 +1,118 @@
+/** tabular_persistence.h                                          -*- C++ -*-
+    Jeremy Barnes, 29 August 2016
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Memory-mappable on-disk format for tabular datasets.  The frozen
+    column representations are written out as-is (metadata plus their raw
+    storage words), so that reloading is a matter of mapping the file and
+    pointing the columns back into it: restart cost is bounded by page
+    faults, not by re-importing and re-freezing the data.
+*/
+
+#pragma once
+
+#include "mldb/core/dataset.h"
+#include "tabular_dataset_column.h"
+#include "tabular_dataset_chunk.h"
+#include "mldb/jml/utils/file_functions.h"
+#include <iostream>
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* TABULAR FILE WRITER                                                       */
+/*****************************************************************************/
+
+/** Writes the primitive pieces of the tabular file format to a stream.
+    Raw storage arrays are 8 byte aligned within the file so that the
+    reader can point directly into the mapping.
+*/
+
+struct TabularFileWriter {
+    TabularFileWriter(std::ostream & stream)
+        : stream(stream), offset(0)
+    {
+    }
+
+    void writeU32(uint32_t val);
+    void writeU64(uint64_t val);
+
+    /// Length-prefixed byte string (used for JSON-encoded metadata)
+    void writeString(const std::string & str);
+
+    /// Raw bytes, padded to an 8 byte boundary first
+    void writeAlignedBytes(const void * data, size_t numBytes);
+
+    std::ostream & stream;
+    uint64_t offset;   ///< Bytes written so far
+};
+
+
+/*****************************************************************************/
+/* TABULAR FILE READER                                                       */
+/*****************************************************************************/
+
+/** Reads the tabular file format from a memory-mapped file.  Raw storage
+    arrays are returned as pointers into the mapping, with a shared
+    pointer that keeps the mapping alive; nothing is copied.
+*/
+
+struct TabularFileReader {
+    TabularFileReader(const std::string & filename);
+
+    /// Read from an in-memory buffer (eg a replicated chunk blob)
+    TabularFileReader(ML::File_Read_Buffer buffer);
+
+    uint32_t readU32();
+    uint64_t readU64();
+    std::string readString();
+
+    /** Return a pointer to the next numBytes bytes of the file (after
+        skipping the alignment padding), without copying.  The returned
+        shared pointer holds a reference to the underlying mapping.
+    */
+    std::shared_ptr<const void> mapAlignedBytes(size_t numBytes);
+
+    ML::File_Read_Buffer buffer;
+    uint64_t offset;   ///< Bytes consumed so far
+};
+
+
+/*****************************************************************************/
+/* FILE LEVEL OPERATIONS                                                     */
+/*****************************************************************************/
+
+/** Write the given frozen chunks and fixed column names to the given
+    (local) file.
+*/
+void saveTabularFile(const std::string & filename,
+                     const std::vector<ColumnName> & fixedColumns,
+                     const std::vector<TabularDatasetChunk> & chunks);
+
+/** Load a file written by saveTabularFile, memory mapping the column
+    storage.  Returns the fixed column names and the frozen chunks.
+*/
+std::pair<std::vector<ColumnName>,
+          std::vector<TabularDatasetChunk> >
+loadTabularFile(const std::string & filename);
+
+/** Encode the frozen chunks starting at firstChunk as an lz4-compressed
+    blob in the same format, suitable for shipping over the peer channel
+    to a replica.
+*/
+std::string encodeTabularChunks(const std::vector<ColumnName> & fixedColumns,
+                                const std::vector<TabularDatasetChunk> & chunks,
+                                size_t firstChunk = 0);
+
+/** Decode a blob written by encodeTabularChunks.  The column storage
+    points into a decompressed copy of the blob, which is kept alive by
+    the chunks.
+*/
+std::pair<std::vector<ColumnName>,
+          std::vector<TabularDatasetChunk> >
+decodeTabularChunks(const std::string & blob);
+
+} // namespace MLDB
+} // namespace Datacratic
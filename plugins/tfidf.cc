@@ -20,6 +20,7 @@
 #include "mldb/ml/value_descriptions.h"
 #include "mldb/sql/sql_expression.h"
 #include "mldb/server/analytics.h"
+#include "mldb/server/per_thread_accumulator.h"
 #include "mldb/types/any_impl.h"
 #include "mldb/types/optional_description.h"
 #include "mldb/vfs/filter_streams.h"
@@ -199,12 +200,21 @@ run(const ProcedureRunConfig & run,
     std::unordered_map<Utf8String, uint64_t> dfs;
     std::atomic<uint64_t> corpusSize(0);
 
+    // Each worker accumulates document frequencies into its own map;
+    // the maps are folded together afterwards, so no token is hashed
+    // under a lock while the corpus is scanned.  The maps are keyed by
+    // the interned column name, so no string is materialized per cell;
+    // terms are converted to strings once per distinct term when the
+    // shards are folded below.
+    typedef std::unordered_map<ColumnName, uint64_t, PathNewHasher> TermCounts;
+    PerThreadAccumulator<TermCounts> dfsAccum;
+
     auto processor = [&] (NamedRowValue & row_)
         {
+            auto & localDfs = dfsAccum.get();
             MatrixNamedRow row = row_.flattenDestructive();
             for (auto& col : row.columns) {
-                Utf8String word = get<0>(col).toUtf8String();
-                dfs[word] += 1;
+                localDfs[get<0>(col)] += 1;
             }
             ++corpusSize;
 
@@ -214,12 +224,20 @@ run(const ProcedureRunConfig & run,
     iterateDataset(runProcConf.trainingData.stm->select, *boundDataset.dataset, boundDataset.asName,
                    runProcConf.trainingData.stm->when,
                    *runProcConf.trainingData.stm->where,
-                   {processor,false/*processInParallel*/},
+                   {processor,true/*processInParallel*/},
                    runProcConf.trainingData.stm->orderBy,
                    runProcConf.trainingData.stm->offset,
                    runProcConf.trainingData.stm->limit,
                    onProgress);
 
+    // Fold the per-thread maps together, converting each distinct term
+    // to its string form exactly once
+    dfsAccum.forEach([&] (TermCounts * shard)
+        {
+            for (auto & df: *shard)
+                dfs[df.first.toUtf8String()] += df.second;
+        });
+
     bool saved = false;
     if (!runProcConf.modelFileUrl.empty()) {
         try {
@@ -311,6 +329,10 @@ TfidfFunction(MldbServer * owner,
 {
     functionConfig = config.params.convert<TfidfFunctionConfig>();
     load(functionConfig.modelFileUrl.toString(), corpusSize, dfs);
+
+    dfsByTerm.reserve(dfs.size());
+    for (auto & df: dfs)
+        dfsByTerm[PathElement(df.first)] = df.second;
 }
 
 Any
@@ -332,15 +354,28 @@ apply(const FunctionApplier & applier,
     uint64_t maxFrequency = 0; // max term frequency for the current document
     uint64_t maxNt = 0;        // max document frequency for terms in the current doc
 
+    // Gather the terms once, looking each up by its interned name so
+    // no string is materialized per column; the scoring pass below
+    // reuses the entries rather than walking the row again
+    struct TermEntry {
+        PathElement name;
+        double frequency;
+        uint64_t df;
+    };
+    std::vector<TermEntry> terms;
+
     auto onColumn = [&] (const PathElement & name,
                          const ExpressionValue & val)
         {
-            Utf8String term = name.toUtf8String();
             uint64_t value = val.getAtom().toUInt();
             maxFrequency = std::max(value, maxFrequency);
-            const auto termFrequency = dfs.find(term);
-            if (termFrequency != dfs.end())
-                maxNt = std::max(maxNt, termFrequency->second); 
+            uint64_t df = 0;
+            const auto termFrequency = dfsByTerm.find(name);
+            if (termFrequency != dfsByTerm.end()) {
+                df = termFrequency->second;
+                maxNt = std::max(maxNt, df);
+            }
+            terms.push_back({name, (double)value, df});
             return true;
         };
 
@@ -415,26 +450,12 @@ apply(const FunctionApplier & applier,
     // Compute the score for every word in the input
     logger->debug() << "corpus size: " << corpusSize;
 
-    auto onColumn2 = [&] (const PathElement & name,
-                          const ExpressionValue & val)
-        {
-            Utf8String term = name.toUtf8String();
-            double frequency = val.getAtom().toDouble();
-
-            double tf = tf_fct(frequency);
-            const auto docFrequency = dfs.find(term);
-            uint64_t docFrequencyInt = docFrequency != dfs.end() ? docFrequency->second : 0;
-            double idf = idf_fct(docFrequencyInt);
+    for (auto & term: terms) {
+        double tf = tf_fct(term.frequency);
+        double idf = idf_fct(term.df);
 
-            logger->debug()
-                << "term: '" << term << "', df: "
-                << docFrequencyInt << ", tf: " << tf << ", idf: " << idf;
-
-            values.emplace_back(name, tf*idf, ts);
-            return true;
-        };
-
-    inputVal.forEachColumn(onColumn2);
+        values.emplace_back(std::move(term.name), tf*idf, ts);
+    }
 
     StructValue outputRow;
     outputRow.emplace_back("output", std::move(values));
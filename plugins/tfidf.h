@@ -105,6 +105,9 @@ struct TfidfFunction: public Function {
     TfidfFunctionConfig functionConfig;
     // document frequencies for terms
     std::unordered_map<Utf8String, uint64_t> dfs;
+    // same frequencies keyed by the interned term, so that scoring a
+    // document looks terms up without materializing a string per column
+    std::unordered_map<PathElement, uint64_t, PathElementNewHasher> dfsByTerm;
     uint64_t corpusSize;
 };
 
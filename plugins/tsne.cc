@@ -138,8 +138,8 @@ struct TsneItl {
     {
         using namespace ML::DB;
 
-        store << string("TSNE") << compact_size_t(2);
-        
+        store << string("TSNE") << compact_size_t(3);
+
         size_t rows = inputPath.shape()[0];
         size_t dimsIn = inputPath.shape()[1];
         size_t dimsOut = outputPath.shape()[1];
@@ -148,7 +148,13 @@ struct TsneItl {
         store << compact_size_t(rows)
               << compact_size_t(dimsIn)
               << compact_size_t(dimsOut);
-        
+
+        // Parameters needed to re-embed new points consistently with
+        // how the model was trained (version 3 onwards)
+        store << compact_size_t(params.numNeighbours)
+              << params.perplexity << params.tolerance
+              << params.min_distance_ratio;
+
         store << inputPath << outputPath;
 
         store << inputColumnNames << outputColumnNames;
@@ -166,11 +172,19 @@ struct TsneItl {
         if (tag != "TSNE")
             throw ML::Exception("Expected TSNE tag");
         compact_size_t version(store);
-        if (version != 2)
+        if (version != 2 && version != 3)
             throw ML::Exception("Unknown version for t-SNE");
 
         compact_size_t rows(store), dimsIn(store), dimsOut(store);
 
+        if (version >= 3) {
+            // Version 2 artifacts keep the default parameters
+            compact_size_t numNeighbours(store);
+            params.numNeighbours = numNeighbours;
+            store >> params.perplexity >> params.tolerance
+                  >> params.min_distance_ratio;
+        }
+
         store >> inputPath >> outputPath;
 
         store >> inputColumnNames >> outputColumnNames;
@@ -388,15 +402,16 @@ DEFINE_STRUCTURE_DESCRIPTION(TsneInput);
 TsneInputDescription::TsneInputDescription()
 {
     addField("embedding", &TsneInput::embedding,
-             "Undocumented.");
+             "High-dimensional point to embed, with the same columns as "
+             "the training data of the t-SNE model.");
 }
 
 DEFINE_STRUCTURE_DESCRIPTION(TsneOutput);
 
 TsneOutputDescription::TsneOutputDescription()
 {
-    addField("cluster", &TsneOutput::tsne,
-             "Undocumented.");
+    addField("tsne", &TsneOutput::tsne,
+             "Coordinates of the point in the low-dimensional embedding.");
 }
 
 
@@ -411,26 +426,31 @@ TsneEmbed(MldbServer * owner,
 }
 
 
-TsneOutput 
+TsneOutput
 TsneEmbed::
 call(TsneInput input) const
 {
-    throw HttpReturnException(500, "t-SNE Embed apply function is not yet implemented");
-#if 0    
-    ExpressionValue result;
+    Date ts = input.embedding.getEffectiveTimestamp();
 
-    ExpressionValue storage;
-    const ExpressionValue & inputVal = context.get("embedding", storage);
+    ML::distribution<float> coords
+        = input.embedding.getEmbedding(itl->inputColumnNames.size());
 
-    ML::distribution<float> input = inputVal.getEmbedding(itl->inputColumnNames.size());
+    for (auto & c: coords) {
+        if (!isfinite(c))
+            throw HttpReturnException
+                (400, "tsne.embedRow requires a fully numeric embedding "
+                 "with no null or infinite values");
+    }
 
-    Date ts = Date::negativeInfinity();
-    auto embedding = itl->reembed(input);
+    // Place the new point against the frozen embedding: its neighbours
+    // come from the vantage point tree over the training inputs, and
+    // the repulsive force from the quadtree over the training outputs.
+    ML::distribution<float> embedding = itl->reembed(coords);
 
-    result.set("tsne", ExpressionValue(embedding, ts));
+    TsneOutput result;
+    result.tsne = ExpressionValue(std::move((vector<float> &)embedding), ts);
 
     return result;
-#endif
 }
 
 namespace {
@@ -444,10 +464,8 @@ regTsne(builtinPackage(),
 RegisterFunctionType<TsneEmbed, TsneEmbedConfig>
 regTsneEmbed(builtinPackage(),
              "tsne.embedRow",
-             "Embed a pre-trained t-SNE algorithm to new data points",
-             "functions/TsneEmbed.md.html",
-             nullptr,
-             {MldbEntity::INTERNAL_ENTITY});
+             "Apply a pre-trained t-SNE model to embed new data points",
+             "functions/TsneEmbed.md.html");
 
 } // file scope
 
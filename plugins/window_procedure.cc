@@ -0,0 +1,368 @@
+/**
+ * window_procedure.cc
+ * This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+ *
+ * Windowed aggregates (row number, lag, lead, cumulative sums) over
+ * partitioned, ordered rows, computed in a single pass: the input is
+ * scanned in parallel, sorted by (partition, order) with
+ * parallelMergeSort, and the partitions are then processed in parallel
+ * with running state, instead of the self-join a plain query needs.
+ **/
+
+#include "window_procedure.h"
+#include "mldb/server/mldb_server.h"
+#include "mldb/sql/sql_expression.h"
+#include "mldb/server/dataset_context.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/base/parallel.h"
+#include "mldb/server/bound_queries.h"
+#include "mldb/server/parallel_merge_sort.h"
+#include "mldb/types/any_impl.h"
+#include "mldb/server/per_thread_accumulator.h"
+#include "mldb/types/date.h"
+#include "mldb/plugins/sql_config_validator.h"
+#include <memory>
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+DEFINE_ENUM_DESCRIPTION(WindowFunctionType);
+
+WindowFunctionTypeDescription::
+WindowFunctionTypeDescription()
+{
+    addValue("rowNumber", WF_ROW_NUMBER,
+             "1-based position of the row within its partition, in the "
+             "order given by the orderBy clause of inputData.");
+    addValue("lag", WF_LAG,
+             "Value of the value expression offset rows earlier in the "
+             "partition.  Rows near the start of the partition, for which "
+             "there is no such row, get no value.");
+    addValue("lead", WF_LEAD,
+             "Value of the value expression offset rows later in the "
+             "partition.  Rows near the end of the partition, for which "
+             "there is no such row, get no value.");
+    addValue("cumulativeSum", WF_CUMULATIVE_SUM,
+             "Running sum of the value expression from the start of the "
+             "partition up to and including the row.  Null values don't "
+             "contribute to the sum.");
+}
+
+DEFINE_STRUCTURE_DESCRIPTION(WindowFunctionConfig);
+
+WindowFunctionConfigDescription::
+WindowFunctionConfigDescription()
+{
+    addField("outputColumn", &WindowFunctionConfig::outputColumn,
+             "Name of the column written to the output dataset.");
+    addField("function", &WindowFunctionConfig::function,
+             "Which windowed aggregate to compute.", WF_ROW_NUMBER);
+    addField("value", &WindowFunctionConfig::value,
+             "Input value, evaluated for each row of the input.  Required "
+             "for everything except rowNumber.");
+    addField("offset", &WindowFunctionConfig::offset,
+             "How many rows back (lag) or forward (lead) to look.  "
+             "Ignored for other functions.", (int64_t)1);
+}
+
+WindowProcedureConfig::
+WindowProcedureConfig()
+{
+    outputDataset.withType("sparse.mutable");
+}
+
+DEFINE_STRUCTURE_DESCRIPTION(WindowProcedureConfig);
+
+WindowProcedureConfigDescription::
+WindowProcedureConfigDescription()
+{
+    addField("inputData", &WindowProcedureConfig::inputData,
+             "An SQL statement to select the input data.  The select "
+             "expression is required but has no effect; the order by "
+             "expression gives the order of the rows within each "
+             "partition.");
+    addField("outputDataset", &WindowProcedureConfig::outputDataset,
+             "Output dataset configuration.  Each input row is written to "
+             "it under the same row name, with one column per configured "
+             "function.",
+             PolyConfigT<Dataset>().withType("sparse.mutable"));
+    addField("partitionBy", &WindowProcedureConfig::partitionBy,
+             "Rows with equal values of this expression form a partition, "
+             "and every function restarts at each partition.  When not "
+             "given, all rows form a single partition.");
+    addField("functions", &WindowProcedureConfig::functions,
+             "The windowed aggregates to compute for each row.");
+    addParent<ProcedureConfig>();
+
+    onPostValidate = [&] (WindowProcedureConfig * cfg,
+                          JsonParsingContext & context)
+    {
+        if (cfg->functions.empty()) {
+            throw ML::Exception("The window procedure needs at least one "
+                                "function to compute");
+        }
+        for (const auto & fn: cfg->functions) {
+            if (fn.outputColumn.empty()) {
+                throw ML::Exception("A window function needs a non-empty "
+                                    "outputColumn");
+            }
+            if (fn.function != WF_ROW_NUMBER && !fn.value) {
+                throw ML::Exception("Window function for column '"
+                                    + fn.outputColumn.rawString()
+                                    + "' needs a value expression");
+            }
+            if ((fn.function == WF_LAG || fn.function == WF_LEAD)
+                && fn.offset < 1) {
+                throw ML::Exception("Window function for column '"
+                                    + fn.outputColumn.rawString()
+                                    + "' needs an offset of at least 1");
+            }
+        }
+        MustContainFrom()(cfg->inputData, WindowProcedureConfig::name);
+    };
+}
+
+namespace {
+
+/** One input row, with everything the windowed pass needs: where it
+    sorts, and the evaluated value expressions.
+*/
+struct WindowRow {
+    RowName rowName;
+    CellValue partition;
+    vector<CellValue> orderKeys;
+    vector<CellValue> values;
+    vector<Date> valueTs;
+    Date ts;
+};
+
+} // file scope
+
+WindowProcedure::
+WindowProcedure(MldbServer * owner,
+                PolyConfig config,
+                const std::function<bool (const Json::Value &)> & onProgress)
+    : Procedure(owner)
+{
+    procedureConfig = config.params.convert<WindowProcedureConfig>();
+}
+
+RunOutput
+WindowProcedure::
+run(const ProcedureRunConfig & run,
+    const std::function<bool (const Json::Value &)> & onProgress) const
+{
+    auto runProcConf = applyRunConfOverProcConf(procedureConfig, run);
+
+    SqlExpressionMldbScope context(server);
+
+    auto boundDataset = runProcConf.inputData.stm->from->bind(context);
+
+    const OrderByExpression & orderBy = runProcConf.inputData.stm->orderBy;
+
+    // Everything the pass needs is evaluated as calculated expressions
+    // during one parallel scan: the partition key, the order by keys
+    // (the sort happens below, not in the query), and the value of each
+    // function that has one.
+    SelectExpression select(SelectExpression::parse("1"));
+    vector<shared_ptr<SqlExpression> > calc;
+
+    if (runProcConf.partitionBy)
+        calc.emplace_back(runProcConf.partitionBy);
+
+    for (auto & c: orderBy.clauses)
+        calc.emplace_back(c.first);
+
+    vector<int> valueIndex(runProcConf.functions.size(), -1);
+    for (unsigned i = 0;  i < runProcConf.functions.size();  ++i) {
+        if (runProcConf.functions[i].value) {
+            valueIndex[i] = calc.size() - (runProcConf.partitionBy ? 1 : 0)
+                - orderBy.clauses.size();
+            calc.emplace_back(runProcConf.functions[i].value);
+        }
+    }
+
+    size_t numOrderKeys = orderBy.clauses.size();
+    bool hasPartition = !!runProcConf.partitionBy;
+
+    PerThreadAccumulator<vector<WindowRow> > rowAccum;
+
+    auto onRow = [&] (NamedRowValue & row,
+                      const vector<ExpressionValue> & calcd)
+    {
+        WindowRow wr;
+        wr.rowName = std::move(row.rowName);
+        wr.ts = Date::negativeInfinity();
+
+        size_t n = 0;
+        if (hasPartition) {
+            wr.partition = calcd[n].getAtom();
+            wr.ts.setMax(calcd[n].getEffectiveTimestamp());
+            ++n;
+        }
+        for (size_t i = 0;  i < numOrderKeys;  ++i, ++n) {
+            wr.orderKeys.emplace_back(calcd[n].getAtom());
+            wr.ts.setMax(calcd[n].getEffectiveTimestamp());
+        }
+        for (;  n < calcd.size();  ++n) {
+            wr.values.emplace_back(calcd[n].getAtom());
+            wr.valueTs.emplace_back(calcd[n].getEffectiveTimestamp());
+            wr.ts.setMax(wr.valueTs.back());
+        }
+
+        rowAccum.get().emplace_back(std::move(wr));
+        return true;
+    };
+
+    // The order by clauses are evaluated above and sorted below, so the
+    // query itself runs unordered and in parallel
+    BoundSelectQuery(select,
+                     *boundDataset.dataset,
+                     boundDataset.asName,
+                     runProcConf.inputData.stm->when,
+                     *runProcConf.inputData.stm->where,
+                     OrderByExpression(),
+                     calc)
+        .execute({onRow, true /*processInParallel*/},
+                 runProcConf.inputData.stm->offset,
+                 runProcConf.inputData.stm->limit,
+                 onProgress);
+
+    // Sort by (partition, order keys), merging the per-thread chunks in
+    // parallel; row name breaks ties so the pass is deterministic
+    auto compareRows = [&] (const WindowRow & r1, const WindowRow & r2)
+    {
+        if (r1.partition != r2.partition)
+            return r1.partition < r2.partition;
+        for (size_t i = 0;  i < numOrderKeys;  ++i) {
+            if (r1.orderKeys[i] == r2.orderKeys[i])
+                continue;
+            bool less = r1.orderKeys[i] < r2.orderKeys[i];
+            return orderBy.clauses[i].second == ASC ? less : !less;
+        }
+        return r1.rowName < r2.rowName;
+    };
+
+    vector<shared_ptr<vector<WindowRow> > > chunks;
+    rowAccum.forEach([&] (vector<WindowRow> * rows)
+    {
+        chunks.emplace_back(make_shared<vector<WindowRow> >(std::move(*rows)));
+    });
+
+    vector<WindowRow> rows = parallelMergeSort(chunks, compareRows);
+
+    // Find the partition boundaries
+    vector<pair<size_t, size_t> > partitions;
+    for (size_t i = 0;  i < rows.size();  ) {
+        size_t j = i + 1;
+        while (j < rows.size() && rows[j].partition == rows[i].partition)
+            ++j;
+        partitions.emplace_back(i, j);
+        i = j;
+    }
+
+    auto output = createDataset(server, runProcConf.outputDataset,
+                                nullptr, true /*overwrite*/);
+
+    typedef tuple<ColumnName, CellValue, Date> Cell;
+    PerThreadAccumulator<vector<pair<RowName, vector<Cell> > > > outAccum;
+
+    vector<ColumnName> outputColumns;
+    for (auto & fn: runProcConf.functions)
+        outputColumns.emplace_back(ColumnName(fn.outputColumn));
+
+    auto doPartition = [&] (size_t p)
+    {
+        size_t begin = partitions[p].first;
+        size_t end = partitions[p].second;
+
+        auto & outRows = outAccum.get();
+        outRows.reserve(1024);
+
+        // Running state per function
+        vector<double> sums(runProcConf.functions.size(), 0.0);
+        vector<bool> sumSeen(runProcConf.functions.size(), false);
+
+        for (size_t i = begin;  i < end;  ++i) {
+            const WindowRow & row = rows[i];
+            vector<Cell> cells;
+
+            for (unsigned f = 0;  f < runProcConf.functions.size();  ++f) {
+                const WindowFunctionConfig & fn = runProcConf.functions[f];
+
+                switch (fn.function) {
+                case WF_ROW_NUMBER:
+                    cells.emplace_back(outputColumns[f],
+                                       (int64_t)(i - begin + 1),
+                                       row.ts);
+                    break;
+                case WF_LAG:
+                case WF_LEAD: {
+                    size_t j = fn.function == WF_LAG
+                        ? i - fn.offset
+                        : i + fn.offset;
+                    // Unsigned wraparound on lag past the start lands
+                    // far outside the partition, which the range check
+                    // catches
+                    if (j < begin || j >= end)
+                        break;
+                    const CellValue & v = rows[j].values[valueIndex[f]];
+                    if (!v.empty())
+                        cells.emplace_back(outputColumns[f], v,
+                                           rows[j].valueTs[valueIndex[f]]);
+                    break;
+                }
+                case WF_CUMULATIVE_SUM: {
+                    const CellValue & v = row.values[valueIndex[f]];
+                    if (v.isNumber()) {
+                        sums[f] += v.toDouble();
+                        sumSeen[f] = true;
+                    }
+                    if (sumSeen[f])
+                        cells.emplace_back(outputColumns[f], sums[f],
+                                           row.ts);
+                    break;
+                }
+                }
+            }
+
+            outRows.emplace_back(row.rowName, std::move(cells));
+
+            if (outRows.size() >= 1024) {
+                output->recordRows(outRows);
+                outRows.clear();
+            }
+        }
+    };
+
+    parallelMap(0, partitions.size(), doPartition);
+
+    // record remainder
+    outAccum.forEach([&] (vector<pair<RowName, vector<Cell> > > * rows)
+    {
+        output->recordRows(*rows);
+    });
+
+    output->commit();
+    return output->getStatus();
+}
+
+Any
+WindowProcedure::
+getStatus() const
+{
+    return Any();
+}
+
+static RegisterProcedureType<WindowProcedure, WindowProcedureConfig>
+regWindowProcedure(
+    builtinPackage(),
+    "Compute windowed aggregates over partitioned, ordered rows",
+    "procedures/WindowProcedure.md.html");
+
+
+} // namespace MLDB
+} // namespace Datacratic
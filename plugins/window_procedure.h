@@ -0,0 +1,83 @@
+/** window_procedure.h                                             -*- C++ -*-
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Procedure that computes windowed aggregates (row number, lag, lead,
+    cumulative sums) over partitioned, ordered rows in a single pass.
+*/
+
+#pragma once
+#include "mldb/core/procedure.h"
+#include "mldb/core/function.h"
+#include "mldb/core/dataset.h"
+#include "mldb/sql/sql_expression.h"
+
+namespace Datacratic {
+namespace MLDB {
+
+enum WindowFunctionType {
+    WF_ROW_NUMBER,      ///< 1-based position of the row in its partition
+    WF_LAG,             ///< Value of an earlier row in the partition
+    WF_LEAD,            ///< Value of a later row in the partition
+    WF_CUMULATIVE_SUM   ///< Running sum of the values up to the row
+};
+
+DECLARE_ENUM_DESCRIPTION(WindowFunctionType);
+
+struct WindowFunctionConfig {
+    WindowFunctionConfig()
+        : function(WF_ROW_NUMBER), offset(1)
+    {
+    }
+
+    /// Name of the column written to the output dataset
+    Utf8String outputColumn;
+
+    /// Which windowed aggregate to compute
+    WindowFunctionType function;
+
+    /// Input value, evaluated per row; required for everything except
+    /// rowNumber
+    std::shared_ptr<SqlExpression> value;
+
+    /// How many rows back (lag) or forward (lead) to look
+    int64_t offset;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(WindowFunctionConfig);
+
+struct WindowProcedureConfig : ProcedureConfig {
+    static constexpr const char * name = "window";
+
+    WindowProcedureConfig();
+
+    InputQuery inputData;
+    PolyConfigT<Dataset> outputDataset;
+
+    /// Rows with equal values of this expression form a partition; when
+    /// null, all rows are in one partition
+    std::shared_ptr<SqlExpression> partitionBy;
+
+    /// The windowed aggregates to compute for each row
+    std::vector<WindowFunctionConfig> functions;
+};
+
+DECLARE_STRUCTURE_DESCRIPTION(WindowProcedureConfig);
+
+struct WindowProcedure: public Procedure {
+
+    WindowProcedure(
+        MldbServer * owner,
+        PolyConfig config,
+        const std::function<bool (const Json::Value &)> & onProgress);
+
+    virtual RunOutput run(
+        const ProcedureRunConfig & run,
+        const std::function<bool (const Json::Value &)> & onProgress) const;
+
+    virtual Any getStatus() const;
+
+    WindowProcedureConfig procedureConfig;
+};
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -13,11 +13,42 @@
 #include "mldb/vfs/fs_utils.h"
 #include "mldb/vfs/filter_streams.h"
 #include "mldb/jml/stats/distribution.h"
+#include "mldb/jml/utils/file_functions.h"
+#include "mldb/http/http_exception.h"
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <cstring>
 
 using namespace std;
 
 
+namespace {
+
+/* Return the local path for a URL whose contents can be memory
+   mapped, or an empty string for remote schemes and compressed
+   payloads.  Mapping the embedding file keeps the float matrix in the
+   page cache, shared with any other process importing the same
+   file. */
+std::string mappableFilename(const std::string & url)
+{
+    std::string filename = url;
+    if (filename.rfind("file://", 0) == 0)
+        filename = filename.substr(7);
+    if (filename.find("://") != std::string::npos)
+        return std::string();
+
+    for (const char * ext: { ".gz", ".bz2", ".xz", ".lz4", ".zst" }) {
+        size_t len = strlen(ext);
+        if (filename.size() > len
+            && filename.compare(filename.size() - len, len, ext) == 0)
+            return std::string();
+    }
+
+    return filename;
+}
+
+} // file scope
+
 namespace Datacratic {
 namespace MLDB {
 
@@ -78,10 +109,29 @@ struct Word2VecImporter: public Procedure {
         auto runProcConf = applyRunConfOverProcConf(config, run);
         auto info = getUriObjectInfo(runProcConf.dataFileUrl.toString());
 
-        filter_istream stream(runProcConf.dataFileUrl.toString());
+        /* Local uncompressed files are memory mapped and parsed in
+           place; one mapped copy of the float matrix is then shared
+           through the page cache between co-located importers.
+           Remote or compressed files keep the streaming path. */
+        std::string mappable
+            = mappableFilename(runProcConf.dataFileUrl.toString());
+
+        ML::File_Read_Buffer buf;
+        std::unique_ptr<filter_istream> stream;
 
         std::string header;
-        getline(stream, header);
+        if (!mappable.empty()) {
+            buf.open(mappable);
+            const char * nl = std::find(buf.start(), buf.end(), '\n');
+            if (nl == buf.end())
+                throw HttpReturnException(400, "word2vec file has no header");
+            header.assign(buf.start(), nl);
+        }
+        else {
+            stream.reset(new filter_istream
+                         (runProcConf.dataFileUrl.toString()));
+            getline(*stream, header);
+        }
 
         vector<string> fields;
         boost::split(fields, header, boost::is_any_of(" "));
@@ -101,37 +151,75 @@ struct Word2VecImporter: public Procedure {
             columnNames.emplace_back(ML::format("%06d", i));
         }
 
-        vector<tuple<RowName, vector<float>, Date> > rows;
+        vector<pair<RowName, Date> > rows;
+        vector<float> coords;
         int64_t numRecorded = 0;
 
-        for (unsigned i = 0;  i < numWords;  ++i) {
-            std::string word;
-            getline(stream, word, ' ');
-
-            std::vector<float> vec(numDims);
-            stream.read((char *)&vec[0], numDims * sizeof(float));
-
+        /* Record one word and its vector; returns false once the
+           limit is reached.  The vectors accumulate in one contiguous
+           matrix that the bulk embedding interface takes as is. */
+        auto recordWord = [&] (unsigned i, std::string word,
+                               const char * vecData) -> bool
+        {
             if (i < runProcConf.offset)
-                continue;
+                return true;
             if (runProcConf.limit != -1 && numRecorded >= runProcConf.limit)
-                break;
+                return false;
 
-            rows.emplace_back(RowName(word), std::move(vec), info.lastModified);
+            size_t pos = coords.size();
+            coords.resize(pos + numDims);
+            std::memcpy(&coords[pos], vecData, numDims * sizeof(float));
+
+            rows.emplace_back(RowName(std::move(word)), info.lastModified);
             ++numRecorded;
 
             if (rows.size() == 10000) {
                 if (output)
-                    output->recordEmbedding(columnNames, rows);
+                    output->recordEmbedding(columnNames, rows, coords.data());
                 rows.clear();
+                coords.clear();
                 cerr << "recorded " << (i+1) << " of " << numWords << " words"
                      << endl;
             }
 
-            //cerr << "got word " << word << endl;
+            return true;
+        };
+
+        if (!mappable.empty()) {
+            const char * p = buf.start() + header.size() + 1;
+            const char * end = buf.end();
+
+            for (unsigned i = 0;  i < numWords;  ++i) {
+                const char * space = std::find(p, end, ' ');
+                if (space == end
+                    || end - (space + 1) < numDims * sizeof(float))
+                    throw HttpReturnException
+                        (400, "word2vec file truncated at word "
+                         + std::to_string(i));
+
+                std::string word(p, space);
+                p = space + 1 + numDims * sizeof(float);
+
+                if (!recordWord(i, std::move(word), space + 1))
+                    break;
+            }
+        }
+        else {
+            std::vector<float> vecBuf(numDims);
+
+            for (unsigned i = 0;  i < numWords;  ++i) {
+                std::string word;
+                getline(*stream, word, ' ');
+
+                stream->read((char *)&vecBuf[0], numDims * sizeof(float));
+
+                if (!recordWord(i, std::move(word), (const char *)&vecBuf[0]))
+                    break;
+            }
         }
 
         if (output) {
-            output->recordEmbedding(columnNames, rows);
+            output->recordEmbedding(columnNames, rows, coords.data());
             output->commit();
         }
 
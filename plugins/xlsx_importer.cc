@@ -16,8 +16,12 @@
 #include "mldb/vfs/filter_streams.h"
 #include "mldb/types/any_impl.h"
 #include "mldb/http/http_exception.h"
+#include "mldb/base/parallel.h"
 #include "mldb/ext/tinyxml2/tinyxml2.h"
 
+#include <map>
+#include <sstream>
+
 
 using namespace std;
 
@@ -680,6 +684,14 @@ struct XlsxImporter: public Procedure {
         Styles styles;
         std::string savedRelationships;
         bool sheetsLoaded = false;
+
+        // Worksheet members extracted during the single pass through the
+        // archive, keyed by internal filename.  The archive stream only
+        // decompresses sequentially, so members are pulled out in one
+        // scan here and the expensive part (XML parse and cell
+        // conversion) runs in parallel afterwards.
+        std::map<std::string, std::string> sheetContents;
+
         auto runProcConf = applyRunConfOverProcConf(config, run);
 
         workbook.timestamp = Date::positiveInfinity();
@@ -733,6 +745,13 @@ struct XlsxImporter: public Procedure {
                 else if (internalFilename == "xl/styles.xml") {
                     styles.load(open({}).buf);
                 }
+                else if (internalFilename.find("xl/worksheets/") == 0) {
+                    // 3.  Save the worksheet bytes so each sheet doesn't
+                    //     need its own scan through the archive later.
+                    std::ostringstream stream;
+                    stream << open({}).buf;
+                    sheetContents[internalFilename] = std::move(stream.str());
+                }
 
                 return true;
             };
@@ -749,53 +768,84 @@ struct XlsxImporter: public Procedure {
             output = obtainDataset(server, runProcConf.output);
         }
 
-        // 4.  Load the worksheets, one by one
-        for (auto & sheetEntry: workbook.sheets) {
-            Utf8String filename = "archive+" + runProcConf.dataFileUrl.toString() + "#xl/" + sheetEntry.filename;
-            filter_istream sheetStream(filename.rawString());
+        // 4.  Load the worksheets.  The shared strings, styles and
+        //     workbook were parsed once above and are read only from
+        //     here on, so each sheet is an independent ThreadPool job.
+        auto doSheet = [&] (size_t sheetIndex)
+            {
+                auto & sheetEntry = workbook.sheets[sheetIndex];
 
-            Sheet sheet(sheetStream.rdbuf(), workbook, strings, styles);
+                std::istringstream sheetStream;
+                std::unique_ptr<filter_istream> fallbackStream;
+                std::streambuf * sheetBuf;
 
-            //cerr << "sheet had " << sheet.rows.size() << " rows" << endl;
+                auto it = sheetContents.find(("xl/" + sheetEntry.filename).rawString());
+                if (it != sheetContents.end()) {
+                    sheetStream.str(it->second);
+                    sheetBuf = sheetStream.rdbuf();
+                }
+                else {
+                    // Not seen during the archive scan (eg a
+                    // relationship pointing outside xl/worksheets/);
+                    // fall back to re-opening the archive.
+                    Utf8String filename = "archive+" + runProcConf.dataFileUrl.toString() + "#xl/" + sheetEntry.filename;
+                    fallbackStream.reset(new filter_istream(filename.rawString()));
+                    sheetBuf = fallbackStream->rdbuf();
+                }
 
-            auto getColName = [] (int64_t colIndex)
-                {
-                    string result;
+                Sheet sheet(sheetBuf, workbook, strings, styles);
 
-                    if (colIndex < 26) {
-                        result = char('A' + (colIndex));
-                    }
-                    else {
-                        result = char('A' + (colIndex % 26)) + result;
-                        colIndex /= 26;
-                        while (colIndex) {
-                            result = char('A' + (colIndex % 26) - 1) + result;
+                //cerr << "sheet had " << sheet.rows.size() << " rows" << endl;
+
+                auto getColName = [] (int64_t colIndex)
+                    {
+                        string result;
+
+                        if (colIndex < 26) {
+                            result = char('A' + (colIndex));
+                        }
+                        else {
+                            result = char('A' + (colIndex % 26)) + result;
                             colIndex /= 26;
+                            while (colIndex) {
+                                result = char('A' + (colIndex % 26) - 1) + result;
+                                colIndex /= 26;
+                            }
                         }
-                    }
 
-                    return ColumnName(result);
-                };
+                        return ColumnName(result);
+                    };
+
+                if (output && !sheet.rows.empty()) {
+                    int maxRowIndex = sheet.rows.back().index;
+                    int indexLength = ML::format("%d", maxRowIndex).length();
 
-            if (output && !sheet.rows.empty()) {
-                int maxRowIndex = sheet.rows.back().index;
-                int indexLength = ML::format("%d", maxRowIndex).length();
+                    std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > outputRows;
+                    outputRows.reserve(sheet.rows.size());
 
-                for (auto & row: sheet.rows) {
-                    MatrixNamedRow outputRow;
-                    outputRow.rowHash = outputRow.rowName
-                        = RowName(sheetEntry.name + ML::format(":%0*d", indexLength, row.index));
+                    for (auto & row: sheet.rows) {
+                        RowName rowName(sheetEntry.name + ML::format(":%0*d", indexLength, row.index));
 
-                    for (auto & col: row.columns) {
-                        outputRow.columns.emplace_back(getColName(std::get<0>(col)),
-                                                       std::get<1>(col),
-                                                       workbook.timestamp);
+                        std::vector<std::tuple<ColumnName, CellValue, Date> > columns;
+                        columns.reserve(row.columns.size());
+                        for (auto & col: row.columns) {
+                            columns.emplace_back(getColName(std::get<0>(col)),
+                                                 std::get<1>(col),
+                                                 workbook.timestamp);
+                        }
+
+                        outputRows.emplace_back(std::move(rowName),
+                                                std::move(columns));
                     }
 
-                    output->recordRow(outputRow.rowName, outputRow.columns);
+                    output->recordRows(outputRows);
                 }
-            }
-        }
+            };
+
+        if (workbook.sheets.size() == 1)
+            doSheet(0);
+        else parallelMap(0, workbook.sheets.size(), doSheet);
+
         output->commit();
         return RunOutput();
     }
@@ -14,6 +14,7 @@
 #include "http_rest_endpoint.h"
 #include "mldb/utils/log.h"
 #include <iomanip>
+#include <strings.h>
 
 using namespace std;
 
@@ -25,11 +26,21 @@ namespace Datacratic {
 
 HttpRestEndpoint::
 HttpRestEndpoint(EventLoop & eventLoop, bool enableLogging)
+    : HttpRestEndpoint(vector<EventLoop *>{ &eventLoop }, enableLogging)
 {
-    auto makeHandler = [&, enableLogging] (TcpSocket && socket) {
+}
+
+HttpRestEndpoint::
+HttpRestEndpoint(const std::vector<EventLoop *> & eventLoops,
+                 bool enableLogging)
+{
+    ExcAssert(!eventLoops.empty());
+    auto makeHandler = [this, enableLogging] (TcpSocket && socket) {
         return make_shared<RestConnectionHandler>(this, std::move(socket), enableLogging);
     };
-    acceptor_.reset(new TcpAcceptor(eventLoop, makeHandler));
+    for (auto & eventLoop: eventLoops) {
+        acceptors_.emplace_back(new TcpAcceptor(*eventLoop, makeHandler));
+    }
 }
 
 HttpRestEndpoint::
@@ -54,7 +65,9 @@ void
 HttpRestEndpoint::
 shutdown()
 {
-    acceptor_->shutdown();
+    for (auto & acceptor: acceptors_) {
+        acceptor->shutdown();
+    }
 }
 
 void
@@ -109,8 +122,16 @@ bindTcp(PortRange const & portRange, std::string host)
     if (host == "" || host == "*")
         host = "0.0.0.0";
 
-    acceptor_->listen(portRange, host);
-    int port = acceptor_->effectiveTCPv4Port();
+    bool reusePort = acceptors_.size() > 1;
+    acceptors_[0]->listen(portRange, host, 128 /* backlog */, reusePort);
+    int port = acceptors_[0]->effectiveTCPv4Port();
+
+    // The remaining shards bind the port the first one settled on;
+    // SO_REUSEPORT lets them all listen on it at once
+    for (size_t i = 1;  i < acceptors_.size();  ++i) {
+        acceptors_[i]->listen(PortRange(port), host, 128 /* backlog */,
+                              reusePort);
+    }
     const char * literate_doc_bind_file = getenv("LITERATE_DOC_BIND_FILENAME");
     if (literate_doc_bind_file) {
         Json::Value v;
@@ -143,7 +164,12 @@ handleHttpPayload(const HttpHeader & header, const std::string & payload)
     // We don't lock here, since sending the response will take the lock,
     // and whatever called us must know it's a valid connection
 
-    this->httpHeader = header;
+    if (logger) {
+        // Keep only what the access log needs; assign() reuses the
+        // strings' storage between keep-alive requests
+        requestVerb.assign(header.verb);
+        requestResource.assign(header.resource);
+    }
     clock_gettime(CLOCK_REALTIME, &timer);
 
     try {
@@ -228,10 +254,29 @@ sendResponseHeader(int code, std::string contentType, RestParams headers)
         // Do nothing once we've finished sending the response, so that
         // the connection isn't closed
     };
-    
+
     for (auto & h: endpoint->extraHeaders)
         headers.push_back(h);
 
+    /* Compress chunked responses when the client accepts it; responses
+       with a known Content-Length or their own Content-Encoding pass
+       through untouched. */
+    bool chunked = false, alreadyEncoded = false;
+    for (auto & h: headers) {
+        if (strcasecmp(h.first.rawString().c_str(), "transfer-encoding") == 0
+            && strcasecmp(h.second.rawString().c_str(), "chunked") == 0)
+            chunked = true;
+        else if (strcasecmp(h.first.rawString().c_str(),
+                            "content-encoding") == 0)
+            alreadyEncoded = true;
+    }
+
+    const std::string & encoding = negotiatedContentEncoding();
+    if (chunked && !alreadyEncoded && !encoding.empty()) {
+        headers.push_back({ "Content-Encoding", encoding });
+        headers.push_back({ "Vary", "Accept-Encoding" });
+        startChunkCompression(encoding);
+    }
 
     logRequest(code);
     putResponseOnWire(HttpResponse(code,
@@ -246,7 +291,10 @@ sendHttpChunk(std::string chunk,
               NextAction next,
               OnWriteFinished onWriteFinished)
 {
-    HttpLegacySocketHandler::send(std::move(chunk), next, onWriteFinished);
+    if (chunkCompressionActive())
+        sendCompressedChunk(std::move(chunk), next, onWriteFinished);
+    else HttpLegacySocketHandler::send(std::move(chunk), next,
+                                       onWriteFinished);
 }
 
 inline void
@@ -257,8 +305,8 @@ logRequest(int code) const
         timespec now;
         clock_gettime(CLOCK_REALTIME, &now);
         double elapsed = (now.tv_sec - timer.tv_sec) * 1000 + (now.tv_nsec - timer.tv_nsec) * 0.000001;
-        logger->info() << "\"" << httpHeader.verb << " " 
-                       << httpHeader.resource << "\" " << code
+        logger->info() << "\"" << requestVerb << " "
+                       << requestResource << "\" " << code
                        << " "  << std::setprecision(3)  << elapsed <<  "ms";
     }
 }
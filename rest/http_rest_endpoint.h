@@ -13,6 +13,7 @@
 #include <atomic>
 #include <memory>
 #include <string>
+#include <vector>
 #include <time.h>
 
 namespace Datacratic {
@@ -31,6 +32,17 @@ struct TcpAcceptor;
 
 struct HttpRestEndpoint {
     HttpRestEndpoint(EventLoop & ioService, bool enableLogging);
+
+    /** Sharded endpoint: one acceptor per event loop, all listening on
+        the same port with SO_REUSEPORT.  The kernel spreads incoming
+        connections between the acceptors, and each connection is then
+        serviced on the loop that accepted it, so there is no shared
+        accept path and no cross-loop migration of established
+        connections.
+    */
+    HttpRestEndpoint(const std::vector<EventLoop *> & eventLoops,
+                     bool enableLogging);
+
     virtual ~HttpRestEndpoint();
 
     /** Set the Access-Control-Allow-Origin: * HTTP header */
@@ -104,7 +116,10 @@ struct HttpRestEndpoint {
 
     private:
         void logRequest(int code) const;
-        HttpHeader httpHeader;
+        /// Request line kept for the access log; copying the whole
+        /// header (including its body data) per request is wasteful
+        std::string requestVerb;
+        std::string requestResource;
         std::shared_ptr<spdlog::logger> logger;
         timespec timer;
     };
@@ -117,7 +132,8 @@ struct HttpRestEndpoint {
 
     std::vector<std::pair<std::string, std::string> > extraHeaders;
 
-    std::unique_ptr<TcpAcceptor> acceptor_;
+    /// One acceptor per event loop; a single entry unless sharded
+    std::vector<std::unique_ptr<TcpAcceptor> > acceptors_;
 };
 
 } // namespace Datacratic
@@ -7,8 +7,11 @@
    Endpoint to talk with a REST service.
 */
 
+#include <thread>
+
 #include "mldb/jml/utils/vector_utils.h"
 #include "mldb/jml/utils/pair_utils.h"
+#include "mldb/jml/utils/environment.h"
 #include "mldb/ext/cityhash/src/city.h"
 #include "mldb/base/exc_assert.h"
 #include "mldb/http/event_loop.h"
@@ -234,13 +237,33 @@ captureInConnection(std::shared_ptr<void> toCapture)
 /* HTTP REST SERVICE                                                         */
 /*****************************************************************************/
 
+/* Number of SO_REUSEPORT acceptor shards for the HTTP endpoint.  With N
+   shards (N > 1), each shard has its own event loop, worker pool and
+   accepting socket; the kernel spreads incoming connections between the
+   shards and each connection stays on the loop that accepted it, so
+   accept throughput scales with the number of shards instead of
+   funnelling through a single shared acceptor.  -1 means one shard per
+   core; 0 or 1 keeps the single shared acceptor. */
+static ML::Env_Option<int> HTTP_SHARDS("MLDB_HTTP_SHARDS", 0);
+
 HttpRestService::
 HttpRestService(bool enableLogging)
     : eventLoop(new EventLoop()),
       threadPool(new AsioThreadPool(*eventLoop)),
-      httpEndpoint(new HttpRestEndpoint(*eventLoop, enableLogging)),
       logger(MLDB::getMldbLog<HttpRestService>())
 {
+    int numShards = HTTP_SHARDS;
+    if (numShards == -1)
+        numShards = std::thread::hardware_concurrency();
+
+    std::vector<EventLoop *> loops = { eventLoop.get() };
+    for (int i = 1;  i < numShards;  ++i) {
+        shardEventLoops.emplace_back(new EventLoop());
+        shardThreadPools.emplace_back(new AsioThreadPool(*shardEventLoops.back()));
+        loops.push_back(shardEventLoops.back().get());
+    }
+
+    httpEndpoint.reset(new HttpRestEndpoint(loops, enableLogging));
 }
 
 HttpRestService::
@@ -258,6 +281,8 @@ shutdown()
     httpEndpoint->shutdown();
 
     threadPool->shutdown();
+    for (auto & pool: shardThreadPools)
+        pool->shutdown();
 }
 
 void
@@ -11,6 +11,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "mldb/http/asio_thread_pool.h"
 #include "mldb/rest/http_rest_endpoint.h"
@@ -203,6 +204,13 @@ struct HttpRestService {
 
     std::unique_ptr<EventLoop> eventLoop;
     std::unique_ptr<AsioThreadPool> threadPool;
+
+    /// Extra event loops and worker pools when the endpoint is sharded
+    /// (MLDB_HTTP_SHARDS); each one services the connections accepted
+    /// by its own SO_REUSEPORT acceptor
+    std::vector<std::unique_ptr<EventLoop> > shardEventLoops;
+    std::vector<std::unique_ptr<AsioThreadPool> > shardThreadPools;
+
     std::unique_ptr<HttpRestEndpoint> httpEndpoint;
     std::shared_ptr<spdlog::logger> logger;
 };
@@ -7,6 +7,7 @@
 LIBREST_SOURCES := \
 	rest_request.cc \
 	rest_request_router.cc \
+	rest_request_stats.cc \
 	rest_request_binding.cc \
 	rest_request_params.cc \
 	in_process_rest_connection.cc \
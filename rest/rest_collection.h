@@ -323,6 +323,15 @@ struct RestCollection : public RestCollectionBase {
                                std::shared_ptr<BackgroundTask> task,
                                bool mustBeNewEntry = false);
 
+    /** Called (with no locks held) each time a background job under
+        construction reports progress.  Default does nothing; collections
+        that publish status watches use it to stream progress events.
+    */
+    virtual void onBackgroundTaskProgress(const Key & key,
+                                          const BackgroundTaskBase & task)
+    {
+    }
+
     bool addEntry(Key key,
                   std::shared_ptr<Value> value,
                   bool mustBeNewEntry = true)
@@ -607,7 +616,15 @@ struct RestConfigurableCollection: public RestCollection<Key, Value> {
     
     virtual WatchT<Key, std::shared_ptr<Status> >
     watchStatus(const Utf8String & spec, bool catchUp, Any info);
-    
+
+    /** Stream a status update through the status watches each time a
+        background job reports progress, so that watchers follow the
+        progress of an asynchronous creation instead of only seeing its
+        final state.
+    */
+    virtual void onBackgroundTaskProgress(const Key & key,
+                                          const BackgroundTaskBase & task);
+
     virtual Watch
     watchChannel(const Utf8String & chanel, const Utf8String & filter,
                  bool catchUp, Any info);
@@ -409,9 +409,6 @@ getKeys() const
 {
     std::vector<Key> result;
 
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
     for (auto & e: *es) {
         result.push_back(e.first);
@@ -424,9 +421,6 @@ size_t
 RestCollection<Key, Value>::
 size() const
 {
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
     return es->size();
 }
@@ -436,9 +430,6 @@ bool
 RestCollection<Key, Value>::
 empty() const
 {
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
     return es->empty();
 }
@@ -516,9 +507,6 @@ addBackgroundJobInThread(Key key,
 {
     using namespace std;
 
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     for (;;) {
         auto oldEntries = impl->entries();
         std::unique_ptr<Entries> newEntries(new Entries(*oldEntries));
@@ -558,9 +546,14 @@ addBackgroundJobInThread(Key key,
 
         auto onProgressFn = [=] (const Json::Value & progress)
             {
-                std::unique_lock<std::mutex> guard(task->mutex);
-                task->setProgress(progress);
-                return !task->cancelled;
+                {
+                    std::unique_lock<std::mutex> guard(task->mutex);
+                    task->setProgress(progress);
+                    if (task->cancelled)
+                        return false;
+                }
+                this->onBackgroundTaskProgress(key, *task);
+                return true;
             };
 
 
@@ -666,9 +659,6 @@ addEntryItl(Key key,
     if (wasCancelled)
         return false;
 
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     for (;;) {
         auto oldEntries = impl->entries();
 
@@ -732,9 +722,6 @@ replaceEntryItl(Key key,
     if (wasCancelled)
         return false;
 
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     for (;;) {
         auto oldEntries = impl->entries();
 
@@ -786,9 +773,6 @@ deleteEntry(Key key)
 {
     std::unique_lock<typename Impl::MutateMutex> mutateGuard(impl->mutateMutex);
 
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     for (;;) {
         auto oldEntries = impl->entries();
 
@@ -871,9 +855,6 @@ std::pair<std::shared_ptr<Value>,
 RestCollection<Key, Value>::
 tryGetEntry(Key key) const
 {
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
 
     auto it = es->find(key);
@@ -888,9 +869,6 @@ std::shared_ptr<Value>
 RestCollection<Key, Value>::
 getExistingEntry(Key key) const
 {
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
 
     auto it = es->find(key);
@@ -908,9 +886,6 @@ std::shared_ptr<Value>
 RestCollection<Key, Value>::
 tryGetExistingEntry(Key key) const
 {
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
 
     auto it = es->find(key);
@@ -950,9 +925,6 @@ bool
 RestCollection<Key, Value>::
 forEachEntry(const std::function<bool (Key key, Value & value)> & fn)
 {
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
 
     size_t sz = es->size();
@@ -973,9 +945,6 @@ bool
 RestCollection<Key, Value>::
 forEachEntry(const std::function<bool (Key key, const Value & value)> & fn) const
 {
-    // NOTE: Should not be necessary... investigation needed
-    GcLock::SharedGuard guard(impl->entriesLock);
-
     auto es = impl->entries.getImmutable();
     for (auto & e: *es) {
         if (e.second.value && !fn(e.first, *e.second.value))
@@ -1357,10 +1326,6 @@ mustCreateSync(Config config,
     //    mutateGuard(this->impl->mutateMutex);
 
     {
-        // NOTE: Should not be necessary... investigation needed.  See
-        // the comment above.
-        GcLock::SharedGuard guard(this->impl->entriesLock);
-
         auto es = this->impl->entries.getImmutable();
 
         if (es->count(key)) {
@@ -1977,6 +1942,20 @@ watchStatus(const Utf8String & spec, bool catchUp, Any info)
     return res;
 }
 
+template<typename Key, typename Value,
+         typename Config, typename Status>
+void
+RestConfigurableCollection<Key, Value, Config, Status>::
+onBackgroundTaskProgress(const Key & key, const BackgroundTaskBase & task)
+{
+    if (statusWatches.empty())
+        return;
+
+    // getStatus() routes through getStatusLoading() while the entry is
+    // under construction, which carries the task's progress
+    statusWatches.trigger(key, std::make_shared<Status>(this->getStatus(key)));
+}
+
 template<typename Key, typename Value,
          typename Config, typename Status>
 Watch
@@ -8,6 +8,8 @@
 
 #include "mldb/types/url.h"
 #include "mldb/rest/rest_request_router.h"
+#include "mldb/rest/rest_request_stats.h"
+#include "mldb/types/date.h"
 #include "mldb/jml/utils/vector_utils.h"
 #include "mldb/arch/exception_handler.h"
 #include "mldb/jml/utils/set_utils.h"
@@ -27,27 +29,56 @@ namespace Datacratic {
 /* PATH SPEC                                                                 */
 /*****************************************************************************/
 
+/* Longest prefix of the regex surface that any match must start with.
+   The scan is conservative: it stops at the first metacharacter, drops
+   the last character when a quantifier follows it, and gives up
+   entirely on a top-level alternation. */
+static std::string regexLiteralPrefix(const std::string & surface)
+{
+    std::string result;
+    for (char c: surface) {
+        switch (c) {
+        case '|':
+            // Alternation: there is no fixed prefix
+            return std::string();
+        case '*': case '+': case '?': case '{':
+            // The quantifier applies to the last character scanned
+            if (!result.empty())
+                result.pop_back();
+            return result;
+        case '.': case '[': case ']': case '(': case ')': case '}':
+        case '^': case '$': case '\\':
+            return result;
+        default:
+            if ((unsigned char)c >= 0x80)
+                return result;  // stay within ASCII
+            result.push_back(c);
+        }
+    }
+    return result;
+}
+
 PathSpec::
 PathSpec()
     : type(NONE)
 {
 }
-        
+
 PathSpec::
 PathSpec(const std::string & fullPath)
-    : type(STRING), path(fullPath)
+    : type(STRING), path(fullPath), literalPrefix(fullPath)
 {
 }
 
 PathSpec::
 PathSpec(const Utf8String & fullPath)
-    : type(STRING), path(fullPath)
+    : type(STRING), path(fullPath), literalPrefix(fullPath.rawString())
 {
 }
 
 PathSpec::
 PathSpec(const char * fullPath)
-    : type(STRING), path(fullPath)
+    : type(STRING), path(fullPath), literalPrefix(fullPath)
 {
 }
 
@@ -55,7 +86,8 @@ PathSpec::
 PathSpec(Regex rex)
     : type(REGEX),
       path(rex.surface()),
-      rex(std::move(rex))
+      rex(std::move(rex)),
+      literalPrefix(regexLiteralPrefix(path.rawString()))
 {
 }
 
@@ -321,11 +353,21 @@ handleRequest(RestConnection & connection,
 {
     //JML_TRACE_EXCEPTIONS(false);
 
+    Date start = Date::now();
+
     RestRequestParsingContext context(request);
     RestRequestMatchResult res = processRequest(connection, request, context);
     if (res == MR_NO) {
         notFoundHandler(connection, request);
     }
+
+    // Record the latency against the pattern of the route that handled
+    // the request.  Async responses are recorded when dispatch returns,
+    // so any work a handler defers past that isn't counted.
+    restRequestStats().record(request.verb,
+                              res == MR_NO || context.matchedRoute.empty()
+                                  ? "(unmatched)" : context.matchedRoute,
+                              Date::now().secondsSince(start));
 }
 
 static std::string getVerbsStr(const std::set<std::string> & verbs)
@@ -382,6 +424,10 @@ processRequest(RestConnection & connection,
         if (debug) {
             cerr << "invoked root handler for request " << request << endl;
         }
+        // Capture the route pattern before the state restores on the
+        // way out wind it back, so the entry point can record latency
+        // against it
+        context.matchedRoute = context.routePattern;
         return rootHandler(connection, request, context);
     }
 
@@ -431,6 +477,7 @@ matchPath(RestRequestParsingContext & context) const
     case PathSpec::STRING: {
         if (context.remaining.removePrefix(path.path)) {
             context.resources.push_back(path.path);
+            context.routePattern += path.path.rawString();
             break;
         }
         else return false;
@@ -450,6 +497,7 @@ matchPath(RestRequestParsingContext & context) const
             context.resources.push_back(Url::decodeUri(in));
         }
         context.remaining.replace(0, results[0].length(), "");
+        context.routePattern += path.getPathDesc().rawString();
         break;
     }
     case PathSpec::NONE:
@@ -470,6 +518,15 @@ process(const RestRequest & request,
 
     bool debug = TRACE_REST_REQUESTS;
 
+    // Reject on the pre-compiled literal prefix of the path before
+    // saving any state or touching the regex machinery; this is what
+    // keeps the scan over sibling routes cheap on deep route trees
+    const std::string & remaining = context.remaining.rawString();
+    if (!path.literalPrefix.empty()
+        && remaining.compare(0, path.literalPrefix.size(),
+                             path.literalPrefix) != 0)
+        return MR_NO;
+
     if (debug) {
         cerr << "verb = " << request.verb << " filter.verbs = " << filter.verbs
              << endl;
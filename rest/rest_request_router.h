@@ -62,6 +62,13 @@ struct PathSpec {
     Regex rex;         ///< Parsed regex, if type == REGEX
     Utf8String desc;   ///< Description for help
 
+    /// Literal prefix that any matching path must start with, computed
+    /// once on construction.  For a string path it's the whole path; for
+    /// a regex it's the longest fixed prefix of its surface (possibly
+    /// empty).  Routing uses it to reject candidate routes with a plain
+    /// byte comparison before touching the regex machinery.
+    std::string literalPrefix;
+
     /// Return the number of captured elements for this specification.  This is the
     /// number of strings that will be appended to the resources field of the context
     /// object.
@@ -308,6 +315,19 @@ struct RestRequestParsingContext {
     /// Part of the resource that has not yet been consumed
     Utf8String remaining;
 
+    /// Pattern of the route matched so far, accumulated from the path
+    /// descriptions of each segment (eg "/v1/datasets/<dataset>").
+    /// Saved and restored with the rest of the state as routes are
+    /// tried.
+    std::string routePattern;
+
+    /// Pattern of the route whose handler was invoked, captured from
+    /// routePattern at that point.  Unlike routePattern it survives
+    /// the state restores done on the way back out, so the caller that
+    /// created the context can read it after dispatch; used to record
+    /// per-route latency.
+    std::string matchedRoute;
+
     /// Used to save the state so that whatever was pushed after can be
     /// removed and the object can get back to its old state (without making
     /// a copy).
@@ -315,6 +335,7 @@ struct RestRequestParsingContext {
         Utf8String remaining;
         int resourcesLength;
         int objectsLength;
+        int routePatternLength;
     };
 
     /// Save the current state, to be restored in restoreState
@@ -324,6 +345,7 @@ struct RestRequestParsingContext {
         result.remaining = remaining;
         result.resourcesLength = resources.size();
         result.objectsLength = objects.size();
+        result.routePatternLength = routePattern.size();
         return result;
     }
 
@@ -336,6 +358,8 @@ struct RestRequestParsingContext {
         ExcAssertGreaterEqual(objects.size(), state.objectsLength);
         while (objects.size() > state.objectsLength)
             objects.pop_back();
+        ExcAssertGreaterEqual(routePattern.size(), state.routePatternLength);
+        routePattern.resize(state.routePatternLength);
     }
 
     /// Guard object to save the state and restore it on scope exit
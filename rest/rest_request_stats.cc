@@ -0,0 +1,159 @@
+/** rest_request_stats.cc
+    Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Per-route latency histograms for REST requests.
+*/
+
+#include "rest_request_stats.h"
+#include "mldb/base/exc_assert.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* LATENCY HISTOGRAM                                                         */
+/*****************************************************************************/
+
+LatencyHistogram::
+LatencyHistogram()
+    : count(0), sumMicros(0), maxMicros(0)
+{
+    for (auto & b: buckets)
+        b.store(0, std::memory_order_relaxed);
+}
+
+int
+LatencyHistogram::
+bucketFor(uint64_t micros)
+{
+    // Values below SUB_BUCKETS are recorded exactly; above that, the
+    // top SUB_BUCKET_BITS + 1 significant bits select the bucket
+    if (micros < SUB_BUCKETS)
+        return micros;
+
+    int exponent = 63 - __builtin_clzll(micros);
+    if (exponent > MAX_EXPONENT) {
+        exponent = MAX_EXPONENT;
+        micros = ((uint64_t)1 << (MAX_EXPONENT + 1)) - 1;
+    }
+
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+        + ((micros >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t
+LatencyHistogram::
+bucketLowerMicros(int bucket)
+{
+    ExcAssertGreaterEqual(bucket, 0);
+    ExcAssertLess(bucket, NUM_BUCKETS);
+
+    int block = bucket / SUB_BUCKETS;
+    int sub = bucket % SUB_BUCKETS;
+    if (block == 0)
+        return bucket;
+    return (uint64_t)(SUB_BUCKETS + sub) << (block - 1);
+}
+
+void
+LatencyHistogram::
+record(uint64_t micros)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add(micros, std::memory_order_relaxed);
+    buckets[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t prev = maxMicros.load(std::memory_order_relaxed);
+    while (micros > prev
+           && !maxMicros.compare_exchange_weak(prev, micros,
+                                               std::memory_order_relaxed)) ;
+}
+
+LatencyHistogram::Snapshot
+LatencyHistogram::
+snapshot() const
+{
+    Snapshot result;
+    result.buckets.resize(NUM_BUCKETS);
+    for (int i = 0;  i < NUM_BUCKETS;  ++i)
+        result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    result.count = count.load(std::memory_order_relaxed);
+    result.sumMicros = sumMicros.load(std::memory_order_relaxed);
+    result.maxMicros = maxMicros.load(std::memory_order_relaxed);
+    return result;
+}
+
+uint64_t
+LatencyHistogram::Snapshot::
+quantileMicros(double q) const
+{
+    if (count == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)std::max(1.0, ceil(q * count));
+    uint64_t cumulative = 0;
+    for (int i = 0;  i < NUM_BUCKETS;  ++i) {
+        cumulative += buckets[i];
+        if (cumulative >= target)
+            return bucketLowerMicros(i);
+    }
+    return bucketLowerMicros(NUM_BUCKETS - 1);
+}
+
+
+/*****************************************************************************/
+/* REST REQUEST STATS                                                        */
+/*****************************************************************************/
+
+void
+RestRequestStats::
+record(const std::string & verb,
+       const std::string & routePattern,
+       double elapsedSeconds)
+{
+    uint64_t micros = elapsedSeconds > 0.0
+        ? (uint64_t)(elapsedSeconds * 1000000.0)
+        : 0;
+
+    LatencyHistogram * histogram;
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        auto & entry = routes[verb + " " + routePattern];
+        if (!entry)
+            entry.reset(new LatencyHistogram());
+        histogram = entry.get();
+    }
+
+    // Histograms are never removed, so recording doesn't need the lock
+    histogram->record(micros);
+}
+
+void
+RestRequestStats::
+forEach(const std::function<void (const std::string & verb,
+                                  const std::string & routePattern,
+                                  const LatencyHistogram & histogram)>
+            & fn) const
+{
+    std::unique_lock<std::mutex> guard(mutex);
+    for (auto & r: routes) {
+        size_t space = r.first.find(' ');
+        fn(r.first.substr(0, space), r.first.substr(space + 1),
+           *r.second);
+    }
+}
+
+RestRequestStats &
+restRequestStats()
+{
+    static RestRequestStats stats;
+    return stats;
+}
+
+} // namespace Datacratic
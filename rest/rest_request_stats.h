@@ -0,0 +1,123 @@
+/** rest_request_stats.h                                           -*- C++ -*-
+    Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Per-route latency histograms for REST requests.
+
+    Every request that goes through a RestRequestRouter is timed and
+    recorded against the pattern of the route that handled it (eg
+    "/v1/datasets/<dataset>/query"), so that request latency
+    percentiles can be read per route without an external proxy.
+
+    The histograms are log-linear (HDR style): sixteen linear
+    sub-buckets per power of two of microseconds, which bounds the
+    relative error of any reported quantile at 1/16th.  The buckets
+    are plain relaxed atomic counters, following engine_stats.h: a
+    request already costs orders of magnitude more than the handful
+    of relaxed adds recording it.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* LATENCY HISTOGRAM                                                         */
+/*****************************************************************************/
+
+struct LatencyHistogram {
+
+    LatencyHistogram();
+
+    /// Linear sub-buckets per power of two; bounds the relative
+    /// error of the reported quantiles at 1 / SUB_BUCKETS
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    /// Highest power of two of microseconds that gets its own
+    /// buckets; longer requests saturate into the last one
+    static constexpr int MAX_EXPONENT = 39;
+
+    static constexpr int NUM_BUCKETS
+        = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    /** Bucket index for a value in microseconds. */
+    static int bucketFor(uint64_t micros);
+
+    /** Lowest value in microseconds that the given bucket covers. */
+    static uint64_t bucketLowerMicros(int bucket);
+
+    /** Record one observation of the given number of microseconds. */
+    void record(uint64_t micros);
+
+    /** Consistent-enough copy of the counters for reporting.  The
+        buckets are read with relaxed loads while writers are still
+        recording, so totals may trail by the odd in-flight request.
+    */
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sumMicros = 0;
+        uint64_t maxMicros = 0;
+        std::vector<uint64_t> buckets;
+
+        /** Value in microseconds at or below which a fraction q of
+            the observations fall.  Zero when empty.
+        */
+        uint64_t quantileMicros(double q) const;
+    };
+
+    Snapshot snapshot() const;
+
+private:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sumMicros;
+    std::atomic<uint64_t> maxMicros;
+    std::atomic<uint64_t> buckets[NUM_BUCKETS];
+};
+
+
+/*****************************************************************************/
+/* REST REQUEST STATS                                                        */
+/*****************************************************************************/
+
+/** Registry of one latency histogram per (verb, route pattern) pair.
+    Routes only ever accumulate; the set of patterns is bounded by the
+    route tree, so entries are never dropped.
+*/
+
+struct RestRequestStats {
+
+    /** Record a request against its route pattern. */
+    void record(const std::string & verb,
+                const std::string & routePattern,
+                double elapsedSeconds);
+
+    /** Visit each (verb, route pattern, histogram), in key order. */
+    void forEach(const std::function<void (const std::string & verb,
+                                           const std::string & routePattern,
+                                           const LatencyHistogram & histogram)>
+                     & fn) const;
+
+private:
+    mutable std::mutex mutex;
+
+    /// Keyed on verb + " " + route pattern.  The histograms are held
+    /// by unique pointer so they stay put as the map grows.
+    std::map<std::string, std::unique_ptr<LatencyHistogram> > routes;
+};
+
+/** The single process-wide instance. */
+RestRequestStats & restRequestStats();
+
+} // namespace Datacratic
@@ -118,3 +118,51 @@ BOOST_AUTO_TEST_CASE( test_hidden_route )
                                        "Not matching regex", callback,
                     Json::Value());
 }
+
+BOOST_AUTO_TEST_CASE( test_literal_prefix_dispatch )
+{
+    // The pre-computed literal prefixes drive the fast rejection of
+    // sibling routes; check they come out right for the path shapes we
+    // register, including those with no fixed prefix at all
+    BOOST_CHECK_EQUAL(PathSpec("/datasets").literalPrefix, "/datasets");
+    BOOST_CHECK_EQUAL(Rx("/datasets/([^/]*)", "").literalPrefix,
+                      "/datasets/");
+    BOOST_CHECK_EQUAL(Rx("/f(oo|ar)", "").literalPrefix, "/f");
+    BOOST_CHECK_EQUAL(Rx("/ab?c", "").literalPrefix, "/a");
+    BOOST_CHECK_EQUAL(Rx("foo|bar", "").literalPrefix, "");
+
+    RestRequestRouter router;
+
+    auto makeCallback = [] (const string & result)
+        {
+            return [=] (RestConnection & connection,
+                        const RestRequest & request,
+                        RestRequestParsingContext & context)
+                {
+                    connection.sendResponse(200, result, "text/plain");
+                    return RestRequestRouter::MR_YES;
+                };
+        };
+
+    auto & datasets = router.addSubRouter("/datasets", "datasets");
+    auto & dataset
+        = datasets.addSubRouter(Rx("/([^/]*)", "/<dataset>"), "dataset");
+    dataset.addRoute("/status", { "GET" },
+                     "status", makeCallback("status"), Json::Value());
+    router.addRoute(Rx("/fo+", "/foo"), { "GET" },
+                    "foo", makeCallback("foo"), Json::Value());
+
+    RestRequest request;
+    request.verb = "GET";
+    request.resource = "/datasets/x/status";
+
+    InProcessRestConnection conn;
+    router.handleRequest(conn, request);
+    BOOST_CHECK_EQUAL(conn.response, "status");
+
+    // A quantified path still matches past its literal prefix
+    request.resource = "/foooo";
+    InProcessRestConnection conn2;
+    router.handleRequest(conn2, request);
+    BOOST_CHECK_EQUAL(conn2.response, "foo");
+}
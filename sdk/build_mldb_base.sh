@@ -2,7 +2,7 @@
 
 apt-get purge -y libcurl4-openssl-dev
 
-apt-get install g++ make libbz2-dev liblzma-dev libcrypto++-dev libpqxx3-dev libicu-dev \
+apt-get install g++ make libbz2-dev liblzma-dev libzstd-dev libcrypto++-dev libpqxx3-dev libicu-dev \
     libgoogle-perftools-dev liblapack-dev libblas-dev python-virtualenv \
 
 # Clean up APT when done
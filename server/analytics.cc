@@ -383,6 +383,118 @@ queryFromStatement(SelectStatement & stm,
     }
 }
 
+void
+queryFromStatementOnRow(std::function<bool (MatrixNamedRow & row)> onRow,
+                        SelectStatement & stm,
+                        SqlBindingScope & scope,
+                        BoundParameters params)
+{
+    BoundTableExpression table = stm.from->bind(scope);
+
+    if (table.dataset) {
+        const Dataset & dataset = *table.dataset;
+
+        if (!stm.having->isConstantTrue() && stm.groupBy.clauses.empty())
+            throw HttpReturnException(400, "HAVING expression requires a GROUP BY expression");
+
+        std::vector< std::shared_ptr<SqlExpression> > aggregators
+            = stm.select.findAggregators(!stm.groupBy.clauses.empty());
+        std::vector< std::shared_ptr<SqlExpression> > havingaggregators
+            = stm.having->findAggregators(!stm.groupBy.clauses.empty());
+        std::vector< std::shared_ptr<SqlExpression> > orderbyaggregators
+            = stm.orderBy.findAggregators(!stm.groupBy.clauses.empty());
+
+        // Do it ungrouped if possible
+        if (stm.groupBy.clauses.empty() && aggregators.empty()) {
+            auto processor = [&] (NamedRowValue & row_,
+                                  const std::vector<ExpressionValue> & calc)
+                {
+                    MatrixNamedRow row = row_.flattenDestructive();
+                    row.rowName = getValidatedRowName(calc.at(0));
+                    row.rowHash = row.rowName;
+                    return onRow(row);
+                };
+
+            iterateDataset(stm.select, dataset, table.asName,
+                           stm.when, *stm.where,
+                           { stm.rowName->shallowCopy() },
+                           { processor, false /*processInParallel*/ },
+                           stm.orderBy, stm.offset, stm.limit, nullptr);
+        }
+        else {
+            aggregators.insert(aggregators.end(), havingaggregators.begin(),
+                               havingaggregators.end());
+            aggregators.insert(aggregators.end(), orderbyaggregators.begin(),
+                               orderbyaggregators.end());
+
+            // Otherwise do it grouped...
+            auto processor = [&] (NamedRowValue & row_)
+                {
+                    MatrixNamedRow row = row_.flattenDestructive();
+                    return onRow(row);
+                };
+
+            iterateDatasetGrouped(stm.select, dataset, table.asName,
+                                  stm.when, *stm.where,
+                                  stm.groupBy, aggregators, *stm.having,
+                                  *stm.rowName,
+                                  { processor, false /*processInParallel*/ },
+                                  stm.orderBy, stm.offset, stm.limit, nullptr);
+        }
+    }
+    else if (table.table.runQuery && stm.from) {
+
+        auto getParamInfo = [&] (const Utf8String & paramName)
+            -> std::shared_ptr<ExpressionValueInfo>
+            {
+                throw HttpReturnException(500, "No query parameter " + paramName);
+            };
+
+        if (!params)
+            params = [] (const Utf8String & param) -> ExpressionValue { throw HttpReturnException(500, "No query parameter " + param); };
+
+        std::shared_ptr<PipelineElement> pipeline = PipelineElement::root(scope)->statement(stm, getParamInfo);
+
+        auto boundPipeline = pipeline->bind();
+
+        auto executor = boundPipeline->start(params);
+
+        ssize_t limit = stm.limit;
+        ssize_t offset = stm.offset;
+
+        auto output = executor->take();
+
+        for (size_t n = 0;
+             output && (limit == -1 || n < limit + offset);
+             output = executor->take(), ++n) {
+
+            // MLDB-1329 band-aid fix.  This appears to break a circlar
+            // reference chain that stops the elements from being
+            // released.
+            output->group.clear();
+
+            if (n < offset) {
+                continue;
+            }
+
+            MatrixNamedRow row;
+            // Second last element is the row name
+            row.rowName = RowName(output->values.at(output->values.size() - 2).toUtf8String());
+
+            output->values.back().mergeToRowDestructive(row.columns);
+            if (!onRow(row))
+                return;
+        }
+    }
+    else {
+        // No from at all
+        for (auto & row: queryWithoutDataset(stm, scope)) {
+            if (!onRow(row))
+                return;
+        }
+    }
+}
+
 RowName getValidatedRowName(const ExpressionValue& rowNameEV)
 {
     if (rowNameEV.empty()) {
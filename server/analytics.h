@@ -148,6 +148,20 @@ queryFromStatement(SelectStatement & stm,
                    SqlBindingScope & scope,
                    BoundParameters params = nullptr);
 
+/** Select from the given statement, passing each result row to the given
+    callback as it is produced instead of materializing the whole result
+    set.  Rows are produced serially, in their output order; returning
+    false from the callback stops the query early.
+
+    The scope should be a clean scope, not requiring any row scope.
+    See the comment above if you have errors inside this function.
+*/
+void
+queryFromStatementOnRow(std::function<bool (MatrixNamedRow & row)> onRow,
+                        SelectStatement & stm,
+                        SqlBindingScope & scope,
+                        BoundParameters params = nullptr);
+
 /** Build a RowName from an expression value and throw if
     it is not valid (row, empty, etc)
 */
@@ -0,0 +1,324 @@
+/** binary_row_batch.cc
+    Jeremy Barnes, 29 August 2016
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Implementation of the compact binary row batch format.
+*/
+
+#include "mldb/server/binary_row_batch.h"
+#include "mldb/http/http_exception.h"
+#include "mldb/types/basic_value_descriptions.h"
+#include "mldb/types/date.h"
+#include <cstring>
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+namespace {
+
+constexpr uint32_t ROW_BATCH_MAGIC = 'M' | ('L' << 8) | ('R' << 16) | ('B' << 24);
+constexpr uint32_t ROW_BATCH_VERSION = 1;
+
+/// Cell payload tags; these are wire format, don't renumber
+enum CellTag : uint8_t {
+    CT_EMPTY = 0,
+    CT_INTEGER = 1,
+    CT_FLOAT = 2,
+    CT_STRING = 3,
+    CT_TIMESTAMP = 4,
+    CT_INTERVAL = 5,
+    CT_BLOB = 6,
+    CT_PATH = 7
+};
+
+void writeVarint(std::string & out, uint64_t val)
+{
+    while (val >= 128) {
+        out.push_back((char)((val & 127) | 128));
+        val >>= 7;
+    }
+    out.push_back((char)val);
+}
+
+void writeZigzag(std::string & out, int64_t val)
+{
+    writeVarint(out, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+void writeDouble(std::string & out, double val)
+{
+    char buf[8];
+    std::memcpy(buf, &val, 8);
+    out.append(buf, 8);
+}
+
+void writeString(std::string & out, const char * data, size_t len)
+{
+    writeVarint(out, len);
+    out.append(data, len);
+}
+
+void writeString(std::string & out, const Utf8String & str)
+{
+    writeString(out, str.rawData(), str.rawLength());
+}
+
+void writeCell(std::string & out, const CellValue & val)
+{
+    switch (val.cellType()) {
+    case CellValue::EMPTY:
+        out.push_back((char)CT_EMPTY);
+        return;
+    case CellValue::INTEGER:
+        out.push_back((char)CT_INTEGER);
+        writeZigzag(out, val.toInt());
+        return;
+    case CellValue::FLOAT:
+        out.push_back((char)CT_FLOAT);
+        writeDouble(out, val.toDouble());
+        return;
+    case CellValue::ASCII_STRING:
+    case CellValue::UTF8_STRING:
+        out.push_back((char)CT_STRING);
+        writeString(out, val.stringChars(), val.toStringLength());
+        return;
+    case CellValue::TIMESTAMP:
+        out.push_back((char)CT_TIMESTAMP);
+        writeDouble(out, val.toTimestamp().secondsSinceEpoch());
+        return;
+    case CellValue::TIMEINTERVAL: {
+        out.push_back((char)CT_INTERVAL);
+        int64_t months, days;
+        double seconds;
+        std::tie(months, days, seconds) = val.toMonthDaySecond();
+        writeZigzag(out, months);
+        writeZigzag(out, days);
+        writeDouble(out, seconds);
+        return;
+    }
+    case CellValue::BLOB:
+        out.push_back((char)CT_BLOB);
+        writeString(out, (const char *)val.blobData(), val.blobLength());
+        return;
+    case CellValue::PATH:
+        out.push_back((char)CT_PATH);
+        writeString(out, val.coerceToPath().toUtf8String());
+        return;
+    default:
+        throw HttpReturnException(500, "Unknown cell type in binary row batch",
+                                  "value", val);
+    }
+}
+
+/// Bounds-checked cursor over an encoded batch
+struct BatchReader {
+    BatchReader(const char * data, size_t length)
+        : p(data), e(data + length)
+    {
+    }
+
+    const char * p;
+    const char * e;
+
+    void need(size_t n) const
+    {
+        if ((size_t)(e - p) < n)
+            throw HttpReturnException(400, "Truncated binary row batch");
+    }
+
+    uint64_t readVarint()
+    {
+        uint64_t result = 0;
+        for (int shift = 0;  shift < 64;  shift += 7) {
+            need(1);
+            uint8_t b = (uint8_t)*p++;
+            result |= (uint64_t)(b & 127) << shift;
+            if (!(b & 128))
+                return result;
+        }
+        throw HttpReturnException(400, "Invalid varint in binary row batch");
+    }
+
+    int64_t readZigzag()
+    {
+        uint64_t val = readVarint();
+        return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+    }
+
+    double readDouble()
+    {
+        need(8);
+        double result;
+        std::memcpy(&result, p, 8);
+        p += 8;
+        return result;
+    }
+
+    Utf8String readString()
+    {
+        uint64_t len = readVarint();
+        need(len);
+        Utf8String result(string(p, p + len));
+        p += len;
+        return result;
+    }
+
+    CellValue readCell()
+    {
+        need(1);
+        uint8_t tag = (uint8_t)*p++;
+        switch (tag) {
+        case CT_EMPTY:
+            return CellValue();
+        case CT_INTEGER:
+            return CellValue(readZigzag());
+        case CT_FLOAT:
+            return CellValue(readDouble());
+        case CT_STRING:
+            return CellValue(readString());
+        case CT_TIMESTAMP:
+            return CellValue(Date::fromSecondsSinceEpoch(readDouble()));
+        case CT_INTERVAL: {
+            int64_t months = readZigzag();
+            int64_t days = readZigzag();
+            double seconds = readDouble();
+            return CellValue::fromMonthDaySecond(months, days, seconds);
+        }
+        case CT_BLOB: {
+            uint64_t len = readVarint();
+            need(len);
+            CellValue result = CellValue::blob(p, len);
+            p += len;
+            return result;
+        }
+        case CT_PATH:
+            return CellValue(Path::parse(readString()));
+        default:
+            throw HttpReturnException(400, "Unknown cell tag in binary row batch",
+                                      "tag", (int)tag);
+        }
+    }
+};
+
+} // file scope
+
+
+/*****************************************************************************/
+/* BINARY ROW BATCH WRITER                                                   */
+/*****************************************************************************/
+
+BinaryRowBatchWriter::
+BinaryRowBatchWriter()
+    : numRows(0)
+{
+}
+
+uint32_t
+BinaryRowBatchWriter::
+columnIndex(const ColumnName & column)
+{
+    uint64_t hash = column.newHash();
+    auto it = columnLookup.find(hash);
+    if (it != columnLookup.end())
+        return it->second;
+    uint32_t result = columnNames.size();
+    columnNames.push_back(column);
+    columnLookup[hash] = result;
+    return result;
+}
+
+void
+BinaryRowBatchWriter::
+addRow(const RowName & rowName,
+       const std::vector<std::tuple<ColumnName, CellValue, Date> > & columns)
+{
+    writeString(rowData, rowName.toUtf8String());
+    writeVarint(rowData, columns.size());
+    for (auto & c: columns) {
+        writeVarint(rowData, columnIndex(std::get<0>(c)));
+        writeCell(rowData, std::get<1>(c));
+        writeDouble(rowData, std::get<2>(c).secondsSinceEpoch());
+    }
+    ++numRows;
+}
+
+std::string
+BinaryRowBatchWriter::
+finish()
+{
+    std::string result;
+    result.reserve(rowData.size() + 64);
+    writeVarint(result, ROW_BATCH_MAGIC);
+    writeVarint(result, ROW_BATCH_VERSION);
+    writeVarint(result, columnNames.size());
+    for (auto & c: columnNames)
+        writeString(result, c.toUtf8String());
+    writeVarint(result, numRows);
+    result += rowData;
+
+    columnNames.clear();
+    columnLookup.clear();
+    rowData.clear();
+    numRows = 0;
+
+    return result;
+}
+
+
+/*****************************************************************************/
+/* DECODING                                                                  */
+/*****************************************************************************/
+
+std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > >
+decodeBinaryRowBatch(const char * data, size_t length)
+{
+    BatchReader reader(data, length);
+
+    if (reader.readVarint() != ROW_BATCH_MAGIC)
+        throw HttpReturnException(400, "Binary row batch has the wrong magic "
+                                  "number; expected an MLRB payload");
+    uint64_t version = reader.readVarint();
+    if (version != ROW_BATCH_VERSION)
+        throw HttpReturnException(400, "Unknown binary row batch version",
+                                  "version", version);
+
+    uint64_t numColumns = reader.readVarint();
+    std::vector<ColumnName> columnNames;
+    columnNames.reserve(numColumns);
+    for (uint64_t i = 0;  i < numColumns;  ++i)
+        columnNames.push_back(Path::parse(reader.readString()));
+
+    uint64_t numRows = reader.readVarint();
+    std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > > result;
+    result.reserve(numRows);
+
+    for (uint64_t i = 0;  i < numRows;  ++i) {
+        RowName rowName = Path::parse(reader.readString());
+        uint64_t numCells = reader.readVarint();
+        std::vector<std::tuple<ColumnName, CellValue, Date> > cells;
+        cells.reserve(numCells);
+        for (uint64_t j = 0;  j < numCells;  ++j) {
+            uint64_t columnIdx = reader.readVarint();
+            if (columnIdx >= columnNames.size())
+                throw HttpReturnException(400, "Column index out of range in "
+                                          "binary row batch",
+                                          "columnIndex", columnIdx);
+            CellValue value = reader.readCell();
+            Date ts = Date::fromSecondsSinceEpoch(reader.readDouble());
+            cells.emplace_back(columnNames[columnIdx], std::move(value),
+                               std::move(ts));
+        }
+        result.emplace_back(std::move(rowName), std::move(cells));
+    }
+
+    if (reader.p != reader.e)
+        throw HttpReturnException(400, "Trailing bytes after binary row batch");
+
+    return result;
+}
+
+} // namespace MLDB
+} // namespace Datacratic
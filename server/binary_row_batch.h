@@ -0,0 +1,97 @@
+/** binary_row_batch.h                                             -*- C++ -*-
+    Jeremy Barnes, 29 August 2016
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Compact binary encoding of a batch of rows, for high rate ingestion
+    over POST /v1/datasets/<id>/rows/binary.  Column names are interned
+    in a per-batch dictionary and referenced by index, cell values are
+    written in their native representation, and counts and lengths are
+    varint encoded, so a batch costs a few bytes per cell instead of the
+    JSON encode/decode on both sides of the wire.
+
+    Format (all multi-byte integers are LEB128 varints unless noted;
+    doubles are 8 raw little-endian bytes):
+
+      'M' 'L' 'R' 'B'               magic
+      version                       currently 1
+      numColumns                    column dictionary
+      numColumns x (len, utf8)      column names, in index order
+      numRows
+      numRows x row
+
+    where each row is:
+
+      len, utf8                     row name (Path string form)
+      numCells
+      numCells x (columnIndex, tag, payload, timestamp double)
+
+    and the cell payload depends on the one byte tag:
+
+      0 empty                       no payload
+      1 integer                     zigzag varint
+      2 float                       double
+      3 string                      len, utf8 bytes
+      4 timestamp                   double (seconds since epoch)
+      5 interval                    zigzag months, zigzag days, double
+      6 blob                        len, raw bytes
+      7 path                        len, utf8 (Path string form)
+
+    The writer below is the client side encoding helper; ingest agents
+    link it (or reimplement the format above) instead of JSON encoding.
+*/
+
+#pragma once
+
+#include "mldb/sql/cell_value.h"
+#include "mldb/sql/dataset_fwd.h"
+#include "mldb/sql/path.h"
+#include "mldb/jml/utils/lightweight_hash.h"
+#include <string>
+#include <vector>
+
+namespace Datacratic {
+namespace MLDB {
+
+
+/*****************************************************************************/
+/* BINARY ROW BATCH WRITER                                                   */
+/*****************************************************************************/
+
+/** Accumulates rows and produces the wire format of a batch.  Column
+    names are interned on first use, so the cost of a repeated column is
+    its index, not its name.
+*/
+
+struct BinaryRowBatchWriter {
+    BinaryRowBatchWriter();
+
+    /** Add a row to the batch.  Columns are (name, value, timestamp)
+        tuples, as recordRow takes them.
+    */
+    void addRow(const RowName & rowName,
+                const std::vector<std::tuple<ColumnName, CellValue, Date> > & columns);
+
+    /** Return the encoded batch and reset the writer. */
+    std::string finish();
+
+    size_t rowCount() const { return numRows; }
+
+private:
+    /// Index of the column in the dictionary, interning it if needed
+    uint32_t columnIndex(const ColumnName & column);
+
+    std::vector<ColumnName> columnNames;
+    ML::Lightweight_Hash<uint64_t, int> columnLookup;
+    std::string rowData;     ///< Encoded rows, appended to by addRow
+    size_t numRows;
+};
+
+
+/** Decode a batch back into the structure that Dataset::recordRows
+    takes.  Throws HttpReturnException(400) on a malformed payload.
+*/
+std::vector<std::pair<RowName, std::vector<std::tuple<ColumnName, CellValue, Date> > > >
+decodeBinaryRowBatch(const char * data, size_t length);
+
+} // namespace MLDB
+} // namespace Datacratic
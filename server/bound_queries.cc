@@ -11,13 +11,23 @@
 #include "mldb/server/dataset_context.h"
 #include "mldb/base/parallel.h"
 #include "mldb/server/per_thread_accumulator.h"
+#include "mldb/server/engine_stats.h"
 #include "mldb/server/parallel_merge_sort.h"
 #include "mldb/arch/timers.h"
 #include "mldb/types/basic_value_descriptions.h"
 #include "mldb/sql/sql_expression_operations.h"
 #include "mldb/sql/sql_utils.h"
+#include "mldb/sql/execution_pipeline.h"
 #include "mldb/http/http_exception.h"
+#include "mldb/server/mldb_server.h"
+#include "mldb/vfs/filter_streams.h"
+#include "mldb/arch/simd_vector.h"
+#include "mldb/jml/utils/lightweight_hash.h"
+#include "mldb/jml/utils/environment.h"
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <mutex>
+#include <unistd.h>
 
 #include "mldb/jml/utils/profile.h"
 
@@ -39,6 +49,289 @@ const int TASK_PER_THREAD = 8;
 __thread int QueryThreadTracker::depth = 0;
 
 
+/*****************************************************************************/
+/* QUERY LANE SCHEDULER                                                      */
+/*****************************************************************************/
+
+/// Maximum number of batch lane queries that may execute at once
+static ML::Env_Option<int> MAX_BATCH_QUERIES("MLDB_MAX_BATCH_QUERIES", 2);
+
+__thread int QueryLaneScheduler::currentLane_ = LANE_INTERACTIVE;
+
+/// Depth of nested Admission objects on this thread, so that a group by
+/// admitting its sub-select doesn't count (or deadlock on) a second slot
+static __thread int admissionDepth = 0;
+
+QueryLaneScheduler::
+QueryLaneScheduler()
+    : runningBatch(0),
+      maxRunningBatch(std::max<int>(1, MAX_BATCH_QUERIES)),
+      runningInteractive(0)
+{
+}
+
+QueryLaneScheduler &
+QueryLaneScheduler::
+instance()
+{
+    static QueryLaneScheduler result;
+    return result;
+}
+
+QueryLane
+QueryLaneScheduler::
+currentLane()
+{
+    return (QueryLane)currentLane_;
+}
+
+QueryLaneScheduler::LaneGuard::
+LaneGuard(QueryLane lane)
+    : saved(currentLane_)
+{
+    currentLane_ = lane;
+}
+
+QueryLaneScheduler::LaneGuard::
+~LaneGuard()
+{
+    currentLane_ = saved;
+}
+
+QueryLaneScheduler::Admission::
+Admission()
+    : lane(currentLane()), counted(admissionDepth++ == 0)
+{
+    if (!counted)
+        return;
+
+    auto & sched = instance();
+
+    if (lane == LANE_INTERACTIVE) {
+        ++sched.runningInteractive;
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(sched.mutex);
+    sched.cond.wait(guard, [&] ()
+                    {
+                        return sched.runningBatch < sched.maxRunningBatch;
+                    });
+    ++sched.runningBatch;
+}
+
+QueryLaneScheduler::Admission::
+~Admission()
+{
+    --admissionDepth;
+    if (!counted)
+        return;
+
+    auto & sched = instance();
+
+    if (lane == LANE_INTERACTIVE) {
+        if (--sched.runningInteractive == 0)
+            sched.cond.notify_all();
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> guard(sched.mutex);
+        --sched.runningBatch;
+    }
+    sched.cond.notify_all();
+}
+
+void
+QueryLaneScheduler::
+yieldAtChunkBoundary(QueryLane lane)
+{
+    if (lane != LANE_BATCH)
+        return;
+    if (runningInteractive.load(std::memory_order_relaxed) == 0)
+        return;
+
+    // An interactive query is in flight: stand aside until it's done.
+    // Chunks are small, so this bounds how long interactive work can
+    // wait behind the batch chunk that is already running.
+    std::unique_lock<std::mutex> guard(mutex);
+    cond.wait(guard, [&] ()
+              {
+                  return runningInteractive.load() == 0;
+              });
+}
+
+
+/*****************************************************************************/
+/* QUERY BATCH SIZE OVERRIDE                                                 */
+/*****************************************************************************/
+
+static __thread ssize_t currentBatchSize = 0;
+
+QueryBatchSizeOverride::
+QueryBatchSizeOverride(ssize_t rows)
+    : saved(currentBatchSize)
+{
+    currentBatchSize = rows;
+}
+
+QueryBatchSizeOverride::
+~QueryBatchSizeOverride()
+{
+    currentBatchSize = saved;
+}
+
+ssize_t
+QueryBatchSizeOverride::
+current()
+{
+    return currentBatchSize;
+}
+
+
+/*****************************************************************************/
+/* QUERY PERF COUNTERS                                                       */
+/*****************************************************************************/
+
+static __thread QueryPerfCounters * currentPerfCounters = nullptr;
+
+QueryPerfCounters *
+QueryPerfCounters::
+current()
+{
+    return currentPerfCounters;
+}
+
+ML::PerfCounterAccumulator *
+QueryPerfCounters::
+columnScanAccumulator()
+{
+    return currentPerfCounters ? &currentPerfCounters->columnScan : nullptr;
+}
+
+QueryPerfCounters::Guard::
+Guard(QueryPerfCounters * counters)
+    : saved(currentPerfCounters),
+      reorderGuard(counters ? &counters->predicatesReordered : nullptr)
+{
+    currentPerfCounters = counters;
+}
+
+QueryPerfCounters::Guard::
+~Guard()
+{
+    currentPerfCounters = saved;
+}
+
+
+/*****************************************************************************/
+/* ADAPTIVE BATCHING                                                         */
+/*****************************************************************************/
+
+/// Target wall time for one scan batch.  Cheap rows converge on large
+/// batches (low scheduling overhead); expensive rows on small ones
+/// (good load balancing and prompt early termination).
+static ML::Env_Option<float> BATCH_QUANTUM_SECONDS
+    ("MLDB_BATCH_QUANTUM_SECONDS", 0.002);
+
+namespace {
+
+/** Controller for the number of rows claimed per scan batch.  Seeded
+    from the static heuristic (TASK_PER_THREAD tasks per core), then
+    adjusted after each measured batch towards BATCH_QUANTUM_SECONDS
+    of work.  Pinned when the query carries a batchSize override.
+*/
+struct AdaptiveBatcher {
+    AdaptiveBatcher(size_t totalRows)
+        : fixed(QueryBatchSizeOverride::current() > 0)
+    {
+        size_t initial;
+        if (fixed)
+            initial = QueryBatchSizeOverride::current();
+        else initial = std::max<size_t>
+                 (MIN_ROW_PER_TASK,
+                  totalRows / (numCpus() * TASK_PER_THREAD));
+        batchSize = clamp(initial);
+    }
+
+    size_t next() const
+    {
+        return batchSize.load(std::memory_order_relaxed);
+    }
+
+    /// Record that n rows took the given wall time, and adjust
+    void recordTime(size_t n, double seconds)
+    {
+        if (fixed || n == 0 || seconds <= 0.0)
+            return;
+        size_t ideal = clamp(BATCH_QUANTUM_SECONDS * n / seconds);
+        // Move half way towards the ideal, to damp oscillation between
+        // threads hitting cheap and expensive regions of the dataset
+        size_t current = batchSize.load(std::memory_order_relaxed);
+        batchSize.store((current + ideal) / 2, std::memory_order_relaxed);
+    }
+
+    static size_t clamp(size_t sz)
+    {
+        return std::min<size_t>(std::max<size_t>(sz, MIN_ROW_PER_TASK),
+                                1 << 20);
+    }
+
+    bool fixed;
+    std::atomic<size_t> batchSize;
+};
+
+/** Scan [first, last) in adaptively sized batches over the thread pool.
+    Workers claim the next batch from a shared cursor, so a thread that
+    finishes a cheap region early is immediately free for the rest
+    rather than waiting on a static partition.  doBatch returns false
+    to stop the scan early.
+*/
+static void scanInAdaptiveBatches(size_t first, size_t last,
+                                  const std::function<bool (size_t, size_t)> & doBatch)
+{
+    if (first >= last)
+        return;
+
+    AdaptiveBatcher batcher(last - first);
+
+    // Per-thread properties are captured here since the workers run on
+    // pool threads that don't carry them.
+    QueryLane lane = QueryLaneScheduler::currentLane();
+
+    std::atomic<size_t> nextRow(first);
+    std::atomic<bool> stop(false);
+
+    auto worker = [&] (size_t)
+        {
+            for (;;) {
+                if (stop.load(std::memory_order_relaxed))
+                    return;
+                QueryLaneScheduler::instance().yieldAtChunkBoundary(lane);
+                size_t n = batcher.next();
+                size_t start = nextRow.fetch_add(n);
+                if (start >= last)
+                    return;
+                size_t end = std::min(start + n, last);
+                ML::Timer timer;
+                if (!doBatch(start, end)) {
+                    stop = true;
+                    return;
+                }
+                batcher.recordTime(end - start, timer.elapsed_wall());
+            }
+        };
+
+    size_t numWorkers
+        = std::min<size_t>(numCpus(),
+                           (last - first + MIN_ROW_PER_TASK - 1)
+                               / MIN_ROW_PER_TASK);
+    parallelMap(0, numWorkers, worker);
+}
+
+} // file scope
+
+
 /*****************************************************************************/
 /* BOUND SELECT QUERY                                                        */
 /*****************************************************************************/
@@ -53,6 +346,16 @@ struct BoundSelectQuery::Executor {
                          std::function<bool (const Json::Value &)> onProgress) = 0;
 
     virtual std::shared_ptr<ExpressionValueInfo> getOutputInfo() const = 0;
+
+    /// Strategy name reported in the query's explain output
+    virtual const char * name() const = 0;
+
+    /// Explain collector for the query being profiled, or null; picked
+    /// up at bind time, which happens inside the profiled region
+    ExecutionExplain * const explain = ExecutionExplain::current();
+
+    /// Rows produced by the where generator, counted when explaining
+    std::atomic<uint64_t> rowsIn{0};
 };
 
 struct UnorderedExecutor: public BoundSelectQuery::Executor {
@@ -64,6 +367,14 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
     BoundSqlExpression boundSelect;
     std::vector<BoundSqlExpression> boundCalc;
     int numBuckets;
+
+    /// When restrictColumns is true, the query names every column it
+    /// touches (no wildcards or row-consuming functions) and they are
+    /// all in neededColumns, so rows are materialized with just those
+    /// columns instead of everything the dataset has for them
+    std::vector<ColumnName> neededColumns;
+    bool restrictColumns;
+
     typedef std::function<bool (NamedRowValue & output,
                                              std::vector<ExpressionValue> & calcd,
                                              int rowNum)> ExecutorAggregator;
@@ -75,17 +386,30 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
                       BoundSqlExpression boundSelect,
                       std::vector<BoundSqlExpression> boundCalc,
                       OrderByExpression newOrderBy,
-                      int numBuckets)
+                      int numBuckets,
+                      std::vector<ColumnName> neededColumns,
+                      bool restrictColumns)
         : matrix(std::move(matrix)),
           whereGenerator(std::move(whereGenerator)),
           context(context),
           whenBound(std::move(whenBound)),
           boundSelect(std::move(boundSelect)),
           boundCalc(std::move(boundCalc)),
-          numBuckets(numBuckets)
+          numBuckets(numBuckets),
+          neededColumns(std::move(neededColumns)),
+          restrictColumns(restrictColumns)
     {
     }
 
+    /// Materialize the row, restricted to the needed columns when the
+    /// query allows it
+    MatrixNamedRow getRow(const RowName & rowName) const
+    {
+        if (restrictColumns)
+            return matrix->getRowColumns(rowName, neededColumns);
+        return matrix->getRow(rowName);
+    }
+
      virtual void execute(std::function<bool (NamedRowValue & output,
                                              std::vector<ExpressionValue> & calcd,
                                              int rowNum)> processor,
@@ -116,9 +440,17 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
         //cerr << "bound query unordered num buckets: " << numBuckets << endl;
         QueryThreadTracker parentTracker;
 
+        QueryPerfCounters * perf = QueryPerfCounters::current();
+
         // Get a list of rows that we run over
         // Ordering is arbitrary but deterministic
+        ML::PerfCounterScope whereScope(perf ? &perf->whereScan : nullptr);
         auto rows = whereGenerator(-1, Any()).first;
+        whereScope.stop();
+
+        engineStatsAdd(engineStats().rowsScanned, rows.size());
+        if (explain)
+            rowsIn.fetch_add(rows.size(), std::memory_order_relaxed);
 
         //cerr << "ROWS MEMORY SIZE " << rows.size() * sizeof(RowName) << endl;
 
@@ -140,7 +472,7 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
 
                 //RowName rowName = rows[rowNum];
 
-                auto row = matrix->getRow(rows[rowNum]);
+                auto row = getRow(rows[rowNum]);
                 auto output = processRow(row, rowNum, numPerBucket, selectStar);
 
                 int bucketNumber = numBuckets > 0 ? std::min((size_t)(rowNum/numPerBucket), (size_t)(numBuckets-1)) : -1;
@@ -153,9 +485,13 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
             ExcAssert(processInParallel);
             ExcAssertEqual(limit, -1);
             ExcAssertEqual(offset, 0);
+            QueryLane lane = QueryLaneScheduler::currentLane();
             std::atomic_ulong bucketCount(0);
             auto doBucket = [&] (int bucketNumber) -> bool
                 {
+                    QueryLaneScheduler::instance().yieldAtChunkBoundary(lane);
+                    QueryPerfCounters::Guard perfGuard(perf);
+                    ML::PerfCounterScope scope(perf ? &perf->process : nullptr);
                     size_t it = bucketNumber * numPerBucket;
                     int stopIt = bucketNumber == numBuckets - 1 ? numRows : it + numPerBucket;
                     for (; it < stopIt; ++it)
@@ -181,7 +517,19 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
 
             if (offset <= upper) {
                 if (processInParallel) {
-                    parallelMap(offset, upper, doRow);
+                    auto doBatch = [&] (size_t start, size_t end) -> bool
+                        {
+                            QueryPerfCounters::Guard perfGuard(perf);
+                            ML::PerfCounterScope scope
+                                (perf ? &perf->process : nullptr);
+                            for (size_t i = start;  i < end;  ++i) {
+                                if (!doRow(i))
+                                    return false;
+                            }
+                            return true;
+                        };
+
+                    scanInAdaptiveBatches(offset, upper, doBatch);
                 }
                 else {
                     // TODO: to reduce memory usage, we should fill blocks of
@@ -192,16 +540,22 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
                     std::vector<std::tuple<NamedRowValue, std::vector<ExpressionValue> >>
                         output(upper-offset);
 
-                    auto copyRow = [&] (int rowNum)
+                    auto copyBatch = [&] (size_t start, size_t end) -> bool
                     {
-                        auto row = matrix->getRow(rows[rowNum]);
-
-                        auto outputRow =
-                            processRow(row, rowNum, numPerBucket, selectStar);
-                        output[rowNum-offset] = std::move(outputRow);
+                        QueryPerfCounters::Guard perfGuard(perf);
+                        ML::PerfCounterScope scope
+                            (perf ? &perf->process : nullptr);
+                        for (size_t rowNum = start;  rowNum < end;  ++rowNum) {
+                            auto row = getRow(rows[rowNum]);
+
+                            auto outputRow =
+                                processRow(row, rowNum, numPerBucket, selectStar);
+                            output[rowNum-offset] = std::move(outputRow);
+                        }
+                        return true;
                     };
 
-                    parallelMap(offset, upper, copyRow);
+                    scanInAdaptiveBatches(offset, upper, copyBatch);
 
                     for (size_t i = offset; i < upper; ++i) {
                         auto& outputRow = output[i-offset];
@@ -249,9 +603,15 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
 
         ExcAssert(processInParallel);
 
+        QueryPerfCounters * perf = QueryPerfCounters::current();
+
+        QueryLane lane = QueryLaneScheduler::currentLane();
         std::atomic_ulong bucketCount(0);
         auto doBucket = [&] (int bucketNumber) -> bool
             {
+                QueryLaneScheduler::instance().yieldAtChunkBoundary(lane);
+                QueryPerfCounters::Guard perfGuard(perf);
+                ML::PerfCounterScope scope(perf ? &perf->process : nullptr);
                 size_t it = bucketNumber * numPerBucket;
                 int stopIt = bucketNumber == numBuckets - 1 ? numRows : it + numPerBucket;
                 auto stream = whereGenerator.rowStream->clone();
@@ -259,7 +619,7 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
                 for (;  it < stopIt; ++it)
                 {
                     RowName rowName = stream->next();
-                    auto row = matrix->getRow(rowName);
+                    auto row = getRow(rowName);
 
                     auto output = processRow(row, it, numPerBucket, selectStar);
                     int bucketNumber = numBuckets > 0 ? std::min((size_t)(it/numPerBucket), (size_t)(numBuckets-1)) : -1;
@@ -268,6 +628,11 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
                     if (!processor(std::get<0>(output), std::get<1>(output), bucketNumber))
                         return false;
                 }
+                engineStatsAdd(engineStats().rowsScanned,
+                               it - bucketNumber * numPerBucket);
+                if (explain)
+                    rowsIn.fetch_add(it - bucketNumber * numPerBucket,
+                                     std::memory_order_relaxed);
                 if (onProgress) {
                     Json::Value progress;
                     progress["percent"] = (float) ++bucketCount / effectiveNumBucket;
@@ -295,15 +660,17 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
         outputRow.rowName = row.rowName;
         outputRow.rowHash = row.rowName;
     
-        auto selectRowScope = context.getRowScope(row);
+        // Note that the calculations and the select share rowContext, so
+        // that subexpressions shared between them at bind time hit the
+        // same per-row memo
         vector<ExpressionValue>& calcd = std::get<1>(output);
         calcd.resize(boundCalc.size());
 
         // Run the extra calculations
         for (unsigned i = 0;  i < boundCalc.size();  ++i) {
-            calcd[i] = std::move(boundCalc[i](selectRowScope, GET_LATEST));
+            calcd[i] = std::move(boundCalc[i](rowContext, GET_LATEST));
         }
-        
+
         if (selectStar) {
             // Move into place, since we know we're selecting *
             // This is more complicated than it looks, because the input is
@@ -314,7 +681,7 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
         }
         else {
             // Run the select expression
-            ExpressionValue selectOutput = boundSelect(selectRowScope, GET_ALL);
+            ExpressionValue selectOutput = boundSelect(rowContext, GET_ALL);
             selectOutput.mergeToRowDestructive(outputRow.columns);
         }
 
@@ -325,8 +692,170 @@ struct UnorderedExecutor: public BoundSelectQuery::Executor {
     {
         return boundSelect.info;
     }
+
+    virtual const char * name() const
+    {
+        return "executor.unordered";
+    }
+};
+
+/*****************************************************************************/
+/* ORDER BY SPILL                                                            */
+/*****************************************************************************/
+
+/// Number of rows an ORDER BY without LIMIT may hold in memory before
+/// sorted runs spill to disk.  0 disables spilling.
+static ML::Env_Option<size_t> ORDER_BY_SPILL_ROWS
+    ("MLDB_ORDER_BY_SPILL_ROWS", 10000000);
+
+/** External merge sort for ORDER BY results that don't fit in memory.
+    Whenever a worker's share of the budget fills up its rows are
+    sorted and written out as one lz4-compressed run of JSON lines,
+    and the runs are k-way merged back into sorted order on output.
+    Peak memory is then one run's rows plus one decoded row per run
+    during the merge, so big ordered exports complete at disk speed
+    instead of dying in the in-memory sort.
+
+    Rows are serialized through the same value descriptions the REST
+    layer uses to return them, so anything a query can produce can
+    spill.
+*/
+struct OrderBySpill {
+
+    /// Binary sort key (empty when the fields have no byte-comparable
+    /// encoding), order by fields, output row, calculated expressions
+    typedef std::tuple<std::string, std::vector<ExpressionValue>,
+                       NamedRowValue,
+                       std::vector<ExpressionValue> > SortedRow;
+    typedef std::function<bool (const SortedRow &, const SortedRow &)>
+        Compare;
+
+    OrderBySpill(const std::string & tmpDir)
+        : tmpDir(tmpDir)
+    {
+        static std::atomic<uint64_t> spillNumber(0);
+        number = spillNumber.fetch_add(1);
+    }
+
+    ~OrderBySpill()
+    {
+        for (auto & r: runs)
+            ::unlink(r.filename.c_str());
+    }
+
+    /** Sort the given rows and write them out as a new run, clearing
+        them.  Safe to call from several workers at once; only the run
+        list itself is touched under the lock.
+    */
+    void spillRun(std::vector<SortedRow> & rows, const Compare & compare)
+    {
+        if (rows.empty())
+            return;
+
+        std::sort(rows.begin(), rows.end(), compare);
+
+        Run run;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            run.filename
+                = ML::format("%s/mldb-orderby-spill-%d-%llu-%zd.jsonl.lz4",
+                             tmpDir.c_str(), (int)getpid(),
+                             (unsigned long long)number, numRunsNamed++);
+        }
+
+        {
+            filter_ostream stream(run.filename);
+            // The binary sort key isn't written: it served its purpose
+            // in the run sort above, and the merge compares the few
+            // rows it holds directly
+            for (auto & row: rows) {
+                Json::Value line(Json::arrayValue);
+                line.append(jsonEncode(std::get<1>(row)));
+                line.append(jsonEncode(std::get<2>(row)));
+                line.append(jsonEncode(std::get<3>(row)));
+                stream << line.toStringNoNewLine() << '\n';
+            }
+        }
+
+        run.numRows = rows.size();
+        rows.clear();
+
+        std::unique_lock<std::mutex> guard(lock);
+        runs.emplace_back(std::move(run));
+    }
+
+    bool anySpilled() const
+    {
+        return !runs.empty();
+    }
+
+    /** Replay every run in merged sorted order, calling onRow with
+        each decoded row until it returns false.  Call only once all
+        spilling is done.
+    */
+    void mergeRuns(const Compare & compare,
+                   const std::function<bool (SortedRow &)> & onRow)
+    {
+        struct Cursor {
+            std::unique_ptr<filter_istream> stream;
+            SortedRow current;
+
+            bool advance()
+            {
+                std::string line;
+                if (!getline(*stream, line))
+                    return false;
+                Json::Value decoded = Json::parse(line);
+                std::get<1>(current)
+                    = jsonDecode<std::vector<ExpressionValue> >(decoded[0]);
+                std::get<2>(current) = jsonDecode<NamedRowValue>(decoded[1]);
+                std::get<3>(current)
+                    = jsonDecode<std::vector<ExpressionValue> >(decoded[2]);
+                return true;
+            }
+        };
+
+        std::vector<std::unique_ptr<Cursor> > cursors;
+        for (auto & r: runs) {
+            std::unique_ptr<Cursor> cursor(new Cursor());
+            cursor->stream.reset(new filter_istream(r.filename));
+            if (cursor->advance())
+                cursors.emplace_back(std::move(cursor));
+        }
+
+        // Heap of cursors with the smallest current row at the front
+        auto cursorAfter = [&] (const std::unique_ptr<Cursor> & c1,
+                                const std::unique_ptr<Cursor> & c2)
+            {
+                return compare(c2->current, c1->current);
+            };
+
+        std::make_heap(cursors.begin(), cursors.end(), cursorAfter);
+
+        while (!cursors.empty()) {
+            std::pop_heap(cursors.begin(), cursors.end(), cursorAfter);
+            auto & cursor = cursors.back();
+            if (!onRow(cursor->current))
+                return;
+            if (cursor->advance())
+                std::push_heap(cursors.begin(), cursors.end(), cursorAfter);
+            else cursors.pop_back();
+        }
+    }
+
+    struct Run {
+        std::string filename;
+        uint64_t numRows = 0;
+    };
+
+    std::string tmpDir;
+    uint64_t number;
+    std::mutex lock;
+    size_t numRunsNamed = 0;
+    std::vector<Run> runs;
 };
 
+
 struct OrderedExecutor: public BoundSelectQuery::Executor {
 
     std::shared_ptr<MatrixView> matrix;
@@ -364,9 +893,17 @@ struct OrderedExecutor: public BoundSelectQuery::Executor {
     {
         QueryThreadTracker parentTracker;
 
+        QueryPerfCounters * perf = QueryPerfCounters::current();
+
         // Get a list of rows that we run over
         // Ordering is arbitrary but deterministic
+        ML::PerfCounterScope whereScope(perf ? &perf->whereScan : nullptr);
         auto rows = whereGenerator(-1, Any()).first;
+        whereScope.stop();
+
+        engineStatsAdd(engineStats().rowsScanned, rows.size());
+        if (explain)
+            rowsIn.fetch_add(rows.size(), std::memory_order_relaxed);
 
         // cerr << "doing " << rows.size() << " rows with order by" << endl;
         // We have a defined order, so we need to sort here
@@ -382,16 +919,59 @@ struct OrderedExecutor: public BoundSelectQuery::Executor {
    
         // For each one, generate the order by key
 
-        typedef std::tuple<std::vector<ExpressionValue>, NamedRowValue, std::vector<ExpressionValue> > SortedRow;
+        typedef OrderBySpill::SortedRow SortedRow;
         typedef std::vector<SortedRow> SortedRows;
-        
+
         PerThreadAccumulator<SortedRows> accum;
 
         std::atomic<int64_t> rowsAdded(0);
 
+        // Compare two rows according to the sort criteria.  The binary
+        // keys turn the per-comparison type dispatch into one byte
+        // compare; rows without a key (fields with no byte-comparable
+        // encoding, or rows decoded from a spill run) and key ties are
+        // compared directly.
+        auto compareRows = [&] (const SortedRow & row1,
+                                const SortedRow & row2) -> bool
+            {
+                const std::string & key1 = std::get<0>(row1);
+                const std::string & key2 = std::get<0>(row2);
+                if (!key1.empty() && !key2.empty()) {
+                    int cmp = key1.compare(key2);
+                    if (cmp != 0)
+                        return cmp < 0;
+                }
+                return boundOrderBy.less(std::get<1>(row1),
+                                         std::get<1>(row2));
+            };
+
+        // With a limit we only ever need the best limit + offset rows, so
+        // each worker thread keeps a bounded heap of candidates instead of
+        // materializing every matching row before the sort.
+        ssize_t maxRowsNeeded = -1;
+        if (limit != -1)
+            maxRowsNeeded = limit + std::max<ssize_t>(offset, 0);
+
+        // Without a limit every matching row must be held for the
+        // sort, which can exceed memory on big exports.  Over budget,
+        // each worker spills sorted runs to disk and the output
+        // becomes a k-way merge of the runs (see OrderBySpill).
+        std::shared_ptr<OrderBySpill> spill;
+        size_t spillRunRows = 0;
+        if (maxRowsNeeded == -1 && ORDER_BY_SPILL_ROWS.get() > 0) {
+            std::string tmpDir = context.dataset.server->getCacheDirectory();
+            if (tmpDir.empty())
+                tmpDir = "/tmp";
+            spill.reset(new OrderBySpill(tmpDir));
+            spillRunRows = std::max<size_t>(ORDER_BY_SPILL_ROWS.get()
+                                            / numCpus(), 1000);
+        }
+
         auto doWhere = [&] (int rowNum) -> bool
             {
                 QueryThreadTracker childTracker = parentTracker.child();
+                QueryPerfCounters::Guard perfGuard(perf);
+                ML::PerfCounterScope scope(perf ? &perf->process : nullptr);
 
                 auto row = matrix->getRow(rows[rowNum]);
 
@@ -413,16 +993,17 @@ struct OrderedExecutor: public BoundSelectQuery::Executor {
                 outputRow.rowName = row.rowName;
                 outputRow.rowHash = row.rowName;
             
-                auto selectRowScope = context.getRowScope(row);
-             
-                // Run the bound select expressions
+                // Run the bound select expressions.  The select and the
+                // calculations share rowContext so that subexpressions
+                // shared between them at bind time hit the same per-row
+                // memo.
                 ExpressionValue selectOutput
-                = boundSelect(selectRowScope, GET_ALL);
+                = boundSelect(rowContext, GET_ALL);
                 selectOutput.mergeToRowDestructive(outputRow.columns);
 
                 vector<ExpressionValue> calcd(boundCalc.size());
                 for (unsigned i = 0;  i < boundCalc.size();  ++i) {
-                    calcd[i] = std::move(boundCalc[i](selectRowScope, GET_LATEST));
+                    calcd[i] = std::move(boundCalc[i](rowContext, GET_LATEST));
                 }
 
                 // Get the order by context, which can read from both the result
@@ -433,10 +1014,44 @@ struct OrderedExecutor: public BoundSelectQuery::Executor {
                 std::vector<ExpressionValue> sortFields
                     = boundOrderBy.apply(orderByRowScope);
 
+                // Encode the sort fields once; every comparison the
+                // row takes part in is then a byte compare
+                std::string sortKey;
+                boundOrderBy.encodeSortKey(sortFields, sortKey);
+
                 SortedRows * sortedRows = &accum.get();
-                sortedRows->emplace_back(std::move(sortFields),
-                                         std::move(outputRow),
-                                         std::move(calcd));
+
+                if (maxRowsNeeded == -1) {
+                    sortedRows->emplace_back(std::move(sortKey),
+                                             std::move(sortFields),
+                                             std::move(outputRow),
+                                             std::move(calcd));
+                    if (spill && sortedRows->size() >= spillRunRows)
+                        spill->spillRun(*sortedRows, compareRows);
+                }
+                else {
+                    // Keep the rows as a max-heap on the sort order; the
+                    // front is the worst candidate and is evicted whenever
+                    // a better row comes along
+                    SortedRow candidate(std::move(sortKey),
+                                        std::move(sortFields),
+                                        std::move(outputRow),
+                                        std::move(calcd));
+
+                    if (sortedRows->size() < maxRowsNeeded) {
+                        sortedRows->emplace_back(std::move(candidate));
+                        std::push_heap(sortedRows->begin(), sortedRows->end(),
+                                       compareRows);
+                    }
+                    else if (!sortedRows->empty()
+                             && compareRows(candidate, sortedRows->front())) {
+                        std::pop_heap(sortedRows->begin(), sortedRows->end(),
+                                      compareRows);
+                        sortedRows->back() = std::move(candidate);
+                        std::push_heap(sortedRows->begin(), sortedRows->end(),
+                                       compareRows);
+                    }
+                }
 
                 ++rowsAdded;
                 return true;
@@ -448,14 +1063,37 @@ struct OrderedExecutor: public BoundSelectQuery::Executor {
 
         cerr << "map took " << timer.elapsed() << endl;
         timer.restart();
-        
-        // Compare two rows according to the sort criteria
-        auto compareRows = [&] (const SortedRow & row1,
-                                const SortedRow & row2) -> bool
-            {
-                return boundOrderBy.less(std::get<0>(row1), std::get<0>(row2));
-            };
-            
+
+        // Everything from here on (spill merge or in-memory merge sort,
+        // plus emitting the rows) is the sort phase
+        ML::PerfCounterScope sortScope(perf ? &perf->sort : nullptr);
+
+        if (spill && spill->anySpilled()) {
+            // Flush each worker's remaining rows as a final run, then
+            // merge the runs in sorted order straight into the
+            // processor; only the cursors' current rows are in memory
+            accum.forEach([&] (SortedRows * threadRows)
+                {
+                    spill->spillRun(*threadRows, compareRows);
+                });
+
+            ExcAssertGreaterEqual(offset, 0);
+
+            ssize_t rowNum = 0;
+            auto onRow = [&] (OrderBySpill::SortedRow & row) -> bool
+                {
+                    if (rowNum++ < offset)
+                        return true;
+                    return processor(std::get<2>(row), std::get<3>(row),
+                                     rowNum - 1);
+                };
+
+            spill->mergeRuns(compareRows, onRow);
+
+            cerr << "external merge took " << timer.elapsed() << endl;
+            return;
+        }
+
         auto rowsSorted = parallelMergeSort(accum.threads, compareRows);
 
         cerr << "shuffle took " << timer.elapsed() << endl;
@@ -463,8 +1101,8 @@ struct OrderedExecutor: public BoundSelectQuery::Executor {
 
         auto doSelect = [&] (int rowNum) -> bool
             {
-                auto & row = std::get<1>(rowsSorted[rowNum]);
-                auto & calcd = std::get<2>(rowsSorted[rowNum]);
+                auto & row = std::get<2>(rowsSorted[rowNum]);
+                auto & calcd = std::get<3>(rowsSorted[rowNum]);
 
                 /* Finally, pass to the terminator to continue. */
                 return processor(row, calcd, rowNum);
@@ -490,6 +1128,11 @@ struct OrderedExecutor: public BoundSelectQuery::Executor {
     {
         return boundSelect.info;
     }
+
+    virtual const char * name() const
+    {
+        return "executor.ordered";
+    }
 };
 
 namespace {
@@ -561,11 +1204,19 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
 
         QueryThreadTracker parentTracker;
 
+        QueryPerfCounters * perf = QueryPerfCounters::current();
+
         ML::Timer rowsTimer;
 
         // Get a list of rows that we run over
         // Ordering is arbitrary but deterministic
+        ML::PerfCounterScope whereScope(perf ? &perf->whereScan : nullptr);
         auto rows = whereGenerator(-1, Any()).first;
+        whereScope.stop();
+
+        engineStatsAdd(engineStats().rowsScanned, rows.size());
+        if (explain)
+            rowsIn.fetch_add(rows.size(), std::memory_order_relaxed);
 
         if (!std::is_sorted(rows.begin(), rows.end(), SortByRowHash()))
             std::sort(rows.begin(), rows.end(), SortByRowHash());
@@ -606,6 +1257,9 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
                 QueryThreadTracker childTracker
                     = std::move(parentTracker.child());
 
+                QueryPerfCounters::Guard perfGuard(perf);
+                ML::PerfCounterScope scope(perf ? &perf->process : nullptr);
+
                 MatrixNamedRow row;
                 try {
                     // If we've gotten all past the maxRowNumNeeded, then we can stop
@@ -738,6 +1392,9 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
 
         scanTimer.restart();
 
+        // The partial sort and the output emit are the sort phase
+        ML::PerfCounterScope sortScope(perf ? &perf->sort : nullptr);
+
         // Now select only the required subset of sorted rows
         if (limit == -1)
             limit = sorted.size();
@@ -818,6 +1475,8 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
 
         ML::Timer rowsTimer;
 
+        QueryPerfCounters * perf = QueryPerfCounters::current();
+
         typedef std::vector<RowName> AccumRows;
         
         PerThreadAccumulator<AccumRows> accum;
@@ -825,16 +1484,13 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
         int numNeeded = offset + limit;
 
         int upperBound = whereGenerator.upperBound;
-        int maxNumTask = numCpus() * TASK_PER_THREAD;
-        //try to have at least MIN_ROW_PER_TASK element per task
-        int numChunk = upperBound < maxNumTask*MIN_ROW_PER_TASK ? (upperBound / maxNumTask) : maxNumTask;
-        numChunk = std::max(numChunk, (int)1U);
-        int chunkSize = (int)std::floor((float)upperBound / numChunk);
 
-        auto doChunk = [&] (int bucketIndex)
+        auto doBatch = [&] (size_t index, size_t stopIndex) -> bool
         {
-          int index = bucketIndex*chunkSize;
-          int stopIndex = bucketIndex == numChunk - 1 ? upperBound : index + chunkSize;
+          QueryPerfCounters::Guard perfGuard(perf);
+          ML::PerfCounterScope scope(perf ? &perf->whereScan : nullptr);
+
+          size_t firstIndex = index;
           AccumRows& rows = accum.get();
 
           auto stream = whereGenerator.rowStream->clone();
@@ -873,9 +1529,14 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
 
               ++index;
           }
-        };      
 
-        parallelMap(0, numChunk, doChunk);        
+          engineStatsAdd(engineStats().rowsScanned, index - firstIndex);
+          if (explain)
+              rowsIn.fetch_add(index - firstIndex, std::memory_order_relaxed);
+          return true;
+        };
+
+        scanInAdaptiveBatches(0, upperBound, doBatch);
        
         // Compare two rows according to the sort criteria
         auto compareRows = [&] (const RowName & row1,
@@ -899,6 +1560,8 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
          // Do we select *?  In that case we can avoid a lot of copying
         bool selectStar = boundSelect.expr->isIdentitySelect(context);
 
+        ML::PerfCounterScope processScope(perf ? &perf->process : nullptr);
+
         int count = 0;
         for (auto & r : rowsMerged) {
 
@@ -939,6 +1602,11 @@ struct RowHashOrderedExecutor: public BoundSelectQuery::Executor {
     {
         return boundSelect.info;
     }
+
+    virtual const char * name() const
+    {
+        return "executor.rowHashOrdered";
+    }
 };
 
 BoundSelectQuery::
@@ -957,15 +1625,67 @@ BoundSelectQuery(const SelectExpression & select,
         SqlExpressionWhenScope whenScope(*context);
         auto whenBound = when.bind(whenScope);
 
-        // Get a generator for the rows that match 
-        auto whereGenerator = context->doCreateRowsWhereGenerator(where, 0, -1);
+        // Constant-fold the where clause before generating rows:
+        // patterns like WHERE 1=1 AND x > 2 then don't evaluate the
+        // constant conjunct per row, and once folded the clause can
+        // match the datasets' optimized generator paths.  Kept in a
+        // member since the generator may bind against it.
+        try {
+            foldedWhere = SqlExpression::foldConstants(where.shallowCopy());
+        } JML_CATCH_ALL {
+            // shallowCopy() isn't available for every expression type;
+            // fall back to the unfolded clause
+            foldedWhere.reset();
+        }
+
+        // Get a generator for the rows that match
+        auto whereGenerator = context->doCreateRowsWhereGenerator
+            (foldedWhere ? *foldedWhere : where, 0, -1);
 
         auto matrix = from.getMatrixView();
 
-        auto boundSelect = select.bind(*context);
+        // Constant-fold the select, calc and order by clauses, then
+        // share repeated subexpressions between them before binding, so
+        // that a CASE chain pasted into several clauses by a query
+        // generator loses its dead arms and is evaluated once per row.
+        // The where clause is excluded from the sharing: it runs inside
+        // the dataset's row generator against its own row scopes, where
+        // the per-row memo could never be hit.
+        std::vector<std::shared_ptr<SqlExpression> > cseRoots;
+        for (auto & c: select.clauses)
+            cseRoots.push_back(SqlExpression::foldConstants(c));
+        for (auto & c: calc)
+            cseRoots.push_back(SqlExpression::foldConstants(c));
+        for (auto & x: orderBy.clauses)
+            cseRoots.push_back(SqlExpression::foldConstants(x.first));
+
+        auto cseRewritten
+            = SqlExpression::extractCommonSubexpressions(cseRoots);
+        if (cseRewritten.empty())
+            cseRewritten = std::move(cseRoots);
+
+        SelectExpression sharedSelect(select);
+        std::vector<std::shared_ptr<SqlExpression> > sharedCalc(calc);
+        OrderByExpression sharedOrderBy(orderBy);
+
+        {
+            size_t i = 0;
+            for (auto & c: sharedSelect.clauses) {
+                auto asRow = std::dynamic_pointer_cast<SqlRowExpression>
+                    (cseRewritten.at(i++));
+                if (asRow)
+                    c = asRow;
+            }
+            for (auto & c: sharedCalc)
+                c = cseRewritten.at(i++);
+            for (auto & x: sharedOrderBy.clauses)
+                x.first = cseRewritten.at(i++);
+        }
+
+        auto boundSelect = sharedSelect.bind(*context);
 
         std::vector<BoundSqlExpression> boundCalc;
-        for (auto & c: calc) {
+        for (auto & c: sharedCalc) {
             ExcAssert(c);
             boundCalc.emplace_back(c->bind(*context));
         }
@@ -974,7 +1694,7 @@ BoundSelectQuery(const SelectExpression & select,
 
         // Remove any constants from the order by clauses
         OrderByExpression newOrderBy;
-        for (auto & x: orderBy.clauses) {
+        for (auto & x: sharedOrderBy.clauses) {
 
             // TODO: Better constant detection
             if (x.first->getType() == "constant")
@@ -983,6 +1703,36 @@ BoundSelectQuery(const SelectExpression & select,
             newOrderBy.clauses.push_back(x);
         }
 
+        // Work out whether the query names every column it touches; if
+        // so the unordered executor can materialize rows with just
+        // those columns, which on wide datasets turns a point lookup
+        // of a few columns from a whole-row scan into a few probes.
+        // Wildcards, nested table references and functions other than
+        // the row metadata ones need the full row.
+        std::vector<ColumnName> neededColumns;
+        bool restrictColumns = true;
+
+        UnboundEntities unbound = sharedSelect.getUnbound();
+        for (auto & c: sharedCalc)
+            unbound.merge(c->getUnbound());
+        for (auto & x: sharedOrderBy.clauses)
+            unbound.merge(x.first->getUnbound());
+        if (when.when)
+            unbound.merge(when.when->getUnbound());
+
+        if (!unbound.tables.empty() || !unbound.wildcards.empty())
+            restrictColumns = false;
+        for (auto & f: unbound.funcs) {
+            if (f.first != "rowName" && f.first != "rowHash"
+                && f.first != "rowPath")
+                restrictColumns = false;
+        }
+        if (restrictColumns) {
+            neededColumns.reserve(unbound.vars.size());
+            for (auto & v: unbound.vars)
+                neededColumns.push_back(v.first);
+        }
+
         bool orderByRowHash = false;
         bool outputInParallel = false /*newOrderBy.clauses.empty()*/;
         if (newOrderBy.clauses.size() == 1
@@ -1020,7 +1770,9 @@ BoundSelectQuery(const SelectExpression & select,
                                                  std::move(boundSelect),
                                                  std::move(boundCalc),
                                                  std::move(newOrderBy),
-                                                 numBuckets));
+                                                 numBuckets,
+                                                 std::move(neededColumns),
+                                                 restrictColumns));
         }
 
     } JML_CATCH_ALL {
@@ -1068,6 +1820,46 @@ execute(std::function<bool (NamedRowValue & output,
 
     ExcAssert(processor);
 
+    engineStatsAdd(engineStats().queriesExecuted);
+
+    QueryLaneScheduler::Admission admission;
+
+    // When the query is being profiled, count the rows the executor
+    // hands back and report the chosen strategy with them
+    if (executor->explain) {
+        std::atomic<uint64_t> rowsOut(0);
+        auto countedProcessor = [&, processor]
+            (NamedRowValue & output,
+             std::vector<ExpressionValue> & calcd,
+             int bucketNum)
+            {
+                rowsOut.fetch_add(1, std::memory_order_relaxed);
+                return processor(output, calcd, bucketNum);
+            };
+
+        try {
+            executor->execute(countedProcessor, processInParallel,
+                              offset, limit, onProgress);
+        } JML_CATCH_ALL {
+            rethrowHttpException(-1, "Execution error: "
+                                 + ML::getExceptionString(),
+                                 "select", select.surface,
+                                 "from", from.getStatus(),
+                                 "where", where.shallowCopy(),
+                                 "calc", calc,
+                                 "orderBy", orderBy,
+                                 "offset", offset,
+                                 "limit", limit);
+        }
+
+        ExecutionExplain::Operator op;
+        op.name = executor->name();
+        op.rowsIn = executor->rowsIn.load(std::memory_order_relaxed);
+        op.rowsOut = rowsOut.load(std::memory_order_relaxed);
+        executor->explain->record(std::move(op));
+        return;
+    }
+
     try {
         executor->execute(processor, processInParallel, offset, limit, onProgress);
     } JML_CATCH_ALL {
@@ -1206,14 +1998,17 @@ struct GroupContext: public SqlExpressionDatasetScope {
             int aggIndex = outputAgg.size();
             OutputAggregator boundagg(argCounter,
                                       args.size(),
-                                      aggFn);
-            outputAgg.emplace_back(boundagg);              
+                                      aggFn,
+                                      functionName);
+            outputAgg.emplace_back(boundagg);
 
             argCounter += args.size();
 
             return {[&,aggIndex] (const std::vector<ExpressionValue> & args,
                                   const SqlRowScope & context)
                     {
+                        if (!precomputed.empty())
+                            return precomputed[aggIndex];
                         return outputAgg[aggIndex]
                             .aggregate.extract(aggData[aggIndex].get());
                     },
@@ -1314,9 +2109,11 @@ struct GroupContext: public SqlExpressionDatasetScope {
     struct OutputAggregator {
         /// Initialize from an aggregator function
         OutputAggregator(int inputIndex, int numInputs,
-                         BoundAggregator aggregate)
+                         BoundAggregator aggregate,
+                         Utf8String functionName)
             :  inputIndex(inputIndex), numInputs(numInputs),
-               aggregate(std::move(aggregate))
+               aggregate(std::move(aggregate)),
+               functionName(std::move(functionName))
         {
         }
 
@@ -1324,6 +2121,7 @@ struct GroupContext: public SqlExpressionDatasetScope {
         int inputIndex;               ///< First column number we get the input from
         int numInputs;                ///< Number of inputs we get
         BoundAggregator aggregate;    ///< Aggregate function, for aggregates
+        Utf8String functionName;      ///< Name it was bound under, eg "sum"
     };
 
     void initializePerThreadAggregators(GroupMapValue& mapInstance)
@@ -1355,14 +2153,149 @@ struct GroupContext: public SqlExpressionDatasetScope {
     }
              
 
-    std::vector<OutputAggregator> outputAgg;    
+    std::vector<OutputAggregator> outputAgg;
     std::vector<std::shared_ptr<void> > aggData;  //working buffers for the above
+
+    /// Results computed by the columnar fast path, one per entry in
+    /// outputAgg.  When non-empty the aggregators return these directly
+    /// instead of extracting from aggData.
+    std::vector<ExpressionValue> precomputed;
+
     int argCounter;
     int argOffset;
     bool evaluateEmptyGroups;
 };
 
 
+/*****************************************************************************/
+/* GROUP BY SPILL                                                            */
+/*****************************************************************************/
+
+/// Number of in-memory groups a GROUP BY may build before further rows
+/// spill to disk.  0 disables spilling.
+static ML::Env_Option<size_t> GROUP_BY_SPILL_GROUPS
+    ("MLDB_GROUP_BY_SPILL_GROUPS", 10000000);
+
+/** Grace-partitioned spill for huge-cardinality GROUP BY.  Once the
+    in-memory group tables reach their budget, rows for groups we don't
+    already hold are hash-partitioned on their group key into
+    lz4-compressed temporary files, one per partition.  After the scan,
+    each partition is replayed and aggregated on its own, so the extra
+    memory needed at any moment is one partition's worth of groups
+    rather than all of them.
+
+    Rows are spilled as one JSON line per row (each calc value as an
+    atom plus its timestamp); rows carrying non-atomic values can't be
+    encoded and stay in memory instead, which keeps the result correct
+    at the cost of the budget for those rows.
+*/
+struct GroupBySpill {
+
+    static constexpr size_t NUM_PARTITIONS = 64;
+
+    GroupBySpill(const std::string & tmpDir)
+    {
+        static std::atomic<uint64_t> spillNumber(0);
+        uint64_t n = spillNumber.fetch_add(1);
+
+        for (size_t i = 0;  i < NUM_PARTITIONS;  ++i) {
+            partitions[i].filename
+                = ML::format("%s/mldb-groupby-spill-%d-%llu-%zd.jsonl.lz4",
+                             tmpDir.c_str(), (int)getpid(),
+                             (unsigned long long)n, i);
+        }
+    }
+
+    ~GroupBySpill()
+    {
+        for (auto & p: partitions) {
+            p.stream.reset();
+            ::unlink(p.filename.c_str());
+        }
+    }
+
+    static uint64_t hashOfKey(const std::vector<ExpressionValue> & key)
+    {
+        uint64_t h = 0;
+        for (auto & v: key)
+            h = h * 1000000007ULL + v.hash();
+        return h;
+    }
+
+    static size_t partitionOfKey(const std::vector<ExpressionValue> & key)
+    {
+        return hashOfKey(key) % NUM_PARTITIONS;
+    }
+
+    /** Append the row to its partition's spill file.  Returns false
+        when a value can't be encoded (it's not an atom), in which case
+        the caller keeps the row in memory.
+    */
+    bool spillRow(const std::vector<ExpressionValue> & rowKey,
+                  const std::vector<ExpressionValue> & calc)
+    {
+        Json::Value encoded(Json::arrayValue);
+        for (auto & v: calc) {
+            if (!v.empty() && !v.isAtom())
+                return false;
+            Json::Value entry(Json::arrayValue);
+            entry.append(jsonEncode(v.getAtom()));
+            entry.append(v.getEffectiveTimestamp().secondsSinceEpoch());
+            encoded.append(std::move(entry));
+        }
+
+        std::string line = encoded.toStringNoNewLine();
+
+        Partition & p = partitions[partitionOfKey(rowKey)];
+        std::unique_lock<std::mutex> guard(p.lock);
+        if (!p.stream)
+            p.stream.reset(new filter_ostream(p.filename));
+        *p.stream << line << '\n';
+        ++p.numRows;
+
+        return true;
+    }
+
+    /** Read the given partition's rows back, calling onRow with the
+        decoded calc vector for each.  Closes the partition's writer
+        first; call only once all spilling is done.
+    */
+    void replay(size_t partition,
+                const std::function<void (std::vector<ExpressionValue> &)>
+                    & onRow)
+    {
+        Partition & p = partitions[partition];
+        p.stream.reset();
+        if (p.numRows == 0)
+            return;
+
+        filter_istream stream(p.filename);
+        std::string line;
+        std::vector<ExpressionValue> calc;
+        while (getline(stream, line)) {
+            Json::Value encoded = Json::parse(line);
+            calc.clear();
+            calc.reserve(encoded.size());
+            for (const Json::Value & entry: encoded) {
+                calc.emplace_back
+                    (jsonDecode<CellValue>(entry[0]),
+                     Date::fromSecondsSinceEpoch(entry[1].asDouble()));
+            }
+            onRow(calc);
+        }
+    }
+
+    struct Partition {
+        std::mutex lock;
+        std::unique_ptr<filter_ostream> stream;
+        std::string filename;
+        uint64_t numRows = 0;
+    };
+
+    Partition partitions[NUM_PARTITIONS];
+};
+
+
 /*****************************************************************************/
 /* BOUND GROUP BY QUERY                                                      */
 /*****************************************************************************/
@@ -1409,7 +2342,14 @@ BoundGroupByQuery(const SelectExpression & select,
     // Bind the row name expression
     boundRowName = rowName.bind(*groupContext);
 
-    size_t maxNumRow = from.getMatrixView()->getRowCount();
+    // Estimate how many rows will actually flow into the aggregation,
+    // so that a selective WHERE doesn't spread a handful of matching
+    // rows over the maximum number of buckets.
+    size_t maxNumRow = from.getRowCountEstimate();
+    double selectivity = from.estimateWhereSelectivity(where);
+    if (selectivity >= 0)
+        maxNumRow = std::max<size_t>(maxNumRow * selectivity, 1);
+
     int maxNumTask = numCpus() * TASK_PER_THREAD;
     //try to have at least MIN_ROW_PER_TASK rows per task
     numBuckets = maxNumRow <= maxNumTask*MIN_ROW_PER_TASK? maxNumRow / maxNumTask : maxNumTask;
@@ -1430,6 +2370,8 @@ execute(RowProcessor processor,
 {
     //STACK_PROFILE(BoundGroupByQuery);
 
+    QueryLaneScheduler::Admission admission;
+
     typedef std::tuple<std::vector<ExpressionValue>,
                        NamedRowValue,
                        std::vector<ExpressionValue> >
@@ -1442,6 +2384,16 @@ execute(RowProcessor processor,
     typedef std::map<RowKey, GroupMapValue> GroupByMapType;
     std::vector<GroupByMapType> accum(numBuckets);
 
+    // Grace-partitioned spill state (see GroupBySpill above).  The
+    // group budget counts groups across all buckets; once it is hit,
+    // rows for groups we don't already hold spill to disk and are
+    // aggregated one partition at a time after the scan.
+    size_t spillGroupBudget = GROUP_BY_SPILL_GROUPS.get();
+    std::atomic<size_t> groupsInMemory(0);
+    std::atomic<bool> spilling(false);
+    std::unique_ptr<GroupBySpill> spill;
+    std::mutex spillInitLock;
+
     //bind the selectexpression, this will create the bound aggregators (which we wont use, ah!)
     auto boundSelect = select.bind(*groupContext);
 
@@ -1465,57 +2417,391 @@ execute(RowProcessor processor,
        GroupByMapType & map = accum[groupNum];
        RowKey rowKey(calc.begin(), calc.begin() + groupBy.clauses.size());
 
+       if (spilling.load()) {
+           // Over budget: keep aggregating the groups this bucket
+           // already holds, spill rows for any other group
+           auto it = map.find(rowKey);
+           if (it != map.end()) {
+               groupContext->aggregateRow(it->second, calc);
+               return true;
+           }
+           if (spill->spillRow(rowKey, calc))
+               return true;
+           // Not encodable; fall through and hold it in memory
+       }
+
        auto pair = map.insert({rowKey, GroupMapValue()});
        auto & iter = pair.first;
        if (pair.second)
        {
           //initialize aggregator data
           groupContext->initializePerThreadAggregators(iter->second);
+
+          if (spillGroupBudget != 0
+              && groupsInMemory.fetch_add(1) + 1 >= spillGroupBudget
+              && !spilling.load()) {
+              std::unique_lock<std::mutex> guard(spillInitLock);
+              if (!spill) {
+                  std::string tmpDir = from.server->getCacheDirectory();
+                  if (tmpDir.empty())
+                      tmpDir = "/tmp";
+                  spill.reset(new GroupBySpill(tmpDir));
+                  spilling = true;
+              }
+          }
        }
 
        groupContext->aggregateRow(iter->second, calc);
 
        return true;
-    };  
-            
-    subSelect->execute(onRow, true /*processInParallel*/, 0, -1, onProgress);
-  
-    //merge the maps in fixed order
-    GroupByMapType destMap;
-    std::vector<GroupByMapType>& threads = accum;
-    if (threads.size() > 0)
+    };
+
+    // Columnar aggregation fast path.  With no GROUP BY and no row
+    // filtering, simple aggregates over direct column references reduce
+    // to a single pass over each column's values, which we can make
+    // directly from the column index in parallel chunks instead of
+    // materializing every row through the select pipeline.  Returns
+    // false whenever the query or the data make it inapplicable; the
+    // row-by-row path below stays the reference implementation.
+    QueryLane lane = QueryLaneScheduler::currentLane();
+
+    auto tryColumnarAggregation = [&] () -> bool
     {
-//        STACK_PROFILE(MergingBuckets);
-        for (auto & srcMap : threads)
-        {
-            for (auto it = srcMap.begin(); it != srcMap.end(); ++it)
-            {
-                auto pair = destMap.insert({it->first, GroupMapValue()});
-                auto destiter = pair.first;
-                if (pair.second)
-                {
-                    //initialize aggregator data
-                    groupContext->initializePerThreadAggregators(destiter->second);
+        enum Op { SUM, AVG, MIN, MAX, COUNT };
+
+        std::vector<Op> ops;
+        std::vector<ColumnName> columns;
+
+        for (auto & agg: groupContext->outputAgg) {
+            Op op;
+            if (agg.functionName == "sum"
+                || agg.functionName == "vertical_sum")
+                op = SUM;
+            else if (agg.functionName == "avg"
+                     || agg.functionName == "vertical_avg")
+                op = AVG;
+            else if (agg.functionName == "min"
+                     || agg.functionName == "vertical_min")
+                op = MIN;
+            else if (agg.functionName == "max"
+                     || agg.functionName == "vertical_max")
+                op = MAX;
+            else if (agg.functionName == "count"
+                     || agg.functionName == "vertical_count")
+                op = COUNT;
+            else return false;
+
+            if (agg.numInputs != 1)
+                return false;
+
+            auto variable = std::dynamic_pointer_cast<ReadColumnExpression>
+                (calc.at(groupContext->argOffset + agg.inputIndex));
+            if (!variable)
+                return false;
+
+            ColumnName columnName = variable->columnName;
+            if (!groupContext->alias.empty()
+                && columnName[0] == groupContext->alias)
+                columnName = columnName.removePrefix();
+
+            ops.push_back(op);
+            columns.push_back(std::move(columnName));
+        }
+
+        auto columnIndex = from.getColumnIndex();
+        size_t numRows = from.getMatrixView()->getRowCount();
+
+        // Reduce each distinct column once, even when several
+        // aggregators refer to it
+        std::map<ColumnName, size_t> columnNumbers;
+        std::vector<ColumnName> uniqueColumns;
+        for (auto & c: columns) {
+            if (columnNumbers.insert({c, uniqueColumns.size()}).second)
+                uniqueColumns.push_back(c);
+        }
+
+        struct Reduction {
+            uint64_t nonNull = 0;          ///< Number of non-null cells
+            double total = 0.0;            ///< Sum of the numeric values
+            bool hasValue = false;         ///< Saw at least one non-null cell
+            CellValue minValue, maxValue;  ///< Extremal values
+            Date minTs = Date::negativeInfinity();    ///< Timestamp of minValue
+            Date maxTs = Date::negativeInfinity();    ///< Timestamp of maxValue
+            Date latestTs = Date::negativeInfinity(); ///< Latest cell timestamp
+        };
+
+        std::vector<Reduction> reductions(uniqueColumns.size());
+
+        try {
+            for (size_t n = 0;  n < uniqueColumns.size();  ++n) {
+                const ColumnName & columnName = uniqueColumns[n];
+
+                // An unknown column aggregates like an all-null one
+                if (numRows == 0 || !columnIndex->knownColumn(columnName))
+                    continue;
+
+                MatrixColumn column = columnIndex->getColumn(columnName);
+                const auto & cells = column.rows;
+
+                // The row-by-row path sees at most one (latest) value
+                // per row.  If any row has several values for this
+                // column we punt back to it rather than re-implement
+                // that filtering here.
+                ML::Lightweight_Hash_Set<uint64_t> seen;
+                for (auto & c: cells) {
+                    if (!seen.insert(RowHash(std::get<0>(c)).hash()).second)
+                        return false;
                 }
 
-                groupContext->mergeThreadMap(destiter->second, it->second);
+                bool needSum = false, needMinMax = false;
+                for (size_t i = 0;  i < ops.size();  ++i) {
+                    if (columns[i] != columnName)
+                        continue;
+                    needSum = needSum || ops[i] == SUM || ops[i] == AVG;
+                    needMinMax = needMinMax || ops[i] == MIN || ops[i] == MAX;
+                }
+
+                Reduction & red = reductions[n];
+                std::mutex reductionLock;
+
+                auto reduceChunk = [&] (size_t first, size_t last)
+                {
+                    QueryLaneScheduler::instance().yieldAtChunkBoundary(lane);
+
+                    Reduction part;
+                    std::vector<double> doubles;
+                    if (needSum)
+                        doubles.reserve(last - first);
+
+                    for (size_t i = first;  i < last;  ++i) {
+                        const CellValue & v = std::get<1>(cells[i]);
+                        if (v.empty())
+                            continue;
+                        Date ts = std::get<2>(cells[i]);
+                        ++part.nonNull;
+                        part.latestTs.setMax(ts);
+                        if (needSum)
+                            doubles.push_back(v.toDouble());
+                        if (needMinMax) {
+                            if (!part.hasValue) {
+                                part.minValue = part.maxValue = v;
+                                part.minTs = part.maxTs = ts;
+                                part.hasValue = true;
+                            }
+                            else {
+                                if (v < part.minValue) {
+                                    part.minValue = v;
+                                    part.minTs = ts;
+                                }
+                                if (part.maxValue < v) {
+                                    part.maxValue = v;
+                                    part.maxTs = ts;
+                                }
+                            }
+                        }
+                    }
+
+                    if (needSum)
+                        part.total = ML::SIMD::vec_sum(doubles.data(),
+                                                       doubles.size());
+
+                    std::unique_lock<std::mutex> guard(reductionLock);
+                    red.nonNull += part.nonNull;
+                    red.total += part.total;
+                    red.latestTs.setMax(part.latestTs);
+                    if (part.hasValue) {
+                        if (!red.hasValue) {
+                            red.minValue = std::move(part.minValue);
+                            red.maxValue = std::move(part.maxValue);
+                            red.minTs = part.minTs;
+                            red.maxTs = part.maxTs;
+                            red.hasValue = true;
+                        }
+                        else {
+                            if (part.minValue < red.minValue) {
+                                red.minValue = std::move(part.minValue);
+                                red.minTs = part.minTs;
+                            }
+                            if (red.maxValue < part.maxValue) {
+                                red.maxValue = std::move(part.maxValue);
+                                red.maxTs = part.maxTs;
+                            }
+                        }
+                    }
+                };
+
+                if (cells.size() < MIN_ROW_PER_TASK)
+                    reduceChunk(0, cells.size());
+                else
+                    parallelMapChunked(0, cells.size(), 65536, reduceChunk);
             }
+        } JML_CATCH_ALL {
+            // Eg a sum over a string column; re-run through the
+            // row-by-row path so that it fails (or not) exactly as it
+            // always did.
+            return false;
         }
+
+        groupContext->precomputed.clear();
+        groupContext->precomputed.reserve(ops.size());
+
+        for (size_t i = 0;  i < ops.size();  ++i) {
+            const Reduction & red = reductions[columnNumbers[columns[i]]];
+            switch (ops[i]) {
+            case SUM:
+                groupContext->precomputed
+                    .emplace_back(red.total, red.latestTs);
+                break;
+            case AVG:
+                groupContext->precomputed
+                    .emplace_back(red.total / (double)red.nonNull,
+                                  red.latestTs);
+                break;
+            case MIN:
+                groupContext->precomputed
+                    .emplace_back(red.minValue, red.minTs);
+                break;
+            case MAX:
+                groupContext->precomputed
+                    .emplace_back(red.maxValue, red.maxTs);
+                break;
+            case COUNT:
+                groupContext->precomputed
+                    .emplace_back(red.nonNull, red.latestTs);
+                break;
+            }
+        }
+
+        // The single group (with its empty key) still goes through the
+        // normal output code below; an empty dataset is handled by the
+        // evaluateEmptyGroups logic exactly as for the row-by-row path.
+        if (numRows != 0) {
+            auto pair = accum[0].emplace(RowKey(), GroupMapValue());
+            groupContext->initializePerThreadAggregators(pair.first->second);
+        }
+
+        return true;
+    };
+
+    bool columnarDone = false;
+
+    if (groupBy.clauses.empty()
+        && where.isConstantTrue()
+        && (!when.when || when.when->isConstantTrue())
+        && having.isConstantTrue()
+        && boundOrderBy.empty())
+    {
+        columnarDone = tryColumnarAggregation();
     }
 
-    if (destMap.empty() && groupContext->evaluateEmptyGroups
+    if (!columnarDone) {
+        groupContext->precomputed.clear();
+        subSelect->execute(onRow, true /*processInParallel*/, 0, -1, onProgress);
+    }
+
+    bool spilled = spilling.load();
+
+    //merge the maps; with many buckets and groups we hash-partition the
+    //groups over the cores so that each destination partition can be
+    //merged independently without locking.  When rows spilled to disk
+    //the partitioning must line up with the spill partitions, so that
+    //each spill file merges into exactly one destination map
+    size_t numPartitions = 1;
+    if (spilled)
+        numPartitions = GroupBySpill::NUM_PARTITIONS;
+    else if (accum.size() > 1) {
+        size_t totalEntries = 0;
+        for (auto & srcMap: accum)
+            totalEntries += srcMap.size();
+        if (totalEntries >= numCpus() * MIN_ROW_PER_TASK)
+            numPartitions = std::min<size_t>(numCpus(), accum.size());
+    }
+
+    auto partitionOfKey = [&] (const RowKey & key) -> size_t
+        {
+            if (spilled)
+                return GroupBySpill::partitionOfKey(key);
+            uint64_t h = 0;
+            for (auto & v: key)
+                h = h * 1000000007ULL + v.hash();
+            return h % numPartitions;
+        };
+
+    std::vector<GroupByMapType> destMaps(numPartitions);
+
+    auto mergePartition = [&] (size_t partition)
+        {
+//            STACK_PROFILE(MergingBuckets);
+            GroupByMapType & destMap = destMaps[partition];
+            for (auto & srcMap : accum)
+            {
+                for (auto it = srcMap.begin(); it != srcMap.end(); ++it)
+                {
+                    if (numPartitions > 1
+                        && partitionOfKey(it->first) != partition)
+                        continue;
+
+                    auto pair = destMap.insert({it->first, GroupMapValue()});
+                    auto destiter = pair.first;
+                    if (pair.second)
+                    {
+                        //initialize aggregator data
+                        groupContext->initializePerThreadAggregators(destiter->second);
+                    }
+
+                    groupContext->mergeThreadMap(destiter->second, it->second);
+                }
+            }
+        };
+
+    if (numPartitions == 1)
+        mergePartition(0);
+    else parallelMap(0, numPartitions, mergePartition);
+
+    // The merged partitions now hold every group; the per-thread source
+    // maps are dead weight, so free them before output rows start to
+    // accumulate rather than keeping a second copy of every group key
+    // and aggregate state alive through the sort
+    std::vector<GroupByMapType>().swap(accum);
+
+    bool noGroups
+        = std::all_of(destMaps.begin(), destMaps.end(),
+                      [] (const GroupByMapType & m) { return m.empty(); });
+
+    if (noGroups && groupContext->evaluateEmptyGroups
         && groupBy.clauses.empty())
     {
-        auto pair = destMap.emplace(RowKey(), GroupMapValue());
+        auto pair = destMaps[0].emplace(RowKey(), GroupMapValue());
         groupContext->initializePerThreadAggregators(pair.first->second);
     }
 
     //output rows
-    //each entry in the final map should be an output row for us   
-    for (auto it = destMap.begin(); it != destMap.end(); ++it)
+
+    // Compare two rows according to the sort criteria
+    auto compareRows = [&] (const SortedRow & row1,
+                            const SortedRow & row2)
+        {
+            return boundOrderBy.less(std::get<0>(row1),
+                                     std::get<0>(row2));
+        };
+
+    ExcAssertGreaterEqual(offset, 0);
+
+    // With both an ORDER BY and a limit only the first offset + limit
+    // sorted rows can ever be emitted, so that is all we keep:
+    // rowsSorted is maintained as a max-heap of that size and groups
+    // that sort after its worst retained row are dropped as they are
+    // produced instead of being materialized for the sort
+    ssize_t sortKeep = (boundOrderBy.empty() || limit == -1)
+        ? -1
+        : offset + limit;
+
+    // Evaluate having / row name / select for one group and emit or
+    // queue it; returns false once the limit is reached
+    auto outputGroup = [&] (const RowKey & rowKey,
+                            const GroupMapValue & groupData) -> bool
     {
-        RowKey rowKey = it->first;
-        groupContext->aggData = it->second;
+        groupContext->aggData = groupData;
 
          // Create the context to evaluate the row name and order by
         NamedRowValue outputRow;
@@ -1526,10 +2812,10 @@ execute(RowProcessor processor,
         ExpressionValue havingResult = boundHaving(rowContext, GET_LATEST);
 
         if (!havingResult.isTrue())
-            continue;
+            return true;
 
         outputRow.rowName = boundRowName(rowContext, GET_LATEST).coerceToPath();
-        outputRow.rowHash = outputRow.rowName;        
+        outputRow.rowHash = outputRow.rowName;
 
         //Evaluating the whole bound select expression
         ExpressionValue result = boundSelect(rowContext, GET_ALL);
@@ -1539,7 +2825,7 @@ execute(RowProcessor processor,
         if (boundOrderBy.empty()) {
             ssize_t n = groupsDone.fetch_add(1);
             if (limit != -1 && n >= limit)
-               break;
+               return false;
 
             processor(outputRow);
         }
@@ -1550,25 +2836,111 @@ execute(RowProcessor processor,
             = boundOrderBy.apply(rowContext);
 
             std::vector<ExpressionValue> calcd;
-                
-            rowsSorted.emplace_back(std::move(sortFields),
-                                    std::move(outputRow),
-                                    std::move(calcd));
-        }           
+
+            SortedRow row(std::move(sortFields),
+                          std::move(outputRow),
+                          std::move(calcd));
+
+            if (sortKeep == -1
+                || rowsSorted.size() < (size_t)sortKeep) {
+                rowsSorted.emplace_back(std::move(row));
+                if (sortKeep != -1)
+                    std::push_heap(rowsSorted.begin(), rowsSorted.end(),
+                                   compareRows);
+            }
+            else if (!rowsSorted.empty()
+                     && compareRows(row, rowsSorted.front())) {
+                // Sorts before the worst row we kept; displace it
+                std::pop_heap(rowsSorted.begin(), rowsSorted.end(),
+                              compareRows);
+                rowsSorted.back() = std::move(row);
+                std::push_heap(rowsSorted.begin(), rowsSorted.end(),
+                               compareRows);
+            }
+        }
+        return true;
+    };
+
+    if (!spilled) {
+        //each entry in the final maps should be an output row for us.  Each
+        //partition map is sorted on the group key, so we walk them with a
+        //k-way merge to keep the same output order as a single map would give
+        std::vector<GroupByMapType::iterator> partIters;
+        for (auto & m: destMaps)
+            partIters.push_back(m.begin());
+
+        for (;;)
+        {
+            int minPartition = -1;
+            for (unsigned p = 0;  p < destMaps.size();  ++p)
+            {
+                if (partIters[p] == destMaps[p].end())
+                    continue;
+                if (minPartition == -1
+                    || partIters[p]->first < partIters[minPartition]->first)
+                    minPartition = p;
+            }
+
+            if (minPartition == -1)
+                break;
+
+            auto it = partIters[minPartition]++;
+
+            bool keepGoing = outputGroup(it->first, it->second);
+
+            // The group's output row is built; release its key and
+            // aggregate state now instead of holding every group
+            // alive until the sort finishes
+            destMaps[minPartition].erase(it);
+
+            if (!keepGoing)
+                break;
+        }
+    }
+    else {
+        // One partition at a time: replay the partition's spilled rows
+        // into its destination map (which already holds the in-memory
+        // groups that hash there), output its groups, then free it.
+        // Group keys are ordered within a partition but not across
+        // partitions; without an ORDER BY the output order is
+        // unspecified anyway.
+        bool limitReached = false;
+
+        for (size_t p = 0;
+             p < GroupBySpill::NUM_PARTITIONS && !limitReached;  ++p) {
+            GroupByMapType & map = destMaps[p];
+
+            spill->replay(p, [&] (std::vector<ExpressionValue> & calc)
+                {
+                    RowKey rowKey(calc.begin(),
+                                  calc.begin() + groupBy.clauses.size());
+                    auto pair = map.insert({std::move(rowKey),
+                                            GroupMapValue()});
+                    if (pair.second)
+                        groupContext->initializePerThreadAggregators
+                            (pair.first->second);
+                    groupContext->aggregateRow(pair.first->second, calc);
+                });
+
+            for (auto it = map.begin();  it != map.end();
+                 /* no increment */) {
+                bool keepGoing = outputGroup(it->first, it->second);
+                it = map.erase(it);
+                if (!keepGoing) {
+                    limitReached = true;
+                    break;
+                }
+            }
+
+            GroupByMapType().swap(map);
+        }
     }
 
     if (boundOrderBy.empty())
         return;
 
-    // Compare two rows according to the sort criteria
-    auto compareRows = [&] (const SortedRow & row1,
-                            const SortedRow & row2)
-        {
-            return boundOrderBy.less(std::get<0>(row1),
-                                     std::get<0>(row2));
-        };
-
-    // Sort our output rows
+    // Sort our output rows (a final sort of the heap-ordered rows is
+    // still needed when a limit capped them)
     std::sort(rowsSorted.begin(), rowsSorted.end(), compareRows);
 
     auto doSelect = [&] (int rowNum) -> bool
@@ -1583,8 +2955,6 @@ execute(RowProcessor processor,
     if (limit == -1)
         limit = rowsSorted.size();
 
-    ExcAssertGreaterEqual(offset, 0);
-
     ssize_t begin = std::min<ssize_t>(offset, rowsSorted.size());
     ssize_t end = std::min<ssize_t>(offset + limit, rowsSorted.size());
 
@@ -9,6 +9,11 @@
 
 #include "sql/sql_expression.h"
 #include "server/analytics.h"
+#include "mldb/arch/perf_counters.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 
 namespace Datacratic {
@@ -69,6 +74,159 @@ struct QueryThreadTracker {
 };
 
 
+/*****************************************************************************/
+/* QUERY LANE SCHEDULER                                                      */
+/*****************************************************************************/
+
+/** Queries run in one of two lanes: interactive (the default, latency
+    sensitive) or batch (long running scans).  The lane is selected per
+    request and carried as a per-thread property set by a LaneGuard at
+    the request boundary.
+*/
+enum QueryLane {
+    LANE_INTERACTIVE = 0,   ///< Latency sensitive; always admitted
+    LANE_BATCH = 1          ///< Throughput work; limited concurrency
+};
+
+/** Arbitrates between the two lanes.  Batch queries are admitted up to
+    a concurrency limit (MLDB_MAX_BATCH_QUERIES, default 2), and their
+    workers yield at chunk boundaries while interactive queries are in
+    flight, so a monster scan can't inflate interactive tail latency.
+    Interactive queries are never made to wait.
+*/
+struct QueryLaneScheduler {
+
+    static QueryLaneScheduler & instance();
+
+    /// Lane that queries started by the calling thread run in
+    static QueryLane currentLane();
+
+    /// RAII object that sets the calling thread's lane
+    struct LaneGuard {
+        LaneGuard(QueryLane lane);
+        ~LaneGuard();
+
+        LaneGuard(const LaneGuard &) = delete;
+        void operator = (const LaneGuard &) = delete;
+
+    private:
+        int saved;
+    };
+
+    /// RAII admission of one running query into its lane.  Batch
+    /// queries block here while the batch lane is at its concurrency
+    /// limit; nested queries on the same thread are not counted twice.
+    struct Admission {
+        Admission();
+        ~Admission();
+
+        Admission(const Admission &) = delete;
+        void operator = (const Admission &) = delete;
+
+    private:
+        QueryLane lane;
+        bool counted;
+    };
+
+    /** Called by batch workers between chunks of work.  Blocks while
+        any interactive query is running, so that batch work is
+        preempted at chunk boundaries rather than cancelled.  A no-op
+        when lane is not LANE_BATCH.
+    */
+    void yieldAtChunkBoundary(QueryLane lane);
+
+private:
+    QueryLaneScheduler();
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    int runningBatch;
+    int maxRunningBatch;
+    std::atomic<int> runningInteractive;
+
+    static __thread int currentLane_;
+};
+
+
+/*****************************************************************************/
+/* QUERY BATCH SIZE OVERRIDE                                                 */
+/*****************************************************************************/
+
+/** Parallel scans size their batches adaptively from the measured wall
+    time of the first batches (see AdaptiveBatcher in bound_queries.cc).
+    This RAII object pins the batch size to a fixed number of rows for
+    queries started by the calling thread, for when the caller knows
+    better; it is set at the request boundary from the batchSize query
+    parameter.  Zero or negative means adaptive.
+*/
+struct QueryBatchSizeOverride {
+    QueryBatchSizeOverride(ssize_t rows);
+    ~QueryBatchSizeOverride();
+
+    /// Batch size pinned for this thread, or <= 0 when adaptive
+    static ssize_t current();
+
+    QueryBatchSizeOverride(const QueryBatchSizeOverride &) = delete;
+    void operator = (const QueryBatchSizeOverride &) = delete;
+
+private:
+    ssize_t saved;
+};
+
+
+/*****************************************************************************/
+/* QUERY PERF COUNTERS                                                       */
+/*****************************************************************************/
+
+/** Hardware counter totals for the phases of one query's execution,
+    from perf_counters.h.  Wall time says a phase is slow; LLC misses
+    and IPC per phase say whether that is compute or memory bound, which
+    is what decides between column representations.
+
+    Filled in only when the request asked for a profile (and counters
+    are available), so the executors pay one thread local read per phase
+    when nobody is looking.  Scans nest inside the phase that runs them:
+    columnScan work done while generating rows is also counted in
+    whereScan.
+*/
+struct QueryPerfCounters {
+    ML::PerfCounterAccumulator whereScan;   ///< Generating matching rows
+    ML::PerfCounterAccumulator process;     ///< Select and calc evaluation
+    ML::PerfCounterAccumulator sort;        ///< Order by sort, merge, output
+    ML::PerfCounterAccumulator columnScan;  ///< Frozen column scan loops
+
+    /// How many AND conjuncts the WHERE filter decided to evaluate in
+    /// the cheaper order rather than the written one (see the
+    /// PredicateReorderCounter channel in sql_expression.h)
+    std::atomic<uint64_t> predicatesReordered{0};
+
+    /// Counters for the query the calling thread is executing, or
+    /// nullptr when no profile was asked for
+    static QueryPerfCounters * current();
+
+    /// current()->columnScan, or nullptr; for the scan loop call sites
+    static ML::PerfCounterAccumulator * columnScanAccumulator();
+
+    /** RAII object that points current() at the given counters.  Set at
+        the request boundary, and again by each executor worker so that
+        work on pool threads attributes to the right query.  A null
+        pointer is allowed and simply clears current().  Also wires the
+        SQL layer's predicate reorder counter up to predicatesReordered.
+    */
+    struct Guard {
+        Guard(QueryPerfCounters * counters);
+        ~Guard();
+
+        Guard(const Guard &) = delete;
+        void operator = (const Guard &) = delete;
+
+    private:
+        QueryPerfCounters * saved;
+        PredicateReorderCounter::Guard reorderGuard;
+    };
+};
+
+
 /*****************************************************************************/
 /* BOUND SELECT QUERY                                                        */
 /*****************************************************************************/
@@ -84,6 +242,10 @@ struct BoundSelectQuery {
     const OrderByExpression & orderBy;
     std::shared_ptr<SqlExpressionDatasetScope> context;
 
+    /// Constant-folded copy of the where clause, when folding applied;
+    /// kept alive here since the row generator binds against it
+    std::shared_ptr<SqlExpression> foldedWhere;
+
     /** Note on the ordering of rows
      *  Users are expecting determinist results (e.g. repeated queries
      *  should return rows in the same order).  When creating this object
@@ -16,6 +16,11 @@
 
 #include <algorithm>
 #include <unordered_map>
+#include <sys/mman.h>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
 
 namespace Datacratic {
 namespace MLDB {
@@ -30,6 +35,34 @@ makeSharedArray(size_t len)
                               [] (T * p) { delete[] p; });
 }
 
+/* Allocate the bit-packed bucket storage.  Large lists (tree training
+   over millions of rows) are backed by an anonymous mapping with
+   transparent hugepages requested, so that the index walks of split
+   evaluation don't thrash the TLB; small lists stay on the heap. */
+static std::shared_ptr<uint64_t>
+allocateBucketStorage(size_t numWords)
+{
+    static constexpr size_t HUGE_PAGE_THRESHOLD = 2 * 1024 * 1024;
+
+    size_t numBytes = numWords * sizeof(uint64_t);
+
+    if (numBytes >= HUGE_PAGE_THRESHOLD) {
+        void * mem = mmap(nullptr, numBytes, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(mem, numBytes, MADV_HUGEPAGE);
+#endif
+            return std::shared_ptr<uint64_t>
+                ((uint64_t *)mem,
+                 [=] (uint64_t *) { munmap(mem, numBytes); });
+        }
+        // Fall through to the heap if the mapping failed
+    }
+
+    return makeSharedArray<uint64_t>(numWords);
+}
+
 }
 
 /*****************************************************************************/
@@ -60,7 +93,7 @@ init(size_t numElements, uint32_t numBuckets)
     //     << " buckets" << endl;
 
     size_t numWords = (entryBits * numElements + 63) / 64;
-    auto writableStorage = makeSharedArray<uint64_t>(numWords);
+    auto writableStorage = allocateBucketStorage(numWords);
     this->current = writableStorage.get();
     this->storage = writableStorage;
     this->bitsWritten = 0;
@@ -68,6 +101,43 @@ init(size_t numElements, uint32_t numBuckets)
     this->numWritten = 0;
 }
 
+void
+WritableBucketList::
+writeBatch(const uint32_t * vals, size_t n)
+{
+    if (entryBits == 0) {
+        // Single bucket; nothing is stored
+        numWritten += n;
+        return;
+    }
+
+    // init() rounds entryBits so that it evenly divides 64
+    size_t perWord = 64 / entryBits;
+
+    // Finish the partially written word so we're word aligned
+    while (n > 0 && bitsWritten != 0) {
+        write(*vals++);
+        --n;
+    }
+
+    // Pack whole words at a time
+    uint64_t * out = current;
+    while (n >= perWord) {
+        uint64_t word = 0;
+        for (size_t i = 0;  i < perWord;  ++i)
+            word |= uint64_t(vals[i]) << (i * entryBits);
+        *out++ = word;
+        vals += perWord;
+        n -= perWord;
+        numWritten += perWord;
+    }
+    current = out;
+
+    // Leftover partial word
+    for (size_t i = 0;  i < n;  ++i)
+        write(vals[i]);
+}
+
 
 /*****************************************************************************/
 /* BUCKET DESCRIPTIONS                                                       */
@@ -115,6 +185,60 @@ getBucket(double val) const
         - splits.begin() + offset;
 }
 
+void
+NumericValues::
+getBuckets(const double * vals, size_t n, uint32_t * out) const
+{
+    if (!active)
+        throw HttpReturnException(500, "Attempt to get bucket from non-numeric value");
+
+    const double * data = splits.data();
+    size_t numSplits = splits.size();
+
+    if (numSplits == 0) {
+        std::fill(out, out + n, offset);
+        return;
+    }
+
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // Four values at a time.  The binary search over the splits advances
+    // all four lanes in lockstep, one level per iteration, with the lane
+    // bases updated branchlessly from the comparison masks.
+    for (;  i + 4 <= n;  i += 4) {
+        __m128d v01 = _mm_loadu_pd(vals + i);
+        __m128d v23 = _mm_loadu_pd(vals + i + 2);
+
+        size_t base0 = 0, base1 = 0, base2 = 0, base3 = 0;
+        size_t len = numSplits;
+
+        while (len > 1) {
+            size_t half = len / 2;
+            __m128d p01 = _mm_set_pd(data[base1 + half - 1],
+                                     data[base0 + half - 1]);
+            __m128d p23 = _mm_set_pd(data[base3 + half - 1],
+                                     data[base2 + half - 1]);
+            int m01 = _mm_movemask_pd(_mm_cmplt_pd(p01, v01));
+            int m23 = _mm_movemask_pd(_mm_cmplt_pd(p23, v23));
+            base0 += (m01 & 1) * half;
+            base1 += ((m01 >> 1) & 1) * half;
+            base2 += (m23 & 1) * half;
+            base3 += ((m23 >> 1) & 1) * half;
+            len -= half;
+        }
+
+        out[i + 0] = base0 + (data[base0] < vals[i + 0]) + offset;
+        out[i + 1] = base1 + (data[base1] < vals[i + 1]) + offset;
+        out[i + 2] = base2 + (data[base2] < vals[i + 2]) + offset;
+        out[i + 3] = base3 + (data[base3] < vals[i + 3]) + offset;
+    }
+#endif
+
+    for (;  i < n;  ++i)
+        out[i] = getBucket(vals[i]);
+}
+
 uint32_t
 OrdinalValues::
 getBucket(const CellValue & val) const
@@ -43,6 +43,43 @@ struct BucketList {
     size_t numEntries;
 };
 
+/** Forward cursor over a BucketList for monotonically increasing
+    indexes, which is the access pattern of tree training (example
+    numbers only ever increase within a node's row list).  The current
+    storage word is kept decoded and the walk prefetches ahead, so each
+    word is loaded once per scan instead of once per entry, and the
+    loads are in flight before they are needed.
+*/
+struct BucketListCursor {
+
+    BucketListCursor(const BucketList & buckets)
+        : data(buckets.storage.get()),
+          entryBits(buckets.entryBits),
+          mask((1ULL << entryBits) - 1),
+          curWord(-1),
+          word(0)
+    {
+    }
+
+    /** Get entry i.  Successive calls must pass non-decreasing i. */
+    inline uint32_t operator () (size_t i)
+    {
+        size_t wordNum = (i * entryBits) >> 6;
+        if (wordNum != curWord) {
+            word = data[wordNum];
+            curWord = wordNum;
+            __builtin_prefetch(data + wordNum + 8, 0 /* read */, 3);
+        }
+        return (word >> ((i * entryBits) & 63)) & mask;
+    }
+
+    const uint64_t * data;
+    size_t entryBits;
+    uint64_t mask;
+    size_t curWord;
+    uint64_t word;
+};
+
 /** Writable version of the above.  OK to slice. */
 struct WritableBucketList: public BucketList {
     WritableBucketList()
@@ -58,6 +95,12 @@ struct WritableBucketList: public BucketList {
 
     void init(size_t numElements, uint32_t numBuckets);
 
+    /** Append a batch of bucket indexes.  Equivalent to calling write()
+        on each value in turn, but packs a whole 64 bit word at a time
+        once the write position is word aligned.
+    */
+    void writeBatch(const uint32_t * vals, size_t n);
+
     inline void write(uint64_t value)
     {
         //ExcAssertLess(value, numBuckets);
@@ -94,6 +137,12 @@ struct NumericValues {
 
     uint32_t getBucket(double val) const;
 
+    /** Bucket assignment for a batch of values.  Same result as calling
+        getBucket() on each value, but runs the binary search over the
+        splits branchlessly and several values at a time.
+    */
+    void getBuckets(const double * vals, size_t n, uint32_t * out) const;
+
 };
 
 struct OrdinalValues {
@@ -81,16 +81,58 @@ struct ColumnScope: public SqlExpressionMldbScope {
         return SqlBindingScope::doGetFunction(tableName, functionName, args, argScope);
     }
 
+    /** Materialize the dense columns required by the expressions bound
+        so far, in requiredColumns order.  This is the inputs argument
+        that RowEvaluator and run() work from. */
     std::vector<std::vector<CellValue> >
-    run(const std::vector<BoundSqlExpression> & exprs) const
+    materializeInputs() const
     {
-        size_t numRows = dataset->getMatrixView()->getRowCount();
-
         std::vector<std::vector<CellValue> > inputs(requiredColumns.size());
         for (size_t i = 0;  i < inputs.size();  ++i) {
             inputs[i] = dataset->getColumnIndex()
                 ->getColumnDense(requiredColumns[i]);
         }
+        return inputs;
+    }
+
+    /** Reentrant evaluation state for one thread.  The row scope and
+        the per-expression output storage are constructed once and
+        re-pointed at each row, so an extraction loop that keeps one of
+        these per thread evaluates rows without allocating in steady
+        state. */
+    struct RowEvaluator {
+        RowEvaluator(const std::vector<BoundSqlExpression> & exprs,
+                     const std::vector<std::vector<CellValue> > & inputs)
+            : exprs(exprs), rowScope(0, inputs), storage(exprs.size())
+        {
+        }
+
+        /** Evaluate every expression on the given row, writing one atom
+            per expression into out, which must hold exprs.size()
+            values. */
+        void evaluateRow(size_t rowIndex, CellValue * out)
+        {
+            rowScope.rowIndex = rowIndex;
+            for (unsigned j = 0;  j < exprs.size();  ++j) {
+                const ExpressionValue & result
+                    = exprs[j](rowScope, storage[j], GET_LATEST);
+
+                // Currently, only atoms are supported as results
+                out[j] = result.getAtom();
+            }
+        }
+
+        const std::vector<BoundSqlExpression> & exprs;
+        RowScope rowScope;
+        std::vector<ExpressionValue> storage;
+    };
+
+    std::vector<std::vector<CellValue> >
+    run(const std::vector<BoundSqlExpression> & exprs) const
+    {
+        size_t numRows = dataset->getMatrixView()->getRowCount();
+
+        std::vector<std::vector<CellValue> > inputs = materializeInputs();
 
         std::vector<std::vector<CellValue> > results(exprs.size());
         for (auto & r: results)
@@ -99,24 +141,118 @@ struct ColumnScope: public SqlExpressionMldbScope {
         // Apply the expression to everything
         auto doRow = [&] (size_t first, size_t last)
             {
+                RowEvaluator eval(exprs, inputs);
+                std::vector<CellValue> rowOut(exprs.size());
                 for (size_t i = first;  i < last;  ++i) {
-                    RowScope scope(i, inputs);
-                    for (unsigned j = 0;  j < exprs.size();  ++j) {
-                        ExpressionValue storage;
-                        const ExpressionValue & result
-                            = exprs[j](scope, storage, GET_LATEST);
-                
-                        // Currently, only atoms are supported as results
-                        results[j][i] = result.getAtom();
-                    }
+                    eval.evaluateRow(i, rowOut.data());
+                    for (unsigned j = 0;  j < exprs.size();  ++j)
+                        results[j][i] = std::move(rowOut[j]);
                 }
             };
-        
+
         parallelMapChunked(0, numRows, 1024 /* rows at once */,
                            doRow);
 
         return std::move(results);
     }
+
+    /** Layout of the buffer filled in by extractDense. */
+    enum BlockLayout {
+        ROW_MAJOR,     ///< buffer[row * numColumns + column]
+        COLUMN_MAJOR   ///< buffer[column * numRows + row]
+    };
+
+    /** Fill a caller-provided float buffer with the values of the
+        required columns over the row range [firstRow, lastRow).  The
+        buffer must hold (lastRow - firstRow) * requiredColumns.size()
+        floats.  Empty cells and cells that can't convert to a number
+        come out as NaN.
+
+        Each column is converted in parallel over blocks of rows,
+        straight into its place in the output, so training code can hand
+        the buffer to the classifier or kmeans cores without building a
+        CellValue matrix and transposing it row by row. */
+    void extractDense(size_t firstRow, size_t lastRow,
+                      float * output, BlockLayout layout) const
+    {
+        ExcAssert(firstRow <= lastRow);
+
+        size_t numRows = lastRow - firstRow;
+        size_t numCols = requiredColumns.size();
+
+        auto index = dataset->getColumnIndex();
+
+        auto getColumn = [&] (size_t j)
+            {
+                std::vector<CellValue> vals
+                    = index->getColumnDense(requiredColumns[j]);
+                if (vals.size() < lastRow)
+                    throw HttpReturnException
+                        (500, "Column '" + requiredColumns[j].toUtf8String()
+                         + "' too short for dense extraction");
+                return vals;
+            };
+
+        auto toFloat = [] (const CellValue & v) -> float
+            {
+                return v.isNumber()
+                    ? v.toDouble()
+                    : std::numeric_limits<float>::quiet_NaN();
+            };
+
+        if (layout == COLUMN_MAJOR) {
+            // One column at a time, straight into its contiguous slice
+            // of the output; no more than a single column's cells are
+            // ever materialized
+            for (size_t j = 0;  j < numCols;  ++j) {
+                std::vector<CellValue> vals = getColumn(j);
+                float * out = output + j * numRows;
+
+                auto doBlock = [&] (size_t first, size_t last)
+                    {
+                        for (size_t i = first;  i < last;  ++i)
+                            out[i] = toFloat(vals[firstRow + i]);
+                    };
+
+                parallelMapChunked(0, numRows, 65536 /* rows at once */,
+                                   doBlock);
+            }
+        }
+        else {
+            // ROW_MAJOR is a transpose of how the columns are stored, so
+            // writing one column at a time would stride over the whole
+            // output per row.  Instead a tile of columns is converted to
+            // contiguous float buffers, then scattered blockwise: each
+            // row of a tile writes one short contiguous run, and the
+            // tile's read streams stay prefetchable.
+            constexpr size_t TILE_COLS = 16;
+
+            std::vector<std::vector<CellValue> > tileVals(TILE_COLS);
+
+            for (size_t j0 = 0;  j0 < numCols;  j0 += TILE_COLS) {
+                size_t j1 = std::min(numCols, j0 + TILE_COLS);
+
+                for (size_t j = j0;  j < j1;  ++j)
+                    tileVals[j - j0] = getColumn(j);
+
+                auto doBlock = [&] (size_t first, size_t last)
+                    {
+                        for (size_t i = first;  i < last;  ++i) {
+                            float * out = output + i * numCols + j0;
+                            for (size_t j = j0;  j < j1;  ++j)
+                                out[j - j0]
+                                    = toFloat(tileVals[j - j0][firstRow + i]);
+                        }
+                    };
+
+                parallelMapChunked(0, numRows, 65536 /* rows at once */,
+                                   doBlock);
+
+                for (size_t j = j0;  j < j1;  ++j)
+                    tileVals[j - j0].clear();
+            }
+        }
+    }
 };
 
 }
@@ -8,11 +8,13 @@
 
 */
 #include "mldb/server/dataset_collection.h"
+#include "mldb/server/binary_row_batch.h"
 #include "mldb/rest/poly_collection_impl.h"
 #include "mldb/server/mldb_server.h"
 #include "mldb/jml/utils/string_functions.h"
 #include "mldb/rest/rest_request_binding.h"
 #include "mldb/jml/utils/lightweight_hash.h"
+#include "mldb/jml/utils/environment.h"
 #include "mldb/sql/sql_expression.h"
 #include "mldb/types/map_description.h"
 #include "mldb/types/vector_description.h"
@@ -66,16 +68,48 @@ registerDatasetType(const Package & package,
                                            docRoute, customRoute, config, registryFlags);
 }
 
+namespace {
+
+/** Encode a query response body.  Same output as jsonEncodeStr, but the
+    buffer is reserved up front from the size of the last response
+    serialized on this thread, so multi-megabyte results don't pay a
+    copy for every geometric regrowth of the string.
+*/
+template<typename T>
+std::string jsonEncodeQueryResult(const T & obj)
+{
+    static thread_local size_t lastSize = 0;
+
+    static auto desc = getDefaultDescriptionSharedT<T>();
+    std::string result;
+    result.reserve(std::max<size_t>(116, lastSize + lastSize / 4));
+    StringJsonPrintingContext context(result);
+    desc->printJson(&obj, context);
+    lastSize = result.size();
+    return result;
+}
+
+} // file scope
+
 void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
                   RestConnection & connection,
                   const std::string & format,
                   bool createHeaders,
                   bool rowNames,
                   bool rowHashes,
-                  bool sortColumns)
+                  bool sortColumns,
+                  const std::function<RestParams ()> & getExtraHeaders)
 {
     std::vector<MatrixNamedRow> sparseOutput = runQuery();
 
+    auto sendResult = [&] (std::string body)
+        {
+            connection.sendHttpResponse(200, std::move(body),
+                                        "application/json",
+                                        getExtraHeaders ? getExtraHeaders()
+                                                        : RestParams());
+        };
+
     if (sortColumns) {
         for (auto & r: sparseOutput) {
             std::sort(r.columns.begin(), r.columns.end());
@@ -83,8 +117,7 @@ void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
     }
 
     if (format == "full" || format == "") {
-        connection.sendResponse(200, jsonEncodeStr(sparseOutput),
-                                "application/json");
+        sendResult(jsonEncodeQueryResult(sparseOutput));
     }
     else if (format == "sparse") {
         std::vector<std::vector<std::pair<ColumnName, CellValue> > > output;
@@ -109,8 +142,7 @@ void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
             output.emplace_back(std::move(rowOut));
         }
 
-        connection.sendResponse(200, jsonEncodeStr(output),
-                                "application/json");
+        sendResult(jsonEncodeQueryResult(output));
     }
     else if (format == "soa") {
         // Structure of arrays; one array per column
@@ -133,8 +165,7 @@ void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
                 vals[i] = val;
             }
         }
-        connection.sendResponse(200, jsonEncodeStr(output),
-                                "application/json");
+        sendResult(jsonEncodeQueryResult(output));
     }
     else if (format == "aos") {
         // Array of structures; one structure per row
@@ -156,8 +187,7 @@ void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
 
             output.emplace_back(std::move(row));
         }
-        connection.sendResponse(200, jsonEncodeStr(output),
-                                "application/json");
+        sendResult(jsonEncodeQueryResult(output));
     }
     else if (format == "table") {
         // TODO: the SQL knows what columns could be created... this could
@@ -247,14 +277,265 @@ void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
             output.push_back(rowOut);
         }
 
-        connection.sendResponse(200, jsonEncodeStr(output),
-                                "application/json");
+        sendResult(jsonEncodeQueryResult(output));
+    }
+    else if (format == "binary") {
+        /* Columnar binary encoding, for bulk transfer to clients that
+           want typed arrays rather than JSON.  Layout (little-endian):
+
+           header:
+             8 bytes   magic "MLDBBIN1"
+             uint32    number of rows
+             uint32    number of columns (including _rowName/_rowHash)
+
+           per column:
+             uint32 + bytes   column name, UTF-8
+             uint8            cell type: 1 = float64, 2 = UTF-8 string,
+                              3 = timestamp (float64 seconds since epoch)
+             bitmap           ceil(rows / 8) bytes; bit (i & 7) of byte
+                              (i >> 3) is set iff row i has a value
+             values           packed values for only the rows that have
+                              one: float64 and timestamp are 8 bytes
+                              each, strings are uint32 length + bytes
+
+           A column is float64 if every present cell is numeric and
+           timestamp if every present cell is a timestamp; anything else
+           falls back to the string representation of its cells, so a
+           decoder only ever branches per column, not per cell.
+        */
+
+        // First, find all columns, like the table format does
+        std::vector<ColumnName> columns;
+        ML::Lightweight_Hash<ColumnHash, int> columnIndex;
+        for (auto & o: sparseOutput) {
+            for (auto & c: o.columns) {
+                auto & columnName = std::get<0>(c);
+                if (columnIndex.insert({columnName, columns.size()}).second) {
+                    columns.push_back(columnName);
+                }
+            }
+        }
+
+        if (sortColumns) {
+            std::sort(columns.begin(), columns.end());
+            for (size_t i = 0;  i < columns.size();  ++i) {
+                columnIndex[columns[i]] = i;
+            }
+        }
+
+        size_t numRows = sparseOutput.size();
+
+        // Transpose the rows into columns of cell pointers; null means
+        // the row has no value for the column
+        std::vector<std::vector<const CellValue *> >
+            byColumn(columns.size(),
+                     std::vector<const CellValue *>(numRows, nullptr));
+
+        for (size_t i = 0;  i < numRows;  ++i) {
+            for (auto & c: sparseOutput[i].columns) {
+                byColumn[columnIndex[std::get<0>(c)]][i] = &std::get<1>(c);
+            }
+        }
+
+        std::string out;
+        auto append = [&] (const void * p, size_t n)
+            {
+                out.append((const char *)p, n);
+            };
+        auto appendU32 = [&] (uint32_t v) { append(&v, sizeof(v)); };
+        auto appendU8 = [&] (uint8_t v) { append(&v, sizeof(v)); };
+        auto appendF64 = [&] (double v) { append(&v, sizeof(v)); };
+        auto appendStr = [&] (const std::string & s)
+            {
+                appendU32(s.size());
+                append(s.data(), s.size());
+            };
+
+        out.append("MLDBBIN1");
+        appendU32(numRows);
+        appendU32(columns.size() + rowNames + rowHashes);
+
+        // String column where every row has a value (_rowName, _rowHash)
+        auto appendDenseStringColumn
+            = [&] (const std::string & name,
+                   const std::function<std::string (size_t)> & getValue)
+            {
+                appendStr(name);
+                appendU8(2);
+                std::string bitmap((numRows + 7) / 8, 0);
+                for (size_t i = 0;  i < numRows;  ++i)
+                    bitmap[i >> 3] |= (1 << (i & 7));
+                append(bitmap.data(), bitmap.size());
+                for (size_t i = 0;  i < numRows;  ++i)
+                    appendStr(getValue(i));
+            };
+
+        if (rowNames)
+            appendDenseStringColumn("_rowName", [&] (size_t i)
+                {
+                    return sparseOutput[i].rowName.toUtf8String().rawString();
+                });
+        if (rowHashes)
+            appendDenseStringColumn("_rowHash", [&] (size_t i)
+                {
+                    return sparseOutput[i].rowHash.toString();
+                });
+
+        for (size_t col = 0;  col < columns.size();  ++col) {
+            auto & cells = byColumn[col];
+
+            appendStr(columns[col].toUtf8String().rawString());
+
+            bool allNumbers = true;
+            bool allTimestamps = true;
+            for (auto & c: cells) {
+                if (!c || c->empty())
+                    continue;
+                allNumbers = allNumbers && c->isNumber();
+                allTimestamps = allTimestamps && c->isTimestamp();
+            }
+
+            uint8_t type = allNumbers ? 1 : allTimestamps ? 3 : 2;
+            appendU8(type);
+
+            std::string bitmap((numRows + 7) / 8, 0);
+            for (size_t i = 0;  i < numRows;  ++i)
+                if (cells[i] && !cells[i]->empty())
+                    bitmap[i >> 3] |= (1 << (i & 7));
+            append(bitmap.data(), bitmap.size());
+
+            for (size_t i = 0;  i < numRows;  ++i) {
+                if (!cells[i] || cells[i]->empty())
+                    continue;
+                switch (type) {
+                case 1:
+                    appendF64(cells[i]->toDouble());
+                    break;
+                case 3:
+                    appendF64(cells[i]->toTimestamp().secondsSinceEpoch());
+                    break;
+                default:
+                    appendStr(cells[i]->coerceToString()
+                              .toUtf8String().rawString());
+                }
+            }
+        }
+
+        connection.sendHttpResponse(200, std::move(out),
+                                    "application/octet-stream",
+                                    getExtraHeaders ? getExtraHeaders()
+                                                    : RestParams());
     }
     else {
         connection.sendErrorResponse(400, "Unknown output format '" + format + "'");
     }
 }
 
+void streamHttpQuery(std::function<void (std::function<bool (MatrixNamedRow & row)> onRow)> runQuery,
+                     RestConnection & connection,
+                     const std::string & format,
+                     bool rowNames,
+                     bool rowHashes,
+                     bool sortColumns)
+{
+    if (format != "full" && format != "" && format != "sparse"
+        && format != "aos") {
+        connection.sendErrorResponse
+            (400, "Output format '" + format + "' cannot be streamed; "
+             "use full, sparse or aos");
+        return;
+    }
+
+    // Rows are batched up into chunks of roughly this size, so that we
+    // don't pay for one HTTP chunk per row
+    static constexpr size_t CHUNK_SIZE = 65536;
+
+    std::string chunk;
+    chunk.reserve(2 * CHUNK_SIZE);
+    chunk += "[";
+    bool firstRow = true;
+
+    // Rows are printed straight into the chunk buffer, rather than
+    // through a temporary string per row.  The context only holds a
+    // reference, so it stays valid across flushes.
+    StringJsonPrintingContext chunkContext(chunk);
+
+    static auto fullRowDesc
+        = getDefaultDescriptionSharedT<MatrixNamedRow>();
+    static auto sparseRowDesc
+        = getDefaultDescriptionSharedT
+            <std::vector<std::pair<ColumnName, CellValue> > >();
+    static auto aosRowDesc
+        = getDefaultDescriptionSharedT<std::map<ColumnName, CellValue> >();
+
+    connection.sendHttpResponseHeader(200, "application/json",
+                                      RestConnection::CHUNKED_ENCODING);
+
+    auto flush = [&] ()
+        {
+            if (!chunk.empty()) {
+                connection.sendPayload(std::move(chunk));
+                chunk.clear();
+            }
+        };
+
+    auto onRow = [&] (MatrixNamedRow & row)
+        {
+            if (sortColumns)
+                std::sort(row.columns.begin(), row.columns.end());
+
+            if (!firstRow)
+                chunk += ",";
+            firstRow = false;
+
+            if (format == "full" || format == "") {
+                fullRowDesc->printJson(&row, chunkContext);
+            }
+            else if (format == "sparse") {
+                std::vector<std::pair<ColumnName, CellValue> > rowOut;
+                rowOut.reserve(row.columns.size() + rowNames + rowHashes);
+
+                if (rowNames)
+                    rowOut.emplace_back(ColumnName("_rowName"), row.rowName.toUtf8String());
+                if (rowHashes)
+                    rowOut.emplace_back(ColumnName("_rowHash"), row.rowHash.toString());
+
+                for (auto & c: row.columns) {
+                    rowOut.emplace_back(std::get<0>(c), std::get<1>(c));
+                }
+
+                std::sort(rowOut.begin() + rowNames + rowHashes, rowOut.end());
+
+                sparseRowDesc->printJson(&rowOut, chunkContext);
+            }
+            else {  // aos
+                std::map<ColumnName, CellValue> rowOut;
+
+                if (rowNames)
+                    rowOut[ColumnName("_rowName")] = row.rowName.toUtf8String();
+                if (rowHashes)
+                    rowOut[ColumnName("_rowHash")] = row.rowHash.toString();
+
+                for (auto & c: row.columns) {
+                    rowOut[std::get<0>(c)] = std::get<1>(c);
+                }
+
+                aosRowDesc->printJson(&rowOut, chunkContext);
+            }
+
+            if (chunk.size() >= CHUNK_SIZE)
+                flush();
+
+            return connection.isConnected();
+        };
+
+    runQuery(onRow);
+
+    chunk += "]";
+    flush();
+    connection.finishResponse();
+}
+
 
 /*****************************************************************************/
 /* DATASET COLLECTION                                                         */
@@ -262,7 +543,8 @@ void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
 
 DatasetCollection::
 DatasetCollection(MldbServer * server)
-    : PolyCollection<Dataset>(L"dataset", L"datasets", server)
+    : PolyCollection<Dataset>(L"dataset", L"datasets", server),
+      lastBudgetCheck(Date::negativeInfinity())
 {
 }
 
@@ -273,6 +555,215 @@ getEntityStatus(const Dataset & dataset) const
     return dataset.getStatus();
 }
 
+/** Memory budget for loaded datasets, in megabytes.  When exceeded,
+    the least recently accessed datasets that can be reloaded from a
+    persisted artifact are unloaded.  0 (the default) keeps every
+    dataset resident forever.
+*/
+static ML::Env_Option<int> DATASET_MEMORY_BUDGET_MB
+    ("MLDB_DATASET_MEMORY_BUDGET_MB", 0);
+
+/* A dataset may only be unloaded if its next access can reload it,
+   which practically means its configuration points at a persisted
+   artifact. */
+static bool reloadableFromArtifact(const PolyConfig & config)
+{
+    if (config.params.empty())
+        return false;
+    Json::Value params = config.params.asJson();
+    return params.isObject()
+        && !params.get("dataFileUrl", "").asString().empty();
+}
+
+std::shared_ptr<Dataset>
+DatasetCollection::
+obtainDataset(const Utf8String & name)
+{
+    // A group commit in flight publishes all of its datasets before a
+    // new query resolves any one of them
+    {
+        std::unique_lock<std::mutex> guard(groupCommitMutex);
+        while (committingDatasets.count(name))
+            groupCommitDone.wait(guard);
+    }
+
+    bool budgeted = DATASET_MEMORY_BUDGET_MB.get() > 0;
+
+    if (budgeted) {
+        std::unique_lock<std::mutex> guard(lruMutex);
+        lastAccess[name] = Date::now();
+    }
+
+    auto dataset = tryGetExistingEntity(name);
+
+    if (!dataset) {
+        // Was it unloaded by the memory budget?  If so, reload it
+        // from its kept configuration.
+        PolyConfig config;
+        bool unloaded = false;
+        {
+            std::unique_lock<std::mutex> guard(lruMutex);
+            auto it = unloadedDatasets.find(name);
+            if (it != unloadedDatasets.end()) {
+                config = it->second;
+                unloaded = true;
+            }
+        }
+
+        if (!unloaded)
+            return getExistingEntity(name);  // throws not found
+
+        auto onProgress = [] (const Json::Value &) { return true; };
+        dataset = obtainEntitySync(config, onProgress);
+
+        std::unique_lock<std::mutex> guard(lruMutex);
+        unloadedDatasets.erase(name);
+    }
+
+    // Budget enforcement scans every dataset's memory usage, so
+    // throttle it rather than running it on each access
+    if (budgeted) {
+        Date now = Date::now();
+        bool check = false;
+        {
+            std::unique_lock<std::mutex> guard(lruMutex);
+            if (now.secondsSince(lastBudgetCheck) > 10.0) {
+                lastBudgetCheck = now;
+                check = true;
+            }
+        }
+        if (check)
+            enforceMemoryBudget();
+    }
+
+    return dataset;
+}
+
+void
+DatasetCollection::
+commitGroup(const std::vector<Utf8String> & names)
+{
+    if (names.empty())
+        throw HttpReturnException(400, "Group commit needs at least one "
+                                  "dataset name");
+
+    // Resolve every dataset before closing the gate, so that an unknown
+    // name fails with the gate never having closed
+    std::vector<std::shared_ptr<Dataset> > datasets;
+    datasets.reserve(names.size());
+    for (auto & name: names)
+        datasets.push_back(obtainDataset(name));
+
+    {
+        std::unique_lock<std::mutex> guard(groupCommitMutex);
+        for (size_t i = 0;  i < names.size();  ++i) {
+            if (!committingDatasets.insert(names[i]).second) {
+                // Back out and refuse, rather than deadlock on the
+                // overlapping group
+                for (size_t j = 0;  j < i;  ++j)
+                    committingDatasets.erase(names[j]);
+                groupCommitDone.notify_all();
+                throw HttpReturnException
+                    (409, "Dataset named twice in a group commit, or part "
+                     "of another group commit still in flight",
+                     "dataset", names[i]);
+            }
+        }
+    }
+
+    auto openGate = [&] ()
+        {
+            std::unique_lock<std::mutex> guard(groupCommitMutex);
+            for (auto & name: names)
+                committingDatasets.erase(name);
+            groupCommitDone.notify_all();
+        };
+
+    try {
+        for (auto & dataset: datasets)
+            dataset->commit();
+    } catch (...) {
+        openGate();
+        throw;
+    }
+
+    openGate();
+}
+
+void
+DatasetCollection::
+enforceMemoryBudget()
+{
+    int64_t budgetMb = DATASET_MEMORY_BUDGET_MB.get();
+    if (budgetMb <= 0)
+        return;
+    uint64_t budgetBytes = (uint64_t)budgetMb * 1000000;
+
+    struct Candidate {
+        Utf8String name;
+        uint64_t bytes;
+        Date lastAccessed;
+    };
+
+    std::vector<Candidate> candidates;
+    uint64_t totalBytes = 0;
+
+    auto onEntry = [&] (Utf8String key, const PolyEntity & entity)
+        {
+            auto dataset = dynamic_cast<const Dataset *>(&entity);
+            if (!dataset)
+                return true;
+
+            uint64_t bytes = dataset->getMemoryUsage().totalBytes;
+            totalBytes += bytes;
+
+            if (bytes > 0
+                && dataset->config_
+                && reloadableFromArtifact(*dataset->config_)) {
+                Date accessed = Date::negativeInfinity();
+                {
+                    std::unique_lock<std::mutex> guard(lruMutex);
+                    auto it = lastAccess.find(key);
+                    if (it != lastAccess.end())
+                        accessed = it->second;
+                }
+                candidates.push_back({ std::move(key), bytes, accessed });
+            }
+
+            return true;
+        };
+    forEachEntry(onEntry);
+
+    if (totalBytes <= budgetBytes)
+        return;
+
+    // Least recently accessed first
+    std::sort(candidates.begin(), candidates.end(),
+              [] (const Candidate & c1, const Candidate & c2)
+              {
+                  return c1.lastAccessed < c2.lastAccessed;
+              });
+
+    for (auto & c: candidates) {
+        if (totalBytes <= budgetBytes)
+            break;
+
+        auto entity = tryGetExistingEntity(c.name);
+        if (!entity || !entity->config_)
+            continue;
+
+        // Keep the configuration so the next access can reload; only
+        // then forget the entity.  Queries holding a shared_ptr keep
+        // using the old object until they finish.
+        {
+            std::unique_lock<std::mutex> guard(lruMutex);
+            unloadedDatasets[c.name] = *entity->config_;
+        }
+        deleteEntry(c.name);
+        totalBytes -= c.bytes;
+    }
+}
+
 template<typename T>
 T getParam(const RestRequest & req, const std::string & name, T defValue)
 {
@@ -370,6 +861,12 @@ initRoutes(RouteManager & manager)
                            &Dataset::getTimestampRange,
                            getDataset);
 
+    addRouteSyncJsonReturn(*manager.valueNode, "/memusage", { "GET" },
+                           "Return the memory held by the dataset",
+                           "Total and per-column byte counts",
+                           &Dataset::getMemoryUsage,
+                           getDataset);
+
     //auto & matrix
     //    = manager.valueNode->addSubRouter("/matrix", "Operations on dataset as matrix");
 
@@ -426,6 +923,50 @@ initRoutes(RouteManager & manager)
                  JsonParam<std::vector<std::tuple<ColumnName, CellValue, Date> > >
                  ("columns", "[ column name, value, date ] tuples to record"));
 
+    // Binary batch recording; the payload is the compact row batch
+    // format documented in binary_row_batch.h, so it can't go through
+    // the JSON helpers.
+    RestRequestRouter::OnProcessRequest recordRowsBinary
+        = [=] (RestConnection & connection,
+               const RestRequest & req,
+               const RestRequestParsingContext & cxt)
+        {
+            try {
+                JML_TRACE_EXCEPTIONS(false);
+
+                auto dataset = std::static_pointer_cast<Dataset>
+                    (cxt.getSharedPtrAs<PolyEntity>(2));
+
+                auto decoded = decodeBinaryRowBatch(req.payload.data(),
+                                                    req.payload.size());
+                dataset->recordRows(decoded);
+
+                connection.sendHttpResponse(200, "", "", {});
+
+                return RestRequestRouter::MR_YES;
+            } catch (const std::exception & exc) {
+                connection.sendResponse(400, exc.what(), "text/plain");
+                return RestRequestRouter::MR_YES;
+            }
+        };
+
+    Json::Value binaryHelp;
+    binaryHelp["payload"]
+        = "Binary row batch, in the format documented in binary_row_batch.h";
+    rows.addRoute("/binary", { "POST" },
+                  "Record a binary batch of rows into the dataset",
+                  recordRowsBinary, binaryHelp);
+
+    addRouteSyncJsonReturn(rows, "/bulk", { "POST" },
+                           "Fetch many rows by name in one call",
+                           "Array of rows in the same order as the request; "
+                           "rows that don't exist come back with their name "
+                           "and no columns",
+                           &Dataset::getRows,
+                           getDataset,
+                           JsonParam<std::vector<RowName> >
+                           ("", "Array of row names to fetch"));
+
     addRouteSync(*manager.valueNode, "/multirows", { "POST" },
                  "Record many rows into the dataset",
                  &Dataset::recordRows,
@@ -11,6 +11,10 @@
 
 #include "mldb/core/dataset.h"
 #include "mldb/rest/poly_collection.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
 
 namespace Datacratic {
 
@@ -26,6 +30,11 @@ namespace MLDB {
     - createHeaders: table result formats will include a header row
     - rowNames: add a '_rowName' column
     - rowHashes: add a '_rowHash' column
+
+    If getExtraHeaders is non-null it is called once the response body
+    has been built, just before it is sent, and the headers it returns
+    are added to the response.  The query profiler uses it to attach the
+    timing breakdown once serialization has finished.
 */
 void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
                   RestConnection & connection,
@@ -33,8 +42,26 @@ void runHttpQuery(std::function<std::vector<MatrixNamedRow> ()> runQuery,
                   bool createHeaders,
                   bool rowNames,
                   bool rowHashes,
-                  bool sortColumns);
-                      
+                  bool sortColumns,
+                  const std::function<RestParams ()> & getExtraHeaders
+                      = nullptr);
+
+/** Run a query and stream the results back over HTTP with chunked
+    transfer encoding, serializing each row as the query produces it
+    instead of materializing the whole result set first.
+
+    The runQuery function is given the callback to pass each row to.
+    Only the row-at-a-time formats (full, sparse, aos) can be streamed;
+    the column-oriented formats need the whole result set to lay out
+    their output and are rejected.
+*/
+void streamHttpQuery(std::function<void (std::function<bool (MatrixNamedRow & row)> onRow)> runQuery,
+                     RestConnection & connection,
+                     const std::string & format,
+                     bool rowNames,
+                     bool rowHashes,
+                     bool sortColumns);
+
 
 /*****************************************************************************/
 /* DATASET COLLECTION                                                        */
@@ -47,6 +74,37 @@ struct DatasetCollection: public PolyCollection<Dataset> {
 
     virtual Any getEntityStatus(const Dataset & dataset) const;
 
+    /** Get the dataset with the given name for query execution,
+        transparently reloading it from its persisted artifact when it
+        was unloaded by the memory budget.  Notes the access for the
+        LRU accounting.  Throws if the dataset doesn't exist.
+    */
+    std::shared_ptr<Dataset> obtainDataset(const Utf8String & name);
+
+    /** Unload idle datasets, least recently accessed first, until the
+        loaded datasets fit within the memory budget given by
+        MLDB_DATASET_MEMORY_BUDGET_MB (0, the default, disables
+        unloading).  Only datasets whose configuration points to a
+        persisted artifact are unloaded, since only those can be
+        reloaded on their next access; datasets whose contents exist
+        only in memory always stay resident.
+    */
+    void enforceMemoryBudget();
+
+    /** Commit a group of datasets as one unit.  A query that starts
+        resolving its datasets after the group commit has started waits
+        until every dataset in the group has committed, so it sees
+        either the whole pre-commit generation or the whole post-commit
+        one, never a mix.  A query already holding its dataset pointers
+        finishes on the objects it resolved.
+
+        The gate only covers the commit calls themselves (which publish
+        the recorded data), not the recording that precedes them, so it
+        is closed for the duration of the version swaps rather than for
+        the length of the refresh.
+    */
+    void commitGroup(const std::vector<Utf8String> & names);
+
     std::vector<std::pair<CellValue, int64_t> >
     getColumnValueCounts(const Dataset * dataset,
                          const ColumnName & columnName,
@@ -71,6 +129,26 @@ struct DatasetCollection: public PolyCollection<Dataset> {
                     bool rowNames,
                     bool rowHashes,
                     bool sortColumns) const;
+
+private:
+    /// Protects the LRU accounting and the unloaded dataset configs
+    mutable std::mutex lruMutex;
+
+    /// When each dataset was last obtained for a query
+    mutable std::map<Utf8String, Date> lastAccess;
+
+    /// Configurations of datasets unloaded by the memory budget, kept
+    /// so that the next access can reload them
+    std::map<Utf8String, PolyConfig> unloadedDatasets;
+
+    /// Budget enforcement is throttled; when it last ran
+    Date lastBudgetCheck;
+
+    /// Names held by an in-flight group commit; obtainDataset blocks on
+    /// them until the whole group has committed
+    mutable std::mutex groupCommitMutex;
+    mutable std::condition_variable groupCommitDone;
+    std::set<Utf8String> committingDatasets;
 };
 
 } // namespace MLDB
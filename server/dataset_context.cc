@@ -7,6 +7,8 @@
 
 #include "mldb/server/dataset_context.h"
 #include "mldb/core/dataset.h"
+#include "mldb/core/value_function.h"
+#include "mldb/types/value_description.h"
 #include "mldb/types/basic_value_descriptions.h"
 #include "mldb/server/mldb_server.h"
 #include "mldb/server/function_collection.h"
@@ -15,12 +17,140 @@
 #include "mldb/jml/utils/lightweight_hash.h"
 #include "mldb/sql/sql_utils.h"
 
+#include <condition_variable>
+#include <mutex>
+
 using namespace std;
 
 
 namespace Datacratic {
 namespace MLDB {
 
+namespace {
+
+/*****************************************************************************/
+/* FUNCTION CALL BATCHER                                                     */
+/*****************************************************************************/
+
+/** Gathers concurrent calls to a function into batches, for functions
+    whose fixed per-call overhead dwarfs the per-row work (see
+    Function::supportsBatchedCalls).
+
+    Query execution runs rows on many worker threads, so under load
+    several calls are usually in flight at once.  Callers deposit their
+    input; whichever caller finds the function idle becomes the leader,
+    takes everything deposited so far and makes a single applyBatch call,
+    then hands each caller back its slot's output.  Each call is still
+    synchronous from its caller's point of view, so no query semantics
+    change; an uncontended call just becomes a batch of one.
+*/
+
+struct FunctionCallBatcher {
+    FunctionCallBatcher(std::shared_ptr<FunctionApplier> applier)
+        : applier(std::move(applier)), busy(false)
+    {
+    }
+
+    ExpressionValue call(ExpressionValue input)
+    {
+        Slot slot;
+        slot.input = std::move(input);
+
+        std::unique_lock<std::mutex> guard(mutex);
+        pending.push_back(&slot);
+
+        while (!slot.done) {
+            if (!busy) {
+                runBatch(guard);  // includes our own slot
+                continue;
+            }
+            cond.wait(guard);
+        }
+
+        if (slot.exc)
+            std::rethrow_exception(slot.exc);
+        return std::move(slot.output);
+    }
+
+private:
+    struct Slot {
+        ExpressionValue input;
+        ExpressionValue output;
+        std::exception_ptr exc;
+        bool done = false;
+    };
+
+    /// Become the leader: take every deposited slot and make one
+    /// applyBatch call for all of them.  Called with the lock held;
+    /// drops it around the function call.
+    void runBatch(std::unique_lock<std::mutex> & guard)
+    {
+        busy = true;
+        std::vector<Slot *> batch = std::move(pending);
+        pending.clear();
+
+        std::vector<ExpressionValue> inputs;
+        inputs.reserve(batch.size());
+        for (Slot * s: batch)
+            inputs.emplace_back(std::move(s->input));
+
+        guard.unlock();
+
+        std::vector<ExpressionValue> outputs;
+        std::exception_ptr exc;
+        try {
+            outputs = applier->applyBatch(inputs);
+            if (outputs.size() != batch.size())
+                throw HttpReturnException
+                    (500, "Batched function returned "
+                     + to_string(outputs.size()) + " outputs for "
+                     + to_string(batch.size()) + " inputs");
+        } catch (...) {
+            exc = std::current_exception();
+        }
+
+        guard.lock();
+
+        for (size_t i = 0;  i < batch.size();  ++i) {
+            if (exc)
+                batch[i]->exc = exc;
+            else batch[i]->output = std::move(outputs[i]);
+            batch[i]->done = true;
+        }
+
+        busy = false;
+        cond.notify_all();
+    }
+
+    std::shared_ptr<FunctionApplier> applier;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool busy;                    ///< a leader is inside the function
+    std::vector<Slot *> pending;  ///< deposited, not yet taken by a leader
+};
+
+
+/*****************************************************************************/
+/* FUNCTION RESULT MEMO                                                      */
+/*****************************************************************************/
+
+/** Per-query result cache for functions that declare themselves
+    deterministic (see Function::isDeterministic).  Keyed on the input
+    value, capped so a high cardinality input can't accumulate the whole
+    result set in memory.
+*/
+
+struct FunctionResultMemo {
+    static constexpr size_t MAX_ENTRIES = 8192;
+
+    std::mutex mutex;
+    std::unordered_map<ExpressionValue, ExpressionValue> entries;
+};
+
+constexpr size_t FunctionResultMemo::MAX_ENTRIES;
+
+} // file scope
+
 
 /*****************************************************************************/
 /* SQL EXPRESSION MLDB SCOPE                                                 */
@@ -69,17 +199,70 @@ doGetFunction(const Utf8String & tableName,
                               .release());
             }
         
-            auto exec = [=] (const std::vector<ExpressionValue> & args,
-                             const SqlRowScope & scope)
-                -> ExpressionValue
-                {
-                    if (args.empty()) {
-                        return applier->apply(ExpressionValue());
-                    }
-                    else {
-                        return applier->apply(args[0]);
-                    }
-                };
+            BoundFunction::Exec exec;
+
+            if (fn->supportsBatchedCalls()) {
+                // Concurrent calls from the query workers are gathered
+                // into one applyBatch call, amortizing the function's
+                // fixed per-call cost over the batch
+                auto batcher = std::make_shared<FunctionCallBatcher>(applier);
+
+                exec = [=] (const std::vector<ExpressionValue> & args,
+                            const SqlRowScope & scope)
+                    -> ExpressionValue
+                    {
+                        return batcher->call(args.empty()
+                                             ? ExpressionValue()
+                                             : args[0]);
+                    };
+            }
+            else {
+                exec = [=] (const std::vector<ExpressionValue> & args,
+                            const SqlRowScope & scope)
+                    -> ExpressionValue
+                    {
+                        if (args.empty()) {
+                            return applier->apply(ExpressionValue());
+                        }
+                        else {
+                            return applier->apply(args[0]);
+                        }
+                    };
+            }
+
+            if (fn->isDeterministic()) {
+                // Deterministic functions get a per-query memo: the same
+                // input always produces the same output, so a column
+                // with heavy value repetition pays for one call per
+                // distinct value.  The memo stops filling at its cap so
+                // that a high cardinality input can't accumulate the
+                // whole result set in memory.
+                auto memo = std::make_shared<FunctionResultMemo>();
+                auto inner = std::move(exec);
+
+                exec = [=] (const std::vector<ExpressionValue> & args,
+                            const SqlRowScope & scope)
+                    -> ExpressionValue
+                    {
+                        static const ExpressionValue noArg;
+                        const ExpressionValue & key
+                            = args.empty() ? noArg : args[0];
+
+                        {
+                            std::unique_lock<std::mutex> guard(memo->mutex);
+                            auto it = memo->entries.find(key);
+                            if (it != memo->entries.end())
+                                return it->second;
+                        }
+
+                        ExpressionValue result = inner(args, scope);
+
+                        std::unique_lock<std::mutex> guard(memo->mutex);
+                        if (memo->entries.size() < FunctionResultMemo::MAX_ENTRIES)
+                            memo->entries.emplace(key, result);
+                        return result;
+                    };
+            }
 
             return BoundFunction(exec, applier->info.output);
         }
@@ -89,18 +272,163 @@ doGetFunction(const Utf8String & tableName,
                                           argScope);
 }
 
+BoundFunction
+SqlExpressionMldbScope::
+doGetFusedFunctionChain(const std::vector<Utf8String> & functionNames,
+                        const std::vector<BoundSqlExpression> & args,
+                        SqlBindingScope & argScope)
+{
+    if (args.size() > 1)
+        return BoundFunction();
+
+    // Every name has to resolve to a user value function; those are the
+    // functions whose apply is a typed call wrapped in ExpressionValue
+    // conversions, so the conversions between chained calls can be
+    // elided.  Outermost first, like functionNames.
+    std::vector<std::shared_ptr<Function> > entities;
+    std::vector<const ValueFunction *> fns;
+
+    for (auto & name: functionNames) {
+        auto fn = mldb->functions->tryGetExistingEntity(name.rawString());
+        if (!fn)
+            return BoundFunction();
+        auto vf = dynamic_cast<const ValueFunction *>(fn.get());
+        if (!vf)
+            return BoundFunction();
+        // Batched functions gather concurrent calls into one; that
+        // machinery trades in ExpressionValues, so they stay on the
+        // normal path
+        if (fn->supportsBatchedCalls())
+            return BoundFunction();
+        entities.emplace_back(std::move(fn));
+        fns.push_back(vf);
+    }
+
+    // Each function's binary output type has to be exactly the type the
+    // next one out consumes for the typed hand-off to be valid
+    for (size_t i = 0;  i + 1 < fns.size();  ++i) {
+        if (*fns[i]->inputDescription->type
+            != *fns[i + 1]->outputDescription->type)
+            return BoundFunction();
+    }
+
+    // Bind each applier: the innermost against the real argument, the
+    // others against the output of the function feeding them.  A
+    // binding failure just means the chain isn't fusable; the caller
+    // then binds the calls separately, which reports any real problem.
+    std::vector<std::shared_ptr<FunctionApplier> > appliers(fns.size());
+    try {
+        JML_TRACE_EXCEPTIONS(false);
+        for (size_t i = 0;  i < fns.size();  ++i) {
+            std::shared_ptr<RowValueInfo> input;
+            if (i == fns.size() - 1) {
+                input = args.empty()
+                    ? std::make_shared<RowValueInfo>(std::vector<KnownColumn>())
+                    : ExpressionValueInfo::toRow(args[0].info);
+            }
+            else {
+                input = ExpressionValueInfo::toRow(fns[i + 1]->outputInfo);
+            }
+            appliers[i].reset(entities[i]->bind(argScope, input).release());
+        }
+    } catch (const std::exception & exc) {
+        return BoundFunction();
+    }
+
+    BoundFunction::Exec exec
+        = [entities, fns, appliers] (const std::vector<ExpressionValue> & args,
+                                     const SqlRowScope & scope)
+        -> ExpressionValue
+        {
+            // Owns one typed value; fused intermediates never become
+            // ExpressionValues
+            struct Typed {
+                std::shared_ptr<const ValueDescription> desc;
+                void * val = nullptr;
+                ~Typed() { if (val) desc->destroy(val); }
+            };
+
+            size_t n = fns.size();
+
+            Typed cur;
+            cur.desc = fns[n - 1]->inputDescription;
+            cur.val = cur.desc->constructDefault();
+            fns[n - 1]->fromInput(cur.val, args.empty()
+                                  ? ExpressionValue() : args[0]);
+
+            // Innermost out, each function consuming its predecessor's
+            // typed output
+            for (size_t i = n;  i > 0;  --i) {
+                Typed out;
+                out.desc = fns[i - 1]->outputDescription;
+                out.val = out.desc->constructDefault();
+                fns[i - 1]->applyTyped(*appliers[i - 1], cur.val, out.val);
+                std::swap(cur.desc, out.desc);
+                std::swap(cur.val, out.val);
+            }
+
+            return fns[0]->toOutput(cur.val);
+        };
+
+    bool deterministic = true;
+    for (auto & e: entities)
+        deterministic = deterministic && e->isDeterministic();
+
+    if (deterministic) {
+        // Same per-query memo as a single deterministic function would
+        // get (keyed on the innermost input), so fusing never loses the
+        // memoization the unfused chain had
+        auto memo = std::make_shared<FunctionResultMemo>();
+        auto inner = std::move(exec);
+
+        exec = [=] (const std::vector<ExpressionValue> & args,
+                    const SqlRowScope & scope)
+            -> ExpressionValue
+            {
+                static const ExpressionValue noArg;
+                const ExpressionValue & key = args.empty() ? noArg : args[0];
+
+                {
+                    std::unique_lock<std::mutex> guard(memo->mutex);
+                    auto it = memo->entries.find(key);
+                    if (it != memo->entries.end())
+                        return it->second;
+                }
+
+                ExpressionValue result = inner(args, scope);
+
+                std::unique_lock<std::mutex> guard(memo->mutex);
+                if (memo->entries.size() < FunctionResultMemo::MAX_ENTRIES)
+                    memo->entries.emplace(key, result);
+                return result;
+            };
+    }
+
+    return BoundFunction(std::move(exec), appliers[0]->info.output);
+}
+
 std::shared_ptr<Dataset>
 SqlExpressionMldbScope::
 doGetDataset(const Utf8String & datasetName)
 {
-    return mldb->datasets->getExistingEntity(datasetName.rawString());
+    // obtainDataset reloads the dataset from its persisted artifact if
+    // it was unloaded by the dataset memory budget
+    auto dataset = mldb->datasets->obtainDataset(datasetName.rawString());
+    if (dataset)
+        resolvedDatasets.push_back({ dataset, datasetName,
+                                     dataset->getVersion() });
+    return dataset;
 }
 
 std::shared_ptr<Dataset>
 SqlExpressionMldbScope::
 doGetDatasetFromConfig(const Any & datasetConfig)
 {
-    return obtainDataset(mldb, datasetConfig.convert<PolyConfig>());
+    auto dataset = obtainDataset(mldb, datasetConfig.convert<PolyConfig>());
+    if (dataset)
+        resolvedDatasets.push_back({ dataset, Utf8String(),
+                                     dataset->getVersion() });
+    return dataset;
 }
 
 // defined in table_expression_operations.cc
@@ -177,6 +505,45 @@ doGetColumn(const Utf8String & tableName,
     //    cerr << "  child " << c << endl;
     //cerr << "simplified = " << simplified << endl;
 
+    // Bind-time specialization: when the dataset guarantees at most one
+    // value per column in a row, every variable filter resolves to that
+    // one value, so the accessor can return the first match instead of
+    // scanning the whole row for the earliest or latest.  It also
+    // remembers the position of the last match: rows materialized from
+    // columnar storage lay their columns out in a near-identical order,
+    // so the remembered position almost always hits and the per-row
+    // search disappears entirely.
+    if (dataset.rowsHaveSingleValuePerColumn()) {
+        auto hint = std::make_shared<std::atomic<uint32_t> >(0);
+        return {[=] (const SqlRowScope & context,
+                     ExpressionValue & storage,
+                     const VariableFilter & filter) -> const ExpressionValue &
+                {
+                    auto & row = context.as<RowScope>();
+                    const auto & cols = row.row.columns;
+
+                    uint32_t h = hint->load(std::memory_order_relaxed);
+                    if (h < cols.size()
+                        && std::get<0>(cols[h]) == simplified) {
+                        return storage
+                            = ExpressionValue(std::get<1>(cols[h]),
+                                              std::get<2>(cols[h]));
+                    }
+
+                    for (uint32_t i = 0;  i < cols.size();  ++i) {
+                        if (std::get<0>(cols[i]) == simplified) {
+                            hint->store(i, std::memory_order_relaxed);
+                            return storage
+                                = ExpressionValue(std::get<1>(cols[i]),
+                                                  std::get<2>(cols[i]));
+                        }
+                    }
+
+                    return storage = std::move(ExpressionValue::null(Date::negativeInfinity()));
+                },
+                std::make_shared<AtomValueInfo>()};
+    }
+
     return {[=] (const SqlRowScope & context,
                  ExpressionValue & storage,
                  const VariableFilter & filter) -> const ExpressionValue &
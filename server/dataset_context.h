@@ -44,7 +44,18 @@ struct SqlExpressionMldbScope: public SqlBindingScope {
                   const Utf8String & functionName,
                   const std::vector<BoundSqlExpression> & args,
                   SqlBindingScope & argScope);
-    
+
+    /** Fuse a chain of nested user value function applications when
+        each function's binary output type is exactly what the next
+        one out consumes, so the intermediates skip the
+        ExpressionValue round trip (see
+        SqlBindingScope::doGetFusedFunctionChain).
+    */
+    virtual BoundFunction
+    doGetFusedFunctionChain(const std::vector<Utf8String> & functionNames,
+                            const std::vector<BoundSqlExpression> & args,
+                            SqlBindingScope & argScope);
+
     virtual std::shared_ptr<Dataset>
     doGetDataset(const Utf8String & datasetName);
 
@@ -58,6 +69,20 @@ struct SqlExpressionMldbScope: public SqlBindingScope {
 
     virtual ColumnGetter doGetColumn(const Utf8String & tableName,
                                      const ColumnName & columnName);
+
+    /** One dataset that was resolved while binding with this scope, with
+        the version it had at that point.  Together these allow a cached
+        plan that was bound with this scope to be checked for staleness
+        (see SqlQueryFunction's plan cache).
+    */
+    struct ResolvedDataset {
+        std::shared_ptr<Dataset> dataset;
+        Utf8String name;        ///< empty if not resolved by name
+        uint64_t version;       ///< dataset version when resolved
+    };
+
+    /// Datasets that were resolved while binding with this scope
+    std::vector<ResolvedDataset> resolvedDatasets;
 };
 
 
@@ -0,0 +1,90 @@
+/** engine_stats.h                                                 -*- C++ -*-
+    Copyright (c) 2016 Datacratic Inc.  All rights reserved.
+
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Process-wide counters for the query engine hot paths.
+
+    These are plain relaxed atomic counters: incrementing one is a
+    single atomic add with no ordering constraints, so they are cheap
+    enough to bump from inside query execution.  Even so, hot loops
+    should accumulate locally and add once per chunk or block rather
+    than once per row.
+
+    The counters only ever grow; MldbServer periodically publishes the
+    per-interval deltas through its EventRecorder, which feeds the
+    MultiAggregator and so the Graphite/Grafana boards.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Datacratic {
+namespace MLDB {
+
+/*****************************************************************************/
+/* ENGINE STATS                                                              */
+/*****************************************************************************/
+
+struct EngineStats {
+
+    EngineStats()
+        : queriesExecuted(0), rowsScanned(0),
+          chunksScanned(0), chunksSkipped(0),
+          resultCacheHits(0), resultCacheMisses(0)
+    {
+    }
+
+    /// SELECT queries run through BoundSelectQuery
+    std::atomic<uint64_t> queriesExecuted;
+
+    /// Rows materialized by the query executors
+    std::atomic<uint64_t> rowsScanned;
+
+    /// Tabular dataset chunks scanned by predicate evaluation
+    std::atomic<uint64_t> chunksScanned;
+
+    /// Tabular dataset chunks eliminated by their zone maps
+    std::atomic<uint64_t> chunksSkipped;
+
+    /// /v1/query result cache hits and misses (cache=1 requests only)
+    std::atomic<uint64_t> resultCacheHits;
+    std::atomic<uint64_t> resultCacheMisses;
+
+    /** Visit each counter with its metric name and current value. */
+    template<typename Fn>
+    void forEach(Fn && fn) const
+    {
+        auto load = [] (const std::atomic<uint64_t> & counter)
+            {
+                return counter.load(std::memory_order_relaxed);
+            };
+
+        fn("queriesExecuted",   load(queriesExecuted));
+        fn("rowsScanned",       load(rowsScanned));
+        fn("chunksScanned",     load(chunksScanned));
+        fn("chunksSkipped",     load(chunksSkipped));
+        fn("resultCacheHits",   load(resultCacheHits));
+        fn("resultCacheMisses", load(resultCacheMisses));
+    }
+};
+
+/** The single process-wide instance. */
+inline EngineStats & engineStats()
+{
+    static EngineStats stats;
+    return stats;
+}
+
+/** Bump a counter by n.  Spelled out so call sites don't need to
+    repeat the memory order.
+*/
+inline void engineStatsAdd(std::atomic<uint64_t> & counter, uint64_t n = 1)
+{
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -121,6 +121,14 @@ commit()
     underlying->commit();
 }
 
+uint64_t
+ForwardedDataset::
+getVersion() const
+{
+    ExcAssert(underlying);
+    return underlying->getVersion();
+}
+
 std::vector<MatrixNamedRow>
 ForwardedDataset::
 queryStructured(const SelectExpression & select,
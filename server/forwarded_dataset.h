@@ -57,6 +57,8 @@ struct ForwardedDataset: public Dataset {
 
     virtual void commit();
 
+    virtual uint64_t getVersion() const;
+
     virtual std::vector<MatrixNamedRow>
     queryStructured(const SelectExpression & select,
                     const WhenExpression & when,
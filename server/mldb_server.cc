@@ -14,10 +14,13 @@
 #include "mldb/rest/collection_config_store.h"
 #include "mldb/rest/http_rest_endpoint.h"
 #include "mldb/rest/rest_request_binding.h"
+#include "mldb/rest/rest_request_stats.h"
+#include "mldb/jml/utils/string_functions.h"
 #include "mldb/vfs/fs_utils.h"
 #include "mldb/server/static_content_handler.h"
 #include "mldb/server/plugin_manifest.h"
 #include "mldb/sql/sql_expression.h"
+#include "mldb/sql/execution_pipeline.h"
 #include <signal.h>
 
 #include "mldb/server/dataset_collection.h"
@@ -29,9 +32,21 @@
 #include "mldb/vfs/fs_utils.h"
 #include "mldb/vfs/filter_streams.h"
 #include "mldb/server/analytics.h"
+#include "mldb/server/bound_queries.h"
+#include "mldb/server/engine_stats.h"
 #include "mldb/types/meta_value_description.h"
+#include "mldb/types/map_description.h"
 #include "mldb/arch/simd.h"
+#include "mldb/arch/tick_counter.h"
 #include "mldb/utils/log.h"
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 
 using namespace std;
@@ -66,6 +81,69 @@ std::shared_ptr<TypeClassCollection>
 createTypeClassCollection(MldbServer * server, RestRouteManager & routeManager);
 
 
+/*****************************************************************************/
+/* ENGINE STATS FLUSHER                                                      */
+/*****************************************************************************/
+
+/** Background thread that publishes the engine hot-path counters (see
+    engine_stats.h) through the server's event recorder.  The counters
+    only ever grow, so we record the per-interval deltas as counts;
+    the MultiAggregator turns those into the per-second rates that the
+    Graphite boards graph.
+*/
+
+struct EngineStatsFlusher {
+
+    EngineStatsFlusher(const EventRecorder & recorder)
+        : recorder(recorder), shuttingDown(false),
+          flushThread([this] () { this->run(); })
+    {
+    }
+
+    ~EngineStatsFlusher()
+    {
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            shuttingDown = true;
+            wakeup.notify_all();
+        }
+        flushThread.join();
+    }
+
+    void run()
+    {
+        std::map<std::string, uint64_t> last;
+        engineStats().forEach([&] (const char * name, uint64_t value)
+            {
+                last[name] = value;
+            });
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> guard(mutex);
+                wakeup.wait_for(guard, std::chrono::seconds(10));
+                if (shuttingDown)
+                    return;
+            }
+
+            engineStats().forEach([&] (const char * name, uint64_t value)
+                {
+                    uint64_t delta = value - last[name];
+                    last[name] = value;
+                    if (delta != 0)
+                        recorder.recordCount(delta, "engine.%s", name);
+                });
+        }
+    }
+
+    const EventRecorder & recorder;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool shuttingDown;
+    std::thread flushThread;
+};
+
+
 /*****************************************************************************/
 /* MLDB SERVER                                                               */
 /*****************************************************************************/
@@ -103,12 +181,14 @@ MldbServer::
 init(std::string credentialsPath,
      std::string staticFilesPath,
      std::string staticDocPath,
-     bool hideInternalEntities)
+     bool hideInternalEntities,
+     std::shared_ptr<PeerServer> peerServer)
 {
-    auto server = std::make_shared<StandalonePeerServer>();
+    if (!peerServer)
+        peerServer = std::make_shared<StandalonePeerServer>();
 
     preInit();
-    initServer(server);
+    initServer(peerServer);
     if (initRoutes()) { // if initRoutes fails no need to add collections to routes
         initCollections(credentialsPath, staticFilesPath, staticDocPath, hideInternalEntities);
         return true;
@@ -183,6 +263,124 @@ initRoutes()
                          handleShutdown,
                          Json::Value());
 
+    RestRequestRouter::OnProcessRequest handleMetrics
+        = [=] (RestConnection & connection,
+               const RestRequest & request,
+               const RestRequestParsingContext & context) {
+
+        bool prometheus = request.params.hasValue("format")
+            && request.params.getValue("format") == "prometheus";
+
+        if (!prometheus) {
+            Json::Value result;
+
+            Json::Value & rest = result["rest"];
+            restRequestStats().forEach
+                ([&] (const std::string & verb,
+                      const std::string & route,
+                      const LatencyHistogram & histogram)
+                {
+                    auto snap = histogram.snapshot();
+                    if (snap.count == 0)
+                        return;
+
+                    Json::Value & v = rest[verb + " " + route];
+                    v["count"] = (Json::UInt)snap.count;
+                    v["meanMs"] = snap.sumMicros / 1000.0 / snap.count;
+                    v["p50Ms"] = snap.quantileMicros(0.5) / 1000.0;
+                    v["p90Ms"] = snap.quantileMicros(0.9) / 1000.0;
+                    v["p99Ms"] = snap.quantileMicros(0.99) / 1000.0;
+                    v["p999Ms"] = snap.quantileMicros(0.999) / 1000.0;
+                    v["maxMs"] = snap.maxMicros / 1000.0;
+                });
+
+            Json::Value & engine = result["engine"];
+            engineStats().forEach([&] (const char * name, uint64_t value)
+                {
+                    engine[name] = (Json::UInt)value;
+                });
+
+            connection.sendResponse(200, result);
+            return RestRequestRouter::MR_YES;
+        }
+
+        std::string body;
+
+        body += "# TYPE mldb_engine_counter counter\n";
+        engineStats().forEach([&] (const char * name, uint64_t value)
+            {
+                body += "mldb_engine_counter{name=\"" + string(name)
+                    + "\"} " + std::to_string(value) + "\n";
+            });
+
+        // The fine log-linear buckets are folded into a fixed set of
+        // scrape bounds; the full resolution stays available through
+        // the JSON format's quantiles
+        static const double bounds[] = {
+            0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+            0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0
+        };
+        constexpr size_t numBounds = sizeof(bounds) / sizeof(bounds[0]);
+
+        body += "# TYPE mldb_rest_request_duration_seconds histogram\n";
+        restRequestStats().forEach
+            ([&] (const std::string & verb,
+                  const std::string & route,
+                  const LatencyHistogram & histogram)
+            {
+                auto snap = histogram.snapshot();
+                if (snap.count == 0)
+                    return;
+
+                std::string labels
+                    = "verb=\"" + verb + "\",route=\"" + route + "\"";
+
+                uint64_t cumulative = 0;
+                size_t b = 0;
+                for (int i = 0;
+                     i < LatencyHistogram::NUM_BUCKETS && b < numBounds;
+                     ++i) {
+                    uint64_t upper
+                        = i + 1 < LatencyHistogram::NUM_BUCKETS
+                        ? LatencyHistogram::bucketLowerMicros(i + 1)
+                        : (uint64_t)-1;
+                    while (b < numBounds
+                           && upper > (uint64_t)(bounds[b] * 1000000.0)) {
+                        body += "mldb_rest_request_duration_seconds_bucket{"
+                            + labels + ",le=\"" + ML::format("%g", bounds[b])
+                            + "\"} " + std::to_string(cumulative) + "\n";
+                        ++b;
+                    }
+                    cumulative += snap.buckets[i];
+                }
+                for (; b < numBounds;  ++b) {
+                    body += "mldb_rest_request_duration_seconds_bucket{"
+                        + labels + ",le=\"" + ML::format("%g", bounds[b])
+                        + "\"} " + std::to_string(cumulative) + "\n";
+                }
+
+                body += "mldb_rest_request_duration_seconds_bucket{"
+                    + labels + ",le=\"+Inf\"} "
+                    + std::to_string(snap.count) + "\n";
+                body += "mldb_rest_request_duration_seconds_sum{" + labels
+                    + "} " + ML::format("%g", snap.sumMicros / 1000000.0)
+                    + "\n";
+                body += "mldb_rest_request_duration_seconds_count{" + labels
+                    + "} " + std::to_string(snap.count) + "\n";
+            });
+
+        connection.sendHttpResponse(200, body, "text/plain; version=0.0.4",
+                                    {});
+        return RestRequestRouter::MR_YES;
+    };
+
+    versionNode.addRoute("/metrics", "GET",
+                         "Per-route request latency histograms and engine "
+                         "counters, as JSON or (with format=prometheus) "
+                         "Prometheus text",
+                         handleMetrics,
+                         Json::Value());
+
 
    // MLDB-1380 - make sure that the CPU support the minimal instruction sets
     if (supportsSystemRequirements()) {
@@ -206,8 +404,70 @@ initRoutes()
                                              false),
                       RestParamDefault<bool>("sortColumns",
                                              "Do we sort the column names",
-                                             false));
-
+                                             false),
+                      RestParamDefault<bool>("streaming",
+                                             "Do we stream the rows back "
+                                             "incrementally with chunked "
+                                             "transfer encoding",
+                                             false),
+                      RestParamDefault<bool>("profile",
+                                             "Do we return a timing "
+                                             "breakdown of the query in the "
+                                             "X-Query-Profile response "
+                                             "header (ignored when "
+                                             "streaming)",
+                                             false),
+                      RestParamDefault<std::string>("lane",
+                                                    "Scheduling lane for the "
+                                                    "query: 'interactive' "
+                                                    "(default) or 'batch'.  "
+                                                    "Batch queries have "
+                                                    "limited concurrency and "
+                                                    "yield to interactive "
+                                                    "ones",
+                                                    "interactive"),
+                      RestParamDefault<bool>("cache",
+                                             "Serve this query from the "
+                                             "server-side result cache when "
+                                             "an entry exists for the same "
+                                             "query text and the contents "
+                                             "of none of its datasets have "
+                                             "changed since, and record the "
+                                             "result on a miss.  Queries "
+                                             "using non-deterministic "
+                                             "functions will have their "
+                                             "results reused.  Ignored "
+                                             "when streaming",
+                                             false),
+                      RestParamDefault<int>("batchSize",
+                                            "Number of rows per parallel "
+                                            "scan batch.  The default of 0 "
+                                            "sizes batches adaptively from "
+                                            "the measured per-row cost",
+                                            0));
+
+        // Registered before the dataset collection adds its /datasets
+        // sub-router, so this explicit path takes precedence over the
+        // <dataset> id pattern
+        addRouteSync(versionNode, "/datasets/group-commit", { "POST" },
+                     "Commit a group of datasets as one unit: queries see "
+                     "either the whole pre-commit generation or the whole "
+                     "post-commit one, never a mix",
+                     &MldbServer::groupCommitDatasets,
+                     this,
+                     JsonParam<std::vector<Utf8String> >
+                     ("", "Array of names of the datasets to commit"));
+
+        addRouteSyncJsonReturn(versionNode, "/queryProfiles", { "GET" },
+                               "Get profiles of recent slow or explicitly "
+                               "profiled queries",
+                               "JSON array of query profiles, newest first",
+                               &MldbServer::getQueryProfiles,
+                               this,
+                               RestParamDefault<int>("limit",
+                                                     "Maximum number of "
+                                                     "profiles to return",
+                                                     20));
 
         this->versionNode = &versionNode;
         return true;
@@ -232,6 +492,284 @@ initRoutes()
     }
 }
 
+namespace {
+
+/** Cache of parsed SQL statements for the query endpoints.  A statement
+    is immutable once parsed, so entries are keyed on the query text
+    alone and never go stale; the cache is emptied when it gets big to
+    bound its memory use.
+*/
+struct StatementCache {
+
+    static constexpr size_t MAX_ENTRIES = 1024;
+
+    std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<const SelectStatement> >
+        statements;
+
+    SelectStatement parse(const std::string & query)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auto it = statements.find(query);
+            if (it != statements.end())
+                return *it->second;  // the copy shares the expression trees
+        }
+
+        auto statement = std::make_shared<const SelectStatement>
+            (SelectStatement::parse(query));
+
+        std::unique_lock<std::mutex> guard(lock);
+        if (statements.size() >= MAX_ENTRIES)
+            statements.clear();
+        statements.emplace(query, statement);
+        return *statement;
+    }
+};
+
+StatementCache queryStatementCache;
+
+/** Opt-in cache of materialized query results, for callers (such as
+    dashboard backends) that re-issue identical queries against
+    datasets that rarely change.  An entry remembers the datasets the
+    query resolved together with their version at execution time; any
+    content change to one of them bumps the version
+    (Dataset::bumpVersion(), called on commit, and on record where
+    writes are immediately visible), which makes the entry stale on its
+    next lookup.  Eviction is
+    least-recently-used against an approximate memory budget.
+*/
+struct QueryResultCache {
+
+    static constexpr size_t MAX_BYTES = 128 * 1024 * 1024;
+
+    /// An entry bigger than this is not cached; it would evict too
+    /// much else for a single query
+    static constexpr size_t MAX_ENTRY_BYTES = MAX_BYTES / 8;
+
+    struct Entry {
+        std::string query;
+        std::vector<SqlExpressionMldbScope::ResolvedDataset> datasets;
+        std::shared_ptr<const std::vector<MatrixNamedRow> > rows;
+        size_t bytes = 0;
+    };
+
+    std::mutex lock;
+    std::list<Entry> entries;   ///< most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t totalBytes = 0;
+
+    static size_t approxBytes(const std::vector<MatrixNamedRow> & rows)
+    {
+        size_t result = sizeof(rows);
+        for (auto & r: rows) {
+            result += sizeof(r) + 64 /* row name */;
+            for (auto & c: r.columns)
+                result += sizeof(c) + 64 /* column name */
+                    + std::get<1>(c).memusage();
+        }
+        return result;
+    }
+
+    /** Return the cached result for the query if there is one and none
+        of the datasets it resolved have changed, otherwise nullptr. */
+    std::shared_ptr<const std::vector<MatrixNamedRow> >
+    lookup(const std::string & query, const MldbServer * server)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        auto it = index.find(query);
+        if (it == index.end())
+            return nullptr;
+
+        for (auto & d: it->second->datasets) {
+            bool stale = d.dataset->getVersion() != d.version;
+            // A dataset deleted and recreated under the same name is a
+            // different object, with its own versions
+            if (!stale && !d.name.empty())
+                stale = server->datasets
+                    ->tryGetExistingEntity(d.name.rawString()) != d.dataset;
+            if (stale) {
+                totalBytes -= it->second->bytes;
+                entries.erase(it->second);
+                index.erase(it);
+                return nullptr;
+            }
+        }
+
+        entries.splice(entries.begin(), entries, it->second);
+        return entries.front().rows;
+    }
+
+    void store(std::string query,
+               std::vector<SqlExpressionMldbScope::ResolvedDataset> datasets,
+               std::shared_ptr<const std::vector<MatrixNamedRow> > rows)
+    {
+        Entry entry;
+        entry.bytes = approxBytes(*rows);
+        if (entry.bytes > MAX_ENTRY_BYTES)
+            return;
+        entry.query = std::move(query);
+        entry.datasets = std::move(datasets);
+        entry.rows = std::move(rows);
+
+        std::unique_lock<std::mutex> guard(lock);
+
+        auto it = index.find(entry.query);
+        if (it != index.end()) {
+            totalBytes -= it->second->bytes;
+            entries.erase(it->second);
+            index.erase(it);
+        }
+
+        totalBytes += entry.bytes;
+        entries.emplace_front(std::move(entry));
+        index[entries.front().query] = entries.begin();
+
+        while (totalBytes > MAX_BYTES && entries.size() > 1) {
+            totalBytes -= entries.back().bytes;
+            index.erase(entries.back().query);
+            entries.pop_back();
+        }
+    }
+};
+
+QueryResultCache queryResultCache;
+
+/** Timing breakdown of a single query execution.  Recorded in the slow
+    query ring buffer, and returned in the X-Query-Profile header when
+    the caller asked for it.
+*/
+struct QueryProfile {
+    Utf8String query;
+    Date timestamp = Date::notADate();
+    double parseSeconds = 0.0;
+    double executeSeconds = 0.0;
+    double serializeSeconds = 0.0;
+    double totalSeconds = 0.0;
+    size_t rowsReturned = 0;
+
+    /// Hardware counter totals per executor phase plus execution
+    /// decision counts; only allocated when profiling was asked for.
+    /// The hardware sections stay empty when perf counters aren't
+    /// available.
+    std::shared_ptr<QueryPerfCounters> perf;
+
+    /// Per-operator row counts and chosen strategies; only allocated
+    /// when profiling was asked for
+    std::shared_ptr<ExecutionExplain> explain;
+
+    static Json::Value
+    countersToJson(const ML::PerfCounterAccumulator & acc)
+    {
+        ML::PerfCounterSample total = acc.total();
+        Json::Value result;
+        result["cycles"] = (Json::UInt)total.cycles;
+        result["instructions"] = (Json::UInt)total.instructions;
+        result["ipc"] = 1.0 * total.instructions / total.cycles;
+        result["llcMisses"] = (Json::UInt)total.cacheMisses;
+        result["branchMisses"] = (Json::UInt)total.branchMisses;
+        return result;
+    }
+
+    Json::Value toJson() const
+    {
+        Json::Value result;
+        result["query"] = query;
+        result["timestamp"] = timestamp.printIso8601();
+        result["parseSeconds"] = parseSeconds;
+        result["executeSeconds"] = executeSeconds;
+        result["serializeSeconds"] = serializeSeconds;
+        result["totalSeconds"] = totalSeconds;
+        result["rowsReturned"] = (Json::UInt)rowsReturned;
+
+        if (perf) {
+            Json::Value hardware;
+            if (!perf->whereScan.empty())
+                hardware["whereScan"] = countersToJson(perf->whereScan);
+            if (!perf->process.empty())
+                hardware["process"] = countersToJson(perf->process);
+            if (!perf->sort.empty())
+                hardware["sort"] = countersToJson(perf->sort);
+            if (!perf->columnScan.empty())
+                hardware["columnScan"] = countersToJson(perf->columnScan);
+            if (!hardware.isNull())
+                result["hardware"] = hardware;
+
+            uint64_t reordered = perf->predicatesReordered;
+            if (reordered > 0)
+                result["predicatesReordered"] = (Json::UInt)reordered;
+        }
+
+        if (explain && !explain->operators.empty()) {
+            // Operators record themselves on destruction, so they come
+            // in from the output end of the chain backwards; report
+            // them source first
+            Json::Value ops;
+            for (auto it = explain->operators.rbegin();
+                 it != explain->operators.rend();  ++it) {
+                Json::Value op;
+                op["operator"] = it->name;
+                if (it->rowsIn > 0)
+                    op["rowsIn"] = (Json::UInt)it->rowsIn;
+                op["rowsOut"] = (Json::UInt)it->rowsOut;
+                ops.append(op);
+            }
+            result["explain"] = ops;
+        }
+
+        return result;
+    }
+};
+
+/** Fixed-size ring of profiles of recent queries, so that a slow query
+    can still be diagnosed after the fact.  Profiled queries are always
+    recorded; unprofiled ones only when they were slow.
+*/
+struct QueryProfileBuffer {
+
+    static constexpr size_t MAX_ENTRIES = 128;
+
+    /// Queries at least this slow are recorded even when profiling was
+    /// not requested
+    static constexpr double SLOW_QUERY_SECONDS = 1.0;
+
+    std::mutex lock;
+    std::vector<std::shared_ptr<const QueryProfile> > entries;
+    size_t next = 0;  ///< Slot the next entry will overwrite
+
+    void record(std::shared_ptr<const QueryProfile> profile)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (entries.size() < MAX_ENTRIES) {
+            entries.emplace_back(std::move(profile));
+            next = entries.size() % MAX_ENTRIES;
+        }
+        else {
+            entries[next] = std::move(profile);
+            next = (next + 1) % MAX_ENTRIES;
+        }
+    }
+
+    /** Return up to limit profiles, newest first. */
+    std::vector<std::shared_ptr<const QueryProfile> >
+    recent(size_t limit)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        std::vector<std::shared_ptr<const QueryProfile> > result;
+        size_t n = std::min(limit, entries.size());
+        result.reserve(n);
+        for (size_t i = 0;  i < n;  ++i) {
+            size_t index = (next + entries.size() - 1 - i) % entries.size();
+            result.push_back(entries[index]);
+        }
+        return result;
+    }
+};
+
+QueryProfileBuffer queryProfileBuffer;
+
+} // file scope
+
 void
 MldbServer::
 runHttpQuery(const Utf8String& query,
@@ -240,31 +778,153 @@ runHttpQuery(const Utf8String& query,
              bool createHeaders,
              bool rowNames,
              bool rowHashes,
-             bool sortColumns) const
+             bool sortColumns,
+             bool streaming,
+             bool profile,
+             const std::string & lane,
+             bool cache,
+             int batchSize) const
 {
-    auto stm = SelectStatement::parse(query.rawString());
+    uint64_t started = ML::ticks();
+
+    QueryLane queryLane;
+    if (lane == "interactive")
+        queryLane = LANE_INTERACTIVE;
+    else if (lane == "batch")
+        queryLane = LANE_BATCH;
+    else throw HttpReturnException(400, "Unknown query lane "
+                                   "(expected 'interactive' or 'batch')",
+                                   "lane", lane);
+
+    // Everything this query executes, including streaming, happens
+    // under this thread's lane
+    QueryLaneScheduler::LaneGuard laneGuard(queryLane);
+
+    // Likewise for the scan batch size override, if one was given
+    QueryBatchSizeOverride batchSizeOverride(batchSize);
+
+    auto stm = queryStatementCache.parse(query.rawString());
     SqlExpressionMldbScope mldbContext(this);
 
+    if (streaming) {
+        // Serialization is interleaved with execution when streaming, so
+        // there is no phase breakdown to return.
+        auto runQuery = [&] (std::function<bool (MatrixNamedRow & row)> onRow)
+            {
+                queryFromStatementOnRow(std::move(onRow), stm, mldbContext);
+            };
+
+        MLDB::streamHttpQuery(runQuery, connection, format,
+                              rowNames, rowHashes, sortColumns);
+        return;
+    }
+
+    // The phase timers cost two rdtsc reads per phase, so we always run
+    // them; that way slow queries make it into the profile buffer even
+    // when nobody asked for a profile up front.
+    auto prof = std::make_shared<QueryProfile>();
+    prof->query = query;
+    prof->timestamp = Date::now();
+    prof->parseSeconds = (ML::ticks() - started) * ML::seconds_per_tick;
+
+    // Hardware counters cost real syscalls per executor phase, so they
+    // are only armed when the caller asked for a profile
+    if (profile) {
+        prof->perf = std::make_shared<QueryPerfCounters>();
+        prof->explain = std::make_shared<ExecutionExplain>();
+    }
+
+    uint64_t serializeStarted = 0;
+
     auto runQuery = [&] ()
         {
-            return queryFromStatement(stm, mldbContext);
+            QueryPerfCounters::Guard perfGuard(prof->perf.get());
+            ExecutionExplain::Guard explainGuard(prof->explain.get());
+
+            uint64_t before = ML::ticks();
+
+            std::vector<MatrixNamedRow> rows;
+            std::shared_ptr<const std::vector<MatrixNamedRow> > cached;
+            if (cache) {
+                cached = queryResultCache.lookup(query.rawString(), this);
+                engineStatsAdd(cached
+                               ? engineStats().resultCacheHits
+                               : engineStats().resultCacheMisses);
+            }
+            if (cached)
+                rows = *cached;
+            else {
+                rows = queryFromStatement(stm, mldbContext);
+                if (cache)
+                    queryResultCache.store
+                        (query.rawString(),
+                         std::move(mldbContext.resolvedDatasets),
+                         std::make_shared<std::vector<MatrixNamedRow> >(rows));
+            }
+
+            serializeStarted = ML::ticks();
+            prof->executeSeconds
+                = (serializeStarted - before) * ML::seconds_per_tick;
+            prof->rowsReturned = rows.size();
+            return rows;
+        };
+
+    // Called once the response body has been serialized, just before it
+    // is sent.
+    auto getProfileHeaders = [&] () -> RestParams
+        {
+            uint64_t now = ML::ticks();
+            prof->serializeSeconds
+                = (now - serializeStarted) * ML::seconds_per_tick;
+            prof->totalSeconds = (now - started) * ML::seconds_per_tick;
+
+            if (profile
+                || prof->totalSeconds
+                    >= QueryProfileBuffer::SLOW_QUERY_SECONDS)
+                queryProfileBuffer.record(prof);
+
+            if (!profile)
+                return RestParams();
+            return { { "X-Query-Profile",
+                       prof->toJson().toStringNoNewLine() } };
         };
 
     MLDB::runHttpQuery(runQuery, connection, format, createHeaders,
-                       rowNames, rowHashes, sortColumns);
+                       rowNames, rowHashes, sortColumns, getProfileHeaders);
+}
+
+Json::Value
+MldbServer::
+getQueryProfiles(int limit)
+{
+    if (limit <= 0)
+        throw HttpReturnException(400, "limit must be positive",
+                                  "limit", limit);
+
+    Json::Value result(Json::arrayValue);
+    for (auto & p: queryProfileBuffer.recent(limit))
+        result.append(p->toJson());
+    return result;
 }
 
 std::vector<MatrixNamedRow>
 MldbServer::
 query(const Utf8String& query) const
 {
-    auto stm = SelectStatement::parse(query.rawString());
+    auto stm = queryStatementCache.parse(query.rawString());
     SqlExpressionMldbScope mldbContext(this);
     BoundTableExpression table = stm.from->bind(mldbContext);
 
     return queryFromStatement(stm, mldbContext);
 }
 
+void
+MldbServer::
+groupCommitDatasets(const std::vector<Utf8String> & names)
+{
+    datasets->commitGroup(names);
+}
+
 Json::Value
 MldbServer::
 getTypeInfo(const std::string & typeName)
@@ -359,12 +1019,17 @@ start()
     ServicePeer::start();
     // Graphite logging: just log a message bracketing service startup
     recordHit("serviceStarted");
+
+    // Start publishing the engine hot-path counters
+    engineStatsFlusher.reset(new EngineStatsFlusher(*this));
 }
 
 void
 MldbServer::
 shutdown()
 {
+    engineStatsFlusher.reset();
+
     httpEndpoint->closePeer();
 
     ServicePeer::shutdown();
@@ -389,6 +1054,47 @@ static bool endsWith(const std::string & str,
     return str.rfind(what) == str.length() - what.length();
 }
 
+/*  The recursive plugin directory walk dominates startup time on
+    replicas with many plugins.  When a cache directory is configured,
+    we remember which subdirectories held an mldb_plugin.json the last
+    time each directory was scanned, so that a warm restart goes
+    straight to the manifests instead of re-walking the tree.  Entries
+    are validated cheaply (each remembered manifest must still exist)
+    before being trusted; any miss falls back to a full scan, which
+    refreshes the cache.  Note that a plugin added to an already
+    cached directory is only picked up once the cache entry is
+    invalidated or removed.
+*/
+
+static std::map<std::string, std::vector<std::string> >
+loadPluginScanCache(const std::string & cachePath)
+{
+    std::map<std::string, std::vector<std::string> > result;
+
+    std::ifstream stream(cachePath);
+    if (!stream)
+        return result;
+
+    std::string contents((std::istreambuf_iterator<char>(stream)),
+                         std::istreambuf_iterator<char>());
+    try {
+        result = jsonDecodeStr<std::map<std::string, std::vector<std::string> > >(contents);
+    } catch (const std::exception & exc) {
+        // A corrupt or stale format cache is ignored and rewritten
+        result.clear();
+    }
+
+    return result;
+}
+
+static void
+savePluginScanCache(const std::string & cachePath,
+                    const std::map<std::string, std::vector<std::string> > & cache)
+{
+    std::ofstream stream(cachePath);
+    stream << jsonEncodeStr(cache);
+}
+
 void
 MldbServer::
 scanPlugins(const std::string & dir_)
@@ -431,6 +1137,39 @@ scanPlugins(const std::string & dir_)
         foundPlugin(dir, stream);
     }
     else {
+        std::string cachePath;
+        if (!cacheDirectory_.empty())
+            cachePath = cacheDirectory_ + "/plugin_scan_cache.json";
+
+        // Warm restart fast path: re-use the plugin set resolved by a
+        // previous scan of this directory instead of re-walking it
+        if (!cachePath.empty()) {
+            auto cache = loadPluginScanCache(cachePath);
+            auto it = cache.find(dir);
+            if (it != cache.end()) {
+                bool valid = true;
+                for (auto & pluginDir: it->second) {
+                    if (!tryGetUriObjectInfo(pluginDir + "mldb_plugin.json")) {
+                        valid = false;
+                        break;
+                    }
+                }
+
+                if (valid) {
+                    logger->debug() << "loading " << it->second.size()
+                                    << " plugins for " << dir
+                                    << " from the scan cache";
+                    for (auto & pluginDir: it->second) {
+                        filter_istream stream(pluginDir + "mldb_plugin.json");
+                        foundPlugin(pluginDir, stream);
+                    }
+                    return;
+                }
+            }
+        }
+
+        std::vector<std::string> pluginDirs;
+
         auto onSubdir = [&] (const std::string & dirName,
                              int depth)
             {
@@ -446,7 +1185,8 @@ scanPlugins(const std::string & dir_)
                     //filter_istream stream(open({}),
                     //                          uri, {});
                     filter_istream stream(uri);
-                    foundPlugin(string(uri, 0, uri.length() - 16), stream);
+                    pluginDirs.push_back(string(uri, 0, uri.length() - 16));
+                    foundPlugin(pluginDirs.back(), stream);
                     return true;
                 }
                 return true;
@@ -454,6 +1194,12 @@ scanPlugins(const std::string & dir_)
 
         try {
             forEachUriObject(dir, onFile, onSubdir);
+
+            if (!cachePath.empty()) {
+                auto cache = loadPluginScanCache(cachePath);
+                cache[dir] = std::move(pluginDirs);
+                savePluginScanCache(cachePath, cache);
+            }
         } catch (const HttpReturnException & exc) {
             logger->error() << "error scanning plugin directory "
                             << dir << ": " << exc.what();
@@ -582,6 +1328,33 @@ restPost(const Utf8String & resource, const RestParams & params,
     return restPerform("POST", resource, params, std::move(payload));
 }
 
+void
+MldbServer::
+handlePeerMessage(RemotePeer * peer, PeerMessage && msg)
+{
+    if (msg.type != PEER_REST_REQUEST)
+        throw ML::Exception("unknown layer 2 peer message type %d", msg.type);
+
+    if (msg.payload.size() != 4)
+        throw ML::Exception("malformed PEER_REST_REQUEST message");
+
+    HttpHeader header;
+    header.verb = msg.payload[0];
+    header.resource = msg.payload[1];
+    header.queryParams = jsonDecodeStr<RestParams>(msg.payload[2]);
+
+    RestRequest request(header, msg.payload[3]);
+
+    InProcessRestConnection connection;
+    handleRequest(connection, request);
+
+    msg.payload = { std::to_string(connection.responseCode),
+                    connection.contentType,
+                    jsonEncodeStr(connection.headers),
+                    connection.response };
+    peer->sendResponse(std::move(msg));
+}
+
 
 
 namespace {
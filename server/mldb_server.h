@@ -39,6 +39,7 @@ struct Function;
 struct CredentialRule;
 
 struct MatrixNamedRow;
+struct EngineStatsFlusher;
 
 
 /*****************************************************************************/
@@ -83,14 +84,18 @@ struct MldbServer: public ServicePeer, public EventRecorder {
     */
     void setCacheDirectory(const std::string & dir);
 
-    /** Initialize the server in standalone mode, with the given
-        configuration path.  No remote
-        discovery or message passing is supported in this configuration.
+    /** Initialize the server with the given configuration path.  By
+        default it runs in standalone mode, where no remote discovery or
+        message passing is supported.  Passing a peer server (eg an
+        AsioPeerServer, together with initDiscovery) instead connects it
+        to other peers; the replication tests use this to run several
+        servers in one process.
     */
     bool init(std::string configurationPath = "",
               std::string staticFilesPath = "file://mldb/container_files/public_html/resources",
               std::string staticDocPath = "file://mldb/container_files/public_html/doc",
-              bool hideInternalEntities = false);
+              bool hideInternalEntities = false,
+              std::shared_ptr<PeerServer> peerServer = nullptr);
 
     void start();
 
@@ -121,12 +126,29 @@ struct MldbServer: public ServicePeer, public EventRecorder {
                       bool createHeaders,
                       bool rowNames,
                       bool rowHashes,
-                      bool sortColumns) const;
+                      bool sortColumns,
+                      bool streaming,
+                      bool profile,
+                      const std::string & lane,
+                      bool cache,
+                      int batchSize) const;
+
+    /** Commit a group of datasets as one unit, so that queries see
+        either the whole pre-commit generation or the whole post-commit
+        one (see DatasetCollection::commitGroup).
+    */
+    void groupCommitDatasets(const std::vector<Utf8String> & names);
 
     /** Get a type info structure for the given type. */
     Json::Value
     getTypeInfo(const std::string & typeName);
 
+    /** Get the profiles of recent slow or explicitly profiled queries,
+        newest first.
+    */
+    Json::Value
+    getQueryProfiles(int limit);
+
     /** Get the documentation path for the given package.  This will look
         at the working directory of the package that loaded it.
     */
@@ -166,6 +188,20 @@ struct MldbServer: public ServicePeer, public EventRecorder {
         const RestParams & params = RestParams(),
         const Json::Value payload = Json::Value()) const;
 
+    /** Layer 2 peer message types understood by MLDB instances. */
+    enum PeerMessageType {
+        PEER_REST_REQUEST   ///< Perform a REST request on the remote peer
+    };
+
+    /** Handle a layer 2 message from a peer.  PEER_REST_REQUEST messages
+        carry { verb, resource, query params, payload } and are run
+        through the REST router as if they had arrived over HTTP, with
+        { code, content type, headers, body } sent back as the response.
+        This is what dataset replication uses to pull chunks from the
+        primary over the peer channel.
+    */
+    virtual void handlePeerMessage(RemotePeer * peer, PeerMessage && msg);
+
 private:
     void preInit();
     bool initRoutes();
@@ -176,6 +212,10 @@ private:
     RestRequestRouter * versionNode;
     std::string cacheDirectory_;
     std::shared_ptr<spdlog::logger> logger;
+
+    /// Publishes the engine hot-path counters (see engine_stats.h)
+    /// through our event recorder while the server is running
+    std::unique_ptr<EngineStatsFlusher> engineStatsFlusher;
 };
 
 } // namespace MLDB
@@ -10,6 +10,7 @@ LIBMLDB_SOURCES:= \
 	plugin_manifest.cc \
 	dataset_utils.cc \
 	dataset_collection.cc \
+	binary_row_batch.cc \
 	procedure_collection.cc \
 	procedure_run_collection.cc \
 	function_collection.cc \
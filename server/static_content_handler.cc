@@ -7,10 +7,16 @@
     Handler for static content.
 */
 
+#include <map>
+#include <mutex>
 #include <typeinfo>
 #include "mldb/server/static_content_handler.h"
 #include "mldb/rest/rest_request_router.h"
+#include "mldb/arch/exception_handler.h"
+#include "mldb/base/hash.h"
+#include "mldb/http/http_socket_handler.h"
 #include "mldb/vfs/fs_utils.h"
+#include "mldb/vfs/zstd_filter.h"
 #include "mldb/jml/utils/file_functions.h"
 #include "mldb/ext/hoedown/src/buffer.h"
 #include "mldb/ext/hoedown/src/html.h"
@@ -23,6 +29,9 @@
 #include "mldb/base/scope.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 
 
 using namespace std;
@@ -31,6 +40,108 @@ namespace fs = boost::filesystem;
 namespace Datacratic {
 namespace MLDB {
 
+namespace {
+
+/* Compress a whole asset body in memory with the given encoding. */
+std::string
+compressAsset(const std::string & body, const std::string & encoding)
+{
+    std::string result;
+    boost::iostreams::filtering_ostream stream;
+    if (encoding == "gzip")
+        stream.push(boost::iostreams::gzip_compressor());
+    else stream.push(zstd_compressor(-1 /* level */, 0 /* threads */));
+    stream.push(boost::iostreams::back_inserter(result));
+    stream.write(body.data(), body.size());
+    stream.reset();
+    return result;
+}
+
+
+/*****************************************************************************/
+/* STATIC ASSET CACHE                                                        */
+/*****************************************************************************/
+
+/** In-memory cache of the static assets under one route.  Each entry
+    keeps the body with {{HTTP_BASE_URL}} already substituted, a
+    content-hash ETag, and pre-compressed gzip and zstd variants, so a
+    repeat request is served from memory without re-reading, hashing or
+    compressing the file.  Entries are checked against the file's size
+    and modification time, so assets that change on disk are reloaded.
+*/
+
+struct StaticAssetCache {
+
+    struct Asset {
+        std::string body;
+        std::string etag;       ///< Strong validator: quoted MD5 of the body
+        std::string gzipBody;   ///< Empty if not worth compressing
+        std::string zstdBody;   ///< Empty if not worth compressing
+        Date lastModified;
+        int64_t size;
+        std::string httpBaseUrl;  ///< Base URL the body was rendered with
+    };
+
+    /** Return the up-to-date asset for the given file, (re)loading it
+        if it's not cached or the file has changed.  Returns a null
+        pointer if the file doesn't exist. */
+    std::shared_ptr<const Asset>
+    obtain(const std::string & filename, const std::string & httpBaseUrl)
+    {
+        auto info = tryGetUriObjectInfo(filename);
+        if (!info)
+            return nullptr;
+
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            auto it = assets.find(filename);
+            if (it != assets.end()
+                && it->second->lastModified == info.lastModified
+                && it->second->size == info.size
+                && it->second->httpBaseUrl == httpBaseUrl)
+                return it->second;
+        }
+
+        // Load outside the lock; concurrent loads of the same file are
+        // harmless, the last one wins
+        auto asset = std::make_shared<Asset>();
+
+        std::string filenameToLoad = filename;
+        if (filenameToLoad.find("file://") == 0)
+            filenameToLoad = std::string(filenameToLoad, 7);
+
+        ML::File_Read_Buffer buf(filenameToLoad);
+        asset->body.assign(buf.start(), buf.end());
+        boost::algorithm::replace_all(asset->body, "{{HTTP_BASE_URL}}",
+                                      httpBaseUrl);
+
+        asset->etag = "\"" + md5HashToHex(asset->body) + "\"";
+        asset->lastModified = info.lastModified;
+        asset->size = info.size;
+        asset->httpBaseUrl = httpBaseUrl;
+
+        if (asset->body.size()
+            >= HttpLegacySocketHandler::MIN_COMPRESSED_BODY_SIZE) {
+            asset->gzipBody = compressAsset(asset->body, "gzip");
+            if (asset->gzipBody.size() >= asset->body.size())
+                asset->gzipBody.clear();
+            asset->zstdBody = compressAsset(asset->body, "zstd");
+            if (asset->zstdBody.size() >= asset->body.size())
+                asset->zstdBody.clear();
+        }
+
+        std::unique_lock<std::mutex> guard(mutex);
+        auto & entry = assets[filename];
+        entry = std::move(asset);
+        return entry;
+    }
+
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<const Asset> > assets;
+};
+
+} // file scope
+
 
 void renderMacro(hoedown_buffer *ob,
                  const hoedown_buffer *text,
@@ -183,7 +294,32 @@ getStaticRouteHandler(string dir, MldbServer * server, bool hideInternalEntities
     if (dir.find("://") == string::npos)
         dir = "file://" + dir;
 
-    return [dir, server, hideInternalEntities] (RestConnection & connection,
+    auto cache = std::make_shared<StaticAssetCache>();
+
+    // Pre-load and pre-compress the directory's assets, so that not
+    // even the first visitor pays for reading and compressing them.
+    // Markdown files are skipped: they are rendered per request.
+    if (dir.find("file://") == 0) {
+        string rootDir(dir, 7);
+        if (fs::is_directory(rootDir)) {
+            for (fs::recursive_directory_iterator it(rootDir), end;
+                 it != end;  ++it) {
+                if (!fs::is_regular_file(it->status()))
+                    continue;
+                string filename = it->path().string();
+                if (filename.rfind(".md") == filename.size() - 3)
+                    continue;
+                JML_TRACE_EXCEPTIONS(false);
+                try {
+                    cache->obtain("file://" + filename, server->httpBaseUrl);
+                } catch (const std::exception & exc) {
+                    // Unreadable file; it will 404 like it always did
+                }
+            }
+        }
+    }
+
+    return [dir, server, hideInternalEntities, cache] (RestConnection & connection,
                   const RestRequest & request,
                   const RestRequestParsingContext & context)
         {
@@ -197,26 +333,47 @@ getStaticRouteHandler(string dir, MldbServer * server, bool hideInternalEntities
 
             //cerr << "looking for " << filename << " for resource " << path << endl;
 
-            auto sendFile = [&connection, &server] (const std::string & filename,
-                                 const std::string & mimeType)
+            auto sendFile = [&connection, &request, &server, &cache]
+                (const std::string & filename,
+                 const std::string & mimeType)
                 {
-                    if (!tryGetUriObjectInfo(filename)) {
+                    auto asset = cache->obtain(filename, server->httpBaseUrl);
+                    if (!asset) {
                         connection.sendErrorResponse
                         (404,
                          "File '" + filename + "' doesn't exist", "text/plain");
                         return RestRequestRouter::MR_YES;
                     }
 
-                    string filenameToLoad = filename;
-                    if (filenameToLoad.find("file://") == 0)
-                        filenameToLoad = string(filenameToLoad, 7);
+                    // A matching validator means the client's copy is
+                    // current; no need to send the body again
+                    if (request.header.tryGetHeader("if-none-match")
+                        .find(asset->etag) != string::npos) {
+                        connection.sendHttpResponse(304, "", "",
+                                                    { { "ETag", asset->etag } });
+                        return RestRequestRouter::MR_YES;
+                    }
 
-                    //cerr << "Loading file " << filename << " as " << filenameToLoad << endl;
-                    ML::File_Read_Buffer buf(filenameToLoad);
-            
-                    string result(buf.start(), buf.end());
-                    boost::algorithm::replace_all(result, "{{HTTP_BASE_URL}}", server->httpBaseUrl);
-                    connection.sendResponse(200, result, mimeType);
+                    RestParams headers = { { "ETag", asset->etag } };
+                    const string * body = &asset->body;
+
+                    // Serve the pre-compressed variant the client accepts;
+                    // the transport layer passes through responses that
+                    // already carry a Content-Encoding
+                    string encoding = pickContentEncoding
+                        (request.header.tryGetHeader("accept-encoding"));
+                    if (encoding == "zstd" && !asset->zstdBody.empty())
+                        body = &asset->zstdBody;
+                    else if (encoding == "gzip" && !asset->gzipBody.empty())
+                        body = &asset->gzipBody;
+                    else encoding.clear();
+
+                    if (!encoding.empty()) {
+                        headers.push_back({ "Content-Encoding", encoding });
+                        headers.push_back({ "Vary", "Accept-Encoding" });
+                    }
+
+                    connection.sendHttpResponse(200, *body, mimeType, headers);
                     return RestRequestRouter::MR_YES;
                 };
 
@@ -285,7 +442,20 @@ getStaticRouteHandler(string dir, MldbServer * server, bool hideInternalEntities
                 result += "</html>\n";
 
                 boost::algorithm::replace_all(result, "{{HTTP_BASE_URL}}", server->httpBaseUrl);
-                connection.sendResponse(200, result, mimeType);
+
+                // Rendered markdown depends on live server state, so it
+                // isn't cached; a content-hash validator still saves the
+                // transfer when the result hasn't changed
+                string etag = "\"" + md5HashToHex(result) + "\"";
+                if (request.header.tryGetHeader("if-none-match")
+                    .find(etag) != string::npos) {
+                    connection.sendHttpResponse(304, "", "",
+                                                { { "ETag", etag } });
+                    return RestRequestRouter::MR_YES;
+                }
+
+                connection.sendHttpResponse(200, result, mimeType,
+                                            { { "ETag", etag } });
                 return RestRequestRouter::MR_YES;
             }
 
@@ -107,26 +107,28 @@ bool iterateArchive(std::streambuf * archive,
                     {
                         // For the moment, copy into a buffer and return
                         // a stringstream.  Streaming support later.
-                            
-                        std::ostringstream stream;
-                            
+
+                        std::string data;
+                        if (info->size > 0)
+                            data.reserve(info->size);
+
                         size_t size = 0;
                         off_t offset = 0;
                         const char * buff;
                         int r = archive_read_data_block(a, (const void **)&buff,
                                                         &size, &offset);
-          
+
                         while (r != ARCHIVE_EOF) {
                             if (r < ARCHIVE_OK)
                                 throw ML::Exception("Error extracting file");
-                            stream.write(buff, size);
+                            data.append(buff, size);
                             r = archive_read_data_block
                                 (a, (const void **)&buff,
                                  &size, &offset);
                         }
 
                         std::shared_ptr<std::istream> result
-                        (new std::istringstream(stream.str()));
+                        (new std::istringstream(std::move(data)));
                         return UriHandler(result->rdbuf(), result, info);
                     };
 
@@ -14,6 +14,7 @@
 #include "mldb/types/url.h"
 #include "mldb/soa/utils/print_utils.h"
 #include "mldb/types/structure_description.h"
+#include "mldb/arch/buffer_pool.h"
 #include "mldb/arch/futex.h"
 #include "mldb/arch/threads.h"
 #include "mldb/base/exc_assert.h"
@@ -232,6 +233,7 @@ Content(const tinyxml2::XMLDocument & xml)
 }
 
 ML::Env_Option<int> S3_DEBUG("S3_DEBUG", 0);
+ML::Env_Option<int> S3_DOWNLOAD_THREADS("S3_DOWNLOAD_THREADS", 0);
 
 S3Api::Response
 S3Api::SignedRequest::
@@ -363,14 +365,20 @@ performSync() const
         myRequest.add_callback_option(CURLOPT_HEADERFUNCTION, CURLOPT_HEADERDATA, onHeader);
         myRequest.add_callback_option(CURLOPT_WRITEFUNCTION, CURLOPT_WRITEDATA, onWriteData);
 
-        string s;
-        if (params.content.data) {
-            s.append(params.content.data, params.content.size);
-        }
-
         if (!noBody) {
-            myRequest.add_option(CURLOPT_POSTFIELDS, s);
-            myRequest.add_option(CURLOPT_POSTFIELDSIZE, params.content.size);
+            // Point libcurl at the content in place; copying a multi
+            // megabyte upload part into a temporary here would double
+            // the memory traffic of every part upload
+            if (params.content.data) {
+                myRequest.add_option(CURLOPT_POSTFIELDSIZE,
+                                     params.content.size);
+                myRequest.add_data_option(CURLOPT_POSTFIELDS,
+                                          params.content.data);
+            }
+            else {
+                myRequest.add_option(CURLOPT_POSTFIELDSIZE, 0L);
+                myRequest.add_option(CURLOPT_POSTFIELDS, "");
+            }
             headers.emplace_back(make_pair("Content-Length", ML::format("%lld",
                                                                         params.content.size)));
 
@@ -1665,6 +1673,16 @@ struct StreamingDownloadSource {
             numThreads = 3;
         if (impl->info.size > 256 * 1024 * 1024)
             numThreads = 5;
+        if (impl->info.size > 1024ULL * 1024 * 1024) {
+            // Big objects get enough request concurrency to saturate the
+            // instance's network; each thread keeps up to two ranged GETs
+            // ahead of the consumer on its own pooled connection
+            numThreads = std::min(16, std::max(5, (int)std::thread::hardware_concurrency()));
+        }
+
+        /* S3_DOWNLOAD_THREADS overrides the object size heuristic */
+        if (S3_DOWNLOAD_THREADS > 0)
+            numThreads = S3_DOWNLOAD_THREADS;
 
         impl->start(numThreads);
     }
@@ -1745,16 +1763,19 @@ struct StreamingDownloadSource {
 
         void start(int nThreads)
         {
+            numThreads = nThreads;
+
             // Maximum chunk size is what we can do in 3 seconds
             maxChunkSize = (owner->bandwidthToServiceMbps
                             * 3.0 * 1000000);
             size_t sysMemory = getTotalSystemMemory();
 
             //cerr << "sysMemory = " << sysMemory << endl;
-            // Limit each chunk to 1% of system memory
-            maxChunkSize = std::min(maxChunkSize, sysMemory / 100);
+            // Limit the chunks in flight (up to two per thread) to a few
+            // percent of system memory, however many threads we run
+            maxChunkSize = std::min(maxChunkSize,
+                                    sysMemory / (20 * numThreads));
             //cerr << "maxChunkSize = " << maxChunkSize << endl;
-            numThreads = nThreads;
 
             for (int i = 0; i < numThreads; i++) {
                 threadQueues.emplace_back(2);
@@ -1996,42 +2017,13 @@ struct StreamingUploadSource {
         Date startDate;
 
         struct Chunk {
-            Chunk() : data(nullptr)
+            Chunk()
+                : size(0), capacity(0), index(0), offset(0)
             {
             }
 
-            Chunk(Chunk && other)
-                noexcept
-            {
-                this->offset = other.offset;
-                this->size = other.size;
-                this->capacity = other.capacity;
-                this->index = other.index;
-                this->data = other.data;
-
-                other.data = nullptr;
-            }
-
-            Chunk & operator = (Chunk && other)
-                noexcept
-            {
-                this->offset = other.offset;
-                this->size = other.size;
-                this->capacity = other.capacity;
-                this->index = other.index;
-                this->data = other.data;
-                other.data = nullptr;
-
-                return *this;
-            }
-
-            ~Chunk()
-                noexcept
-            {
-                if (this->data) {
-                    delete[] this->data;
-                }
-            }
+            Chunk(Chunk && other) noexcept = default;
+            Chunk & operator = (Chunk && other) noexcept = default;
 
             void init(uint64_t offset, size_t capacity, int index)
             {
@@ -2039,18 +2031,20 @@ struct StreamingUploadSource {
                 this->size = 0;
                 this->capacity = capacity;
                 this->index = index;
-                this->data = new char[capacity];
+                // Pooled, so that a long upload recycles the buffers of
+                // already-uploaded parts instead of allocating per part
+                this->data = ML::get_pooled_buffer(capacity);
             }
 
             size_t append(const char * input, size_t n)
             {
                 size_t todo = std::min(n, capacity - size);
-                std::copy(input, input + todo, data + size);
+                std::copy(input, input + todo, data.get() + size);
                 size += todo;
                 return todo;
             }
 
-            char * data;
+            std::shared_ptr<char> data;
             size_t size;
             size_t capacity;
             int index;
@@ -2196,13 +2190,13 @@ struct StreamingUploadSource {
                         //     << chunk.index << endl;
 
                         // Upload the data
-                        string md5 = md5HashToHex(chunk.data, chunk.size);
+                        string md5 = md5HashToHex(chunk.data.get(), chunk.size);
 
                         auto putResult = owner->put(bucket, "/" + object,
                                                     ML::format("partNumber=%d&uploadId=%s",
                                                                chunk.index + 1, uploadId),
                                                     {}, {},
-                                                    S3Api::Content(chunk.data,
+                                                    S3Api::Content(chunk.data.get(),
                                                                    chunk.size,
                                                                    md5));
                         if (putResult.code_ != 200) {
@@ -2214,10 +2208,12 @@ struct StreamingUploadSource {
                         // cerr << "successfully uploaded part " << chunk.index
                         //     << " with etag " << etag << endl;
 
-                        std::unique_lock<std::mutex> guard(etagsLock);
-                        while (etags.size() <= chunk.index)
-                            etags.push_back("");
-                        etags[chunk.index] = etag;
+                        {
+                            std::unique_lock<std::mutex> guard(etagsLock);
+                            while (etags.size() <= chunk.index)
+                                etags.push_back("");
+                            etags[chunk.index] = etag;
+                        }
                     } catch (...) {
                         // Capture exception to be thrown later
                         exc = std::current_exception();
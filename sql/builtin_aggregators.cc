@@ -13,6 +13,8 @@
 #include "mldb/jml/utils/csv.h"
 #include "mldb/types/vector_description.h"
 #include <array>
+#include <cmath>
+#include <set>
 #include <unordered_set>
 
 using namespace std;
@@ -961,6 +963,474 @@ struct LaterAccum {
 static RegisterAggregatorT<EarliestLatestAccum<EarlierAccum> > registerEarliest("earliest", "vertical_earliest");
 static RegisterAggregatorT<EarliestLatestAccum<LaterAccum> > registerLatest("latest", "vertical_latest");
 
+/** HyperLogLog sketch over the value hashes.  Unlike count_distinct it
+    uses constant memory (2^11 one byte registers, for a typical error
+    around 2.3%) no matter how many distinct values are seen, and the
+    per-thread states merge by taking the register maxima, so the
+    estimate is identical whichever way the rows were partitioned.
+*/
+struct ApproxCountDistinctAccum {
+    static constexpr int nargs = 1;
+    static constexpr size_t NUM_BITS = 11;
+    static constexpr size_t NUM_REGISTERS = 1 << NUM_BITS;
+
+    ApproxCountDistinctAccum()
+        : registers(NUM_REGISTERS, 0), ts(Date::negativeInfinity())
+    {
+    }
+
+    static std::shared_ptr<ExpressionValueInfo>
+    info(const std::vector<BoundSqlExpression> & args)
+    {
+        return std::make_shared<IntegerValueInfo>();
+    }
+
+    void process(const ExpressionValue * args, size_t nargs)
+    {
+        ExcAssertEqual(nargs, 1);
+        const ExpressionValue & val = args[0];
+        if (val.empty())
+            return;
+
+        uint64_t hash = val.getAtom().hash();
+
+        // The top bits pick the register; the rank is the position of
+        // the first set bit in the rest.
+        size_t bucket = hash >> (64 - NUM_BITS);
+        uint64_t rest = hash << NUM_BITS;
+        uint8_t rank = rest == 0
+            ? 64 - NUM_BITS + 1
+            : __builtin_clzll(rest) + 1;
+
+        registers[bucket] = std::max(registers[bucket], rank);
+        ts.setMax(val.getEffectiveTimestamp());
+    }
+
+    ExpressionValue extract()
+    {
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (uint8_t r: registers) {
+            sum += std::ldexp(1.0, -r);
+            zeros += (r == 0);
+        }
+
+        double m = NUM_REGISTERS;
+        double alpha = 0.7213 / (1.0 + 1.079 / m);
+        double estimate = alpha * m * m / sum;
+
+        // Small range correction: fall back to linear counting
+        if (estimate <= 2.5 * m && zeros != 0)
+            estimate = m * std::log(m / zeros);
+
+        return ExpressionValue((int64_t)std::round(estimate), ts);
+    }
+
+    void merge(ApproxCountDistinctAccum * src)
+    {
+        for (size_t i = 0;  i < NUM_REGISTERS;  ++i)
+            registers[i] = std::max(registers[i], src->registers[i]);
+        ts.setMax(src->ts);
+    }
+
+    std::vector<uint8_t> registers;
+    Date ts;
+};
+
+static RegisterAggregatorT<ApproxCountDistinctAccum>
+registerApproxCountDistinct("approx_count_distinct");
+
+/** Keeps the k largest values seen, in a single streaming pass.  The
+    second argument gives k and must be constant over the aggregation.
+    Returns an embedding with the values in decreasing order.
+*/
+struct TopKAccum {
+    static constexpr int nargs = 2;
+
+    TopKAccum()
+        : k(0), ts(Date::negativeInfinity())
+    {
+    }
+
+    static std::shared_ptr<ExpressionValueInfo>
+    info(const std::vector<BoundSqlExpression> & args)
+    {
+        return std::make_shared<EmbeddingValueInfo>();
+    }
+
+    void process(const ExpressionValue * args, size_t nargs)
+    {
+        ExcAssertEqual(nargs, 2);
+        const ExpressionValue & val = args[0];
+        if (val.empty())
+            return;
+
+        if (k == 0)
+            k = std::max<int64_t>(args[1].toInt(), 1);
+
+        values.insert(val.getAtom());
+        if (values.size() > k)
+            values.erase(values.begin());  // drop the smallest
+
+        ts.setMax(val.getEffectiveTimestamp());
+    }
+
+    ExpressionValue extract()
+    {
+        std::vector<CellValue> result(values.rbegin(), values.rend());
+        return ExpressionValue(std::move(result), ts);
+    }
+
+    void merge(TopKAccum * src)
+    {
+        k = std::max(k, src->k);
+        values.insert(src->values.begin(), src->values.end());
+        while (values.size() > k)
+            values.erase(values.begin());
+        ts.setMax(src->ts);
+    }
+
+    int64_t k;
+    std::multiset<CellValue> values;
+    Date ts;
+};
+
+static RegisterAggregatorT<TopKAccum> registerTopK("topk");
+
+/** SpaceSaving sketch of the k most frequent values.  The second
+    argument gives k and must be constant over the aggregation.  Uses
+    k counters no matter how many distinct values are seen: a new
+    value evicts the entry with the lowest count and inherits that
+    count as its error bound, so counts are exact to within the
+    smallest tracked count.  Returns a row mapping each value to its
+    (approximate) count, which replaces a full GROUP BY ... ORDER BY
+    count(*) ... LIMIT k materializing every group.
+*/
+struct FrequentItemsAccum {
+    static constexpr int nargs = 2;
+
+    FrequentItemsAccum()
+        : k(0), ts(Date::negativeInfinity())
+    {
+    }
+
+    static std::shared_ptr<ExpressionValueInfo>
+    info(const std::vector<BoundSqlExpression> & args)
+    {
+        return std::make_shared<UnknownRowValueInfo>();
+    }
+
+    void process(const ExpressionValue * args, size_t nargs)
+    {
+        ExcAssertEqual(nargs, 2);
+        const ExpressionValue & val = args[0];
+        if (val.empty())
+            return;
+
+        if (k == 0)
+            k = std::max<int64_t>(args[1].toInt(), 1);
+
+        ts.setMax(val.getEffectiveTimestamp());
+
+        CellValue atom = val.getAtom();
+        auto it = counts.find(atom);
+        if (it != counts.end()) {
+            ++it->second;
+            return;
+        }
+
+        if (counts.size() < k) {
+            counts[std::move(atom)] = 1;
+            return;
+        }
+
+        // Evict the entry with the lowest count; the newcomer inherits
+        // its count plus one.  A linear scan is fine at the ks this is
+        // used with (tens of entries).
+        auto lowest = counts.begin();
+        for (auto jt = counts.begin();  jt != counts.end();  ++jt) {
+            if (jt->second < lowest->second)
+                lowest = jt;
+        }
+        uint64_t count = lowest->second + 1;
+        counts.erase(lowest);
+        counts[std::move(atom)] = count;
+    }
+
+    ExpressionValue extract()
+    {
+        RowValue result;
+        for (auto & c: counts) {
+            result.emplace_back(PathElement(c.first.toUtf8String()),
+                                c.second, ts);
+        }
+        return ExpressionValue(std::move(result));
+    }
+
+    void merge(FrequentItemsAccum * src)
+    {
+        k = std::max(k, src->k);
+        for (auto & c: src->counts)
+            counts[c.first] += c.second;
+
+        // Trim back to the k highest counts
+        while (counts.size() > k) {
+            auto lowest = counts.begin();
+            for (auto jt = counts.begin();  jt != counts.end();  ++jt) {
+                if (jt->second < lowest->second)
+                    lowest = jt;
+            }
+            counts.erase(lowest);
+        }
+
+        ts.setMax(src->ts);
+    }
+
+    int64_t k;
+    std::unordered_map<CellValue, uint64_t> counts;
+    Date ts;
+};
+
+static RegisterAggregatorT<FrequentItemsAccum>
+registerFrequentItems("frequent_items");
+
+/** t-digest sketch of a distribution of doubles, used by the quantile
+    aggregators.  Centroids are kept small near the tails and allowed to
+    grow towards the middle (the k-scale function below), so extreme
+    quantiles stay accurate while the memory stays fixed at a few
+    hundred centroids no matter how many values are added.  Digests
+    built over different partitions of the rows merge into one another,
+    which is what lets the per-thread aggregation states combine.
+*/
+struct QuantileDigest {
+    static constexpr double COMPRESSION = 100.0;
+    static constexpr size_t BUFFER_SIZE = 512;
+
+    QuantileDigest()
+        : totalWeight(0.0),
+          minValue(INFINITY),
+          maxValue(-INFINITY)
+    {
+    }
+
+    void add(double x, double w = 1.0)
+    {
+        centroids.emplace_back(x, w);
+        totalWeight += w;
+        minValue = std::min(minValue, x);
+        maxValue = std::max(maxValue, x);
+        if (centroids.size() >= BUFFER_SIZE)
+            compress();
+    }
+
+    void merge(const QuantileDigest & other)
+    {
+        centroids.insert(centroids.end(),
+                         other.centroids.begin(), other.centroids.end());
+        totalWeight += other.totalWeight;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+        compress();
+    }
+
+    /** Scale function; centroids may absorb weight as long as they span
+        less than one unit of k.  The arcsin form concentrates the
+        resolution at the two tails.
+    */
+    static double scale(double q)
+    {
+        return COMPRESSION / (2.0 * M_PI)
+            * std::asin(2.0 * std::min(1.0, std::max(0.0, q)) - 1.0);
+    }
+
+    void compress()
+    {
+        if (centroids.size() <= 1)
+            return;
+
+        std::sort(centroids.begin(), centroids.end());
+
+        std::vector<std::pair<double, double> > merged;
+        merged.reserve(COMPRESSION);
+        merged.push_back(centroids[0]);
+
+        double weightSoFar = 0.0;
+        double kLeft = scale(0.0);
+
+        for (size_t i = 1;  i < centroids.size();  ++i) {
+            double proposed = merged.back().second + centroids[i].second;
+            double kRight = scale((weightSoFar + proposed) / totalWeight);
+
+            if (kRight - kLeft <= 1.0) {
+                // Merge into the current centroid, keeping the weighted
+                // mean
+                double & mean = merged.back().first;
+                double & weight = merged.back().second;
+                mean += (centroids[i].first - mean)
+                    * centroids[i].second / proposed;
+                weight = proposed;
+            }
+            else {
+                weightSoFar += merged.back().second;
+                kLeft = scale(weightSoFar / totalWeight);
+                merged.push_back(centroids[i]);
+            }
+        }
+
+        centroids = std::move(merged);
+    }
+
+    double quantile(double q)
+    {
+        compress();
+
+        if (centroids.empty())
+            return NAN;
+        if (centroids.size() == 1)
+            return centroids[0].first;
+
+        // Interpolate between the centroid centres bracketing rank
+        // q * totalWeight
+        double rank = q * totalWeight;
+        double weightSoFar = 0.0;
+
+        double prevCentre = minValue;
+        double prevRank = 0.0;
+
+        for (auto & c: centroids) {
+            double centre = weightSoFar + c.second / 2.0;
+            if (rank < centre) {
+                double frac = (rank - prevRank) / (centre - prevRank);
+                return prevCentre + frac * (c.first - prevCentre);
+            }
+            prevCentre = c.first;
+            prevRank = centre;
+            weightSoFar += c.second;
+        }
+
+        if (rank >= totalWeight)
+            return maxValue;
+        double frac = (rank - prevRank) / (totalWeight - prevRank);
+        return prevCentre + frac * (maxValue - prevCentre);
+    }
+
+    /// Merged centroids followed by not yet merged input points, as
+    /// (mean, weight) pairs
+    std::vector<std::pair<double, double> > centroids;
+    double totalWeight;
+    double minValue;
+    double maxValue;
+};
+
+/** Approximate quantile of the values, in a single streaming pass with
+    fixed memory.  The second argument gives the quantile, between 0 and
+    1, and must be constant over the aggregation.  Replaces the full
+    materialization and sort that an ORDER BY based percentile requires;
+    accuracy is highest at the tails (p95, p99), which is where latency
+    reports look.
+*/
+struct QuantileAccum {
+    static constexpr int nargs = 2;
+
+    QuantileAccum()
+        : q(std::nan("")), ts(Date::negativeInfinity())
+    {
+    }
+
+    static std::shared_ptr<ExpressionValueInfo>
+    info(const std::vector<BoundSqlExpression> & args)
+    {
+        return std::make_shared<Float64ValueInfo>();
+    }
+
+    void process(const ExpressionValue * args, size_t nargs)
+    {
+        ExcAssertEqual(nargs, 2);
+        const ExpressionValue & val = args[0];
+        if (val.empty())
+            return;
+
+        if (std::isnan(q)) {
+            q = args[1].toDouble();
+            if (q < 0.0 || q > 1.0)
+                throw HttpReturnException
+                    (400, "quantile() second argument must be between "
+                     "0 and 1");
+        }
+
+        digest.add(val.toDouble());
+        ts.setMax(val.getEffectiveTimestamp());
+    }
+
+    ExpressionValue extract()
+    {
+        if (digest.totalWeight == 0.0)
+            return ExpressionValue();
+        return ExpressionValue(digest.quantile(q), ts);
+    }
+
+    void merge(QuantileAccum * src)
+    {
+        if (std::isnan(q))
+            q = src->q;
+        digest.merge(src->digest);
+        ts.setMax(src->ts);
+    }
+
+    QuantileDigest digest;
+    double q;
+    Date ts;
+};
+
+static RegisterAggregatorT<QuantileAccum> registerQuantile("quantile");
+
+/** Approximate median; same sketch as quantile() with the quantile
+    fixed at 0.5.
+*/
+struct MedianAccum {
+    static constexpr int nargs = 1;
+
+    MedianAccum()
+        : ts(Date::negativeInfinity())
+    {
+    }
+
+    static std::shared_ptr<ExpressionValueInfo>
+    info(const std::vector<BoundSqlExpression> & args)
+    {
+        return std::make_shared<Float64ValueInfo>();
+    }
+
+    void process(const ExpressionValue * args, size_t nargs)
+    {
+        ExcAssertEqual(nargs, 1);
+        const ExpressionValue & val = args[0];
+        if (val.empty())
+            return;
+
+        digest.add(val.toDouble());
+        ts.setMax(val.getEffectiveTimestamp());
+    }
+
+    ExpressionValue extract()
+    {
+        if (digest.totalWeight == 0.0)
+            return ExpressionValue();
+        return ExpressionValue(digest.quantile(0.5), ts);
+    }
+
+    void merge(MedianAccum * src)
+    {
+        digest.merge(src->digest);
+        ts.setMax(src->ts);
+    }
+
+    QuantileDigest digest;
+    Date ts;
+};
+
+static RegisterAggregatorT<MedianAccum> registerMedian("median");
+
 
 } // namespace Builtins
 } // namespace MLDB
@@ -16,9 +16,17 @@ typedef std::function<BoundTableExpression (const std::vector<BoundTableExpressi
 // and allow expression parsing to be in a separate library
 std::shared_ptr<Dataset> (*createTransposedDatasetFn) (MldbServer *, std::shared_ptr<Dataset> dataset);
 std::shared_ptr<Dataset> (*createMergedDatasetFn) (MldbServer *, std::vector<std::shared_ptr<Dataset> >);
+std::shared_ptr<Dataset> (*createUnionDatasetFn) (MldbServer *, std::vector<std::shared_ptr<Dataset> >);
 std::shared_ptr<Dataset> (*createSampledDatasetFn) (MldbServer *,
                                                     std::shared_ptr<Dataset> dataset,
                                                     const ExpressionValue & options);
+std::shared_ptr<Dataset> (*createHistogramDatasetFn) (MldbServer *,
+                                                      std::shared_ptr<Dataset> dataset,
+                                                      const ExpressionValue & options);
+std::shared_ptr<Dataset> (*createReservoirDatasetFn) (MldbServer *,
+                                                      std::shared_ptr<Dataset> dataset,
+                                                      const ExpressionValue & options,
+                                                      bool stratified);
 
 // defined in table_expression_operations.cc
 BoundTableExpression
@@ -123,6 +131,37 @@ static RegisterBuiltin registerMerge(merge, "merge");
 
 
 
+/*****************************************************************************/
+/* UNION DATASET                                                             */
+/*****************************************************************************/
+
+BoundTableExpression unionDatasets(const SqlBindingScope & context,
+                                   const std::vector<BoundTableExpression> & args,
+                                   const ExpressionValue & options,
+                                   const Utf8String& alias)
+{
+    if (args.size() < 2)
+        throw HttpReturnException(500, "union() needs at least 2 arguments");
+    if(!options.empty())
+        throw HttpReturnException(500, "union() does not take any options");
+
+    std::vector<std::shared_ptr<Dataset> > datasets;
+    datasets.reserve(args.size());
+    for (auto arg : args)
+    {
+        if (arg.dataset)
+            datasets.push_back(arg.dataset);
+    }
+
+    auto ds = createUnionDatasetFn(context.getMldbServer(), datasets);
+
+    return bindDataset(ds, alias);
+}
+
+static RegisterBuiltin registerUnion(unionDatasets, "union");
+
+
+
 /*****************************************************************************/
 /* SAMPLED DATASET                                                           */
 /*****************************************************************************/
@@ -162,6 +201,107 @@ static RegisterBuiltin registerSample(sample, "sample");
 
 
 
+/*****************************************************************************/
+/* HISTOGRAM DATASET                                                         */
+/*****************************************************************************/
+
+BoundTableExpression histogram(const SqlBindingScope & context,
+                               const std::vector<BoundTableExpression> & args,
+                               const ExpressionValue & options,
+                               const Utf8String& alias)
+{
+    if (args.size() != 1)
+        throw HttpReturnException(400, "The 'histogram' function takes 1 "
+                                  "dataset as input, followed by a row "
+                                  "expression of parameters. See the "
+                                  "documentation of the 'From Expressions' "
+                                  "for more details.",
+                                  "options", options,
+                                  "alias", alias);
+
+    if (!options.isRow())
+        throw HttpReturnException(400,
+                "The parameters provided to the 'histogram' function "
+                "should be a row expression with at least the 'column' "
+                "parameter. Value provided: " + jsonEncodeStr(options)
+                + ". See the documentation of the 'From Expressions' "
+                "for more details on using the 'histogram' function");
+
+    auto ds = createHistogramDatasetFn(context.getMldbServer(),
+                                       args[0].dataset,
+                                       options);
+
+    return bindDataset(ds, alias);
+}
+
+static RegisterBuiltin registerHistogram(histogram, "histogram");
+
+
+
+/*****************************************************************************/
+/* RESERVOIR DATASET                                                         */
+/*****************************************************************************/
+
+static BoundTableExpression
+reservoirImpl(const SqlBindingScope & context,
+              const std::vector<BoundTableExpression> & args,
+              const ExpressionValue & options,
+              const Utf8String& alias,
+              const char * name,
+              bool stratified)
+{
+    if (args.size() != 1)
+        throw HttpReturnException(400, Utf8String("The '") + name
+                                  + "' function takes 1 dataset as input, "
+                                  "followed by a row expression of optional "
+                                  "parameters. See the documentation of the "
+                                  "'From Expressions' for more details.",
+                                  "options", options,
+                                  "alias", alias);
+
+    if (!options.empty() && !options.isRow())
+        throw HttpReturnException(400,
+                Utf8String("The parameters provided to the '") + name
+                + "' function should be a row expression, or not be "
+                "provided to use the defaults. Value provided: "
+                + jsonEncodeStr(options) + ". See the documentation of "
+                "the 'From Expressions' for more details on using the '"
+                + name + "' function");
+
+    auto ds = createReservoirDatasetFn(context.getMldbServer(),
+                                       args[0].dataset,
+                                       options,
+                                       stratified);
+
+    return bindDataset(ds, alias);
+}
+
+BoundTableExpression reservoir(const SqlBindingScope & context,
+                               const std::vector<BoundTableExpression> & args,
+                               const ExpressionValue & options,
+                               const Utf8String& alias)
+{
+    return reservoirImpl(context, args, options, alias,
+                         "reservoir", false /* stratified */);
+}
+
+static RegisterBuiltin registerReservoir(reservoir, "reservoir");
+
+BoundTableExpression
+stratifiedSample(const SqlBindingScope & context,
+                 const std::vector<BoundTableExpression> & args,
+                 const ExpressionValue & options,
+                 const Utf8String& alias)
+{
+    return reservoirImpl(context, args, options, alias,
+                         "stratified_sample", true /* stratified */);
+}
+
+static RegisterBuiltin registerStratifiedSample(stratifiedSample,
+                                                "stratified_sample");
+
+
+
 }
 }
 }
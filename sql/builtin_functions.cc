@@ -27,6 +27,9 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -901,18 +904,65 @@ BoundFunction implicit_cast(const std::vector<BoundSqlExpression> & args)
 
 static RegisterBuiltin registerImplicitCast(implicit_cast, "implicit_cast");
 
+/** Extract a literal prefix from the given regular expression, to allow
+    strings that can't possibly match to be rejected with a plain byte
+    compare before the regex engine runs.  Returns an empty string when no
+    usable prefix exists.  anchored is set when the pattern begins with
+    '^'.  Only ASCII literals are kept so that comparing raw UTF-8 bytes
+    is exact.
+*/
+static std::string regexLiteralPrefix(const Utf8String & pattern,
+                                      bool * anchored)
+{
+    const std::string & raw = pattern.rawString();
+
+    *anchored = !raw.empty() && raw[0] == '^';
+
+    // An alternation anywhere can bypass the start of the pattern, so
+    // no prefix is usable
+    if (raw.find('|') != std::string::npos)
+        return std::string();
+
+    std::string result;
+    for (size_t i = *anchored ? 1 : 0;  i < raw.size();  ++i) {
+        char c = raw[i];
+        if (c == '?' || c == '*' || c == '{') {
+            // A quantifier makes the preceding character optional or
+            // repeated, so it can't be part of the required prefix
+            if (!result.empty())
+                result.pop_back();
+            break;
+        }
+        if (c == '+') {
+            // At least one occurrence is required; keep it and stop
+            break;
+        }
+        if (c == '(' || c == '[' || c == '\\' || c == '.'
+            || c == '^' || c == '$' || (unsigned char)c >= 128)
+            break;
+        result += c;
+    }
+    return result;
+}
+
 /** Helper class that takes care of regular expression application whether
     it's a constant value or not.
 */
 struct RegexHelper {
     RegexHelper(BoundSqlExpression expr_)
-        : expr(std::move(expr_))
+        : expr(std::move(expr_)),
+          prefixAnchored(false)
     {
         if (expr.metadata.isConstant) {
             isPrecompiled = true;
             precompiled = compile(expr.constantValue());
+            literalPrefix = regexLiteralPrefix
+                (expr.constantValue().toUtf8String(), &prefixAnchored);
+        }
+        else {
+            isPrecompiled = false;
+            cache = std::make_shared<ProgramCache>();
         }
-        else isPrecompiled = false;
     }
 
     boost::u32regex compile(const ExpressionValue & val) const
@@ -942,6 +992,61 @@ struct RegexHelper {
         }
     }
 
+    /// Compiled programs for the patterns seen at run time, for when the
+    /// pattern expression isn't constant but takes few distinct values
+    /// (eg, a pattern read from a joined column).  Shared between copies
+    /// of the bound function, which may be called from several threads.
+    struct ProgramCache {
+        std::mutex mutex;
+        std::map<Utf8String, boost::u32regex> programs;
+    };
+
+    /** Return the compiled program for the given pattern value, reusing
+        a previously compiled one when the same pattern was already seen
+        by this bound expression.
+    */
+    boost::u32regex getCompiled(const ExpressionValue & val) const
+    {
+        Utf8String regexStr;
+        try {
+            regexStr = val.toUtf8String();
+        } JML_CATCH_ALL {
+            return compile(val);  // produce the standard error message
+        }
+
+        std::unique_lock<std::mutex> guard(cache->mutex);
+        auto it = cache->programs.find(regexStr);
+        if (it != cache->programs.end())
+            return it->second;
+
+        // Bound the memory taken by adversarially unique patterns
+        if (cache->programs.size() >= 256)
+            cache->programs.clear();
+
+        auto program = compile(val);
+        cache->programs.emplace(std::move(regexStr), program);
+        return program;
+    }
+
+    /** Pre-filter on the literal prefix of a constant pattern.  Returns
+        true when str can't possibly be accepted by the regex: when the
+        prefix must be at the start of the string (full matches and
+        anchored searches) it's a plain byte compare; otherwise the
+        prefix must at least occur somewhere in the string.
+    */
+    bool cannotMatch(const Utf8String & str, bool mustBeAtStart) const
+    {
+        if (literalPrefix.empty())
+            return false;
+        const std::string & raw = str.rawString();
+        if (mustBeAtStart || prefixAnchored) {
+            return raw.length() < literalPrefix.length()
+                || std::memcmp(raw.data(), literalPrefix.data(),
+                               literalPrefix.length()) != 0;
+        }
+        return raw.find(literalPrefix) == std::string::npos;
+    }
+
     /// The expression that the regex came from, to help with error messages
     BoundSqlExpression expr;
 
@@ -951,6 +1056,15 @@ struct RegexHelper {
     /// Is it actually constant (and precompiled), or computed on the fly?
     bool isPrecompiled;
 
+    /// Literal prefix of a constant pattern; empty if none is usable
+    std::string literalPrefix;
+
+    /// Did the constant pattern begin with '^'?
+    bool prefixAnchored;
+
+    /// Run-time program cache, for non-constant patterns only
+    std::shared_ptr<ProgramCache> cache;
+
     virtual ExpressionValue apply(const std::vector<ExpressionValue> & args,
                                   const SqlRowScope & scope,
                                   const boost::u32regex & regex) const = 0;
@@ -962,7 +1076,7 @@ struct RegexHelper {
             return apply(args, scope, precompiled);
         }
         else {
-            return apply(args, scope, compile(args.at(1)));
+            return apply(args, scope, getCompiled(args.at(1)));
         }
     }
 };
@@ -982,6 +1096,13 @@ struct ApplyRegexReplace: public RegexHelper {
         if (args[0].empty() || args[1].empty() || args[2].empty())
             return ExpressionValue::null(calcTs(args[0], args[1], args[2]));
 
+        if (isPrecompiled
+            && cannotMatch(args[0].toUtf8String(), false /* at start */)) {
+            // Nothing can match, so nothing can be replaced
+            return ExpressionValue(args[0].toUtf8String(),
+                                   calcTs(args[0], args[1], args[2]));
+        }
+
         std::basic_string<char32_t> matchStr = args[0].toWideString();
         std::basic_string<char32_t> replacementStr = args[2].toWideString();
 
@@ -1025,8 +1146,13 @@ struct ApplyRegexMatch: public RegexHelper {
         if (args[0].empty() || args[1].empty())
             return ExpressionValue::null(calcTs(args[0], args[1]));
 
+        // A full match always starts at the beginning of the string
+        if (isPrecompiled
+            && cannotMatch(args[0].toUtf8String(), true /* at start */))
+            return ExpressionValue(false, calcTs(args[0], args[1]));
+
         std::basic_string<char32_t> matchStr = args[0].toWideString();
-        
+
         auto result = boost::u32regex_match(matchStr.begin(), matchStr.end(),
                                             regex);
         return ExpressionValue(result, calcTs(args[0], args[1]));
@@ -1061,8 +1187,12 @@ struct ApplyRegexSearch: public RegexHelper {
         if (args[0].empty() || args[1].empty())
             return ExpressionValue::null(calcTs(args[0], args[1]));
 
+        if (isPrecompiled
+            && cannotMatch(args[0].toUtf8String(), false /* at start */))
+            return ExpressionValue(false, calcTs(args[0], args[1]));
+
         std::basic_string<char32_t> searchStr = args[0].toWideString();
-        
+
         auto result = boost::u32regex_search(searchStr.begin(), searchStr.end(),
                                             regex);
         return ExpressionValue(result, calcTs(args[0], args[1]));
@@ -1919,6 +2049,25 @@ ParseTokenizeArguments(Utf8String& splitchar, Utf8String& quotechar,
     }
 }
 
+/** The parsed options row of tokenize()/token_extract(). */
+struct TokenizeOptions {
+    Utf8String splitchar = ",";
+    Utf8String quotechar = "";
+    int offset = 0;
+    int limit = -1;
+    int min_token_length = 1;
+    ML::distribution<float, std::vector<float> > ngram_range = {1, 1};
+    ExpressionValue values;
+    bool check[7] = {false, false, false, false, false, false, false};
+
+    void parse(const ExpressionValue::Structured & argRow)
+    {
+        ParseTokenizeArguments(splitchar, quotechar, offset, limit,
+                               min_token_length, ngram_range, values,
+                               check, argRow);
+    }
+};
+
 BoundFunction tokenize(const std::vector<BoundSqlExpression> & args)
 {
     if (args.size() == 0)
@@ -1927,6 +2076,14 @@ BoundFunction tokenize(const std::vector<BoundSqlExpression> & args)
     if (args.size() > 2)
         throw HttpReturnException(400, "requires at most two arguments");
 
+    // The options row is almost always a literal; parse it once at
+    // bind time instead of once per row
+    std::shared_ptr<const TokenizeOptions> constOptions;
+    if (args.size() == 2 && args[1].metadata.isConstant) {
+        auto options = std::make_shared<TokenizeOptions>();
+        options->parse(args[1].constantValue().getStructured());
+        constOptions = std::move(options);
+    }
 
     // Comma separated list, first is row name, rest are row columns
     return {[=] (const std::vector<ExpressionValue> & args,
@@ -1936,26 +2093,20 @@ BoundFunction tokenize(const std::vector<BoundSqlExpression> & args)
 
                 Utf8String text = args[0].toUtf8String();
 
-                Utf8String splitchar = ",";
-                Utf8String quotechar = "";
-                int offset = 0;
-                int limit = -1;
-                int min_token_length = 1;
-                ML::distribution<float, std::vector<float> > ngram_range = {1, 1};
-                ExpressionValue values;
-                bool check[] = {false, false, false, false, false, false, false};
-
-                if (args.size() == 2)
-                    ParseTokenizeArguments(splitchar, quotechar, offset, limit,
-                                           min_token_length, ngram_range, values,
-                                           check, args.at(1).getStructured());
+                TokenizeOptions localOptions;
+                const TokenizeOptions * options = &localOptions;
+                if (constOptions)
+                    options = constOptions.get();
+                else if (args.size() == 2)
+                    localOptions.parse(args.at(1).getStructured());
 
                 ML::Parse_Context pcontext(text.rawData(), text.rawData(), text.rawLength());
 
                 std::unordered_map<Utf8String, int> bagOfWords;
 
-                tokenize(bagOfWords, pcontext, splitchar, quotechar, offset, limit,
-                        min_token_length, ngram_range);
+                tokenize(bagOfWords, pcontext, options->splitchar,
+                         options->quotechar, options->offset, options->limit,
+                         options->min_token_length, options->ngram_range);
 
                 RowValue row;
                 row.reserve(bagOfWords.size());
@@ -1963,15 +2114,15 @@ BoundFunction tokenize(const std::vector<BoundSqlExpression> & args)
                 auto it = bagOfWords.begin();
 
                 while (it != bagOfWords.end()) {
-                    if (check[4]) //values
+                    if (options->check[4]) //values
                     {
-                        if (!values.isAtom())
+                        if (!options->values.isAtom())
                           throw HttpReturnException(400, ML::format("requires 'value' "
                                 "argument be a scalar, got type '%s'",
-                                values.getTypeAsString()));
+                                options->values.getTypeAsString()));
 
                         row.emplace_back(ColumnName(it->first),
-                                     values.getAtom(),
+                                     options->values.getAtom(),
                                      ts);
                         ++it;
                     }
@@ -2002,6 +2153,15 @@ BoundFunction token_extract(const std::vector<BoundSqlExpression> & args)
     if (args.size() > 3)
         throw HttpReturnException(400, "requires at most three arguments");
 
+    // As for tokenize(), a literal options row is parsed at bind time
+    std::shared_ptr<const TokenizeOptions> constOptions;
+    if (args.size() == 3 && args[2].metadata.isConstant) {
+        auto options = std::make_shared<TokenizeOptions>();
+        options->limit = 1;
+        options->parse(args[2].constantValue().getStructured());
+        constOptions = std::move(options);
+    }
+
     return {[=] (const std::vector<ExpressionValue> & args,
                  const SqlRowScope & scope) -> ExpressionValue
             {
@@ -2009,27 +2169,26 @@ BoundFunction token_extract(const std::vector<BoundSqlExpression> & args)
 
                 Utf8String text = args[0].toUtf8String();
 
-                Utf8String splitchar = ",";
-                Utf8String quotechar = "";
-                int offset = 0;
-                int limit = 1;
-                int min_token_length = 1;
-                ML::distribution<float, std::vector<float> > ngram_range;
-                ExpressionValue values;
-                bool check[] = {false, false, false, false, false, false, false};
+                TokenizeOptions localOptions;
+                const TokenizeOptions * options = &localOptions;
+                if (constOptions)
+                    options = constOptions.get();
+                else {
+                    localOptions.limit = 1;
+                    if (args.size() == 3)
+                        localOptions.parse(args.at(2).getStructured());
+                }
 
                 int nth = args.at(1).toInt();
 
-                if (args.size() == 3)
-                    ParseTokenizeArguments(splitchar, quotechar, offset, limit, min_token_length,
-                                           ngram_range, values, check, args.at(2).getStructured());
-
                 ML::Parse_Context pcontext(text.rawData(), text.rawData(), text.rawLength());
 
                 ExpressionValue result;
 
-                Utf8String output = token_extract(pcontext, splitchar, quotechar, offset, limit,
-                        nth, min_token_length);
+                Utf8String output = token_extract
+                    (pcontext, options->splitchar, options->quotechar,
+                     options->offset, options->limit,
+                     nth, options->min_token_length);
 
                 if (output != "")
                     result = ExpressionValue(output, ts);
@@ -2530,6 +2689,63 @@ BoundFunction extract_column(const std::vector<BoundSqlExpression> & args)
 
 static RegisterBuiltin registerExtractColumn(extract_column, "extract_column");
 
+/** Case-fold a pure ASCII string, 16 bytes at a time where possible.
+    ASCII letters differ from their other-case counterpart only in bit
+    0x20, so we compute a letter mask and flip the bit.  Only valid for
+    ASCII data; UTF-8 strings go through the code point based path.
+*/
+template<bool Upper>
+static void asciiChangeCase(const char * p, size_t len, char * out)
+{
+    const char * end = p + len;
+    const char first = Upper ? 'a' : 'A';
+    const char last  = Upper ? 'z' : 'Z';
+
+#if defined(__SSE2__)
+    __m128i lo  = _mm_set1_epi8(first - 1);
+    __m128i hi  = _mm_set1_epi8(last + 1);
+    __m128i bit = _mm_set1_epi8(0x20);
+
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        __m128i isLetter
+            = _mm_and_si128(_mm_cmpgt_epi8(block, lo),
+                            _mm_cmplt_epi8(block, hi));
+        block = _mm_xor_si128(block, _mm_and_si128(isLetter, bit));
+        _mm_storeu_si128((__m128i *)out, block);
+        p += 16;
+        out += 16;
+    }
+#endif // __SSE2__
+
+    for (; p != end;  ++p, ++out) {
+        char c = *p;
+        if (c >= first && c <= last)
+            c ^= 0x20;
+        *out = c;
+    }
+}
+
+template<bool Upper>
+static ExpressionValue changeCase(const ExpressionValue & arg)
+{
+    CellValue atom = arg.getAtom();
+
+    if (atom.isAsciiString()) {
+        std::string folded(atom.toStringLength(), 0);
+        asciiChangeCase<Upper>(atom.stringChars(), folded.size(),
+                               &folded[0]);
+        return ExpressionValue(Utf8String(std::move(folded),
+                                          false /* check */),
+                               arg.getEffectiveTimestamp());
+    }
+
+    return ExpressionValue(Upper
+                           ? atom.toUtf8String().toUpper()
+                           : atom.toUtf8String().toLower(),
+                           arg.getEffectiveTimestamp());
+}
+
 BoundFunction lower(const std::vector<BoundSqlExpression> & args)
 {
     // Return an expression but with the timestamp modified to something else
@@ -2541,9 +2757,7 @@ BoundFunction lower(const std::vector<BoundSqlExpression> & args)
                  const SqlRowScope & scope) -> ExpressionValue
             {
                 ExcAssertEqual(args.size(), 1);
-                ExpressionValue result(args[0].getAtom().toUtf8String().toLower(),
-                                       args[0].getEffectiveTimestamp());
-                return result;
+                return changeCase<false /* upper */>(args[0]);
             },
             std::make_shared<Utf8StringValueInfo>()
             };
@@ -2562,9 +2776,7 @@ BoundFunction upper(const std::vector<BoundSqlExpression> & args)
                  const SqlRowScope & scope) -> ExpressionValue
             {
                 ExcAssertEqual(args.size(), 1);
-                ExpressionValue result(args[0].getAtom().toUtf8String().toUpper(),
-                                       args[0].getEffectiveTimestamp());
-                return result;
+                return changeCase<true /* upper */>(args[0]);
             },
             std::make_shared<Utf8StringValueInfo>()
     };
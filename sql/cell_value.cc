@@ -21,12 +21,85 @@
 #include "path.h"
 #include "mldb/ext/s2/s2.h"
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 using namespace std;
 
 
 namespace Datacratic {
 namespace MLDB {
 
+namespace {
+
+/* Most string cells are short: categorical values of a few tens of
+   bytes that just miss the inline representation.  Allocating their
+   StringRepr with malloc puts a malloc/free pair on every such cell,
+   which dominates import and scan of string columns.  Instead, any
+   representation that fits in a fixed-size block is recycled through a
+   per-thread free list: freeing pushes the block, allocating pops one,
+   and only the first use of a block ever reaches malloc.
+
+   A cell may be freed on a different thread than the one that
+   allocated it; the block then simply joins the freeing thread's list.
+   The list is capped to bound the memory an idle thread holds on to.
+*/
+
+struct StringReprPool {
+    /// Block size; covers the StringRepr header plus strings of up to
+    /// 47 bytes, past which malloc is used directly
+    static constexpr size_t POOLED_BYTES = 64;
+
+    /// Maximum blocks kept per thread
+    static constexpr size_t MAX_FREE = 8192;
+
+    std::vector<void *> blocks;
+    bool stopped = false;
+
+    ~StringReprPool()
+    {
+        for (void * block: blocks)
+            ::free(block);
+        blocks.clear();
+        // Cells destroyed after this thread's pool (eg statics at
+        // process exit) fall back to plain malloc/free
+        stopped = true;
+    }
+};
+
+thread_local StringReprPool stringReprPool;
+
+void * allocateStringRepr(size_t bytes)
+{
+    if (bytes <= StringReprPool::POOLED_BYTES) {
+        StringReprPool & pool = stringReprPool;
+        if (!pool.stopped && !pool.blocks.empty()) {
+            void * block = pool.blocks.back();
+            pool.blocks.pop_back();
+            return block;
+        }
+        // Allocate a whole block, so that once freed it can serve any
+        // pooled size
+        bytes = StringReprPool::POOLED_BYTES;
+    }
+    return malloc(bytes);
+}
+
+void freeStringRepr(void * mem, size_t bytes)
+{
+    if (bytes <= StringReprPool::POOLED_BYTES) {
+        StringReprPool & pool = stringReprPool;
+        if (!pool.stopped && pool.blocks.size() < StringReprPool::MAX_FREE) {
+            pool.blocks.push_back(mem);
+            return;
+        }
+    }
+    ::free(mem);
+}
+
+} // file scope
+
 /*****************************************************************************/
 /* CELL VALUE                                                                */
 /*****************************************************************************/
@@ -43,7 +116,7 @@ CellValue(const Path & path)
         type = ST_SHORT_PATH;
     }
     else {
-        void * mem = malloc(sizeof(StringRepr) + strLength);
+        void * mem = allocateStringRepr(sizeof(StringRepr) + strLength + 1);
         longString = new (mem) StringRepr;
         std::copy(u.rawData(), u.rawData() + strLength, longString->repr);
         type = ST_LONG_PATH;
@@ -164,10 +237,10 @@ initString(const char * stringValue, size_t len, bool isUtf8, bool check)
         else {
             type = ST_ASCII_LONG_STRING;
         }
-        void * mem = malloc(sizeof(StringRepr) + strLength + 1);
+        void * mem = allocateStringRepr(sizeof(StringRepr) + strLength + 1);
         longString = new (mem) StringRepr;
         std::copy(s, e, longString->repr);
-        longString->repr[strLength + 1] = 0;
+        longString->repr[strLength] = 0;
     }
 }
 
@@ -181,7 +254,7 @@ initBlob(const char * data, size_t len)
         type = ST_SHORT_BLOB;
     }
     else {
-        void * mem = malloc(sizeof(StringRepr) + len);
+        void * mem = allocateStringRepr(sizeof(StringRepr) + len + 1);
         longString = new (mem) StringRepr;
         std::copy(data, data + len, longString->repr);
         type = ST_LONG_BLOB;
@@ -196,7 +269,7 @@ CellValue(const CellValue & other)
         || other.type == ST_UTF8_LONG_STRING
         || other.type == ST_LONG_BLOB
         || other.type == ST_LONG_PATH) {
-        void * mem = malloc(sizeof(StringRepr) + other.strLength + 1);
+        void * mem = allocateStringRepr(sizeof(StringRepr) + other.strLength + 1);
         longString = new (mem) StringRepr;
         std::copy(other.longString->repr, other.longString->repr + strLength,
                   longString->repr);
@@ -1033,8 +1106,11 @@ CellValue::
 deleteString()
 {
     if (longString) {
+        // All of the long representations allocate this much; the size
+        // picks the free list the block goes back to
+        size_t bytes = sizeof(StringRepr) + strLength + 1;
         longString->~StringRepr();
-        free(longString);
+        freeStringRepr(longString, bytes);
     }
     type = ST_EMPTY;
     longString = nullptr;
@@ -1200,16 +1276,43 @@ extractStructuredJson(JsonPrintingContext & context) const
         context.startObject();
         context.startMember("blob");
         context.startArray();
-            
+
         // Chunks of ASCII are written as a string; non-ASCII is
         // as integers.
         const unsigned char * p = blobData();
         const unsigned char * e = p + blobLength();
 
+        // Scan to the end of the run of printable ASCII (' ' to '~')
+        // starting at p.  For blobs of mostly text (or mostly binary)
+        // the runs are long, so on SSE2 machines they are swept 16
+        // bytes at a time; the scalar loop is the tail and fallback.
+        auto scanPrintable = [e] (const unsigned char * p)
+            {
+#if defined(__SSE2__)
+                __m128i low = _mm_set1_epi8(' ' - 1);
+                __m128i high = _mm_set1_epi8(127);
+
+                while (e - p >= 16) {
+                    __m128i block
+                        = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                    // Bytes >= 128 are negative in the signed compares,
+                    // so they fail the lower bound as they should
+                    int printable = _mm_movemask_epi8
+                        (_mm_and_si128(_mm_cmpgt_epi8(block, low),
+                                       _mm_cmplt_epi8(block, high)));
+                    if (printable != 0xffff)
+                        return p + __builtin_ctz(~printable & 0xffff);
+                    p += 16;
+                }
+#endif // __SSE2__
+                while (p < e && *p >= ' ' && *p < 127)
+                    ++p;
+                return p;
+            };
+
         while (p < e) {
             const unsigned char * s = p;
-            while (p < e && *p >= ' ' && *p < 127 && isascii(*p))
-                ++p;
+            p = scanPrintable(p);
             size_t len = p - s;
             //cerr << "len = " << len << endl;
             if (len == 1) {
@@ -1331,6 +1434,10 @@ struct CellValueDescription: public ValueDescriptionT<CellValue> {
                     if (v["blob"].type() != Json::arrayValue) {
                         throw HttpReturnException(400, "JSON blob is not an array: '" + v.toStringNoNewLine() + "'");
                     }
+                    // Each element is at least one byte, so this never
+                    // over-reserves by much and avoids the realloc
+                    // cascade of growing a byte at a time
+                    contents.reserve(v["blob"].size());
                     for (auto & v2: v["blob"]) {
                         if (v2.isUInt() || v2.isInt()) {
                             uint64_t val = v2.asUInt();
@@ -146,7 +146,7 @@ struct CellValue {
     ~CellValue()
     {
         if (type == ST_ASCII_LONG_STRING || type == ST_UTF8_LONG_STRING
-            || type == ST_LONG_BLOB)
+            || type == ST_LONG_BLOB || type == ST_LONG_PATH)
             deleteString();
     }
 
@@ -9,6 +9,9 @@
 
 #include "mldb/types/date.h"
 #include "mldb/types/value_description_fwd.h"
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
 
 
 namespace Datacratic {
@@ -51,9 +54,23 @@ bool
 CellValue::
 hasNonAsciiChar(const char *start, unsigned int len) const
 {
-    for(unsigned i = 0 ; i < len;++i)
-    {
-        if ((unsigned int)start[i] > 127)
+    const char * p = start;
+    const char * end = start + len;
+
+#if defined(__SSE2__)
+    // _mm_movemask_epi8 gathers the high bit of each byte, which is
+    // exactly the non-ASCII test, 16 bytes at a time
+    while (end - p >= 16) {
+        __m128i block
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        if (_mm_movemask_epi8(block))
+            return true;
+        p += 16;
+    }
+#endif // __SSE2__
+
+    for (; p != end;  ++p) {
+        if ((unsigned int)*p > 127)
             return true;
     }
     return false;
@@ -27,16 +27,119 @@ MatrixRowDescription()
     addField("columns", &MatrixRow::columns, "Columns active for this row");
 }
 
-DEFINE_STRUCTURE_DESCRIPTION(MatrixNamedRow);
+/* MatrixNamedRow is the envelope of every query result row, so its
+   description is written out by hand rather than macro-generated: the
+   serializer emits the fields in straight-line code against cached leaf
+   descriptions instead of going through the generic per-field dispatch
+   in StructureDescriptionBase::printJson.  The field table is still
+   registered, so parsing, documentation and introspection behave
+   exactly as before.
+*/
+
+struct MatrixNamedRowDescription
+    :  public Datacratic::StructureDescription<MatrixNamedRow> {
+    MatrixNamedRowDescription();
+
+    MatrixNamedRowDescription(const Datacratic::ConstructOnly &);
+
+    virtual void initialize()
+    {
+        MatrixNamedRowDescription newMe;
+        *this = std::move(newMe);
+    }
+
+    virtual void printJson(const void * input,
+                           JsonPrintingContext & context) const;
+
+    std::shared_ptr<const ValueDescriptionT<Path> > pathDesc;
+    std::shared_ptr<const ValueDescriptionT<RowHash> > rowHashDesc;
+    std::shared_ptr<const ValueDescriptionT<CellValue> > cellDesc;
+    std::shared_ptr<const ValueDescriptionT<Date> > dateDesc;
+
+    struct Regme;
+    static Regme regme;
+};
+
+struct MatrixNamedRowDescription::Regme {
+    bool done;
+    Regme()
+        : done(false)
+    {
+        Datacratic::registerValueDescription
+            (typeid(MatrixNamedRow),
+             [] () { return new MatrixNamedRowDescription(); }, true);
+    }
+};
+
+MatrixNamedRowDescription::
+MatrixNamedRowDescription(const Datacratic::ConstructOnly &)
+{
+    regme.done = true;
+}
+
+Datacratic::ValueDescriptionT<MatrixNamedRow> *
+getDefaultDescription(MatrixNamedRow *)
+{
+    return new MatrixNamedRowDescription();
+}
+
+Datacratic::ValueDescriptionT<MatrixNamedRow> *
+getDefaultDescriptionUninitialized(MatrixNamedRow *)
+{
+    return new MatrixNamedRowDescription(::Datacratic::constructOnly);
+}
+
+MatrixNamedRowDescription::Regme MatrixNamedRowDescription::regme;
 
 MatrixNamedRowDescription::
 MatrixNamedRowDescription()
+    : pathDesc(getDefaultDescriptionSharedT<Path>()),
+      rowHashDesc(getDefaultDescriptionSharedT<RowHash>()),
+      cellDesc(getDefaultDescriptionSharedT<CellValue>()),
+      dateDesc(getDefaultDescriptionSharedT<Date>())
 {
     addField("rowName", &MatrixNamedRow::rowName, "Name of the row");
     addField("rowHash", &MatrixNamedRow::rowHash, "Hash of the row");
     addField("columns", &MatrixNamedRow::columns, "Columns active for this row");
 }
 
+void
+MatrixNamedRowDescription::
+printJson(const void * input, JsonPrintingContext & context) const
+{
+    auto * row = reinterpret_cast<const MatrixNamedRow *>(input);
+
+    context.startObject();
+
+    if (!pathDesc->isDefaultTyped(&row->rowName)) {
+        context.startMember("rowName", 7);
+        pathDesc->printJsonTyped(&row->rowName, context);
+    }
+    if (!rowHashDesc->isDefaultTyped(&row->rowHash)) {
+        context.startMember("rowHash", 7);
+        rowHashDesc->printJsonTyped(&row->rowHash, context);
+    }
+
+    // The columns dominate the payload; the tuples are emitted inline
+    // rather than through the vector and tuple descriptions.
+    context.startMember("columns", 7);
+    context.startArray(row->columns.size());
+    for (auto & c: row->columns) {
+        context.newArrayElement();
+        context.startArray(3);
+        context.newArrayElement();
+        pathDesc->printJsonTyped(&std::get<0>(c), context);
+        context.newArrayElement();
+        cellDesc->printJsonTyped(&std::get<1>(c), context);
+        context.newArrayElement();
+        dateDesc->printJsonTyped(&std::get<2>(c), context);
+        context.endArray();
+    }
+    context.endArray();
+
+    context.endObject();
+}
+
 DEFINE_STRUCTURE_DESCRIPTION(MatrixEvent);
 
 MatrixEventDescription::
@@ -36,6 +36,61 @@ PipelineResultsDescription()
 }
 
 
+/*****************************************************************************/
+/* EXECUTION EXPLAIN                                                         */
+/*****************************************************************************/
+
+namespace {
+
+__thread ExecutionExplain * currentExecutionExplain = nullptr;
+
+} // file scope
+
+void
+ExecutionExplain::
+record(Operator op)
+{
+    std::unique_lock<std::mutex> guard(mutex);
+    operators.emplace_back(std::move(op));
+}
+
+ExecutionExplain *
+ExecutionExplain::
+current()
+{
+    return currentExecutionExplain;
+}
+
+ExecutionExplain::Guard::
+Guard(ExecutionExplain * explain)
+    : saved(currentExecutionExplain)
+{
+    currentExecutionExplain = explain;
+}
+
+ExecutionExplain::Guard::
+~Guard()
+{
+    currentExecutionExplain = saved;
+}
+
+
+/*****************************************************************************/
+/* ELEMENT EXECUTOR                                                          */
+/*****************************************************************************/
+
+ElementExecutor::
+~ElementExecutor()
+{
+    if (explain && !explainName.empty()) {
+        ExecutionExplain::Operator op;
+        op.name = explainName;
+        op.rowsOut = rowsOut.load(std::memory_order_relaxed);
+        explain->record(std::move(op));
+    }
+}
+
+
 /*****************************************************************************/
 /* LEXICAL SCOPE                                                             */
 /*****************************************************************************/
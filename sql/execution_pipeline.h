@@ -10,6 +10,9 @@
 #include "sql_expression.h"
 #include "binding_contexts.h"
 #include "table_expression_operations.h"
+#include "mldb/compiler/compiler.h"
+#include <atomic>
+#include <mutex>
 
 namespace Datacratic {
 namespace MLDB {
@@ -210,18 +213,74 @@ private:
 };
 
 
+/*****************************************************************************/
+/* EXECUTION EXPLAIN                                                         */
+/*****************************************************************************/
+
+/** Per-query record of which operators ran and how many rows flowed
+    through each.  Like the predicate reorder counter, the collector is
+    armed through a thread local so that the SQL layer doesn't depend on
+    the server's profiling objects: executors pick the pointer up when
+    they are constructed (on the request thread) and append their record
+    once they are destroyed, so the chain reads from the last operator
+    back to the source.  An operator's rows in are the rows out of its
+    upstream operator.
+*/
+struct ExecutionExplain {
+    struct Operator {
+        std::string name;       ///< Operator and chosen strategy
+        uint64_t rowsIn = 0;    ///< Rows consumed, when the operator knows
+        uint64_t rowsOut = 0;   ///< Rows produced
+    };
+
+    std::mutex mutex;
+    std::vector<Operator> operators;
+
+    void record(Operator op);
+
+    /// Collector armed for the current query, or nullptr
+    static ExecutionExplain * current();
+
+    /// Makes the given collector current() for its lifetime
+    struct Guard {
+        Guard(ExecutionExplain * explain);
+        ~Guard();
+
+        Guard(const Guard &) = delete;
+        void operator = (const Guard &) = delete;
+
+    private:
+        ExecutionExplain * saved;
+    };
+};
+
+
 /*****************************************************************************/
 /* ELEMENT EXECUTOR                                                          */
 /*****************************************************************************/
 
 struct ElementExecutor {
 
-    virtual ~ElementExecutor()
+    ElementExecutor()
+        : explain(ExecutionExplain::current()),
+          rowsOut(0)
     {
     }
 
+    virtual ~ElementExecutor();
+
+    /** Take one element from the pipeline, counting it towards the
+        explain output when the query is being profiled. */
+    std::shared_ptr<PipelineResults> take()
+    {
+        auto result = takeImpl();
+        if (JML_UNLIKELY(explain != nullptr) && result)
+            rowsOut.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
     /** Take one element from the pipeline. */
-    virtual std::shared_ptr<PipelineResults> take() = 0;
+    virtual std::shared_ptr<PipelineResults> takeImpl() = 0;
 
     /** Take all elements from the pipeline.  inParallel describes whether
         the function can be called from multiple threads at once.
@@ -230,6 +289,16 @@ struct ElementExecutor {
 
     /** Restart the executor from the start. */
     virtual void restart() = 0;
+
+    /// Name reported in the query's explain output; executors that are
+    /// pure plumbing leave it empty and stay hidden
+    std::string explainName;
+
+    /// Explain collector for the current query, or null
+    ExecutionExplain * const explain;
+
+    /// Rows produced so far, counted only when explain is armed
+    std::atomic<uint64_t> rowsOut;
 };
 
 
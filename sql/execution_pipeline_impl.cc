@@ -15,6 +15,7 @@
 #include "table_expression_operations.h"
 #include <algorithm>
 #include "mldb/sql/sql_expression_operations.h"
+#include "mldb/core/dataset.h"
 
 using namespace std;
 
@@ -263,7 +264,7 @@ generateMore(SqlRowScope & rowScope)
 
 std::shared_ptr<PipelineResults>
 GenerateRowsExecutor::
-take()
+takeImpl()
 {
     // Return the row itself as the value, and the row's name as
     // metadata.
@@ -344,6 +345,7 @@ GenerateRowsElement::Bound::
 start(const BoundParameters & getParam) const
 {
     auto result = std::make_shared<GenerateRowsExecutor>();
+    result->explainName = "generate";
     result->source = source_->start(getParam);
     result->generator
         = parent->from.runQuery(*outputScope_,
@@ -442,7 +444,7 @@ SubSelectExecutor(std::shared_ptr<BoundPipelineElement> boundSelect,
 
 std::shared_ptr<PipelineResults>
 SubSelectExecutor::
-take()
+takeImpl()
 {
     auto subResult = pipeline->take();
     if (subResult)
@@ -508,6 +510,7 @@ SubSelectElement::Bound::
 start(const BoundParameters & getParam) const
 {
     auto result = std::make_shared<SubSelectExecutor>(boundSelect, getParam);
+    result->explainName = "subselect";
     return result;
 }
 
@@ -810,16 +813,46 @@ JoinElement(std::shared_ptr<PipelineElement> root,
     auto leftEmbedding = std::make_shared<EmbeddingLiteralExpression>(leftclauses.clauses);
     auto rightEmbedding = std::make_shared<EmbeddingLiteralExpression>(rightclauses.clauses);
 
+    // An inner equijoin whose right side is a small dataset is better
+    // done as a hash join: we build a hash table on the right side's
+    // pivot value and stream the left side through it, which avoids
+    // sorting either side.  The canonical case is a star-schema join
+    // against a dimension dataset.
+    useHashJoin = false;
+    if (condition.style == AnnotatedJoinCondition::EQUIJOIN
+        && joinQualification == JOIN_INNER
+        && boundRight.dataset) {
+        // What matters is how many rows end up in the hash table, not
+        // how many the right dataset holds: scale the row count
+        // estimate by the sampled selectivity of the right side's
+        // restriction, so a large dataset behind a selective filter
+        // still qualifies for the hash build.
+        double rightRows = boundRight.dataset->getRowCountEstimate();
+        double selectivity = boundRight.dataset
+            ->estimateWhereSelectivity(*rightCondition);
+        if (selectivity >= 0)
+            rightRows *= selectivity;
+        if (rightRows <= HASH_JOIN_MAX_BUILD_ROWS)
+            useHashJoin = true;
+    }
+
+    // The merge (equi) join needs both sides ordered on the pivot; the
+    // hash join doesn't care about order on either side.
+    auto leftOrderBy
+        = useHashJoin ? ORDER_BY_NOTHING : condition.left.orderBy;
+    auto rightOrderBy
+        = useHashJoin ? ORDER_BY_NOTHING : condition.right.orderBy;
+
     leftImpl= root
         ->where(constantWhere)
         ->from(left, boundLeft, when, selectAll, leftCondition,
-               condition.left.orderBy)
+               leftOrderBy)
         ->select(leftEmbedding);
 
     rightImpl = root
         ->where(constantWhere)
         ->from(right, boundRight, when, selectAll, rightCondition,
-               condition.right.orderBy)
+               rightOrderBy)
         ->select(rightEmbedding);
 }
 
@@ -831,7 +864,8 @@ bind() const
                                    leftImpl->bind(),
                                     rightImpl->bind(),
                                    condition,
-                                   joinQualification);
+                                   joinQualification,
+                                   useHashJoin);
 }
 
 
@@ -856,7 +890,7 @@ CrossJoinExecutor(const Bound * parent,
 
 std::shared_ptr<PipelineResults>
 JoinElement::CrossJoinExecutor::
-take()
+takeImpl()
 {
     bool outerLeft = parent->joinQualification_ == JOIN_LEFT
         || parent->joinQualification_ == JOIN_FULL;
@@ -1035,7 +1069,7 @@ takeMoreInput()
 */
 std::shared_ptr<PipelineResults>
 JoinElement::EquiJoinExecutor::
-take()
+takeImpl()
 {
     bool outerLeft = parent->joinQualification_ == JOIN_LEFT
         || parent->joinQualification_ == JOIN_FULL;
@@ -1215,6 +1249,94 @@ restart()
 }
 
 
+/*****************************************************************************/
+/* HASH JOIN EXECUTOR                                                        */
+/*****************************************************************************/
+
+JoinElement::HashJoinExecutor::
+HashJoinExecutor(const Bound * parent,
+                 std::shared_ptr<ElementExecutor> root,
+                 std::shared_ptr<ElementExecutor> left,
+                 std::shared_ptr<ElementExecutor> right)
+    : parent(parent),
+      root(std::move(root)),
+      left(std::move(left)),
+      right(std::move(right)),
+      matchIndex(0)
+{
+    ExcAssert(parent && this->root && this->left && this->right);
+
+    // Build phase: drain the right side into the hash table.  Null pivot
+    // values can never match an equijoin, so they are dropped here.
+    for (auto r = this->right->take();  r;  r = this->right->take()) {
+        ExpressionValue field = r->values.back().getColumn(0, GET_ALL);
+        if (field.empty())
+            continue;
+        uint64_t hash = field.hash();
+        hashTable[hash].emplace_back(std::move(field), std::move(r));
+    }
+
+    l = this->left->take();
+}
+
+std::shared_ptr<PipelineResults>
+JoinElement::HashJoinExecutor::
+takeImpl()
+{
+    // Probe phase: stream the left side through the hash table.  A left
+    // row with n matches produces n results over n calls, tracked by
+    // matchIndex.
+    while (l) {
+        ExpressionValue lField = l->values.back().getColumn(0, GET_ALL);
+
+        if (!lField.empty()) {
+            auto it = hashTable.find(lField.hash());
+            if (it != hashTable.end()) {
+                while (matchIndex < it->second.size()) {
+                    auto & entry = it->second[matchIndex++];
+                    if (entry.first != lField)
+                        continue;  // hash collision; not a real match
+
+                    auto & r = entry.second;
+
+                    // Same output layout as the equi join: left values
+                    // without the pivot embedding, then right values
+                    // without the pivot embedding.
+                    auto result = std::make_shared<PipelineResults>(*l);
+                    result->values.pop_back();
+                    for (size_t i = 0;  i + 1 < r->values.size();  ++i)
+                        result->values.push_back(r->values[i]);
+
+                    ExpressionValue storage;
+                    if (!parent->crossWhere_(*result, storage, GET_LATEST)
+                        .isTrue())
+                        continue;
+
+                    return result;
+                }
+            }
+        }
+
+        l = left->take();
+        matchIndex = 0;
+    }
+
+    // Nothing more found
+    return nullptr;
+}
+
+void
+JoinElement::HashJoinExecutor::
+restart()
+{
+    // The hash table only depends on the right side, so it survives a
+    // restart; only the left (probe) side rewinds.
+    left->restart();
+    l = left->take();
+    matchIndex = 0;
+}
+
+
 /*****************************************************************************/
 /* BOUND JOIN EXECUTOR                                                       */
 /*****************************************************************************/
@@ -1224,14 +1346,16 @@ Bound(std::shared_ptr<BoundPipelineElement> root,
       std::shared_ptr<BoundPipelineElement> left,
       std::shared_ptr<BoundPipelineElement> right,
       AnnotatedJoinCondition condition,
-      JoinQualification joinQualification)
+      JoinQualification joinQualification,
+      bool useHashJoin)
     : root_(std::move(root)),
       left_(std::move(left)),
       right_(std::move(right)),
       outputScope_(createOutputScope()),
       crossWhere_(condition.crossWhere->bind(*outputScope_)),
       condition_(std::move(condition)),
-      joinQualification_(joinQualification)
+      joinQualification_(joinQualification),
+      useHashJoin_(useHashJoin)
 {
 }
 
@@ -1271,21 +1395,36 @@ std::shared_ptr<ElementExecutor>
 JoinElement::Bound::
 start(const BoundParameters & getParam) const
 {
+    std::shared_ptr<ElementExecutor> result;
+
     switch (condition_.style) {
 
     case AnnotatedJoinCondition::CROSS_JOIN:
-        return std::make_shared<CrossJoinExecutor>
+        result = std::make_shared<CrossJoinExecutor>
             (this,
              root_->start(getParam),
              left_->start(getParam),
              right_->start(getParam));
+        result->explainName = "join.cross";
+        return result;
 
     case AnnotatedJoinCondition::EQUIJOIN:
-        return std::make_shared<EquiJoinExecutor>
+        if (useHashJoin_) {
+            result = std::make_shared<HashJoinExecutor>
+                (this,
+                 root_->start(getParam),
+                 left_->start(getParam),
+                 right_->start(getParam));
+            result->explainName = "join.hash";
+            return result;
+        }
+        result = std::make_shared<EquiJoinExecutor>
             (this,
              root_->start(getParam),
              left_->start(getParam),
              right_->start(getParam));
+        result->explainName = "join.equi";
+        return result;
 
     default:
         throw HttpReturnException(400, "Can't execute that kind of join",
@@ -1331,7 +1470,7 @@ bind() const
 
 std::shared_ptr<PipelineResults>
 RootElement::Executor::
-take()
+takeImpl()
 {
     return std::make_shared<PipelineResults>();
 }
@@ -1566,7 +1705,7 @@ bind() const
 
 std::shared_ptr<PipelineResults>
 FilterWhereElement::Executor::
-take()
+takeImpl()
 {
     while (true) {
         std::shared_ptr<PipelineResults> input = source_->take();
@@ -1614,6 +1753,7 @@ FilterWhereElement::Bound::
 start(const BoundParameters & getParam) const
 {
     auto result = std::make_shared<Executor>();
+    result->explainName = "where";
     result->parent_ = this;
     result->source_ = source_->start(getParam);
     return result;
@@ -1667,7 +1807,7 @@ bind() const
 
 std::shared_ptr<PipelineResults>
 SelectElement::Executor::
-take()
+takeImpl()
 {
     while (true) {
         std::shared_ptr<PipelineResults> input = source->take();
@@ -1712,6 +1852,7 @@ SelectElement::Bound::
 start(const BoundParameters & getParam) const
 {
     auto result = std::make_shared<Executor>();
+    result->explainName = "select";
     result->parent = this;
     result->source = source_->start(getParam);
     return result;
@@ -1765,7 +1906,7 @@ Executor(const Bound * parent,
 
 std::shared_ptr<PipelineResults>
 OrderByElement::Executor::
-take()
+takeImpl()
 {
     // We haven't returned anything yet.  Grab the entire set of results
     // from the input, sort it, and get it ready to serve up as results
@@ -1836,8 +1977,10 @@ std::shared_ptr<ElementExecutor>
 OrderByElement::Bound::
 start(const BoundParameters & getParam) const
 {
-    return std::make_shared<Executor>(this,
-                                      source_->start(getParam));
+    auto result = std::make_shared<Executor>(this,
+                                             source_->start(getParam));
+    result->explainName = "sort";
+    return result;
 }
 
 std::shared_ptr<BoundPipelineElement>
@@ -1995,7 +2138,7 @@ sameGroup(const std::vector<ExpressionValue> & group1,
 // Take a group at a time
 std::shared_ptr<PipelineResults>
 PartitionElement::Executor::
-take()
+takeImpl()
 {
     // If no more, we're done
     if (!first)
@@ -2046,10 +2189,12 @@ std::shared_ptr<ElementExecutor>
 PartitionElement::Bound::
 start(const BoundParameters & getParam) const
 {
-    return std::make_shared<Executor>
+    auto result = std::make_shared<Executor>
         (this, source_->start(getParam),
          source_->numOutputFields() - numValues_,
          source_->numOutputFields());
+    result->explainName = "partition";
+    return result;
 }
         
 std::shared_ptr<BoundPipelineElement>
@@ -2102,7 +2247,7 @@ Executor(std::shared_ptr<ElementExecutor> source,
 
 std::shared_ptr<PipelineResults>
 ParamsElement::Executor::
-take()
+takeImpl()
 {
     auto result = source_->take();
     result->getParam = getParam_;
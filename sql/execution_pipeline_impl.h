@@ -9,6 +9,7 @@
 
 #include "execution_pipeline.h"
 #include "join_utils.h"
+#include <unordered_map>
 
 namespace Datacratic {
 namespace MLDB {
@@ -74,7 +75,7 @@ struct GenerateRowsExecutor: public ElementExecutor {
 
     bool generateMore(SqlRowScope & scope);
 
-    virtual std::shared_ptr<PipelineResults> take();
+    virtual std::shared_ptr<PipelineResults> takeImpl();
 
     virtual void restart();
 };
@@ -169,7 +170,7 @@ struct SubSelectExecutor: public ElementExecutor {
     BoundParameters params;
     std::shared_ptr<ElementExecutor> pipeline;
 
-    virtual std::shared_ptr<PipelineResults> take();
+    virtual std::shared_ptr<PipelineResults> takeImpl();
 
     virtual void restart();
 };
@@ -313,6 +314,13 @@ struct JoinElement: public PipelineElement {
     AnnotatedJoinCondition condition;
     JoinQualification joinQualification;
 
+    /// Maximum right-side row count for which we'll build a hash table
+    /// rather than sorting both sides
+    static constexpr size_t HASH_JOIN_MAX_BUILD_ROWS = 65536;
+
+    /// True if the join will execute as a hash join; see HashJoinExecutor
+    bool useHashJoin;
+
     std::shared_ptr<PipelineElement> leftImpl;
     std::shared_ptr<PipelineElement> rightImpl;
 
@@ -333,7 +341,7 @@ struct JoinElement: public PipelineElement {
         
         std::shared_ptr<PipelineResults> l,r;
             
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
 
         void restart();
     };
@@ -360,7 +368,38 @@ struct JoinElement: public PipelineElement {
 
         void takeMoreInput();
             
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
+
+        virtual void restart();
+    };
+
+    /** Execution builds an in-memory hash table on the pivot value of the
+        (smaller) right side, then streams the left side through it.  This
+        avoids sorting either side; complexity is O(left rows + right rows)
+        with memory proportional to the right side.  It's used for inner
+        equijoins where the right side is a small dataset, eg the dimension
+        side of a star-schema join.
+    */
+    struct HashJoinExecutor: public ElementExecutor {
+        HashJoinExecutor(const Bound * parent,
+                         std::shared_ptr<ElementExecutor> root,
+                         std::shared_ptr<ElementExecutor> left,
+                         std::shared_ptr<ElementExecutor> right);
+
+        const Bound * parent;
+        std::shared_ptr<ElementExecutor> root, left, right;
+
+        /// Right side rows, keyed on the hash of their pivot value.  The
+        /// pivot value itself is kept to resolve hash collisions.
+        std::unordered_map<uint64_t,
+                           std::vector<std::pair<ExpressionValue,
+                                                 std::shared_ptr<PipelineResults> > > >
+            hashTable;
+
+        std::shared_ptr<PipelineResults> l;
+        size_t matchIndex;   ///< Next entry to try in the current bucket
+
+        virtual std::shared_ptr<PipelineResults> takeImpl();
 
         virtual void restart();
     };
@@ -375,7 +414,8 @@ struct JoinElement: public PipelineElement {
               std::shared_ptr<BoundPipelineElement> left,
               std::shared_ptr<BoundPipelineElement> right,
               AnnotatedJoinCondition condition,
-              JoinQualification joinQualification);
+              JoinQualification joinQualification,
+              bool useHashJoin);
 
         std::shared_ptr<BoundPipelineElement> root_;
         std::shared_ptr<BoundPipelineElement> left_;
@@ -384,6 +424,7 @@ struct JoinElement: public PipelineElement {
         BoundSqlExpression crossWhere_;
         AnnotatedJoinCondition condition_;
         JoinQualification joinQualification_;
+        bool useHashJoin_;
 
         /** Our output scope has:
             - The left and right tables
@@ -423,7 +464,7 @@ struct RootElement: public PipelineElement {
     struct Bound;
 
     struct Executor: public ElementExecutor {
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
         virtual void restart();
     };
 
@@ -508,7 +549,7 @@ struct FilterWhereElement: public PipelineElement {
         std::shared_ptr<ElementExecutor> source_;
         PipelineExpressionScope * context_;
 
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
 
         virtual void restart();
     };
@@ -562,7 +603,7 @@ struct SelectElement: public PipelineElement {
         const Bound * parent;
         std::shared_ptr<ElementExecutor> source;
 
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
 
         virtual void restart();
     };
@@ -618,7 +659,7 @@ struct OrderByElement: public PipelineElement {
         ssize_t numDone;
 
         // When we take elements, we take a group at a time
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
 
         virtual void restart();
     };
@@ -716,7 +757,7 @@ struct PartitionElement: public PipelineElement {
                        const std::vector<ExpressionValue> & group2) const;
 
         // Take a group at a time
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
 
         virtual void restart();
     };
@@ -768,7 +809,7 @@ struct ParamsElement: public PipelineElement {
         std::shared_ptr<ElementExecutor> source_;
         BoundParameters getParam_;
 
-        virtual std::shared_ptr<PipelineResults> take();
+        virtual std::shared_ptr<PipelineResults> takeImpl();
 
         virtual void restart();
     };
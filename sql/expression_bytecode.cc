@@ -0,0 +1,441 @@
+/** expression_bytecode.cc
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Implementation of the bytecode lowering of bound row expressions.
+*/
+
+#include "expression_bytecode.h"
+#include "sql_expression_operations.h"
+#include "mldb/sql/expression_value.h"
+#include "mldb/http/http_exception.h"
+#include <vector>
+
+using namespace std;
+
+
+namespace Datacratic {
+namespace MLDB {
+
+// Scalar arithmetic kernels, defined in sql_expression_operations.cc and
+// shared with the closure based execution so that lowered expressions
+// have exactly the same semantics (strings, timestamps, intervals, ...)
+CellValue binaryPlus(const CellValue & l, const CellValue & r);
+CellValue binaryMinus(const CellValue & l, const CellValue & r);
+CellValue binaryMultiplication(const CellValue & l, const CellValue & r);
+CellValue binaryDivision(const CellValue & l, const CellValue & r);
+CellValue binaryModulus(const CellValue & l, const CellValue & r);
+
+namespace {
+
+/*****************************************************************************/
+/* BYTECODE PROGRAM                                                          */
+/*****************************************************************************/
+
+enum Opcode : uint8_t {
+    OP_LOAD_COLUMN,    ///< dest = columns[a], evaluated on the row scope
+    OP_LOAD_CONSTANT,  ///< dest = constants[a]
+    OP_ADD,            ///< dest = regs[a] + regs[b], etc
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_EQ,
+    OP_NE,
+    OP_GT,
+    OP_LT,
+    OP_GE,
+    OP_LE,
+    OP_AND,
+    OP_OR,
+    OP_NOT             ///< dest = NOT regs[a]
+};
+
+/** One instruction of the flattened program.  Registers are in SSA form:
+    each is written exactly once per row, by the instruction that has it
+    as dest, before any instruction reads it.
+*/
+struct Instruction {
+    Opcode op;
+    uint16_t dest;
+    uint16_t a;
+    uint16_t b;
+};
+
+/** A register holds the atom result of one expression node: its cell
+    value (empty cell = SQL NULL) and its effective timestamp.
+*/
+struct Register {
+    CellValue value;
+    Date ts;
+};
+
+struct BytecodeProgram {
+    std::vector<Instruction> instructions;
+    std::vector<Register> constants;
+    std::vector<BoundSqlExpression> columns;
+    uint16_t numRegisters = 0;
+    uint16_t resultRegister = 0;
+
+    /// Original exec, run instead for rows where a load yields a
+    /// non-atom (eg a row valued column) so results never change
+    BoundSqlExpression::ExecFunction fallback;
+
+    const ExpressionValue &
+    execute(const SqlRowScope & row,
+            ExpressionValue & storage,
+            const VariableFilter & filter) const
+    {
+        // Scratch register file, reused from row to row so that the hot
+        // path doesn't allocate
+        static thread_local std::vector<Register> registers;
+        registers.resize(numRegisters);
+        Register * regs = registers.data();
+
+        for (const Instruction & inst: instructions) {
+            Register & dest = regs[inst.dest];
+
+            switch (inst.op) {
+
+            case OP_LOAD_COLUMN: {
+                ExpressionValue valStorage;
+                const ExpressionValue & val
+                    = columns[inst.a](row, valStorage, filter);
+                if (val.empty()) {
+                    dest.value = CellValue();
+                    dest.ts = val.getEffectiveTimestamp();
+                }
+                else if (val.isAtom()) {
+                    dest.value = val.getAtom();
+                    dest.ts = val.getEffectiveTimestamp();
+                }
+                else {
+                    // Not a scalar at runtime; this program doesn't
+                    // apply to this row
+                    return fallback(row, storage, filter);
+                }
+                break;
+            }
+
+            case OP_LOAD_CONSTANT:
+                dest = constants[inst.a];
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD: {
+                const Register & l = regs[inst.a];
+                const Register & r = regs[inst.b];
+                if (l.value.empty() || r.value.empty()) {
+                    // Matches the scalar Op::apply kernels, which return
+                    // the lhs when either side is null
+                    dest.value = l.value;
+                }
+                else {
+                    switch (inst.op) {
+                    case OP_ADD:
+                        dest.value = binaryPlus(l.value, r.value);  break;
+                    case OP_SUB:
+                        dest.value = binaryMinus(l.value, r.value);  break;
+                    case OP_MUL:
+                        dest.value = binaryMultiplication(l.value, r.value);
+                        break;
+                    case OP_DIV:
+                        dest.value = binaryDivision(l.value, r.value);  break;
+                    default:
+                        dest.value = binaryModulus(l.value, r.value);  break;
+                    }
+                }
+                dest.ts = std::max(l.ts, r.ts);
+                break;
+            }
+
+            case OP_EQ:
+            case OP_NE:
+            case OP_GT:
+            case OP_LT:
+            case OP_GE:
+            case OP_LE: {
+                const Register & l = regs[inst.a];
+                const Register & r = regs[inst.b];
+                Date ts = std::max(l.ts, r.ts);
+                if (l.value.empty() || r.value.empty()) {
+                    dest.value = CellValue();
+                }
+                else {
+                    bool res;
+                    switch (inst.op) {
+                    case OP_EQ: res = l.value == r.value;  break;
+                    case OP_NE: res = l.value != r.value;  break;
+                    case OP_GT: res = l.value >  r.value;  break;
+                    case OP_LT: res = l.value <  r.value;  break;
+                    case OP_GE: res = l.value >= r.value;  break;
+                    default:    res = l.value <= r.value;  break;
+                    }
+                    dest.value = CellValue(res);
+                }
+                dest.ts = ts;
+                break;
+            }
+
+            case OP_AND: {
+                const Register & l = regs[inst.a];
+                const Register & r = regs[inst.b];
+                if (l.value.isFalse() && r.value.isFalse()) {
+                    dest.value = CellValue(false);
+                    dest.ts = std::min(l.ts, r.ts);
+                }
+                else if (l.value.isFalse()) {
+                    dest.value = CellValue(false);
+                    dest.ts = l.ts;
+                }
+                else if (r.value.isFalse()) {
+                    dest.value = CellValue(false);
+                    dest.ts = r.ts;
+                }
+                else if (l.value.empty() && r.value.empty()) {
+                    dest.value = CellValue();
+                    dest.ts = std::min(l.ts, r.ts);
+                }
+                else if (l.value.empty()) {
+                    dest.value = CellValue();
+                    dest.ts = l.ts;
+                }
+                else if (r.value.empty()) {
+                    dest.value = CellValue();
+                    dest.ts = r.ts;
+                }
+                else {
+                    dest.value = CellValue(true);
+                    dest.ts = std::max(l.ts, r.ts);
+                }
+                break;
+            }
+
+            case OP_OR: {
+                const Register & l = regs[inst.a];
+                const Register & r = regs[inst.b];
+                if (l.value.isTrue() && r.value.isTrue()) {
+                    dest.value = CellValue(true);
+                    dest.ts = std::max(l.ts, r.ts);
+                }
+                else if (l.value.isTrue()) {
+                    dest.value = CellValue(true);
+                    dest.ts = l.ts;
+                }
+                else if (r.value.isTrue()) {
+                    dest.value = CellValue(true);
+                    dest.ts = r.ts;
+                }
+                else if (l.value.empty() && r.value.empty()) {
+                    dest.value = CellValue();
+                    dest.ts = std::max(l.ts, r.ts);
+                }
+                else if (l.value.empty()) {
+                    dest.value = CellValue();
+                    dest.ts = l.ts;
+                }
+                else if (r.value.empty()) {
+                    dest.value = CellValue();
+                    dest.ts = r.ts;
+                }
+                else {
+                    dest.value = CellValue(false);
+                    dest.ts = std::min(l.ts, r.ts);
+                }
+                break;
+            }
+
+            case OP_NOT: {
+                const Register & r = regs[inst.a];
+                if (r.value.empty())
+                    dest.value = CellValue();
+                else dest.value = CellValue(!r.value.isTrue());
+                dest.ts = r.ts;
+                break;
+            }
+
+            }
+        }
+
+        const Register & result = regs[resultRegister];
+        if (result.value.empty())
+            return storage = ExpressionValue::null(result.ts);
+        return storage = ExpressionValue(result.value, result.ts);
+    }
+};
+
+
+/*****************************************************************************/
+/* BYTECODE COMPILER                                                         */
+/*****************************************************************************/
+
+/** Walks the expression tree, emitting instructions in post order so
+    that each node's operands are computed before the node itself.
+    Returns the register that holds the node's result, or -1 if the node
+    isn't expressible, in which case the whole compilation is abandoned.
+*/
+struct BytecodeCompiler {
+
+    BytecodeCompiler(SqlBindingScope & scope)
+        : scope(scope)
+    {
+    }
+
+    SqlBindingScope & scope;
+    BytecodeProgram program;
+
+    int newRegister()
+    {
+        if (program.numRegisters == std::numeric_limits<uint16_t>::max())
+            return -1;
+        return program.numRegisters++;
+    }
+
+    int compileNode(const SqlExpression & expr)
+    {
+        if (auto constant
+            = dynamic_cast<const ConstantExpression *>(&expr)) {
+            const ExpressionValue & val = constant->constant;
+            if (!val.empty() && !val.isAtom())
+                return -1;
+            int reg = newRegister();
+            if (reg == -1)
+                return -1;
+            Register c;
+            if (!val.empty())
+                c.value = val.getAtom();
+            c.ts = val.getEffectiveTimestamp();
+            program.constants.emplace_back(std::move(c));
+            program.instructions.push_back
+                (Instruction{OP_LOAD_CONSTANT, (uint16_t)reg,
+                             (uint16_t)(program.constants.size() - 1), 0});
+            return reg;
+        }
+
+        if (auto column
+            = dynamic_cast<const ReadColumnExpression *>(&expr)) {
+            int reg = newRegister();
+            if (reg == -1)
+                return -1;
+            program.columns.emplace_back(column->bind(scope));
+            program.instructions.push_back
+                (Instruction{OP_LOAD_COLUMN, (uint16_t)reg,
+                             (uint16_t)(program.columns.size() - 1), 0});
+            return reg;
+        }
+
+        if (auto arith
+            = dynamic_cast<const ArithmeticExpression *>(&expr)) {
+            Opcode op;
+            if (arith->op == "+")      op = OP_ADD;
+            else if (arith->op == "-") op = OP_SUB;
+            else if (arith->op == "*") op = OP_MUL;
+            else if (arith->op == "/") op = OP_DIV;
+            else if (arith->op == "%") op = OP_MOD;
+            else return -1;
+            if (!arith->lhs || !arith->rhs)
+                return -1;
+            return compileBinary(op, *arith->lhs, *arith->rhs);
+        }
+
+        if (auto comparison
+            = dynamic_cast<const ComparisonExpression *>(&expr)) {
+            Opcode op;
+            if (comparison->op == "=" || comparison->op == "==")
+                op = OP_EQ;
+            else if (comparison->op == "!=") op = OP_NE;
+            else if (comparison->op == ">")  op = OP_GT;
+            else if (comparison->op == "<")  op = OP_LT;
+            else if (comparison->op == ">=") op = OP_GE;
+            else if (comparison->op == "<=") op = OP_LE;
+            else return -1;
+            return compileBinary(op, *comparison->lhs, *comparison->rhs);
+        }
+
+        if (auto boolean
+            = dynamic_cast<const BooleanOperatorExpression *>(&expr)) {
+            if (boolean->op == "AND" && boolean->lhs)
+                return compileBinary(OP_AND, *boolean->lhs, *boolean->rhs);
+            if (boolean->op == "OR" && boolean->lhs)
+                return compileBinary(OP_OR, *boolean->lhs, *boolean->rhs);
+            if (boolean->op == "NOT" && !boolean->lhs) {
+                int r = compileNode(*boolean->rhs);
+                if (r == -1)
+                    return -1;
+                int reg = newRegister();
+                if (reg == -1)
+                    return -1;
+                program.instructions.push_back
+                    (Instruction{OP_NOT, (uint16_t)reg, (uint16_t)r, 0});
+                return reg;
+            }
+            return -1;
+        }
+
+        return -1;
+    }
+
+    int compileBinary(Opcode op,
+                      const SqlExpression & lhs,
+                      const SqlExpression & rhs)
+    {
+        int l = compileNode(lhs);
+        if (l == -1)
+            return -1;
+        int r = compileNode(rhs);
+        if (r == -1)
+            return -1;
+        int reg = newRegister();
+        if (reg == -1)
+            return -1;
+        program.instructions.push_back
+            (Instruction{op, (uint16_t)reg, (uint16_t)l, (uint16_t)r});
+        return reg;
+    }
+};
+
+} // file scope
+
+
+/*****************************************************************************/
+/* COMPILE EXPRESSION BYTECODE                                               */
+/*****************************************************************************/
+
+BoundSqlExpression
+compileExpressionBytecode(const BoundSqlExpression & expr,
+                          SqlBindingScope & scope)
+{
+    if (!expr.expr || !expr.exec)
+        return expr;
+
+    // A bare column read or constant has no call chain to flatten
+    if (dynamic_cast<const ReadColumnExpression *>(expr.expr.get())
+        || dynamic_cast<const ConstantExpression *>(expr.expr.get()))
+        return expr;
+
+    BytecodeCompiler compiler(scope);
+    int resultRegister = compiler.compileNode(*expr.expr);
+    if (resultRegister == -1)
+        return expr;
+
+    auto program = std::make_shared<BytecodeProgram>
+        (std::move(compiler.program));
+    program->resultRegister = resultRegister;
+    program->fallback = expr.exec;
+
+    BoundSqlExpression result = expr;
+    result.exec = [program] (const SqlRowScope & row,
+                             ExpressionValue & storage,
+                             const VariableFilter & filter)
+        -> const ExpressionValue &
+        {
+            return program->execute(row, storage, filter);
+        };
+
+    return result;
+}
+
+} // namespace MLDB
+} // namespace Datacratic
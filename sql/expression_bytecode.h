@@ -0,0 +1,40 @@
+/** expression_bytecode.h                                          -*- C++ -*-
+    This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+    Lowering of bound row expressions to a flat, register based bytecode.
+
+    The exec functions produced by binding form a chain of std::function
+    calls, one per node of the expression tree, each of which pays an
+    indirect call and shuffles ExpressionValue storage.  For the simple
+    scalar predicates that dominate WHERE clauses (arithmetic,
+    comparisons and boolean logic over column reads and constants) the
+    whole tree can instead be flattened into a linear program over a
+    small register file of (CellValue, timestamp) pairs, executed by a
+    single dispatch loop with no per-node calls and no allocation.
+*/
+
+#pragma once
+
+#include "sql_expression.h"
+
+namespace Datacratic {
+namespace MLDB {
+
+/** Attempt to lower the given bound expression to bytecode.  Returns a
+    new BoundSqlExpression that executes the compiled program when the
+    expression is expressible (arithmetic, comparison and AND/OR/NOT
+    nodes over column reads and constants), or the passed-in expression
+    unchanged when it isn't.
+
+    The scope must be the scope the expression was bound against, as the
+    column reads are re-bound against it.  The compiled program checks at
+    runtime that the values it loads are atoms, and falls back to the
+    original exec function for any row where they aren't (for example a
+    row-valued column), so lowering never changes a result.
+*/
+BoundSqlExpression
+compileExpressionBytecode(const BoundSqlExpression & expr,
+                          SqlBindingScope & scope);
+
+} // namespace MLDB
+} // namespace Datacratic
@@ -22,6 +22,7 @@
 #include "mldb/jml/utils/less.h"
 #include "mldb/jml/utils/lightweight_hash.h"
 #include "mldb/jml/utils/compact_vector.h"
+#include <atomic>
 
 using namespace std;
 
@@ -2620,6 +2621,32 @@ ML::distribution<double, std::vector<double> >
 ExpressionValue::
 getEmbeddingDouble(ssize_t knownLength) const
 {
+    // Fast path: contiguous float or double embedding storage copies
+    // straight into the distribution, without materializing a
+    // ColumnName and CellValue per element.
+    if (type_ == Type::EMBEDDING
+        && (embedding_->storageType_ == ST_FLOAT64
+            || embedding_->storageType_ == ST_FLOAT32)) {
+        size_t n = embedding_->length();
+        if (knownLength != -1 && n < (size_t)knownLength)
+            throw HttpReturnException
+                (400, Utf8String("Expected ") + to_string(knownLength)
+                 + " elements in embedding, got " + to_string(n));
+        if (knownLength != -1)
+            n = knownLength;
+
+        ML::distribution<double> result;
+        if (embedding_->storageType_ == ST_FLOAT64) {
+            auto p = reinterpret_cast<const double *>(embedding_->data_.get());
+            result.assign(p, p + n);
+        }
+        else {
+            auto p = reinterpret_cast<const float *>(embedding_->data_.get());
+            result.assign(p, p + n);
+        }
+        return result;
+    }
+
     // TODO: this is inefficient.  We should be able to have the
     // info function return us one that does it much more
     // efficiently.
@@ -2846,6 +2873,16 @@ getEmbeddingCell(ssize_t knownLength) const
 
     throw HttpReturnException(500, "getEmbeddingCell called for non-embedding");
 }
+
+const void *
+ExpressionValue::
+tryGetFlatEmbeddingData(StorageType storage, size_t & numElements) const
+{
+    if (type_ != Type::EMBEDDING || embedding_->storageType_ != storage)
+        return nullptr;
+    numElements = embedding_->length();
+    return embedding_->data_.get();
+}
 #endif
 
 void
@@ -3765,6 +3802,140 @@ initUInt(uint64_t intValue, Date ts)
     setAtom(intValue, ts);
 }
 
+namespace {
+
+/*****************************************************************************/
+/* STRUCTURED VALUE POOL                                                     */
+/*****************************************************************************/
+
+/* Every structured ExpressionValue allocates a node holding its Structured
+   vector and its shared_ptr control block.  A row-by-row SELECT does this
+   several times per row on every query thread, and the resulting malloc
+   contention limits how queries scale over threads.  We instead carve the
+   nodes out of a per-thread pool of fixed size blocks.
+
+   A value may outlive the row (and even the thread) that created it, so
+   the pool can't simply be reset between batches: a block goes back to
+   the pool it came from when the last reference to the value goes, from
+   whatever thread that happens on, through a lock-free free list.  The
+   pool itself is kept alive by its outstanding blocks. */
+
+struct StructuredPool {
+
+    union Block {
+        Block * next;
+        char storage[192];
+    };
+
+    /// Maximum blocks kept around per thread, to bound the memory that
+    /// an idle thread holds on to
+    static constexpr int MAX_FREE = 8192;
+
+    /// Blocks released and not yet reused.  Pushed from any thread, but
+    /// popped only by the owning thread, so the pop loop is ABA-free.
+    std::atomic<Block *> freeBlocks;
+    std::atomic<int> numFree;
+
+    StructuredPool()
+        : freeBlocks(nullptr), numFree(0)
+    {
+    }
+
+    ~StructuredPool()
+    {
+        Block * block = freeBlocks.load(std::memory_order_acquire);
+        while (block) {
+            Block * next = block->next;
+            delete block;
+            block = next;
+        }
+    }
+
+    void * allocate()
+    {
+        Block * block = freeBlocks.load(std::memory_order_acquire);
+        while (block) {
+            if (freeBlocks.compare_exchange_weak(block, block->next,
+                                                 std::memory_order_acq_rel)) {
+                numFree.fetch_sub(1, std::memory_order_relaxed);
+                return block;
+            }
+        }
+        return new Block;
+    }
+
+    void release(void * mem)
+    {
+        Block * block = static_cast<Block *>(mem);
+        if (numFree.load(std::memory_order_relaxed) >= MAX_FREE) {
+            delete block;
+            return;
+        }
+        numFree.fetch_add(1, std::memory_order_relaxed);
+        block->next = freeBlocks.load(std::memory_order_acquire);
+        while (!freeBlocks.compare_exchange_weak(block->next, block,
+                                                 std::memory_order_acq_rel));
+    }
+};
+
+/** Allocator handed to allocate_shared below.  The library rebinds it to
+    its internal node type, so T isn't known in advance; anything that
+    doesn't fit in a block falls back to the heap.
+*/
+template<typename T>
+struct StructuredPoolAllocator {
+    typedef T value_type;
+
+    StructuredPoolAllocator(std::shared_ptr<StructuredPool> pool)
+        : pool(std::move(pool))
+    {
+    }
+
+    template<typename U>
+    StructuredPoolAllocator(const StructuredPoolAllocator<U> & other)
+        : pool(other.pool)
+    {
+    }
+
+    std::shared_ptr<StructuredPool> pool;
+
+    T * allocate(size_t n)
+    {
+        if (n == 1 && sizeof(T) <= sizeof(StructuredPool::Block))
+            return static_cast<T *>(pool->allocate());
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T * p, size_t n)
+    {
+        if (n == 1 && sizeof(T) <= sizeof(StructuredPool::Block))
+            pool->release(p);
+        else ::operator delete(p);
+    }
+
+    bool operator == (const StructuredPoolAllocator & other) const
+    {
+        return pool == other.pool;
+    }
+
+    bool operator != (const StructuredPoolAllocator & other) const
+    {
+        return pool != other.pool;
+    }
+};
+
+std::shared_ptr<const ExpressionValue::Structured>
+allocateStructured(ExpressionValue::Structured && value)
+{
+    static thread_local std::shared_ptr<StructuredPool> pool
+        = std::make_shared<StructuredPool>();
+    return std::allocate_shared<ExpressionValue::Structured>
+        (StructuredPoolAllocator<ExpressionValue::Structured>(pool),
+         std::move(value));
+}
+
+} // file scope
+
 void
 ExpressionValue::
 initStructured(Structured value) noexcept
@@ -3819,7 +3990,7 @@ initStructured(Structured value) noexcept
         value.swap(newValue);
     }
 
-    initStructured(std::make_shared<Structured>(std::move(value)));
+    initStructured(allocateStructured(std::move(value)));
 }
 
 void
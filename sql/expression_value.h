@@ -809,6 +809,16 @@ struct ExpressionValue {
     std::vector<CellValue>
     getEmbeddingCell(ssize_t knownLength = -1) const;
 
+    /** If this value is an embedding whose elements are stored as a
+        contiguous array of the given storage type, return a pointer to
+        the elements and set numElements; otherwise return nullptr.
+        This is the fast path that lets arithmetic run directly over
+        the storage with the kernels in mldb/arch/simd_vector.h,
+        without boxing each element in a CellValue.
+    */
+    const void *
+    tryGetFlatEmbeddingData(StorageType storage, size_t & numElements) const;
+
     /** Return the shape of the embedding. */
     std::vector<size_t>
     getEmbeddingShape() const;
@@ -7,6 +7,9 @@
 
 #include "path.h"
 #include <cstring>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 #include "mldb/types/hash_wrapper.h"
 #include "mldb/types/value_description.h"
 #include "mldb/types/vector_description.h"
@@ -131,6 +134,122 @@ compareNatural(const char * p1, size_t len1,
 }
 
 
+constexpr HashSeed defaultSeedStable { .i64 = { 0x1958DF94340e7cbaULL, 0x8928Fc8B84a0ULL } };
+
+
+/*****************************************************************************/
+/* PATH ELEMENT INTERN TABLE                                                 */
+/*****************************************************************************/
+
+namespace {
+
+/* Process-wide interning table for path elements that are too long to be
+   stored inline.  Repeated column names are looked up here the first time
+   they are hashed, so that each distinct name gets a small id and has its
+   (expensive) Id-compatible hash computed exactly once; from then on
+   hashing the element is a table hit and comparing two interned elements
+   is an integer compare on the ids.  Elements that fit inline don't need
+   any of this: they are plain 24 byte values whose words can be compared
+   directly, and their hashes are cached per-thread (see oldHash()).
+
+   Entries are never removed, so ids remain valid for the life of the
+   process.  The table stops accepting new entries once full, so that a
+   stream of unique row names can't make it grow without bound; elements
+   that miss simply fall back to computing their own hash. */
+
+struct PathElementInternTable {
+
+    struct Entry {
+        uint32_t id;       ///< Nonzero intern id; 0 = not interned
+        uint64_t oldHash;  ///< Id-compatible hash of the bytes
+    };
+
+    static constexpr size_t NUM_SHARDS = 64;
+    static constexpr size_t MAX_ENTRIES_PER_SHARD = 1024;
+
+    /** Return the entry for the given bytes, creating it if it doesn't
+        exist and there is space left in its shard.  Returns an entry with
+        id 0 if the name couldn't be interned.  Thread safe.
+    */
+    Entry lookup(const char * p, size_t len)
+    {
+        // Key on the (cheap) siphash of the bytes; the stored bytes are
+        // checked on a hit so a 64 bit collision degrades to not interning
+        // the second name, never to a wrong answer.
+        uint64_t key = ::mldb_siphash24(p, len, defaultSeedStable.b);
+
+        Shard & shard = shards[key % NUM_SHARDS];
+        std::unique_lock<std::mutex> guard(shard.lock);
+
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            if (it->second.bytes.size() == len
+                && std::memcmp(it->second.bytes.data(), p, len) == 0)
+                return { it->second.id, it->second.oldHash };
+            return { 0, 0 };
+        }
+
+        if (shard.entries.size() >= MAX_ENTRIES_PER_SHARD)
+            return { 0, 0 };
+
+        StoredEntry entry;
+        entry.id = nextId.fetch_add(1, std::memory_order_relaxed);
+        entry.oldHash = Id(p, len).hash();
+        entry.bytes.assign(p, len);
+
+        Entry result{ entry.id, entry.oldHash };
+        shard.entries.emplace(key, std::move(entry));
+        return result;
+    }
+
+private:
+    struct StoredEntry {
+        uint32_t id;
+        uint64_t oldHash;
+        std::string bytes;
+    };
+
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<uint64_t, StoredEntry> entries;
+    };
+
+    Shard shards[NUM_SHARDS];
+    std::atomic<uint32_t> nextId{1};
+};
+
+PathElementInternTable pathElementInternTable;
+
+/* Per-thread direct-mapped cache of the oldHash() of inline elements,
+   which is expensive to compute (it round-trips through Id) and is
+   recomputed constantly for the same column names during row processing.
+   The key is the element's full 24 byte value, so a hit can't be wrong;
+   the all-zeros (empty) element is excluded as it matches the initial
+   state of the entries. */
+
+struct SimpleElementHashCache {
+    struct Entry {
+        uint64_t w0, w1, w2;
+        uint64_t hash;
+    };
+
+    static constexpr size_t NUM_ENTRIES = 1024;
+
+    Entry entries[NUM_ENTRIES];
+
+    Entry & entryFor(const uint64_t * words)
+    {
+        uint64_t mixed
+            = words[0] * 0x9E3779B97F4A7C15ULL
+            + words[1] * 0xC2B2AE3D27D4EB4FULL
+            + words[2] * 0x165667B19E3779F9ULL;
+        return entries[(mixed >> 32) % NUM_ENTRIES];
+    }
+};
+
+} // file scope
+
+
 /*****************************************************************************/
 /* PATH ELEMENT                                                              */
 /*****************************************************************************/
@@ -371,6 +490,24 @@ operator == (const PathElement & other) const
     //ExcAssertEqual(digits_, calcDigits(data(), dataLength()));
     //ExcAssertEqual(other.digits_, calcDigits(other.data(), other.dataLength()));
 
+    // One inline and one out of line can never have the same length
+    if (complex_ != other.complex_)
+        return false;
+
+    if (JML_LIKELY(!complex_)) {
+        // Natural comparison only returns equal for identical bytes, so
+        // equality of inline elements (length, digit flags, characters
+        // and zero padding) is equality of their words
+        return words[0] == other.words[0]
+            && words[1] == other.words[1]
+            && words[2] == other.words[2];
+    }
+
+    // Two interned elements are equal if and only if their ids are
+    uint32_t id1 = str.md >> 8, id2 = other.str.md >> 8;
+    if (id1 && id2)
+        return id1 == id2;
+
     return digits_ == other.digits_
         && dataLength() == other.dataLength()
         && compareString(other.data(), other.dataLength()) == 0;
@@ -519,10 +656,39 @@ uint64_t
 PathElement::
 oldHash() const
 {
-    return Id(data(), dataLength()).hash();
-}
+    if (JML_LIKELY(!complex_)) {
+        if (empty())
+            return Id(data(), dataLength()).hash();
+
+        static thread_local SimpleElementHashCache cache;
+        auto & entry = cache.entryFor(words);
+        if (entry.w0 == words[0]
+            && entry.w1 == words[1]
+            && entry.w2 == words[2])
+            return entry.hash;
+        uint64_t result = Id(data(), dataLength()).hash();
+        entry = { words[0], words[1], words[2], result };
+        return result;
+    }
 
-constexpr HashSeed defaultSeedStable { .i64 = { 0x1958DF94340e7cbaULL, 0x8928Fc8B84a0ULL } };
+    // Out of line elements cache their hash, and their intern table id,
+    // in the words that the inline representation would have used.
+    uint64_t saved = str.savedHash;
+    if (JML_LIKELY(saved != 0))
+        return saved;
+
+    auto interned = pathElementInternTable.lookup(data(), dataLength());
+    uint64_t result = interned.id
+        ? interned.oldHash
+        : Id(data(), dataLength()).hash();
+
+    // Benign race: concurrent hashers of equal elements store equal values
+    if (interned.id)
+        str.md = (str.md & 0xff) | ((uint64_t)interned.id << 8);
+    str.savedHash = result;
+
+    return result;
+}
 
 uint64_t
 PathElement::
@@ -602,6 +768,9 @@ PathElement::
 complexCopyConstruct(const PathElement & other)
 {
     new (&str.str) Utf8String(other.getComplex());
+    // Carry over the cached intern id and hash with the value
+    str.md = other.str.md;
+    str.savedHash = other.str.savedHash;
 }
 
 void
@@ -609,6 +778,8 @@ PathElement::
 complexMoveConstruct(PathElement && other)
 {
     new (&str.str) Utf8String(std::move(other.getComplex()));
+    str.md = other.str.md;
+    str.savedHash = other.str.savedHash;
 }
 
 namespace {
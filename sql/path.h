@@ -236,9 +236,13 @@ struct PathElement {
     struct Itl;
 
     struct Str {
-        uint64_t md;
+        /// Flag bits in the low byte; the rest holds the id of the entry
+        /// in the process-wide intern table once the element has been
+        /// interned, or zero beforehand (see path.cc)
+        mutable uint64_t md;
         Utf8String str;
-        uint64_t savedHash;
+        /// Cached result of oldHash(); zero means not yet computed
+        mutable uint64_t savedHash;
     };
 
     static constexpr int EMPTY = 0;
@@ -19,6 +19,7 @@ SQL_EXPRESSION_SOURCES := \
 	path.cc \
 	dataset_types.cc \
 	sql_expression_operations.cc \
+	expression_bytecode.cc \
 
 # Unfortunately the S2 library needs you to mess with the include path as its includes
 # aren't prefixed.
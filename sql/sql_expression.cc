@@ -134,6 +134,64 @@ constantValue() const
     return operator () (context, GET_LATEST);
 }
 
+size_t
+BoundSqlExpression::
+filterBatch(const SqlRowScope * const * contexts,
+            uint32_t * indexes,
+            size_t numIn) const
+{
+    if (execFilter)
+        return execFilter(contexts, indexes, numIn);
+
+    // No native filter: gather the selected scopes, evaluate them in a
+    // batch, and keep the indexes where the predicate came back true
+    std::vector<const SqlRowScope *> selected(numIn);
+    for (size_t i = 0;  i < numIn;  ++i)
+        selected[i] = contexts[indexes[i]];
+
+    std::vector<ExpressionValue> outputs(numIn);
+    executeBatch(selected.data(), numIn, outputs.data(), GET_LATEST);
+
+    size_t numOut = 0;
+    for (size_t i = 0;  i < numIn;  ++i) {
+        if (outputs[i].isTrue())
+            indexes[numOut++] = indexes[i];
+    }
+
+    return numOut;
+}
+
+/*****************************************************************************/
+/* PREDICATE REORDER COUNTER                                                 */
+/*****************************************************************************/
+
+namespace {
+
+__thread std::atomic<uint64_t> * currentPredicateReorderCounter = nullptr;
+
+} // file scope
+
+std::atomic<uint64_t> *
+PredicateReorderCounter::
+current()
+{
+    return currentPredicateReorderCounter;
+}
+
+PredicateReorderCounter::Guard::
+Guard(std::atomic<uint64_t> * counter)
+    : saved(currentPredicateReorderCounter)
+{
+    currentPredicateReorderCounter = counter;
+}
+
+PredicateReorderCounter::Guard::
+~Guard()
+{
+    currentPredicateReorderCounter = saved;
+}
+
+
 DEFINE_STRUCTURE_DESCRIPTION(BoundSqlExpression);
 
 BoundSqlExpressionDescription::
@@ -222,7 +280,17 @@ doGetFunction(const Utf8String & tableName,
     if (factory) {
         return factory(functionName, args, argScope);
     }
-    
+
+    return {nullptr, nullptr};
+}
+
+BoundFunction
+SqlBindingScope::
+doGetFusedFunctionChain(const std::vector<Utf8String> & functionNames,
+                        const std::vector<BoundSqlExpression> & args,
+                        SqlBindingScope & argScope)
+{
+    // No fusion by default; each call binds separately
     return {nullptr, nullptr};
 }
 
@@ -1703,6 +1771,430 @@ getUnbound() const
     return result;
 }
 
+namespace {
+
+/** State shared between all occurrences of one deduplicated
+    subexpression: the slot its per-row result is memoized in, and the
+    bound form, which the first occurrence to be bound against a given
+    scope fills in so that the other occurrences can reuse it.
+*/
+struct SharedSubexpressionGroup {
+    SharedSubexpressionGroup(size_t slot)
+        : slot(slot), boundScope(nullptr)
+    {
+    }
+
+    size_t slot;
+    std::mutex mutex;
+    const SqlBindingScope * boundScope;
+    std::shared_ptr<BoundSqlExpression> bound;
+};
+
+/** Wrapper placed around each occurrence of a repeated subexpression by
+    extractCommonSubexpressions().  Binding the first occurrence binds
+    the wrapped expression; later occurrences bound against the same
+    scope reuse that bound form.  At run time the result is memoized in
+    the row scope, so however many occurrences are evaluated against one
+    row scope, the wrapped expression runs at most once per variable
+    filter.
+
+    For printing and static analysis the wrapper impersonates the
+    expression it wraps, so code that inspects expression types (eg the
+    order by constant removal) behaves as before.
+*/
+struct SharedSubexpression: public SqlExpression {
+    SharedSubexpression(std::shared_ptr<SqlExpression> inner,
+                        std::shared_ptr<SharedSubexpressionGroup> group)
+        : inner(std::move(inner)), group(std::move(group))
+    {
+        this->surface = this->inner->surface;
+    }
+
+    std::shared_ptr<SqlExpression> inner;
+    std::shared_ptr<SharedSubexpressionGroup> group;
+
+    virtual BoundSqlExpression bind(SqlBindingScope & scope) const
+    {
+        std::shared_ptr<BoundSqlExpression> boundInner;
+        {
+            std::unique_lock<std::mutex> guard(group->mutex);
+            if (group->bound && group->boundScope == &scope)
+                boundInner = group->bound;
+        }
+
+        if (!boundInner) {
+            boundInner = std::make_shared<BoundSqlExpression>(inner->bind(scope));
+            std::unique_lock<std::mutex> guard(group->mutex);
+            group->bound = boundInner;
+            group->boundScope = &scope;
+        }
+
+        // Constants are cheaper to re-evaluate than to memoize
+        if (boundInner->metadata.isConstant)
+            return *boundInner;
+
+        size_t slot = group->slot;
+
+        auto exec = [=] (const SqlRowScope & row,
+                         ExpressionValue & storage,
+                         const VariableFilter & filter)
+            -> const ExpressionValue &
+            {
+                auto & memo = row.sharedExprMemo;
+                if (memo.size() <= slot)
+                    memo.resize(slot + 1);
+                auto & entry = memo[slot];
+                if (entry.computed && entry.filter == filter)
+                    return entry.value;
+                entry.value = boundInner->exec(row, storage, filter);
+                entry.filter = filter;
+                entry.computed = true;
+                return entry.value;
+            };
+
+        return BoundSqlExpression(std::move(exec), this, boundInner->info,
+                                  boundInner->metadata);
+    }
+
+    virtual Utf8String print() const
+    {
+        return inner->print();
+    }
+
+    virtual std::shared_ptr<SqlExpression>
+    transform(const TransformArgs & transformArgs) const
+    {
+        auto result = std::make_shared<SharedSubexpression>(*this);
+        result->inner = transformArgs({ inner }).at(0);
+        return result;
+    }
+
+    virtual std::string getType() const
+    {
+        return inner->getType();
+    }
+
+    virtual Utf8String getOperation() const
+    {
+        return inner->getOperation();
+    }
+
+    virtual std::vector<std::shared_ptr<SqlExpression> > getChildren() const
+    {
+        return inner->getChildren();
+    }
+
+    virtual bool isConstant() const
+    {
+        return inner->isConstant();
+    }
+};
+
+} // file scope
+
+namespace {
+
+/** True for a function call whose repeated occurrences must each be
+    evaluated: now() depends on the clock, and a name that doesn't
+    resolve to a registered builtin is a user function whose
+    determinism can't be known at this level (Function::isDeterministic
+    defaults to false).  Sharing such a call would collapse
+    rand() + rand() into twice one draw.  This mirrors how
+    foldConstantIfPossible never folds through a function call.
+*/
+bool isNonDeterministicCall(const SqlExpression & expr)
+{
+    auto asCall = dynamic_cast<const FunctionCallExpression *>(&expr);
+    if (!asCall)
+        return false;
+    return !asCall->tableName.empty()
+        || asCall->functionName == "now"
+        || !tryLookupFunction(asCall->functionName);
+}
+
+} // file scope
+
+std::vector<std::shared_ptr<SqlExpression> >
+SqlExpression::
+extractCommonSubexpressions(const std::vector<std::shared_ptr<SqlExpression> > & roots)
+{
+    // Count how often each candidate subtree occurs, keyed on its
+    // printed form.  Only composite, non-constant subtrees with no
+    // aggregators and no non-deterministic calls are candidates: bare
+    // column reads and constants are cheaper to re-evaluate than to
+    // memoize, aggregators are accumulated outside the row scope that
+    // the memo lives in, and a non-deterministic call must produce a
+    // fresh value per written occurrence.
+    std::map<Utf8String, int> counts;
+
+    // Returns (hasAggregator, hasNonDeterministicCall) for the subtree
+    std::function<std::pair<bool, bool> (const SqlExpression &)> count
+        = [&] (const SqlExpression & expr) -> std::pair<bool, bool>
+        {
+            auto children = expr.getChildren();
+            bool hasAggregator = expr.isAggregator();
+            bool nonDeterministic = isNonDeterministicCall(expr);
+            for (auto & c: children) {
+                if (!c)
+                    continue;
+                auto childFlags = count(*c);
+                hasAggregator = hasAggregator || childFlags.first;
+                nonDeterministic = nonDeterministic || childFlags.second;
+            }
+            if (!children.empty() && !hasAggregator && !nonDeterministic
+                && !expr.isConstant())
+                counts[expr.print()] += 1;
+            return {hasAggregator, nonDeterministic};
+        };
+
+    for (auto & r: roots) {
+        if (r)
+            count(*r);
+    }
+
+    bool anyRepeated = false;
+    for (auto & c: counts) {
+        if (c.second > 1)
+            anyRepeated = true;
+    }
+
+    if (!anyRepeated)
+        return {};
+
+    // Rewrite each root, wrapping the outermost repeated subtrees.
+    // There is no need to recurse below a wrapped subtree: everything
+    // inside it already runs at most once per row.
+    std::map<Utf8String, std::shared_ptr<SharedSubexpressionGroup> > groups;
+
+    std::function<std::shared_ptr<SqlExpression>
+                  (std::shared_ptr<SqlExpression>)> rewrite;
+
+    TransformArgs rewriteChildren
+        = [&] (const std::vector<std::shared_ptr<SqlExpression> > & children)
+        -> std::vector<std::shared_ptr<SqlExpression> >
+        {
+            std::vector<std::shared_ptr<SqlExpression> > result;
+            result.reserve(children.size());
+            for (auto & c: children)
+                result.push_back(c ? rewrite(c) : c);
+            return result;
+        };
+
+    rewrite = [&] (std::shared_ptr<SqlExpression> expr)
+        -> std::shared_ptr<SqlExpression>
+        {
+            auto children = expr->getChildren();
+            if (!children.empty() && !expr->isConstant()) {
+                auto it = counts.find(expr->print());
+                if (it != counts.end() && it->second > 1) {
+                    auto & group = groups[it->first];
+                    if (!group)
+                        group = std::make_shared<SharedSubexpressionGroup>
+                            (groups.size() - 1);
+                    return std::make_shared<SharedSubexpression>(expr, group);
+                }
+            }
+            if (children.empty())
+                return expr;
+            return expr->transform(rewriteChildren);
+        };
+
+    try {
+        std::vector<std::shared_ptr<SqlExpression> > result;
+        result.reserve(roots.size());
+        for (auto & r: roots)
+            result.push_back(r ? rewrite(r) : r);
+        return result;
+    } JML_CATCH_ALL {
+        // transform() isn't implemented for every expression type; this
+        // is an optimization, so fall back to the originals rather than
+        // failing a query that would otherwise bind
+        return {};
+    }
+}
+
+namespace {
+
+/** Replace a constant subtree with its pre-evaluated value.  Row
+    expressions are left alone even when constant, since folding them
+    away would lose the named column structure they produce.
+*/
+std::shared_ptr<SqlExpression>
+foldConstantIfPossible(std::shared_ptr<SqlExpression> expr)
+{
+    if (expr->getType() == "constant"
+        || !expr->isConstant()
+        || dynamic_cast<const SqlRowExpression *>(expr.get()))
+        return expr;
+
+    try {
+        auto folded = std::make_shared<ConstantExpression>(expr->constantValue());
+        folded->surface = expr->surface;
+        return folded;
+    } JML_CATCH_ALL {
+        // Evaluation failed (eg a divide by zero).  SQL mandates lazy
+        // evaluation, so leave the subtree in place to fail at run time
+        // if and only if it is actually evaluated.
+        return expr;
+    }
+}
+
+/** True when the expression always evaluates to a boolean (or null),
+    whatever its inputs.  AND and OR coerce their result to a boolean,
+    so TRUE AND x can only be replaced by x when x passes this test;
+    otherwise the fold would leak x's raw value (eg a number) where the
+    caller expected a boolean.
+*/
+bool isStaticallyBoolean(const SqlExpression & expr)
+{
+    return dynamic_cast<const ComparisonExpression *>(&expr)
+        || dynamic_cast<const BooleanOperatorExpression *>(&expr)
+        || dynamic_cast<const IsTypeExpression *>(&expr)
+        || dynamic_cast<const BetweenExpression *>(&expr)
+        || dynamic_cast<const InExpression *>(&expr)
+        || dynamic_cast<const LikeExpression *>(&expr);
+}
+
+std::shared_ptr<SqlExpression>
+foldExpressionTree(std::shared_ptr<SqlExpression> expr)
+{
+    // Fold the children first, so that constants percolate upwards
+    if (!expr->getChildren().empty()) {
+        TransformArgs foldChildren
+            = [] (const std::vector<std::shared_ptr<SqlExpression> > & args)
+            -> std::vector<std::shared_ptr<SqlExpression> >
+            {
+                std::vector<std::shared_ptr<SqlExpression> > result;
+                result.reserve(args.size());
+                for (auto & a: args)
+                    result.push_back(a ? foldExpressionTree(a) : a);
+                return result;
+            };
+
+        expr = expr->transform(foldChildren);
+    }
+
+    // Short-circuit constant conjuncts and disjuncts.  TRUE AND x and
+    // FALSE OR x reduce to x when x is itself boolean-valued; a
+    // constant FALSE conjunct or TRUE disjunct decides the result
+    // whatever the other side is, NULLs included.
+    auto asBool = dynamic_cast<const BooleanOperatorExpression *>(expr.get());
+    if (asBool && asBool->lhs && asBool->rhs) {
+        if (asBool->op == "AND") {
+            if (asBool->lhs->isConstantTrue()
+                && isStaticallyBoolean(*asBool->rhs))
+                return asBool->rhs;
+            if (asBool->rhs->isConstantTrue()
+                && isStaticallyBoolean(*asBool->lhs))
+                return asBool->lhs;
+            if (asBool->lhs->isConstantFalse()
+                || asBool->rhs->isConstantFalse()) {
+                auto folded = std::make_shared<ConstantExpression>
+                    (ExpressionValue(false, Date::negativeInfinity()));
+                folded->surface = expr->surface;
+                return folded;
+            }
+        }
+        else if (asBool->op == "OR") {
+            if (asBool->lhs->isConstantFalse()
+                && isStaticallyBoolean(*asBool->rhs))
+                return asBool->rhs;
+            if (asBool->rhs->isConstantFalse()
+                && isStaticallyBoolean(*asBool->lhs))
+                return asBool->lhs;
+            if (asBool->lhs->isConstantTrue()
+                || asBool->rhs->isConstantTrue()) {
+                auto folded = std::make_shared<ConstantExpression>
+                    (ExpressionValue(true, Date::negativeInfinity()));
+                folded->surface = expr->surface;
+                return folded;
+            }
+        }
+    }
+
+    // Prune searched CASE arms whose condition can never match, and
+    // truncate at the first arm whose condition always matches
+    auto asCase = dynamic_cast<const CaseExpression *>(expr.get());
+    if (asCase && !asCase->expr) {
+        enum Match { MATCH_NEVER, MATCH_ALWAYS, MATCH_UNKNOWN };
+        auto armMatches = [] (const std::shared_ptr<SqlExpression> & cond)
+            -> Match
+            {
+                if (!cond->isConstant())
+                    return MATCH_UNKNOWN;
+                try {
+                    return cond->constantValue().isTrue()
+                        ? MATCH_ALWAYS : MATCH_NEVER;
+                } JML_CATCH_ALL {
+                    return MATCH_UNKNOWN;
+                }
+            };
+
+        bool changed = false;
+        std::vector<std::pair<std::shared_ptr<SqlExpression>,
+                              std::shared_ptr<SqlExpression> > > newWhen;
+        std::shared_ptr<SqlExpression> newElse = asCase->elseExpr;
+
+        for (auto & arm: asCase->when) {
+            Match match = armMatches(arm.first);
+            if (match == MATCH_NEVER) {
+                changed = true;
+                continue;
+            }
+            if (match == MATCH_ALWAYS) {
+                if (newWhen.empty()) {
+                    // The first reachable arm always matches, so the
+                    // whole case reduces to its value
+                    return arm.second;
+                }
+                // Later arms and the else can never be reached
+                newElse = arm.second;
+                changed = true;
+                break;
+            }
+            newWhen.push_back(arm);
+        }
+
+        if (changed) {
+            if (newWhen.empty()) {
+                if (newElse)
+                    return newElse;
+                auto folded = std::make_shared<ConstantExpression>
+                    (ExpressionValue());
+                folded->surface = expr->surface;
+                return folded;
+            }
+            auto folded = std::make_shared<CaseExpression>(*asCase);
+            folded->when = std::move(newWhen);
+            folded->elseExpr = newElse;
+            return folded;
+        }
+    }
+
+    // Finally, a node whose whole subtree is constant becomes a single
+    // pre-evaluated constant
+    return foldConstantIfPossible(std::move(expr));
+}
+
+} // file scope
+
+std::shared_ptr<SqlExpression>
+SqlExpression::
+foldConstants(std::shared_ptr<SqlExpression> expr)
+{
+    if (!expr)
+        return expr;
+
+    try {
+        return foldExpressionTree(expr);
+    } JML_CATCH_ALL {
+        // transform() isn't implemented for every expression type; this
+        // is an optimization, so fall back to the original rather than
+        // failing a query that would otherwise bind
+        return expr;
+    }
+}
+
 std::shared_ptr<SqlExpression>
 SqlExpression::
 shallowCopy() const
@@ -2461,6 +2953,103 @@ compare(const std::vector<ExpressionValue> & vec1,
     };
 }
 
+bool
+BoundOrderByExpression::
+encodeSortKey(const std::vector<ExpressionValue> & vec,
+              std::string & key,
+              int offset) const
+{
+    ExcAssertGreaterEqual(vec.size(), offset + clauses.size());
+
+    key.clear();
+
+    for (unsigned i = 0;  i < clauses.size();  ++i) {
+        const ExpressionValue & e = vec[offset + i];
+
+        size_t fieldStart = key.size();
+
+        // One class byte per field keeps nulls before numbers before
+        // strings, matching the comparison order.  Null expression
+        // values and null cells get the same class; the resulting key
+        // ties are broken by compare(), which is always safe, unlike a
+        // key ordering that would contradict it.
+        if (e.empty()) {
+            key.push_back('\0');
+        }
+        else if (e.isAtom()) {
+            const CellValue & cell = e.getAtom();
+            switch (cell.cellType()) {
+            case CellValue::INTEGER:
+            case CellValue::FLOAT: {
+                key.push_back('\1');
+                // The usual order-preserving transform of the IEEE bit
+                // pattern: setting the sign bit shifts positives above
+                // negatives, complementing negatives reverses their
+                // magnitude order.  Integers go through double, which
+                // is monotonic; the ones past 2^53 that collide tie on
+                // the key and fall back to compare().
+                double d = cell.toDouble();
+                uint64_t bits;
+                std::memcpy(&bits, &d, sizeof(bits));
+                if (std::isnan(d))
+                    bits = 0;  // NaN sorts before every other number
+                else if (bits & ((uint64_t)1 << 63))
+                    bits = ~bits;
+                else
+                    bits |= ((uint64_t)1 << 63);
+                for (int b = 7;  b >= 0;  --b)
+                    key.push_back((bits >> (8 * b)) & 0xff);
+                break;
+            }
+            case CellValue::ASCII_STRING:
+            case CellValue::UTF8_STRING: {
+                key.push_back('\2');
+                const char * p = cell.stringChars();
+                size_t len = cell.toStringLength();
+                for (size_t j = 0;  j < len;  ++j) {
+                    // XOR with 0x80 maps the comparator's signed char
+                    // order onto the unsigned order of byte compares
+                    unsigned char c = ((unsigned char)p[j]) ^ 0x80;
+                    if (c == 0) {
+                        // Escape zero bytes so the terminator below
+                        // stays unambiguous
+                        key.push_back('\0');
+                        key.push_back('\xff');
+                    }
+                    else key.push_back(c);
+                }
+                // The terminator sorts after end-of-key but before any
+                // escaped zero byte, so prefixes order correctly even
+                // when another field follows
+                key.push_back('\0');
+                key.push_back('\1');
+                break;
+            }
+            default:
+                // Timestamps, intervals, blobs and paths don't define
+                // an order against the other classes; leave those rows
+                // to the full comparison
+                key.clear();
+                return false;
+            }
+        }
+        else {
+            key.clear();
+            return false;
+        }
+
+        // A descending field reverses its byte order wholesale; the
+        // encodings above are self-delimiting, so this stays correct
+        // when further fields follow
+        if (clauses[i].dir == DESC) {
+            for (size_t j = fieldStart;  j < key.size();  ++j)
+                key[j] = ~key[j];
+        }
+    }
+
+    return true;
+}
+
 
 /*****************************************************************************/
 /* ORDER BY EXPRESSION                                                       */
@@ -14,6 +14,7 @@
 #include "mldb/types/string.h"
 #include "mldb/types/any.h"
 #include "mldb/types/value_description_fwd.h"
+#include <atomic>
 #include <memory>
 #include <set>
 
@@ -155,6 +156,31 @@ struct BoundSqlExpression {
                                                    ExpressionValue & storage,
                                                    const VariableFilter & filter)> ExecFunction;
 
+    /** Function type to execute the expression over a batch of rows at
+        once, writing one output value per row.  Operators that can run
+        as tight loops over a block (comparisons, arithmetic) provide
+        this to avoid the per-row virtual call and allocation overhead
+        of exec; it is optional, and executeBatch() falls back to
+        calling exec row by row when it's missing.
+    */
+    typedef std::function<void (const SqlRowScope * const * contexts,
+                                size_t numContexts,
+                                ExpressionValue * outputs,
+                                const VariableFilter & filter)> ExecBatchFunction;
+
+    /** Function type to filter a batch of rows through the expression
+        used as a predicate, with a selection vector.  On input,
+        indexes[0..numIn) are positions into the contexts array, sorted
+        ascending; the function compacts the vector in place to the
+        positions where the predicate evaluates true and returns how
+        many remain.  Like execBatch it is optional; filterBatch()
+        falls back to batch evaluation of the selected rows followed
+        by compaction when it's missing.
+    */
+    typedef std::function<size_t (const SqlRowScope * const * contexts,
+                                  uint32_t * indexes,
+                                  size_t numIn)> ExecFilterFunction;
+
     BoundSqlExpression()
     {
     }
@@ -167,6 +193,13 @@ struct BoundSqlExpression {
     operator bool () const { return !!exec; };
 
     ExecFunction exec;
+
+    /// Optional batch execution function; see ExecBatchFunction
+    ExecBatchFunction execBatch;
+
+    /// Optional selection vector filter function; see ExecFilterFunction
+    ExecFilterFunction execFilter;
+
     std::shared_ptr<const SqlExpression> expr;
 
     /// What kind of value does this return?
@@ -199,10 +232,78 @@ struct BoundSqlExpression {
         return res;
     }
 
+    /** Evaluate the expression over a block of rows at once, writing
+        one output per row.  Uses the operator's batch implementation
+        when there is one, otherwise falls back to row at a time.
+    */
+    void executeBatch(const SqlRowScope * const * contexts,
+                      size_t numContexts,
+                      ExpressionValue * outputs,
+                      const VariableFilter & filter) const
+    {
+        if (execBatch) {
+            execBatch(contexts, numContexts, outputs, filter);
+            return;
+        }
+
+        for (size_t i = 0;  i < numContexts;  ++i) {
+            ExpressionValue storage;
+            const ExpressionValue & res = exec(*contexts[i], storage, filter);
+            if (&res == &storage)
+                outputs[i] = std::move(storage);
+            else outputs[i] = res;
+        }
+    }
+
+    /** Filter a batch of rows through the expression used as a
+        predicate, keeping the indexes where it evaluates true under
+        GET_LATEST (the same test a WHERE scan applies row by row).
+        Compacts indexes in place and returns the number kept.  Boolean
+        operators refine or merge the selection vector directly, so an
+        ANDed chain of predicates narrows the vector without ever
+        materializing the rejected rows.
+    */
+    size_t filterBatch(const SqlRowScope * const * contexts,
+                       uint32_t * indexes,
+                       size_t numIn) const;
+
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(BoundSqlExpression);
 
+
+/*****************************************************************************/
+/* PREDICATE REORDER COUNTER                                                 */
+/*****************************************************************************/
+
+/** Per-thread counter that conjunct reordering decisions are reported
+    to (see the AND handling in BooleanOperatorExpression::bind).  The
+    query executor installs it when a profile was asked for, so the
+    reordering shows up in the query profiler; it is null otherwise.
+    The SQL library must not depend on the server, so the channel is
+    defined here and populated from above.
+*/
+
+struct PredicateReorderCounter {
+    /// Counter for the calling thread, or nullptr
+    static std::atomic<uint64_t> * current();
+
+    /** RAII object that points current() at the given counter.  A null
+        pointer is allowed and simply clears current().
+    */
+    struct Guard {
+        Guard(std::atomic<uint64_t> * counter);
+        ~Guard();
+
+        Guard(const Guard &) = delete;
+        void operator = (const Guard &) = delete;
+
+    private:
+        std::atomic<uint64_t> * saved;
+    };
+};
+
+
 /*****************************************************************************/
 /* TABLE OPERATIONS                                                          */
 /*****************************************************************************/
@@ -547,7 +648,25 @@ struct SqlBindingScope {
                   const Utf8String & functionName,
                   const std::vector<BoundSqlExpression> & args,
                   SqlBindingScope & argScope);
-    
+
+    /** Try to bind a chain of nested single-argument function
+        applications outer(...(inner(arg))) as one fused call that
+        hands each intermediate value to the next function in its
+        typed binary form, instead of materializing an ExpressionValue
+        between each pair.  functionNames is ordered outermost first;
+        args are the bound arguments of the innermost call.
+
+        Returns a null BoundFunction when the chain can't be fused
+        (for example when the names don't all resolve to typed value
+        functions, or adjacent types don't line up); the caller then
+        binds the calls separately as usual.  The default
+        implementation never fuses.
+    */
+    virtual BoundFunction
+    doGetFusedFunctionChain(const std::vector<Utf8String> & functionNames,
+                            const std::vector<BoundSqlExpression> & args,
+                            SqlBindingScope & argScope);
+
 
     virtual BoundTableExpression
     doGetDatasetFunction(const Utf8String & functionName,
@@ -783,11 +902,33 @@ DECLARE_STRUCTURE_DESCRIPTION(UnboundEntities);
     This is an empty class; any implementation must derive from it.
 */
 
+/** One entry of the per-row memo for subexpressions that were shared at
+    bind time; see SqlExpression::extractCommonSubexpressions().
+*/
+struct SharedExpressionMemoEntry {
+    SharedExpressionMemoEntry()
+        : computed(false), filter(GET_ALL)
+    {
+    }
+
+    bool computed;
+    VariableFilter filter;
+    ExpressionValue value;
+};
+
 struct SqlRowScope {
     virtual ~SqlRowScope()
     {
     }
 
+    /** Per-row memo for subexpressions shared at bind time, indexed by
+        the slot assigned to each shared subexpression.  Lazily sized on
+        first use, so row scopes for queries with nothing shared pay
+        only for an empty vector.  Mutable since caching a result
+        doesn't change the row that the scope describes.
+    */
+    mutable std::vector<SharedExpressionMemoEntry> sharedExprMemo;
+
     /** In some circumstances, such as calling functions, we want to signal
         that there is no row available even though the functions require
         one to be passed.
@@ -977,6 +1118,36 @@ struct SqlExpression: public std::enable_shared_from_this<SqlExpression> {
     */
     virtual UnboundEntities getUnbound() const;
 
+    /** Common-subexpression elimination over a set of clauses that will
+        be bound against the same scope and evaluated against the same
+        row scopes.  Repeated non-trivial subtrees (composite, not
+        constant, no aggregators) are wrapped so that all occurrences
+        share one bound expression whose per-row result is memoized in
+        the row scope; a subexpression repeated three times then costs
+        one evaluation per row.
+
+        Returns the rewritten roots in the order they were passed, or an
+        empty vector when nothing is repeated (or the rewrite could not
+        be applied), in which case the originals should be used.
+    */
+    static std::vector<std::shared_ptr<SqlExpression> >
+    extractCommonSubexpressions(const std::vector<std::shared_ptr<SqlExpression> > & roots);
+
+    /** Constant folding pass over a parsed expression tree.  Constant
+        subtrees are pre-evaluated into a single ConstantExpression via
+        the isConstant()/constantValue() machinery, constant conjuncts
+        and disjuncts of AND/OR are short-circuited away, and searched
+        CASE arms whose condition can never match are pruned.  A subtree
+        whose evaluation fails is left in place, since SQL mandates lazy
+        evaluation: it should only fail at run time if it is actually
+        evaluated.
+
+        Returns the folded tree, or the expression unchanged when
+        nothing folds or the rewrite could not be applied.
+    */
+    static std::shared_ptr<SqlExpression>
+    foldConstants(std::shared_ptr<SqlExpression> expr);
+
     /** Helpful shallow copy function that calls transform() */
     std::shared_ptr<SqlExpression> shallowCopy() const;
 
@@ -1261,6 +1432,22 @@ struct BoundOrderByExpression {
         return compare(vec1, vec2, offset) == -1;
     }
 
+    /** Encode the order by fields into a binary key such that two keys
+        compare bytewise (eg with std::string's operator <) in the same
+        order as compare() orders the fields they were built from, with
+        key ties broken by compare().  This turns the per-comparison
+        type dispatch of a sort into one encoding per row and cheap
+        byte comparisons thereafter.
+
+        Returns false, leaving key empty, when a field has no
+        byte-comparable encoding (values that aren't null, numbers or
+        strings); the caller then compares those rows with less()
+        directly.
+    */
+    bool encodeSortKey(const std::vector<ExpressionValue> & vec,
+                       std::string & key,
+                       int offset = 0) const;
+
 };
 
 DECLARE_STRUCTURE_DESCRIPTION(BoundOrderByExpression);
@@ -12,10 +12,13 @@
 #include "mldb/types/vector_description.h"
 #include "table_expression_operations.h"
 #include <unordered_set>
+#include <algorithm>
 #include "mldb/server/dataset_context.h"
 #include "mldb/base/scope.h"
 #include "mldb/sql/sql_utils.h"
 #include "mldb/jml/stats/distribution.h"
+#include "mldb/arch/simd_vector.h"
+#include "mldb/arch/tick_counter.h"
 
 using namespace std;
 
@@ -58,8 +61,148 @@ doComparison(const SqlExpression * expr,
              const BoundSqlExpression & boundRhs,
              bool (ExpressionValue::* op)(const ExpressionValue &) const)
 {
-    return {[=] (const SqlRowScope & row, ExpressionValue & storage,
-                 const VariableFilter & filter)
+    // When one side is constant, evaluate it once here and capture it
+    // in the closure, so the per-row path only touches the other side.
+    // Comparisons against literals are the bread and butter of
+    // generated where clauses.
+    if (boundRhs.metadata.isConstant && !boundLhs.metadata.isConstant) {
+        ExpressionValue rval = boundRhs.constantValue();
+        bool rempty = rval.empty();
+
+        BoundSqlExpression result
+            ([=] (const SqlRowScope & row, ExpressionValue & storage,
+                  const VariableFilter & filter)
+                -> const ExpressionValue &
+                {
+                    ExpressionValue lstorage;
+                    const ExpressionValue & l
+                        = boundLhs(row, lstorage, GET_LATEST);
+                    Date ts = calcTs(l, rval);
+                    if (l.empty() || rempty)
+                        return storage = std::move(ExpressionValue::null(ts));
+
+                    return storage
+                        = std::move(ExpressionValue((l .* op)(rval), ts));
+                },
+                expr,
+                std::make_shared<BooleanValueInfo>());
+
+        result.execBatch = [=] (const SqlRowScope * const * rowScopes,
+                                size_t numRows,
+                                ExpressionValue * outputs,
+                                const VariableFilter & filter)
+            {
+                std::vector<ExpressionValue> lvals(numRows);
+                boundLhs.executeBatch(rowScopes, numRows, lvals.data(),
+                                      GET_LATEST);
+
+                for (size_t i = 0;  i < numRows;  ++i) {
+                    const ExpressionValue & l = lvals[i];
+                    Date ts = calcTs(l, rval);
+                    if (l.empty() || rempty)
+                        outputs[i] = ExpressionValue::null(ts);
+                    else outputs[i] = ExpressionValue((l .* op)(rval), ts);
+                }
+            };
+
+        // Filter path: comparisons against NULL never match, and the
+        // survivors are decided without building boolean outputs
+        result.execFilter = [=] (const SqlRowScope * const * contexts,
+                                 uint32_t * indexes,
+                                 size_t numIn) -> size_t
+            {
+                if (rempty)
+                    return 0;
+
+                std::vector<const SqlRowScope *> selected(numIn);
+                for (size_t i = 0;  i < numIn;  ++i)
+                    selected[i] = contexts[indexes[i]];
+
+                std::vector<ExpressionValue> lvals(numIn);
+                boundLhs.executeBatch(selected.data(), numIn, lvals.data(),
+                                      GET_LATEST);
+
+                size_t numOut = 0;
+                for (size_t i = 0;  i < numIn;  ++i) {
+                    const ExpressionValue & l = lvals[i];
+                    if (!l.empty() && (l .* op)(rval))
+                        indexes[numOut++] = indexes[i];
+                }
+                return numOut;
+            };
+
+        return result;
+    }
+    else if (boundLhs.metadata.isConstant && !boundRhs.metadata.isConstant) {
+        ExpressionValue lval = boundLhs.constantValue();
+        bool lempty = lval.empty();
+
+        BoundSqlExpression result
+            ([=] (const SqlRowScope & row, ExpressionValue & storage,
+                  const VariableFilter & filter)
+                -> const ExpressionValue &
+                {
+                    ExpressionValue rstorage;
+                    const ExpressionValue & r
+                        = boundRhs(row, rstorage, GET_LATEST);
+                    Date ts = calcTs(lval, r);
+                    if (lempty || r.empty())
+                        return storage = std::move(ExpressionValue::null(ts));
+
+                    return storage
+                        = std::move(ExpressionValue((lval .* op)(r), ts));
+                },
+                expr,
+                std::make_shared<BooleanValueInfo>());
+
+        result.execBatch = [=] (const SqlRowScope * const * rowScopes,
+                                size_t numRows,
+                                ExpressionValue * outputs,
+                                const VariableFilter & filter)
+            {
+                std::vector<ExpressionValue> rvals(numRows);
+                boundRhs.executeBatch(rowScopes, numRows, rvals.data(),
+                                      GET_LATEST);
+
+                for (size_t i = 0;  i < numRows;  ++i) {
+                    const ExpressionValue & r = rvals[i];
+                    Date ts = calcTs(lval, r);
+                    if (lempty || r.empty())
+                        outputs[i] = ExpressionValue::null(ts);
+                    else outputs[i] = ExpressionValue((lval .* op)(r), ts);
+                }
+            };
+
+        result.execFilter = [=] (const SqlRowScope * const * contexts,
+                                 uint32_t * indexes,
+                                 size_t numIn) -> size_t
+            {
+                if (lempty)
+                    return 0;
+
+                std::vector<const SqlRowScope *> selected(numIn);
+                for (size_t i = 0;  i < numIn;  ++i)
+                    selected[i] = contexts[indexes[i]];
+
+                std::vector<ExpressionValue> rvals(numIn);
+                boundRhs.executeBatch(selected.data(), numIn, rvals.data(),
+                                      GET_LATEST);
+
+                size_t numOut = 0;
+                for (size_t i = 0;  i < numIn;  ++i) {
+                    const ExpressionValue & r = rvals[i];
+                    if (!r.empty() && (lval .* op)(r))
+                        indexes[numOut++] = indexes[i];
+                }
+                return numOut;
+            };
+
+        return result;
+    }
+
+    BoundSqlExpression result
+        ([=] (const SqlRowScope & row, ExpressionValue & storage,
+              const VariableFilter & filter)
             -> const ExpressionValue &
             {
                 ExpressionValue lstorage, rstorage;
@@ -69,11 +212,36 @@ doComparison(const SqlExpression * expr,
                 Date ts = calcTs(l, r);
                 if (l.empty() || r.empty())
                     return storage = std::move(ExpressionValue::null(ts));
- 
+
                 return storage = std::move(ExpressionValue((l .* op)(r), ts));
             },
             expr,
-            std::make_shared<BooleanValueInfo>()};
+            std::make_shared<BooleanValueInfo>());
+
+    // Batch path: evaluate both operands over the whole block, then
+    // apply the comparison in a tight loop with no virtual calls.
+    result.execBatch = [=] (const SqlRowScope * const * rowScopes,
+                            size_t numRows,
+                            ExpressionValue * outputs,
+                            const VariableFilter & filter)
+        {
+            std::vector<ExpressionValue> lvals(numRows), rvals(numRows);
+            boundLhs.executeBatch(rowScopes, numRows, lvals.data(),
+                                  GET_LATEST);
+            boundRhs.executeBatch(rowScopes, numRows, rvals.data(),
+                                  GET_LATEST);
+
+            for (size_t i = 0;  i < numRows;  ++i) {
+                const ExpressionValue & l = lvals[i];
+                const ExpressionValue & r = rvals[i];
+                Date ts = calcTs(l, r);
+                if (l.empty() || r.empty())
+                    outputs[i] = ExpressionValue::null(ts);
+                else outputs[i] = ExpressionValue((l .* op)(r), ts);
+            }
+        };
+
+    return result;
 }
 
 BoundSqlExpression
@@ -268,6 +436,97 @@ struct BinaryOpHelper {
                                               onInfo);
     }
 
+    /* Fast paths for embeddings with contiguous float or double
+       storage: the elements go straight through the operator's
+       vectorized kernel instead of being boxed one by one in
+       CellValues.  Each returns false when the fast path doesn't
+       apply (non-embedding, other storage types, or a scalar whose
+       semantics aren't purely numeric) and the caller falls back to
+       the generic path. */
+
+    template<typename T>
+    static bool
+    tryVecEmbeddingEmbedding(const ExpressionValue & lhs,
+                             const ExpressionValue & rhs,
+                             ExpressionValue & storage)
+    {
+        constexpr StorageType st = GetStorageType<T>::val;
+        size_t ln = 0, rn = 0;
+        const T * l = reinterpret_cast<const T *>
+            (lhs.tryGetFlatEmbeddingData(st, ln));
+        if (!l)
+            return false;
+        const T * r = reinterpret_cast<const T *>
+            (rhs.tryGetFlatEmbeddingData(st, rn));
+        if (!r)
+            return false;
+        if (ln != rn)
+            throw HttpReturnException
+                (400, "Attempt to perform operation on incompatible shaped "
+                 "embeddings",
+                 "lhsShape", lhs.getEmbeddingShape(),
+                 "rhsShape", rhs.getEmbeddingShape());
+
+        std::shared_ptr<T> out(new T[ln], [] (T * p) { delete[] p; });
+        Op::vecApply(l, r, out.get(), ln);
+
+        Date ts = std::max(lhs.getEffectiveTimestamp(),
+                           rhs.getEffectiveTimestamp());
+        storage = ExpressionValue::embedding(ts, std::move(out), st,
+                                             lhs.getEmbeddingShape());
+        return true;
+    }
+
+    template<typename T>
+    static bool
+    tryVecEmbeddingScalar(const ExpressionValue & lhs,
+                          const ExpressionValue & rhs,
+                          ExpressionValue & storage)
+    {
+        if (!rhs.getAtom().isNumber())
+            return false;
+        constexpr StorageType st = GetStorageType<T>::val;
+        size_t n = 0;
+        const T * l = reinterpret_cast<const T *>
+            (lhs.tryGetFlatEmbeddingData(st, n));
+        if (!l)
+            return false;
+
+        std::shared_ptr<T> out(new T[n], [] (T * p) { delete[] p; });
+        Op::vecApplyScalarRhs(l, (T)rhs.getAtom().toDouble(), out.get(), n);
+
+        Date ts = std::max(lhs.getEffectiveTimestamp(),
+                           rhs.getEffectiveTimestamp());
+        storage = ExpressionValue::embedding(ts, std::move(out), st,
+                                             lhs.getEmbeddingShape());
+        return true;
+    }
+
+    template<typename T>
+    static bool
+    tryVecScalarEmbedding(const ExpressionValue & lhs,
+                          const ExpressionValue & rhs,
+                          ExpressionValue & storage)
+    {
+        if (!lhs.getAtom().isNumber())
+            return false;
+        constexpr StorageType st = GetStorageType<T>::val;
+        size_t n = 0;
+        const T * r = reinterpret_cast<const T *>
+            (rhs.tryGetFlatEmbeddingData(st, n));
+        if (!r)
+            return false;
+
+        std::shared_ptr<T> out(new T[n], [] (T * p) { delete[] p; });
+        Op::vecApplyScalarLhs((T)lhs.getAtom().toDouble(), r, out.get(), n);
+
+        Date ts = std::max(lhs.getEffectiveTimestamp(),
+                           rhs.getEffectiveTimestamp());
+        storage = ExpressionValue::embedding(ts, std::move(out), st,
+                                             rhs.getEmbeddingShape());
+        return true;
+    }
+
     // Context object for scalar operations on the LHS or RHS
     struct ScalarContext {
         ScalarContext(BoundSqlExpression bound)
@@ -352,6 +611,10 @@ struct BinaryOpHelper {
                           ExpressionValue & storage) const
         {
             // embedding * scalar
+            if (tryVecEmbeddingScalar<double>(lhs, rhs, storage)
+                || tryVecEmbeddingScalar<float>(lhs, rhs, storage))
+                return storage;
+
             std::vector<CellValue> lcells = lhs.getEmbeddingCell();
             const CellValue & r = rhs.getAtom();
             for (auto & c: lcells)
@@ -469,6 +732,10 @@ struct BinaryOpHelper {
                        ExpressionValue & storage) const
         {
             // Scalar * embedding
+            if (tryVecScalarEmbedding<double>(lhs, rhs, storage)
+                || tryVecScalarEmbedding<float>(lhs, rhs, storage))
+                return storage;
+
             std::vector<CellValue> rcells = rhs.getEmbeddingCell();
             const CellValue & l = lhs.getAtom();
             for (auto & c: rcells)
@@ -484,6 +751,10 @@ struct BinaryOpHelper {
                           ExpressionValue & storage) const
         {
             // embedding * embedding
+            if (tryVecEmbeddingEmbedding<double>(lhs, rhs, storage)
+                || tryVecEmbeddingEmbedding<float>(lhs, rhs, storage))
+                return storage;
+
             std::vector<CellValue> lcells = lhs.getEmbeddingCell();
             std::vector<CellValue> rcells = rhs.getEmbeddingCell();
 
@@ -816,6 +1087,30 @@ struct BinaryOpHelper {
                                 GET_LATEST);
         result.expr = expr->shared_from_this();
 
+        // Batch path: evaluate both operands over the whole block, then
+        // apply the (statically dispatched) operation in a tight loop.
+        result.execBatch = [=] (const SqlRowScope * const * rowScopes,
+                                size_t numRows,
+                                ExpressionValue * outputs,
+                                const VariableFilter & filter)
+            {
+                std::vector<ExpressionValue> lvals(numRows), rvals(numRows);
+                lhsContext.bound.executeBatch(rowScopes, numRows,
+                                              lvals.data(), GET_LATEST);
+                rhsContext.bound.executeBatch(rowScopes, numRows,
+                                              rvals.data(), GET_LATEST);
+
+                for (size_t i = 0;  i < numRows;  ++i) {
+                    ExpressionValue storage;
+                    const ExpressionValue & res
+                        = lhsContext.applyLhs(rhsContext, lvals[i],
+                                              rvals[i], storage);
+                    if (&res == &storage)
+                        outputs[i] = std::move(storage);
+                    else outputs[i] = res;
+                }
+            };
+
         return result;
     }
 
@@ -957,7 +1252,7 @@ binaryPlusOnTimestamp(const CellValue & l, const CellValue & r)
 
 }
 
-static CellValue binaryPlus(const CellValue & l, const CellValue & r)
+CellValue binaryPlus(const CellValue & l, const CellValue & r)
 {
     if (l.isString() || r.isString())
     {
@@ -1031,7 +1326,7 @@ static CellValue binaryMinusOnTimestamp(const CellValue & l, const CellValue & r
 
 }
 
-static CellValue binaryMinus(const CellValue & l, const CellValue & r)
+CellValue binaryMinus(const CellValue & l, const CellValue & r)
 {
     if (l.isTimestamp())
     {
@@ -1098,7 +1393,7 @@ static CellValue multiplyInterval(const CellValue & l, double rvalue)
     return std::move(CellValue::fromMonthDaySecond(months, days, seconds));
 }
 
-static CellValue binaryMultiplication(const CellValue & l, const CellValue & r)
+CellValue binaryMultiplication(const CellValue & l, const CellValue & r)
 {
     if (l.isTimeinterval() && r.isNumber())
     {
@@ -1111,7 +1406,7 @@ static CellValue binaryMultiplication(const CellValue & l, const CellValue & r)
     else return l.toDouble() * r.toDouble();
 }
 
-static CellValue binaryDivision(const CellValue & l, const CellValue & r)
+CellValue binaryDivision(const CellValue & l, const CellValue & r)
 {
     if (l.isTimeinterval() && r.isNumber())
     {
@@ -1148,7 +1443,7 @@ CellValue safeIntegerMod(const T1 a, const T2 b)
     }
 }
 
-static CellValue binaryModulus(const CellValue & la, const CellValue & ra)
+CellValue binaryModulus(const CellValue & la, const CellValue & ra)
 {
     if (la.isInteger() && ra.isInteger()) {
         if (la.isUInt64() && ra.isUInt64()) {
@@ -1175,6 +1470,30 @@ struct BinaryPlusOp {
         return binaryPlus(l, r);
     }
 
+    /* Kernels over contiguous float/double embedding storage, used by
+       the BinaryOpHelper fast paths.  Semantics match apply() on
+       numbers; the non-numeric cases can't occur in float storage. */
+
+    template<typename T>
+    static void vecApply(const T * l, const T * r, T * o, size_t n)
+    {
+        ML::SIMD::vec_add(l, r, o, n);
+    }
+
+    template<typename T>
+    static void vecApplyScalarRhs(const T * l, T r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = l[i] + r;
+    }
+
+    template<typename T>
+    static void vecApplyScalarLhs(T l, const T * r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = l + r[i];
+    }
+
     static std::shared_ptr<ExpressionValueInfo>
     getInfo(const std::shared_ptr<ExpressionValueInfo> & lhs,
             const std::shared_ptr<ExpressionValueInfo> & rhs)
@@ -1191,6 +1510,26 @@ struct BinaryMinusOp {
         return binaryMinus(l, r);
     }
 
+    template<typename T>
+    static void vecApply(const T * l, const T * r, T * o, size_t n)
+    {
+        ML::SIMD::vec_minus(l, r, o, n);
+    }
+
+    template<typename T>
+    static void vecApplyScalarRhs(const T * l, T r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = l[i] - r;
+    }
+
+    template<typename T>
+    static void vecApplyScalarLhs(T l, const T * r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = l - r[i];
+    }
+
     static std::shared_ptr<ExpressionValueInfo>
     getInfo(const std::shared_ptr<ExpressionValueInfo> & lhs,
             const std::shared_ptr<ExpressionValueInfo> & rhs)
@@ -1207,6 +1546,24 @@ struct BinaryMultiplicationOp {
         return binaryMultiplication(l, r);
     }
 
+    template<typename T>
+    static void vecApply(const T * l, const T * r, T * o, size_t n)
+    {
+        ML::SIMD::vec_prod(l, r, o, n);
+    }
+
+    template<typename T>
+    static void vecApplyScalarRhs(const T * l, T r, T * o, size_t n)
+    {
+        ML::SIMD::vec_scale(l, r, o, n);
+    }
+
+    template<typename T>
+    static void vecApplyScalarLhs(T l, const T * r, T * o, size_t n)
+    {
+        ML::SIMD::vec_scale(r, l, o, n);
+    }
+
     static std::shared_ptr<ExpressionValueInfo>
     getInfo(const std::shared_ptr<ExpressionValueInfo> & lhs,
             const std::shared_ptr<ExpressionValueInfo> & rhs)
@@ -1223,6 +1580,30 @@ struct BinaryDivisionOp {
         return binaryDivision(l, r);
     }
 
+    /* No SIMD division kernel; the plain loops still skip the
+       per-element CellValue boxing. */
+
+    template<typename T>
+    static void vecApply(const T * l, const T * r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = l[i] / r[i];
+    }
+
+    template<typename T>
+    static void vecApplyScalarRhs(const T * l, T r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = l[i] / r;
+    }
+
+    template<typename T>
+    static void vecApplyScalarLhs(T l, const T * r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = l / r[i];
+    }
+
     static std::shared_ptr<ExpressionValueInfo>
     getInfo(const std::shared_ptr<ExpressionValueInfo> & lhs,
             const std::shared_ptr<ExpressionValueInfo> & rhs)
@@ -1239,6 +1620,27 @@ struct BinaryModulusOp {
         return binaryModulus(l, r);
     }
 
+    template<typename T>
+    static void vecApply(const T * l, const T * r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = std::fmod(l[i], r[i]);
+    }
+
+    template<typename T>
+    static void vecApplyScalarRhs(const T * l, T r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = std::fmod(l[i], r);
+    }
+
+    template<typename T>
+    static void vecApplyScalarLhs(T l, const T * r, T * o, size_t n)
+    {
+        for (size_t i = 0;  i < n;  ++i)
+            o[i] = std::fmod(l, r[i]);
+    }
+
     static std::shared_ptr<ExpressionValueInfo>
     getInfo(const std::shared_ptr<ExpressionValueInfo> & lhs,
             const std::shared_ptr<ExpressionValueInfo> & rhs)
@@ -1909,7 +2311,8 @@ bind(SqlBindingScope & scope) const
     auto boundRhs = rhs->bind(scope);
 
     if (op == "AND" && lhs) {
-        return {[=] (const SqlRowScope & row,
+        BoundSqlExpression result
+            = {[=] (const SqlRowScope & row,
                      ExpressionValue & storage,
                      const VariableFilter & filter) -> const ExpressionValue &
                 {
@@ -1942,9 +2345,102 @@ bind(SqlBindingScope & scope) const
                 },
                 this,
                 std::make_shared<BooleanValueInfo>()};
+
+        /* Runtime conjunct reordering: conjuncts evaluate in written
+           order, which puts an expensive first conjunct (say a regex)
+           ahead of a cheap selective one.  The first batches time
+           both sides and count how many rows each keeps; once enough
+           rows have been sampled the remainder of the scan runs
+           whichever order has the lower expected cost per row.
+           Filtering with AND is order-independent, so only the batch
+           filter path reorders.  One stats block per binding, shared
+           across the worker threads of the scan. */
+        struct AndFilterStats {
+            enum Order {
+                ORDER_MEASURING = 0,
+                ORDER_LHS_FIRST,
+                ORDER_RHS_FIRST
+            };
+
+            /// Rows sampled before the order is locked in
+            enum { SAMPLE_ROWS = 4096 };
+
+            std::atomic<uint64_t> lhsRows{0}, lhsKept{0}, lhsTicks{0};
+            std::atomic<uint64_t> rhsRows{0}, rhsKept{0}, rhsTicks{0};
+            std::atomic<int> order{ORDER_MEASURING};
+        };
+
+        auto stats = std::make_shared<AndFilterStats>();
+
+        // As a filter, AND refines the selection vector: the second
+        // predicate only ever sees the rows the first one kept
+        result.execFilter = [=] (const SqlRowScope * const * contexts,
+                                 uint32_t * indexes,
+                                 size_t numIn) -> size_t
+            {
+                switch (stats->order.load(std::memory_order_relaxed)) {
+                case AndFilterStats::ORDER_LHS_FIRST: {
+                    size_t numLeft
+                        = boundLhs.filterBatch(contexts, indexes, numIn);
+                    return boundRhs.filterBatch(contexts, indexes, numLeft);
+                }
+                case AndFilterStats::ORDER_RHS_FIRST: {
+                    size_t numLeft
+                        = boundRhs.filterBatch(contexts, indexes, numIn);
+                    return boundLhs.filterBatch(contexts, indexes, numLeft);
+                }
+                }
+
+                // Sampling phase: written order, each side timed
+                uint64_t t0 = ML::ticks();
+                size_t numLeft = boundLhs.filterBatch(contexts, indexes, numIn);
+                uint64_t t1 = ML::ticks();
+                size_t numOut = boundRhs.filterBatch(contexts, indexes, numLeft);
+                uint64_t t2 = ML::ticks();
+
+                stats->lhsRows += numIn;
+                stats->lhsKept += numLeft;
+                stats->lhsTicks += t1 - t0;
+                stats->rhsRows += numLeft;
+                stats->rhsKept += numOut;
+                stats->rhsTicks += t2 - t1;
+
+                uint64_t lhsRows = stats->lhsRows;
+                uint64_t rhsRows = stats->rhsRows;
+                if (lhsRows >= AndFilterStats::SAMPLE_ROWS) {
+                    // Expected per-row cost of each order, assuming
+                    // the conjuncts are independent.  The right side
+                    // was only measured on rows the left one kept; if
+                    // that was no rows at all, the left side filters
+                    // everything and stays first.
+                    int decision = AndFilterStats::ORDER_LHS_FIRST;
+                    if (rhsRows > 0) {
+                        double lhsCost = 1.0 * stats->lhsTicks / lhsRows;
+                        double rhsCost = 1.0 * stats->rhsTicks / rhsRows;
+                        double lhsSel = 1.0 * stats->lhsKept / lhsRows;
+                        double rhsSel = 1.0 * stats->rhsKept / rhsRows;
+
+                        if (rhsCost + rhsSel * lhsCost
+                            < lhsCost + lhsSel * rhsCost)
+                            decision = AndFilterStats::ORDER_RHS_FIRST;
+                    }
+
+                    int expected = AndFilterStats::ORDER_MEASURING;
+                    if (stats->order.compare_exchange_strong(expected, decision)
+                        && decision == AndFilterStats::ORDER_RHS_FIRST) {
+                        if (auto * counter = PredicateReorderCounter::current())
+                            ++*counter;
+                    }
+                }
+
+                return numOut;
+            };
+
+        return result;
     }
     else if (op == "OR" && lhs) {
-        return {[=] (const SqlRowScope & row,
+        BoundSqlExpression result
+            = {[=] (const SqlRowScope & row,
                      ExpressionValue & storage,
                      const VariableFilter & filter)
                 -> const ExpressionValue &
@@ -1980,6 +2476,36 @@ bind(SqlBindingScope & scope) const
                 },
                 this,
                 std::make_shared<BooleanValueInfo>()};
+
+        // As a filter, OR gives the rows the left predicate rejected a
+        // second chance with the right one, then merges the two kept
+        // sets back into ascending order
+        result.execFilter = [=] (const SqlRowScope * const * contexts,
+                                 uint32_t * indexes,
+                                 size_t numIn) -> size_t
+            {
+                std::vector<uint32_t> input(indexes, indexes + numIn);
+                size_t numLeft = boundLhs.filterBatch(contexts, indexes, numIn);
+
+                std::vector<uint32_t> rejected;
+                rejected.reserve(numIn - numLeft);
+                std::set_difference(input.begin(), input.end(),
+                                    indexes, indexes + numLeft,
+                                    std::back_inserter(rejected));
+
+                size_t numRight
+                    = boundRhs.filterBatch(contexts, rejected.data(),
+                                           rejected.size());
+
+                std::vector<uint32_t> merged(numLeft + numRight);
+                std::merge(indexes, indexes + numLeft,
+                           rejected.begin(), rejected.begin() + numRight,
+                           merged.begin());
+                std::copy(merged.begin(), merged.end(), indexes);
+                return merged.size();
+            };
+
+        return result;
     }
     else if (op == "NOT" && !lhs) {
         return {[=] (const SqlRowScope & row,
@@ -2194,6 +2720,44 @@ bind(SqlBindingScope & scope) const
     ++scope.functionStackDepth;
     Scope_Exit(--scope.functionStackDepth);
 
+    // A chain like normalize(embedding(tokenize(x))) materializes an
+    // ExpressionValue between each pair of functions.  When the scope
+    // can fuse the chain (see doGetFusedFunctionChain), the
+    // intermediates stay in their typed form instead.  The longest
+    // fusable run from the outside in wins; whatever remains inside it
+    // is bound as the argument in the usual way.
+    if (tableName.empty() && args.size() == 1) {
+        std::vector<Utf8String> chainNames = { functionName };
+        std::vector<const FunctionCallExpression *> chainNodes = { this };
+
+        const FunctionCallExpression * node = this;
+        while (node->args.size() == 1) {
+            auto inner = dynamic_cast<const FunctionCallExpression *>
+                (node->args[0].get());
+            if (!inner || !inner->tableName.empty())
+                break;
+            chainNames.push_back(inner->functionName);
+            chainNodes.push_back(inner);
+            node = inner;
+        }
+
+        for (size_t len = chainNames.size();  len >= 2;  --len) {
+            const FunctionCallExpression * innermost = chainNodes[len - 1];
+
+            std::vector<BoundSqlExpression> boundInnerArgs;
+            for (auto & arg: innermost->args)
+                boundInnerArgs.emplace_back(arg->bind(scope));
+
+            std::vector<Utf8String> names(chainNames.begin(),
+                                          chainNames.begin() + len);
+
+            BoundFunction fused
+                = scope.doGetFusedFunctionChain(names, boundInnerArgs, scope);
+            if (fused)
+                return bindBuiltinFunction(scope, boundInnerArgs, fused);
+        }
+    }
+
     std::vector<BoundSqlExpression> boundArgs;
     for (auto& arg : args) {
         boundArgs.emplace_back(std::move(arg->bind(scope)));
@@ -230,6 +230,64 @@ BOOST_AUTO_TEST_CASE(test_indexes)
     BOOST_CHECK_EQUAL(PathElement(-1000).toIndex(), -1);
 }
 
+BOOST_AUTO_TEST_CASE(test_element_interning)
+{
+    // Elements too long to store inline are interned process-wide the
+    // first time they are hashed; equality and hashing must behave the
+    // same before and after that happens
+
+    std::string longName1(40, 'x');
+    std::string longName2 = longName1;
+    longName2[39] = 'y';
+
+    PathElement el1(longName1);
+    PathElement el1b(longName1);
+    PathElement el2(longName2);
+
+    BOOST_CHECK_EQUAL(el1, el1b);
+    BOOST_CHECK_NE(el1, el2);
+
+    uint64_t h = el1.hash();
+    BOOST_CHECK_EQUAL(h, el1b.hash());
+    BOOST_CHECK_EQUAL(h, el1.hash());   // cached second time around
+    BOOST_CHECK_NE(h, el2.hash());
+
+    // Equality still holds once both sides carry an intern id
+    BOOST_CHECK_EQUAL(el1, el1b);
+    BOOST_CHECK_NE(el1, el2);
+
+    // An interned element compared against a fresh copy of the same name
+    BOOST_CHECK_EQUAL(el1, PathElement(longName1));
+    BOOST_CHECK_EQUAL(PathElement(longName1), el1);
+
+    // Copies and moves keep the cached hash
+    PathElement el1c(el1);
+    BOOST_CHECK_EQUAL(el1c, el1);
+    BOOST_CHECK_EQUAL(el1c.hash(), h);
+    PathElement el1m(std::move(el1c));
+    BOOST_CHECK_EQUAL(el1m, el1);
+    BOOST_CHECK_EQUAL(el1m.hash(), h);
+
+    // Inline elements can never equal out of line ones
+    BOOST_CHECK_NE(PathElement("x"), el1);
+
+    // Paths containing long elements hash and compare consistently
+    Path p1 = PathElement("row") + PathElement(longName1);
+    Path p2 = PathElement("row") + PathElement(longName1);
+    Path p3 = PathElement("row") + PathElement(longName2);
+    BOOST_CHECK_EQUAL(p1, p2);
+    BOOST_CHECK_EQUAL(p1.hash(), p2.hash());
+    BOOST_CHECK_NE(p1, p3);
+
+    // Inline elements: repeated hashing through the per-thread cache
+    PathElement shortEl("someColumn");
+    uint64_t sh = shortEl.hash();
+    for (int i = 0;  i < 1000;  ++i) {
+        BOOST_REQUIRE_EQUAL(shortEl.hash(), sh);
+    }
+    BOOST_CHECK_EQUAL(PathElement("someColumn").hash(), sh);
+}
+
 BOOST_AUTO_TEST_CASE(test_remove_prefix)
 {
     Path test = PathElement("test1") + PathElement("x");
@@ -222,7 +222,7 @@ tokenize(std::unordered_map<Utf8String, int>& bagOfWords,
          const Utf8String& quotechar,
          int offset, int limit,
          int min_token_length,
-         ML::distribution<float, std::vector<float> > & ngram_range)
+         const ML::distribution<float, std::vector<float> > & ngram_range)
 {
     int count = 0;
  
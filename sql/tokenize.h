@@ -36,7 +36,7 @@ namespace Datacratic {
                   const Utf8String& quotechar,
                   int offset, int limit,
                   int min_token_length,
-                  ML::distribution<float, std::vector<float> > & ngram_range);
+                  const ML::distribution<float, std::vector<float> > & ngram_range);
 
     Utf8String token_extract(ML::Parse_Context& context,
                              const Utf8String& splitchars,
@@ -382,6 +382,8 @@ struct TensorflowGraphConfig {
     Url modelFileUrl;
     SelectExpression inputs;
     SelectExpression outputs;
+    int batchSize = 1;
+    double batchDelayMs = 2.0;
 };
 
 
@@ -400,6 +402,19 @@ TensorflowGraphConfigDescription()
     addField("outputs", &TensorflowGraphConfig::outputs,
              "Outputs of the graph that are returned as the result of "
              "the function");
+    addField("batchSize", &TensorflowGraphConfig::batchSize,
+             "Maximum number of concurrent applications of the function "
+             "that will be coalesced into a single run of the graph.  "
+             "This improves device (especially GPU) occupancy when many "
+             "requests arrive together, but only applies to graphs whose "
+             "input tensors have a leading batch dimension of one and "
+             "whose outputs keep that batch dimension.  The default of "
+             "one disables batching.", 1);
+    addField("batchDelayMs", &TensorflowGraphConfig::batchDelayMs,
+             "Maximum time, in milliseconds, that an application of the "
+             "function will wait for other applications to join its "
+             "batch before running it anyway.  Only meaningful when "
+             "batchSize is greater than one.", 2.0);
 }
 
 struct TensorflowGraph: public Function {
@@ -610,7 +625,30 @@ struct TensorflowGraph: public Function {
 
     mutable std::mutex queueLock;
     mutable std::condition_variable queueCond;
-    
+
+    /// One call() waiting for its batch to be run.  Lives on the stack
+    /// of the waiting caller, which blocks until done is set.
+    struct BatchEntry {
+        const std::vector<tensorflow::Tensor> * inputs = nullptr;
+        std::vector<tensorflow::Tensor> outputs;
+        std::exception_ptr exc;
+        bool done = false;
+    };
+
+    /// Batch of calls being accumulated.  The first call to arrive is
+    /// the leader: it waits up to batchDelayMs for others to join, then
+    /// runs the whole batch and distributes the output slices.  Only
+    /// calls with the same input and output layers can share a batch.
+    struct PendingBatch {
+        std::vector<std::string> inputLayers;
+        std::vector<std::string> outputLayers;
+        std::vector<BatchEntry *> entries;
+    };
+
+    mutable std::mutex batchLock;
+    mutable std::condition_variable batchCond;
+    mutable std::shared_ptr<PendingBatch> pendingBatch;
+
 
     Any getStatus() const
     {
@@ -1022,6 +1060,196 @@ struct TensorflowGraph: public Function {
         }
     }
 
+    template<typename T>
+    static void
+    concatTensorsT(const std::vector<const tensorflow::Tensor *> & inputs,
+                   tensorflow::Tensor & result)
+    {
+        auto out = result.flat<T>();
+        size_t pos = 0;
+        for (auto & t: inputs) {
+            auto in = t->flat<T>();
+            for (size_t i = 0;  i < (size_t)in.size();  ++i)
+                out(pos++) = in(i);
+        }
+    }
+
+    /** Concatenate tensors along their leading (batch) dimension.  All
+        of them must have the same datatype and the same trailing
+        dimensions.
+    */
+    static tensorflow::Tensor
+    concatTensors(const std::vector<const tensorflow::Tensor *> & inputs)
+    {
+        using namespace tensorflow;
+
+        const Tensor & first = *inputs.at(0);
+        TensorShape shape = first.shape();
+        int64 totalRows = 0;
+        for (auto & t: inputs) {
+            ExcAssertEqual(t->dtype(), first.dtype());
+            ExcAssertEqual(t->dims(), first.dims());
+            for (int d = 1;  d < t->dims();  ++d)
+                ExcAssertEqual(t->dim_size(d), first.dim_size(d));
+            totalRows += t->dim_size(0);
+        }
+        shape.set_dim(0, totalRows);
+
+        Tensor result(first.dtype(), shape);
+
+        switch (first.dtype()) {
+        case DT_FLOAT:
+            concatTensorsT<float>(inputs, result);  break;
+        case DT_DOUBLE:
+            concatTensorsT<double>(inputs, result);  break;
+        case DT_INT32:
+            concatTensorsT<int32_t>(inputs, result);  break;
+        case DT_UINT8:
+            concatTensorsT<uint8_t>(inputs, result);  break;
+        case DT_INT16:
+            concatTensorsT<int16_t>(inputs, result);  break;
+        case DT_INT8:
+            concatTensorsT<int8_t>(inputs, result);  break;
+        case DT_STRING:
+            concatTensorsT<std::string>(inputs, result);  break;
+        case DT_BOOL:
+            concatTensorsT<bool>(inputs, result);  break;
+        default:
+            throw HttpReturnException(400, "Can't batch tensor of this type "
+                                      "for TensorFlow");
+        }
+
+        return result;
+    }
+
+    /** A call can join a batch only if every one of its input tensors
+        has a leading batch dimension of exactly one row, since batching
+        works by concatenating the inputs along that dimension.
+    */
+    static bool isBatchable(const std::vector<tensorflow::Tensor> & inputs)
+    {
+        for (auto & t: inputs) {
+            if (t.dims() < 1 || t.dim_size(0) != 1)
+                return false;
+        }
+        return !inputs.empty();
+    }
+
+    /** Coalesce this call with other concurrent calls into a single
+        batched run of the graph.  The first call to arrive leads the
+        batch: it waits up to batchDelayMs for up to batchSize - 1
+        others to join, concatenates the inputs, runs the graph once,
+        and hands each caller its slice of the outputs.
+    */
+    std::vector<tensorflow::Tensor>
+    callBatched(const std::vector<tensorflow::Tensor> & inputs,
+                const std::vector<string> & inputLayers,
+                const std::vector<string> & outputLayers) const
+    {
+        using namespace tensorflow;
+
+        BatchEntry entry;
+        entry.inputs = &inputs;
+
+        std::shared_ptr<PendingBatch> batch;
+
+        {
+            std::unique_lock<std::mutex> guard(batchLock);
+
+            if (pendingBatch
+                && pendingBatch->inputLayers == inputLayers
+                && pendingBatch->outputLayers == outputLayers
+                && (int)pendingBatch->entries.size()
+                    < functionConfig.batchSize) {
+                // Join the batch being accumulated, and wait for its
+                // leader to run the graph for us.
+                auto joined = pendingBatch;
+                joined->entries.push_back(&entry);
+                if ((int)joined->entries.size() == functionConfig.batchSize)
+                    batchCond.notify_all();  // wake the leader early
+                batchCond.wait(guard, [&] () { return entry.done; });
+                if (entry.exc)
+                    std::rethrow_exception(entry.exc);
+                return std::move(entry.outputs);
+            }
+
+            // Start a new batch and lead it.  If an incompatible batch
+            // was pending, we simply displace it; its leader holds its
+            // own reference and will still run it.
+            batch = std::make_shared<PendingBatch>();
+            batch->inputLayers = inputLayers;
+            batch->outputLayers = outputLayers;
+            batch->entries.push_back(&entry);
+            pendingBatch = batch;
+
+            std::chrono::duration<double, std::milli>
+                delay(functionConfig.batchDelayMs);
+            batchCond.wait_for(guard, delay,
+                               [&] () {
+                                   return (int)batch->entries.size()
+                                       >= functionConfig.batchSize;
+                               });
+
+            // Nobody else can join past this point
+            if (pendingBatch == batch)
+                pendingBatch.reset();
+        }
+
+        std::exception_ptr exc;
+
+        try {
+            vector<pair<string, Tensor> > inputTensors;
+            for (unsigned i = 0;  i < inputLayers.size();  ++i) {
+                std::vector<const Tensor *> toConcat;
+                toConcat.reserve(batch->entries.size());
+                for (auto & e: batch->entries)
+                    toConcat.push_back(&e->inputs->at(i));
+                inputTensors.emplace_back(inputLayers[i],
+                                          toConcat.size() == 1
+                                          ? *toConcat[0]
+                                          : concatTensors(toConcat));
+            }
+
+            auto outputs = runGraph(std::move(inputTensors), outputLayers);
+
+            int64 numRows = batch->entries.size();
+            for (auto & output: outputs) {
+                if (output.dims() < 1 || output.dim_size(0) != numRows)
+                    throw HttpReturnException
+                        (400, "Output of batched TensorFlow graph doesn't "
+                         "keep the batch dimension; set batchSize to 1 "
+                         "for this model",
+                         "batchSize", functionConfig.batchSize);
+            }
+
+            // Hand each entry its slice of the outputs.  Slice shares
+            // the underlying buffer, so no copy is made here.
+            for (unsigned row = 0;  row < batch->entries.size();  ++row) {
+                auto & e = *batch->entries[row];
+                for (auto & output: outputs)
+                    e.outputs.emplace_back(output.Slice(row, row + 1));
+            }
+        } catch (...) {
+            exc = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> guard(batchLock);
+            for (auto & e: batch->entries) {
+                if (e == &entry)
+                    continue;
+                e->exc = exc;
+                e->done = true;
+            }
+            batchCond.notify_all();
+        }
+
+        if (exc)
+            std::rethrow_exception(exc);
+
+        return std::move(entry.outputs);
+    }
+
     std::vector<tensorflow::Tensor>
     call(const std::vector<tensorflow::Tensor> & inputs,
          const std::vector<string> & inputLayers,
@@ -1032,6 +1260,9 @@ struct TensorflowGraph: public Function {
 
         ExcAssertEqual(inputs.size(), inputLayers.size());
 
+        if (functionConfig.batchSize > 1 && isBatchable(inputs))
+            return callBatched(inputs, inputLayers, outputLayers);
+
         // Note: passing constants in makes startup faster but causes
         // problems accessing them, so it's not done.
         vector<pair<string, Tensor> > inputTensors; // = constants;
@@ -1052,6 +1283,19 @@ struct TensorflowGraph: public Function {
             }
         }
 
+        return runGraph(std::move(inputTensors), outputLayers);
+    }
+
+    /** Run one (possibly batched) step of the graph on the least
+        loaded session.
+    */
+    std::vector<tensorflow::Tensor>
+    runGraph(std::vector<std::pair<std::string, tensorflow::Tensor> >
+                 inputTensors,
+             const std::vector<string> & outputLayers) const
+    {
+        using namespace tensorflow;
+
         Date before = Date::now();
 
         std::vector<Tensor> outputs;
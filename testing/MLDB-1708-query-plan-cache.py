@@ -0,0 +1,101 @@
+#
+# MLDB-1708-query-plan-cache.py
+# 29 août 2016
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Checks that the cached query plan of sql.query functions is invalidated
+# when the datasets it reads are updated or replaced, and that repeated
+# /v1/query calls (which share a statement cache) keep seeing fresh data.
+#
+
+import unittest, json
+
+mldb = mldb_wrapper.wrap(mldb) # noqa
+
+class Mldb1708(MldbUnitTest):
+    @classmethod
+    def setUpClass(self):
+        ds = mldb.create_dataset({ "id": "data", "type": "sparse.mutable" })
+        ds.record_row("r1", [["x", 1, 0]])
+        ds.commit()
+
+        mldb.put("/v1/functions/probe", {
+            "type": "sql.query",
+            "params": {
+                "query": "select sum(x) as total from data"
+            }
+        })
+
+    def test_repeated_application_is_stable(self):
+        for _ in range(3):
+            rez = mldb.get("/v1/functions/probe/application",
+                           input={}).json()
+            self.assertEqual(rez["output"]["total"], 1)
+
+    def test_plan_invalidated_on_commit(self):
+        rez = mldb.get("/v1/functions/probe/application", input={}).json()
+        self.assertEqual(rez["output"]["total"], 1)
+
+        ds = mldb.create_dataset({ "id": "data2", "type": "sparse.mutable" })
+        ds.record_row("r1", [["x", 10, 0]])
+        ds.record_row("r2", [["x", 20, 0]])
+        ds.commit()
+
+        mldb.put("/v1/functions/probe2", {
+            "type": "sql.query",
+            "params": {
+                "query": "select sum(x) as total from data2"
+            }
+        })
+
+        rez = mldb.get("/v1/functions/probe2/application", input={}).json()
+        self.assertEqual(rez["output"]["total"], 30)
+
+        # Updating the dataset must invalidate the cached plan
+        ds.record_row("r3", [["x", 100, 0]])
+        ds.commit()
+
+        rez = mldb.get("/v1/functions/probe2/application", input={}).json()
+        self.assertEqual(rez["output"]["total"], 130)
+
+    def test_plan_invalidated_on_dataset_replacement(self):
+        ds = mldb.create_dataset({ "id": "data3", "type": "sparse.mutable" })
+        ds.record_row("r1", [["x", 5, 0]])
+        ds.commit()
+
+        mldb.put("/v1/functions/probe3", {
+            "type": "sql.query",
+            "params": {
+                "query": "select sum(x) as total from data3"
+            }
+        })
+
+        rez = mldb.get("/v1/functions/probe3/application", input={}).json()
+        self.assertEqual(rez["output"]["total"], 5)
+
+        # Deleting and recreating the dataset under the same name must
+        # also invalidate the plan, even though the versions restart
+        mldb.delete("/v1/datasets/data3")
+        ds = mldb.create_dataset({ "id": "data3", "type": "sparse.mutable" })
+        ds.record_row("r1", [["x", 7, 0]])
+        ds.commit()
+
+        rez = mldb.get("/v1/functions/probe3/application", input={}).json()
+        self.assertEqual(rez["output"]["total"], 7)
+
+    def test_repeated_query_endpoint_sees_updates(self):
+        ds = mldb.create_dataset({ "id": "data4", "type": "sparse.mutable" })
+        ds.record_row("r1", [["x", 1, 0]])
+        ds.commit()
+
+        q = "select sum(x) as total from data4"
+        self.assertEqual(mldb.query(q)[1][1], 1)
+        # same query text again, now served through the statement cache
+        self.assertEqual(mldb.query(q)[1][1], 1)
+
+        ds.record_row("r2", [["x", 2, 0]])
+        ds.commit()
+
+        self.assertEqual(mldb.query(q)[1][1], 3)
+
+mldb.run_tests()
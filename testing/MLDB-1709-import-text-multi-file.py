@@ -0,0 +1,92 @@
+#
+# MLDB-1709-import-text-multi-file.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Test of import.text with several files imported into one dataset.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+def import_rows(conf):
+    mldb.put("/v1/procedures/multi_import", conf)
+    res = mldb.get(
+        "/v1/query",
+        q="select a, b from multi order by a").json()
+    return res
+
+
+# Explicit list of files
+conf = {
+    "type": "import.text",
+    "params": {
+        "dataFileUrls": [
+            "file://mldb/testing/dataset/MLDB-1709-part1.csv",
+            "file://mldb/testing/dataset/MLDB-1709-part2.csv"
+        ],
+        "outputDataset": {
+            "id": "multi"
+        },
+        "runOnCreation": True
+    }
+}
+
+response = import_rows(conf)
+
+assert len(response) == 4, \
+    'expected rows from both files, got %d' % len(response)
+assert [row['columns'][0][1] for row in response] == [1, 2, 3, 4]
+
+# Default row names must not collide across files
+row_names = set(row['rowName'] for row in response)
+assert len(row_names) == 4, 'row names should be unique across files'
+
+# Wildcard expansion of a prefix
+conf = {
+    "type": "import.text",
+    "params": {
+        "dataFileUrls": [
+            "file://mldb/testing/dataset/MLDB-1709-part*"
+        ],
+        "outputDataset": {
+            "id": "multi2"
+        },
+        "runOnCreation": True
+    }
+}
+
+mldb.put("/v1/procedures/multi_import2", conf)
+
+response = mldb.get(
+    "/v1/query",
+    q="select a, b from multi2 order by a").json()
+
+assert len(response) == 4, \
+    'expected wildcard to pick up both files, got %d' % len(response)
+
+# dataFileUrl and dataFileUrls can be combined, and a custom named
+# expression is left alone
+conf = {
+    "type": "import.text",
+    "params": {
+        "dataFileUrl": "file://mldb/testing/dataset/MLDB-1709-part1.csv",
+        "dataFileUrls": [
+            "file://mldb/testing/dataset/MLDB-1709-part2.csv"
+        ],
+        "named": "a",
+        "outputDataset": {
+            "id": "multi3"
+        },
+        "runOnCreation": True
+    }
+}
+
+mldb.put("/v1/procedures/multi_import3", conf)
+
+response = mldb.get(
+    "/v1/query",
+    q="select a from multi3 order by a").json()
+
+assert [row['rowName'] for row in response] == ['1', '2', '3', '4']
+
+mldb.script.set_return("success")
@@ -0,0 +1,116 @@
+#
+# MLDB-1710-query-profile.py
+# 29 août 2016
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Checks that /v1/query?profile=1 returns a timing breakdown in the
+# X-Query-Profile header and that profiled queries show up in
+# /v1/queryProfiles, newest first.
+#
+
+import unittest, json
+
+mldb = mldb_wrapper.wrap(mldb) # noqa
+
+class Mldb1710(MldbUnitTest):
+    @classmethod
+    def setUpClass(self):
+        ds = mldb.create_dataset({ "id": "data", "type": "sparse.mutable" })
+        for i in range(10):
+            ds.record_row("r%d" % i, [["x", i, 0]])
+        ds.commit()
+
+    def test_profile_header(self):
+        rez = mldb.get("/v1/query", q="select x from data", profile=1)
+        self.assertTrue("X-Query-Profile" in rez.headers)
+
+        profile = json.loads(rez.headers["X-Query-Profile"])
+        self.assertEqual(profile["query"], "select x from data")
+        self.assertEqual(profile["rowsReturned"], 10)
+        for phase in ["parseSeconds", "executeSeconds",
+                      "serializeSeconds", "totalSeconds"]:
+            self.assertGreaterEqual(profile[phase], 0)
+        self.assertGreaterEqual(profile["totalSeconds"],
+                                profile["executeSeconds"])
+
+        # the rows themselves are unchanged by profiling
+        self.assertEqual(len(rez.json()), 10)
+
+    def test_hardware_counters_when_available(self):
+        # Hardware counters need perf_event access, which many test
+        # environments don't grant; only check the shape when present.
+        rez = mldb.get("/v1/query", q="select x from data", profile=1)
+        profile = json.loads(rez.headers["X-Query-Profile"])
+        if "hardware" not in profile:
+            return
+        for phase, counters in profile["hardware"].items():
+            self.assertGreater(counters["cycles"], 0, phase)
+            self.assertGreater(counters["instructions"], 0, phase)
+            self.assertGreater(counters["ipc"], 0, phase)
+            self.assertGreaterEqual(counters["llcMisses"], 0, phase)
+            self.assertGreaterEqual(counters["branchMisses"], 0, phase)
+
+    def test_predicate_reordering_reported(self):
+        # An expensive regex first and a cheap, highly selective
+        # comparison second is the case conjunct reordering exists
+        # for.  The decision depends on measured timings, so only
+        # check the reported shape, and that correctness held.
+        ds = mldb.create_dataset({ "id": "wide", "type": "tabular" })
+        for i in xrange(20000):
+            ds.record_row("r%d" % i, [["s", "prefix-%d-suffix" % i, 0],
+                                      ["i", i, 0]])
+        ds.commit()
+
+        rez = mldb.get(
+            "/v1/query",
+            q="select i from wide "
+              "where regex_match(s, 'prefix-[0-9]+-suffix') and i < 3",
+            profile=1)
+        self.assertEqual(len(rez.json()), 3)
+
+        profile = json.loads(rez.headers["X-Query-Profile"])
+        if "predicatesReordered" in profile:
+            self.assertGreaterEqual(profile["predicatesReordered"], 1)
+
+    def test_explain_reported(self):
+        rez = mldb.get("/v1/query", q="select x from data", profile=1)
+        profile = json.loads(rez.headers["X-Query-Profile"])
+
+        ops = {op["operator"]: op for op in profile["explain"]}
+        executors = [n for n in ops if n.startswith("executor.")]
+        self.assertEqual(len(executors), 1)
+        self.assertEqual(ops[executors[0]]["rowsOut"], 10)
+        self.assertEqual(ops[executors[0]]["rowsIn"], 10)
+
+    def test_explain_join_strategy(self):
+        rez = mldb.get(
+            "/v1/query",
+            q="select * from data as a join data as b on a.x = b.x",
+            profile=1)
+        profile = json.loads(rez.headers["X-Query-Profile"])
+
+        names = [op["operator"] for op in profile["explain"]]
+        self.assertTrue(any(n.startswith("join.") for n in names), names)
+        self.assertIn("generate", names)
+
+    def test_no_header_by_default(self):
+        rez = mldb.get("/v1/query", q="select x from data")
+        self.assertFalse("X-Query-Profile" in rez.headers)
+
+    def test_profiles_buffer(self):
+        mldb.get("/v1/query", q="select x from data where x > 1", profile=1)
+        mldb.get("/v1/query", q="select x from data where x > 2", profile=1)
+
+        profiles = mldb.get("/v1/queryProfiles", limit=2).json()
+        self.assertEqual(len(profiles), 2)
+        # newest first
+        self.assertEqual(profiles[0]["query"],
+                         "select x from data where x > 2")
+        self.assertEqual(profiles[1]["query"],
+                         "select x from data where x > 1")
+
+    def test_bad_limit(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.get("/v1/queryProfiles", limit=0)
+
+mldb.run_tests()
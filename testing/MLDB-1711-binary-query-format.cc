@@ -0,0 +1,147 @@
+/* MLDB-1711-binary-query-format.cc
+   This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+   Test of the columnar binary output format of /v1/query.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "mldb/server/mldb_server.h"
+#include "mldb/server/dataset_collection.h"
+#include "mldb/plugins/sparse_matrix_dataset.h"
+#include "mldb/sql/cell_value.h"
+
+using namespace std;
+using namespace Datacratic;
+using namespace Datacratic::MLDB;
+
+namespace {
+
+/* Minimal decoder for the format documented in dataset_collection.cc */
+struct BinaryResultReader {
+    BinaryResultReader(const std::string & data)
+        : data(data), pos(0)
+    {
+    }
+
+    const std::string & data;
+    size_t pos;
+
+    void read(void * p, size_t n)
+    {
+        BOOST_REQUIRE_LE(pos + n, data.size());
+        memcpy(p, data.data() + pos, n);
+        pos += n;
+    }
+
+    uint32_t readU32() { uint32_t v;  read(&v, 4);  return v; }
+    uint8_t readU8() { uint8_t v;  read(&v, 1);  return v; }
+    double readF64() { double v;  read(&v, 8);  return v; }
+
+    std::string readStr()
+    {
+        uint32_t len = readU32();
+        std::string result(len, 0);
+        read(&result[0], len);
+        return result;
+    }
+
+    std::vector<bool> readBitmap(size_t numRows)
+    {
+        std::string bytes((numRows + 7) / 8, 0);
+        read(&bytes[0], bytes.size());
+        std::vector<bool> result(numRows);
+        for (size_t i = 0;  i < numRows;  ++i)
+            result[i] = bytes[i >> 3] & (1 << (i & 7));
+        return result;
+    }
+};
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_binary_query_format )
+{
+    MldbServer server;
+    server.init();
+    server.start();
+
+    // Create a dataset with a numeric column, a string column, and a
+    // column with a hole in it
+    PolyConfig pconfig;
+    pconfig.id = "data";
+    MutableSparseMatrixDatasetConfig params;
+    pconfig.params = params;
+    auto dataset = std::make_shared<MutableSparseMatrixDataset>
+        (&server, pconfig, nullptr);
+    server.datasets->addEntry("data", dataset);
+
+    Date ts = Date::fromSecondsSinceEpoch(1000000);
+
+    auto recordRow = [&] (const std::string & rowName,
+                          std::vector<std::tuple<ColumnName, CellValue, Date> >
+                              vals)
+        {
+            dataset->recordRow(PathElement(rowName), vals);
+        };
+
+    recordRow("r1", { { ColumnName("x"), 1.5, ts },
+                      { ColumnName("s"), "hello", ts } });
+    recordRow("r2", { { ColumnName("x"), 2, ts } });
+    recordRow("r3", { { ColumnName("x"), -3.25, ts },
+                      { ColumnName("s"), "world", ts } });
+    dataset->commit();
+
+    auto connection
+        = server.restGet("/v1/query",
+                         { { "q", "select x, s from data order by rowName()" },
+                           { "format", "binary" } });
+
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 200);
+    BOOST_CHECK_EQUAL(connection.contentType, "application/octet-stream");
+
+    BinaryResultReader reader(connection.response);
+
+    char magic[8];
+    reader.read(magic, 8);
+    BOOST_CHECK_EQUAL(std::string(magic, magic + 8), "MLDBBIN1");
+
+    uint32_t numRows = reader.readU32();
+    uint32_t numColumns = reader.readU32();
+    BOOST_CHECK_EQUAL(numRows, 3);
+    BOOST_CHECK_EQUAL(numColumns, 3);  // _rowName, x, s
+
+    // _rowName column: dense strings
+    BOOST_CHECK_EQUAL(reader.readStr(), "_rowName");
+    BOOST_CHECK_EQUAL(reader.readU8(), 2);
+    auto namePresent = reader.readBitmap(numRows);
+    BOOST_CHECK(namePresent[0] && namePresent[1] && namePresent[2]);
+    BOOST_CHECK_EQUAL(reader.readStr(), "r1");
+    BOOST_CHECK_EQUAL(reader.readStr(), "r2");
+    BOOST_CHECK_EQUAL(reader.readStr(), "r3");
+
+    // x column: float64, all rows present
+    BOOST_CHECK_EQUAL(reader.readStr(), "x");
+    BOOST_CHECK_EQUAL(reader.readU8(), 1);
+    auto xPresent = reader.readBitmap(numRows);
+    BOOST_CHECK(xPresent[0] && xPresent[1] && xPresent[2]);
+    BOOST_CHECK_EQUAL(reader.readF64(), 1.5);
+    BOOST_CHECK_EQUAL(reader.readF64(), 2.0);
+    BOOST_CHECK_EQUAL(reader.readF64(), -3.25);
+
+    // s column: strings, hole in r2
+    BOOST_CHECK_EQUAL(reader.readStr(), "s");
+    BOOST_CHECK_EQUAL(reader.readU8(), 2);
+    auto sPresent = reader.readBitmap(numRows);
+    BOOST_CHECK(sPresent[0]);
+    BOOST_CHECK(!sPresent[1]);
+    BOOST_CHECK(sPresent[2]);
+    BOOST_CHECK_EQUAL(reader.readStr(), "hello");
+    BOOST_CHECK_EQUAL(reader.readStr(), "world");
+
+    // Everything consumed
+    BOOST_CHECK_EQUAL(reader.pos, connection.response.size());
+
+    server.shutdown();
+}
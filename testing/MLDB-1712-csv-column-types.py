@@ -0,0 +1,69 @@
+#
+# MLDB-1712-csv-column-types.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Declared column types for import.text (the columnTypes parameter).
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1712CsvColumnTypes(MldbUnitTest):  # noqa
+
+    data_file = "file://mldb/testing/dataset/MLDB-1712.csv"
+
+    def run_import(self, dataset, column_types, **extra):
+        params = {
+            "dataFileUrl": self.data_file,
+            "outputDataset": {"id": dataset},
+            "columnTypes": column_types,
+            "runOnCreation": True
+        }
+        params.update(extra)
+        mldb.put("/v1/procedures/" + dataset + "_import", {
+            "type": "import.text",
+            "params": params
+        })
+
+    def test_declared_types(self):
+        self.run_import("typed", {
+            "id": "string",
+            "count": "integer",
+            "score": "number"
+        })
+
+        res = mldb.query(
+            "select id, count, score from typed order by rowName()")
+        # leading zeros survive in a declared string column
+        self.assertEqual(res[1][1:], ["00123", 10, 1.25])
+        self.assertEqual(res[2][1:], ["00456", -3, 250])
+        # empty cells in declared columns stay null
+        self.assertEqual(res[3][1:], ["007", None, None])
+
+    def test_quoted_field_follows_declaration(self):
+        self.run_import("typed2", {"label": "string"})
+        res = mldb.query("select label from typed2 order by rowName()")
+        # a quoted numeric-looking value in a string column stays a string
+        self.assertEqual(res[3][1], "008")
+
+    def test_bad_value_is_line_error(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):  # noqa
+            self.run_import("bad", {"score": "integer"})
+
+    def test_ignore_bad_lines(self):
+        self.run_import("skipped", {"score": "integer"},
+                        ignoreBadLines=True)
+        res = mldb.query("select count(*) as cnt from skipped")
+        # only the line with an empty score parses as integer
+        self.assertEqual(res[1][1], 1)
+
+    def test_unknown_column_is_rejected(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):  # noqa
+            self.run_import("unknown_col", {"no_such_column": "integer"})
+
+    def test_unknown_type_is_rejected(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):  # noqa
+            self.run_import("unknown_type", {"id": "varchar"})
+
+
+mldb.run_tests()
@@ -0,0 +1,77 @@
+#
+# MLDB-1713-metrics-endpoint.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Per-route latency histograms exposed at /v1/metrics.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1713MetricsEndpoint(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        ds = mldb.create_dataset({"id": "metrics_ds", "type": "sparse.mutable"})
+        for i in xrange(3):
+            ds.record_row("row%d" % i, [["x", i, 0]])
+        ds.commit()
+
+        # Generate some traffic on routes we can assert on
+        for i in xrange(5):
+            mldb.query("select x from metrics_ds")
+            mldb.get("/v1/datasets/metrics_ds")
+
+    def test_json_format(self):
+        metrics = mldb.get("/v1/metrics").json()
+
+        self.assertTrue("rest" in metrics)
+        self.assertTrue("engine" in metrics)
+
+        rest = metrics["rest"]
+
+        # Routes are reported by pattern, not by concrete URL
+        self.assertTrue("GET /v1/datasets/<dataset>" in rest,
+                        sorted(rest.keys()))
+
+        route = rest["GET /v1/datasets/<dataset>"]
+        self.assertGreaterEqual(route["count"], 5)
+        for stat in ["meanMs", "p50Ms", "p90Ms", "p99Ms", "p999Ms", "maxMs"]:
+            self.assertTrue(stat in route, stat)
+
+        # Quantiles are non-decreasing
+        self.assertLessEqual(route["p50Ms"], route["p99Ms"])
+        self.assertLessEqual(route["p99Ms"], route["maxMs"] + 0.001)
+
+    def test_prometheus_format(self):
+        text = mldb.get("/v1/metrics", format="prometheus").text
+
+        self.assertTrue(
+            "# TYPE mldb_rest_request_duration_seconds histogram" in text)
+        self.assertTrue("mldb_engine_counter{" in text)
+
+        lines = [l for l in text.split("\n")
+                 if "route=\"/v1/datasets/<dataset>\"" in l
+                 and "verb=\"GET\"" in l]
+        self.assertTrue(lines, text)
+
+        # The cumulative buckets end with +Inf equal to the count
+        buckets = [l for l in lines if "_bucket{" in l]
+        counts = [l for l in lines if "_count{" in l]
+        self.assertTrue(any("le=\"+Inf\"" in l for l in buckets))
+        inf = [int(l.split(" ")[-1]) for l in buckets
+               if "le=\"+Inf\"" in l][0]
+        total = int(counts[0].split(" ")[-1])
+        self.assertEqual(inf, total)
+
+        values = [int(l.split(" ")[-1]) for l in buckets]
+        self.assertEqual(values, sorted(values))
+
+    def test_metrics_route_itself_is_recorded(self):
+        mldb.get("/v1/metrics")
+        metrics = mldb.get("/v1/metrics").json()
+        self.assertTrue("GET /v1/metrics" in metrics["rest"],
+                        sorted(metrics["rest"].keys()))
+
+
+mldb.run_tests()
@@ -0,0 +1,60 @@
+#
+# MLDB-1714-bulk-row-fetch.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Bulk row fetch through POST /v1/datasets/<dataset>/rows/bulk.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1714BulkRowFetch(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        for dataset_type in ["tabular", "sparse.mutable"]:
+            ds = mldb.create_dataset({
+                "id": dataset_type.replace(".", "_"),
+                "type": dataset_type})
+            for i in xrange(100):
+                ds.record_row("row%d" % i, [["x", i, 0], ["y", "v%d" % i, 0]])
+            ds.commit()
+
+    def check_bulk(self, dataset):
+        names = ["row3", "row99", "row0", "row42"]
+        res = mldb.post("/v1/datasets/%s/rows/bulk" % dataset, names).json()
+
+        # Results line up with the request
+        self.assertEqual([r["rowName"] for r in res], names)
+
+        for name, row in zip(names, res):
+            i = int(name[3:])
+            cols = {c[0]: c[1] for c in row["columns"]}
+            self.assertEqual(cols["x"], i)
+            self.assertEqual(cols["y"], "v%d" % i)
+
+    def test_tabular(self):
+        self.check_bulk("tabular")
+
+    def test_sparse(self):
+        self.check_bulk("sparse_mutable")
+
+    def test_missing_rows_keep_position(self):
+        res = mldb.post("/v1/datasets/tabular/rows/bulk",
+                        ["row1", "no_such_row", "row2"]).json()
+
+        self.assertEqual([r["rowName"] for r in res],
+                         ["row1", "no_such_row", "row2"])
+        self.assertTrue(res[0]["columns"])
+        self.assertEqual(res[1].get("columns", []), [])
+        self.assertTrue(res[2]["columns"])
+
+    def test_large_batch(self):
+        names = ["row%d" % i for i in xrange(100)]
+        res = mldb.post("/v1/datasets/tabular/rows/bulk", names).json()
+        self.assertEqual(len(res), 100)
+        for i, row in enumerate(res):
+            self.assertEqual(row["rowName"], "row%d" % i)
+
+
+mldb.run_tests()
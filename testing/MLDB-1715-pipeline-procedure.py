@@ -0,0 +1,111 @@
+#
+# MLDB-1715-pipeline-procedure.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Pipeline procedure: DAG of child procedures with overlapping steps.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+def transform_step(name, input_ds, output_ds, depends=None):
+    step = {
+        "name": name,
+        "procedure": {
+            "type": "transform",
+            "params": {
+                "inputData": "select x * 2 as y from %s" % input_ds,
+                "outputDataset": {"id": output_ds, "type": "sparse.mutable"}
+            }
+        }
+    }
+    if depends is not None:
+        step["dependsOn"] = depends
+    return step
+
+
+class Mldb1715PipelineProcedure(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        ds = mldb.create_dataset({"id": "base", "type": "sparse.mutable"})
+        for i in xrange(10):
+            ds.record_row("row%d" % i, [["x", i, 0]])
+        ds.commit()
+
+    def run_pipeline(self, params):
+        params["runOnCreation"] = True
+        return mldb.post("/v1/procedures", {
+            "type": "pipeline.run",
+            "params": params})
+
+    def test_serial_default(self):
+        # Without dependsOn the steps run one after the other, so the
+        # second step sees the dataset the first one produced
+        res = self.run_pipeline({
+            "steps": [
+                transform_step("first", "base", "serial_mid"),
+                {
+                    "name": "second",
+                    "procedure": {
+                        "type": "transform",
+                        "params": {
+                            "inputData": "select y + 1 as z from serial_mid",
+                            "outputDataset": {"id": "serial_out",
+                                              "type": "sparse.mutable"}
+                        }
+                    }
+                }
+            ],
+            "intermediates": ["serial_mid"]}).json()
+
+        steps = res["status"]["firstRun"]["status"]["steps"]
+        self.assertEqual([s["name"] for s in steps], ["first", "second"])
+
+        rows = mldb.query("select z from serial_out order by rowName()")
+        self.assertEqual(len(rows), 11)  # header + 10 rows
+        for row in rows[1:]:
+            i = int(row[0][3:])
+            self.assertEqual(row[1], i * 2 + 1)
+
+        # The intermediate dataset was deleted at the end of the run
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.get("/v1/datasets/serial_mid")
+
+    def test_overlapping_steps(self):
+        # Two independent steps followed by one that depends on both
+        self.run_pipeline({
+            "steps": [
+                transform_step("left", "base", "dag_left", depends=[]),
+                transform_step("right", "base", "dag_right", depends=[]),
+                transform_step("join", "dag_left", "dag_out",
+                               depends=["left", "right"])
+            ]})
+
+        for ds in ["dag_left", "dag_right", "dag_out"]:
+            self.assertEqual(
+                mldb.get("/v1/datasets/%s" % ds).json()["status"]["rowCount"],
+                10)
+
+    def test_unknown_dependency_is_rejected(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            self.run_pipeline({
+                "steps": [
+                    transform_step("only", "base", "bad_out",
+                                   depends=["nonexistent"])
+                ]})
+
+    def test_duplicate_step_names_are_rejected(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            self.run_pipeline({
+                "steps": [
+                    transform_step("twin", "base", "dup_out_1"),
+                    transform_step("twin", "base", "dup_out_2")
+                ]})
+
+    def test_empty_pipeline_is_rejected(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            self.run_pipeline({"steps": []})
+
+
+mldb.run_tests()
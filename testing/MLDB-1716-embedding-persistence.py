@@ -0,0 +1,102 @@
+#
+# MLDB-1716-embedding-persistence.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Persistence of embedding datasets: commit saves the dataset and its
+# nearest neighbors index to dataFileUrl, and creating a dataset whose
+# dataFileUrl already exists reloads it instead of re-indexing.
+#
+
+import os
+import tempfile
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+tmp_dir = tempfile.mkdtemp(dir='build/x86_64/tmp')
+
+
+def record_rows(ds, num_rows):
+    for i in xrange(num_rows):
+        ds.record_row("row%d" % i, [["x", i, 0], ["y", i % 7, 0]])
+
+
+class Mldb1716EmbeddingPersistence(MldbUnitTest):  # noqa
+
+    def nn_distances(self, dataset, coords):
+        func = "nn_" + dataset
+        mldb.put("/v1/functions/" + func, {
+            "type": "embedding.neighbors",
+            "params": {"dataset": dataset}})
+        return mldb.query(
+            "select %s({coords: %s, numNeighbors: 3})[distances] as *"
+            % (func, coords))
+
+    def test_reload(self):
+        url = 'file://' + os.path.join(tmp_dir, 'reload.emb')
+
+        ds = mldb.create_dataset({
+            "id": "emb_save",
+            "type": "embedding",
+            "params": {"dataFileUrl": url}})
+        record_rows(ds, 20)
+        ds.commit()
+
+        before = self.nn_distances("emb_save", "'row5'")
+        mldb.delete("/v1/datasets/emb_save")
+
+        # Creating a dataset on the same file reloads it
+        mldb.create_dataset({
+            "id": "emb_load",
+            "type": "embedding",
+            "params": {"dataFileUrl": url}})
+
+        res = mldb.query("select x, y from emb_load order by rowName()")
+        self.assertEqual(len(res), 21)  # header + 20 rows
+        for row in res[1:]:
+            i = int(row[0][3:])
+            self.assertEqual(row[1], i)
+            self.assertEqual(row[2], i % 7)
+
+        # The reloaded index gives the same answers
+        after = self.nn_distances("emb_load", "'row5'")
+        self.assertEqual(before, after)
+
+    def test_incremental_commit(self):
+        ds = mldb.create_dataset({"id": "emb_incr", "type": "embedding"})
+        record_rows(ds, 200)
+        ds.commit()
+
+        # A small addition tops up the built index instead of rebuilding
+        ds.record_row("extra", [["x", 57.5, 0], ["y", 3.5, 0]])
+        ds.commit()
+
+        res = self.nn_distances("emb_incr", "'extra'")
+        self.assertEqual(res[0][1], "extra")
+        self.assertEqual(res[1][1], 0)
+        self.assertEqual(
+            mldb.get("/v1/datasets/emb_incr").json()["status"]["rowCount"],
+            201)
+
+    def test_reload_quantized(self):
+        url = 'file://' + os.path.join(tmp_dir, 'reload_quantized.emb')
+
+        ds = mldb.create_dataset({
+            "id": "emb_q_save",
+            "type": "embedding",
+            "params": {"quantize": True, "dataFileUrl": url}})
+        record_rows(ds, 20)
+        ds.commit()
+
+        before = self.nn_distances("emb_q_save", "'row5'")
+        mldb.delete("/v1/datasets/emb_q_save")
+
+        mldb.create_dataset({
+            "id": "emb_q_load",
+            "type": "embedding",
+            "params": {"quantize": True, "dataFileUrl": url}})
+
+        after = self.nn_distances("emb_q_load", "'row5'")
+        self.assertEqual(before, after)
+
+
+mldb.run_tests()
@@ -0,0 +1,93 @@
+#
+# MLDB-1717-window-procedure.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Window procedure: row number, lag, lead and cumulative sums over
+# partitioned, ordered rows.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1717WindowProcedure(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        ds = mldb.create_dataset({"id": "events", "type": "sparse.mutable"})
+        row = 0
+        for user in ["u0", "u1"]:
+            for t in xrange(1, 6):
+                amount = t * 10 + (100 if user == "u1" else 0)
+                ds.record_row("row%d" % row, [
+                    ["user", user, 0],
+                    ["t", t, 0],
+                    ["amount", amount, 0]])
+                row += 1
+        ds.commit()
+
+        mldb.post("/v1/procedures", {
+            "type": "window",
+            "params": {
+                "inputData": "select 1 from events order by t",
+                "outputDataset": {"id": "windowed", "type": "sparse.mutable"},
+                "partitionBy": "user",
+                "functions": [
+                    {"outputColumn": "n", "function": "rowNumber"},
+                    {"outputColumn": "prev", "function": "lag",
+                     "value": "amount"},
+                    {"outputColumn": "next", "function": "lead",
+                     "value": "amount"},
+                    {"outputColumn": "total", "function": "cumulativeSum",
+                     "value": "amount"}
+                ],
+                "runOnCreation": True
+            }
+        })
+
+    def fetch(self, row_name):
+        res = mldb.query(
+            "select * from windowed where rowName() = '%s'" % row_name)
+        return dict(zip(res[0][1:], res[1][1:]))
+
+    def test_row_number_restarts_per_partition(self):
+        # row0..row4 are u0 at t 1..5; row5..row9 are u1 at t 1..5
+        self.assertEqual(self.fetch("row0")["n"], 1)
+        self.assertEqual(self.fetch("row4")["n"], 5)
+        self.assertEqual(self.fetch("row5")["n"], 1)
+        self.assertEqual(self.fetch("row9")["n"], 5)
+
+    def test_lag_and_lead(self):
+        # Second row of u0: lag is the first amount, lead the third
+        row = self.fetch("row1")
+        self.assertEqual(row["prev"], 10)
+        self.assertEqual(row["next"], 30)
+
+        # First row of a partition has no lag, last has no lead
+        self.assertNotIn("prev", self.fetch("row5"))
+        self.assertNotIn("next", self.fetch("row9"))
+
+    def test_cumulative_sum(self):
+        # u0 amounts are 10..50; u1 amounts are 110..150
+        self.assertEqual(self.fetch("row0")["total"], 10)
+        self.assertEqual(self.fetch("row4")["total"], 10 + 20 + 30 + 40 + 50)
+        self.assertEqual(self.fetch("row5")["total"], 110)
+        self.assertEqual(self.fetch("row9")["total"],
+                         110 + 120 + 130 + 140 + 150)
+
+    def test_missing_value_expression_is_rejected(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.post("/v1/procedures", {
+                "type": "window",
+                "params": {
+                    "inputData": "select 1 from events order by t",
+                    "outputDataset": {"id": "bad_out",
+                                      "type": "sparse.mutable"},
+                    "functions": [
+                        {"outputColumn": "prev", "function": "lag"}
+                    ],
+                    "runOnCreation": True
+                }
+            })
+
+
+mldb.run_tests()
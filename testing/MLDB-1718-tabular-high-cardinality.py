@@ -0,0 +1,53 @@
+#
+# MLDB-1718-tabular-high-cardinality.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# High cardinality columns in a tabular dataset switch to direct value
+# storage partway through a chunk (see TabularDatasetColumn); the switch
+# must be invisible to queries.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+NUM_ROWS = 15000  # past the 10k cardinality sample
+
+
+class Mldb1718TabularHighCardinality(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        ds = mldb.create_dataset({"id": "ids", "type": "tabular"})
+        for i in xrange(NUM_ROWS):
+            ds.record_row("row%d" % i, [
+                ["uid", "user-%06d" % i, 0],
+                ["cat", i % 3, 0]])
+        # A value first seen before the switch, recorded again after it
+        ds.record_row("repeat", [["uid", "user-000123", 0], ["cat", 0, 0]])
+        ds.commit()
+
+    def test_row_count(self):
+        res = mldb.query("select count(*) as n from ids")
+        self.assertEqual(res[1][1], NUM_ROWS + 1)
+
+    def test_point_lookup_after_switch(self):
+        res = mldb.query(
+            "select rowName() from ids where uid = 'user-012345'")
+        self.assertEqual(len(res), 2)
+        self.assertEqual(res[1][1], "row12345")
+
+    def test_repeated_value_matches_both_rows(self):
+        res = mldb.query(
+            "select rowName() from ids where uid = 'user-000123' "
+            "order by rowName()")
+        self.assertEqual(sorted(r[1] for r in res[1:]),
+                         ["repeat", "row123"])
+
+    def test_low_cardinality_column_unaffected(self):
+        res = mldb.query(
+            "select cat, count(*) as n from ids group by cat order by cat")
+        self.assertEqual(len(res), 4)
+        counts = {row[1]: row[2] for row in res[1:]}
+        self.assertEqual(sum(counts.values()), NUM_ROWS + 1)
+
+
+mldb.run_tests()
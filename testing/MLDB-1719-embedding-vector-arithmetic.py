@@ -0,0 +1,58 @@
+#
+# MLDB-1719-embedding-vector-arithmetic.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Arithmetic over embeddings with contiguous float/double storage goes
+# through the SIMD kernels (see BinaryOpHelper); results must match the
+# scalar per-element path.  normalize() returns double-storage
+# embeddings, so combining its results exercises the fast path.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1719EmbeddingVectorArithmetic(MldbUnitTest):  # noqa
+
+    def assert_embedding(self, query, expected):
+        res = mldb.query(query)
+        values = res[1][1:]
+        self.assertEqual(len(values), len(expected))
+        for got, exp in zip(values, expected):
+            self.assertAlmostEqual(got, exp, places=10)
+
+    def test_embedding_plus_embedding(self):
+        self.assert_embedding(
+            "select normalize([3, 4], 2) + normalize([8, 6], 2) as *",
+            [0.6 + 0.8, 0.8 + 0.6])
+
+    def test_embedding_minus_embedding(self):
+        self.assert_embedding(
+            "select normalize([3, 4], 2) - normalize([8, 6], 2) as *",
+            [0.6 - 0.8, 0.8 - 0.6])
+
+    def test_embedding_times_embedding(self):
+        self.assert_embedding(
+            "select normalize([3, 4], 2) * normalize([8, 6], 2) as *",
+            [0.6 * 0.8, 0.8 * 0.6])
+
+    def test_embedding_times_scalar(self):
+        self.assert_embedding(
+            "select normalize([3, 4], 2) * 10 as *", [6.0, 8.0])
+        self.assert_embedding(
+            "select 10 * normalize([3, 4], 2) as *", [6.0, 8.0])
+
+    def test_embedding_divided_by_scalar(self):
+        self.assert_embedding(
+            "select normalize([3, 4], 2) / 2 as *", [0.3, 0.4])
+
+    def test_shape_mismatch_raises(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.query(
+                "select normalize([3, 4], 2) + normalize([1, 2, 3], 2)")
+
+    def test_norm(self):
+        res = mldb.query("select norm([3, 4], 2) as n")
+        self.assertAlmostEqual(res[1][1], 5.0, places=10)
+
+
+mldb.run_tests()
@@ -0,0 +1,78 @@
+#
+# MLDB-1720-reservoir-sample.py
+# 29 août 2016
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Tests the reservoir() and stratified_sample() table functions.
+#
+
+import unittest
+
+mldb = mldb_wrapper.wrap(mldb) # noqa
+
+class Mldb1720(MldbUnitTest):
+    @classmethod
+    def setUpClass(self):
+        ds = mldb.create_dataset({ "id": "data", "type": "sparse.mutable" })
+        for i in xrange(1000):
+            ds.record_row("r%d" % i, [["x", i, 0],
+                                      ["label", "a" if i % 10 == 0 else "b", 0]])
+        ds.commit()
+
+    def test_sample_size(self):
+        res = mldb.query(
+            "select x from reservoir(data, {rows: 100, seed: 1})")
+        self.assertEqual(len(res) - 1, 100)
+
+    def test_rows_come_from_source(self):
+        res = mldb.query(
+            "select x from reservoir(data, {rows: 50, seed: 2})")
+        for row in res[1:]:
+            self.assertTrue(row[0].startswith("r"))
+            self.assertEqual(int(row[0][1:]), row[1])
+
+    def test_small_dataset_returned_whole(self):
+        res = mldb.query(
+            "select x from reservoir(data, {rows: 5000, seed: 3})")
+        self.assertEqual(len(res) - 1, 1000)
+
+    def test_deterministic_with_seed(self):
+        res1 = mldb.query(
+            "select rowName() from reservoir(data, {rows: 20, seed: 42}) "
+            "order by rowName()")
+        res2 = mldb.query(
+            "select rowName() from reservoir(data, {rows: 20, seed: 42}) "
+            "order by rowName()")
+        self.assertEqual(res1, res2)
+
+    def test_stratified_counts(self):
+        # 100 'a' rows and 900 'b' rows; 50 of each should come back
+        res = mldb.query(
+            "select label, count(*) as cnt from "
+            "stratified_sample(data, {rows: 50, by: 'label', seed: 4}) "
+            "group by label order by label")
+        self.assertEqual(res[1:], [["[\"a\"]", "a", 50],
+                                   ["[\"b\"]", "b", 50]])
+
+    def test_stratified_small_stratum_returned_whole(self):
+        res = mldb.query(
+            "select label, count(*) as cnt from "
+            "stratified_sample(data, {rows: 200, by: 'label', seed: 5}) "
+            "group by label order by label")
+        self.assertEqual(res[1:], [["[\"a\"]", "a", 100],
+                                   ["[\"b\"]", "b", 200]])
+
+    def test_stratified_requires_by(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.query("select * from stratified_sample(data, {rows: 10})")
+
+    def test_reservoir_rejects_by(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.query(
+                "select * from reservoir(data, {rows: 10, by: 'label'})")
+
+    def test_bad_rows(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.query("select * from reservoir(data, {rows: 0})")
+
+mldb.run_tests()
@@ -0,0 +1,77 @@
+#
+# MLDB-1721-tabular-time-index.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# A tabular dataset with a declared timeColumn builds a sorted sparse
+# index on it at commit time; BETWEEN and range comparisons on that
+# column must return exactly the rows a scan would.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+NUM_ROWS = 10000
+
+
+class Mldb1721TabularTimeIndex(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        indexed = mldb.create_dataset({
+            "id": "events", "type": "tabular",
+            "params": {"timeColumn": "t"}})
+        control = mldb.create_dataset({
+            "id": "events_scan", "type": "tabular"})
+
+        # Record in a scrambled order so the within-chunk sort matters
+        for i in xrange(NUM_ROWS):
+            t = (i * 7919) % NUM_ROWS
+            row = [["t", t, 0], ["x", i, 0]]
+            indexed.record_row("r%d" % t, row)
+            control.record_row("r%d" % t, row)
+
+        # Rows with no time value never fall inside a window
+        indexed.record_row("no-time", [["x", -1, 0]])
+        control.record_row("no-time", [["x", -1, 0]])
+
+        indexed.commit()
+        control.commit()
+
+    def assert_same_as_scan(self, where):
+        q = "select rowName() from %s where " + where + " order by rowName()"
+        self.assertEqual(mldb.query(q % "events"),
+                         mldb.query(q % "events_scan"))
+
+    def test_between(self):
+        res = mldb.query(
+            "select rowName() from events where t between 100 and 199")
+        self.assertEqual(len(res), 101)
+        self.assertEqual(sorted(r[1] for r in res[1:]),
+                         sorted("r%d" % t for t in xrange(100, 200)))
+
+    def test_between_bounds_inclusive(self):
+        res = mldb.query(
+            "select rowName() from events where t between 42 and 42")
+        self.assertEqual([r[1] for r in res[1:]], ["r42"])
+
+    def test_between_matches_scan(self):
+        self.assert_same_as_scan("t between 1234 and 5678")
+        self.assert_same_as_scan("t between 0 and 0")
+        # empty window
+        self.assert_same_as_scan("t between 20000 and 30000")
+
+    def test_range_comparisons_match_scan(self):
+        self.assert_same_as_scan("t < 5")
+        self.assert_same_as_scan("t <= 5")
+        self.assert_same_as_scan("t > %d" % (NUM_ROWS - 5))
+        self.assert_same_as_scan("t >= %d" % (NUM_ROWS - 5))
+        self.assert_same_as_scan("5 > t")  # normalized form
+
+    def test_null_time_excluded(self):
+        res = mldb.query(
+            "select rowName() from events where t between 0 and %d"
+            % NUM_ROWS)
+        names = [r[1] for r in res[1:]]
+        self.assertEqual(len(names), NUM_ROWS)
+        self.assertNotIn("no-time", names)
+
+mldb.run_tests()
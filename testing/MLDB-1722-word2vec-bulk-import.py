@@ -0,0 +1,74 @@
+#
+# MLDB-1722-word2vec-bulk-import.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Imports a small word2vec binary file into an embedding dataset; the
+# importer feeds the embedding through the bulk (contiguous matrix)
+# recording interface, so this covers that path end to end.
+#
+
+import os
+import struct
+import tempfile
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+tmp_dir = tempfile.mkdtemp(dir='build/x86_64/tmp')
+
+NUM_WORDS = 50
+NUM_DIMS = 4
+
+vectors_path = os.path.join(tmp_dir, 'vectors.bin')
+
+with open(vectors_path, 'wb') as f:
+    f.write("%d %d\n" % (NUM_WORDS, NUM_DIMS))
+    for i in xrange(NUM_WORDS):
+        f.write("word%d " % i)
+        f.write(struct.pack("<%df" % NUM_DIMS,
+                            float(i), float(i % 7), 1.0, 0.0))
+
+
+class Mldb1722Word2VecBulkImport(MldbUnitTest):  # noqa
+
+    def test_import(self):
+        mldb.post("/v1/procedures", {
+            "type": "import.word2vec",
+            "params": {
+                "dataFileUrl": "file://" + vectors_path,
+                "outputDataset": {"id": "w2v", "type": "embedding"},
+                "runOnCreation": True}})
+
+        res = mldb.query("select count(*) as n from w2v")
+        self.assertEqual(res[1][1], NUM_WORDS)
+
+        # Vectors land in the right rows, in column order
+        res = mldb.query('select * from w2v where rowName() = \'word7\'')
+        self.assertEqual(res[0][1:],
+                         ["000000", "000001", "000002", "000003"])
+        self.assertEqual(res[1][1:], [7, 0, 1, 0])
+
+    def test_import_with_limit(self):
+        mldb.post("/v1/procedures", {
+            "type": "import.word2vec",
+            "params": {
+                "dataFileUrl": "file://" + vectors_path,
+                "outputDataset": {"id": "w2v_limited", "type": "embedding"},
+                "offset": 5,
+                "limit": 10,
+                "runOnCreation": True}})
+
+        res = mldb.query("select rowName() from w2v_limited order by rowName()")
+        names = sorted(r[1] for r in res[1:])
+        self.assertEqual(names, sorted("word%d" % i for i in xrange(5, 15)))
+
+    def test_neighbors_on_imported(self):
+        # The imported dataset is indexed like any other embedding
+        mldb.put("/v1/functions/w2v_nn", {
+            "type": "embedding.neighbors",
+            "params": {"dataset": "w2v"}})
+        res = mldb.query(
+            "select w2v_nn({coords: 'word3', numNeighbors: 1})[distances] as *")
+        self.assertEqual(res[0][1], "word3")
+        self.assertEqual(res[1][1], 0)
+
+mldb.run_tests()
@@ -0,0 +1,45 @@
+#
+# MLDB-1724-group-commit.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Commits a group of datasets through POST /v1/datasets/group-commit and
+# checks that the recorded rows of every dataset in the group become
+# visible, plus the error cases (unknown name, overlapping groups).
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1724GroupCommit(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        for name in ['features', 'labels']:
+            mldb.put("/v1/datasets/" + name, {"type": "sparse.mutable"})
+            for i in xrange(10):
+                mldb.post("/v1/datasets/%s/rows" % name, {
+                    "rowName": "r%d" % i,
+                    "columns": [[name, i, 0]]})
+
+    def test_group_commit_publishes_all(self):
+        mldb.post("/v1/datasets/group-commit", ["features", "labels"])
+
+        res = mldb.query("select count(*) as n from features")
+        self.assertEqual(res[1][1], 10)
+        res = mldb.query("""select count(*) as n from features
+                            join labels on features.rowName() = labels.rowName()""")
+        self.assertEqual(res[1][1], 10)
+
+    def test_unknown_dataset_fails(self):
+        with self.assertRaises(mldb_wrapper.ResponseException):
+            mldb.post("/v1/datasets/group-commit", ["features", "nonesuch"])
+
+    def test_duplicate_name_fails(self):
+        with self.assertMldbRaises(status_code=409):
+            mldb.post("/v1/datasets/group-commit", ["features", "features"])
+
+    def test_empty_group_fails(self):
+        with self.assertMldbRaises(status_code=400):
+            mldb.post("/v1/datasets/group-commit", [])
+
+mldb.run_tests()
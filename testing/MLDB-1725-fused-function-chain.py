@@ -0,0 +1,57 @@
+#
+# MLDB-1725-fused-function-chain.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Nested applications of user value functions with matching types, like
+# stem(stop(...)), are fused at bind time so the intermediate value
+# skips the ExpressionValue round trip.  Checks that a fused chain
+# produces exactly what applying the functions one at a time does.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1725FusedFunctionChain(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        mldb.put("/v1/functions/stop", {
+            "type": "filter_stopwords"})
+        mldb.put("/v1/functions/stem", {
+            "type": "stemmer",
+            "params": {"language": "english"}})
+
+    def columns_of(self, query):
+        res = mldb.get("/v1/query", q=query).json()
+        return sorted([c[0] for c in res[0]["columns"]])
+
+    def test_chain_matches_stepwise(self):
+        bag = ("{tokenize('the cats and dogs', {splitchars:' '}) as *}")
+
+        # stem's argument is directly the stop call: the chain fuses
+        fused = self.columns_of(
+            "SELECT stem(stop({words: %s}))[words] as *" % bag)
+
+        # stem's argument is a row constructor built from stop's
+        # output: same computation, bound as two separate calls
+        stepwise = self.columns_of(
+            "SELECT stem({words: {stop({words: %s})[words] as *}})"
+            "[words] as *" % bag)
+
+        self.assertEqual(fused, stepwise)
+        self.assertEqual(fused, ["cat", "dog"])
+
+    def test_three_deep_chain(self):
+        res = self.columns_of(
+            "SELECT stem(stop(stem({words: {tokenize("
+            "'the cats and dogs', {splitchars:' '}) as *}})))[words] as *")
+        self.assertEqual(res, ["cat", "dog"])
+
+    def test_chain_under_builtin(self):
+        # The chain inside a builtin call still fuses and evaluates
+        res = mldb.query(
+            "SELECT horizontal_count(stem(stop({words: {tokenize("
+            "'the cats and dogs', {splitchars:' '}) as *}}))[words]) as n")
+        self.assertEqual(res[1][1], 2)
+
+mldb.run_tests()
@@ -0,0 +1,58 @@
+#
+# MLDB-1726-group-by-order-by-limit.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# GROUP BY with an ORDER BY on aggregate results keeps only the first
+# offset + limit sorted rows while the groups are produced instead of
+# materializing every group for the sort.  Checks that limited and
+# offset queries return exactly the corresponding slice of the full
+# ordered result.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+class Mldb1726GroupByOrderByLimit(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        ds = mldb.create_dataset({'id': 'groups', 'type': 'sparse.mutable'})
+        for i in xrange(100):
+            ds.record_row('row%d' % i,
+                          [['k', 'g%02d' % (i % 17), 0],
+                           ['v', i, 0]])
+        ds.commit()
+
+        cls.full = mldb.query(
+            "SELECT k, sum(v) AS total FROM groups "
+            "GROUP BY k ORDER BY sum(v) DESC, k")
+
+    def test_limit_is_prefix_of_full_ordering(self):
+        res = mldb.query(
+            "SELECT k, sum(v) AS total FROM groups "
+            "GROUP BY k ORDER BY sum(v) DESC, k LIMIT 5")
+        self.assertEqual(res, self.full[:6])
+
+    def test_offset_and_limit_slice(self):
+        res = mldb.query(
+            "SELECT k, sum(v) AS total FROM groups "
+            "GROUP BY k ORDER BY sum(v) DESC, k LIMIT 4 OFFSET 7")
+        self.assertEqual(res, [self.full[0]] + self.full[8:12])
+
+    def test_limit_larger_than_groups(self):
+        res = mldb.query(
+            "SELECT k, sum(v) AS total FROM groups "
+            "GROUP BY k ORDER BY sum(v) DESC, k LIMIT 1000")
+        self.assertEqual(res, self.full)
+
+    def test_having_with_limit(self):
+        full = mldb.query(
+            "SELECT k, sum(v) AS total FROM groups "
+            "GROUP BY k HAVING sum(v) > 250 ORDER BY sum(v) DESC, k")
+        res = mldb.query(
+            "SELECT k, sum(v) AS total FROM groups "
+            "GROUP BY k HAVING sum(v) > 250 ORDER BY sum(v) DESC, k "
+            "LIMIT 3")
+        self.assertEqual(res, full[:4])
+
+mldb.run_tests()
@@ -0,0 +1,107 @@
+#
+# MLDB-1728-tabular-persistence-roundtrip.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# On-disk persistence of tabular datasets.  Commit a dataset covering
+# every frozen column representation (dense table, sparse, run length,
+# 8 and 16 bit dictionary coded), destroy it, recreate it from the
+# persisted file and check that every row, column and value survives
+# the round trip, including queries served from the memory-mapped
+# columns.
+#
+
+import os
+import tempfile
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+tmp_dir = tempfile.mkdtemp(dir='build/x86_64/tmp')
+data_path = os.path.join(tmp_dir, 'tabular.mldbt')
+
+NUM_ROWS = 5000
+
+# 5 distinct strings -> 8 bit dictionary; 300 distinct -> 16 bit;
+# long runs of the same value -> run length; a column only present on
+# every 20th row -> sparse
+SMALL_DICT = ['alpha', 'beta', 'gamma', 'delta', 'epsilon']
+
+
+def row_for(i):
+    cols = [['dense', i, 0],
+            ['dict8', SMALL_DICT[i % 5], 0],
+            ['dict16', 'val%03d' % (i % 300), 0],
+            ['run', i // 1000, 0]]
+    if i % 20 == 0:
+        cols.append(['sparse', i * 2, 0])
+    return cols
+
+
+def record_all(ds):
+    for i in xrange(NUM_ROWS):
+        ds.record_row('row%05d' % i, row_for(i))
+
+
+def full_contents(name):
+    return mldb.query(
+        "select dense, dict8, dict16, run, sparse from %s "
+        "order by rowName()" % name)
+
+
+class Mldb1728TabularPersistenceRoundtrip(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        ds = mldb.create_dataset({
+            'id': 'original',
+            'type': 'tabular',
+            'params': {
+                'unknownColumns': 'add',
+                'dataFileUrl': 'file://' + data_path}})
+        record_all(ds)
+        ds.commit()
+
+        cls.expected = full_contents('original')
+        mldb.delete('/v1/datasets/original')
+
+        # Recreating with the same dataFileUrl reloads from the
+        # persisted file, with the column storage memory mapped
+        mldb.create_dataset({
+            'id': 'reloaded',
+            'type': 'tabular',
+            'params': {
+                'unknownColumns': 'add',
+                'dataFileUrl': 'file://' + data_path}})
+
+    def test_full_contents_survive(self):
+        self.assertEqual(full_contents('reloaded'), self.expected)
+
+    def test_row_count(self):
+        res = mldb.query("select count(*) as n from reloaded")
+        self.assertEqual(res[1][1], NUM_ROWS)
+
+    def test_queries_over_mmapped_columns(self):
+        # One predicate per representation, answered from the mapped
+        # columns
+        res = mldb.query("select count(*) as n from reloaded "
+                         "where dict8 = 'gamma'")
+        self.assertEqual(res[1][1], NUM_ROWS / 5)
+
+        res = mldb.query("select count(*) as n from reloaded "
+                         "where dict16 = 'val123'")
+        self.assertEqual(res[1][1],
+                         len([i for i in xrange(NUM_ROWS)
+                              if i % 300 == 123]))
+
+        res = mldb.query("select count(*) as n from reloaded "
+                         "where run = 3")
+        self.assertEqual(res[1][1], 1000)
+
+        res = mldb.query("select sum(sparse) as s from reloaded")
+        self.assertEqual(res[1][1],
+                         sum(i * 2 for i in xrange(0, NUM_ROWS, 20)))
+
+        res = mldb.query("select dense, dict8, run from reloaded "
+                         "where rowName() = 'row04321'")
+        self.assertEqual(res[1][1:], [4321, SMALL_DICT[4321 % 5], 4])
+
+mldb.run_tests()
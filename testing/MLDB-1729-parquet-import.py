@@ -0,0 +1,513 @@
+#
+# MLDB-1729-parquet-import.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Round trip tests for the Parquet importer.  Parquet files are built
+# from scratch here (Thrift compact footer, page headers, RLE levels,
+# raw Snappy and gzip pages) so that every supported combination of
+# codec, page version and encoding has a deterministic fixture: plain
+# v1 pages, gzip and snappy compressed pages, data pages v2 with the
+# levels outside of the compressed region, nullable columns and
+# dictionary encoded columns.
+#
+
+import os
+import struct
+import tempfile
+import zlib
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+tmp_dir = tempfile.mkdtemp(dir='build/x86_64/tmp')
+
+# Constants from the Parquet format, as in plugins/parquet_reader.h
+PT_BOOLEAN, PT_INT32, PT_INT64 = 0, 1, 2
+PT_FLOAT, PT_DOUBLE, PT_BYTE_ARRAY = 4, 5, 6
+CT_UTF8 = 0
+FRT_REQUIRED, FRT_OPTIONAL = 0, 1
+ENC_PLAIN, ENC_PLAIN_DICTIONARY, ENC_RLE, ENC_RLE_DICTIONARY = 0, 2, 3, 8
+CODEC_UNCOMPRESSED, CODEC_SNAPPY, CODEC_GZIP = 0, 1, 2
+TCT_BOOL_TRUE, TCT_BOOL_FALSE = 1, 2
+TCT_I64, TCT_BINARY, TCT_LIST, TCT_STRUCT = 6, 8, 9, 12
+
+
+#############################################################################
+# Thrift compact protocol writer
+#############################################################################
+
+def varint(n):
+    out = ''
+    while True:
+        if n < 0x80:
+            return out + chr(n)
+        out += chr((n & 0x7f) | 0x80)
+        n >>= 7
+
+
+def zigzag(n):
+    return varint((n << 1) ^ (n >> 63))
+
+
+def list_header(elem_type, size):
+    if size < 15:
+        return chr((size << 4) | elem_type)
+    return chr((15 << 4) | elem_type) + varint(size)
+
+
+class TStruct(object):
+    """Writes one Thrift compact struct, fields in ascending id order."""
+
+    def __init__(self):
+        self.out = ''
+        self.last_id = 0
+
+    def _header(self, field_id, field_type):
+        delta = field_id - self.last_id
+        assert 1 <= delta <= 15
+        self.last_id = field_id
+        self.out += chr((delta << 4) | field_type)
+
+    def i(self, field_id, value):
+        self._header(field_id, TCT_I64)
+        self.out += zigzag(value)
+
+    def boolean(self, field_id, value):
+        self._header(field_id, TCT_BOOL_TRUE if value else TCT_BOOL_FALSE)
+
+    def binary(self, field_id, value):
+        self._header(field_id, TCT_BINARY)
+        self.out += varint(len(value)) + value
+
+    def i_list(self, field_id, values):
+        self._header(field_id, TCT_LIST)
+        self.out += list_header(TCT_I64, len(values))
+        self.out += ''.join(zigzag(v) for v in values)
+
+    def binary_list(self, field_id, values):
+        self._header(field_id, TCT_LIST)
+        self.out += list_header(TCT_BINARY, len(values))
+        self.out += ''.join(varint(len(v)) + v for v in values)
+
+    def struct(self, field_id, value):
+        self._header(field_id, TCT_STRUCT)
+        self.out += value
+
+    def struct_list(self, field_id, values):
+        self._header(field_id, TCT_LIST)
+        self.out += list_header(TCT_STRUCT, len(values)) + ''.join(values)
+
+    def done(self):
+        return self.out + '\x00'
+
+
+#############################################################################
+# Value and level encodings
+#############################################################################
+
+def plain_encode(ptype, values):
+    if ptype == PT_BOOLEAN:
+        out = ''
+        for i in xrange(0, len(values), 8):
+            b = 0
+            for j, v in enumerate(values[i:i + 8]):
+                if v:
+                    b |= 1 << j
+            out += chr(b)
+        return out
+    if ptype == PT_INT32:
+        return ''.join(struct.pack('<i', v) for v in values)
+    if ptype == PT_INT64:
+        return ''.join(struct.pack('<q', v) for v in values)
+    if ptype == PT_FLOAT:
+        return ''.join(struct.pack('<f', v) for v in values)
+    if ptype == PT_DOUBLE:
+        return ''.join(struct.pack('<d', v) for v in values)
+    if ptype == PT_BYTE_ARRAY:
+        return ''.join(struct.pack('<I', len(v)) + v for v in values)
+    raise Exception('unhandled physical type')
+
+
+def rle_encode(values):
+    """RLE half of the hybrid encoding, for bit widths up to 8."""
+    out = ''
+    i = 0
+    while i < len(values):
+        j = i
+        while j < len(values) and values[j] == values[i]:
+            j += 1
+        out += varint((j - i) << 1) + chr(values[i])
+        i = j
+    return out
+
+
+def bit_packed_encode(values):
+    """Bit packed half of the hybrid encoding, for bit width 1."""
+    num_groups = (len(values) + 7) // 8
+    padded = values + [0] * (num_groups * 8 - len(values))
+    out = varint((num_groups << 1) | 1)
+    for i in xrange(0, len(padded), 8):
+        b = 0
+        for j, v in enumerate(padded[i:i + 8]):
+            if v:
+                b |= 1 << j
+        out += chr(b)
+    return out
+
+
+def snappy_compress(data):
+    """Raw Snappy block made of literal chunks only (always valid)."""
+    out = varint(len(data))
+    for i in xrange(0, len(data), 60):
+        chunk = data[i:i + 60]
+        out += chr((len(chunk) - 1) << 2) + chunk
+    return out
+
+
+def gzip_compress(data):
+    compressor = zlib.compressobj(6, zlib.DEFLATED, 16 + 15)
+    return compressor.compress(data) + compressor.flush()
+
+
+def compress(codec, data):
+    if codec == CODEC_SNAPPY:
+        return snappy_compress(data)
+    if codec == CODEC_GZIP:
+        return gzip_compress(data)
+    return data
+
+
+#############################################################################
+# File builder
+#############################################################################
+
+def data_page_v1_header(num_values, encoding, uncompressed, compressed):
+    dph = TStruct()
+    dph.i(1, num_values)
+    dph.i(2, encoding)
+    dph.i(3, ENC_RLE)
+    header = TStruct()
+    header.i(1, 0)  # PAGE_DATA
+    header.i(2, uncompressed)
+    header.i(3, compressed)
+    header.struct(5, dph.done())
+    return header.done()
+
+
+def data_page_v2_header(num_values, num_nulls, encoding, levels_length,
+                        uncompressed, compressed, is_compressed):
+    dph = TStruct()
+    dph.i(1, num_values)
+    dph.i(2, num_nulls)
+    dph.i(4, encoding)
+    dph.i(5, levels_length)
+    dph.i(6, 0)  # no repetition levels
+    dph.boolean(7, is_compressed)
+    header = TStruct()
+    header.i(1, 3)  # PAGE_DATA_V2
+    header.i(2, uncompressed)
+    header.i(3, compressed)
+    header.struct(8, dph.done())
+    return header.done()
+
+
+def dictionary_page_header(num_values, uncompressed, compressed):
+    dph = TStruct()
+    dph.i(1, num_values)
+    dph.i(2, ENC_PLAIN_DICTIONARY)
+    header = TStruct()
+    header.i(1, 2)  # PAGE_DICTIONARY
+    header.i(2, uncompressed)
+    header.i(3, compressed)
+    header.struct(7, dph.done())
+    return header.done()
+
+
+def column_chunk(spec, values, offset):
+    """Encode one column chunk (dictionary page if any, then one data
+    page) starting at offset, returning (bytes, metadata)."""
+    codec = spec.get('codec', CODEC_UNCOMPRESSED)
+    optional = spec.get('optional', False)
+    not_null = [0 if v is None else 1 for v in values]
+    present = [v for v in values if v is not None]
+
+    chunk = ''
+    dict_offset = -1
+    encodings = [ENC_RLE, ENC_PLAIN]
+
+    if spec.get('dictionary', False):
+        dict_values = []
+        indices = []
+        for v in present:
+            if v not in dict_values:
+                dict_values.append(v)
+            indices.append(dict_values.index(v))
+        dict_body = plain_encode(spec['ptype'], dict_values)
+        compressed = compress(codec, dict_body)
+        dict_offset = offset
+        chunk += dictionary_page_header(len(dict_values), len(dict_body),
+                                        len(compressed)) + compressed
+        bit_width = max(1, len(bin(len(dict_values) - 1)) - 2)
+        value_bytes = chr(bit_width) + rle_encode(indices)
+        encoding = ENC_RLE_DICTIONARY
+        encodings = encodings + [ENC_RLE_DICTIONARY]
+    else:
+        value_bytes = plain_encode(spec['ptype'], present)
+        encoding = ENC_PLAIN
+
+    if optional:
+        if spec.get('packed_levels', False):
+            levels = bit_packed_encode(not_null)
+        else:
+            levels = rle_encode(not_null)
+    else:
+        levels = ''
+
+    data_offset = offset + len(chunk)
+
+    if spec.get('page', 'v1') == 'v1':
+        # v1: the whole page, levels included, goes through the codec
+        body = value_bytes
+        if optional:
+            body = struct.pack('<I', len(levels)) + levels + body
+        compressed = compress(codec, body)
+        chunk += data_page_v1_header(len(values), encoding, len(body),
+                                     len(compressed)) + compressed
+    else:
+        # v2: the levels stay outside of the compressed region
+        is_compressed = spec.get('page_compressed', True)
+        vals = compress(codec, value_bytes) if is_compressed else value_bytes
+        chunk += data_page_v2_header(
+            len(values), len(values) - len(present), encoding, len(levels),
+            len(levels) + len(value_bytes), len(levels) + len(vals),
+            is_compressed) + levels + vals
+
+    meta = {'ptype': spec['ptype'], 'encodings': encodings,
+            'name': spec['name'], 'codec': codec,
+            'num_values': len(values), 'size': len(chunk),
+            'data_offset': data_offset, 'dict_offset': dict_offset}
+    return chunk, meta
+
+
+def file_footer(specs, groups_meta, num_rows):
+    root = TStruct()
+    root.binary(4, 'schema')
+    root.i(5, len(specs))
+    schema = [root.done()]
+    for spec in specs:
+        element = TStruct()
+        element.i(1, spec['ptype'])
+        element.i(3, FRT_OPTIONAL if spec.get('optional', False)
+                  else FRT_REQUIRED)
+        element.binary(4, spec['name'])
+        if spec.get('ctype') is not None:
+            element.i(6, spec['ctype'])
+        schema.append(element.done())
+
+    groups = []
+    for metas, group_rows in groups_meta:
+        columns = []
+        total = 0
+        for m in metas:
+            cmd = TStruct()
+            cmd.i(1, m['ptype'])
+            cmd.i_list(2, m['encodings'])
+            cmd.binary_list(3, [m['name']])
+            cmd.i(4, m['codec'])
+            cmd.i(5, m['num_values'])
+            cmd.i(6, m['size'])
+            cmd.i(7, m['size'])
+            cmd.i(9, m['data_offset'])
+            if m['dict_offset'] >= 0:
+                cmd.i(11, m['dict_offset'])
+            chunk = TStruct()
+            chunk.struct(3, cmd.done())
+            columns.append(chunk.done())
+            total += m['size']
+        group = TStruct()
+        group.struct_list(1, columns)
+        group.i(2, total)
+        group.i(3, group_rows)
+        groups.append(group.done())
+
+    meta = TStruct()
+    meta.i(1, 1)  # format version
+    meta.struct_list(2, schema)
+    meta.i(3, num_rows)
+    meta.struct_list(4, groups)
+    return meta.done()
+
+
+def write_parquet(name, specs, row_groups):
+    """Write a Parquet file from column specs and per row group column
+    values ({column name: [values]}; None is a null).  Returns its path."""
+    out = 'PAR1'
+    groups_meta = []
+    for group in row_groups:
+        metas = []
+        group_rows = 0
+        for spec in specs:
+            values = group[spec['name']]
+            group_rows = len(values)
+            chunk, meta = column_chunk(spec, values, len(out))
+            out += chunk
+            metas.append(meta)
+        groups_meta.append((metas, group_rows))
+    footer = file_footer(specs, groups_meta,
+                         sum(rows for _, rows in groups_meta))
+    out += footer + struct.pack('<I', len(footer)) + 'PAR1'
+    path = os.path.join(tmp_dir, name)
+    with open(path, 'wb') as f:
+        f.write(out)
+    return path
+
+
+def import_parquet(path, dataset_id):
+    mldb.post('/v1/procedures', {
+        'type': 'experimental.import.parquet',
+        'params': {
+            'dataFileUrl': 'file://' + path,
+            'outputDataset': {'id': dataset_id, 'type': 'tabular'},
+            'runOnCreation': True}})
+
+
+#############################################################################
+# The tests
+#############################################################################
+
+class Mldb1729ParquetImport(MldbUnitTest):  # noqa
+
+    def test_plain_v1_two_row_groups(self):
+        # Every physical type as plain uncompressed v1 pages, split
+        # over two row groups; rows are named 1..n across the groups
+        specs = [{'name': 'i32', 'ptype': PT_INT32},
+                 {'name': 'i64', 'ptype': PT_INT64},
+                 {'name': 'dbl', 'ptype': PT_DOUBLE},
+                 {'name': 'flt', 'ptype': PT_FLOAT},
+                 {'name': 'flag', 'ptype': PT_BOOLEAN},
+                 {'name': 'name', 'ptype': PT_BYTE_ARRAY, 'ctype': CT_UTF8},
+                 {'name': 'opt', 'ptype': PT_INT32, 'optional': True}]
+        path = write_parquet(
+            'plain.parquet', specs,
+            [{'i32': [10, 11, 12, 13],
+              'i64': [2 ** 40, -1, 0, 2 ** 40 + 3],
+              'dbl': [0.25, 1.25, 2.25, 3.25],
+              'flt': [0.5, 1.5, 2.5, 3.5],
+              'flag': [1, 0, 1, 0],
+              'name': ['zero', 'one', 'two', 'three'],
+              'opt': [100, None, 102, None]},
+             {'i32': [14, 15, 16, 17],
+              'i64': [4, 5, 6, 7],
+              'dbl': [4.25, 5.25, 6.25, 7.25],
+              'flt': [4.5, 5.5, 6.5, 7.5],
+              'flag': [0, 1, 0, 1],
+              'name': ['four', 'five', 'six', 'seven'],
+              'opt': [None, 105, None, 107]}])
+        import_parquet(path, 'plain')
+
+        res = mldb.query("select i32, i64, dbl, flt, flag, name, opt "
+                         "from plain order by rowName()")
+        self.assertEqual(res, [
+            ['_rowName', 'i32', 'i64', 'dbl', 'flt', 'flag', 'name', 'opt'],
+            ['1', 10, 2 ** 40, 0.25, 0.5, 1, 'zero', 100],
+            ['2', 11, -1, 1.25, 1.5, 0, 'one', None],
+            ['3', 12, 0, 2.25, 2.5, 1, 'two', 102],
+            ['4', 13, 2 ** 40 + 3, 3.25, 3.5, 0, 'three', None],
+            ['5', 14, 4, 4.25, 4.5, 0, 'four', None],
+            ['6', 15, 5, 5.25, 5.5, 1, 'five', 105],
+            ['7', 16, 6, 6.25, 6.5, 0, 'six', None],
+            ['8', 17, 7, 7.25, 7.5, 1, 'seven', 107]])
+
+    def test_gzip_v1(self):
+        specs = [{'name': 'x', 'ptype': PT_INT32, 'codec': CODEC_GZIP},
+                 {'name': 's', 'ptype': PT_BYTE_ARRAY, 'ctype': CT_UTF8,
+                  'codec': CODEC_GZIP},
+                 {'name': 'opt', 'ptype': PT_INT64, 'optional': True,
+                  'codec': CODEC_GZIP}]
+        path = write_parquet(
+            'gzip.parquet', specs,
+            [{'x': [1, 2, 3, 4, 5],
+              's': ['a', 'bb', 'ccc', 'dddd', 'eeeee'],
+              'opt': [None, 20, None, 40, 50]}])
+        import_parquet(path, 'gz')
+
+        res = mldb.query("select x, s, opt from gz order by rowName()")
+        self.assertEqual(res[1:], [
+            ['1', 1, 'a', None],
+            ['2', 2, 'bb', 20],
+            ['3', 3, 'ccc', None],
+            ['4', 4, 'dddd', 40],
+            ['5', 5, 'eeeee', 50]])
+
+    def test_snappy_v1(self):
+        # The long strings make the page span several Snappy literal
+        # chunks
+        strings = ['string number %d, padded out well past sixty bytes '
+                   'to take several literals' % i for i in xrange(6)]
+        specs = [{'name': 'x', 'ptype': PT_INT32, 'codec': CODEC_SNAPPY},
+                 {'name': 's', 'ptype': PT_BYTE_ARRAY, 'ctype': CT_UTF8,
+                  'codec': CODEC_SNAPPY}]
+        path = write_parquet(
+            'snappy.parquet', specs,
+            [{'x': list(xrange(6)), 's': strings}])
+        import_parquet(path, 'sn')
+
+        res = mldb.query("select x, s from sn order by rowName()")
+        self.assertEqual(res[1:],
+                         [[str(i + 1), i, strings[i]] for i in xrange(6)])
+
+    def test_data_pages_v2(self):
+        # v2 pages keep the definition levels outside of the compressed
+        # region; isCompressed selects the codec for the values only.
+        # One column uses bit packed levels instead of RLE runs.
+        specs = [{'name': 'a', 'ptype': PT_INT32, 'optional': True,
+                  'page': 'v2', 'codec': CODEC_SNAPPY,
+                  'packed_levels': True},
+                 {'name': 'b', 'ptype': PT_DOUBLE, 'optional': True,
+                  'page': 'v2', 'codec': CODEC_SNAPPY,
+                  'page_compressed': False},
+                 {'name': 'c', 'ptype': PT_INT64,
+                  'page': 'v2', 'codec': CODEC_GZIP}]
+        path = write_parquet(
+            'v2.parquet', specs,
+            [{'a': [1, None, 3, None, 5, 6, None],
+              'b': [None, 1.5, None, 3.5, None, 5.5, 6.5],
+              'c': [10, 20, 30, 40, 50, 60, 70]}])
+        import_parquet(path, 'v2')
+
+        res = mldb.query("select a, b, c from v2 order by rowName()")
+        self.assertEqual(res[1:], [
+            ['1', 1, None, 10],
+            ['2', None, 1.5, 20],
+            ['3', 3, None, 30],
+            ['4', None, 3.5, 40],
+            ['5', 5, None, 50],
+            ['6', 6, 5.5, 60],
+            ['7', None, 6.5, 70]])
+
+    def test_dictionary_encoding(self):
+        cities = ['lyon', 'paris', 'lyon', 'brest', 'paris', 'paris',
+                  'lyon', 'brest']
+        specs = [{'name': 'city', 'ptype': PT_BYTE_ARRAY, 'ctype': CT_UTF8,
+                  'dictionary': True, 'codec': CODEC_GZIP},
+                 {'name': 'n', 'ptype': PT_INT32}]
+        path = write_parquet(
+            'dict.parquet', specs,
+            [{'city': cities, 'n': list(xrange(8))}])
+        import_parquet(path, 'dict')
+
+        res = mldb.query("select city, n from dict order by rowName()")
+        self.assertEqual(res[1:],
+                         [[str(i + 1), cities[i], i] for i in xrange(8)])
+
+        res = mldb.query("select count(*) as c from dict "
+                         "where city = 'lyon'")
+        self.assertEqual(res[1][1], 3)
+
+    def test_not_a_parquet_file(self):
+        path = os.path.join(tmp_dir, 'not.parquet')
+        with open(path, 'wb') as f:
+            f.write('PAR1 this is not really a parquet file')
+        with self.assertMldbRaises(status_code=400):
+            import_parquet(path, 'bad')
+
+mldb.run_tests()
@@ -0,0 +1,195 @@
+/* MLDB-1730-tabular-replication.cc
+   This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+   Test of hot-standby replication of tabular datasets: two MLDB servers
+   in one process, connected over the real peer channel, with rows
+   recorded on the primary and served by the standby.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include "mldb/server/mldb_server.h"
+#include "mldb/rest/asio_peer_server.h"
+#include "mldb/rest/peer_discovery.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace Datacratic;
+using namespace Datacratic::MLDB;
+
+namespace {
+
+/** Discovery that shares a registry between the peers of the test, so
+    that servers in the same process find each other without an etcd.
+*/
+struct SharedPeerDiscovery: public PeerDiscovery {
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<PeerInfo> published;
+        std::vector<SharedPeerDiscovery *> members;
+    };
+
+    SharedPeerDiscovery(RestEntity * owner,
+                        std::shared_ptr<Registry> registry)
+        : PeerDiscovery(owner), registry(std::move(registry))
+    {
+        std::unique_lock<std::mutex> guard(this->registry->mutex);
+        this->registry->members.push_back(this);
+        for (auto & info: this->registry->published)
+            knownPeers.addEntry(info.peerName,
+                                std::make_shared<PeerInfo>(info));
+    }
+
+    ~SharedPeerDiscovery()
+    {
+        std::unique_lock<std::mutex> guard(registry->mutex);
+        auto & members = registry->members;
+        members.erase(std::find(members.begin(), members.end(), this));
+    }
+
+    std::shared_ptr<Registry> registry;
+
+    virtual void publish(PeerInfo info) override
+    {
+        std::unique_lock<std::mutex> guard(registry->mutex);
+        registry->published.push_back(info);
+        for (auto * member: registry->members)
+            member->knownPeers.addEntry(info.peerName,
+                                        std::make_shared<PeerInfo>(info));
+    }
+
+    virtual void shutdown() override
+    {
+        knownPeers.clear();
+    }
+
+    virtual void wakeup() override
+    {
+    }
+};
+
+std::shared_ptr<MldbServer>
+createServer(const std::string & name,
+             std::shared_ptr<SharedPeerDiscovery::Registry> registry)
+{
+    auto server = std::make_shared<MldbServer>(name);
+
+    auto peerServer = std::make_shared<AsioPeerServer>();
+    peerServer->init(PortRange(15000, 16000), "127.0.0.1");
+
+    BOOST_REQUIRE(server->init("",
+                               "file://mldb/container_files/public_html/resources",
+                               "file://mldb/container_files/public_html/doc",
+                               false /* hideInternalEntities */,
+                               peerServer));
+    server->initDiscovery
+        (std::make_shared<SharedPeerDiscovery>(server.get(), registry));
+    server->start();
+    return server;
+}
+
+Json::Value queryTable(MldbServer & server, const std::string & sql)
+{
+    auto connection = server.restGet("/v1/query", { { "q", sql },
+                                                    { "format", "table" } });
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 200);
+    return Json::parse(connection.response);
+}
+
+/** Wait for the standby to catch up to the expected row count; the lag
+    is bounded by the replication period plus the transfer time. */
+bool waitForRowCount(MldbServer & server, const std::string & dataset,
+                     int expected, double timeoutSeconds = 10.0)
+{
+    for (int i = 0;  i < int(timeoutSeconds / 0.05);  ++i) {
+        Json::Value result
+            = queryTable(server, "select count(*) as n from " + dataset);
+        if (result[1][1].asInt() == expected)
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+void recordRow(MldbServer & server, const std::string & dataset,
+               const std::string & rowName, int x)
+{
+    Json::Value row;
+    row["rowName"] = rowName;
+    row["columns"][0][0] = "x";
+    row["columns"][0][1] = x;
+    row["columns"][0][2] = 0;
+    auto connection = server.restPost("/v1/datasets/" + dataset + "/rows",
+                                      RestParams(), row);
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 200);
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_tabular_replication )
+{
+    auto registry = std::make_shared<SharedPeerDiscovery::Registry>();
+
+    auto primary = createServer("mldb1", registry);
+    auto standby = createServer("mldb2", registry);
+
+    // The primary holds a plain tabular dataset
+    Json::Value primaryConfig;
+    primaryConfig["type"] = "tabular";
+    primaryConfig["params"]["unknownColumns"] = "add";
+    auto connection = primary->restPut("/v1/datasets/data", RestParams(),
+                                       primaryConfig);
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 201);
+
+    recordRow(*primary, "data", "row1", 1);
+    recordRow(*primary, "data", "row2", 2);
+    recordRow(*primary, "data", "row3", 3);
+    connection = primary->restPost("/v1/datasets/data/commit");
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 200);
+
+    // The standby pulls the committed chunks over the peer channel
+    Json::Value standbyConfig;
+    standbyConfig["type"] = "tabular";
+    standbyConfig["params"]["replicateFromPeer"] = "mldb1";
+    standbyConfig["params"]["replicateFromDataset"] = "data";
+    standbyConfig["params"]["replicationPeriod"] = 0.05;
+    connection = standby->restPut("/v1/datasets/data", RestParams(),
+                                  standbyConfig);
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 201);
+
+    BOOST_REQUIRE(waitForRowCount(*standby, "data", 3));
+
+    string sql = "select x from data order by rowName()";
+    BOOST_CHECK_EQUAL(queryTable(*standby, sql), queryTable(*primary, sql));
+
+    // Rows committed after the standby connected must appear too
+    recordRow(*primary, "data", "row4", 4);
+    recordRow(*primary, "data", "row5", 5);
+    connection = primary->restPost("/v1/datasets/data/commit");
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 200);
+
+    BOOST_REQUIRE(waitForRowCount(*standby, "data", 5));
+    BOOST_CHECK_EQUAL(queryTable(*standby, sql), queryTable(*primary, sql));
+
+    // The replication link reports as healthy, with a sync time and the
+    // primary's commit time
+    connection = standby->restGet("/v1/datasets/data");
+    BOOST_REQUIRE_EQUAL(connection.responseCode, 200);
+    Json::Value status = Json::parse(connection.response);
+    const Json::Value & replication = status["status"]["replication"];
+    BOOST_CHECK_EQUAL(replication["peer"].asString(), "mldb1");
+    BOOST_CHECK_EQUAL(replication["dataset"].asString(), "data");
+    BOOST_CHECK(replication.isMember("lastSyncTime"));
+    BOOST_CHECK(replication.isMember("primaryCommitTime"));
+    BOOST_CHECK(!replication.isMember("error"));
+
+    standby->shutdown();
+    primary->shutdown();
+}
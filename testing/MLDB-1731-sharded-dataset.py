@@ -0,0 +1,121 @@
+#
+# MLDB-1731-sharded-dataset.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Queries against a sharded dataset must return the same thing as the
+# same query against the same rows held in a single tabular dataset:
+# plain scans (with WHERE, OFFSET and LIMIT), decomposable aggregates
+# and GROUP BY recombination.  ORDER BY and HAVING can't be pushed to
+# the shards and must fail with explicit errors.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+NUM_ROWS = 60
+NUM_SHARDS = 3
+
+
+def row_for(i):
+    return [['x', i, 0],
+            ['g', 'g%d' % (i % 5), 0],
+            ['v', i * 2, 0]]
+
+
+class Mldb1731ShardedDataset(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        # The same rows, spread over the shards and kept whole
+        shards = []
+        for s in xrange(NUM_SHARDS):
+            shards.append(mldb.create_dataset({
+                'id': 'shard%d' % s,
+                'type': 'tabular',
+                'params': {'unknownColumns': 'add'}}))
+        flat = mldb.create_dataset({
+            'id': 'flat',
+            'type': 'tabular',
+            'params': {'unknownColumns': 'add'}})
+
+        for i in xrange(NUM_ROWS):
+            shards[i % NUM_SHARDS].record_row('row%03d' % i, row_for(i))
+            flat.record_row('row%03d' % i, row_for(i))
+
+        for ds in shards:
+            ds.commit()
+        flat.commit()
+
+        mldb.put('/v1/datasets/sharded', {
+            'type': 'sharded',
+            'params': {
+                'shards': [{'dataset': 'shard%d' % s}
+                           for s in xrange(NUM_SHARDS)]}})
+
+    def assert_same_rows(self, sql_sharded, sql_flat):
+        # Shard order is unspecified, so compare sorted
+        sharded = mldb.query(sql_sharded)
+        flat = mldb.query(sql_flat)
+        self.assertEqual(sharded[0], flat[0])
+        self.assertEqual(sorted(sharded[1:]), sorted(flat[1:]))
+
+    def test_plain_scan(self):
+        self.assert_same_rows("select x, g, v from sharded",
+                              "select x, g, v from flat")
+
+    def test_where(self):
+        self.assert_same_rows("select x, v from sharded where x % 7 = 3",
+                              "select x, v from flat where x % 7 = 3")
+
+    def test_offset_limit(self):
+        # The order rows come back in is unspecified, but offset and
+        # limit have to partition the full row set without duplicates
+        full = sorted(mldb.query("select x from sharded")[1:])
+
+        first = mldb.query("select x from sharded limit 10")[1:]
+        self.assertEqual(len(first), 10)
+
+        rest = mldb.query("select x from sharded offset 10")[1:]
+        self.assertEqual(len(rest), NUM_ROWS - 10)
+
+        tail = mldb.query("select x from sharded offset %d"
+                          % (NUM_ROWS - 5))[1:]
+        self.assertEqual(len(tail), 5)
+
+        self.assertEqual(
+            mldb.query("select x from sharded offset %d" % NUM_ROWS)[1:],
+            [])
+
+    def test_aggregates(self):
+        sql = ("select count(*) as c, sum(v) as s, min(x) as mn, "
+               "max(x) as mx, avg(v) as a from %s")
+        self.assertEqual(mldb.query(sql % 'sharded'),
+                         mldb.query(sql % 'flat'))
+
+    def test_aggregates_with_where(self):
+        sql = "select count(*) as c, sum(v) as s from %s where x >= 30"
+        self.assertEqual(mldb.query(sql % 'sharded'),
+                         mldb.query(sql % 'flat'))
+
+    def test_group_by(self):
+        sql = ("select g, count(*) as c, sum(v) as s, min(x) as mn, "
+               "max(x) as mx, avg(x) as a from %s group by g")
+        self.assert_same_rows(sql % 'sharded', sql % 'flat')
+
+    def test_order_by_in_outer_query(self):
+        # ORDER BY can't be pushed down, but sorting the merged result
+        # in an outer query works
+        sql = ("select x, v from (select x, v from %s) as sub "
+               "order by x limit 7")
+        self.assertEqual(mldb.query(sql % 'sharded'),
+                         mldb.query(sql % 'flat'))
+
+    def test_order_by_rejected(self):
+        with self.assertMldbRaises(status_code=400):
+            mldb.query("select x from sharded order by x")
+
+    def test_having_rejected(self):
+        with self.assertMldbRaises(status_code=400):
+            mldb.query("select g, count(*) as c from sharded "
+                       "group by g having c > 5")
+
+mldb.run_tests()
@@ -0,0 +1,83 @@
+#
+# MLDB-1732-query-result-cache.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# The opt-in /v1/query result cache must never serve stale results: a
+# commit to a tabular dataset invalidates entries over it, a record to
+# a sparse.mutable dataset (whose writes are visible without a commit)
+# invalidates right away, and deleting and recreating a dataset under
+# the same name starts from a clean slate.
+#
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+
+def cached_query(sql):
+    return mldb.get('/v1/query', q=sql, format='table', cache='true').json()
+
+
+class Mldb1732QueryResultCache(MldbUnitTest):  # noqa
+
+    def test_tabular_commit_invalidates(self):
+        ds = mldb.create_dataset({
+            'id': 'tab',
+            'type': 'tabular',
+            'params': {'unknownColumns': 'add'}})
+        for i in xrange(3):
+            ds.record_row('row%d' % i, [['x', i, 0]])
+        ds.commit()
+
+        sql = "select x from tab order by rowName()"
+        first = cached_query(sql)
+        self.assertEqual(len(first), 4)
+
+        # Served again (from the cache or not, it must be the same)
+        self.assertEqual(cached_query(sql), first)
+
+        # Tabular rows only become visible at commit, so recording alone
+        # changes nothing
+        ds.record_row('row3', [['x', 3, 0]])
+        ds.record_row('row4', [['x', 4, 0]])
+        self.assertEqual(cached_query(sql), first)
+
+        # ... but the commit must invalidate the entry
+        ds.commit()
+        after = cached_query(sql)
+        self.assertEqual(len(after), 6)
+        self.assertEqual(after[1:4], first[1:])
+
+    def test_sparse_record_invalidates(self):
+        # sparse.mutable writes are visible without a commit, so a
+        # record alone must already invalidate
+        ds = mldb.create_dataset({'id': 'sparse', 'type': 'sparse.mutable'})
+        for i in xrange(3):
+            ds.record_row('row%d' % i, [['x', i, 0]])
+        ds.commit()
+
+        sql = "select x from sparse order by rowName()"
+        first = cached_query(sql)
+        self.assertEqual(len(first), 4)
+
+        ds.record_row('row3', [['x', 3, 0]])
+        after = cached_query(sql)
+        self.assertEqual(len(after), 5)
+        self.assertEqual(after[4], ['row3', 3])
+
+    def test_recreated_dataset_not_stale(self):
+        ds = mldb.create_dataset({'id': 'swap', 'type': 'sparse.mutable'})
+        ds.record_row('old', [['x', 1, 0]])
+        ds.commit()
+
+        sql = "select x from swap order by rowName()"
+        self.assertEqual(cached_query(sql)[1:], [['old', 1]])
+
+        # A dataset recreated under the same name is a different object;
+        # the entry over the old one must not be served
+        mldb.delete('/v1/datasets/swap')
+        ds = mldb.create_dataset({'id': 'swap', 'type': 'sparse.mutable'})
+        ds.record_row('new', [['x', 2, 0]])
+        ds.commit()
+
+        self.assertEqual(cached_query(sql)[1:], [['new', 2]])
+
+mldb.run_tests()
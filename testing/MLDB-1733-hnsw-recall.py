@@ -0,0 +1,100 @@
+#
+# MLDB-1733-hnsw-recall.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# The 'hnsw' index of the embedding dataset answers nearest neighbor
+# queries approximately.  Check its recall against the exact vantage
+# point tree on the same random embedding, both with an explicit ef
+# and with the default candidate list size, and that the absent-row
+# path behaves like the exact index.
+#
+
+import random
+
+mldb = mldb_wrapper.wrap(mldb)  # noqa
+
+NUM_ROWS = 500
+NUM_DIMS = 8
+NUM_QUERIES = 20
+NUM_NEIGHBORS = 10
+
+
+class Mldb1733HnswRecall(MldbUnitTest):  # noqa
+
+    @classmethod
+    def setUpClass(cls):
+        random.seed(42)
+        cls.points = points = [[random.random() for _ in xrange(NUM_DIMS)]
+                               for _ in xrange(NUM_ROWS)]
+
+        # The same embedding twice: once over the exact vantage point
+        # tree, once over the approximate HNSW graph
+        configs = [
+            ('exact', {}),
+            ('approx', {'indexType': 'hnsw',
+                        'hnswM': 8,
+                        'hnswEfConstruction': 100})]
+
+        for ds_id, params in configs:
+            ds = mldb.create_dataset({
+                'id': ds_id,
+                'type': 'embedding',
+                'params': params})
+            for i, point in enumerate(points):
+                ds.record_row('row%d' % i,
+                              [['d%d' % j, val, 0]
+                               for j, val in enumerate(point)])
+            ds.commit()
+
+            mldb.put('/v1/functions/nn_' + ds_id, {
+                'type': 'embedding.neighbors',
+                'params': {'dataset': ds_id}})
+
+    def neighbors(self, fn, row, ef=None):
+        args = "coords: '%s', numNeighbors: %d" % (row, NUM_NEIGHBORS)
+        if ef is not None:
+            args += ", ef: %d" % ef
+        res = mldb.query("select %s({%s})[distances] as *" % (fn, args))
+        return set(res[0][1:])
+
+    def check_recall(self, ef, minimum):
+        hits = 0
+        total = 0
+        for q in xrange(NUM_QUERIES):
+            row = 'row%d' % q
+            exact = self.neighbors('nn_exact', row)
+            self.assertEqual(len(exact), NUM_NEIGHBORS)
+            approx = self.neighbors('nn_approx', row, ef=ef)
+            # The query row itself is at distance zero and must always
+            # be found
+            self.assertIn(row, approx)
+            hits += len(exact & approx)
+            total += NUM_NEIGHBORS
+        recall = hits / float(total)
+        mldb.log("recall at ef=%s: %.3f" % (ef, recall))
+        self.assertGreaterEqual(recall, minimum)
+
+    def test_recall(self):
+        self.check_recall(ef=200, minimum=0.9)
+
+    def test_recall_default_ef(self):
+        self.check_recall(ef=None, minimum=0.9)
+
+    def test_coords_query(self):
+        # Querying by coordinates rather than by row name goes through
+        # the other search entry point; the nearest row to a recorded
+        # point is that row, at distance zero
+        coords = ', '.join("d%d: %.17g" % (j, val)
+                           for j, val in enumerate(self.points[0]))
+        res = mldb.query("select nn_approx({coords: {%s}, numNeighbors: 1})"
+                         "[distances] as *" % coords)
+        self.assertEqual(res[0][1], 'row0')
+        self.assertAlmostEqual(res[1][1], 0, places=5)
+
+    def test_absent_row(self):
+        # An unknown row name is a client error for both index types
+        for fn in ('nn_exact', 'nn_approx'):
+            with self.assertMldbRaises(status_code=400):
+                mldb.query("select %s({coords: 'no-such-row'})" % fn)
+
+mldb.run_tests()
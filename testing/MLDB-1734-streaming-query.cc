@@ -0,0 +1,149 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/** MLDB-1734-streaming-query.cc
+
+    The streaming=true parameter of /v1/query sends the rows back with
+    chunked transfer encoding, interleaved with execution.  Over a real
+    HTTP connection, the streamed body must parse to exactly the same
+    JSON as the non-streaming response for every streamable format, and
+    the response must actually be chunked.
+*/
+
+#include "mldb/server/mldb_server.h"
+#include "mldb/core/dataset.h"
+#include "mldb/http/http_rest_proxy.h"
+#include "mldb/jml/utils/string_functions.h"
+#include "mldb/types/pair_description.h"
+#include "mldb/types/tuple_description.h"
+#include "mldb/types/vector_description.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+
+using namespace std;
+using namespace Datacratic;
+using namespace Datacratic::MLDB;
+
+BOOST_AUTO_TEST_CASE( test_streaming_query )
+{
+    MldbServer server;
+
+    server.init();
+    string httpBoundAddress = server.bindTcp(PortRange(17000,18000),
+                                             "127.0.0.1");
+    cerr << "http listening on " << httpBoundAddress << endl;
+    server.start();
+
+    HttpRestProxy proxy(httpBoundAddress);
+
+    PolyConfig datasetConfig;
+    datasetConfig.type = "sparse.mutable";
+
+    auto putResult = proxy.put("/v1/datasets/test",
+                               jsonEncode(datasetConfig));
+    BOOST_REQUIRE_EQUAL(putResult.code(), 201);
+
+    // Enough rows that the streamed body is well past the 64kb chunk
+    // buffer, so the response really does arrive in several chunks
+    typedef std::vector<std::tuple<ColumnName, CellValue, Date> > Columns;
+    std::vector<std::pair<RowName, Columns> > rows;
+    rows.reserve(2000);
+
+    for (int i = 0;  i < 2000;  ++i) {
+        Columns columns;
+        columns.emplace_back(ColumnName("x"), i, Date());
+        columns.emplace_back(ColumnName("label"),
+                             ML::format("row number %d padded out to make "
+                                        "the output bigger", i),
+                             Date());
+        rows.emplace_back(RowName(ML::format("row%04d", i)),
+                          std::move(columns));
+    }
+
+    auto postResult = proxy.post("/v1/datasets/test/multirows",
+                                 jsonEncode(rows));
+    BOOST_REQUIRE_EQUAL(postResult.code(), 200);
+    BOOST_REQUIRE_EQUAL(proxy.post("/v1/datasets/test/commit").code(), 200);
+
+    string sql = "select * from test order by rowName()";
+
+    auto streamingGet = [&] (const RestParams & params,
+                             bool & chunked, int & dataCalls)
+        {
+            string body;
+            chunked = false;
+            dataCalls = 0;
+
+            auto onData = [&] (const std::string & data)
+                {
+                    ++dataCalls;
+                    body += data;
+                    return true;
+                };
+            auto onHeader = [&] (const HttpHeader & header)
+                {
+                    chunked = header.isChunked;
+                    return true;
+                };
+
+            auto response = proxy.get("/v1/query", params, {}, -1,
+                                      true, onData, onHeader);
+            BOOST_REQUIRE_EQUAL(response.code(), 200);
+            return body;
+        };
+
+    for (string format: { "full", "sparse", "aos" }) {
+        auto plain = proxy.get("/v1/query",
+                               { { "q", sql }, { "format", format } });
+        BOOST_REQUIRE_EQUAL(plain.code(), 200);
+        Json::Value expected = Json::parse(plain.body());
+        BOOST_REQUIRE_EQUAL(expected.size(), 2000u);
+
+        bool chunked;
+        int dataCalls;
+        string body = streamingGet({ { "q", sql },
+                                     { "format", format },
+                                     { "streaming", "true" } },
+                                   chunked, dataCalls);
+
+        BOOST_CHECK(chunked);
+        BOOST_CHECK_GT(dataCalls, 1);
+        BOOST_CHECK(Json::parse(body) == expected);
+    }
+
+    // The sparse format honours the row name and hash switches when
+    // streaming too
+    {
+        auto plain = proxy.get("/v1/query",
+                               { { "q", sql }, { "format", "sparse" },
+                                 { "rowNames", "false" },
+                                 { "rowHashes", "true" } });
+        BOOST_REQUIRE_EQUAL(plain.code(), 200);
+
+        bool chunked;
+        int dataCalls;
+        string body = streamingGet({ { "q", sql }, { "format", "sparse" },
+                                     { "rowNames", "false" },
+                                     { "rowHashes", "true" },
+                                     { "streaming", "true" } },
+                                   chunked, dataCalls);
+
+        BOOST_CHECK(chunked);
+        BOOST_CHECK(Json::parse(body) == Json::parse(plain.body()));
+    }
+
+    // Formats that need the whole result before serializing can't be
+    // streamed
+    {
+        auto response = proxy.get("/v1/query",
+                                  { { "q", sql }, { "format", "table" },
+                                    { "streaming", "true" } },
+                                  {}, -1, false /* exceptions */);
+        BOOST_CHECK_EQUAL(response.code(), 400);
+    }
+
+    server.shutdown();
+}
@@ -0,0 +1,117 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/* binary_row_batch_test.cc                                        -*- C++ -*-
+   Jeremy Barnes, 29 August 2016
+
+   Test of the binary row batch encoding.
+*/
+
+#include "mldb/server/binary_row_batch.h"
+#include "mldb/http/http_exception.h"
+#include "mldb/jml/utils/string_functions.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+
+using namespace std;
+using namespace Datacratic;
+using namespace Datacratic::MLDB;
+
+typedef std::vector<std::tuple<ColumnName, CellValue, Date> > Cells;
+
+BOOST_AUTO_TEST_CASE( test_empty_batch )
+{
+    BinaryRowBatchWriter writer;
+    std::string encoded = writer.finish();
+    auto decoded = decodeBinaryRowBatch(encoded.data(), encoded.size());
+    BOOST_CHECK_EQUAL(decoded.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_round_trip )
+{
+    Date ts = Date::fromSecondsSinceEpoch(1472428800.5);
+
+    Cells cells;
+    cells.emplace_back(ColumnName("empty"), CellValue(), ts);
+    cells.emplace_back(ColumnName("int"), CellValue(-42), ts);
+    cells.emplace_back(ColumnName("bigint"), CellValue(1LL << 60), ts);
+    cells.emplace_back(ColumnName("float"), CellValue(1.25), ts);
+    cells.emplace_back(ColumnName("str"), CellValue("hello"), ts);
+    cells.emplace_back(ColumnName("utf8"), CellValue(Utf8String("école")), ts);
+    cells.emplace_back(ColumnName("ts"), CellValue(ts), ts);
+    cells.emplace_back(ColumnName("interval"),
+                       CellValue::fromMonthDaySecond(1, 2, 3.5), ts);
+    cells.emplace_back(ColumnName("blob"), CellValue::blob("\0\1\2", 3), ts);
+    cells.emplace_back(ColumnName("path"), CellValue(Path::parse("a.b.c")), ts);
+
+    BinaryRowBatchWriter writer;
+    writer.addRow(RowName("row1"), cells);
+    writer.addRow(RowName("row2"), cells);
+    BOOST_CHECK_EQUAL(writer.rowCount(), 2);
+
+    std::string encoded = writer.finish();
+    auto decoded = decodeBinaryRowBatch(encoded.data(), encoded.size());
+
+    BOOST_REQUIRE_EQUAL(decoded.size(), 2);
+    BOOST_CHECK_EQUAL(decoded[0].first, RowName("row1"));
+    BOOST_CHECK_EQUAL(decoded[1].first, RowName("row2"));
+
+    for (auto & row: decoded) {
+        BOOST_REQUIRE_EQUAL(row.second.size(), cells.size());
+        for (size_t i = 0;  i < cells.size();  ++i) {
+            BOOST_CHECK_EQUAL(std::get<0>(row.second[i]), std::get<0>(cells[i]));
+            BOOST_CHECK_EQUAL(std::get<1>(row.second[i]), std::get<1>(cells[i]));
+            BOOST_CHECK_EQUAL(std::get<2>(row.second[i]), std::get<2>(cells[i]));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_column_dictionary_is_shared )
+{
+    Date ts = Date::now();
+
+    BinaryRowBatchWriter writer;
+    for (unsigned i = 0;  i < 1000;  ++i) {
+        Cells cells;
+        cells.emplace_back(ColumnName("aColumnWithALongishName"),
+                           CellValue((int)i), ts);
+        writer.addRow(RowName(ML::format("row%d", i)), cells);
+    }
+
+    std::string encoded = writer.finish();
+
+    // The column name is sent once, not once per row
+    BOOST_CHECK_LT(encoded.size(), 1000 * 20);
+
+    auto decoded = decodeBinaryRowBatch(encoded.data(), encoded.size());
+    BOOST_CHECK_EQUAL(decoded.size(), 1000);
+    BOOST_CHECK_EQUAL(std::get<1>(decoded[123].second[0]), CellValue(123));
+}
+
+BOOST_AUTO_TEST_CASE( test_malformed_batches_rejected )
+{
+    BinaryRowBatchWriter writer;
+    writer.addRow(RowName("row1"),
+                  { std::make_tuple(ColumnName("x"), CellValue(1),
+                                    Date::now()) });
+    std::string encoded = writer.finish();
+
+    // Truncation anywhere must throw, not read out of bounds
+    for (size_t len = 0;  len < encoded.size();  ++len) {
+        BOOST_CHECK_THROW(decodeBinaryRowBatch(encoded.data(), len),
+                          std::exception);
+    }
+
+    // Wrong magic
+    std::string garbage = "not a row batch";
+    BOOST_CHECK_THROW(decodeBinaryRowBatch(garbage.data(), garbage.size()),
+                      std::exception);
+
+    // Trailing junk
+    std::string trailing = encoded + "x";
+    BOOST_CHECK_THROW(decodeBinaryRowBatch(trailing.data(), trailing.size()),
+                      std::exception);
+}
@@ -11,6 +11,9 @@
 #define BOOST_TEST_DYN_LINK
 
 #include <atomic>
+#include <mutex>
+#include <unistd.h>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -18,6 +21,9 @@
 #include "mldb/arch/exception.h"
 #include "mldb/jml/utils/string_functions.h"
 #include "mldb/jml/utils/vector_utils.h"
+#include "mldb/jml/utils/guard.h"
+#include "mldb/vfs/filter_streams.h"
+#include "mldb/vfs/filter_streams_registry.h"
 
 #include "mldb/plugins/for_each_line.h"
 
@@ -89,3 +95,115 @@ BOOST_AUTO_TEST_CASE( test_forEachLine_throw )
 
     BOOST_CHECK_THROW(forEachLineStr(stream, processLine), ML::Exception);
 }
+
+BOOST_AUTO_TEST_CASE( test_forEachLineBlock_mapped )
+{
+    // The zero-copy path needs a real file that can be memory mapped
+    string filename = "/tmp/for_each_line_mapped_test_"
+        + to_string(getpid()) + ".txt";
+    ML::Call_Guard fn([&]() { unlink(filename.c_str()); });
+
+    // Enough data to span more than one 20MB block, so the hand-off
+    // between blocks is exercised
+    constexpr int64_t numLines = 300000;
+    const string padding(80, 'x');
+
+    {
+        filter_ostream stream(filename);
+        stream << "header\n";
+        for (int64_t i = 0;  i < numLines;  ++i)
+            stream << "mapped line " << i << " " << padding << "\n";
+    }
+
+    filter_istream stream(filename, { { "mapped", "true" } });
+
+    const char * mappedStart;
+    size_t mappedSize;
+    std::tie(mappedStart, mappedSize) = stream.mapped();
+    BOOST_REQUIRE(mappedStart != nullptr);
+
+    string header;
+    getline(stream, header);
+    BOOST_CHECK_EQUAL(header, "header");
+
+    mutex resultMutex;
+    map<int64_t, string> result;
+    auto onLine = [&] (const char * line, size_t lineLength,
+                       int64_t blockNumber, int64_t lineNumber) {
+        // Lines must point into the mapping, not into a copy of it
+        BOOST_CHECK(line >= mappedStart
+                    && line + lineLength <= mappedStart + mappedSize);
+        lock_guard<mutex> guard(resultMutex);
+        BOOST_CHECK(result.insert({lineNumber, string(line, lineLength)})
+                    .second);
+        return true;
+    };
+
+    forEachLineBlock(stream, onLine);
+
+    BOOST_REQUIRE_EQUAL(result.size(), numLines);
+    for (int64_t i = 0;  i < numLines;  ++i)
+        BOOST_CHECK_EQUAL(result[i],
+                          "mapped line " + to_string(i) + " " + padding);
+}
+
+BOOST_AUTO_TEST_CASE( test_forEachLineBlock_zstd_blocked )
+{
+    ML::Call_Guard fn([&]() {deleteAllMemStreamStrings();});
+
+    // Enough lines to span several of the 2MB compressed blocks, so
+    // that the parallel decompression path is really exercised
+    constexpr int64_t numLines = 500000;
+
+    {
+        filter_ostream stream("mem://lines.zsb");
+        stream << "header\n";
+        for (int64_t i = 0;  i < numLines;  ++i)
+            stream << "this is line number " << i << "\n";
+    }
+
+    filter_istream stream("mem://lines.zsb");
+    string header;
+    getline(stream, header);
+    BOOST_CHECK_EQUAL(header, "header");
+
+    mutex resultMutex;
+    map<int64_t, string> result;
+    auto onLine = [&] (const char * line, size_t lineLength,
+                       int64_t blockNumber, int64_t lineNumber) {
+        lock_guard<mutex> guard(resultMutex);
+        BOOST_CHECK(result.insert({lineNumber, string(line, lineLength)})
+                    .second);
+        return true;
+    };
+
+    forEachLineBlock(stream, "mem://lines.zsb", 1 /* header */, onLine);
+
+    BOOST_REQUIRE_EQUAL(result.size(), numLines);
+    for (int64_t i = 0;  i < numLines;  ++i)
+        BOOST_CHECK_EQUAL(result[i], "this is line number " + to_string(i));
+}
+
+BOOST_AUTO_TEST_CASE( test_forEachLineBlock_zstd_blocked_maxLines )
+{
+    ML::Call_Guard fn([&]() {deleteAllMemStreamStrings();});
+
+    {
+        filter_ostream stream("mem://lines.zsb");
+        for (int64_t i = 0;  i < 1000;  ++i)
+            stream << "line " << i << "\n";
+    }
+
+    filter_istream stream("mem://lines.zsb");
+
+    atomic<int64_t> count(0);
+    auto onLine = [&] (const char * line, size_t lineLength,
+                       int64_t blockNumber, int64_t lineNumber) {
+        ++count;
+        return true;
+    };
+
+    forEachLineBlock(stream, "mem://lines.zsb", 0, onLine, 100 /* maxLines */);
+
+    BOOST_CHECK_EQUAL(count, 100);
+}
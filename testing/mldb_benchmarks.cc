@@ -0,0 +1,258 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/** mldb_benchmarks.cc                                             -*- C++ -*-
+
+    Micro-benchmarks for the query and storage hot paths: CellValue
+    construction, Path hashing, FrozenColumn scans, ExpressionValue row
+    building, forEachLineBlock throughput and an end-to-end SELECT scan.
+
+    This is not a correctness test and is not part of the test suite;
+    build it with the 'benchmarks' target and run it directly.  Each
+    benchmark prints one line of JSON on stdout:
+
+        {"benchmark":"path_hash","ops":...,"nsPerOp":...,"opsPerSec":...}
+
+    so that results are machine readable and can be tracked across
+    releases.  For the scan benchmarks an op is one row.
+*/
+
+#include "mldb/sql/cell_value.h"
+#include "mldb/sql/expression_value.h"
+#include "mldb/server/mldb_server.h"
+#include "mldb/core/dataset.h"
+#include "mldb/plugins/tabular_dataset_column.h"
+#include "mldb/plugins/frozen_column.h"
+#include "mldb/plugins/for_each_line.h"
+#include "mldb/types/date.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+using namespace Datacratic;
+using namespace Datacratic::MLDB;
+
+namespace {
+
+/// Results accumulate here so the compiler can't remove the work
+volatile uint64_t sink = 0;
+
+double secondsSince(const chrono::steady_clock::time_point & start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start)
+        .count();
+}
+
+void report(const char * benchmark, size_t ops, double seconds)
+{
+    printf("{\"benchmark\":\"%s\",\"ops\":%zu,"
+           "\"nsPerOp\":%.2f,\"opsPerSec\":%.0f}\n",
+           benchmark, ops, seconds * 1e9 / ops, ops / seconds);
+    fflush(stdout);
+}
+
+/** Run fn(numOps) and report its timing under the given name. */
+template<typename Fn>
+void bench(const char * benchmark, size_t numOps, Fn && fn)
+{
+    auto start = chrono::steady_clock::now();
+    fn(numOps);
+    report(benchmark, numOps, secondsSince(start));
+}
+
+void benchCellValue()
+{
+    bench("cellvalue_construct_int", 10000000, [] (size_t n)
+        {
+            for (size_t i = 0;  i < n;  ++i) {
+                CellValue v((int64_t)i);
+                sink += (int)v.cellType();
+            }
+        });
+
+    bench("cellvalue_construct_double", 10000000, [] (size_t n)
+        {
+            for (size_t i = 0;  i < n;  ++i) {
+                CellValue v(i * 0.5);
+                sink += (int)v.cellType();
+            }
+        });
+
+    bench("cellvalue_construct_short_string", 5000000, [] (size_t n)
+        {
+            // Short enough for the inline string representation
+            for (size_t i = 0;  i < n;  ++i) {
+                CellValue v("short str");
+                sink += (int)v.cellType();
+            }
+        });
+
+    bench("cellvalue_construct_long_string", 2000000, [] (size_t n)
+        {
+            string longString(100, 'x');
+            for (size_t i = 0;  i < n;  ++i) {
+                CellValue v(longString);
+                sink += (int)v.cellType();
+            }
+        });
+}
+
+void benchPathHash()
+{
+    vector<ColumnName> names;
+    for (unsigned i = 0;  i < 500;  ++i)
+        names.emplace_back(ML::format("field%d", i));
+    for (unsigned i = 0;  i < 500;  ++i)
+        names.push_back(ColumnName(ML::format("nested%d", i))
+                        + PathElement("value"));
+
+    bench("path_hash", 10000000, [&] (size_t n)
+        {
+            for (size_t i = 0;  i < n;  ++i)
+                sink += names[i % names.size()].hash();
+        });
+
+    bench("path_parse", 2000000, [&] (size_t n)
+        {
+            for (size_t i = 0;  i < n;  ++i)
+                sink += ColumnName::parse("a.b.field").hash();
+        });
+}
+
+void benchFrozenColumn()
+{
+    constexpr size_t numRows = 2000000;
+
+    // An integer column with few distinct values, as a categorical
+    // column freezes
+    TabularDatasetColumn intColumn;
+    intColumn.reserve(numRows);
+    for (size_t i = 0;  i < numRows;  ++i)
+        intColumn.add(i, CellValue((int64_t)(i % 1000)));
+    auto frozenInts = intColumn.freeze();
+
+    bench("frozen_column_scan_int", numRows, [&] (size_t n)
+        {
+            for (size_t i = 0;  i < n;  ++i)
+                sink += frozenInts->get(i).toInt();
+        });
+
+    TabularDatasetColumn doubleColumn;
+    doubleColumn.reserve(numRows);
+    for (size_t i = 0;  i < numRows;  ++i)
+        doubleColumn.add(i, CellValue(i * 0.1));
+    auto frozenDoubles = doubleColumn.freeze();
+
+    bench("frozen_column_scan_double", numRows, [&] (size_t n)
+        {
+            for (size_t i = 0;  i < n;  ++i)
+                sink += (uint64_t)frozenDoubles->get(i).toDouble();
+        });
+}
+
+void benchExpressionValueRow()
+{
+    constexpr size_t numCols = 20;
+
+    vector<ColumnName> names;
+    for (unsigned i = 0;  i < numCols;  ++i)
+        names.emplace_back(ML::format("col%d", i));
+
+    Date ts = Date::now();
+
+    bench("expression_value_row_build", 500000, [&] (size_t n)
+        {
+            for (size_t i = 0;  i < n;  ++i) {
+                RowValue row;
+                row.reserve(numCols);
+                for (unsigned j = 0;  j < numCols;  ++j)
+                    row.emplace_back(names[j], (int64_t)(i + j), ts);
+                ExpressionValue value(std::move(row));
+                sink += value.isRow();
+            }
+        });
+}
+
+void benchForEachLineBlock()
+{
+    constexpr size_t numLines = 2000000;
+
+    string data;
+    data.reserve(numLines * 40);
+    for (size_t i = 0;  i < numLines;  ++i) {
+        data += ML::format("%zd,some text field,3.25,another field", i);
+        data += '\n';
+    }
+
+    bench("for_each_line_block", numLines, [&] (size_t n)
+        {
+            istringstream stream(data);
+            std::atomic<uint64_t> bytes(0);
+            auto onLine = [&] (const char * line, size_t length,
+                               int64_t blockNumber, int64_t lineNumber)
+                {
+                    bytes += length;
+                    return true;
+                };
+            forEachLineBlock(stream, onLine);
+            sink += bytes;
+        });
+}
+
+void benchSelectScan()
+{
+    MldbServer server;
+    server.init();
+
+    PolyConfig datasetConfig;
+    datasetConfig.type = "sparse.mutable";
+    datasetConfig.id = "bench";
+
+    auto dataset = createDataset(&server, datasetConfig, nullptr,
+                                 true /* overwrite */);
+
+    constexpr size_t numRows = 100000;
+
+    vector<ColumnName> names;
+    for (unsigned i = 0;  i < 5;  ++i)
+        names.emplace_back(ML::format("col%d", i));
+
+    Date ts = Date::now();
+    for (size_t i = 0;  i < numRows;  ++i) {
+        vector<tuple<ColumnName, CellValue, Date> > columns;
+        columns.reserve(names.size());
+        for (unsigned j = 0;  j < names.size();  ++j)
+            columns.emplace_back(names[j], (int64_t)(i * j), ts);
+        dataset->recordRow(RowName(ML::format("row%zd", i)), columns);
+    }
+    dataset->commit();
+
+    constexpr size_t numQueries = 10;
+
+    bench("bound_select_query_scan", numRows * numQueries, [&] (size_t)
+        {
+            for (size_t i = 0;  i < numQueries;  ++i) {
+                auto rows = server.query
+                    ("SELECT count(*), sum(col1) FROM bench WHERE col2 >= 0");
+                sink += rows.size();
+            }
+        });
+
+    server.shutdown();
+}
+
+} // file scope
+
+int main(int argc, char ** argv)
+{
+    benchCellValue();
+    benchPathHash();
+    benchFrozenColumn();
+    benchExpressionValueRow();
+    benchForEachLineBlock();
+    benchSelectScan();
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#
+# sketch_aggregators_test.py
+# This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+#
+# Tests for the sketch based aggregators: topk, approx_count_distinct
+# and frequent_items.
+#
+
+mldb = mldb_wrapper.wrap(mldb) # noqa
+
+import unittest
+
+class SketchAggregatorsTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        ds = mldb.create_dataset({'id': 'example', 'type': 'tabular'})
+        # 100 rows of x = 0..99; y is highly skewed: 90 'a', 9 'b', 1 'c'
+        for i in xrange(100):
+            y = 'a' if i < 90 else ('b' if i < 99 else 'c')
+            ds.record_row('row%d' % i, [['x', i, 0], ['y', y, 0]])
+        ds.commit()
+
+    def test_topk(self):
+        res = mldb.query('select topk(x, 3) as tk from example')
+        self.assertEqual(res[1][1:], [99, 98, 97])
+
+    def test_approx_count_distinct(self):
+        res = mldb.query('select approx_count_distinct(x) as cnt, '
+                         'approx_count_distinct(y) as cnty from example')
+        # exact at these cardinalities (linear counting range)
+        self.assertEqual(res[1][1:], [100, 3])
+
+    def test_frequent_items(self):
+        res = mldb.query('select frequent_items(y, 2) as * from example')
+        header = res[0]
+        counts = dict(zip(header[1:], res[1][1:]))
+        # with 3 distinct values and k=2 the top item is exact
+        self.assertEqual(counts['a'], 90)
+        self.assertEqual(len(counts), 2)
+
+    def test_parallel_merge(self):
+        # Large enough to aggregate on several threads; the merged
+        # estimate must not depend on the partitioning
+        ds = mldb.create_dataset({'id': 'big', 'type': 'tabular'})
+        for i in xrange(100000):
+            ds.record_row('row%d' % i, [['x', i % 1000, 0]])
+        ds.commit()
+
+        res = mldb.query('select approx_count_distinct(x) as cnt from big')
+        cnt = res[1][1]
+        self.assertTrue(abs(cnt - 1000) < 100,
+                        'estimate %d too far from 1000' % cnt)
+
+        res = mldb.query('select topk(x, 2) as tk from big')
+        self.assertEqual(res[1][1:], [999, 998])
+
+mldb.run_tests()
@@ -16,6 +16,12 @@ $(eval $(call include_sub_make,cookbook))
 
 $(eval $(call library,mldb_test_function,test_function.cc,mldb))
 
+# Micro-benchmarks for the query and storage hot paths.  Not part of the
+# test suite; build with the 'benchmarks' target and run mldb_benchmarks
+# directly to get one JSON line per benchmark, for tracking across
+# releases.
+$(eval $(call program,mldb_benchmarks,mldb,,benchmarks))
+
 
 $(eval $(call mldb_unit_test,MLDBFB-336-sample_test.py,,manual))
 
@@ -25,6 +31,7 @@ $(eval $(call test,mldb_python_plugin_test,mldb,boost))
 $(eval $(call test,MLDB-642_script_procedure_test,mldb,boost))
 $(eval $(call test,for_each_line_test,mldb,boost))
 $(eval $(call test,svd_utils_test,mldb,boost))
+$(eval $(call test,binary_row_batch_test,mldb,boost))
 
 $(eval $(call test,mldb_reddit_test,mldb,boost))
 $(eval $(call test,cell_value_test,sql_expression,boost))
@@ -233,6 +240,9 @@ $(eval $(call mldb_unit_test,MLDB-1026-slow-not-in.js))
 $(eval $(call mldb_unit_test,MLDB-974-slow-subquery.js))
 $(eval $(call mldb_unit_test,MLDB-1155_csv_line_endings.py))
 $(eval $(call test,MLDB-1040-invalid-requests,mldb,boost))
+$(eval $(call test,MLDB-1711-binary-query-format,mldb,boost))
+$(eval $(call test,MLDB-1730-tabular-replication,mldb,boost))
+$(eval $(call test,MLDB-1734-streaming-query,mldb,boost))
 $(eval $(call mldb_unit_test,MLDB-1081-getEmbedding_honors_limit_offset.py))
 $(eval $(call mldb_unit_test,MLDB-951-run-on-creation.py))
 $(eval $(call mldb_unit_test,MLDB-1092_conf_interval.py))
@@ -346,6 +356,7 @@ $(eval $(call mldb_unit_test,MLDB-1594-aggregator-empty-row.py))
 $(eval $(call mldb_unit_test,MLDB-1617-like-precedence.py))
 $(eval $(call mldb_unit_test,MLDB-1707-no-context-resolve-table.py))
 $(eval $(call mldb_unit_test,MLDB-1706-horizontal.py))
+$(eval $(call mldb_unit_test,sketch_aggregators_test.py))
 
 # The MLDB-1398 test case requires a library and a plugin
 # Tensorflow plugins
@@ -377,5 +388,29 @@ $(eval $(call mldb_unit_test,MLDB-1705-function-application-path.py))
 $(eval $(call mldb_unit_test,MLDB-1691-str-functions.py))
 $(eval $(call mldb_unit_test,MLDB-1694-flatten-embeddings.py,tensorflow))
 $(eval $(call mldb_unit_test,MLDB-1703_null_char_import.py))
+$(eval $(call mldb_unit_test,MLDB-1708-query-plan-cache.py))
+$(eval $(call mldb_unit_test,MLDB-1710-query-profile.py))
+$(eval $(call mldb_unit_test,MLDB-1709-import-text-multi-file.py))
+$(eval $(call mldb_unit_test,MLDB-1712-csv-column-types.py))
+$(eval $(call mldb_unit_test,MLDB-1713-metrics-endpoint.py))
+$(eval $(call mldb_unit_test,MLDB-1714-bulk-row-fetch.py))
+$(eval $(call mldb_unit_test,MLDB-1715-pipeline-procedure.py))
+$(eval $(call mldb_unit_test,MLDB-1716-embedding-persistence.py))
+$(eval $(call mldb_unit_test,MLDB-1717-window-procedure.py))
+$(eval $(call mldb_unit_test,MLDB-1718-tabular-high-cardinality.py))
+$(eval $(call mldb_unit_test,MLDB-1719-embedding-vector-arithmetic.py))
+$(eval $(call mldb_unit_test,MLDB-1720-reservoir-sample.py))
+$(eval $(call mldb_unit_test,MLDB-1721-tabular-time-index.py))
+$(eval $(call mldb_unit_test,MLDB-1722-word2vec-bulk-import.py))
+$(eval $(call mldb_unit_test,MLDB-1723-multiline-parallel-import.py))
+$(eval $(call mldb_unit_test,MLDB-1724-group-commit.py))
+$(eval $(call mldb_unit_test,MLDB-1725-fused-function-chain.py))
+$(eval $(call mldb_unit_test,MLDB-1726-group-by-order-by-limit.py))
+$(eval $(call mldb_unit_test,MLDB-1727-tabular-wal-recovery.py))
+$(eval $(call mldb_unit_test,MLDB-1728-tabular-persistence-roundtrip.py))
+$(eval $(call mldb_unit_test,MLDB-1729-parquet-import.py))
+$(eval $(call mldb_unit_test,MLDB-1731-sharded-dataset.py))
+$(eval $(call mldb_unit_test,MLDB-1732-query-result-cache.py))
+$(eval $(call mldb_unit_test,MLDB-1733-hnsw-recall.py))
 $(eval $(call mldb_unit_test,MLDB-1678-rowname-optimizations.js))
 $(eval $(call mldb_unit_test,classifier_test_err_on_empty_sets.py))
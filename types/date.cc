@@ -9,6 +9,10 @@
 #include "date.h"
 #include "date_description.h"
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include "mldb/arch/format.h"
 #include "mldb/soa/js/js_value.h"
@@ -89,6 +93,129 @@ expectFixedWidthInt(ML::Parse_Context & context,
 const boost::posix_time::ptime
 epoch(boost::gregorian::date(1970, 1, 1));
 
+/** True iff every byte of w selected by mask (0xff on selected lanes)
+    is an ASCII digit. */
+inline bool
+digitsAt(uint64_t w, uint64_t mask)
+{
+    // high nibble of each digit is 3...
+    if (((w ^ 0x3030303030303030ULL) & 0xF0F0F0F0F0F0F0F0ULL & mask) != 0)
+        return false;
+    // ... and the low nibble is at most 9.  Lanes hold at most 0x15
+    // after the add, so there is no carry between them.
+    uint64_t lo = w & 0x0F0F0F0F0F0F0F0FULL & mask;
+    return ((lo + 0x0606060606060606ULL) & 0x1010101010101010ULL & mask) == 0;
+}
+
+/** Digit value of the given byte of a little-endian load of digits. */
+inline unsigned
+digitAt(uint64_t w, int byte)
+{
+    return (w >> (8 * byte)) & 0x0F;
+}
+
+/** Days between 1970-01-01 and the given proleptic Gregorian date;
+    negative before the epoch. */
+inline int64_t
+daysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = y - era * 400;                                 // [0, 399]
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;// [0, 365]
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;         // [0, 146096]
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+/** Inverse of daysFromCivil. */
+inline void
+civilFromDays(int64_t z, int64_t & y, unsigned & m, unsigned & d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = z - era * 146097;
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp + (mp < 10 ? 3 : -9);
+    y = (int64_t)yoe + era * 400 + (m <= 2);
+}
+
+/** Fast path for the fixed layout we print ourselves:
+    YYYY-MM-DDTHH:MM:SS[.fff...][Z], with a space accepted in place of
+    the T.  This is the layout of nearly every timestamp column in a
+    CSV import, so the digits come out of two eight-byte loads instead
+    of walking a Parse_Context character at a time.  Returns false on
+    anything that doesn't match exactly, including out-of-range fields
+    and timezone offsets; the caller then falls back to the general
+    parser, so behaviour is unchanged on a mismatch. */
+bool
+tryParseFixedIso8601(const char * p, size_t len, double & result)
+{
+    if (len < 19)
+        return false;
+    if (p[4] != '-' || p[7] != '-' || (p[10] != 'T' && p[10] != ' ')
+        || p[13] != ':' || p[16] != ':')
+        return false;
+
+    uint64_t w0, w1;
+    std::memcpy(&w0, p, 8);       // YYYY-MM-
+    std::memcpy(&w1, p + 11, 8);  // HH:MM:SS
+
+    if (!digitsAt(w0, 0x00FFFF00FFFFFFFFULL)       // YYYY and MM
+        || !digitsAt(w1, 0xFFFF00FFFF00FFFFULL)    // HH, MM and SS
+        || (unsigned)(p[8] - '0') > 9 || (unsigned)(p[9] - '0') > 9)
+        return false;
+
+    int year  = digitAt(w0, 0) * 1000 + digitAt(w0, 1) * 100
+              + digitAt(w0, 2) * 10 + digitAt(w0, 3);
+    int month = digitAt(w0, 5) * 10 + digitAt(w0, 6);
+    int day   = (p[8] - '0') * 10 + (p[9] - '0');
+    int hour  = digitAt(w1, 0) * 10 + digitAt(w1, 1);
+    int min   = digitAt(w1, 3) * 10 + digitAt(w1, 4);
+    int sec   = digitAt(w1, 6) * 10 + digitAt(w1, 7);
+
+    // Boost's calendar only covers 1400 onwards; send anything it
+    // might reject to the general parser so errors stay identical
+    static const int daysInMonth[]
+        = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (year < 1400 || month < 1 || month > 12
+        || hour > 23 || min > 59 || sec > 59)
+        return false;
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (day < 1 || day > daysInMonth[month - 1] + (leap && month == 2))
+        return false;
+
+    int64_t daySeconds = daysFromCivil(year, month, day) * 86400;
+    int timeOfDay = hour * 3600 + min * 60 + sec;
+
+    size_t pos = 19;
+    if (pos < len && p[pos] == '.') {
+        // Fractional seconds: defer to strtod on the decimal so the
+        // value rounds exactly as the general parser's would.  The
+        // fraction belongs to the non-negative time of day; the date's
+        // seconds (negative before the epoch) are added afterwards, as
+        // the general parser does.  Gluing the fraction onto the
+        // signed total instead would subtract it for pre-epoch dates.
+        char buf[64];
+        int n = snprintf(buf, sizeof(buf), "%d", timeOfDay);
+        size_t start = pos++;
+        while (pos < len && (unsigned)(p[pos] - '0') <= 9)
+            ++pos;
+        if (pos == start + 1 || pos - start + n >= sizeof(buf))
+            return false;
+        std::memcpy(buf + n, p + start, pos - start);
+        buf[n + pos - start] = 0;
+        result = daySeconds + strtod(buf, nullptr);
+    }
+    else result = daySeconds + timeOfDay;
+
+    if (pos < len && p[pos] == 'Z')
+        ++pos;
+    return pos == len;
+}
+
 }
 
 namespace Datacratic {
@@ -202,6 +329,11 @@ parseIso8601DateTime(const std::string & dateTimeStr)
     else if (dateTimeStr == "-Inf")
         return negativeInfinity();
     else {
+        double seconds;
+        if (tryParseFixedIso8601(dateTimeStr.c_str(), dateTimeStr.length(),
+                                 seconds))
+            return fromSecondsSinceEpoch(seconds);
+
         Date date;
         Iso8601Parser parser(dateTimeStr);
         if (!parser.matchDateTime(date))
@@ -381,11 +513,58 @@ printIso8601(int seconds_digits) const
         else return "-Inf";
     }
 
-    string result = print("%Y-%m-%dT%H:%M:%S");
+    string result;
+
+    /* Fast path: the layout is fixed, so for the four-digit-year range
+       the nineteen leading characters can be written digit by digit
+       without going through gmtime_r and strftime.  Matches the
+       truncation towards zero that print() applies to the seconds. */
+    if (secondsSinceEpoch_ > -1000000000000.0    // same cutoffs as print()
+        && secondsSinceEpoch_ < 100000000000.0)
+    {
+        int64_t t = (int64_t)secondsSinceEpoch_;
+        int64_t days = t / 86400;
+        int64_t rem = t % 86400;
+        if (rem < 0) {
+            rem += 86400;
+            --days;
+        }
+
+        int64_t year;
+        unsigned month, day;
+        civilFromDays(days, year, month, day);
+
+        if (year >= 1000 && year <= 9999) {
+            auto put2 = [] (char * p, unsigned v) {
+                p[0] = '0' + v / 10;
+                p[1] = '0' + v % 10;
+            };
+
+            char buf[19];
+            put2(buf, year / 100);
+            put2(buf + 2, year % 100);
+            buf[4] = '-';
+            put2(buf + 5, month);
+            buf[7] = '-';
+            put2(buf + 8, day);
+            buf[10] = 'T';
+            put2(buf + 11, rem / 3600);
+            buf[13] = ':';
+            put2(buf + 14, (rem / 60) % 60);
+            buf[16] = ':';
+            put2(buf + 17, rem % 60);
+
+            result.assign(buf, 19);
+        }
+    }
+
+    if (result.empty()) {
+        result = print("%Y-%m-%dT%H:%M:%S");
+
+        if (result == "Inf" || result == "-Inf" || result == "NaD")
+            return result;
+    }
 
-    if (result == "Inf" || result == "-Inf" || result == "NaD")
-        return result;
-    
     addFractionalSeconds(result, secondsSinceEpoch(), seconds_digits);
 
     result += "Z";
@@ -11,6 +11,7 @@
 
 #include "json_printing.h"
 #include "dtoa.h"
+#include "itoa.h"
 #include <cmath>
 #include <iostream>
 #include "mldb/ext/jsoncpp/value.h"
@@ -700,58 +701,58 @@ writeNull()
     write("null");
 }
 
+// Shared by the integer writers below; itoa is much cheaper than
+// sprintf, which matters when serializing large numeric results
+template<typename T>
+static void writeItoa(std::string & str, T i)
+{
+    ItoaBuf buf;
+    char * begin;
+    char * end;
+    std::tie(begin, end) = itoa(i, buf);
+    str.append(begin, end);
+}
+
 void
 StringJsonPrintingContext::
 writeInt(int i)
 {
-    char buffer[128];
-    int chars = sprintf(buffer, "%i", i);
-    write(buffer, chars);
+    writeItoa(str, i);
 }
 
 void
 StringJsonPrintingContext::
 writeUnsignedInt(unsigned int i)
 {
-    char buffer[128];
-    int chars = sprintf(buffer, "%u", i);
-    write(buffer, chars);
+    writeItoa(str, i);
 }
 
 void
 StringJsonPrintingContext::
 writeLong(long int i)
 {
-    char buffer[128];
-    int chars = sprintf(buffer, "%li", i);
-    write(buffer, chars);
+    writeItoa(str, i);
 }
 
 void
 StringJsonPrintingContext::
 writeUnsignedLong(unsigned long int i)
 {
-    char buffer[128];
-    int chars = sprintf(buffer, "%lu", i);
-    write(buffer, chars);
+    writeItoa(str, i);
 }
 
 void
 StringJsonPrintingContext::
 writeLongLong(long long int i)
 {
-    char buffer[128];
-    int chars = sprintf(buffer, "%lli", i);
-    write(buffer, chars);
+    writeItoa(str, i);
 }
 
 void
 StringJsonPrintingContext::
 writeUnsignedLongLong(unsigned long long int i)
 {
-    char buffer[128];
-    int chars = sprintf(buffer, "%llu", i);
-    write(buffer, chars);
+    writeItoa(str, i);
 }
 
 void
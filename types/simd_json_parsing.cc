@@ -0,0 +1,1080 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/* simd_json_parsing.cc
+   Jeremy Barnes, 29 August 2016
+
+   Vectorized two-stage JSON parser for complete, in-memory documents.
+*/
+
+#include "simd_json_parsing.h"
+#include "string.h"
+#include "mldb/arch/exception.h"
+#include "mldb/ext/jsoncpp/json.h"
+
+#include <emmintrin.h>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* TOKEN                                                                     */
+/*****************************************************************************/
+
+struct SimdJsonParsingContext::Token {
+    enum Type : uint8_t {
+        OBJECT_BEGIN,
+        OBJECT_END,
+        ARRAY_BEGIN,
+        ARRAY_END,
+        STRING,
+        NUMBER,
+        BOOL_TRUE,
+        BOOL_FALSE,
+        NULL_VALUE
+    };
+
+    uint8_t type;
+    uint8_t hasEscapes;  ///< Strings only: contains backslash escapes
+    uint32_t start;      ///< Offset of first byte (strings: after the quote)
+    uint32_t end;        ///< Offset one past last byte (strings: the quote)
+    uint32_t match;      ///< Begin tokens: index of the matching end token
+};
+
+
+namespace {
+
+using Token = SimdJsonParsingContext::Token;
+
+/// Nesting deeper than this falls back to the streaming parser rather
+/// than risking stack exhaustion in the recursive tokenizer.
+constexpr int MAX_NESTING_DEPTH = 1024;
+
+inline bool isJsonWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool isNumberChar(char c)
+{
+    return (c >= '0' && c <= '9')
+        || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+
+/*****************************************************************************/
+/* TOKENIZER                                                                 */
+/*****************************************************************************/
+
+/** Stage one: split a complete document into a tape of tokens, validating
+    the structure as we go.  All methods return false on anything that
+    isn't plain, well-formed JSON; the caller then falls back to the
+    streaming parser, which either parses it or produces its usual error.
+*/
+
+struct Tokenizer {
+    Tokenizer(const char * data, size_t length, std::vector<Token> & tape)
+        : data(data), length(length), pos(0), tape(tape)
+    {
+    }
+
+    const char * data;
+    size_t length;
+    size_t pos;
+    std::vector<Token> & tape;
+
+    void skipWhitespace()
+    {
+        while (pos < length && isJsonWhitespace(data[pos]))
+            ++pos;
+    }
+
+    /** Advance pos to the next quote or backslash, scanning sixteen bytes
+        at a time.  Returns false if the end of the document is reached
+        first.  This is where nearly all of the bytes of a typical
+        document are consumed, hence the vectorization.
+    */
+    bool findStringSpecial()
+    {
+        const __m128i quotes = _mm_set1_epi8('"');
+        const __m128i backslashes = _mm_set1_epi8('\\');
+
+        while (pos + 16 <= length) {
+            __m128i block
+                = _mm_loadu_si128((const __m128i *)(data + pos));
+            int mask = _mm_movemask_epi8
+                (_mm_or_si128(_mm_cmpeq_epi8(block, quotes),
+                              _mm_cmpeq_epi8(block, backslashes)));
+            if (mask) {
+                pos += __builtin_ctz(mask);
+                return true;
+            }
+            pos += 16;
+        }
+
+        while (pos < length && data[pos] != '"' && data[pos] != '\\')
+            ++pos;
+
+        return pos < length;
+    }
+
+    /// Tokenize a string; pos is on the opening quote
+    bool tokenizeString(Token & token)
+    {
+        ++pos;  // opening quote
+
+        token.type = Token::STRING;
+        token.hasEscapes = false;
+        token.start = pos;
+
+        for (;;) {
+            if (!findStringSpecial())
+                return false;  // unterminated string
+
+            if (data[pos] == '"')
+                break;
+
+            // Backslash: skip it and the escaped character, so that an
+            // escaped quote doesn't terminate the string.  Escapes are
+            // decoded lazily, only if the string is actually read.
+            token.hasEscapes = true;
+            pos += 2;
+            if (pos > length)
+                return false;
+        }
+
+        token.end = pos;
+        ++pos;  // closing quote
+        return true;
+    }
+
+    /// Tokenize a number; pos is on a digit or minus sign
+    bool tokenizeNumber(Token & token)
+    {
+        token.type = Token::NUMBER;
+        token.hasEscapes = false;
+        token.start = pos;
+
+        bool hasDigit = false;
+        while (pos < length && isNumberChar(data[pos])) {
+            hasDigit = hasDigit || isdigit(data[pos]);
+            ++pos;
+        }
+
+        token.end = pos;
+        return hasDigit;
+    }
+
+    bool tokenizeLiteral(const char * literal, Token::Type type)
+    {
+        size_t len = strlen(literal);
+        if (pos + len > length
+            || memcmp(data + pos, literal, len) != 0)
+            return false;
+
+        Token token;
+        token.type = type;
+        token.hasEscapes = false;
+        token.start = pos;
+        token.end = pos + len;
+        token.match = 0;
+        tape.push_back(token);
+
+        pos += len;
+        return true;
+    }
+
+    bool tokenizeObject(int depth)
+    {
+        size_t beginIndex = tape.size();
+        Token begin;
+        begin.type = Token::OBJECT_BEGIN;
+        begin.hasEscapes = false;
+        begin.start = pos;
+        begin.end = pos + 1;
+        begin.match = 0;
+        tape.push_back(begin);
+
+        ++pos;  // {
+        skipWhitespace();
+        if (pos == length)
+            return false;
+
+        if (data[pos] == '}')
+            ++pos;
+        else for (;;) {
+            skipWhitespace();
+            if (pos == length || data[pos] != '"')
+                return false;
+
+            Token key;
+            if (!tokenizeString(key))
+                return false;
+            tape.push_back(key);
+
+            skipWhitespace();
+            if (pos == length || data[pos] != ':')
+                return false;
+            ++pos;
+
+            if (!tokenizeValue(depth + 1))
+                return false;
+
+            skipWhitespace();
+            if (pos == length)
+                return false;
+            if (data[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (data[pos] == '}') {
+                ++pos;
+                break;
+            }
+            return false;
+        }
+
+        Token end;
+        end.type = Token::OBJECT_END;
+        end.hasEscapes = false;
+        end.start = pos - 1;
+        end.end = pos;
+        end.match = beginIndex;
+        tape[beginIndex].match = tape.size();
+        tape.push_back(end);
+
+        return true;
+    }
+
+    bool tokenizeArray(int depth)
+    {
+        size_t beginIndex = tape.size();
+        Token begin;
+        begin.type = Token::ARRAY_BEGIN;
+        begin.hasEscapes = false;
+        begin.start = pos;
+        begin.end = pos + 1;
+        begin.match = 0;
+        tape.push_back(begin);
+
+        ++pos;  // [
+        skipWhitespace();
+        if (pos == length)
+            return false;
+
+        if (data[pos] == ']')
+            ++pos;
+        else for (;;) {
+            if (!tokenizeValue(depth + 1))
+                return false;
+
+            skipWhitespace();
+            if (pos == length)
+                return false;
+            if (data[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (data[pos] == ']') {
+                ++pos;
+                break;
+            }
+            return false;
+        }
+
+        Token end;
+        end.type = Token::ARRAY_END;
+        end.hasEscapes = false;
+        end.start = pos - 1;
+        end.end = pos;
+        end.match = beginIndex;
+        tape[beginIndex].match = tape.size();
+        tape.push_back(end);
+
+        return true;
+    }
+
+    bool tokenizeValue(int depth)
+    {
+        if (depth > MAX_NESTING_DEPTH)
+            return false;
+
+        skipWhitespace();
+        if (pos == length)
+            return false;
+
+        char c = data[pos];
+        switch (c) {
+        case '{':
+            return tokenizeObject(depth);
+        case '[':
+            return tokenizeArray(depth);
+        case '"': {
+            Token token;
+            if (!tokenizeString(token))
+                return false;
+            token.match = 0;
+            tape.push_back(token);
+            return true;
+        }
+        case 't':
+            return tokenizeLiteral("true", Token::BOOL_TRUE);
+        case 'f':
+            return tokenizeLiteral("false", Token::BOOL_FALSE);
+        case 'n':
+            return tokenizeLiteral("null", Token::NULL_VALUE);
+        default:
+            if (c == '-' || isdigit(c)) {
+                Token token;
+                if (!tokenizeNumber(token))
+                    return false;
+                token.match = 0;
+                tape.push_back(token);
+                return true;
+            }
+            // NaN, Infinity, or garbage: let the streaming parser
+            // decide what to make of it
+            return false;
+        }
+    }
+
+    /// Tokenize the whole document: one value, nothing but whitespace after
+    bool tokenizeDocument()
+    {
+        if (!tokenizeValue(0))
+            return false;
+        skipWhitespace();
+        return pos == length;
+    }
+};
+
+inline int hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/// Is a number token written without a fraction or exponent?
+inline bool isIntegralToken(const char * data, const Token & token)
+{
+    for (uint32_t i = token.start;  i < token.end;  ++i) {
+        char c = data[i];
+        if (c == '.' || c == 'e' || c == 'E')
+            return false;
+    }
+    return true;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* SIMD JSON PARSING CONTEXT                                                 */
+/*****************************************************************************/
+
+SimdJsonParsingContext::
+SimdJsonParsingContext()
+    : lineNumber(0), data(nullptr), length(0), position(0)
+{
+}
+
+SimdJsonParsingContext::
+~SimdJsonParsingContext()
+{
+}
+
+bool
+SimdJsonParsingContext::
+init(const std::string & filename,
+     const char * data, size_t length,
+     int64_t lineNumber)
+{
+    this->filename = filename;
+    this->lineNumber = lineNumber;
+    this->data = data;
+    this->length = length;
+    this->position = 0;
+
+    // A previous parse that threw mid-document may have left path
+    // entries behind
+    while (pathLength() > 0)
+        popPath();
+
+    tape.clear();
+
+    if (length > (size_t)std::numeric_limits<uint32_t>::max())
+        return false;  // token offsets are 32 bit
+
+    Tokenizer tokenizer(data, length, tape);
+    if (!tokenizer.tokenizeDocument()) {
+        tape.clear();
+        return false;
+    }
+
+    return true;
+}
+
+const SimdJsonParsingContext::Token &
+SimdJsonParsingContext::
+current() const
+{
+    if (position >= tape.size())
+        const_cast<SimdJsonParsingContext *>(this)
+            ->exception("no more input");
+    return tape[position];
+}
+
+size_t
+SimdJsonParsingContext::
+endOfValue(size_t tokenIndex) const
+{
+    const Token & token = tape[tokenIndex];
+    if (token.type == Token::OBJECT_BEGIN
+        || token.type == Token::ARRAY_BEGIN)
+        return token.match + 1;
+    return tokenIndex + 1;
+}
+
+void
+SimdJsonParsingContext::
+exception(const std::string & message)
+{
+    throw ML::Exception("%s:%lld: at %s: %s",
+                        filename.c_str(), (long long)lineNumber,
+                        printPath().c_str(), message.c_str());
+}
+
+std::string
+SimdJsonParsingContext::
+getContext() const
+{
+    return filename + ":" + std::to_string(lineNumber)
+        + " at " + printPath();
+}
+
+long long
+SimdJsonParsingContext::
+getLongLong(const Token & token) const
+{
+    char buffer[64];
+    size_t len = token.end - token.start;
+    if (len >= sizeof(buffer)
+        || !isIntegralToken(data, token))
+        const_cast<SimdJsonParsingContext *>(this)
+            ->exception("expected integer");
+
+    memcpy(buffer, data + token.start, len);
+    buffer[len] = 0;
+
+    errno = 0;
+    char * endPtr = nullptr;
+    long long result = strtoll(buffer, &endPtr, 10);
+    if (endPtr != buffer + len || errno == ERANGE)
+        const_cast<SimdJsonParsingContext *>(this)
+            ->exception("expected integer");
+    return result;
+}
+
+unsigned long long
+SimdJsonParsingContext::
+getUnsignedLongLong(const Token & token) const
+{
+    char buffer[64];
+    size_t len = token.end - token.start;
+    if (len >= sizeof(buffer)
+        || len == 0
+        || data[token.start] == '-'
+        || !isIntegralToken(data, token))
+        const_cast<SimdJsonParsingContext *>(this)
+            ->exception("expected unsigned integer");
+
+    memcpy(buffer, data + token.start, len);
+    buffer[len] = 0;
+
+    errno = 0;
+    char * endPtr = nullptr;
+    unsigned long long result = strtoull(buffer, &endPtr, 10);
+    if (endPtr != buffer + len || errno == ERANGE)
+        const_cast<SimdJsonParsingContext *>(this)
+            ->exception("expected unsigned integer");
+    return result;
+}
+
+double
+SimdJsonParsingContext::
+getDouble(const Token & token) const
+{
+    char buffer[64];
+    size_t len = token.end - token.start;
+
+    std::string heapBuffer;
+    const char * start;
+    if (len < sizeof(buffer)) {
+        memcpy(buffer, data + token.start, len);
+        buffer[len] = 0;
+        start = buffer;
+    }
+    else {
+        heapBuffer.assign(data + token.start, len);
+        start = heapBuffer.c_str();
+    }
+
+    errno = 0;
+    char * endPtr = nullptr;
+    double result = strtod(start, &endPtr);
+    if (endPtr != start + len)
+        const_cast<SimdJsonParsingContext *>(this)
+            ->exception("expected number");
+    return result;
+}
+
+std::string
+SimdJsonParsingContext::
+getRawString(const Token & token) const
+{
+    if (!token.hasEscapes)
+        return std::string(data + token.start, data + token.end);
+
+    std::string result;
+    result.reserve(token.end - token.start);
+
+    for (uint32_t i = token.start;  i < token.end;  /* no inc */) {
+        int c = (unsigned char)data[i++];
+
+        if (c > 127) {
+            // UTF-8 sequence byte; copied through verbatim, like the
+            // streaming parser
+            result += (char)c;
+            continue;
+        }
+
+        if (c == '\\') {
+            if (i == token.end)
+                const_cast<SimdJsonParsingContext *>(this)
+                    ->exception("invalid escaped char");
+            c = data[i++];
+            switch (c) {
+            case 't': c = '\t';  break;
+            case 'n': c = '\n';  break;
+            case 'r': c = '\r';  break;
+            case 'f': c = '\f';  break;
+            case 'b': c = '\b';  break;
+            case '/': c = '/';   break;
+            case '\\':c = '\\';  break;
+            case '"': c = '"';   break;
+            case 'u': {
+                if (i + 4 > token.end)
+                    const_cast<SimdJsonParsingContext *>(this)
+                        ->exception("invalid unicode escape");
+                int code = 0;
+                for (int j = 0;  j < 4;  ++j) {
+                    int digit = hexDigitValue(data[i++]);
+                    if (digit == -1)
+                        const_cast<SimdJsonParsingContext *>(this)
+                            ->exception("invalid unicode escape");
+                    code = code * 16 + digit;
+                }
+                c = code;
+                break;
+            }
+            default:
+                const_cast<SimdJsonParsingContext *>(this)
+                    ->exception("invalid escaped char");
+            }
+        }
+
+        if (c < ' ' || c >= 127) {
+            char buf[8];
+            char * p = buf;
+            p = utf8::append(c, p);
+            result.append(buf, p);
+        }
+        else result += (char)c;
+    }
+
+    return result;
+}
+
+int
+SimdJsonParsingContext::
+expectInt()
+{
+    long long result = getLongLong(current());
+    if (result < INT_MIN || result > INT_MAX)
+        exception("integer out of range");
+    ++position;
+    return result;
+}
+
+unsigned int
+SimdJsonParsingContext::
+expectUnsignedInt()
+{
+    unsigned long long result = getUnsignedLongLong(current());
+    if (result > UINT_MAX)
+        exception("integer out of range");
+    ++position;
+    return result;
+}
+
+long
+SimdJsonParsingContext::
+expectLong()
+{
+    long long result = getLongLong(current());
+    if (result < LONG_MIN || result > LONG_MAX)
+        exception("integer out of range");
+    ++position;
+    return result;
+}
+
+unsigned long
+SimdJsonParsingContext::
+expectUnsignedLong()
+{
+    unsigned long long result = getUnsignedLongLong(current());
+    if (result > ULONG_MAX)
+        exception("integer out of range");
+    ++position;
+    return result;
+}
+
+long long
+SimdJsonParsingContext::
+expectLongLong()
+{
+    long long result = getLongLong(current());
+    ++position;
+    return result;
+}
+
+unsigned long long
+SimdJsonParsingContext::
+expectUnsignedLongLong()
+{
+    unsigned long long result = getUnsignedLongLong(current());
+    ++position;
+    return result;
+}
+
+float
+SimdJsonParsingContext::
+expectFloat()
+{
+    return expectDouble();
+}
+
+double
+SimdJsonParsingContext::
+expectDouble()
+{
+    const Token & token = current();
+    if (token.type != Token::NUMBER)
+        exception("expected number");
+    double result = getDouble(token);
+    ++position;
+    return result;
+}
+
+bool
+SimdJsonParsingContext::
+expectBool()
+{
+    const Token & token = current();
+    if (token.type == Token::BOOL_TRUE) {
+        ++position;
+        return true;
+    }
+    if (token.type == Token::BOOL_FALSE) {
+        ++position;
+        return false;
+    }
+    exception("expected bool");
+}
+
+bool
+SimdJsonParsingContext::
+matchUnsignedLongLong(unsigned long long & val)
+{
+    if (!isUnsigned())
+        return false;
+    val = expectUnsignedLongLong();
+    return true;
+}
+
+bool
+SimdJsonParsingContext::
+matchLongLong(long long & val)
+{
+    if (!isInt())
+        return false;
+    val = expectLongLong();
+    return true;
+}
+
+bool
+SimdJsonParsingContext::
+matchDouble(double & val)
+{
+    if (!isNumber())
+        return false;
+    val = expectDouble();
+    return true;
+}
+
+std::string
+SimdJsonParsingContext::
+expectStringAscii()
+{
+    const Token & token = current();
+    if (token.type != Token::STRING)
+        exception("expected string");
+    std::string result = getRawString(token);
+    for (char c: result) {
+        if (c & 0x80)
+            exception("non-ASCII character in ASCII string");
+    }
+    ++position;
+    return result;
+}
+
+ssize_t
+SimdJsonParsingContext::
+expectStringAscii(char * value, size_t maxLen)
+{
+    std::string result = expectStringAscii();
+    if (result.size() + 1 > maxLen) {
+        --position;  // not consumed
+        return -1;
+    }
+    memcpy(value, result.c_str(), result.size() + 1);
+    return result.size();
+}
+
+Utf8String
+SimdJsonParsingContext::
+expectStringUtf8()
+{
+    const Token & token = current();
+    if (token.type != Token::STRING)
+        exception("expected string");
+    // The Utf8String constructor validates, exactly like the streaming
+    // parser's return path
+    Utf8String result(getRawString(token));
+    ++position;
+    return result;
+}
+
+ssize_t
+SimdJsonParsingContext::
+expectStringUtf8(char * value, size_t maxLen)
+{
+    const Token & token = current();
+    if (token.type != Token::STRING)
+        exception("expected string");
+    std::string result = getRawString(token);
+    if (result.size() + 1 > maxLen)
+        return -1;
+    memcpy(value, result.c_str(), result.size() + 1);
+    ++position;
+    return result.size();
+}
+
+Json::Value
+SimdJsonParsingContext::
+jsonAt(size_t & tokenIndex) const
+{
+    const Token & token = tape[tokenIndex];
+
+    switch (token.type) {
+    case Token::OBJECT_BEGIN: {
+        Json::Value result(Json::objectValue);
+        size_t endIndex = token.match;
+        size_t i = tokenIndex + 1;
+        while (i < endIndex) {
+            std::string key = getRawString(tape[i]);
+            ++i;
+            result[key] = jsonAt(i);
+        }
+        tokenIndex = endIndex + 1;
+        return result;
+    }
+    case Token::ARRAY_BEGIN: {
+        Json::Value result(Json::arrayValue);
+        size_t endIndex = token.match;
+        size_t i = tokenIndex + 1;
+        int elementNum = 0;
+        while (i < endIndex)
+            result[elementNum++] = jsonAt(i);
+        tokenIndex = endIndex + 1;
+        return result;
+    }
+    case Token::STRING: {
+        Json::Value result = Utf8String(getRawString(token));
+        ++tokenIndex;
+        return result;
+    }
+    case Token::NUMBER: {
+        Json::Value result;
+        if (isIntegralToken(data, token)) {
+            if (data[token.start] == '-')
+                result = (Json::Value::Int)getLongLong(token);
+            else
+                result = (Json::Value::UInt)getUnsignedLongLong(token);
+        }
+        else result = getDouble(token);
+        ++tokenIndex;
+        return result;
+    }
+    case Token::BOOL_TRUE:
+        ++tokenIndex;
+        return Json::Value(true);
+    case Token::BOOL_FALSE:
+        ++tokenIndex;
+        return Json::Value(false);
+    case Token::NULL_VALUE:
+        ++tokenIndex;
+        return Json::Value();
+    default:
+        const_cast<SimdJsonParsingContext *>(this)
+            ->exception("expected JSON value");
+    }
+}
+
+Json::Value
+SimdJsonParsingContext::
+expectJson()
+{
+    current();  // throws if past the end
+    return jsonAt(position);
+}
+
+void
+SimdJsonParsingContext::
+expectNull()
+{
+    if (current().type != Token::NULL_VALUE)
+        exception("expected null");
+    ++position;
+}
+
+bool
+SimdJsonParsingContext::
+isObject() const
+{
+    return current().type == Token::OBJECT_BEGIN;
+}
+
+bool
+SimdJsonParsingContext::
+isString() const
+{
+    return current().type == Token::STRING;
+}
+
+bool
+SimdJsonParsingContext::
+isArray() const
+{
+    return current().type == Token::ARRAY_BEGIN;
+}
+
+bool
+SimdJsonParsingContext::
+isBool() const
+{
+    uint8_t type = current().type;
+    return type == Token::BOOL_TRUE || type == Token::BOOL_FALSE;
+}
+
+bool
+SimdJsonParsingContext::
+isNumber() const
+{
+    return current().type == Token::NUMBER;
+}
+
+bool
+SimdJsonParsingContext::
+isNull() const
+{
+    return current().type == Token::NULL_VALUE;
+}
+
+bool
+SimdJsonParsingContext::
+isInt() const
+{
+    const Token & token = current();
+    if (token.type != Token::NUMBER
+        || !isIntegralToken(data, token)
+        || token.end - token.start >= 64)
+        return false;
+
+    // Like the streaming parser, overflowing values are doubles, not ints
+    char buffer[64];
+    size_t len = token.end - token.start;
+    memcpy(buffer, data + token.start, len);
+    buffer[len] = 0;
+
+    errno = 0;
+    char * endPtr = nullptr;
+    strtoll(buffer, &endPtr, 10);
+    return endPtr == buffer + len && errno != ERANGE;
+}
+
+bool
+SimdJsonParsingContext::
+isUnsigned() const
+{
+    const Token & token = current();
+    if (token.type != Token::NUMBER
+        || data[token.start] == '-'
+        || !isIntegralToken(data, token)
+        || token.end - token.start >= 64)
+        return false;
+
+    char buffer[64];
+    size_t len = token.end - token.start;
+    memcpy(buffer, data + token.start, len);
+    buffer[len] = 0;
+
+    errno = 0;
+    char * endPtr = nullptr;
+    strtoull(buffer, &endPtr, 10);
+    return endPtr == buffer + len && errno != ERANGE;
+}
+
+void
+SimdJsonParsingContext::
+skip()
+{
+    current();  // throws if past the end
+    position = endOfValue(position);
+}
+
+std::string
+SimdJsonParsingContext::
+printCurrent()
+{
+    size_t savedPosition = position;
+    Json::Value value = jsonAt(savedPosition);
+    return value.toStringNoNewLine();
+}
+
+void
+SimdJsonParsingContext::
+forEachMember(const std::function<void ()> & fn)
+{
+    const Token & token = current();
+
+    // The streaming parser treats null as an empty object here
+    if (token.type == Token::NULL_VALUE) {
+        ++position;
+        return;
+    }
+
+    if (token.type != Token::OBJECT_BEGIN)
+        exception("expected object");
+
+    // Takes care of popping the path even if fn throws.  Out of line
+    // here for clang 3.4.
+    struct PathHolder {
+        PathHolder(SimdJsonParsingContext * context,
+                   const char * memberName,
+                   int memberNum)
+            : context(context)
+        {
+            context->pushPath(memberName, memberNum);
+        }
+
+        ~PathHolder()
+        {
+            context->popPath();
+        }
+
+        SimdJsonParsingContext * const context;
+    };
+
+    size_t endIndex = token.match;
+    size_t i = position + 1;
+    int memberNum = 0;
+
+    while (i < endIndex) {
+        // Key string must stay alive for the duration of fn, since the
+        // path entry doesn't copy it
+        std::string key = getRawString(tape[i]);
+
+        size_t next = endOfValue(i + 1);
+        position = i + 1;
+
+        {
+            PathHolder holder(this, key.c_str(), memberNum++);
+            fn();
+        }
+
+        i = next;
+    }
+
+    position = endIndex + 1;
+}
+
+void
+SimdJsonParsingContext::
+forEachElement(const std::function<void ()> & fn)
+{
+    const Token & token = current();
+
+    // The streaming parser treats null as an empty array here
+    if (token.type == Token::NULL_VALUE) {
+        ++position;
+        return;
+    }
+
+    if (token.type != Token::ARRAY_BEGIN)
+        exception("expected array");
+
+    size_t endIndex = token.match;
+    size_t i = position + 1;
+    int elementNum = 0;
+    bool first = true;
+
+    try {
+        while (i < endIndex) {
+            if (first)
+                pushPath(elementNum);
+            else replacePath(elementNum);
+            first = false;
+
+            size_t next = endOfValue(i);
+            position = i;
+            fn();
+            i = next;
+            ++elementNum;
+        }
+    } catch (...) {
+        if (!first)
+            popPath();
+        throw;
+    }
+
+    if (!first)
+        popPath();
+
+    position = endIndex + 1;
+}
+
+} // namespace Datacratic
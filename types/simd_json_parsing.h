@@ -0,0 +1,118 @@
+/* simd_json_parsing.h                                             -*- C++ -*-
+   Jeremy Barnes, 29 August 2016
+
+   This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+   Vectorized two-stage JSON parser for complete, in-memory documents.
+*/
+
+#pragma once
+
+#include "json_parsing.h"
+#include "mldb/compiler/compiler.h"
+#include <string>
+#include <vector>
+
+namespace Datacratic {
+
+
+/*****************************************************************************/
+/* SIMD JSON PARSING CONTEXT                                                 */
+/*****************************************************************************/
+
+/** JSON parsing context over a complete document held in memory, such as
+    one line of a newline-delimited JSON file.
+
+    Rather than parsing character by character, it first tokenizes the
+    whole document into a flat tape of structural tokens using SSE2 to
+    scan strings sixteen bytes at a time, and then serves the
+    JsonParsingContext callbacks directly off the tape.  This avoids
+    nearly all of the per-character dispatch of the streaming parser,
+    which dominates the import of large newline-delimited JSON files.
+
+    The tokenizer is deliberately conservative: init() returns false for
+    anything it doesn't fully understand (malformed JSON, pathological
+    nesting, non-standard number forms), in which case the caller should
+    re-parse the document with StreamingJsonParsingContext.  Since the
+    tokenizer also validates the document structure, the callbacks
+    themselves only fail on type mismatches and numeric overflow.
+
+    The object is designed to be reused (eg, one instance per thread of
+    an import): init() clears any previous state but keeps the tape's
+    allocation.  The parsed memory must outlive the parse; nothing is
+    copied.
+*/
+
+struct SimdJsonParsingContext: public JsonParsingContext {
+
+    SimdJsonParsingContext();
+    ~SimdJsonParsingContext();
+
+    /** Tokenize the given complete JSON document and position the
+        context at its root value.  Returns false (leaving the context
+        unusable) if the document can't be fully tokenized; the caller
+        should then fall back to a streaming parse.  The filename and
+        line number are used only for error messages.
+    */
+    bool init(const std::string & filename,
+              const char * data, size_t length,
+              int64_t lineNumber = 1);
+
+    virtual void exception(const std::string & message) JML_NORETURN;
+    virtual std::string getContext() const;
+
+    virtual int expectInt();
+    virtual unsigned int expectUnsignedInt();
+    virtual long expectLong();
+    virtual unsigned long expectUnsignedLong();
+    virtual long long expectLongLong();
+    virtual unsigned long long expectUnsignedLongLong();
+    virtual float expectFloat();
+    virtual double expectDouble();
+    virtual bool expectBool();
+    virtual bool matchUnsignedLongLong(unsigned long long & val);
+    virtual bool matchLongLong(long long & val);
+    virtual bool matchDouble(double & val);
+    virtual std::string expectStringAscii();
+    virtual ssize_t expectStringAscii(char * value, size_t maxLen);
+    virtual Utf8String expectStringUtf8();
+    virtual ssize_t expectStringUtf8(char * value, size_t maxLen);
+    virtual Json::Value expectJson();
+    virtual void expectNull();
+
+    virtual bool isObject() const;
+    virtual bool isString() const;
+    virtual bool isArray() const;
+    virtual bool isBool() const;
+    virtual bool isNumber() const;
+    virtual bool isNull() const;
+    virtual bool isInt() const;
+    virtual bool isUnsigned() const;
+
+    virtual void skip();
+    virtual std::string printCurrent();
+
+    virtual void forEachMember(const std::function<void ()> & fn);
+    virtual void forEachElement(const std::function<void ()> & fn);
+
+    /// One entry in the structural tape built by init()
+    struct Token;
+
+private:
+    const Token & current() const;
+    size_t endOfValue(size_t tokenIndex) const;
+    long long getLongLong(const Token & tok) const;
+    unsigned long long getUnsignedLongLong(const Token & tok) const;
+    double getDouble(const Token & tok) const;
+    std::string getRawString(const Token & tok) const;
+    Json::Value jsonAt(size_t & tokenIndex) const;
+
+    std::string filename;       ///< For error messages only
+    int64_t lineNumber;         ///< For error messages only
+    const char * data;          ///< Start of the document (not owned)
+    size_t length;              ///< Length of the document in bytes
+    std::vector<Token> tape;    ///< Structural tape; filled in by init()
+    size_t position;            ///< Index into tape of the current value
+};
+
+} // namespace Datacratic
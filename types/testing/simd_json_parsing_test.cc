@@ -0,0 +1,189 @@
+/* simd_json_parsing_test.cc
+   Jeremy Barnes, 29 August 2016
+
+   This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+   Test of the vectorized JSON parsing context against the streaming one.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "mldb/types/simd_json_parsing.h"
+#include "mldb/types/json_parsing.h"
+#include "mldb/ext/jsoncpp/json.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace Datacratic;
+
+using boost::unit_test::test_suite;
+
+/// Parse the document with both parsers via expectJson and check that
+/// they agree
+void testAgainstStreaming(const std::string & doc)
+{
+    SimdJsonParsingContext simdContext;
+    BOOST_REQUIRE(simdContext.init("test", doc.c_str(), doc.size()));
+
+    StreamingJsonParsingContext streamingContext
+        ("test", doc.c_str(), doc.size());
+
+    Json::Value simdValue = simdContext.expectJson();
+    Json::Value streamingValue = streamingContext.expectJson();
+
+    BOOST_CHECK_EQUAL(simdValue, streamingValue);
+}
+
+/// Documents the tokenizer should refuse, leaving them to the streaming
+/// parser
+void testRejected(const std::string & doc)
+{
+    SimdJsonParsingContext context;
+    BOOST_CHECK(!context.init("test", doc.c_str(), doc.size()));
+}
+
+BOOST_AUTO_TEST_CASE( test_scalars )
+{
+    testAgainstStreaming("null");
+    testAgainstStreaming("true");
+    testAgainstStreaming("false");
+    testAgainstStreaming("0");
+    testAgainstStreaming("-1");
+    testAgainstStreaming("12345678901234567890");
+    testAgainstStreaming("1.25");
+    testAgainstStreaming("-1.25e10");
+    testAgainstStreaming("\"hello\"");
+    testAgainstStreaming("\"\"");
+}
+
+BOOST_AUTO_TEST_CASE( test_strings )
+{
+    testAgainstStreaming("\"tab\\there\"");
+    testAgainstStreaming("\"quote\\\"here\"");
+    testAgainstStreaming("\"backslash\\\\here\"");
+    testAgainstStreaming("\"unicode\\u00e9\"");
+    testAgainstStreaming("\"\\u0001\"");
+    testAgainstStreaming("\"caf\xc3\xa9\"");  // raw UTF-8
+}
+
+BOOST_AUTO_TEST_CASE( test_structures )
+{
+    testAgainstStreaming("{}");
+    testAgainstStreaming("[]");
+    testAgainstStreaming("{\"a\": 1, \"b\": [1, 2, 3]}");
+    testAgainstStreaming("[{\"a\": {\"b\": null}}, [[]], \"x\"]");
+    testAgainstStreaming("  { \"spaced\" :\t[ 1 ,2 ] }  ");
+
+    // Long enough to exercise the 16 byte at a time string scan
+    testAgainstStreaming("{\"key\": \"" + std::string(1000, 'x') + "\"}");
+}
+
+BOOST_AUTO_TEST_CASE( test_rejected )
+{
+    testRejected("");
+    testRejected("   ");
+    testRejected("{");
+    testRejected("{\"a\": 1");
+    testRejected("{\"a\" 1}");
+    testRejected("[1, 2");
+    testRejected("\"unterminated");
+    testRejected("{\"a\": 1} trailing");
+    testRejected("NaN");
+    testRejected("Infinity");
+    testRejected("-");
+}
+
+BOOST_AUTO_TEST_CASE( test_type_predicates )
+{
+    std::string doc = "{\"i\": 123, \"d\": 1.5, \"s\": \"x\", \"n\": null, "
+                      "\"b\": true, \"a\": [1], \"o\": {}, \"neg\": -1, "
+                      "\"big\": 99999999999999999999999999}";
+
+    SimdJsonParsingContext context;
+    BOOST_REQUIRE(context.init("test", doc.c_str(), doc.size()));
+
+    BOOST_REQUIRE(context.isObject());
+
+    auto onMember = [&] ()
+        {
+            std::string name = context.fieldName();
+            if (name == "i") {
+                BOOST_CHECK(context.isInt());
+                BOOST_CHECK(context.isUnsigned());
+                BOOST_CHECK(context.isNumber());
+                BOOST_CHECK_EQUAL(context.expectLongLong(), 123);
+            }
+            else if (name == "d") {
+                BOOST_CHECK(!context.isInt());
+                BOOST_CHECK(context.isNumber());
+                BOOST_CHECK_EQUAL(context.expectDouble(), 1.5);
+            }
+            else if (name == "s") {
+                BOOST_CHECK(context.isString());
+                BOOST_CHECK_EQUAL(context.expectStringUtf8(), "x");
+            }
+            else if (name == "n") {
+                BOOST_CHECK(context.isNull());
+                context.expectNull();
+            }
+            else if (name == "b") {
+                BOOST_CHECK(context.isBool());
+                BOOST_CHECK_EQUAL(context.expectBool(), true);
+            }
+            else if (name == "a") {
+                BOOST_CHECK(context.isArray());
+                context.skip();
+            }
+            else if (name == "o") {
+                BOOST_CHECK(context.isObject());
+                context.skip();
+            }
+            else if (name == "neg") {
+                BOOST_CHECK(context.isInt());
+                BOOST_CHECK(!context.isUnsigned());
+                BOOST_CHECK_EQUAL(context.expectLongLong(), -1);
+            }
+            else if (name == "big") {
+                // Too big for an integer: becomes a double, like the
+                // streaming parser
+                BOOST_CHECK(!context.isInt());
+                BOOST_CHECK(!context.isUnsigned());
+                BOOST_CHECK(context.isNumber());
+                context.skip();
+            }
+            else BOOST_CHECK(false);
+        };
+
+    context.forEachMember(onMember);
+}
+
+BOOST_AUTO_TEST_CASE( test_paths )
+{
+    std::string doc = "{\"outer\": {\"inner\": [7]}}";
+
+    SimdJsonParsingContext context;
+    BOOST_REQUIRE(context.init("test", doc.c_str(), doc.size()));
+
+    std::string deepestPath;
+
+    auto onElement = [&] ()
+        {
+            deepestPath = context.printPath();
+            context.skip();
+        };
+
+    auto onInner = [&] ()
+        {
+            context.forEachElement(onElement);
+        };
+
+    auto onOuter = [&] ()
+        {
+            context.forEachMember(onInner);
+        };
+
+    context.forEachMember(onOuter);
+
+    BOOST_CHECK_EQUAL(deepestPath, ".outer.inner[0]");
+}
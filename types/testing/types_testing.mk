@@ -10,5 +10,6 @@ $(eval $(call test,periodic_utils_test,types,boost))
 $(eval $(call program,id_profile,types))
 $(eval $(call test,reader_test,jsoncpp arch types,boost))
 $(eval $(call test,json_parsing_test,types arch,boost))
+$(eval $(call test,simd_json_parsing_test,types arch,boost))
 $(eval $(call test,any_test,any types arch,boost))
 $(eval $(call test,decode_uri_test,types,boost))
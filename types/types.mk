@@ -10,6 +10,7 @@ LIBVALUE_DESCRIPTION_SOURCES := \
 	value_description.cc \
 	basic_value_descriptions.cc \
 	json_parsing.cc \
+	simd_json_parsing.cc \
 	json_printing.cc \
 	dtoa.c \
 	meta_value_description.cc \
@@ -496,7 +496,9 @@ printJson(const void * input, JsonPrintingContext & context) const
         auto mbr = addOffset(input, fd.offset);
         if (fd.description->isDefault(mbr))
             continue;
-        context.startMember(it->first);
+        // Use the length-aware overload; the Utf8String one would
+        // construct a fresh string per field per object printed.
+        context.startMember(fd.fieldName.c_str(), fd.fieldName.size());
         fd.description->printJson(mbr, context);
     }
         
@@ -33,6 +33,8 @@
 #include <unordered_map>
 #include "ext/lzma/lzma.h"
 #include "lz4_filter.h"
+#include "zstd_filter.h"
+#include "zstd_blocked.h"
 #include "fs_utils.h"
 
 
@@ -160,7 +162,8 @@ void addCompression(streambuf & buf,
                     boost::iostreams::filtering_ostream & stream,
                     const std::string & resource,
                     const std::string & compression,
-                    int compressionLevel)
+                    int compressionLevel,
+                    int compressionThreads = 1)
 {
     using namespace boost::iostreams;
 
@@ -191,7 +194,22 @@ void addCompression(streambuf & buf,
     else if (compression == "lz4"
         || (compression == ""
             && (ends_with(resource, ".lz4") || ends_with(resource, ".lz4~")))) {
-        stream.push(lz4_compressor(compressionLevel));
+        if (compressionThreads > 1)
+            stream.push(lz4_pipelined_compressor(compressionLevel,
+                                                 7 /* blockSizeId */,
+                                                 compressionThreads));
+        else stream.push(lz4_compressor(compressionLevel));
+    }
+    else if (compression == "zst" || compression == "zstd"
+        || (compression == ""
+            && (ends_with(resource, ".zst") || ends_with(resource, ".zst~")
+                || ends_with(resource, ".zstd")
+                || ends_with(resource, ".zstd~")))) {
+        stream.push(zstd_compressor(compressionLevel));
+    }
+    else if (compression == "zsb"
+        || (compression == "" && isZstdBlocked(resource))) {
+        stream.push(zstd_blocked_compressor(compressionLevel));
     }
     else if (compression != "" && compression != "none")
         throw ML::Exception("unknown filter compression " + compression);
@@ -212,8 +230,14 @@ void addCompression(streambuf & buf,
     it = options.find("compressionLevel");
     if (it != options.end())
         compressionLevel = boost::lexical_cast<int>(it->second);
-    
-    addCompression(buf, stream, resource, compression, compressionLevel);
+
+    int compressionThreads = 1;
+    it = options.find("compressionThreads");
+    if (it != options.end())
+        compressionThreads = boost::lexical_cast<int>(it->second);
+
+    addCompression(buf, stream, resource, compression, compressionLevel,
+                   compressionThreads);
 }
 
 
@@ -624,10 +648,22 @@ openFromStreambuf(std::streambuf * buf,
                      && (ends_with(resource, ".lz4")
                          || ends_with(resource, ".lz4~"))));
 
+    bool zstd = (compression == "zst" || compression == "zstd"
+                 || (compression == ""
+                     && (ends_with(resource, ".zst")
+                         || ends_with(resource, ".zst~")
+                         || ends_with(resource, ".zstd")
+                         || ends_with(resource, ".zstd~"))));
+
+    bool zsb = (compression == "zsb"
+                 || (compression == "" && isZstdBlocked(resource)));
+
     if (gzip) new_stream->push(gzip_decompressor());
     if (bzip2) new_stream->push(bzip2_decompressor());
     if (lzma) new_stream->push(lzma_decompressor());
     if (lz4) new_stream->push(lz4_decompressor());
+    if (zstd) new_stream->push(zstd_decompressor());
+    if (zsb) new_stream->push(zstd_blocked_decompressor());
 
     if (!new_stream->empty()) {
         new_stream->push(*buf);
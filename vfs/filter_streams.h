@@ -145,6 +145,9 @@ public:
 
         mode = comma separated list of out,append,create
         compression = string (gz, bz2, xz, ...)
+        compressionLevel = integer, meaning depends upon the codec
+        compressionThreads = integer; > 1 compresses blocks on a worker
+                             pool (currently lz4 only)
         resource = string to be used in error messages
     */
     void open(const std::string & uri,
@@ -114,6 +114,9 @@ struct HttpStreamingDownloadSource {
             stop();
         }
 
+        /// One proxy per stream is cheap: its curl handle comes from
+        /// HttpRestProxy's shared keep-alive pool, so fetching many small
+        /// objects from the same host reuses the same connections.
         HttpRestProxy proxy;
         std::string urlStr;
 
@@ -13,13 +13,19 @@
 
 #pragma once
 
+#include "mldb/arch/buffer_pool.h"
 #include "mldb/ext/xxhash/xxhash.h"
 #include "mldb/ext/lz4/lz4.h"
 #include "mldb/ext/lz4/lz4hc.h"
 #include "mldb/base/exc_assert.h"
 
 #include <boost/iostreams/concepts.hpp>
+#include <condition_variable>
+#include <deque>
+#include <future>
 #include <ios>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <cstring>
 #include "mldb/jml/utils/guard.h"
@@ -227,9 +233,10 @@ private:
 
         size_t bytesToAlloc = LZ4_compressBound(pos);
         ExcAssert(bytesToAlloc);
-        char* compressed = new char[bytesToAlloc];
-        ML::Call_Guard guard([&] () { delete[] compressed; });
-        
+        std::shared_ptr<char> compressedBuf
+            = ML::get_pooled_buffer(bytesToAlloc);
+        char* compressed = compressedBuf.get();
+
         auto compressedSize = compressFn(buffer.data(), compressed, pos);
 
         auto writeChecksum = [&](const char* data, size_t n) {
@@ -264,6 +271,241 @@ private:
 };
 
 
+/******************************************************************************/
+/* LZ4 PIPELINED COMPRESSOR                                                   */
+/******************************************************************************/
+
+/** Same stream format as lz4_compressor, but full blocks are handed to a
+    small pool of worker threads and written out in submission order, so
+    that a producer (eg a csv export) isn't limited to one core's worth
+    of compression throughput.  Blocks are compressed independently, so
+    the output is byte for byte identical to the single threaded filter.
+
+    The state is shared between copies, since boost iostreams passes
+    filters by value and only ever uses the last copy.
+*/
+struct lz4_pipelined_compressor
+    : public boost::iostreams::multichar_output_filter
+{
+    lz4_pipelined_compressor(int level = 0, uint8_t blockSizeId = 7,
+                             int numThreads = 4)
+        : state(std::make_shared<State>(level, blockSizeId, numThreads))
+    {
+    }
+
+    template<typename Sink>
+    std::streamsize write(Sink& sink, const char* s, std::streamsize n)
+    {
+        State& st = *state;
+
+        if (st.writeHeader) {
+            st.head.write(sink);
+            st.writeHeader = false;
+        }
+
+        size_t toWrite = n;
+        while (toWrite > 0) {
+            size_t toCopy = std::min<size_t>(toWrite,
+                                             st.buffer.size() - st.pos);
+            std::memcpy(st.buffer.data() + st.pos, s, toCopy);
+
+            toWrite -= toCopy;
+            st.pos += toCopy;
+            s += toCopy;
+
+            if (st.pos == st.buffer.size()) submitBlock(sink);
+        }
+
+        // Write out whatever has finished compressing, without blocking
+        while (!st.inFlight.empty()
+               && (st.inFlight.front().wait_for(std::chrono::seconds(0))
+                   == std::future_status::ready))
+            writeFront(sink);
+
+        return n;
+    }
+
+    template<typename Sink>
+    void close(Sink& sink)
+    {
+        State& st = *state;
+
+        if (st.writeHeader) {
+            st.head.write(sink);
+            st.writeHeader = false;
+        }
+        if (st.pos) submitBlock(sink);
+
+        while (!st.inFlight.empty())
+            writeFront(sink);
+
+        const uint32_t eos = 0;
+        lz4::write(sink, &eos, sizeof(eos));
+    }
+
+private:
+
+    struct State {
+        State(int level, uint8_t blockSizeId, int numThreads)
+            : head(blockSizeId, true, true, false),
+              writeHeader(true), pos(0), shutdown(false)
+        {
+            buffer.resize(head.blockSize());
+            compressFn = level < 3 ? LZ4_compress : LZ4_compressHC;
+
+            if (numThreads < 1) numThreads = 1;
+            maxInFlight = numThreads * 2;
+            for (int i = 0;  i < numThreads;  ++i)
+                workers.emplace_back([this] () { this->runWorker(); });
+        }
+
+        ~State()
+        {
+            {
+                std::unique_lock<std::mutex> guard(queueLock);
+                shutdown = true;
+            }
+            queueCond.notify_all();
+            for (auto& w: workers) w.join();
+        }
+
+        std::future<std::vector<char> > enqueue(std::vector<char> block)
+        {
+            auto compressFn = this->compressFn;
+            bool blockChecksum = head.blockChecksum();
+            std::packaged_task<std::vector<char> ()> task
+                ([block = std::move(block), compressFn, blockChecksum]
+                 () mutable
+                 {
+                     return compressBlock(std::move(block), compressFn,
+                                          blockChecksum);
+                 });
+            auto result = task.get_future();
+            {
+                std::unique_lock<std::mutex> guard(queueLock);
+                jobs.emplace_back(std::move(task));
+            }
+            queueCond.notify_one();
+            return result;
+        }
+
+        void runWorker()
+        {
+            for (;;) {
+                std::packaged_task<std::vector<char> ()> job;
+                {
+                    std::unique_lock<std::mutex> guard(queueLock);
+                    queueCond.wait(guard, [this] ()
+                                   {
+                                       return shutdown || !jobs.empty();
+                                   });
+                    if (jobs.empty()) return;  // shut down, queue drained
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        lz4::Header head;
+        int (*compressFn)(const char*, char*, int);
+
+        bool writeHeader;
+        std::vector<char> buffer;
+        size_t pos;
+
+        /// Framed blocks being compressed, in stream order
+        std::deque<std::future<std::vector<char> > > inFlight;
+        size_t maxInFlight;
+
+        std::mutex queueLock;
+        std::condition_variable queueCond;
+        std::deque<std::packaged_task<std::vector<char> ()> > jobs;
+        bool shutdown;
+        std::vector<std::thread> workers;
+    };
+
+    /// Compress one block and frame it (size word, payload, checksum)
+    /// exactly as lz4_compressor::flush() writes it
+    static std::vector<char>
+    compressBlock(std::vector<char> block,
+                  int (*compressFn)(const char*, char*, int),
+                  bool blockChecksum)
+    {
+        size_t bytesToAlloc = LZ4_compressBound(block.size());
+        ExcAssert(bytesToAlloc);
+        std::shared_ptr<char> compressed
+            = ML::get_pooled_buffer(bytesToAlloc);
+
+        int compressedSize
+            = compressFn(block.data(), compressed.get(), block.size());
+
+        std::vector<char> framed;
+        framed.reserve(sizeof(uint32_t) * 2
+                       + (compressedSize > 0 ? compressedSize : block.size()));
+
+        auto append = [&] (const void* data, size_t n)
+            {
+                framed.insert(framed.end(),
+                              (const char*)data, (const char*)data + n);
+            };
+
+        if (compressedSize > 0) {
+            uint32_t word = compressedSize;
+            append(&word, sizeof(word));
+            append(compressed.get(), compressedSize);
+            if (blockChecksum) {
+                uint32_t checksum = XXH32(compressed.get(), compressedSize,
+                                          lz4::ChecksumSeed);
+                append(&checksum, sizeof(checksum));
+            }
+        }
+        else {
+            uint32_t word = block.size() | lz4::NotCompressedMask;
+            append(&word, sizeof(word));
+            append(block.data(), block.size());
+            if (blockChecksum) {
+                uint32_t checksum = XXH32(block.data(), block.size(),
+                                          lz4::ChecksumSeed);
+                append(&checksum, sizeof(checksum));
+            }
+        }
+
+        return framed;
+    }
+
+    template<typename Sink>
+    void submitBlock(Sink& sink)
+    {
+        State& st = *state;
+
+        // Backpressure: never more than maxInFlight blocks queued or
+        // being compressed at once
+        while (st.inFlight.size() >= st.maxInFlight)
+            writeFront(sink);
+
+        std::vector<char> block = std::move(st.buffer);
+        block.resize(st.pos);
+        st.buffer = std::vector<char>(st.head.blockSize());
+        st.pos = 0;
+
+        st.inFlight.emplace_back(st.enqueue(std::move(block)));
+    }
+
+    /// Write out the oldest in-flight block, waiting for it if needed
+    template<typename Sink>
+    void writeFront(Sink& sink)
+    {
+        State& st = *state;
+        std::vector<char> framed = st.inFlight.front().get();
+        st.inFlight.pop_front();
+        lz4::write(sink, framed.data(), framed.size());
+    }
+
+    std::shared_ptr<State> state;
+};
+
+
 /******************************************************************************/
 /* LZ4 DECOMPRESSOR                                                           */
 /******************************************************************************/
@@ -326,8 +568,9 @@ private:
         bool notCompressed = compressedSize & lz4::NotCompressedMask;
         compressedSize &= ~lz4::NotCompressedMask;
 
-        char* compressed = (char*) malloc(compressedSize);
-        ML::Call_Guard guard([=] () { free(compressed); });
+        std::shared_ptr<char> compressedBuf
+            = ML::get_pooled_buffer(compressedSize);
+        char* compressed = compressedBuf.get();
         lz4::read(src, compressed, compressedSize);
 
         if (head.blockChecksum()) {
@@ -224,7 +224,7 @@ BOOST_AUTO_TEST_CASE( test_empty_gzip )
     fs::create_directories("build/x86_64/tmp");
 
     string fileprefix("build/x86_64/tmp/empty.");
-    vector<string> exts = { "gz", "bz2", "xz", "lz4" };
+    vector<string> exts = { "gz", "bz2", "xz", "lz4", "zst" };
 
     for (const auto & ext: exts) {
         string filename = fileprefix + ext;
@@ -354,6 +354,117 @@ BOOST_AUTO_TEST_CASE( test_mem_scheme_out_gz )
 }
 #endif
 
+#if 1
+/* ensures that a zstd round trip through the filter stack restores the
+ * original text */
+BOOST_AUTO_TEST_CASE( test_mem_scheme_roundtrip_zst )
+{
+    Call_Guard fn([&]() {deleteAllMemStreamStrings();});
+
+    string text("");
+    {
+        string pattern("AbCdEfGh");
+        text.reserve(pattern.size() * 1000000);
+        for (int i = 0; i < 1000000; i++) {
+            text += pattern;
+        }
+    }
+
+    {
+        filter_ostream outS("mem://out_file.zst");
+        outS << text;
+    }
+
+    string compressed = getMemStreamString("out_file.zst");
+    BOOST_CHECK_NE(text, compressed);
+
+    string result;
+    filter_istream inS("mem://out_file.zst");
+    while (inS) {
+        char buf[16384];
+        inS.read(buf, 16384);
+        result.append(buf, inS.gcount());
+    }
+    BOOST_CHECK_EQUAL(text, result);
+}
+#endif
+
+#if 1
+/* ensures that a block-indexed zstd round trip through the filter stack
+ * restores the original text (8MB spans several 2MB blocks) */
+BOOST_AUTO_TEST_CASE( test_mem_scheme_roundtrip_zsb )
+{
+    Call_Guard fn([&]() {deleteAllMemStreamStrings();});
+
+    string text("");
+    {
+        string pattern("AbCdEfGh");
+        text.reserve(pattern.size() * 1000000);
+        for (int i = 0; i < 1000000; i++) {
+            text += pattern;
+        }
+    }
+
+    {
+        filter_ostream outS("mem://out_file.zsb");
+        outS << text;
+    }
+
+    string compressed = getMemStreamString("out_file.zsb");
+    BOOST_CHECK_NE(text, compressed);
+
+    string result;
+    filter_istream inS("mem://out_file.zsb");
+    while (inS) {
+        char buf[16384];
+        inS.read(buf, 16384);
+        result.append(buf, inS.gcount());
+    }
+    BOOST_CHECK_EQUAL(text, result);
+}
+#endif
+
+#if 1
+/* ensures that multi-threaded lz4 compression produces byte for byte the
+ * same stream as the single-threaded filter (several 4MB blocks) */
+BOOST_AUTO_TEST_CASE( test_mem_scheme_lz4_threaded )
+{
+    Call_Guard fn([&]() {deleteAllMemStreamStrings();});
+
+    string text("");
+    {
+        string pattern("AbCdEfGh");
+        text.reserve(pattern.size() * 2000000);
+        for (int i = 0; i < 2000000; i++) {
+            text += pattern;
+        }
+    }
+
+    {
+        filter_ostream outS("mem://out_file1.lz4");
+        outS << text;
+    }
+
+    {
+        map<string, string> options = { { "compressionThreads", "4" } };
+        filter_ostream outS("mem://out_file2.lz4", options);
+        outS << text;
+    }
+
+    BOOST_CHECK_EQUAL(getMemStreamString("out_file1.lz4"),
+                      getMemStreamString("out_file2.lz4"));
+
+    string result;
+    filter_istream inS("mem://out_file2.lz4");
+    while (inS) {
+        char buf[16384];
+        inS.read(buf, 16384);
+        result.append(buf, inS.gcount());
+    }
+    BOOST_CHECK_EQUAL(text, result);
+}
+#endif
+
 #if 1
 /* ensures that reading a 8M bytes text works well too */
 BOOST_AUTO_TEST_CASE( test_mem_scheme_in )
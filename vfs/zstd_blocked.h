@@ -0,0 +1,448 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/** zstd_blocked.h                                   -*- C++ -*-
+
+    Block-indexed zstd container format.  The payload is cut into
+    fixed-size blocks, each compressed as an independent zstd frame, with
+    a frame index of compressed offsets appended at the end of the file.
+    Unlike a plain compressed stream, the compressed blocks can be handed
+    to separate threads and decompressed in parallel, and the index
+    allows seeking to an arbitrary uncompressed offset.
+
+    Layout (integers are little-endian, as written on x86):
+
+      header    magic "ZSB1", uint64 blockSize
+      blocks    repeated: uint32 compressedSize, uint32 uncompressedSize,
+                then compressedSize bytes forming a complete zstd frame
+      sentinel  uint32 0xFFFFFFFF
+      index     uint64 numBlocks, then per block: uint64 compressedOffset
+                (of its compressedSize field), uint32 compressedSize,
+                uint32 uncompressedSize
+      footer    uint64 indexOffset, magic "ZSBX"
+*/
+
+#pragma once
+
+#include "zstd_filter.h"
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+
+namespace Datacratic {
+
+namespace zsb {
+
+static constexpr char MAGIC[4] = { 'Z', 'S', 'B', '1' };
+static constexpr char FOOTER_MAGIC[4] = { 'Z', 'S', 'B', 'X' };
+static constexpr uint32_t SENTINEL = 0xFFFFFFFFU;
+static constexpr uint64_t DEFAULT_BLOCK_SIZE = 2 * 1024 * 1024;
+
+template<typename Source>
+void readFully(Source& src, char* data, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        std::streamsize got
+            = boost::iostreams::read(src, data + done, size - done);
+        if (got <= 0)
+            throw zstd_error("premature end of blocked zstd file");
+        done += got;
+    }
+}
+
+} // namespace zsb
+
+
+/** Does the resource name look like a blocked zstd file? */
+inline bool isZstdBlocked(const std::string & resource)
+{
+    auto endsWith = [] (const std::string & s, const std::string & suffix)
+        {
+            return s.size() >= suffix.size()
+                && s.compare(s.size() - suffix.size(), suffix.size(),
+                             suffix) == 0;
+        };
+    return endsWith(resource, ".zsb") || endsWith(resource, ".zsb~");
+}
+
+
+/******************************************************************************/
+/* ZSTD BLOCKED COMPRESSOR                                                    */
+/******************************************************************************/
+
+/** Output filter writing the blocked container.  Input bytes are
+    buffered into blocks of blockSize bytes, each compressed as an
+    independent zstd frame; close() appends the frame index.
+
+    The context is shared between copies, since boost iostreams passes
+    filters by value and only ever uses the last copy.
+*/
+struct zstd_blocked_compressor : public boost::iostreams::multichar_output_filter
+{
+    zstd_blocked_compressor(int level = -1,
+                            uint64_t blockSize = zsb::DEFAULT_BLOCK_SIZE)
+        : cctx(ZSTD_createCCtx(), ZSTD_freeCCtx),
+          blockSize(blockSize),
+          headerWritten(false),
+          fileOffset(0)
+    {
+        if (!cctx)
+            throw zstd_error("unable to create zstd compression context");
+        if (blockSize == 0 || blockSize > SENTINEL_SAFE_SIZE)
+            throw zstd_error("blocked zstd block size out of range");
+
+        if (level != -1)
+            zstd::checkError
+                (ZSTD_CCtx_setParameter(cctx.get(),
+                                        ZSTD_c_compressionLevel, level));
+
+        blockData.reserve(blockSize);
+    }
+
+    template<typename Sink>
+    std::streamsize write(Sink& sink, const char* s, std::streamsize n)
+    {
+        std::streamsize done = 0;
+        while (done < n) {
+            size_t take = std::min<size_t>(n - done,
+                                           blockSize - blockData.size());
+            blockData.insert(blockData.end(), s + done, s + done + take);
+            done += take;
+            if (blockData.size() == blockSize)
+                flushBlock(sink);
+        }
+        return n;
+    }
+
+    template<typename Sink>
+    void close(Sink& sink)
+    {
+        if (!blockData.empty())
+            flushBlock(sink);
+
+        // An empty payload still gets a valid (zero block) container
+        writeHeader(sink);
+
+        writeValue(sink, zsb::SENTINEL);
+
+        uint64_t indexOffset = fileOffset;
+        writeValue(sink, (uint64_t)index.size());
+        for (auto & entry: index) {
+            writeValue(sink, entry.compressedOffset);
+            writeValue(sink, entry.compressedSize);
+            writeValue(sink, entry.uncompressedSize);
+        }
+
+        writeValue(sink, indexOffset);
+        zstd::write(sink, zsb::FOOTER_MAGIC, sizeof(zsb::FOOTER_MAGIC));
+    }
+
+private:
+    // Uncompressed sizes are stored as uint32, and the sentinel must be
+    // distinguishable from a compressed size
+    static constexpr uint64_t SENTINEL_SAFE_SIZE = 1ULL << 30;
+
+    struct Entry {
+        uint64_t compressedOffset;
+        uint32_t compressedSize;
+        uint32_t uncompressedSize;
+    };
+
+    template<typename Sink, typename T>
+    void writeValue(Sink& sink, T value)
+    {
+        zstd::write(sink, (const char *)&value, sizeof(value));
+        fileOffset += sizeof(value);
+    }
+
+    template<typename Sink>
+    void writeHeader(Sink& sink)
+    {
+        if (headerWritten)
+            return;
+        zstd::write(sink, zsb::MAGIC, sizeof(zsb::MAGIC));
+        fileOffset += sizeof(zsb::MAGIC);
+        writeValue(sink, blockSize);
+        headerWritten = true;
+    }
+
+    template<typename Sink>
+    void flushBlock(Sink& sink)
+    {
+        writeHeader(sink);
+
+        size_t bound = ZSTD_compressBound(blockData.size());
+        compressed.resize(bound);
+        size_t compressedSize
+            = zstd::checkError
+                (ZSTD_compress2(cctx.get(), compressed.data(), bound,
+                                blockData.data(), blockData.size()));
+
+        index.push_back({ fileOffset, (uint32_t)compressedSize,
+                          (uint32_t)blockData.size() });
+
+        writeValue(sink, (uint32_t)compressedSize);
+        writeValue(sink, (uint32_t)blockData.size());
+        zstd::write(sink, compressed.data(), compressedSize);
+        fileOffset += compressedSize;
+
+        blockData.clear();
+    }
+
+    std::shared_ptr<ZSTD_CCtx> cctx;
+    uint64_t blockSize;
+    bool headerWritten;
+    uint64_t fileOffset;
+    std::vector<char> blockData;
+    std::vector<char> compressed;
+    std::vector<Entry> index;
+};
+
+
+/******************************************************************************/
+/* ZSTD BLOCKED DECOMPRESSOR                                                  */
+/******************************************************************************/
+
+/** Input filter reading the blocked container sequentially, for
+    consumers that just want the decompressed bytes.  Stops at the
+    sentinel; the trailing index is left unread.
+*/
+struct zstd_blocked_decompressor : public boost::iostreams::multichar_input_filter
+{
+    zstd_blocked_decompressor()
+        : dctx(ZSTD_createDCtx(), ZSTD_freeDCtx),
+          headerRead(false),
+          pos(0),
+          eos(false)
+    {
+        if (!dctx)
+            throw zstd_error("unable to create zstd decompression context");
+    }
+
+    template<typename Source>
+    std::streamsize read(Source& src, char* s, std::streamsize n)
+    {
+        std::streamsize done = 0;
+        while (done < n && !eos) {
+            if (pos == outBuffer.size() && !readBlock(src)) {
+                eos = true;
+                break;
+            }
+            size_t take = std::min<size_t>(n - done, outBuffer.size() - pos);
+            std::memcpy(s + done, outBuffer.data() + pos, take);
+            pos += take;
+            done += take;
+        }
+
+        return done == 0 && eos ? -1 : done;
+    }
+
+private:
+    template<typename Source>
+    bool readBlock(Source& src)
+    {
+        if (!headerRead) {
+            char magic[sizeof(zsb::MAGIC)];
+            zsb::readFully(src, magic, sizeof(magic));
+            if (std::memcmp(magic, zsb::MAGIC, sizeof(magic)) != 0)
+                throw zstd_error("not a blocked zstd file: bad magic");
+            uint64_t blockSize;
+            readValue(src, blockSize);
+            headerRead = true;
+        }
+
+        uint32_t compressedSize;
+        readValue(src, compressedSize);
+        if (compressedSize == zsb::SENTINEL)
+            return false;
+        uint32_t uncompressedSize;
+        readValue(src, uncompressedSize);
+
+        inBuffer.resize(compressedSize);
+        zsb::readFully(src, inBuffer.data(), compressedSize);
+
+        outBuffer.resize(uncompressedSize);
+        size_t result
+            = zstd::checkError
+                (ZSTD_decompressDCtx(dctx.get(),
+                                     outBuffer.data(), uncompressedSize,
+                                     inBuffer.data(), compressedSize));
+        if (result != uncompressedSize)
+            throw zstd_error("blocked zstd frame size mismatch");
+        pos = 0;
+        return true;
+    }
+
+    template<typename Source, typename T>
+    void readValue(Source& src, T & value)
+    {
+        zsb::readFully(src, (char *)&value, sizeof(value));
+    }
+
+    std::shared_ptr<ZSTD_DCtx> dctx;
+    bool headerRead;
+    std::vector<char> inBuffer;
+    std::vector<char> outBuffer;
+    size_t pos;
+    bool eos;
+};
+
+
+/******************************************************************************/
+/* ZSTD BLOCKED SOURCE                                                        */
+/******************************************************************************/
+
+/** Reads a blocked file at the compressed level, returning one complete
+    frame at a time so that frames can be decompressed on separate
+    threads.  The stream must be positioned at the start of the file and
+    deliver the raw (compressed) bytes.
+*/
+struct ZstdBlockedSource {
+
+    ZstdBlockedSource(std::istream & stream)
+        : stream(stream)
+    {
+        char magic[sizeof(zsb::MAGIC)];
+        readBytes(magic, sizeof(magic));
+        if (std::memcmp(magic, zsb::MAGIC, sizeof(magic)) != 0)
+            throw zstd_error("not a blocked zstd file: bad magic");
+        readValue(blockSize_);
+        readValue(nextCompressedSize);
+    }
+
+    /** Uncompressed size of every block but the last. */
+    uint64_t blockSize() const { return blockSize_; }
+
+    /** True once the last block has been returned. */
+    bool eof() const { return nextCompressedSize == zsb::SENTINEL; }
+
+    /** Read the next compressed frame.  Returns false at the end of the
+        blocks.
+    */
+    bool nextBlock(std::vector<char> & frame, uint32_t & uncompressedSize)
+    {
+        if (eof())
+            return false;
+        uint32_t compressedSize = nextCompressedSize;
+        readValue(uncompressedSize);
+        frame.resize(compressedSize);
+        readBytes(frame.data(), compressedSize);
+        readValue(nextCompressedSize);
+        return true;
+    }
+
+    /** Decompress a frame returned by nextBlock().  Thread safe. */
+    static void decompressBlock(const char * frame, size_t frameSize,
+                                char * out, size_t outSize)
+    {
+        size_t result
+            = zstd::checkError(ZSTD_decompress(out, outSize,
+                                               frame, frameSize));
+        if (result != outSize)
+            throw zstd_error("blocked zstd frame size mismatch");
+    }
+
+private:
+    void readBytes(char * data, size_t size)
+    {
+        stream.read(data, size);
+        if ((size_t)stream.gcount() != size)
+            throw zstd_error("premature end of blocked zstd file");
+    }
+
+    template<typename T>
+    void readValue(T & value)
+    {
+        readBytes((char *)&value, sizeof(value));
+    }
+
+    std::istream & stream;
+    uint64_t blockSize_;
+    uint32_t nextCompressedSize;
+};
+
+
+/******************************************************************************/
+/* ZSTD BLOCKED INDEX                                                         */
+/******************************************************************************/
+
+/** Frame index from the end of a blocked file, mapping uncompressed
+    offsets to compressed ones for random access.  Requires a seekable
+    stream over the raw (compressed) bytes.
+*/
+struct ZstdBlockedIndex {
+
+    struct Entry {
+        uint64_t compressedOffset;
+        uint32_t compressedSize;
+        uint32_t uncompressedSize;
+    };
+
+    uint64_t blockSize;
+    std::vector<Entry> blocks;
+
+    uint64_t totalUncompressedSize() const
+    {
+        uint64_t result = 0;
+        for (auto & entry: blocks)
+            result += entry.uncompressedSize;
+        return result;
+    }
+
+    /** Number of the block holding the given uncompressed offset.  All
+        blocks but the last are exactly blockSize long.
+    */
+    size_t blockAtOffset(uint64_t uncompressedOffset) const
+    {
+        size_t result = uncompressedOffset / blockSize;
+        if (result >= blocks.size())
+            throw zstd_error("uncompressed offset past end of blocked "
+                             "zstd file");
+        return result;
+    }
+
+    static ZstdBlockedIndex load(std::istream & stream)
+    {
+        auto readBytes = [&] (char * data, size_t size)
+            {
+                stream.read(data, size);
+                if ((size_t)stream.gcount() != size)
+                    throw zstd_error("premature end of blocked zstd file");
+            };
+
+        char magic[sizeof(zsb::MAGIC)];
+        readBytes(magic, sizeof(magic));
+        if (std::memcmp(magic, zsb::MAGIC, sizeof(magic)) != 0)
+            throw zstd_error("not a blocked zstd file: bad magic");
+
+        ZstdBlockedIndex result;
+        readBytes((char *)&result.blockSize, sizeof(result.blockSize));
+
+        stream.seekg(-(std::streamoff)(sizeof(uint64_t)
+                                       + sizeof(zsb::FOOTER_MAGIC)),
+                     std::ios::end);
+        uint64_t indexOffset;
+        readBytes((char *)&indexOffset, sizeof(indexOffset));
+        readBytes(magic, sizeof(magic));
+        if (std::memcmp(magic, zsb::FOOTER_MAGIC, sizeof(magic)) != 0)
+            throw zstd_error("not a blocked zstd file: bad footer");
+
+        stream.seekg(indexOffset);
+        uint64_t numBlocks;
+        readBytes((char *)&numBlocks, sizeof(numBlocks));
+        result.blocks.resize(numBlocks);
+        for (auto & entry: result.blocks) {
+            readBytes((char *)&entry.compressedOffset,
+                      sizeof(entry.compressedOffset));
+            readBytes((char *)&entry.compressedSize,
+                      sizeof(entry.compressedSize));
+            readBytes((char *)&entry.uncompressedSize,
+                      sizeof(entry.uncompressedSize));
+        }
+
+        return result;
+    }
+};
+
+} // namespace Datacratic
@@ -0,0 +1,220 @@
+// This file is part of MLDB. Copyright 2016 Datacratic. All rights reserved.
+
+/** zstd_filter.h                                -*- C++ -*-
+
+    boost iostreams filter implementation for Zstandard, on top of the
+    libzstd streaming API.  Compression can spread over several worker
+    threads, which keeps large exports from being bottlenecked on a
+    single core.
+*/
+
+#pragma once
+
+#include <zstd.h>
+
+#include <boost/iostreams/concepts.hpp>
+#include <boost/iostreams/operations.hpp>
+#include <ios>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Datacratic {
+
+
+/******************************************************************************/
+/* ZSTD ERROR                                                                 */
+/******************************************************************************/
+
+struct zstd_error : public std::ios_base::failure
+{
+    explicit zstd_error(const std::string& msg) : failure(msg) {}
+};
+
+namespace zstd {
+
+inline size_t checkError(size_t code)
+{
+    if (ZSTD_isError(code))
+        throw zstd_error(ZSTD_getErrorName(code));
+    return code;
+}
+
+template<typename Sink>
+void write(Sink& sink, const char* data, size_t size)
+{
+    while (size > 0) {
+        size_t written = boost::iostreams::write(sink, data, size);
+        if (!written) throw zstd_error("unable to write bytes");
+
+        data += written;
+        size -= written;
+    }
+}
+
+} // namespace zstd
+
+
+/******************************************************************************/
+/* ZSTD COMPRESSOR                                                            */
+/******************************************************************************/
+
+struct zstd_compressor : public boost::iostreams::multichar_output_filter
+{
+    /* Flushable so that a stream flush produces a decodable prefix;
+       needed when compressing data that is streamed out chunk by
+       chunk. */
+    struct category : boost::iostreams::multichar_output_filter::category,
+                      boost::iostreams::flushable_tag
+    {
+    };
+
+
+    /** Compress with the given level (-1 for the library default) over
+        the given number of worker threads (-1 for one per core).  When
+        libzstd was built without multithreading support the worker
+        parameter is refused and compression runs on the calling thread.
+
+        The context is shared between copies, since boost iostreams
+        passes filters by value and only ever uses the last copy.
+    */
+    zstd_compressor(int level = -1, int numThreads = -1)
+        : cctx(ZSTD_createCCtx(), ZSTD_freeCCtx)
+    {
+        if (!cctx)
+            throw zstd_error("unable to create zstd compression context");
+
+        if (level != -1)
+            zstd::checkError
+                (ZSTD_CCtx_setParameter(cctx.get(),
+                                        ZSTD_c_compressionLevel, level));
+
+        if (numThreads == -1)
+            numThreads = std::thread::hardware_concurrency();
+        ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_nbWorkers, numThreads);
+
+        buffer.resize(ZSTD_CStreamOutSize());
+    }
+
+    template<typename Sink>
+    std::streamsize write(Sink& sink, const char* s, std::streamsize n)
+    {
+        ZSTD_inBuffer in = { s, (size_t)n, 0 };
+
+        while (in.pos < in.size) {
+            ZSTD_outBuffer out = { buffer.data(), buffer.size(), 0 };
+            zstd::checkError
+                (ZSTD_compressStream2(cctx.get(), &out, &in,
+                                      ZSTD_e_continue));
+            if (out.pos)
+                zstd::write(sink, buffer.data(), out.pos);
+        }
+
+        return n;
+    }
+
+    /** Flush whatever the context has buffered so that everything
+        written so far can be decoded on the other end. */
+    template<typename Sink>
+    bool flush(Sink& sink)
+    {
+        ZSTD_inBuffer in = { nullptr, 0, 0 };
+
+        for (;;) {
+            ZSTD_outBuffer out = { buffer.data(), buffer.size(), 0 };
+            size_t remaining
+                = zstd::checkError
+                    (ZSTD_compressStream2(cctx.get(), &out, &in,
+                                          ZSTD_e_flush));
+            if (out.pos)
+                zstd::write(sink, buffer.data(), out.pos);
+            if (remaining == 0)
+                break;
+        }
+
+        return true;
+    }
+
+    template<typename Sink>
+    void close(Sink& sink)
+    {
+        ZSTD_inBuffer in = { nullptr, 0, 0 };
+
+        for (;;) {
+            ZSTD_outBuffer out = { buffer.data(), buffer.size(), 0 };
+            size_t remaining
+                = zstd::checkError
+                    (ZSTD_compressStream2(cctx.get(), &out, &in,
+                                          ZSTD_e_end));
+            if (out.pos)
+                zstd::write(sink, buffer.data(), out.pos);
+            if (remaining == 0)
+                break;
+        }
+    }
+
+private:
+    std::shared_ptr<ZSTD_CCtx> cctx;
+    std::vector<char> buffer;
+};
+
+
+/******************************************************************************/
+/* ZSTD DECOMPRESSOR                                                          */
+/******************************************************************************/
+
+struct zstd_decompressor : public boost::iostreams::multichar_input_filter
+{
+    zstd_decompressor()
+        : dctx(ZSTD_createDCtx(), ZSTD_freeDCtx),
+          in{nullptr, 0, 0},
+          lastResult(0),
+          eos(false)
+    {
+        if (!dctx)
+            throw zstd_error("unable to create zstd decompression context");
+
+        inBuffer.resize(ZSTD_DStreamInSize());
+    }
+
+    template<typename Source>
+    std::streamsize read(Source& src, char* s, std::streamsize n)
+    {
+        ZSTD_outBuffer out = { s, (size_t)n, 0 };
+
+        while (out.pos < out.size && !eos) {
+            if (in.pos == in.size) {
+                std::streamsize got
+                    = boost::iostreams::read(src, inBuffer.data(),
+                                             inBuffer.size());
+                if (got <= 0) {
+                    // A frame left open at the end of the input is a
+                    // truncated stream
+                    if (lastResult != 0)
+                        throw zstd_error("premature end of zstd stream");
+                    eos = true;
+                    break;
+                }
+
+                in.src = inBuffer.data();
+                in.size = got;
+                in.pos = 0;
+            }
+
+            lastResult = zstd::checkError
+                (ZSTD_decompressStream(dctx.get(), &out, &in));
+        }
+
+        return eos && !out.pos ? -1 : out.pos;
+    }
+
+private:
+    std::shared_ptr<ZSTD_DCtx> dctx;
+
+    std::vector<char> inBuffer;
+    ZSTD_inBuffer in;
+    size_t lastResult;   ///< 0 iff we are at a frame boundary
+    bool eos;
+};
+
+} // namespace Datacratic